@@ -0,0 +1,178 @@
+// ============================================================================
+//
+// FILE        : Clock.cpp
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : Implementation of exported class Clock
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// this is the "main" source file
+#define	SRVSTART_DLL
+
+// we are exporting the class
+#define	SRVSTART_DLL_EXPORT
+
+//
+// which platform are we running?
+//
+#if	defined(WIN32)
+#define	CLOCK_PLATFORM_IS_WIN32	1
+#else
+#define	CLOCK_PLATFORM_IS_WIN32	0
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// system headers
+#if	CLOCK_PLATFORM_IS_WIN32
+#define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
+#include <windows.h>
+#else
+#include <errno.h>
+#include <time.h>
+#endif	// CLOCK_PLATFORM_IS_WIN32
+
+// class headers
+#include "Clock.h"
+
+// ============================================================================
+//
+// NAMESPACE DECLARATIONS
+//
+// ============================================================================
+
+using namespace SrvStart;
+
+// ============================================================================
+//
+// LOCAL VARIABLES
+//
+// ============================================================================
+
+// replacement time source (if any)
+static Clock::TICKS_FUNCTION *G_ticksFunction = 0;
+static Clock::SLEEP_FUNCTION *G_sleepFunction = 0;
+static void                  *G_clockPointer  = 0;
+
+// ============================================================================
+//
+// PUBLIC MEMBER FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// MEMBER FUNCTION : Clock::getTicks
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : get the current time, for measuring intervals
+//
+// RETURNS         : milliseconds since an arbitrary fixed point
+//
+// ============================================================================
+unsigned long long Clock::getTicks()
+{
+	if(G_ticksFunction!=0)
+	{
+		return (*G_ticksFunction)(G_clockPointer);
+	}
+
+#if	CLOCK_PLATFORM_IS_WIN32
+	return GetTickCount64();
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	return ((unsigned long long)now.tv_sec)*1000+now.tv_nsec/1000000;
+#endif	// CLOCK_PLATFORM_IS_WIN32
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : Clock::sleep
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : wait for a time
+//
+// ARGUMENTS       : milliseconds IN time to wait
+//
+// ============================================================================
+void Clock::sleep
+(
+	unsigned long milliseconds
+)
+{
+	if(G_sleepFunction!=0)
+	{
+		(*G_sleepFunction)(milliseconds,G_clockPointer);
+		return;
+	}
+
+#if	CLOCK_PLATFORM_IS_WIN32
+	Sleep(milliseconds);
+#else
+	struct timespec wait;
+	wait.tv_sec  = milliseconds/1000;
+	wait.tv_nsec = (milliseconds%1000)*1000000L;
+	while((nanosleep(&wait,&wait)!=0)&&(errno==EINTR))
+	{
+		// interrupted by a signal - wait for the rest of the time
+	}
+#endif	// CLOCK_PLATFORM_IS_WIN32
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : Clock::setTimeSource
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : replace the system clock (eg with a virtual clock, for a
+//                   test harness), or go back to it
+//
+//                   The functions are not protected by a lock, so they must
+//                   be set before any thread that uses the clock is started.
+//                   Either function can be replaced on its own.
+//
+// ARGUMENTS       : ticksFunction  IN function returning the current time in
+//                                     milliseconds (NULL for the system clock)
+//                   sleepFunction  IN function waiting for a time (NULL for the
+//                                     system clock)
+//                   genericPointer IN pointer passed to both functions
+//
+// ============================================================================
+void Clock::setTimeSource
+(
+	TICKS_FUNCTION *ticksFunction,
+	SLEEP_FUNCTION *sleepFunction,
+	void           *genericPointer
+)
+{
+	G_ticksFunction = ticksFunction;
+	G_sleepFunction = sleepFunction;
+	G_clockPointer  = genericPointer;
+}
@@ -0,0 +1,124 @@
+// ============================================================================
+//
+// FILE        : Clock.h
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : interface definition for Clock class
+//
+//               The Clock is the time source for the service supervisor:
+//               every wait (see Sleeper) and every uptime it measures goes
+//               through it.  By default it is the system's monotonic clock.
+//
+//               A test harness can replace it with a virtual clock, whose
+//               sleep just moves virtual time on, so that start, restart,
+//               stop and timeout sequences run without any real waiting.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// prevent multiple inclusion
+
+#if !defined(__CLOCK_H__)
+#define __CLOCK_H__
+
+// ============================================================================
+//
+// IMPORT / EXPORT
+//
+// ============================================================================
+
+//
+// if SRVSTART_DLL_EXPORT is #defined, then we are building the DLL
+//  and exporting the classes
+//
+// otherwise, we are building an executable which will link with the DLL at run-time
+//
+// -------------------------------------------------------------
+// APART FROM THE DLL ITSELF,
+//  ANY SOURCE FILE WHICH #includes THIS ONE SHOULD ENSURE THAT
+//  SRVSTART_DLL_EXPORT is not #defined
+// -------------------------------------------------------------
+//
+
+#ifdef SRVSTART_DLL_EXPORT
+#define SRVSTART_DLL_API __declspec(dllexport)
+#pragma message("exporting Clock")
+
+#else
+
+#ifdef	SRVSTART_DLL_LOCAL
+#pragma message("Clock is local")
+#define	SRVSTART_DLL_API
+
+#else
+
+#define SRVSTART_DLL_API __declspec(dllimport)
+#pragma message("importing Clock")
+
+#endif
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// namespace header
+#include "SrvStart.h"
+
+// ============================================================================
+//
+// NAMESPACE
+//
+// ============================================================================
+
+// all the DLL classes are defined within the SrvStart namespace
+namespace SrvStart {
+
+// ============================================================================
+//
+// Clock class
+//
+// ============================================================================
+class SRVSTART_DLL_API Clock
+{
+public:
+	// milliseconds since an arbitrary fixed point (never goes backwards)
+	static unsigned long long getTicks();
+
+	// wait for the given number of milliseconds
+	static void sleep(unsigned long milliseconds);
+
+	// replace the time source (NULL functions for the system clock) - this
+	//  must be done before any thread that uses the clock is started
+	typedef unsigned long long TICKS_FUNCTION(void *genericPointer);
+	typedef void SLEEP_FUNCTION(unsigned long milliseconds,void *genericPointer);
+	static void setTimeSource(TICKS_FUNCTION *ticksFunction,SLEEP_FUNCTION *sleepFunction,
+		void *genericPointer);
+
+private:
+	Clock(); // no constructor
+
+};
+
+} // namespace SrvStart
+
+#endif // !defined(__CLOCK_H__)
@@ -48,14 +48,24 @@
 #include <process.h>
 #include <stdlib.h>
 #include <direct.h>
+#include <time.h>
+#include <psapi.h>
+#include <tlhelp32.h>
 
 // support headers
 #include <logger.h>
 
 // class headers
+#include "Clock.h"
 #include "Sleeper.h"
 #include "StringSubstituter.h"
+#include "SubstitutionTemplate.h"
+#include "SubstitutionContext.h"
 #include "ScmConnector.h"
+#include "ControlEndpoint.h"
+#include "Metrics.h"
+#include "MetricsEndpoint.h"
+#include "StatusBoard.h"
 #include "CmdRunner.h"
 
 // ============================================================================
@@ -75,6 +85,23 @@ using namespace SrvStart;
 const char *DEFAULT_NAME			= "";
 const char *DEFAULT_COMMAND			= "";
 
+// actions requested through the control endpoint, for watchCommand() to take
+typedef enum CONTROL_ACTIONS { CONTROL_NONE, CONTROL_STOP, CONTROL_RESTART, CONTROL_RELOAD_RESTART } ;
+
+// pause and continue requests from the SCM, for watchCommand() to act on
+typedef enum PAUSE_REQUESTS { PAUSE_REQUEST_NONE, PAUSE_REQUEST_PAUSE, PAUSE_REQUEST_CONTINUE } ;
+
+// why the command was restarted (for the metrics)
+typedef enum RESTART_CAUSES { RESTART_CAUSE_EXIT, RESTART_CAUSE_RELOAD, RESTART_CAUSE_REQUEST,
+								RESTART_CAUSE_COUNT } ;
+static const char *RESTART_CAUSE_NAMES[RESTART_CAUSE_COUNT] = { "exit", "reload", "request" };
+
+// SCM statuses reported by the metrics
+static const ScmConnector::SCM_STATUSES METRICS_STATUSES[] = {
+	ScmConnector::STATUS_STARTING,ScmConnector::STATUS_RUNNING,ScmConnector::STATUS_STOPPING,
+	ScmConnector::STATUS_STOPPED,ScmConnector::STATUS_PAUSING,ScmConnector::STATUS_PAUSED,
+	ScmConnector::STATUS_CONTINUING };
+
 // ============================================================================
 //
 // LOCAL FUNCTION PROTOTYPES
@@ -92,6 +119,19 @@ typedef enum STARTED_PROCESS_STATUS {
 				PROCESS_STATUS_EXIT_FAILURE } ;
 static STARTED_PROCESS_STATUS getProcessStatus(HANDLE hProcess) throw(SrvStartException);
 BOOL CALLBACK sendCloseMessage(HWND hwnd,LPARAM lParam);
+bool suspendProcess(DWORD processId,bool suspend);
+void scmControlFunction(ScmConnector::SCM_CONTROLS control,void *genericPointer);
+static const char *getStatusName(ScmConnector::SCM_STATUSES scmStatus);
+typedef struct PROCESS_SAMPLE {
+				ULONGLONG userMilliseconds;
+				ULONGLONG kernelMilliseconds;
+				ULONGLONG workingSet;
+				ULONGLONG peakWorkingSet;
+				ULONGLONG pagefile;
+				ULONGLONG readBytes;
+				ULONGLONG writeBytes;
+				DWORD     handles; } ;
+static bool sampleProcess(HANDLE hProcess,PROCESS_SAMPLE *sample);
 
 // ============================================================================
 //
@@ -116,6 +156,12 @@ struct CmdRunnerData
 	char *shutdownCommand;
 	CmdRunner::SHUTDOWN_METHODS shutdownMethod;
 
+	// pause / continue
+	char *pauseCommand;
+	char *continueCommand;
+	CmdRunner::PAUSE_METHODS pauseMethod;
+	bool paused;
+
 	// characteristics
 	int waitInterval;
 	CmdRunner::EXECUTION_PRIORITIES executionPriority;
@@ -134,9 +180,63 @@ struct CmdRunnerData
 	// ScmConnector
 	ScmConnector *scmConnector;
 
+	// configuration reload
+	CmdRunner::RELOAD_FUNCTION *reloadFunction;
+	void                       *reloadPointer;
+	bool                        reloadForced;
+
+	// requests from the SCM (made on its thread, taken by watchCommand())
+	volatile LONG pauseRequest;
+	volatile LONG paramChanged;
+
+	// control endpoint, and the action requested through it
+	ControlEndpoint controlEndpoint;
+	CONTROL_ACTIONS controlAction;
+
+	// service statistics (reported through the control endpoint)
+	ULONGLONG serviceStartTicks;
+	ULONGLONG commandStartTicks;
+	int       restartCount;
+
+	// metrics, and the endpoint which serves them - the values are updated on
+	//  this thread, and rendered on the endpoint's
+	int              metricsPort;
+	MetricsEndpoint  metricsEndpoint;
+	MetricsGauge     metricsServiceStart;
+	MetricsGauge     metricsCommandStart;
+	MetricsGauge     metricsProcessId;
+	MetricsCounter   metricsRestarts[RESTART_CAUSE_COUNT];
+	MetricsHistogram metricsTimeToReady;
+	MetricsHistogram metricsStopDuration;
+	MetricsCounter   metricsProbeSuccesses;
+	MetricsCounter   metricsProbeFailures;
+	MetricsGauge     metricsProbeLastResult;
+
+	// status board, and the record published there
+	StatusBoard                statusBoard;
+	StatusBoard::STATUS_RECORD statusRecord;
+
 	// 	StringSubstituter
 	StringSubstituter stringSubstituter;
 
+	// environment variables (snapshot of process environment plus env directives)
+	SubstitutionContext substitutionContext;
+	char *environmentBlock;
+
+	// compiled startup / shutdown strings, and their substituted values
+	SubstitutionTemplate startupCommandTemplate;
+	SubstitutionTemplate startupDirectoryTemplate;
+	SubstitutionTemplate waitCommandTemplate;
+	SubstitutionTemplate shutdownCommandTemplate;
+	SubstitutionTemplate pauseCommandTemplate;
+	SubstitutionTemplate continueCommandTemplate;
+	char *substStartupCommand;
+	char *substStartupDirectory;
+	char *substWaitCommand;
+	char *substShutdownCommand;
+	char *substPauseCommand;
+	char *substContinueCommand;
+
 	// constructor / destructor
 	CmdRunnerData()
 	{
@@ -150,6 +250,18 @@ struct CmdRunnerData
 		stringSubstituter.stringInit(waitCommand);
 		stringSubstituter.stringInit(shutdownCommand);
 		shutdownMethod = CmdRunner::SHUTDOWN_BY_KILL;
+		stringSubstituter.stringInit(pauseCommand);
+		stringSubstituter.stringInit(continueCommand);
+		pauseMethod = CmdRunner::PAUSE_NOT_SUPPORTED;
+		paused      = false;
+
+		environmentBlock      = 0;
+		substStartupCommand   = 0;
+		substStartupDirectory = 0;
+		substWaitCommand      = 0;
+		substShutdownCommand  = 0;
+		substPauseCommand     = 0;
+		substContinueCommand  = 0;
 
 		waitInterval      = 1;
 		executionPriority = CmdRunner::NORMAL_PRIORITY;
@@ -164,15 +276,114 @@ struct CmdRunnerData
 
 		scmConnector = 0;
 
+		reloadFunction = 0;
+		reloadPointer  = 0;
+		reloadForced   = false;
+
+		pauseRequest = PAUSE_REQUEST_NONE;
+		paramChanged = 0;
+
+		controlAction = CONTROL_NONE;
+
+		serviceStartTicks = 0;
+		commandStartTicks = 0;
+		restartCount      = 0;
+
+		metricsPort = 0;
+		metricsProbeLastResult.set(-1);
+
+		memset(&statusRecord,0,sizeof(statusRecord));
+
 	} ;
 	
 	virtual ~CmdRunnerData()
 	{
-		stringSubstituter.stringDelete(srvName);
-		stringSubstituter.stringDelete(startupCommand);
-		stringSubstituter.stringDelete(startupDirectory);
-		stringSubstituter.stringDelete(waitCommand);
-		stringSubstituter.stringDelete(shutdownCommand);
+		// the strings are freed along with stringSubstituter
+	} ;
+
+	// substitute into the startup command, startup directory and wait command
+	// (each string is only parsed when it changes, and only re-rendered when
+	//  an environment variable it uses changes)
+	void substitute() throw (SrvStartException)
+	{
+		environmentBlock = substitutionContext.getEnvironmentBlock();
+
+		startupCommandTemplate.compile(startupCommand);
+		substStartupCommand = startupCommandTemplate.render(&substitutionContext);
+
+		if(startupDirectory==0)
+		{
+			substStartupDirectory = 0;
+		}
+		else
+		{
+			startupDirectoryTemplate.compile(startupDirectory);
+			substStartupDirectory = startupDirectoryTemplate.render(&substitutionContext);
+		}
+
+		waitCommandTemplate.compile(waitCommand);
+		substWaitCommand = waitCommandTemplate.render(&substitutionContext);
+	} ;
+
+	// substitute into the shutdown, pause and continue commands
+	void substituteShutdown() throw (SrvStartException)
+	{
+		shutdownCommandTemplate.compile(shutdownCommand);
+		substShutdownCommand = shutdownCommandTemplate.render(&substitutionContext);
+		pauseCommandTemplate.compile(pauseCommand);
+		substPauseCommand = pauseCommandTemplate.render(&substitutionContext);
+		continueCommandTemplate.compile(continueCommand);
+		substContinueCommand = continueCommandTemplate.render(&substitutionContext);
+	} ;
+
+	// publish the state of the service and its command to the status board
+	// (the state's transition time is when it was first published)
+	void publishStatus()
+	{
+		if(!statusBoard.isOpen())
+		{
+			return;
+		}
+
+		unsigned long long now   = (unsigned long long)time(0);
+		const char        *state = getStatusName(scmConnector->getScmStatus());
+		if(strcmp(statusRecord.state,state)!=0)
+		{
+			strncpy(statusRecord.state,state,sizeof(statusRecord.state)-1);
+			statusRecord.transitionTime = now;
+		}
+		statusRecord.restarts   = restartCount;
+		statusRecord.sampleTime = now;
+
+		// the command - or how it last exited
+		DWORD exitCode = STILL_ACTIVE;
+		if((hCommandProcess!=0)&&(GetExitCodeProcess(hCommandProcess,&exitCode))&&(exitCode!=STILL_ACTIVE))
+		{
+			if(statusRecord.pid!=0)
+			{
+				statusRecord.lastExitCode = exitCode;
+				statusRecord.lastExitTime = now;
+				statusRecord.pid          = 0;
+			}
+		}
+		else if(hCommandProcess!=0)
+		{
+			statusRecord.pid = dwProcessId;
+		}
+
+		PROCESS_SAMPLE sample;
+		if((statusRecord.pid!=0)&&(sampleProcess(hCommandProcess,&sample)))
+		{
+			statusRecord.userMilliseconds   = sample.userMilliseconds;
+			statusRecord.kernelMilliseconds = sample.kernelMilliseconds;
+			statusRecord.workingSet         = sample.workingSet;
+			statusRecord.pagefile           = sample.pagefile;
+			statusRecord.readBytes          = sample.readBytes;
+			statusRecord.writeBytes         = sample.writeBytes;
+			statusRecord.handles            = sample.handles;
+		}
+
+		statusBoard.publish(statusRecord);
 	} ;
 
 } ;
@@ -238,6 +449,8 @@ throw (SrvStartException)
 	cmdRunnerData->stringSubstituter.stringCopy(cmdRunnerData->startupCommand,DEFAULT_COMMAND);
 	cmdRunnerData->stringSubstituter.stringCopy(cmdRunnerData->shutdownCommand,"");
 	cmdRunnerData->stringSubstituter.stringCopy(cmdRunnerData->waitCommand,"");
+	cmdRunnerData->stringSubstituter.stringCopy(cmdRunnerData->pauseCommand,"");
+	cmdRunnerData->stringSubstituter.stringCopy(cmdRunnerData->continueCommand,"");
 
 	switch(mode)
 	{
@@ -289,6 +502,14 @@ throw (SrvStartException)
 				}
 				break;
 
+			case ScmConnector::STATUS_FAILED:
+				// not connected, or (sharing the process) never started by the SCM
+				LOGGER_LOG_ERROR1("CmdRunner::CmdRunner(): service '%s' was not started by the SCM",
+					cmdRunnerData->srvName)
+				THROW_SRVSTART_EXCEPTION
+					(SRVSTART_EXCEPTION_GENERAL_ERROR,"CmdRunner","CmdRunner")
+				break;
+
 			default:
 				// unexpected status
 				LOGGER_LOG_ERROR1("CmdRunner::CmdRunner(): unexpected SCM status %d",scmStatus)
@@ -330,6 +551,11 @@ throw (SrvStartException)
 			static_cast<void*>(this));
 		LOGGER_LOG_DEBUG("installed callback function")
 
+		// install the callback for the other SCM controls (pause, continue
+		//  and paramchange)
+		cmdRunnerData->scmConnector->installControlCallback(scmControlFunction,cmdRunnerData);
+		LOGGER_LOG_DEBUG("installed control callback function")
+
 	}
 
 	// we are ready to have our properties set now
@@ -357,16 +583,14 @@ void CmdRunner::start() throw (SrvStartException)
 	// make sure that the command has been set
 	CHECK_GOOD_STRING("start",cmdRunnerData->startupCommand)
 
-	// we are now ready to perform the required substitutions
-	cmdRunnerData->stringSubstituter.stringSubstitute(cmdRunnerData->startupCommand);
-
-	// also on startup directory etc if supplied
-#define	_SUBSTITUTE(d) \
-	if(d!=0) { if ((*d)!='\0') { cmdRunnerData->stringSubstituter.stringSubstitute(d); } }
+	// set the final values of env directives in our own environment (for
+	// commands run using system())
+	cmdRunnerData->substitutionContext.apply();
 
-	_SUBSTITUTE(cmdRunnerData->startupDirectory)
-	_SUBSTITUTE(cmdRunnerData->waitCommand)
-	_SUBSTITUTE(cmdRunnerData->shutdownCommand)
+	// we are now ready to perform the required substitutions
+	// (the command strings themselves are left unchanged)
+	cmdRunnerData->substitute();
+	cmdRunnerData->substituteShutdown();
 
 	// there are three cases to deal with
 
@@ -377,17 +601,17 @@ void CmdRunner::start() throw (SrvStartException)
 	{
 		LOGGER_LOG_DEBUG("start(): ordinary command running in the same window")
 		// first of all, change to the right directory
-		if(_chdir(cmdRunnerData->startupDirectory))
+		if(_chdir(cmdRunnerData->substStartupDirectory))
 		{
 			// failed to change directory
-			LOGGER_LOG_ERROR1("start(): failed to change to directory %s)",cmdRunnerData->startupDirectory)
+			LOGGER_LOG_ERROR1("start(): failed to change to directory %s)",cmdRunnerData->substStartupDirectory)
 			THROW_SRVSTART_EXCEPTION
 				(SRVSTART_EXCEPTION_INVALID_PARAMETER,"CmdRunner","start")
 		}
 		// start the command using POSIX system()
 		// there doesn't seem to be a Win32 API call for this!
-		LOGGER_LOG_DEBUG1("running command '%s' using system()",cmdRunnerData->startupCommand)
-		int rc = system(cmdRunnerData->startupCommand);
+		LOGGER_LOG_DEBUG1("running command '%s' using system()",cmdRunnerData->substStartupCommand)
+		int rc = system(cmdRunnerData->substStartupCommand);
 		// this is a blocking call, so just return now
 		if(rc == 0)
 		{
@@ -397,7 +621,7 @@ void CmdRunner::start() throw (SrvStartException)
 		else
 		{
 			LOGGER_LOG_ERROR2("start(): failed to start command %s using system() (rc = %d)",
-									cmdRunnerData->startupCommand,rc)
+									cmdRunnerData->substStartupCommand,rc)
 			THROW_SRVSTART_EXCEPTION
 				(SRVSTART_EXCEPTION_COMMAND_FAILED,"CmdRunner","start")
 		}
@@ -424,6 +648,34 @@ void CmdRunner::start() throw (SrvStartException)
 	// case 3: this is a service
 	LOGGER_LOG_DEBUG("start(): service")
 
+	// open the control endpoint (the service can run without one)
+	cmdRunnerData->serviceStartTicks = Clock::getTicks();
+	try { cmdRunnerData->controlEndpoint.open(cmdRunnerData->srvName,controlCallbackFunction,this); }
+	catch(...)
+	{
+		LOGGER_LOG_INFO1("WARNING: service '%s' cannot be controlled by srvctl",cmdRunnerData->srvName)
+	}
+
+	// open the metrics endpoint, if there is one (the service can run without it too)
+	cmdRunnerData->metricsServiceStart.set(cmdRunnerData->serviceStartTicks);
+	if(cmdRunnerData->metricsPort>0)
+	{
+		try { cmdRunnerData->metricsEndpoint.open(cmdRunnerData->metricsPort,metricsRenderFunction,this); }
+		catch(...)
+		{
+			LOGGER_LOG_INFO2("WARNING: service '%s' cannot serve metrics on port %d",
+				cmdRunnerData->srvName,cmdRunnerData->metricsPort)
+		}
+	}
+
+	// take a record on the status board (nor does it need that)
+	try { cmdRunnerData->statusBoard.open(cmdRunnerData->srvName); }
+	catch(...)
+	{
+		LOGGER_LOG_INFO1("WARNING: service '%s' is not on the status board",cmdRunnerData->srvName)
+	}
+	strncpy(cmdRunnerData->statusRecord.svcName,cmdRunnerData->srvName,sizeof(cmdRunnerData->statusRecord.svcName)-1);
+
 	// if the service is set to auto-restart, we may have to loop
 	bool stillLooping = true;
 
@@ -437,9 +689,20 @@ void CmdRunner::start() throw (SrvStartException)
 	{
 
 		// run the command
+		ULONGLONG startingTicks = Clock::getTicks();
 		try { startCommand(); }
 		CATCH_AND_NOTIFY
 
+		// the command (new or replaced) is now the service's main process, and
+		//  it is not paused (even if the one it replaces was)
+		cmdRunnerData->scmConnector->notifyMainPid(cmdRunnerData->dwProcessId);
+		cmdRunnerData->paused = false;
+		if(cmdRunnerData->commandStartTicks!=0) { cmdRunnerData->restartCount++; }
+		cmdRunnerData->commandStartTicks = Clock::getTicks();
+		cmdRunnerData->metricsCommandStart.set(cmdRunnerData->commandStartTicks);
+		cmdRunnerData->metricsProcessId.set(cmdRunnerData->dwProcessId);
+		cmdRunnerData->publishStatus();
+
 		// wait for the process to start up
 		LOGGER_LOG_DEBUG("process is starting")
 		try { waitForStartup(); }
@@ -449,12 +712,16 @@ void CmdRunner::start() throw (SrvStartException)
 		LOGGER_LOG_DEBUG("process is running")
 		try { cmdRunnerData->scmConnector->notifyScmStatus(ScmConnector::STATUS_RUNNING); }
 		CATCH_AND_NOTIFY
+		cmdRunnerData->metricsTimeToReady.observe((unsigned long)(Clock::getTicks()-startingTicks));
+		cmdRunnerData->publishStatus();
 
 		// watch the process (wait for it to finish or be stopped)
 		LOGGER_LOG_DEBUG("waiting for process to finish")
 		try
 		{
-			switch(watchCommand())
+			WATCH_OUTCOMES watchOutcome = watchCommand();
+			cmdRunnerData->publishStatus();
+			switch(watchOutcome)
 			{
 				case WATCH_COMMAND_COMPLETED:
 					// command completed on its own
@@ -463,7 +730,8 @@ void CmdRunner::start() throw (SrvStartException)
 					{
 						// auto-restart has been set - is the service still running?
 						LOGGER_LOG_DEBUG("auto-restart has been set")
-						if(cmdRunnerData->scmConnector->getScmStatus()==ScmConnector::STATUS_RUNNING)
+						ScmConnector::SCM_STATUSES scmStatus = cmdRunnerData->scmConnector->getScmStatus();
+						if((scmStatus==ScmConnector::STATUS_RUNNING)||(scmStatus==ScmConnector::STATUS_PAUSED))
 						{
 							// yes, the service is still running - restart the program
 							LOGGER_LOG_DEBUG("auto-restart has been set: will restart service program")
@@ -472,6 +740,9 @@ void CmdRunner::start() throw (SrvStartException)
 								// sleep before restart
 								Sleeper::Sleep(cmdRunnerData->autoRestartInterval,"restart service");
 							}
+							// pick up any change to the command
+							cmdRunnerData->substitute();
+							cmdRunnerData->metricsRestarts[RESTART_CAUSE_EXIT].increment();
 							stillLooping = true;
 						}
 						else
@@ -494,6 +765,24 @@ void CmdRunner::start() throw (SrvStartException)
 					LOGGER_LOG_DEBUG("command was stopped by SCM - exiting")
 					stillLooping = false;
 					break;
+
+				case WATCH_COMMAND_RELOADED:
+					// command was stopped to pick up a new configuration - start it again
+					// (the service stays RUNNING as far as the SCM is concerned)
+					LOGGER_LOG_INFO1("restarting service '%s' with its new configuration",cmdRunnerData->srvName)
+					cmdRunnerData->substitute();
+					cmdRunnerData->substituteShutdown();
+					cmdRunnerData->metricsRestarts[RESTART_CAUSE_RELOAD].increment();
+					stillLooping = true;
+					break;
+
+				case WATCH_COMMAND_RESTARTED:
+					// command was stopped through the control endpoint - start it again
+					LOGGER_LOG_INFO1("restarting service '%s' on request",cmdRunnerData->srvName)
+					cmdRunnerData->substitute();
+					cmdRunnerData->metricsRestarts[RESTART_CAUSE_REQUEST].increment();
+					stillLooping = true;
+					break;
 			}
 
 			if(!stillLooping)
@@ -502,6 +791,7 @@ void CmdRunner::start() throw (SrvStartException)
 				LOGGER_LOG_DEBUG("command has completed - service is shutting down")
 				cmdRunnerData->scmConnector->notifyScmStatus(ScmConnector::STATUS_STOPPING,true);
 				cmdRunnerData->scmConnector->notifyScmStatus(ScmConnector::STATUS_STOPPED);
+				cmdRunnerData->publishStatus();
 			}
 
 		}
@@ -509,6 +799,11 @@ void CmdRunner::start() throw (SrvStartException)
 
 	}
 
+	// the service has stopped - nobody can control it now
+	cmdRunnerData->controlEndpoint.close();
+	cmdRunnerData->metricsEndpoint.close();
+	cmdRunnerData->statusBoard.close();
+
 	// return
 	SS_RETURNV("CmdRunner::start")
 
@@ -559,6 +854,56 @@ char *CmdRunner::getShutdownCommand() const { return cmdRunnerData->shutdownComm
 char *CmdRunner::getWaitCommand() const { return cmdRunnerData->waitCommand; }
 CmdRunner::SHUTDOWN_METHODS CmdRunner::getShutdownMethod() const { return cmdRunnerData->shutdownMethod; }
 
+// ============================================================================
+//
+// MEMBER FUNCTION : CmdRunner::get|setPauseCommand
+//                   CmdRunner::get|setContinueCommand
+//                   CmdRunner::get|setPauseMethod
+//                   CmdRunner::setPreshutdownTimeout
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : set how the command is paused and continued when the SCM
+//                   asks (it cannot be paused unless a pause method is set),
+//                   and how long the SCM waits for it to stop before the
+//                   system shuts down (in seconds)
+//
+// ARGUMENTS       : as below
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+void CmdRunner::setPauseCommand(const char *pc) throw (SrvStartException)
+{
+	CHECK_GOOD_STRING("setPauseCommand",pc)
+	cmdRunnerData->stringSubstituter.stringCopy(cmdRunnerData->pauseCommand,pc);
+	setPauseMethod(PAUSE_BY_COMMAND);
+}
+void CmdRunner::setContinueCommand(const char *cc) throw (SrvStartException)
+{
+	CHECK_GOOD_STRING("setContinueCommand",cc)
+	cmdRunnerData->stringSubstituter.stringCopy(cmdRunnerData->continueCommand,cc);
+}
+void CmdRunner::setPauseMethod(const PAUSE_METHODS pm)
+{
+	cmdRunnerData->pauseMethod = pm;
+	if(cmdRunnerData->startMode==SERVICE_MODE)
+	{
+		cmdRunnerData->scmConnector->acceptPauseContinue(pm!=PAUSE_NOT_SUPPORTED);
+	}
+}
+void CmdRunner::setPreshutdownTimeout(int pt)
+{
+	if(cmdRunnerData->startMode==SERVICE_MODE)
+	{
+		cmdRunnerData->scmConnector->setPreshutdownTimeout(1000UL*pt);
+	}
+}
+
+char *CmdRunner::getPauseCommand() const { return cmdRunnerData->pauseCommand; }
+char *CmdRunner::getContinueCommand() const { return cmdRunnerData->continueCommand; }
+CmdRunner::PAUSE_METHODS CmdRunner::getPauseMethod() const { return cmdRunnerData->pauseMethod; }
+
 // ============================================================================
 //
 // MEMBER FUNCTION : CmdRunner::mapLocalDrive
@@ -621,14 +966,11 @@ void CmdRunner::mapLocalDrive
 	cmdRunnerData->stringSubstituter.stringAppend(substCommand,driveLetterString);
 	cmdRunnerData->stringSubstituter.stringAppend(substCommand," ");
 	cmdRunnerData->stringSubstituter.stringAppend(substCommand,drivePath);
-	cmdRunnerData->stringSubstituter.stringSubstitute(substCommand);
+	cmdRunnerData->stringSubstituter.stringSubstitute(substCommand,&cmdRunnerData->substitutionContext);
 
 	// run SUBST x: path
 	LOGGER_LOG_DEBUG1("About to create substitution using '%s'",substCommand)
 	int rc = system(substCommand);
-
-	// release string storage
-	cmdRunnerData->stringSubstituter.stringDelete(substCommand);
 	delete[] fullSubstPath;
 
 	// successful subst?
@@ -636,9 +978,11 @@ void CmdRunner::mapLocalDrive
 	{
 		// success
 		LOGGER_LOG_DEBUG1("Completed: '%s'",substCommand)
+		cmdRunnerData->stringSubstituter.stringDelete(substCommand);
 	}
 	else
 	{
+		cmdRunnerData->stringSubstituter.stringDelete(substCommand);
 		LOGGER_LOG_ERROR3("mapLocalDrive(): failed to subst %c = '%s' (rc = %d)",
 								driveLetter,drivePath,rc)
 		THROW_SRVSTART_EXCEPTION
@@ -671,7 +1015,7 @@ void CmdRunner::mapNetworkDrive
 	char *netPath;
 	cmdRunnerData->stringSubstituter.stringInit(netPath);
 	cmdRunnerData->stringSubstituter.stringCopy(netPath,networkPath);
-	cmdRunnerData->stringSubstituter.stringSubstitute(netPath);
+	cmdRunnerData->stringSubstituter.stringSubstitute(netPath,&cmdRunnerData->substitutionContext);
 
 	NETRESOURCE netResource;
 	netResource.dwType = RESOURCETYPE_DISK;
@@ -693,6 +1037,7 @@ void CmdRunner::mapNetworkDrive
 	if(netError == NO_ERROR)
 	{
 		// success
+		cmdRunnerData->stringSubstituter.stringDelete(netPath);
 		SS_RETURNV("mapNetworkDrive")
 	}
 
@@ -778,6 +1123,9 @@ void CmdRunner::mapNetworkDrive
 
 	}
 
+	// release string storage
+	cmdRunnerData->stringSubstituter.stringDelete(netPath);
+
 	// throw exception
 	THROW_SRVSTART_EXCEPTION
 		(SRVSTART_EXCEPTION_INVALID_PARAMETER,"CmdRunner","mapNetworkDrive")
@@ -838,6 +1186,24 @@ void CmdRunner::setAutoRestartInterval(int in) { cmdRunnerData->autoRestartInter
 bool CmdRunner::getAutoRestart() const { return cmdRunnerData->autoRestart; }
 int  CmdRunner::getAutoRestartInterval() const { return cmdRunnerData->autoRestartInterval; }
 
+// ============================================================================
+//
+// MEMBER FUNCTION : CmdRunner::setMetricsPort
+//                   CmdRunner::getMetricsPort
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : set / get the TCP port on which metrics are served (on
+//                   127.0.0.1 only, and in service mode only)
+//
+// ARGUMENTS       : property value (set) - 0 for no metrics endpoint
+//
+// RETURNS         : property value (get)
+//
+// ============================================================================
+void CmdRunner::setMetricsPort(int mp) { cmdRunnerData->metricsPort = mp; }
+int  CmdRunner::getMetricsPort() const { return cmdRunnerData->metricsPort; }
+
 // ============================================================================
 //
 // MEMBER FUNCTION : CmdRunner::addEnv
@@ -864,12 +1230,12 @@ void CmdRunner::addEnv
 	CHECK_GOOD_STRING("addEnv",nm)
 	CHECK_GOOD_STRING("addEnv",val)
 
-	// copy value
-	char *tmp_val = 0;
-	cmdRunnerData->stringSubstituter.stringCopy(tmp_val,val);
+	// add it to the substitution context (its value may refer to variables
+	// which have not been set yet - they are resolved again when we start)
+	cmdRunnerData->substitutionContext.set(nm,val);
 
 	// perform substitution on environment value
-	cmdRunnerData->stringSubstituter.stringSubstitute(tmp_val);
+	const char *tmp_val = cmdRunnerData->substitutionContext.lookup(nm);
 	LOGGER_LOG_DEBUG1("value after substitution is '%s')",tmp_val)
 
 	// log an informational message
@@ -878,6 +1244,88 @@ void CmdRunner::addEnv
 	SetEnvironmentVariable(nm,tmp_val);
 }
 
+// ============================================================================
+//
+// MEMBER FUNCTION : CmdRunner::removeEnv
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : discard an environment variable which has been set, so
+//                   that it has its original value again (or is not set)
+//
+// ARGUMENTS       : nm IN environment variable name
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+void CmdRunner::removeEnv
+(
+	const char *nm
+) throw (SrvStartException)
+{
+	LOGGER_LOG_DEBUG1("CmdRunner::removeEnv('%s')",nm)
+
+	// check input parameters
+	CHECK_GOOD_STRING("removeEnv",nm)
+
+	// remove it from the substitution context
+	cmdRunnerData->substitutionContext.unset(nm);
+
+	// and put back (or delete) the environment variable
+	const char *tmp_val = cmdRunnerData->substitutionContext.lookup(nm);
+	if(tmp_val==0)
+	{
+		LOGGER_LOG_INFO1("UNSET %s",nm)
+	}
+	else
+	{
+		LOGGER_LOG_INFO2("SET %s=%s",nm,tmp_val)
+	}
+	SetEnvironmentVariable(nm,tmp_val);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : CmdRunner::setReloadCallback
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : set the function which checks for (and applies) a new
+//                   configuration while the service is running
+//
+// ARGUMENTS       : reloadFunction IN function to call (NULL for none)
+//                   genericPointer IN generic pointer passed to the function
+//
+// ============================================================================
+void CmdRunner::setReloadCallback
+(
+	RELOAD_FUNCTION *reloadFunction,
+	void            *genericPointer
+)
+{
+	cmdRunnerData->reloadFunction = reloadFunction;
+	cmdRunnerData->reloadPointer  = genericPointer;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : CmdRunner::isReloadRequested
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : is the reload function being called because a reload has
+//                   been asked for (by an SCM PARAMCHANGE, or a reload request
+//                   through the control endpoint)?  If so, the configuration
+//                   should be read again even if it does not look changed.
+//
+// RETURNS         : true if it is
+//
+// ============================================================================
+bool CmdRunner::isReloadRequested() const
+{
+	return cmdRunnerData->reloadForced;
+}
+
 // ============================================================================
 //
 // MEMBER FUNCTION : CmdRunner::setStartMinimised
@@ -956,6 +1404,331 @@ void CmdRunner::stopCallbackFunction
 	}
 }
 
+// ============================================================================
+//
+// MEMBER FUNCTION : CmdRunner::controlCallbackFunction
+//
+// ACCESS SPECIFIER: private static
+//
+// DESCRIPTION     : this function is called by the ControlEndpoint (from
+//                   watchCommand(), so on the service's own thread) for each
+//                   request it receives:
+//
+//                      status           service state, pid, uptimes, restarts
+//                      pid              process id of the command
+//                      uptime           seconds since the service started
+//                      restarts         number of times the command has been
+//                                       restarted
+//                      sample           resource usage of the command
+//                      metrics          where the metrics are served
+//                      stop             stop the service
+//                      restart          restart the command
+//                      reload           pick up a changed configuration file
+//                      log <command>    a logger control command (eg "log debug 3")
+//                      help             list the requests
+//
+//                   Actions which need the command to be stopped are left for
+//                   watchCommand() to take.
+//
+// ARGUMENTS       : request    IN  request line
+//                   reply      OUT reply text
+//                   replySize  IN  size of reply
+//                   thisObject IN  this CmdRunner
+//
+// RETURNS         : true if the request has succeeded
+//
+// ============================================================================
+bool CmdRunner::controlCallbackFunction
+(
+	const char *request,
+	char       *reply,
+	int         replySize,
+	void       *thisObject
+)
+{
+	CmdRunner     *cmdRunner = static_cast<CmdRunner*>(thisObject);
+	CmdRunnerData *d         = cmdRunner->cmdRunnerData;
+	char           verb[32];
+	int            verbLength;
+	const char    *argument;
+	ULONGLONG      now = Clock::getTicks();
+
+	LOGGER_LOG_DEBUG1("CmdRunner::controlCallbackFunction('%s')",request)
+
+	// split the request into its verb and argument
+	request   += strspn(request," \t");
+	verbLength = strcspn(request," \t");
+	argument   = request+verbLength;
+	argument  += strspn(argument," \t");
+	if(verbLength>=(int)sizeof(verb)) { verbLength = sizeof(verb)-1; }
+	memcpy(verb,request,verbLength);
+	verb[verbLength] = '\0';
+
+	// the command is running while the service is
+	ScmConnector::SCM_STATUSES scmStatus = d->scmConnector->getScmStatus();
+	bool running = (scmStatus==ScmConnector::STATUS_RUNNING)||(scmStatus==ScmConnector::STATUS_PAUSED);
+
+	if(_stricmp(verb,"status")==0)
+	{
+		snprintf(reply,replySize,"service=%s state=%s pid=%lu uptime=%llu command_uptime=%llu restarts=%d",
+			d->srvName,getStatusName(scmStatus),d->dwProcessId,(now-d->serviceStartTicks)/1000,
+			(now-d->commandStartTicks)/1000,d->restartCount);
+		return true;
+	}
+
+	if(_stricmp(verb,"pid")==0)
+	{
+		snprintf(reply,replySize,"%lu",d->dwProcessId);
+		return true;
+	}
+
+	if(_stricmp(verb,"uptime")==0)
+	{
+		snprintf(reply,replySize,"%llu",(now-d->serviceStartTicks)/1000);
+		return true;
+	}
+
+	if(_stricmp(verb,"restarts")==0)
+	{
+		snprintf(reply,replySize,"%d",d->restartCount);
+		return true;
+	}
+
+	if(_stricmp(verb,"sample")==0)
+	{
+		PROCESS_SAMPLE sample;
+		if(!sampleProcess(d->hCommandProcess,&sample))
+		{
+			snprintf(reply,replySize,"unable to sample process %lu, error=%d",d->dwProcessId,GetLastError());
+			return false;
+		}
+		snprintf(reply,replySize,
+			"pid=%lu user_ms=%llu kernel_ms=%llu working_set=%llu peak_working_set=%llu "
+			"pagefile=%llu handles=%lu read_bytes=%llu write_bytes=%llu",
+			d->dwProcessId,sample.userMilliseconds,sample.kernelMilliseconds,
+			sample.workingSet,sample.peakWorkingSet,sample.pagefile,sample.handles,
+			sample.readBytes,sample.writeBytes);
+		return true;
+	}
+
+	if(_stricmp(verb,"metrics")==0)
+	{
+		if(!d->metricsEndpoint.isOpen()) { snprintf(reply,replySize,"no metrics endpoint"); return false; }
+		snprintf(reply,replySize,"http://127.0.0.1:%d/metrics",d->metricsPort);
+		return true;
+	}
+
+	if(_stricmp(verb,"stop")==0)
+	{
+		if(!running) { snprintf(reply,replySize,"service is not running"); return false; }
+		d->controlAction = CONTROL_STOP;
+		d->controlEndpoint.interrupt();
+		snprintf(reply,replySize,"stopping");
+		return true;
+	}
+
+	if(_stricmp(verb,"restart")==0)
+	{
+		if(!running) { snprintf(reply,replySize,"service is not running"); return false; }
+		d->controlAction = CONTROL_RESTART;
+		d->controlEndpoint.interrupt();
+		snprintf(reply,replySize,"restarting");
+		return true;
+	}
+
+	if(_stricmp(verb,"reload")==0)
+	{
+		if(!running) { snprintf(reply,replySize,"service is not running"); return false; }
+		if(d->reloadFunction==0) { snprintf(reply,replySize,"no configuration file to reload"); return false; }
+		d->reloadForced = true;
+		RELOAD_ACTIONS reloadAction = (*d->reloadFunction)(cmdRunner,false,d->reloadPointer);
+		d->reloadForced = false;
+		switch(reloadAction)
+		{
+			case RELOAD_NOTHING:
+				snprintf(reply,replySize,"configuration unchanged");
+				break;
+			case RELOAD_APPLIED:
+				snprintf(reply,replySize,"configuration changes applied");
+				break;
+			case RELOAD_RESTART:
+				d->controlAction = CONTROL_RELOAD_RESTART;
+				d->controlEndpoint.interrupt();
+				snprintf(reply,replySize,"restarting with the new configuration");
+				break;
+		}
+		return true;
+	}
+
+	if(_stricmp(verb,"log")==0)
+	{
+		char command[ControlEndpoint::MAX_MESSAGE];
+		strncpy(command,argument,sizeof(command)-1);
+		command[sizeof(command)-1] = '\0';
+		return LoggerControl(command,reply,replySize)!=0;
+	}
+
+	if(_stricmp(verb,"help")==0)
+	{
+		snprintf(reply,replySize,"status pid uptime restarts sample metrics stop restart reload log <command> help");
+		return true;
+	}
+
+	snprintf(reply,replySize,"unknown request '%s' (try 'help')",verb);
+	return false;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : CmdRunner::metricsRenderFunction
+//
+// ACCESS SPECIFIER: private static
+//
+// DESCRIPTION     : this function is called by the MetricsEndpoint (on its own
+//                   thread) for each scrape, and renders the service's metrics
+//                   in the Prometheus text format:  its state and uptimes,
+//                   restarts by cause, time-to-ready and stop durations, the
+//                   results of the wait command (the startup probe), the
+//                   logger's drop and queue counters, and a resource sample of
+//                   the command.
+//
+//                   It reads only the metrics themselves (which are safe to
+//                   read from any thread), and opens the command process by
+//                   its id rather than use the handle the service thread owns.
+//
+// ARGUMENTS       : text       OUT metrics text
+//                   textSize   IN  size of text
+//                   thisObject IN  this CmdRunner
+//
+// RETURNS         : length of text
+//
+// ============================================================================
+int CmdRunner::metricsRenderFunction
+(
+	char *text,
+	int   textSize,
+	void *thisObject
+)
+{
+	CmdRunner     *cmdRunner = static_cast<CmdRunner*>(thisObject);
+	CmdRunnerData *d         = cmdRunner->cmdRunnerData;
+	ULONGLONG      now       = Clock::getTicks();
+	char           service[256];
+	char           labels[300];
+	int            length = 0;
+	int            i;
+
+	Metrics::escapeLabel(service,sizeof(service),d->srvName);
+	snprintf(labels,sizeof(labels),"service=\"%s\"",service);
+
+	// state
+	ScmConnector::SCM_STATUSES scmStatus = d->scmConnector->getScmStatus();
+	length = Metrics::appendHeader(text,textSize,length,"srvstart_service_state","gauge",
+		"Service state (1 for the current state).");
+	for(i=0;i<(int)(sizeof(METRICS_STATUSES)/sizeof(METRICS_STATUSES[0]));i++)
+	{
+		length = Metrics::append(text,textSize,length,"srvstart_service_state{%s,state=\"%s\"} %d\n",
+			labels,getStatusName(METRICS_STATUSES[i]),(scmStatus==METRICS_STATUSES[i] ? 1 : 0));
+	}
+
+	// uptimes
+	long long serviceStart = d->metricsServiceStart.get();
+	long long commandStart = d->metricsCommandStart.get();
+	length = Metrics::appendHeader(text,textSize,length,"srvstart_service_uptime_seconds","gauge",
+		"Seconds since the service started.");
+	length = Metrics::append(text,textSize,length,"srvstart_service_uptime_seconds{%s} %.3f\n",
+		labels,(serviceStart==0 ? 0.0 : (now-serviceStart)/1000.0));
+	length = Metrics::appendHeader(text,textSize,length,"srvstart_command_uptime_seconds","gauge",
+		"Seconds since the command was last started.");
+	length = Metrics::append(text,textSize,length,"srvstart_command_uptime_seconds{%s} %.3f\n",
+		labels,(commandStart==0 ? 0.0 : (now-commandStart)/1000.0));
+
+	// restarts
+	length = Metrics::appendHeader(text,textSize,length,"srvstart_restarts_total","counter",
+		"Restarts of the command, by cause.");
+	for(i=0;i<RESTART_CAUSE_COUNT;i++)
+	{
+		length = Metrics::append(text,textSize,length,"srvstart_restarts_total{%s,cause=\"%s\"} %llu\n",
+			labels,RESTART_CAUSE_NAMES[i],d->metricsRestarts[i].get());
+	}
+
+	// durations
+	length = Metrics::appendHeader(text,textSize,length,"srvstart_time_to_ready_seconds","histogram",
+		"Time from starting the command to reporting it running.");
+	length = d->metricsTimeToReady.render(text,textSize,length,"srvstart_time_to_ready_seconds",labels);
+	length = Metrics::appendHeader(text,textSize,length,"srvstart_stop_duration_seconds","histogram",
+		"Time taken to stop the command.");
+	length = d->metricsStopDuration.render(text,textSize,length,"srvstart_stop_duration_seconds",labels);
+
+	// startup probe (the wait command)
+	length = Metrics::appendHeader(text,textSize,length,"srvstart_probes_total","counter",
+		"Runs of the wait command, by result.");
+	length = Metrics::append(text,textSize,length,
+		"srvstart_probes_total{%s,result=\"success\"} %llu\n"
+		"srvstart_probes_total{%s,result=\"failure\"} %llu\n",
+		labels,d->metricsProbeSuccesses.get(),labels,d->metricsProbeFailures.get());
+	length = Metrics::appendHeader(text,textSize,length,"srvstart_probe_last_success","gauge",
+		"1 if the last wait command succeeded, 0 if it failed, -1 if none has run.");
+	length = Metrics::append(text,textSize,length,"srvstart_probe_last_success{%s} %lld\n",
+		labels,d->metricsProbeLastResult.get());
+
+	// logger
+	unsigned long sent, queued, dropped;
+	length = Metrics::appendHeader(text,textSize,length,"srvstart_logger_rate_dropped_total","counter",
+		"Log messages dropped by the rate limits.");
+	length = Metrics::append(text,textSize,length,"srvstart_logger_rate_dropped_total{%s} %lu\n",
+		labels,LoggerGetRateDropped());
+	if(LoggerGetSyslogCounters(LOGGER_DEFAULT_LOGGER,&sent,&queued,&dropped))
+	{
+		length = Metrics::appendHeader(text,textSize,length,"srvstart_logger_syslog_sent_total","counter",
+			"Log messages sent to syslog.");
+		length = Metrics::append(text,textSize,length,"srvstart_logger_syslog_sent_total{%s} %lu\n",labels,sent);
+		length = Metrics::appendHeader(text,textSize,length,"srvstart_logger_syslog_queued","gauge",
+			"Log messages waiting to be sent to syslog.");
+		length = Metrics::append(text,textSize,length,"srvstart_logger_syslog_queued{%s} %lu\n",labels,queued);
+		length = Metrics::appendHeader(text,textSize,length,"srvstart_logger_syslog_dropped_total","counter",
+			"Log messages dropped because the syslog queue was full or the socket failed.");
+		length = Metrics::append(text,textSize,length,"srvstart_logger_syslog_dropped_total{%s} %lu\n",labels,dropped);
+	}
+
+	// command resources
+	DWORD  processId = (DWORD)d->metricsProcessId.get();
+	HANDLE hProcess  = (processId==0 ? NULL :
+		OpenProcess(PROCESS_QUERY_INFORMATION|PROCESS_VM_READ,FALSE,processId));
+	if(hProcess!=NULL)
+	{
+		PROCESS_SAMPLE sample;
+		if(sampleProcess(hProcess,&sample))
+		{
+			length = Metrics::appendHeader(text,textSize,length,"srvstart_command_cpu_seconds_total","counter",
+				"CPU time used by the command, by mode.");
+			length = Metrics::append(text,textSize,length,
+				"srvstart_command_cpu_seconds_total{%s,mode=\"user\"} %.3f\n"
+				"srvstart_command_cpu_seconds_total{%s,mode=\"kernel\"} %.3f\n",
+				labels,sample.userMilliseconds/1000.0,labels,sample.kernelMilliseconds/1000.0);
+			length = Metrics::appendHeader(text,textSize,length,"srvstart_command_memory_bytes","gauge",
+				"Memory used by the command, by kind.");
+			length = Metrics::append(text,textSize,length,
+				"srvstart_command_memory_bytes{%s,kind=\"working_set\"} %llu\n"
+				"srvstart_command_memory_bytes{%s,kind=\"peak_working_set\"} %llu\n"
+				"srvstart_command_memory_bytes{%s,kind=\"pagefile\"} %llu\n",
+				labels,sample.workingSet,labels,sample.peakWorkingSet,labels,sample.pagefile);
+			length = Metrics::appendHeader(text,textSize,length,"srvstart_command_handles","gauge",
+				"Handles held by the command.");
+			length = Metrics::append(text,textSize,length,"srvstart_command_handles{%s} %lu\n",labels,sample.handles);
+			length = Metrics::appendHeader(text,textSize,length,"srvstart_command_io_bytes_total","counter",
+				"Bytes read and written by the command.");
+			length = Metrics::append(text,textSize,length,
+				"srvstart_command_io_bytes_total{%s,direction=\"read\"} %llu\n"
+				"srvstart_command_io_bytes_total{%s,direction=\"write\"} %llu\n",
+				labels,sample.readBytes,labels,sample.writeBytes);
+		}
+		CloseHandle(hProcess);
+	}
+
+	return length;
+}
+
 // ============================================================================
 //
 // PRIVATE MEMBER FUNCTIONS
@@ -1023,8 +1796,9 @@ void CmdRunner::startCommand() throw (SrvStartException)
 	}
 
 	// start the process
-	createProcess(cmdRunnerData->startupCommand,false,cmdRunnerData->hCommandProcess,
-						&(cmdRunnerData->dwProcessId),0,cmdRunnerData->startupDirectory,
+	createProcess(cmdRunnerData->substStartupCommand,false,cmdRunnerData->hCommandProcess,
+						&(cmdRunnerData->dwProcessId),cmdRunnerData->environmentBlock,
+						cmdRunnerData->substStartupDirectory,
 						creationFlags,&startupInfo,cmdRunnerData->waitInterval);
 
 	// return
@@ -1048,18 +1822,27 @@ void CmdRunner::waitForStartup() throw (SrvStartException)
 	LOGGER_LOG_DEBUG("CmdRunner::waitForStartup()")
 
 	// what are we waiting for?
-	if(cmdRunnerData->waitCommand[0] != '\0')
+	if(cmdRunnerData->substWaitCommand[0] != '\0')
 	{
 		// start wait command and wait for it to complete
 		LOGGER_LOG_INFO3(
 "%s is waiting for command '%s' to complete before reporting a 'running' status to the SCM for service '%s'",
-			getApplication(),cmdRunnerData->waitCommand,cmdRunnerData->srvName)
+			getApplication(),cmdRunnerData->substWaitCommand,cmdRunnerData->srvName)
 
 		// run wait command and wait for it to complete
+		// (its result is counted as that of the startup probe)
 		HANDLE hWaitProcess;
-		createProcess(cmdRunnerData->waitCommand,true,hWaitProcess);
+		try { createProcess(cmdRunnerData->substWaitCommand,true,hWaitProcess,0,cmdRunnerData->environmentBlock); }
+		catch(...)
+		{
+			cmdRunnerData->metricsProbeFailures.increment();
+			cmdRunnerData->metricsProbeLastResult.set(0);
+			throw;
+		}
+		cmdRunnerData->metricsProbeSuccesses.increment();
+		cmdRunnerData->metricsProbeLastResult.set(1);
 		LOGGER_LOG_INFO2("wait command '%s' has now completed for service '%s'",
-					cmdRunnerData->waitCommand,cmdRunnerData->srvName)
+					cmdRunnerData->substWaitCommand,cmdRunnerData->srvName)
 		SS_RETURNV("CmdRunner::waitForStartup")
 	}
 	else
@@ -1091,11 +1874,17 @@ void CmdRunner::waitForStartup() throw (SrvStartException)
 // ACCESS SPECIFIER: private
 //
 // DESCRIPTION     : watch command until it completes (it finishes on its own
-//                   or a STOP request is received)
+//                   or a STOP request is received), or until it has been
+//                   stopped because a configuration change needs a restart or
+//                   a restart has been requested through the control endpoint
+//
+//                   Control requests are served while waiting.
 //
 // RETURNS         : one of:
 //                      WATCH_COMMAND_COMPLETED
 //                      WATCH_COMMAND_WAS_STOPPED
+//                      WATCH_COMMAND_RELOADED
+//                      WATCH_COMMAND_RESTARTED
 //                      WATCH_ERROR
 //
 // THROWS          : SrvStartException
@@ -1108,8 +1897,16 @@ CmdRunner::WATCH_OUTCOMES CmdRunner::watchCommand() throw (SrvStartException)
 	// wait for command to complete
 	while(true)
 	{
-		// sleep
-		Sleeper::Sleep(cmdRunnerData->waitInterval,"process to complete");
+		// sleep (serving control requests meanwhile)
+		if(cmdRunnerData->controlEndpoint.isOpen())
+		{
+			cmdRunnerData->controlEndpoint.serve(cmdRunnerData->waitInterval*1000);
+		}
+		else
+		{
+			Sleeper::Sleep(cmdRunnerData->waitInterval,"process to complete");
+		}
+		cmdRunnerData->publishStatus();
 
 		// get the current status of the command
 		switch(getProcessStatus(cmdRunnerData->hCommandProcess))
@@ -1132,6 +1929,64 @@ CmdRunner::WATCH_OUTCOMES CmdRunner::watchCommand() throw (SrvStartException)
 				break;
 		}
 
+		// process is still running - has an action been requested through the control endpoint?
+		CONTROL_ACTIONS controlAction = cmdRunnerData->controlAction;
+		cmdRunnerData->controlAction = CONTROL_NONE;
+		switch(controlAction)
+		{
+			case CONTROL_STOP:
+				// just as if the SCM had asked
+				LOGGER_LOG_INFO1("service '%s' is stopping on request",cmdRunnerData->srvName)
+				stopCallbackVar = true;
+				break;
+
+			case CONTROL_RESTART:
+				LOGGER_LOG_DEBUG("watchCommand: restart requested")
+				killCommand(false);
+				SS_RETURN("watchCommand",WATCH_COMMAND_RESTARTED);
+				break;
+
+			case CONTROL_RELOAD_RESTART:
+				LOGGER_LOG_DEBUG("watchCommand: reload requested, and it needs a restart")
+				killCommand(false);
+				(void)(*cmdRunnerData->reloadFunction)(this,true,cmdRunnerData->reloadPointer);
+				SS_RETURN("watchCommand",WATCH_COMMAND_RELOADED);
+				break;
+		}
+
+		// process is still running - has the SCM asked for it to be paused or continued?
+		switch(InterlockedExchange(&cmdRunnerData->pauseRequest,PAUSE_REQUEST_NONE))
+		{
+			case PAUSE_REQUEST_PAUSE:
+				pauseCommand(true);
+				break;
+
+			case PAUSE_REQUEST_CONTINUE:
+				pauseCommand(false);
+				break;
+		}
+
+		// process is still running - has the configuration changed?  (or has the
+		//  SCM said that it has?)
+		if((cmdRunnerData->reloadFunction!=0)&&(cmdRunnerData->startMode==SERVICE_MODE)&&(!stopCallbackVar))
+		{
+			cmdRunnerData->reloadForced = (InterlockedExchange(&cmdRunnerData->paramChanged,0)!=0);
+			if(cmdRunnerData->reloadForced)
+			{
+				LOGGER_LOG_INFO1("service '%s' has been asked to reload its configuration",cmdRunnerData->srvName)
+			}
+			RELOAD_ACTIONS reloadAction = (*cmdRunnerData->reloadFunction)(this,false,cmdRunnerData->reloadPointer);
+			cmdRunnerData->reloadForced = false;
+			if(reloadAction==RELOAD_RESTART)
+			{
+				// stop the command with its old settings, then apply the new ones
+				LOGGER_LOG_DEBUG("watchCommand: configuration change needs a restart")
+				killCommand(false);
+				(void)(*cmdRunnerData->reloadFunction)(this,true,cmdRunnerData->reloadPointer);
+				SS_RETURN("watchCommand",WATCH_COMMAND_RELOADED);
+			}
+		}
+
 		// process is still running - has a stop callback been invoked?
 		if(stopCallbackVar)
 		{
@@ -1172,27 +2027,61 @@ CmdRunner::WATCH_OUTCOMES CmdRunner::watchCommand() throw (SrvStartException)
 //
 // DESCRIPTION     : stop the running command (service mode only)
 //
+// ARGUMENTS       : stopping IN false if the command is only being restarted
+//                               (the SCM is not told that the service is stopping)
+//
 // THROWS          : SrvStartException
 //
 // ============================================================================
-void CmdRunner::killCommand() throw (SrvStartException)
+void CmdRunner::killCommand
+(
+	bool stopping
+) throw (SrvStartException)
 {
-	LOGGER_LOG_DEBUG("CmdRunner::killCommand()")
+	LOGGER_LOG_DEBUG1("CmdRunner::killCommand(%d)",stopping)
+
+	ULONGLONG stoppingTicks = Clock::getTicks();
 
 	// notify the SCM that the service is stopping
-	cmdRunnerData->scmConnector->notifyScmStatus(ScmConnector::STATUS_STOPPING);
+	if(stopping)
+	{
+		cmdRunnerData->scmConnector->notifyScmStatus(ScmConnector::STATUS_STOPPING);
+	}
+
+	// a paused command must be running again to shut itself down
+	if(cmdRunnerData->paused)
+	{
+		LOGGER_LOG_DEBUG("continuing paused process before shutting it down")
+		if(cmdRunnerData->pauseMethod==PAUSE_BY_COMMAND)
+		{
+			try
+			{
+				HANDLE hContinueProcess;
+				createProcess(cmdRunnerData->substContinueCommand,true,hContinueProcess,0,cmdRunnerData->environmentBlock);
+			}
+			catch(...)
+			{
+				LOGGER_LOG_ERROR1("failed to run continue command '%s'",cmdRunnerData->substContinueCommand)
+			}
+		}
+		else
+		{
+			(void)suspendProcess(cmdRunnerData->dwProcessId,false);
+		}
+		cmdRunnerData->paused = false;
+	}
 
 	// is the shutdown method 'command'?
 	if(cmdRunnerData->shutdownMethod==SHUTDOWN_BY_COMMAND)
 	{
 		// is there a shutdown command?
-		if(cmdRunnerData->shutdownCommand[0] != '\0')
+		if((cmdRunnerData->substShutdownCommand!=0)&&(cmdRunnerData->substShutdownCommand[0] != '\0'))
 		{
-			LOGGER_LOG_DEBUG1("using '%s' to shut down process",cmdRunnerData->shutdownCommand)
+			LOGGER_LOG_DEBUG1("using '%s' to shut down process",cmdRunnerData->substShutdownCommand)
 
 			// run the shutdown command for this process and wait for it to complete
 			HANDLE hStopProcess;
-			createProcess(cmdRunnerData->shutdownCommand,true,hStopProcess);
+			createProcess(cmdRunnerData->substShutdownCommand,true,hStopProcess,0,cmdRunnerData->environmentBlock);
 		}
 		else
 		{
@@ -1235,18 +2124,100 @@ void CmdRunner::killCommand() throw (SrvStartException)
 	{
 		// sleep one second
 		Sleeper::Sleep(1,"process to complete");
-		if(((++shutdownCount)|60)==0)
+		if(((++shutdownCount)%60)==0)
 		{
 			// log a warning message
 			LOGGER_LOG_INFO2("WARNING: service '%s' has been shutting down for %d minutes",
 								cmdRunnerData->srvName,shutdownCount/60)
 		}
 	}
+	cmdRunnerData->metricsStopDuration.observe((unsigned long)(Clock::getTicks()-stoppingTicks));
 
 	// return
 	SS_RETURNV("CmdRunner::killCommand")
 }
 
+// ============================================================================
+//
+// MEMBER FUNCTION : CmdRunner::pauseCommand
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : pause or continue the running command (service mode only),
+//                   as the SCM has asked, and tell the SCM when it is done
+//
+//                   The command is paused by suspending all of its threads, or
+//                   by running the pause command (and continued by resuming
+//                   them, or by running the continue command).  If the command
+//                   cannot be paused, the SCM is told it is still running.
+//
+// ARGUMENTS       : pausing IN true to pause, false to continue
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+void CmdRunner::pauseCommand
+(
+	bool pausing
+) throw (SrvStartException)
+{
+	LOGGER_LOG_DEBUG1("CmdRunner::pauseCommand(%d)",pausing)
+
+	// pausing by command needs both commands
+	if((cmdRunnerData->pauseMethod==PAUSE_BY_COMMAND)&&(pausing)
+		&&((cmdRunnerData->substPauseCommand[0]=='\0')||(cmdRunnerData->substContinueCommand[0]=='\0')))
+	{
+		LOGGER_LOG_INFO("Pause method of 'command' was specified, but there is no pause or continue command.  Will use 'suspend' instead.")
+		cmdRunnerData->pauseMethod = PAUSE_BY_SUSPEND;
+	}
+
+	bool done = false;
+	if(pausing==cmdRunnerData->paused)
+	{
+		// nothing to do
+		done = true;
+	}
+	else if(cmdRunnerData->pauseMethod==PAUSE_BY_COMMAND)
+	{
+		char *command = pausing ? cmdRunnerData->substPauseCommand : cmdRunnerData->substContinueCommand;
+		LOGGER_LOG_DEBUG2("using '%s' to %s process",command,(pausing ? "pause" : "continue"))
+		try
+		{
+			HANDLE hPauseProcess;
+			createProcess(command,true,hPauseProcess,0,cmdRunnerData->environmentBlock);
+			done = true;
+		}
+		catch(...)
+		{
+			LOGGER_LOG_ERROR1("failed to run command '%s'",command)
+		}
+	}
+	else if(cmdRunnerData->pauseMethod==PAUSE_BY_SUSPEND)
+	{
+		LOGGER_LOG_DEBUG1("%s the threads of the process",(pausing ? "suspending" : "resuming"))
+		done = suspendProcess(cmdRunnerData->dwProcessId,pausing);
+	}
+
+	if(done)
+	{
+		cmdRunnerData->paused = pausing;
+		LOGGER_LOG_INFO2("service '%s' has been %s",cmdRunnerData->srvName,(pausing ? "paused" : "continued"))
+	}
+	else
+	{
+		LOGGER_LOG_ERROR2("failed to %s service '%s'",(pausing ? "pause" : "continue"),cmdRunnerData->srvName)
+	}
+
+	// tell the SCM (unless it has asked for the service to stop meanwhile)
+	if(!stopCallbackVar)
+	{
+		cmdRunnerData->scmConnector->notifyScmStatus(
+			cmdRunnerData->paused ? ScmConnector::STATUS_PAUSED : ScmConnector::STATUS_RUNNING);
+	}
+
+	SS_RETURNV("CmdRunner::pauseCommand")
+}
+
 // ============================================================================
 //
 // LOCAL UTILITY FUNCTIONS
@@ -1489,3 +2460,166 @@ BOOL CALLBACK sendCloseMessage
 	return TRUE ;
 
 }
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : suspendProcess
+//
+// DESCRIPTION     : suspend or resume every thread of a process (Win32 has no
+//                   equivalent of SIGSTOP and SIGCONT for a whole process)
+//
+//                   Only the process itself is paused, not any processes it
+//                   has started.
+//
+// ARGUMENTS       : processId IN process id
+//                   suspend   IN true to suspend, false to resume
+//
+// RETURNS         : true if every thread has been suspended or resumed
+//
+// ============================================================================
+bool suspendProcess
+(
+	DWORD processId,
+	bool  suspend
+)
+{
+	HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD,0);
+	if(hSnapshot==INVALID_HANDLE_VALUE)
+	{
+		LOGGER_LOG_ERROR1("suspendProcess: failed to list threads, error=%d",GetLastError())
+		return false;
+	}
+
+	bool          ok = true;
+	int           threadCount = 0;
+	THREADENTRY32 threadEntry;
+	threadEntry.dwSize = sizeof(threadEntry);
+	for(BOOL more=Thread32First(hSnapshot,&threadEntry); more; more=Thread32Next(hSnapshot,&threadEntry))
+	{
+		if(threadEntry.th32OwnerProcessID!=processId) { continue; }
+
+		HANDLE hThread = OpenThread(THREAD_SUSPEND_RESUME,FALSE,threadEntry.th32ThreadID);
+		if((hThread==NULL)
+			||((suspend ? SuspendThread(hThread) : ResumeThread(hThread))==(DWORD)-1))
+		{
+			LOGGER_LOG_ERROR2("suspendProcess: failed for thread %lu, error=%d",threadEntry.th32ThreadID,GetLastError())
+			ok = false;
+		}
+		if(hThread!=NULL) { CloseHandle(hThread); }
+		threadCount++;
+	}
+	CloseHandle(hSnapshot);
+
+	LOGGER_LOG_DEBUG3("suspendProcess(%lu,%d): %d threads",processId,suspend,threadCount)
+	return ok&&(threadCount>0);
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : scmControlFunction
+//
+// DESCRIPTION     : this function is called by the ScmConnector (on the SCM's
+//                   thread) for the PAUSE, CONTINUE and PARAMCHANGE controls.
+//                   It only notes the request:  watchCommand() acts on it.
+//
+// ARGUMENTS       : control        IN control
+//                   genericPointer IN the CmdRunnerData
+//
+// ============================================================================
+void scmControlFunction
+(
+	ScmConnector::SCM_CONTROLS control,
+	void                      *genericPointer
+)
+{
+	CmdRunnerData *d = static_cast<CmdRunnerData*>(genericPointer);
+
+	LOGGER_LOG_DEBUG1("scmControlFunction(%d)",control)
+
+	switch(control)
+	{
+		case ScmConnector::CONTROL_PAUSE:
+			InterlockedExchange(&d->pauseRequest,PAUSE_REQUEST_PAUSE);
+			break;
+
+		case ScmConnector::CONTROL_CONTINUE:
+			InterlockedExchange(&d->pauseRequest,PAUSE_REQUEST_CONTINUE);
+			break;
+
+		case ScmConnector::CONTROL_PARAMCHANGE:
+			InterlockedExchange(&d->paramChanged,1);
+			break;
+	}
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : getStatusName
+//
+// DESCRIPTION     : name of an SCM status (as reported by srvctl and the metrics)
+//
+// ARGUMENTS       : scmStatus IN status
+//
+// RETURNS         : name
+//
+// ============================================================================
+static const char *getStatusName
+(
+	ScmConnector::SCM_STATUSES scmStatus
+)
+{
+	switch(scmStatus)
+	{
+		case ScmConnector::STATUS_INITIALISING: return "initialising";
+		case ScmConnector::STATUS_STARTING:     return "starting";
+		case ScmConnector::STATUS_RUNNING:      return "running";
+		case ScmConnector::STATUS_STOPPING:     return "stopping";
+		case ScmConnector::STATUS_STOPPED:      return "stopped";
+		case ScmConnector::STATUS_PAUSING:      return "pausing";
+		case ScmConnector::STATUS_PAUSED:       return "paused";
+		case ScmConnector::STATUS_CONTINUING:   return "continuing";
+		default:                                return "unknown";
+	}
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : sampleProcess
+//
+// DESCRIPTION     : sample the resource usage of a process (for srvctl sample,
+//                   the metrics and the status board)
+//
+// ARGUMENTS       : hProcess IN  process handle
+//                   sample   OUT resource usage
+//
+// RETURNS         : true on success (GetLastError() says why not)
+//
+// ============================================================================
+static bool sampleProcess
+(
+	HANDLE          hProcess,
+	PROCESS_SAMPLE *sample
+)
+{
+	FILETIME                creationTime, exitTime, kernelTime, userTime;
+	PROCESS_MEMORY_COUNTERS memoryCounters;
+	IO_COUNTERS             ioCounters;
+
+	if((!GetProcessTimes(hProcess,&creationTime,&exitTime,&kernelTime,&userTime))
+		||(!GetProcessMemoryInfo(hProcess,&memoryCounters,sizeof(memoryCounters)))
+		||(!GetProcessIoCounters(hProcess,&ioCounters))
+		||(!GetProcessHandleCount(hProcess,&sample->handles)))
+	{
+		return false;
+	}
+
+	// FILETIMEs are in 100ns units
+	sample->userMilliseconds   = ((((ULONGLONG)userTime.dwHighDateTime)<<32)|userTime.dwLowDateTime)/10000;
+	sample->kernelMilliseconds = ((((ULONGLONG)kernelTime.dwHighDateTime)<<32)|kernelTime.dwLowDateTime)/10000;
+	sample->workingSet         = memoryCounters.WorkingSetSize;
+	sample->peakWorkingSet     = memoryCounters.PeakWorkingSetSize;
+	sample->pagefile           = memoryCounters.PagefileUsage;
+	sample->readBytes          = ioCounters.ReadTransferCount;
+	sample->writeBytes         = ioCounters.WriteTransferCount;
+	return true;
+}
@@ -109,6 +109,7 @@ public:
 								INSTALL_MODE, INSTALL_DESKTOP_MODE, REMOVE_MODE };
 	typedef enum EXECUTION_PRIORITIES {HIGH_PRIORITY, IDLE_PRIORITY, NORMAL_PRIORITY, REAL_PRIORITY };
 	typedef enum SHUTDOWN_METHODS { SHUTDOWN_BY_KILL, SHUTDOWN_BY_COMMAND, SHUTDOWN_BY_WINMESSAGE };
+	typedef enum PAUSE_METHODS { PAUSE_NOT_SUPPORTED, PAUSE_BY_SUSPEND, PAUSE_BY_COMMAND };
 
 	// start
 	void start() throw (SrvStartException);
@@ -125,6 +126,16 @@ public:
 	char *getWaitCommand() const;
 	SHUTDOWN_METHODS getShutdownMethod() const;
 
+	// pause and continue (service mode only)
+	void setPauseCommand(const char *pc) throw (SrvStartException);
+	void setContinueCommand(const char *cc) throw (SrvStartException);
+	void setPauseMethod(const PAUSE_METHODS pm);
+	void setPreshutdownTimeout(int pt);
+
+	char *getPauseCommand() const;
+	char *getContinueCommand() const;
+	PAUSE_METHODS getPauseMethod() const;
+
 	// properties
 	void setDebugLevel(int dl);
 	void setWaitInterval(int wi);
@@ -140,6 +151,7 @@ public:
 
 	// environment
 	void addEnv(const char *nm,const char *val) throw (SrvStartException);
+	void removeEnv(const char *nm) throw (SrvStartException);
 
 	// start profile
 	void setStartMinimised(bool sm);
@@ -153,10 +165,26 @@ public:
 	bool getAutoRestart() const;
 	int  getAutoRestartInterval() const;
 
+	// metrics endpoint (service mode only) - 0 for none
+	void setMetricsPort(int mp);
+	int  getMetricsPort() const;
+
 	// drive mappings
 	void mapLocalDrive(const char driveLetter,const char *drivePath) throw (SrvStartException);
 	void mapNetworkDrive(const char driveLetter,const char *networkPath) throw (SrvStartException);
 
+	// configuration reload (service mode only) - the function is called while
+	//  the service is running with restarting false, and returns RELOAD_RESTART
+	//  if the command must be restarted;  it is then called again with
+	//  restarting true once the command has stopped, to apply the new settings
+	typedef enum RELOAD_ACTIONS { RELOAD_NOTHING, RELOAD_APPLIED, RELOAD_RESTART };
+	typedef RELOAD_ACTIONS RELOAD_FUNCTION(CmdRunner *cmdRunner,bool restarting,void *genericPointer);
+	void setReloadCallback(RELOAD_FUNCTION *reloadFunction,void *genericPointer);
+
+	// has a reload been asked for (by the SCM or through the control
+	//  endpoint), rather than just checked for?  (for the reload function)
+	bool isReloadRequested() const;
+
 	// constructor and destructor
 	CmdRunner(START_MODES mode = COMMAND_MODE,char *nm = NULL) throw (SrvStartException);
 	virtual ~CmdRunner();
@@ -180,11 +208,21 @@ private:	// member functions: internals
 	void waitForStartup() throw (SrvStartException);
 
 	// watch command while it's running
-	typedef enum WATCH_OUTCOMES { WATCH_COMMAND_COMPLETED, WATCH_COMMAND_WAS_STOPPED };
+	typedef enum WATCH_OUTCOMES { WATCH_COMMAND_COMPLETED, WATCH_COMMAND_WAS_STOPPED,
+									WATCH_COMMAND_RELOADED, WATCH_COMMAND_RESTARTED };
 	WATCH_OUTCOMES watchCommand() throw (SrvStartException);
 
+	// handle a request made through the control endpoint (see ControlEndpoint)
+	static bool controlCallbackFunction(const char *request,char *reply,int replySize,void *thisObject);
+
+	// render the metrics for the metrics endpoint (see MetricsEndpoint)
+	static int metricsRenderFunction(char *text,int textSize,void *thisObject);
+
 	// kill the command
-	void killCommand() throw (SrvStartException);
+	void killCommand(bool stopping = true) throw (SrvStartException);
+
+	// pause or continue the command
+	void pauseCommand(bool pausing) throw (SrvStartException);
 
 private:	// data members - hidden data
 	struct CmdRunnerData *cmdRunnerData;
@@ -0,0 +1,1181 @@
+// ============================================================================
+//
+// FILE        : ControlEndpoint.cpp
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : Implementation of ControlEndpoint class
+//
+//               The endpoint keeps a fixed number of connections.  On Win32
+//               each one is an instance of the named pipe, with an overlapped
+//               connect, read or write always outstanding on it;  serve()
+//               waits on their events and moves each connection on to its
+//               next step as its I/O completes.  On POSIX the connections are
+//               non-blocking sockets accepted from the listening socket, and
+//               serve() waits for them with poll().
+//
+//               Each connection buffers the requests it has read and the
+//               replies waiting to be written, so a client may send several
+//               requests at once (blank request lines are ignored).
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// this is the "main" source file
+#define	SRVSTART_DLL
+
+// we are exporting the class
+#define	SRVSTART_DLL_EXPORT
+
+//
+// which platform are we running?
+//
+#if	defined(WIN32)
+#define	CONTROL_PLATFORM_IS_WIN32	1
+#else
+#define	CONTROL_PLATFORM_IS_WIN32	0
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// system headers
+#if	CONTROL_PLATFORM_IS_WIN32
+#define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#endif	// CONTROL_PLATFORM_IS_WIN32
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// support headers
+#include <logger.h>
+
+// class headers
+#include "SrvStart.h"
+#include "ControlEndpoint.h"
+
+// ============================================================================
+//
+// NAMESPACE DECLARATIONS
+//
+// ============================================================================
+
+using namespace SrvStart;
+
+// ============================================================================
+//
+// CONSTANT DEFINITIONS
+//
+// ============================================================================
+
+// endpoint names are <prefix><service><suffix>
+#if	CONTROL_PLATFORM_IS_WIN32
+#define	CONTROL_NAME_PREFIX		"\\\\.\\pipe\\srvstart."
+#define	CONTROL_NAME_SUFFIX		""
+#define	CONTROL_LIST_PATTERN	"\\\\.\\pipe\\*"
+#else
+#define	CONTROL_DIRECTORY		"/tmp"
+#define	CONTROL_NAME_PREFIX		CONTROL_DIRECTORY "/srvstart."
+#define	CONTROL_NAME_SUFFIX		".ctl"
+#endif	// CONTROL_PLATFORM_IS_WIN32
+
+// the part of the name which is listed by listServices()
+#define	CONTROL_LIST_PREFIX		"srvstart."
+
+// number of clients which can be connected at once
+const int CONTROL_MAX_CONNECTIONS = 8;
+
+// replies buffered for one connection
+const int CONTROL_OUTPUT_SIZE = 4*ControlEndpoint::MAX_MESSAGE;
+
+// longest endpoint name
+const int CONTROL_MAX_NAME = 260;
+
+// ============================================================================
+//
+// LOCAL CLASSES
+//
+// ============================================================================
+
+//
+// one client connection
+//
+struct ControlConnection
+{
+	// requests read, and replies waiting to be written
+	char input[ControlEndpoint::MAX_MESSAGE];
+	int  inputLength;
+	char output[CONTROL_OUTPUT_SIZE];
+	int  outputLength;
+
+	// skipping the rest of a request which was too long?
+	bool discarding;
+
+#if	CONTROL_PLATFORM_IS_WIN32
+	// pipe instance, and the overlapped operation outstanding on it
+	typedef enum CONNECTION_STATES { CONNECTION_CLOSED, CONNECTION_CONNECTING,
+										CONNECTION_READING, CONNECTION_WRITING };
+	HANDLE            pipe;
+	OVERLAPPED        overlapped;
+	CONNECTION_STATES state;
+#else
+	// socket (-1 if the connection is not in use)
+	int socket;
+#endif	// CONTROL_PLATFORM_IS_WIN32
+
+	ControlConnection()
+	{
+		inputLength  = 0;
+		outputLength = 0;
+		discarding   = false;
+#if	CONTROL_PLATFORM_IS_WIN32
+		pipe  = INVALID_HANDLE_VALUE;
+		memset(&overlapped,0,sizeof(overlapped));
+		state = CONNECTION_CLOSED;
+#else
+		socket = -1;
+#endif	// CONTROL_PLATFORM_IS_WIN32
+	} ;
+} ;
+
+//
+// ControlEndpoint data
+//
+struct ControlEndpointData
+{
+	// endpoint name (empty if not open)
+	char name[CONTROL_MAX_NAME];
+
+	// request handler
+	ControlEndpoint::CONTROL_FUNCTION *controlFunction;
+	void                              *genericPointer;
+
+	// set by interrupt() to end serve()
+	bool interrupted;
+
+	// connections (the next one to be served first, for fairness)
+	ControlConnection connections[CONTROL_MAX_CONNECTIONS];
+	int               nextConnection;
+
+#if	!CONTROL_PLATFORM_IS_WIN32
+	// listening socket
+	int listener;
+#endif	// !CONTROL_PLATFORM_IS_WIN32
+
+	ControlEndpointData()
+	{
+		name[0]         = '\0';
+		controlFunction = 0;
+		genericPointer  = 0;
+		interrupted     = false;
+		nextConnection  = 0;
+#if	!CONTROL_PLATFORM_IS_WIN32
+		listener        = -1;
+#endif	// !CONTROL_PLATFORM_IS_WIN32
+	} ;
+} ;
+
+// ============================================================================
+//
+// LOCAL FUNCTION PROTOTYPES
+//
+// ============================================================================
+
+static void processInput(ControlEndpointData *d,ControlConnection *c);
+static bool parseReply(char *received,char *reply,int replySize);
+#if	CONTROL_PLATFORM_IS_WIN32
+static void startConnect(ControlConnection *c);
+static void startRead(ControlConnection *c);
+static void startWrite(ControlConnection *c);
+static void stepConnection(ControlEndpointData *d,ControlConnection *c);
+static void closeConnection(ControlConnection *c);
+#else
+static void acceptConnections(ControlEndpointData *d);
+static void readConnection(ControlEndpointData *d,ControlConnection *c);
+static void flushConnection(ControlEndpointData *d,ControlConnection *c);
+static void closeConnection(ControlConnection *c);
+static unsigned long elapsedMilliseconds(const struct timespec *start);
+#endif	// CONTROL_PLATFORM_IS_WIN32
+
+// ============================================================================
+//
+// PUBLIC MEMBER FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ControlEndpoint::ControlEndpoint
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : constructor
+//
+// ============================================================================
+ControlEndpoint::ControlEndpoint()
+{
+	controlEndpointData = new ControlEndpointData;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ControlEndpoint::~ControlEndpoint
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : destructor
+//
+// ============================================================================
+ControlEndpoint::~ControlEndpoint()
+{
+	close();
+	delete controlEndpointData;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ControlEndpoint::open
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : open the endpoint of a service
+//
+// ARGUMENTS       : svcName         IN service name
+//                   controlFunction IN request handler
+//                   genericPointer  IN generic pointer passed to the handler
+//
+// THROWS          : SrvStartException (if the endpoint cannot be created, or
+//                   another process already has it)
+//
+// ============================================================================
+void ControlEndpoint::open
+(
+	const char       *svcName,
+	CONTROL_FUNCTION *controlFunction,
+	void             *genericPointer
+)
+throw (SrvStartException)
+{
+	ControlEndpointData *d = controlEndpointData;
+	int                  i;
+
+	LOGGER_LOG_DEBUG1("ControlEndpoint::open('%s')",svcName)
+
+	close();
+	getEndpointName(svcName,d->name,sizeof(d->name));
+	d->controlFunction = controlFunction;
+	d->genericPointer  = genericPointer;
+
+#if	CONTROL_PLATFORM_IS_WIN32
+	// create every instance of the pipe (the first one must be new)
+	for(i=0;i<CONTROL_MAX_CONNECTIONS;i++)
+	{
+		ControlConnection *c = &d->connections[i];
+		c->pipe = CreateNamedPipe(d->name,
+						PIPE_ACCESS_DUPLEX|FILE_FLAG_OVERLAPPED|(i==0 ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+						PIPE_TYPE_BYTE|PIPE_READMODE_BYTE|PIPE_WAIT|PIPE_REJECT_REMOTE_CLIENTS,
+						CONTROL_MAX_CONNECTIONS,CONTROL_OUTPUT_SIZE,MAX_MESSAGE,0,NULL);
+		c->overlapped.hEvent = CreateEvent(NULL,TRUE,TRUE,NULL);
+		if((c->pipe==INVALID_HANDLE_VALUE)||(c->overlapped.hEvent==NULL))
+		{
+			LOGGER_LOG_ERROR2("ControlEndpoint: unable to create pipe '%s', error=%d",d->name,GetLastError())
+			close();
+			THROW_SRVSTART_EXCEPTION
+				(SRVSTART_EXCEPTION_GENERAL_ERROR,"ControlEndpoint","open")
+		}
+		startConnect(c);
+	}
+#else
+	struct sockaddr_un address;
+	memset(&address,0,sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(strlen(d->name)>=sizeof(address.sun_path))
+	{
+		LOGGER_LOG_ERROR1("ControlEndpoint: socket name '%s' is too long",d->name)
+		d->name[0] = '\0';
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ControlEndpoint","open")
+	}
+	strcpy(address.sun_path,d->name);
+
+	// is another process serving it?  if not, the socket is left over - remove it
+	int probe = socket(AF_UNIX,SOCK_STREAM|SOCK_CLOEXEC,0);
+	if((probe>=0)&&(connect(probe,(struct sockaddr *)&address,sizeof(address))==0))
+	{
+		::close(probe);
+		LOGGER_LOG_ERROR1("ControlEndpoint: socket '%s' is in use by another process",d->name)
+		d->name[0] = '\0';
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_GENERAL_ERROR,"ControlEndpoint","open")
+	}
+	if(probe>=0) { ::close(probe); }
+	(void)unlink(d->name);
+
+	// listen - for this user only
+	d->listener = socket(AF_UNIX,SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK,0);
+	if((d->listener<0)
+		||(bind(d->listener,(struct sockaddr *)&address,sizeof(address))!=0)
+		||(chmod(d->name,S_IRUSR|S_IWUSR)!=0)
+		||(listen(d->listener,SOMAXCONN)!=0))
+	{
+		LOGGER_LOG_ERROR2("ControlEndpoint: unable to listen on socket '%s', error=%d",d->name,errno)
+		close();
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_GENERAL_ERROR,"ControlEndpoint","open")
+	}
+	for(i=0;i<CONTROL_MAX_CONNECTIONS;i++)
+	{
+		d->connections[i].socket = -1;
+	}
+#endif	// CONTROL_PLATFORM_IS_WIN32
+
+	LOGGER_LOG_DEBUG1("ControlEndpoint: listening on '%s'",d->name)
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ControlEndpoint::close
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : close the endpoint (connected clients are disconnected)
+//
+// ============================================================================
+void ControlEndpoint::close()
+{
+	ControlEndpointData *d = controlEndpointData;
+
+	if(d->name[0]=='\0')
+	{
+		return;
+	}
+
+	LOGGER_LOG_DEBUG1("ControlEndpoint::close('%s')",d->name)
+
+	for(int i=0;i<CONTROL_MAX_CONNECTIONS;i++)
+	{
+		closeConnection(&d->connections[i]);
+	}
+
+#if	!CONTROL_PLATFORM_IS_WIN32
+	if(d->listener>=0)
+	{
+		::close(d->listener);
+		d->listener = -1;
+		(void)unlink(d->name);
+	}
+#endif	// !CONTROL_PLATFORM_IS_WIN32
+
+	d->name[0] = '\0';
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ControlEndpoint::isOpen
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : is the endpoint open?
+//
+// RETURNS         : true if it is
+//
+// ============================================================================
+bool ControlEndpoint::isOpen() const
+{
+	return controlEndpointData->name[0]!='\0';
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ControlEndpoint::serve
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : serve clients for the given time - this is called from
+//                   the owner's event loop instead of sleeping, and every
+//                   request is handled (through the callback) on the caller's
+//                   thread
+//
+// ARGUMENTS       : milliseconds IN how long to serve for;  serve() returns
+//                                   sooner if a request calls interrupt()
+//
+// ============================================================================
+void ControlEndpoint::serve
+(
+	unsigned long milliseconds
+)
+{
+	ControlEndpointData *d = controlEndpointData;
+	int                  i;
+
+	d->interrupted = false;
+
+#if	CONTROL_PLATFORM_IS_WIN32
+	DWORD started = GetTickCount();
+	while(!d->interrupted)
+	{
+		DWORD elapsed = GetTickCount()-started;
+		if(elapsed>=milliseconds)
+		{
+			break;
+		}
+
+		// wait for the next connection to complete an operation
+		HANDLE events[CONTROL_MAX_CONNECTIONS];
+		int    which[CONTROL_MAX_CONNECTIONS];
+		int    count = 0;
+		for(i=0;i<CONTROL_MAX_CONNECTIONS;i++)
+		{
+			int n = (d->nextConnection+i)%CONTROL_MAX_CONNECTIONS;
+			if(d->connections[n].state!=ControlConnection::CONNECTION_CLOSED)
+			{
+				events[count] = d->connections[n].overlapped.hEvent;
+				which[count]  = n;
+				count++;
+			}
+		}
+		if(count==0)
+		{
+			Sleep(milliseconds-elapsed);
+			break;
+		}
+
+		DWORD rc = WaitForMultipleObjects(count,events,FALSE,milliseconds-elapsed);
+		if(rc==WAIT_TIMEOUT)
+		{
+			break;
+		}
+		if(rc>=WAIT_OBJECT_0+count)
+		{
+			LOGGER_LOG_ERROR1("ControlEndpoint: wait failed, error=%d",GetLastError())
+			Sleep(milliseconds-elapsed);
+			break;
+		}
+		d->nextConnection = (which[rc-WAIT_OBJECT_0]+1)%CONTROL_MAX_CONNECTIONS;
+		stepConnection(d,&d->connections[which[rc-WAIT_OBJECT_0]]);
+	}
+#else
+	struct timespec started;
+	clock_gettime(CLOCK_MONOTONIC,&started);
+	while(!d->interrupted)
+	{
+		unsigned long elapsed = elapsedMilliseconds(&started);
+		if(elapsed>=milliseconds)
+		{
+			break;
+		}
+
+		// wait for the connections, and for new clients if there is room
+		//  (otherwise they wait in the listen backlog)
+		struct pollfd      fds[1+CONTROL_MAX_CONNECTIONS];
+		ControlConnection *which[1+CONTROL_MAX_CONNECTIONS];
+		int                count = 0;
+		for(i=0;i<CONTROL_MAX_CONNECTIONS;i++)
+		{
+			ControlConnection *c = &d->connections[(d->nextConnection+i)%CONTROL_MAX_CONNECTIONS];
+			if(c->socket>=0)
+			{
+				fds[count].fd     = c->socket;
+				fds[count].events = (c->outputLength>0 ? POLLOUT : POLLIN);
+				which[count]      = c;
+				count++;
+			}
+		}
+		if((d->listener>=0)&&(count<CONTROL_MAX_CONNECTIONS))
+		{
+			fds[count].fd     = d->listener;
+			fds[count].events = POLLIN;
+			which[count]      = 0;
+			count++;
+		}
+		int rc = poll(fds,count,(int)(milliseconds-elapsed));
+		if(rc==0)
+		{
+			break;
+		}
+		if(rc<0)
+		{
+			if(errno==EINTR) { continue; }
+			LOGGER_LOG_ERROR1("ControlEndpoint: poll failed, error=%d",errno)
+			break;
+		}
+		d->nextConnection = (d->nextConnection+1)%CONTROL_MAX_CONNECTIONS;
+		for(i=0;i<count;i++)
+		{
+			if(fds[i].revents==0) { continue; }
+			if(which[i]==0)                      { acceptConnections(d); }
+			else if(which[i]->outputLength>0)    { flushConnection(d,which[i]); }
+			else                                 { readConnection(d,which[i]); }
+		}
+	}
+#endif	// CONTROL_PLATFORM_IS_WIN32
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ControlEndpoint::interrupt
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : make serve() return once the current request has been
+//                   handled (called by a request handler which needs the
+//                   owner's event loop to act)
+//
+// ============================================================================
+void ControlEndpoint::interrupt()
+{
+	controlEndpointData->interrupted = true;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ControlEndpoint::request
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : client side - send one request to a service, and get its
+//                   reply
+//
+// ARGUMENTS       : svcName             IN  service name
+//                   request             IN  request (without the newline)
+//                   reply               OUT reply text (without "OK "/"ERR "),
+//                                           or the reason there is no reply
+//                   replySize           IN  size of reply
+//                   timeoutMilliseconds IN  how long to wait for the reply
+//
+// RETURNS         : true if the service replied "OK"
+//
+// ============================================================================
+bool ControlEndpoint::request
+(
+	const char   *svcName,
+	const char   *request,
+	char         *reply,
+	int           replySize,
+	unsigned long timeoutMilliseconds
+)
+{
+	char name[CONTROL_MAX_NAME];
+	char message[MAX_MESSAGE];
+	char received[MAX_MESSAGE+1];
+	int  messageLength;
+	int  receivedLength = 0;
+
+	getEndpointName(svcName,name,sizeof(name));
+	messageLength = snprintf(message,sizeof(message),"%s\n",request);
+	if((messageLength<0)||(messageLength>=(int)sizeof(message)))
+	{
+		snprintf(reply,replySize,"request is too long");
+		return false;
+	}
+
+#if	CONTROL_PLATFORM_IS_WIN32
+	// connect (waiting for an instance if they are all busy)
+	HANDLE pipe;
+	while(true)
+	{
+		pipe = CreateFile(name,GENERIC_READ|GENERIC_WRITE,0,NULL,OPEN_EXISTING,FILE_FLAG_OVERLAPPED,NULL);
+		if(pipe!=INVALID_HANDLE_VALUE)
+		{
+			break;
+		}
+		if((GetLastError()!=ERROR_PIPE_BUSY)||(!WaitNamedPipe(name,timeoutMilliseconds)))
+		{
+			snprintf(reply,replySize,"service '%s' is not running (error=%d)",svcName,GetLastError());
+			return false;
+		}
+	}
+
+	// write the request, and read until the reply is complete
+	OVERLAPPED overlapped;
+	DWORD      started = GetTickCount();
+	DWORD      bytes;
+	bool       complete = false;
+	bool       writing  = true;
+	memset(&overlapped,0,sizeof(overlapped));
+	overlapped.hEvent = CreateEvent(NULL,TRUE,FALSE,NULL);
+	while((overlapped.hEvent!=NULL)&&(!complete))
+	{
+		BOOL ok = (writing ?
+			WriteFile(pipe,message,messageLength,NULL,&overlapped) :
+			ReadFile(pipe,received+receivedLength,MAX_MESSAGE-receivedLength,NULL,&overlapped));
+		if((!ok)&&(GetLastError()!=ERROR_IO_PENDING))
+		{
+			break;
+		}
+		DWORD elapsed = GetTickCount()-started;
+		if((elapsed>=timeoutMilliseconds)
+			||(WaitForSingleObject(overlapped.hEvent,timeoutMilliseconds-elapsed)!=WAIT_OBJECT_0))
+		{
+			CancelIo(pipe);
+			(void)GetOverlappedResult(pipe,&overlapped,&bytes,TRUE);
+			break;
+		}
+		if(!GetOverlappedResult(pipe,&overlapped,&bytes,FALSE))
+		{
+			break;
+		}
+		if(writing)
+		{
+			writing = false;
+			continue;
+		}
+		receivedLength += bytes;
+		complete = ((memchr(received,'\n',receivedLength)!=0)||(receivedLength==MAX_MESSAGE));
+	}
+	if(overlapped.hEvent!=NULL) { CloseHandle(overlapped.hEvent); }
+	CloseHandle(pipe);
+#else
+	struct sockaddr_un address;
+	memset(&address,0,sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path,name,sizeof(address.sun_path)-1);
+
+	int s = socket(AF_UNIX,SOCK_STREAM|SOCK_CLOEXEC,0);
+	if((s<0)||(connect(s,(struct sockaddr *)&address,sizeof(address))!=0))
+	{
+		snprintf(reply,replySize,"service '%s' is not running (error=%d)",svcName,errno);
+		if(s>=0) { ::close(s); }
+		return false;
+	}
+
+	// write the request, and read until the reply is complete
+	struct timeval timeout;
+	timeout.tv_sec  = timeoutMilliseconds/1000;
+	timeout.tv_usec = (timeoutMilliseconds%1000)*1000;
+	(void)setsockopt(s,SOL_SOCKET,SO_RCVTIMEO,&timeout,sizeof(timeout));
+	(void)setsockopt(s,SOL_SOCKET,SO_SNDTIMEO,&timeout,sizeof(timeout));
+	if(send(s,message,messageLength,MSG_NOSIGNAL)==messageLength)
+	{
+		while((receivedLength<MAX_MESSAGE)&&(memchr(received,'\n',receivedLength)==0))
+		{
+			int n = recv(s,received+receivedLength,MAX_MESSAGE-receivedLength,0);
+			if(n<=0) { break; }
+			receivedLength += n;
+		}
+	}
+	::close(s);
+#endif	// CONTROL_PLATFORM_IS_WIN32
+
+	received[receivedLength] = '\0';
+	if(memchr(received,'\n',receivedLength)==0)
+	{
+		snprintf(reply,replySize,"no reply from service '%s'",svcName);
+		return false;
+	}
+	return parseReply(received,reply,replySize);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ControlEndpoint::listServices
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : client side - list the services which have an endpoint
+//
+// ARGUMENTS       : listFunction   IN function called with each service name
+//                   genericPointer IN generic pointer passed to the function
+//
+// RETURNS         : number of services listed
+//
+// ============================================================================
+int ControlEndpoint::listServices
+(
+	LIST_FUNCTION *listFunction,
+	void          *genericPointer
+)
+{
+	char svcName[CONTROL_MAX_NAME];
+	int  prefixLength = strlen(CONTROL_LIST_PREFIX);
+	int  suffixLength = strlen(CONTROL_NAME_SUFFIX);
+	int  count        = 0;
+
+#if	CONTROL_PLATFORM_IS_WIN32
+	WIN32_FIND_DATA findData;
+	HANDLE          hFind = FindFirstFile(CONTROL_LIST_PATTERN,&findData);
+	if(hFind==INVALID_HANDLE_VALUE)
+	{
+		return 0;
+	}
+	do
+	{
+		const char *entry = findData.cFileName;
+#else
+	DIR *dir = opendir(CONTROL_DIRECTORY);
+	if(dir==0)
+	{
+		return 0;
+	}
+	struct dirent *dirEntry;
+	while((dirEntry = readdir(dir))!=0)
+	{
+		const char *entry = dirEntry->d_name;
+#endif	// CONTROL_PLATFORM_IS_WIN32
+
+		int entryLength = strlen(entry);
+		if((entryLength>prefixLength+suffixLength)
+			&&(entryLength-prefixLength-suffixLength<(int)sizeof(svcName))
+			&&(strncmp(entry,CONTROL_LIST_PREFIX,prefixLength)==0)
+			&&(strcmp(entry+entryLength-suffixLength,CONTROL_NAME_SUFFIX)==0))
+		{
+			memcpy(svcName,entry+prefixLength,entryLength-prefixLength-suffixLength);
+			svcName[entryLength-prefixLength-suffixLength] = '\0';
+			(*listFunction)(svcName,genericPointer);
+			count++;
+		}
+
+#if	CONTROL_PLATFORM_IS_WIN32
+	} while(FindNextFile(hFind,&findData));
+	FindClose(hFind);
+#else
+	}
+	closedir(dir);
+#endif	// CONTROL_PLATFORM_IS_WIN32
+
+	return count;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ControlEndpoint::getEndpointName
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : get the name of the endpoint of a service
+//
+// ARGUMENTS       : svcName  IN  service name
+//                   name     OUT pipe or socket name
+//                   nameSize IN  size of name
+//
+// ============================================================================
+void ControlEndpoint::getEndpointName
+(
+	const char *svcName,
+	char       *name,
+	int         nameSize
+)
+{
+	snprintf(name,nameSize,"%s%s%s",CONTROL_NAME_PREFIX,svcName,CONTROL_NAME_SUFFIX);
+	name[nameSize-1] = '\0';
+}
+
+// ============================================================================
+//
+// LOCAL UTILITY FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : processInput
+//
+// DESCRIPTION     : handle every complete request a connection has read, as
+//                   long as there is room for the replies
+//
+// ARGUMENTS       : d IN endpoint data
+//                   c IN connection
+//
+// ============================================================================
+static void processInput
+(
+	ControlEndpointData *d,
+	ControlConnection   *c
+)
+{
+	char *line      = c->input;
+	int   remaining = c->inputLength;
+	char  text[ControlEndpoint::MAX_MESSAGE-8];
+
+	while(c->outputLength+ControlEndpoint::MAX_MESSAGE<=CONTROL_OUTPUT_SIZE)
+	{
+		char *newline = (char *)memchr(line,'\n',remaining);
+		bool  ok;
+		if(c->discarding)
+		{
+			// skip to the end of the request which was too long
+			if(newline==0) { remaining = 0; break; }
+			remaining -= (newline+1-line);
+			line = newline+1;
+			c->discarding = false;
+			continue;
+		}
+		if(newline==0)
+		{
+			if(remaining<ControlEndpoint::MAX_MESSAGE) { break; }
+			// a full buffer without a newline - reply now, and discard the request
+			ok = false;
+			strcpy(text,"request is too long");
+			remaining     = 0;
+			c->discarding = true;
+		}
+		else
+		{
+			*newline = '\0';
+			if((newline>line)&&(newline[-1]=='\r')) { newline[-1] = '\0'; }
+			remaining -= (newline+1-line);
+			char *request = line;
+			line = newline+1;
+			if(request[strspn(request," \t")]=='\0') { continue; }
+
+			// the reply must be a single line
+			text[0] = '\0';
+			ok = (*d->controlFunction)(request,text,sizeof(text),d->genericPointer);
+			text[sizeof(text)-1] = '\0';
+			for(char *p=text;*p!='\0';p++) { if((*p=='\n')||(*p=='\r')) { *p = ' '; } }
+		}
+		c->outputLength += snprintf(c->output+c->outputLength,CONTROL_OUTPUT_SIZE-c->outputLength,
+									"%s %s\n",(ok ? "OK" : "ERR"),text);
+	}
+
+	memmove(c->input,line,remaining);
+	c->inputLength = remaining;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : parseReply
+//
+// DESCRIPTION     : split a reply line into its status and text
+//
+// ARGUMENTS       : received  IN  reply line (terminated by a newline)
+//                   reply     OUT reply text
+//                   replySize IN  size of reply
+//
+// RETURNS         : true if the status is "OK"
+//
+// ============================================================================
+static bool parseReply
+(
+	char *received,
+	char *reply,
+	int   replySize
+)
+{
+	*strchr(received,'\n') = '\0';
+
+	bool  ok   = (strncmp(received,"OK ",3)==0);
+	char *text = (ok ? received+3 : (strncmp(received,"ERR ",4)==0 ? received+4 : received));
+	snprintf(reply,replySize,"%s",text);
+	reply[replySize-1] = '\0';
+	return ok;
+}
+
+#if	CONTROL_PLATFORM_IS_WIN32
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : startConnect
+//                   startRead
+//                   startWrite
+//
+// DESCRIPTION     : start the next overlapped operation on a pipe instance -
+//                   its event is signalled when the operation completes (even
+//                   if it completes at once)
+//
+// ARGUMENTS       : c IN connection
+//
+// ============================================================================
+static void startConnect(ControlConnection *c)
+{
+	c->inputLength  = 0;
+	c->outputLength = 0;
+	c->discarding   = false;
+	c->state        = ControlConnection::CONNECTION_CONNECTING;
+	if(!ConnectNamedPipe(c->pipe,&c->overlapped))
+	{
+		switch(GetLastError())
+		{
+			case ERROR_IO_PENDING:
+				break;
+			case ERROR_PIPE_CONNECTED:
+				// a client got in between CreateNamedPipe and ConnectNamedPipe
+				SetEvent(c->overlapped.hEvent);
+				break;
+			default:
+				LOGGER_LOG_ERROR1("ControlEndpoint: unable to connect pipe, error=%d",GetLastError())
+				c->state = ControlConnection::CONNECTION_CLOSED;
+				closeConnection(c);
+				break;
+		}
+	}
+}
+static void startRead(ControlConnection *c)
+{
+	c->state = ControlConnection::CONNECTION_READING;
+	if((!ReadFile(c->pipe,c->input+c->inputLength,ControlEndpoint::MAX_MESSAGE-c->inputLength,
+					NULL,&c->overlapped))
+		&&(GetLastError()!=ERROR_IO_PENDING))
+	{
+		// the client has gone - wait for the next one
+		DisconnectNamedPipe(c->pipe);
+		startConnect(c);
+	}
+}
+static void startWrite(ControlConnection *c)
+{
+	c->state = ControlConnection::CONNECTION_WRITING;
+	if((!WriteFile(c->pipe,c->output,c->outputLength,NULL,&c->overlapped))
+		&&(GetLastError()!=ERROR_IO_PENDING))
+	{
+		DisconnectNamedPipe(c->pipe);
+		startConnect(c);
+	}
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : stepConnection
+//
+// DESCRIPTION     : a pipe instance's operation has completed - move it on to
+//                   its next one
+//
+// ARGUMENTS       : d IN endpoint data
+//                   c IN connection
+//
+// ============================================================================
+static void stepConnection
+(
+	ControlEndpointData *d,
+	ControlConnection   *c
+)
+{
+	DWORD bytes = 0;
+	BOOL  ok    = GetOverlappedResult(c->pipe,&c->overlapped,&bytes,FALSE);
+
+	if((!ok)||((c->state==ControlConnection::CONNECTION_READING)&&(bytes==0)))
+	{
+		// the client has gone (or never arrived) - wait for the next one
+		if(c->state!=ControlConnection::CONNECTION_CONNECTING)
+		{
+			LOGGER_LOG_DEBUG("ControlEndpoint: client disconnected")
+			DisconnectNamedPipe(c->pipe);
+		}
+		startConnect(c);
+		return;
+	}
+
+	switch(c->state)
+	{
+		case ControlConnection::CONNECTION_CONNECTING:
+			LOGGER_LOG_DEBUG("ControlEndpoint: client connected")
+			startRead(c);
+			break;
+
+		case ControlConnection::CONNECTION_READING:
+			c->inputLength += bytes;
+			processInput(d,c);
+			if(c->outputLength>0) { startWrite(c); } else { startRead(c); }
+			break;
+
+		case ControlConnection::CONNECTION_WRITING:
+			// requests may be waiting for room for their replies
+			memmove(c->output,c->output+bytes,c->outputLength-bytes);
+			c->outputLength -= bytes;
+			if(c->outputLength==0) { processInput(d,c); }
+			if(c->outputLength>0) { startWrite(c); } else { startRead(c); }
+			break;
+	}
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : closeConnection
+//
+// DESCRIPTION     : close a pipe instance (once its operation has ended)
+//
+// ARGUMENTS       : c IN connection
+//
+// ============================================================================
+static void closeConnection(ControlConnection *c)
+{
+	DWORD bytes;
+
+	if(c->pipe!=INVALID_HANDLE_VALUE)
+	{
+		// the OVERLAPPED must outlive the operation
+		if(c->state!=ControlConnection::CONNECTION_CLOSED)
+		{
+			CancelIo(c->pipe);
+			(void)GetOverlappedResult(c->pipe,&c->overlapped,&bytes,TRUE);
+		}
+		CloseHandle(c->pipe);
+		c->pipe = INVALID_HANDLE_VALUE;
+	}
+	if(c->overlapped.hEvent!=NULL)
+	{
+		CloseHandle(c->overlapped.hEvent);
+		c->overlapped.hEvent = NULL;
+	}
+	c->state = ControlConnection::CONNECTION_CLOSED;
+}
+
+#else
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : acceptConnections
+//
+// DESCRIPTION     : accept the clients waiting on the listening socket, as
+//                   long as there is a free connection
+//
+// ARGUMENTS       : d IN endpoint data
+//
+// ============================================================================
+static void acceptConnections(ControlEndpointData *d)
+{
+	for(int i=0;i<CONTROL_MAX_CONNECTIONS;i++)
+	{
+		ControlConnection *c = &d->connections[i];
+		if(c->socket>=0)
+		{
+			continue;
+		}
+		int s = accept4(d->listener,0,0,SOCK_CLOEXEC|SOCK_NONBLOCK);
+		if(s<0)
+		{
+			return;
+		}
+		LOGGER_LOG_DEBUG("ControlEndpoint: client connected")
+		c->socket       = s;
+		c->inputLength  = 0;
+		c->outputLength = 0;
+		c->discarding   = false;
+	}
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : readConnection
+//
+// DESCRIPTION     : read what a client has sent, and handle its requests
+//
+// ARGUMENTS       : d IN endpoint data
+//                   c IN connection
+//
+// ============================================================================
+static void readConnection
+(
+	ControlEndpointData *d,
+	ControlConnection   *c
+)
+{
+	int n = recv(c->socket,c->input+c->inputLength,ControlEndpoint::MAX_MESSAGE-c->inputLength,0);
+	if((n<0)&&((errno==EAGAIN)||(errno==EWOULDBLOCK)||(errno==EINTR)))
+	{
+		return;
+	}
+	if(n<=0)
+	{
+		LOGGER_LOG_DEBUG("ControlEndpoint: client disconnected")
+		closeConnection(c);
+		return;
+	}
+	c->inputLength += n;
+	processInput(d,c);
+	flushConnection(d,c);
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : flushConnection
+//
+// DESCRIPTION     : write as much of a connection's replies as the socket
+//                   will take (the rest waits for POLLOUT)
+//
+// ARGUMENTS       : d IN endpoint data
+//                   c IN connection
+//
+// ============================================================================
+static void flushConnection
+(
+	ControlEndpointData *d,
+	ControlConnection   *c
+)
+{
+	while((c->socket>=0)&&(c->outputLength>0))
+	{
+		int n = send(c->socket,c->output,c->outputLength,MSG_NOSIGNAL|MSG_DONTWAIT);
+		if(n<0)
+		{
+			if((errno!=EAGAIN)&&(errno!=EWOULDBLOCK)&&(errno!=EINTR)) { closeConnection(c); }
+			return;
+		}
+		memmove(c->output,c->output+n,c->outputLength-n);
+		c->outputLength -= n;
+
+		// requests may be waiting for room for their replies
+		if(c->outputLength==0) { processInput(d,c); }
+	}
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : closeConnection
+//
+// DESCRIPTION     : close a client's socket
+//
+// ARGUMENTS       : c IN connection
+//
+// ============================================================================
+static void closeConnection(ControlConnection *c)
+{
+	if(c->socket>=0)
+	{
+		::close(c->socket);
+		c->socket = -1;
+	}
+	c->inputLength  = 0;
+	c->outputLength = 0;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : elapsedMilliseconds
+//
+// DESCRIPTION     : time since a start time (monotonic)
+//
+// ARGUMENTS       : start IN start time
+//
+// RETURNS         : elapsed time in milliseconds
+//
+// ============================================================================
+static unsigned long elapsedMilliseconds(const struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	return (unsigned long)((now.tv_sec-start->tv_sec)*1000+(now.tv_nsec-start->tv_nsec)/1000000);
+}
+
+#endif	// CONTROL_PLATFORM_IS_WIN32
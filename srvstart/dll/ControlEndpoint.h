@@ -0,0 +1,158 @@
+// ============================================================================
+//
+// FILE        : ControlEndpoint.h
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : interface definition for ControlEndpoint class
+//
+//               A ControlEndpoint lets local tools query and command a running
+//               service:  a named pipe \\.\pipe\srvstart.<service> on Win32,
+//               or a Unix domain socket /tmp/srvstart.<service>.ctl elsewhere.
+//
+//               The protocol is line based.  A client sends one or more
+//               requests, each terminated by a newline, and gets one reply
+//               line for each, in order:  "OK <text>" or "ERR <text>".  The
+//               requests themselves are interpreted by the owner of the
+//               endpoint, through a callback (see CmdRunner).
+//
+//               The endpoint has no threads of its own.  Its owner calls serve()
+//               from its event loop instead of sleeping, and every client is
+//               served there with overlapped (Win32) or non-blocking (POSIX)
+//               I/O, so a slow client cannot hold up the others.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// prevent multiple inclusion
+
+#if !defined(__CONTROL_ENDPOINT_H__)
+#define __CONTROL_ENDPOINT_H__
+
+// ============================================================================
+//
+// IMPORT / EXPORT
+//
+// ============================================================================
+
+//
+// if SRVSTART_DLL_EXPORT is #defined, then we are building the DLL
+//  and exporting the classes
+//
+// otherwise, we are building an executable which will link with the DLL at run-time
+//
+// -------------------------------------------------------------
+// APART FROM THE DLL ITSELF,
+//  ANY SOURCE FILE WHICH #includes THIS ONE SHOULD ENSURE THAT
+//  SRVSTART_DLL_EXPORT is not #defined
+// -------------------------------------------------------------
+//
+
+#ifdef SRVSTART_DLL_EXPORT
+#define SRVSTART_DLL_API __declspec(dllexport)
+#pragma message("exporting ControlEndpoint")
+
+#else
+
+#ifdef	SRVSTART_DLL_LOCAL
+#pragma message("ControlEndpoint is local")
+#define	SRVSTART_DLL_API
+
+#else
+
+#define SRVSTART_DLL_API __declspec(dllimport)
+#pragma message("importing ControlEndpoint")
+
+#endif
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// namespace header
+#include "SrvStart.h"
+
+// forward declarations
+struct ControlEndpointData;
+
+// ============================================================================
+//
+// NAMESPACE
+//
+// ============================================================================
+
+// all the DLL classes are defined within the SrvStart namespace
+namespace SrvStart {
+
+// ============================================================================
+//
+// ControlEndpoint class
+//
+// ============================================================================
+class SRVSTART_DLL_API ControlEndpoint
+{
+public:
+	// longest request or reply line (including the newline)
+	enum { MAX_MESSAGE = 1024 };
+
+	// request handler:  puts the reply text (one line) into reply, and
+	//  returns true for "OK", false for "ERR"
+	typedef bool CONTROL_FUNCTION(const char *request,char *reply,int replySize,void *genericPointer);
+
+	// open and close the endpoint of a service
+	void open(const char *svcName,CONTROL_FUNCTION *controlFunction,void *genericPointer)
+		throw (SrvStartException);
+	void close();
+	bool isOpen() const;
+
+	// serve clients for the given time (returns early after interrupt())
+	void serve(unsigned long milliseconds);
+	void interrupt();
+
+	// client side:  send one request to a service, and get its reply
+	static bool request(const char *svcName,const char *request,char *reply,int replySize,
+		unsigned long timeoutMilliseconds);
+
+	// client side:  list the services which have an endpoint
+	typedef void LIST_FUNCTION(const char *svcName,void *genericPointer);
+	static int listServices(LIST_FUNCTION *listFunction,void *genericPointer);
+
+	// name of the endpoint of a service
+	static void getEndpointName(const char *svcName,char *name,int nameSize);
+
+	// constructor and destructor
+	ControlEndpoint();
+	virtual ~ControlEndpoint();
+
+private:
+	// no copying
+	ControlEndpoint(const ControlEndpoint &);
+	ControlEndpoint &operator=(const ControlEndpoint &);
+
+private:	// data members - hidden data
+	struct ControlEndpointData *controlEndpointData;
+
+};
+
+} // namespace SrvStart
+
+#endif // !defined(__CONTROL_ENDPOINT_H__)
@@ -0,0 +1,391 @@
+// ============================================================================
+//
+// FILE        : DurationHistory.cpp
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : Implementation of exported class DurationHistory
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// this is the "main" source file
+#define	SRVSTART_DLL
+
+// we are exporting the class
+#define	SRVSTART_DLL_EXPORT
+
+//
+// which platform are we running?
+//
+#if	defined(WIN32)
+#define	DURATION_PLATFORM_IS_WIN32	1
+#else
+#define	DURATION_PLATFORM_IS_WIN32	0
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// system headers
+#if	DURATION_PLATFORM_IS_WIN32
+#define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
+#include <windows.h>
+#endif	// DURATION_PLATFORM_IS_WIN32
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// support headers
+#include <logger.h>
+
+// class headers
+#include "DurationHistory.h"
+
+// ============================================================================
+//
+// NAMESPACE DECLARATIONS
+//
+// ============================================================================
+
+using namespace SrvStart;
+
+// ============================================================================
+//
+// CONSTANT DEFINITIONS
+//
+// ============================================================================
+
+// number of buckets in each histogram (the last has no upper limit)
+const int DURATION_BUCKETS = 16;
+
+// upper limit of each bucket (milliseconds)
+static const unsigned long G_bucketLimits[DURATION_BUCKETS-1] =
+	{ 250,500,1000,2000,4000,8000,15000,30000,60000,120000,240000,480000,900000,1800000,3600000 };
+
+// names of the phases in the state file
+static const char *G_phaseNames[DurationHistory::PHASE_COUNT] = { "start","stop" };
+
+// once a histogram holds this many runs, every bucket is halved
+const unsigned long DURATION_DECAY_RUNS = 64;
+
+// fewest runs from which a percentile is given
+const unsigned long DURATION_MIN_RUNS = 3;
+
+// longest state file name, and line in the state file
+const int DURATION_MAX_NAME = 1024;
+const int DURATION_MAX_LINE = 512;
+
+// ============================================================================
+//
+// LOCAL CLASSES
+//
+// ============================================================================
+
+//
+// DurationHistory data
+//
+struct DurationHistoryData
+{
+	// state file (empty until loaded)
+	char fileName[DURATION_MAX_NAME];
+
+	// number of runs in each bucket
+	unsigned long buckets[DurationHistory::PHASE_COUNT][DURATION_BUCKETS];
+
+	// constructor
+	DurationHistoryData()
+	{
+		fileName[0] = '\0';
+		memset(buckets,0,sizeof(buckets));
+	} ;
+
+} ;
+
+// ============================================================================
+//
+// PUBLIC MEMBER FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// MEMBER FUNCTION : DurationHistory::DurationHistory
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : constructor - the history is empty until it is loaded
+//
+// ============================================================================
+DurationHistory::DurationHistory()
+{
+	durationHistoryData = new DurationHistoryData;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : DurationHistory::~DurationHistory
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : destructor
+//
+// ============================================================================
+DurationHistory::~DurationHistory()
+{
+	delete durationHistoryData;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : DurationHistory::load
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : load the history of a service from its state file (if it
+//                   has one - lines which cannot be understood are ignored)
+//
+// ARGUMENTS       : svcName IN service name
+//
+// ============================================================================
+void DurationHistory::load
+(
+	const char *svcName
+)
+{
+	DurationHistoryData *d = durationHistoryData;
+
+	getStateFileName(svcName,d->fileName,sizeof(d->fileName));
+	memset(d->buckets,0,sizeof(d->buckets));
+
+	FILE *file = fopen(d->fileName,"r");
+	if(file==0)
+	{
+		LOGGER_LOG_DEBUG1("DurationHistory: no history in '%s'",d->fileName)
+		return;
+	}
+
+	// each line is a phase name and the count in each bucket
+	char line[DURATION_MAX_LINE];
+	while(fgets(line,sizeof(line),file)!=0)
+	{
+		char *next = line+strcspn(line," \t\r\n");
+		if(*next=='\0') { continue; }
+		*(next++) = '\0';
+
+		for(int phase=0;phase<PHASE_COUNT;phase++)
+		{
+			if(strcmp(line,G_phaseNames[phase])) { continue; }
+			for(int i=0;i<DURATION_BUCKETS;i++)
+			{
+				d->buckets[phase][i] = strtoul(next,&next,10);
+			}
+		}
+	}
+	fclose(file);
+
+	LOGGER_LOG_DEBUG3("DurationHistory: loaded '%s' (%lu starts, %lu stops)",
+		d->fileName,getCount(PHASE_START),getCount(PHASE_STOP))
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : DurationHistory::record
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : add a duration to the history (in memory - the caller
+//                   saves it, with save(), once it has let go of any locks)
+//
+// ARGUMENTS       : phase        IN what took this long
+//                   milliseconds IN how long it took
+//
+// ============================================================================
+void DurationHistory::record
+(
+	PHASES        phase,
+	unsigned long milliseconds
+)
+{
+	DurationHistoryData *d = durationHistoryData;
+	int                  i = 0;
+
+	while((i<DURATION_BUCKETS-1)&&(milliseconds>G_bucketLimits[i])) { i++; }
+	d->buckets[phase][i]++;
+
+	// older runs count for less
+	if(getCount(phase)>=DURATION_DECAY_RUNS)
+	{
+		for(i=0;i<DURATION_BUCKETS;i++) { d->buckets[phase][i] /= 2; }
+	}
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : DurationHistory::getCount
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : get the number of runs remembered
+//
+// ARGUMENTS       : phase IN start or stop
+//
+// RETURNS         : number of runs
+//
+// ============================================================================
+unsigned long DurationHistory::getCount
+(
+	PHASES phase
+) const
+{
+	unsigned long count = 0;
+
+	for(int i=0;i<DURATION_BUCKETS;i++) { count += durationHistoryData->buckets[phase][i]; }
+	return count;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : DurationHistory::getPercentile
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : get the duration within which the given percentage of the
+//                   runs remembered finished (the upper limit of the bucket it
+//                   falls in, or twice the last limit if it has none)
+//
+// ARGUMENTS       : phase   IN start or stop
+//                   percent IN percentage (eg 95)
+//
+// RETURNS         : duration in milliseconds, or 0 if there are not enough
+//                   runs to say
+//
+// ============================================================================
+unsigned long DurationHistory::getPercentile
+(
+	PHASES phase,
+	int    percent
+) const
+{
+	unsigned long count = getCount(phase);
+
+	if(count<DURATION_MIN_RUNS) { return 0; }
+
+	unsigned long target     = (count*percent+99)/100;
+	unsigned long cumulative = 0;
+	for(int i=0;i<DURATION_BUCKETS-1;i++)
+	{
+		cumulative += durationHistoryData->buckets[phase][i];
+		if(cumulative>=target) { return G_bucketLimits[i]; }
+	}
+	return 2*G_bucketLimits[DURATION_BUCKETS-2];
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : DurationHistory::getStateFileName
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : get the name of the state file of a service
+//
+// ARGUMENTS       : svcName  IN  service name
+//                   name     OUT state file name
+//                   nameSize IN  size of name
+//
+// ============================================================================
+void DurationHistory::getStateFileName
+(
+	const char *svcName,
+	char       *name,
+	int         nameSize
+)
+{
+#if	DURATION_PLATFORM_IS_WIN32
+	const char *directory = getenv("ProgramData");
+	if(directory==0) { directory = getenv("TEMP"); }
+	if(directory==0) { directory = "."; }
+	snprintf(name,nameSize,"%s\\srvstart.%s.durations",directory,svcName);
+#else
+	// a service name may contain anything but '/'
+	int length = snprintf(name,nameSize,"/var/tmp/srvstart.");
+	snprintf(name+length,nameSize-length,"%s.durations",svcName);
+	for(char *c=name+length;*c!='\0';c++)
+	{
+		if(*c=='/') { *c = '_'; }
+	}
+#endif	// DURATION_PLATFORM_IS_WIN32
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : DurationHistory::save
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : save the history to the state file (a new file replaces
+//                   it, so a failure cannot leave half a history behind)
+//
+//                   The buckets are copied first, so a duration recorded
+//                   meanwhile cannot change the file as it is written.
+//
+//                   A failure is only logged:  the history is just a guide.
+//
+// ============================================================================
+void DurationHistory::save() const
+{
+	DurationHistoryData *d = durationHistoryData;
+	char                 newFileName[DURATION_MAX_NAME+8];
+	unsigned long        buckets[PHASE_COUNT][DURATION_BUCKETS];
+
+	if(d->fileName[0]=='\0') { return; }
+	memcpy(buckets,d->buckets,sizeof(buckets));
+
+	snprintf(newFileName,sizeof(newFileName),"%s.new",d->fileName);
+	FILE *file = fopen(newFileName,"w");
+	if(file==0)
+	{
+		LOGGER_LOG_INFO1("WARNING: unable to save service durations to '%s'",newFileName)
+		return;
+	}
+
+	fprintf(file,"# srvstart service durations:  runs taking up to");
+	for(int i=0;i<DURATION_BUCKETS-1;i++) { fprintf(file," %lu",G_bucketLimits[i]); }
+	fprintf(file,"ms, then longer\n");
+	for(int phase=0;phase<PHASE_COUNT;phase++)
+	{
+		fprintf(file,"%s",G_phaseNames[phase]);
+		for(int i=0;i<DURATION_BUCKETS;i++) { fprintf(file," %lu",buckets[phase][i]); }
+		fprintf(file,"\n");
+	}
+
+	bool saved = (fclose(file)==0);
+#if	DURATION_PLATFORM_IS_WIN32
+	saved = saved&&(MoveFileEx(newFileName,d->fileName,MOVEFILE_REPLACE_EXISTING)!=0);
+#else
+	saved = saved&&(rename(newFileName,d->fileName)==0);
+#endif	// DURATION_PLATFORM_IS_WIN32
+	if(!saved)
+	{
+		LOGGER_LOG_INFO1("WARNING: unable to save service durations to '%s'",d->fileName)
+	}
+}
@@ -0,0 +1,148 @@
+// ============================================================================
+//
+// FILE        : DurationHistory.h
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : interface definition for DurationHistory class
+//
+//               A DurationHistory remembers how long a service has taken to
+//               start and to stop, as a histogram for each (the bucket limits
+//               roughly double, from a quarter of a second to an hour).  It is kept in a small
+//               state file, srvstart.<service>.durations, in %ProgramData%
+//               (or %TEMP%) on Win32 and in /var/tmp elsewhere, so it
+//               survives restarts of the service and of the system.
+//
+//               Older runs count for less:  once a histogram holds enough
+//               runs, every bucket is halved, so the history follows a
+//               service whose start time changes.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// prevent multiple inclusion
+
+#if !defined(__DURATION_HISTORY_H__)
+#define __DURATION_HISTORY_H__
+
+// ============================================================================
+//
+// IMPORT / EXPORT
+//
+// ============================================================================
+
+//
+// if SRVSTART_DLL_EXPORT is #defined, then we are building the DLL
+//  and exporting the classes
+//
+// otherwise, we are building an executable which will link with the DLL at run-time
+//
+// -------------------------------------------------------------
+// APART FROM THE DLL ITSELF,
+//  ANY SOURCE FILE WHICH #includes THIS ONE SHOULD ENSURE THAT
+//  SRVSTART_DLL_EXPORT is not #defined
+// -------------------------------------------------------------
+//
+
+#ifdef SRVSTART_DLL_EXPORT
+#define SRVSTART_DLL_API __declspec(dllexport)
+#pragma message("exporting DurationHistory")
+
+#else
+
+#ifdef	SRVSTART_DLL_LOCAL
+#pragma message("DurationHistory is local")
+#define	SRVSTART_DLL_API
+
+#else
+
+#define SRVSTART_DLL_API __declspec(dllimport)
+#pragma message("importing DurationHistory")
+
+#endif
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// namespace header
+#include "SrvStart.h"
+
+// forward declarations
+struct DurationHistoryData;
+
+// ============================================================================
+//
+// NAMESPACE
+//
+// ============================================================================
+
+// all the DLL classes are defined within the SrvStart namespace
+namespace SrvStart {
+
+// ============================================================================
+//
+// DurationHistory class
+//
+// ============================================================================
+class SRVSTART_DLL_API DurationHistory
+{
+public:
+	// the durations remembered
+	enum PHASES { PHASE_START, PHASE_STOP, PHASE_COUNT };
+
+	// load the history of a service (an empty one if there is none yet)
+	void load(const char *svcName);
+
+	// add a duration (in memory only - save() writes the state file)
+	void record(PHASES phase,unsigned long milliseconds);
+
+	// save the history to the state file (slow - do not hold a lock over it)
+	void save() const;
+
+	// number of runs remembered (older ones count for less)
+	unsigned long getCount(PHASES phase) const;
+
+	// duration within which the given percentage of runs finished, or 0 if
+	//  there are not enough runs to say
+	unsigned long getPercentile(PHASES phase,int percent) const;
+
+	// name of the state file of a service
+	static void getStateFileName(const char *svcName,char *name,int nameSize);
+
+	// constructor and destructor
+	DurationHistory();
+	virtual ~DurationHistory();
+
+private:
+	// no copying
+	DurationHistory(const DurationHistory &);
+	DurationHistory &operator=(const DurationHistory &);
+
+private:	// data members - hidden data
+	struct DurationHistoryData *durationHistoryData;
+
+};
+
+} // namespace SrvStart
+
+#endif // !defined(__DURATION_HISTORY_H__)
@@ -0,0 +1,336 @@
+// ============================================================================
+//
+// FILE        : Metrics.cpp
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : Implementation of exported classes Metrics, MetricsCounter,
+//               MetricsGauge and MetricsHistogram
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// this is the "main" source file
+#define	SRVSTART_DLL
+
+// we are exporting the class
+#define	SRVSTART_DLL_EXPORT
+
+//
+// which platform are we running?
+//
+#if	defined(WIN32)
+#define	METRICS_PLATFORM_IS_WIN32	1
+#else
+#define	METRICS_PLATFORM_IS_WIN32	0
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// system headers
+#if	METRICS_PLATFORM_IS_WIN32
+#define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
+#include <windows.h>
+#endif	// METRICS_PLATFORM_IS_WIN32
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// class headers
+#include "Metrics.h"
+
+// ============================================================================
+//
+// NAMESPACE DECLARATIONS
+//
+// ============================================================================
+
+using namespace SrvStart;
+
+// ============================================================================
+//
+// LOCAL MACROS
+//
+// ============================================================================
+
+// interlocked operations on a 64-bit value
+#if	METRICS_PLATFORM_IS_WIN32
+#define	METRICS_ATOMIC_ADD(p,v)		InterlockedExchangeAdd64((p),(v))
+#define	METRICS_ATOMIC_SET(p,v)		InterlockedExchange64((p),(v))
+#define	METRICS_ATOMIC_GET(p)		InterlockedCompareExchange64(const_cast<volatile long long*>(p),0,0)
+#else
+#define	METRICS_ATOMIC_ADD(p,v)		__atomic_fetch_add((p),(v),__ATOMIC_RELAXED)
+#define	METRICS_ATOMIC_SET(p,v)		__atomic_store_n((p),(v),__ATOMIC_RELAXED)
+#define	METRICS_ATOMIC_GET(p)		__atomic_load_n((p),__ATOMIC_RELAXED)
+#endif	// METRICS_PLATFORM_IS_WIN32
+
+// ============================================================================
+//
+// CONSTANT DEFINITIONS
+//
+// ============================================================================
+
+// upper limit of each histogram bucket (milliseconds)
+static const unsigned long G_bucketLimits[MetricsHistogram::BUCKET_COUNT-1] =
+	{ 100,250,500,1000,2500,5000,10000,30000,60000,120000,300000 };
+
+// ============================================================================
+//
+// PUBLIC MEMBER FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// MEMBER FUNCTION : Metrics::append
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : append formatted text
+//
+// ARGUMENTS       : text     IN/OUT text
+//                   textSize IN     size of text
+//                   length   IN     length of text so far
+//                   format   IN     printf format, and its arguments
+//
+// RETURNS         : new length of text
+//
+// ============================================================================
+int Metrics::append
+(
+	char       *text,
+	int         textSize,
+	int         length,
+	const char *format,
+	...
+)
+{
+	if(length>=textSize) { return textSize; }
+
+	va_list arguments;
+	va_start(arguments,format);
+	int added = vsnprintf(text+length,textSize-length,format,arguments);
+	va_end(arguments);
+
+	// a line which does not fit is left out, and so is everything after it
+	//  (a successful append is always shorter than textSize)
+	if((added<0)||(added>=textSize-length))
+	{
+		text[length] = '\0';
+		return textSize;
+	}
+	return length+added;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : Metrics::appendHeader
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : append the # HELP and # TYPE lines of a metric
+//
+// ARGUMENTS       : text     IN/OUT text
+//                   textSize IN     size of text
+//                   length   IN     length of text so far
+//                   name     IN     metric name
+//                   type     IN     counter, gauge or histogram
+//                   help     IN     description
+//
+// RETURNS         : new length of text
+//
+// ============================================================================
+int Metrics::appendHeader
+(
+	char       *text,
+	int         textSize,
+	int         length,
+	const char *name,
+	const char *type,
+	const char *help
+)
+{
+	return append(text,textSize,length,"# HELP %s %s\n# TYPE %s %s\n",name,help,name,type);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : Metrics::escapeLabel
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : escape backslashes, double quotes and newlines in a label
+//                   value
+//
+// ARGUMENTS       : label     OUT escaped value (truncated if need be)
+//                   labelSize IN  size of label
+//                   value     IN  value
+//
+// ============================================================================
+void Metrics::escapeLabel
+(
+	char       *label,
+	int         labelSize,
+	const char *value
+)
+{
+	int length = 0;
+
+	for(;(*value!='\0')&&(length<labelSize-2);value++)
+	{
+		if((*value=='\\')||(*value=='"')||(*value=='\n'))
+		{
+			label[length++] = '\\';
+			label[length++] = (*value=='\n') ? 'n' : *value;
+		}
+		else
+		{
+			label[length++] = *value;
+		}
+	}
+	label[length] = '\0';
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : MetricsCounter::MetricsCounter
+//                   MetricsCounter::increment
+//                   MetricsCounter::get
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : a counter (starts at 0)
+//
+// ARGUMENTS       : as below
+//
+// ============================================================================
+MetricsCounter::MetricsCounter() { value = 0; }
+void MetricsCounter::increment(unsigned long by) { METRICS_ATOMIC_ADD(&value,(long long)by); }
+unsigned long long MetricsCounter::get() const { return (unsigned long long)METRICS_ATOMIC_GET(&value); }
+
+// ============================================================================
+//
+// MEMBER FUNCTION : MetricsGauge::MetricsGauge
+//                   MetricsGauge::set
+//                   MetricsGauge::get
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : a gauge (starts at 0)
+//
+// ARGUMENTS       : as below
+//
+// ============================================================================
+MetricsGauge::MetricsGauge() { value = 0; }
+void MetricsGauge::set(long long newValue) { METRICS_ATOMIC_SET(&value,newValue); }
+long long MetricsGauge::get() const { return METRICS_ATOMIC_GET(&value); }
+
+// ============================================================================
+//
+// MEMBER FUNCTION : MetricsHistogram::MetricsHistogram
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : constructor - the histogram is empty
+//
+// ============================================================================
+MetricsHistogram::MetricsHistogram()
+{
+	for(int i=0;i<BUCKET_COUNT;i++) { buckets[i] = 0; }
+	sumMilliseconds = 0;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : MetricsHistogram::observe
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : count a duration
+//
+// ARGUMENTS       : milliseconds IN duration
+//
+// ============================================================================
+void MetricsHistogram::observe
+(
+	unsigned long milliseconds
+)
+{
+	int i = 0;
+
+	while((i<BUCKET_COUNT-1)&&(milliseconds>G_bucketLimits[i])) { i++; }
+	METRICS_ATOMIC_ADD(&buckets[i],1LL);
+	METRICS_ATOMIC_ADD(&sumMilliseconds,(long long)milliseconds);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : MetricsHistogram::render
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : append the histogram to the text, as cumulative buckets
+//                   in seconds, a sum and a count (the count is the total of
+//                   the buckets read, so the two always agree)
+//
+// ARGUMENTS       : text     IN/OUT text
+//                   textSize IN     size of text
+//                   length   IN     length of text so far
+//                   name     IN     metric name
+//                   labels   IN     labels (eg service="x"), or ""
+//
+// RETURNS         : new length of text
+//
+// ============================================================================
+int MetricsHistogram::render
+(
+	char       *text,
+	int         textSize,
+	int         length,
+	const char *name,
+	const char *labels
+) const
+{
+	const char *separator  = (labels[0]!='\0') ? "," : "";
+	long long   cumulative = 0;
+
+	for(int i=0;i<BUCKET_COUNT;i++)
+	{
+		cumulative += METRICS_ATOMIC_GET(&buckets[i]);
+		if(i<BUCKET_COUNT-1)
+		{
+			length = Metrics::append(text,textSize,length,"%s_bucket{%s%sle=\"%g\"} %lld\n",
+				name,labels,separator,G_bucketLimits[i]/1000.0,cumulative);
+		}
+		else
+		{
+			length = Metrics::append(text,textSize,length,"%s_bucket{%s%sle=\"+Inf\"} %lld\n",
+				name,labels,separator,cumulative);
+		}
+	}
+	length = Metrics::append(text,textSize,length,"%s_sum{%s} %.3f\n",
+		name,labels,METRICS_ATOMIC_GET(&sumMilliseconds)/1000.0);
+	length = Metrics::append(text,textSize,length,"%s_count{%s} %lld\n",name,labels,cumulative);
+
+	return length;
+}
@@ -0,0 +1,194 @@
+// ============================================================================
+//
+// FILE        : Metrics.h
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : interface definition for the metrics classes
+//
+//               A MetricsCounter only goes up, a MetricsGauge is set, and a
+//               MetricsHistogram counts durations in fixed buckets.  They are
+//               updated with interlocked (atomic) operations and no locks,
+//               so the service's own thread pays next to nothing for them.
+//               They are turned into text only when they are read, in the
+//               Prometheus text exposition format (see MetricsEndpoint).
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// prevent multiple inclusion
+
+#if !defined(__METRICS_H__)
+#define __METRICS_H__
+
+// ============================================================================
+//
+// IMPORT / EXPORT
+//
+// ============================================================================
+
+//
+// if SRVSTART_DLL_EXPORT is #defined, then we are building the DLL
+//  and exporting the classes
+//
+// otherwise, we are building an executable which will link with the DLL at run-time
+//
+// -------------------------------------------------------------
+// APART FROM THE DLL ITSELF,
+//  ANY SOURCE FILE WHICH #includes THIS ONE SHOULD ENSURE THAT
+//  SRVSTART_DLL_EXPORT is not #defined
+// -------------------------------------------------------------
+//
+
+#ifdef SRVSTART_DLL_EXPORT
+#define SRVSTART_DLL_API __declspec(dllexport)
+#pragma message("exporting Metrics")
+
+#else
+
+#ifdef	SRVSTART_DLL_LOCAL
+#pragma message("Metrics is local")
+#define	SRVSTART_DLL_API
+
+#else
+
+#define SRVSTART_DLL_API __declspec(dllimport)
+#pragma message("importing Metrics")
+
+#endif
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// namespace header
+#include "SrvStart.h"
+
+// ============================================================================
+//
+// NAMESPACE
+//
+// ============================================================================
+
+// all the DLL classes are defined within the SrvStart namespace
+namespace SrvStart {
+
+// ============================================================================
+//
+// Metrics class - writing the text exposition format
+//
+// ============================================================================
+class SRVSTART_DLL_API Metrics
+{
+public:
+	// append to the text (returns the new length - the text is never overrun;
+	//  once a line has not fitted, it returns textSize, and appends nothing more)
+	static int append(char *text,int textSize,int length,const char *format,...);
+
+	// append the # HELP and # TYPE lines of a metric
+	static int appendHeader(char *text,int textSize,int length,const char *name,
+		const char *type,const char *help);
+
+	// make a label value safe to put between double quotes
+	static void escapeLabel(char *label,int labelSize,const char *value);
+
+private:
+	Metrics(); // no constructor
+
+};
+
+// ============================================================================
+//
+// MetricsCounter class
+//
+// ============================================================================
+class SRVSTART_DLL_API MetricsCounter
+{
+public:
+	void increment(unsigned long by = 1);
+	unsigned long long get() const;
+
+	MetricsCounter();
+
+private:
+	// no copying
+	MetricsCounter(const MetricsCounter &);
+	MetricsCounter &operator=(const MetricsCounter &);
+
+	volatile long long value;
+
+};
+
+// ============================================================================
+//
+// MetricsGauge class
+//
+// ============================================================================
+class SRVSTART_DLL_API MetricsGauge
+{
+public:
+	void set(long long newValue);
+	long long get() const;
+
+	MetricsGauge();
+
+private:
+	// no copying
+	MetricsGauge(const MetricsGauge &);
+	MetricsGauge &operator=(const MetricsGauge &);
+
+	volatile long long value;
+
+};
+
+// ============================================================================
+//
+// MetricsHistogram class
+//
+// ============================================================================
+class SRVSTART_DLL_API MetricsHistogram
+{
+public:
+	// buckets (the last has no upper limit)
+	enum { BUCKET_COUNT = 12 };
+
+	// count a duration
+	void observe(unsigned long milliseconds);
+
+	// append the histogram (in seconds) to the text - labels may be empty
+	int render(char *text,int textSize,int length,const char *name,const char *labels) const;
+
+	MetricsHistogram();
+
+private:
+	// no copying
+	MetricsHistogram(const MetricsHistogram &);
+	MetricsHistogram &operator=(const MetricsHistogram &);
+
+	volatile long long buckets[BUCKET_COUNT];
+	volatile long long sumMilliseconds;
+
+};
+
+} // namespace SrvStart
+
+#endif // !defined(__METRICS_H__)
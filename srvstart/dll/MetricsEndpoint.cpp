@@ -0,0 +1,520 @@
+// ============================================================================
+//
+// FILE        : MetricsEndpoint.cpp
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : Implementation of MetricsEndpoint class
+//
+//               The endpoint thread waits (with select) for a connection on
+//               the listening socket, checking every so often whether it has
+//               been asked to stop.  Each connection is served in turn: the
+//               request line is read, the text rendered and written, and the
+//               connection closed.  Scrapes are rare and small, so nothing
+//               cleverer is needed.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// this is the "main" source file
+#define	SRVSTART_DLL
+
+// we are exporting the class
+#define	SRVSTART_DLL_EXPORT
+
+//
+// which platform are we running?
+//
+#if	defined(WIN32)
+#define	METRICS_PLATFORM_IS_WIN32	1
+#else
+#define	METRICS_PLATFORM_IS_WIN32	0
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// system headers
+#if	METRICS_PLATFORM_IS_WIN32
+#define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
+#include <winsock2.h>
+#include <windows.h>
+#include <process.h>
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#endif	// METRICS_PLATFORM_IS_WIN32
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// support headers
+#include <logger.h>
+
+// class headers
+#include "SrvStart.h"
+#include "MetricsEndpoint.h"
+
+// ============================================================================
+//
+// NAMESPACE DECLARATIONS
+//
+// ============================================================================
+
+using namespace SrvStart;
+
+// ============================================================================
+//
+// CONSTANT DEFINITIONS
+//
+// ============================================================================
+
+// sockets
+#if	METRICS_PLATFORM_IS_WIN32
+typedef SOCKET METRICS_SOCKET;
+#define	METRICS_NO_SOCKET		INVALID_SOCKET
+#define	METRICS_CLOSE_SOCKET	closesocket
+#define	METRICS_SOCKET_ERROR	WSAGetLastError()
+#else
+typedef int METRICS_SOCKET;
+#define	METRICS_NO_SOCKET		(-1)
+#define	METRICS_CLOSE_SOCKET	::close
+#define	METRICS_SOCKET_ERROR	errno
+#endif	// METRICS_PLATFORM_IS_WIN32
+
+// how often the thread checks whether it should stop (milliseconds)
+const int METRICS_POLL_INTERVAL = 250;
+
+// how long a client has to send its request (milliseconds)
+const int METRICS_REQUEST_TIMEOUT = 2000;
+
+// longest request header we read
+const int METRICS_MAX_REQUEST = 4096;
+
+// ============================================================================
+//
+// LOCAL CLASSES
+//
+// ============================================================================
+
+//
+// MetricsEndpoint data
+//
+struct MetricsEndpointData
+{
+	// listening socket, port and render function
+	METRICS_SOCKET                    listener;
+	unsigned short                    port;
+	MetricsEndpoint::RENDER_FUNCTION *renderFunction;
+	void                             *genericPointer;
+
+	// the endpoint thread, and the flag which tells it to stop
+	bool          threadRunning;
+	volatile bool threadStop;
+#if	METRICS_PLATFORM_IS_WIN32
+	HANDLE        thread;
+#else
+	pthread_t     thread;
+#endif	// METRICS_PLATFORM_IS_WIN32
+
+	// response (header and text) - used only by the endpoint thread
+	char response[MetricsEndpoint::MAX_TEXT+256];
+
+	// constructor
+	MetricsEndpointData()
+	{
+		listener       = METRICS_NO_SOCKET;
+		port           = 0;
+		renderFunction = 0;
+		genericPointer = 0;
+		threadRunning  = false;
+		threadStop     = false;
+	} ;
+
+} ;
+
+// ============================================================================
+//
+// LOCAL FUNCTION PROTOTYPES
+//
+// ============================================================================
+
+#if	METRICS_PLATFORM_IS_WIN32
+static unsigned __stdcall endpointMain(void *arg);
+#else
+static void *endpointMain(void *arg);
+#endif	// METRICS_PLATFORM_IS_WIN32
+static void serveConnection(MetricsEndpointData *d,METRICS_SOCKET connection);
+static bool waitReadable(METRICS_SOCKET s,int milliseconds);
+static void sendAll(METRICS_SOCKET s,const char *data,int length);
+
+// ============================================================================
+//
+// PUBLIC MEMBER FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// MEMBER FUNCTION : MetricsEndpoint::MetricsEndpoint
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : constructor - the endpoint is not open
+//
+// ============================================================================
+MetricsEndpoint::MetricsEndpoint()
+{
+	metricsEndpointData = new MetricsEndpointData;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : MetricsEndpoint::~MetricsEndpoint
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : destructor - closes the endpoint
+//
+// ============================================================================
+MetricsEndpoint::~MetricsEndpoint()
+{
+	close();
+	delete metricsEndpointData;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : MetricsEndpoint::open
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : listen on 127.0.0.1:<port>, and start the endpoint thread
+//
+// ARGUMENTS       : port           IN TCP port
+//                   renderFunction IN render function
+//                   genericPointer IN generic pointer passed to the function
+//
+// THROWS          : SrvStartException (if the port cannot be listened on)
+//
+// ============================================================================
+void MetricsEndpoint::open
+(
+	unsigned short   port,
+	RENDER_FUNCTION *renderFunction,
+	void            *genericPointer
+)
+throw (SrvStartException)
+{
+	MetricsEndpointData *d = metricsEndpointData;
+
+	LOGGER_LOG_DEBUG1("MetricsEndpoint::open(%u)",port)
+
+	close();
+	d->port           = port;
+	d->renderFunction = renderFunction;
+	d->genericPointer = genericPointer;
+
+#if	METRICS_PLATFORM_IS_WIN32
+	WSADATA wsaData;
+	if(WSAStartup(MAKEWORD(2,2),&wsaData)!=0)
+	{
+		LOGGER_LOG_ERROR1("MetricsEndpoint: unable to start Winsock, error=%d",GetLastError())
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_GENERAL_ERROR,"MetricsEndpoint","open")
+	}
+#endif	// METRICS_PLATFORM_IS_WIN32
+
+	// listen - on the loopback interface only
+	struct sockaddr_in address;
+	memset(&address,0,sizeof(address));
+	address.sin_family      = AF_INET;
+	address.sin_port        = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	d->listener = socket(AF_INET,SOCK_STREAM,0);
+	if((d->listener==METRICS_NO_SOCKET)
+		||(bind(d->listener,(struct sockaddr *)&address,sizeof(address))!=0)
+		||(listen(d->listener,SOMAXCONN)!=0))
+	{
+		LOGGER_LOG_ERROR2("MetricsEndpoint: unable to listen on 127.0.0.1:%u, error=%d",
+			port,METRICS_SOCKET_ERROR)
+		close();
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_GENERAL_ERROR,"MetricsEndpoint","open")
+	}
+
+	// start the thread
+	d->threadStop = false;
+#if	METRICS_PLATFORM_IS_WIN32
+	d->thread = (HANDLE)_beginthreadex(NULL,0,endpointMain,d,0,NULL);
+	d->threadRunning = (d->thread!=0);
+#else
+	d->threadRunning = (pthread_create(&d->thread,0,endpointMain,d)==0);
+#endif	// METRICS_PLATFORM_IS_WIN32
+	if(!d->threadRunning)
+	{
+		LOGGER_LOG_ERROR1("MetricsEndpoint: unable to start thread, error=%d",errno)
+		close();
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_GENERAL_ERROR,"MetricsEndpoint","open")
+	}
+
+	LOGGER_LOG_INFO1("MetricsEndpoint: serving http://127.0.0.1:%u/metrics",port)
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : MetricsEndpoint::close
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : stop the endpoint thread, and close the socket
+//
+// ============================================================================
+void MetricsEndpoint::close()
+{
+	MetricsEndpointData *d = metricsEndpointData;
+
+	if(d->listener==METRICS_NO_SOCKET)
+	{
+		return;
+	}
+
+	LOGGER_LOG_DEBUG1("MetricsEndpoint::close(%u)",d->port)
+
+	// the thread notices within METRICS_POLL_INTERVAL
+	if(d->threadRunning)
+	{
+		d->threadStop = true;
+#if	METRICS_PLATFORM_IS_WIN32
+		WaitForSingleObject(d->thread,INFINITE);
+		CloseHandle(d->thread);
+#else
+		pthread_join(d->thread,0);
+#endif	// METRICS_PLATFORM_IS_WIN32
+		d->threadRunning = false;
+	}
+
+	METRICS_CLOSE_SOCKET(d->listener);
+	d->listener = METRICS_NO_SOCKET;
+
+#if	METRICS_PLATFORM_IS_WIN32
+	WSACleanup();
+#endif	// METRICS_PLATFORM_IS_WIN32
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : MetricsEndpoint::isOpen
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : is the endpoint open?
+//
+// RETURNS         : true if it is
+//
+// ============================================================================
+bool MetricsEndpoint::isOpen() const
+{
+	return metricsEndpointData->listener!=METRICS_NO_SOCKET;
+}
+
+// ============================================================================
+//
+// LOCAL UTILITY FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : endpointMain
+//
+// DESCRIPTION     : endpoint thread - accept and serve connections until
+//                   asked to stop
+//
+// ARGUMENTS       : arg IN MetricsEndpointData
+//
+// ============================================================================
+#if	METRICS_PLATFORM_IS_WIN32
+static unsigned __stdcall endpointMain(void *arg)
+#else
+static void *endpointMain(void *arg)
+#endif	// METRICS_PLATFORM_IS_WIN32
+{
+	MetricsEndpointData *d = (MetricsEndpointData *)arg;
+
+	while(!d->threadStop)
+	{
+		if(!waitReadable(d->listener,METRICS_POLL_INTERVAL))
+		{
+			continue;
+		}
+		METRICS_SOCKET connection = accept(d->listener,0,0);
+		if(connection==METRICS_NO_SOCKET)
+		{
+			LOGGER_LOG_DEBUG1("MetricsEndpoint: accept failed, error=%d",METRICS_SOCKET_ERROR)
+			continue;
+		}
+		serveConnection(d,connection);
+		METRICS_CLOSE_SOCKET(connection);
+	}
+
+	return 0;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : serveConnection
+//
+// DESCRIPTION     : read one HTTP request and answer it - 200 with the
+//                   metrics for GET /metrics (or GET /), 404 or 405 otherwise,
+//                   or 500 if the metrics did not fit
+//
+// ARGUMENTS       : d          IN endpoint data
+//                   connection IN client socket
+//
+// ============================================================================
+static void serveConnection(MetricsEndpointData *d,METRICS_SOCKET connection)
+{
+	char request[METRICS_MAX_REQUEST];
+	int  length = 0;
+
+	// read up to the end of the header (the body, if any, is ignored)
+	request[0] = '\0';
+	while((length<(int)sizeof(request)-1)&&(strstr(request,"\r\n\r\n")==0)&&(strstr(request,"\n\n")==0))
+	{
+		if(!waitReadable(connection,METRICS_REQUEST_TIMEOUT))
+		{
+			return;
+		}
+		int received = recv(connection,request+length,sizeof(request)-1-length,0);
+		if(received<=0)
+		{
+			break;
+		}
+		length += received;
+		request[length] = '\0';
+	}
+
+	// request line: <method> <path> <version>
+	char method[16];
+	char path[256];
+	if(sscanf(request,"%15s %255s",method,path)!=2)
+	{
+		return;
+	}
+	char *query = strchr(path,'?');
+	if(query!=0) { *query = '\0'; }
+
+	const char *status;
+	int         textLength = 0;
+	char       *text = d->response+256;
+	if(strcmp(method,"GET")!=0)
+	{
+		status = "405 Method Not Allowed";
+	}
+	else if((strcmp(path,"/metrics")!=0)&&(strcmp(path,"/")!=0))
+	{
+		status = "404 Not Found";
+	}
+	else
+	{
+		status     = "200 OK";
+		textLength = d->renderFunction(text,MetricsEndpoint::MAX_TEXT,d->genericPointer);
+		if(textLength>=MetricsEndpoint::MAX_TEXT)
+		{
+			// better no scrape than a truncated one which looks complete
+			LOGGER_LOG_ERROR1("MetricsEndpoint: metrics are longer than %d bytes - scrape refused",MetricsEndpoint::MAX_TEXT)
+			status     = "500 Internal Server Error";
+			textLength = 0;
+		}
+	}
+
+	// the header goes just in front of the text
+	char header[256];
+	int  headerLength = snprintf(header,sizeof(header),
+		"HTTP/1.0 %s\r\n"
+		"Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+		"Content-Length: %d\r\n"
+		"Connection: close\r\n\r\n",status,textLength);
+	memcpy(text-headerLength,header,headerLength);
+	sendAll(connection,text-headerLength,headerLength+textLength);
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : waitReadable
+//
+// DESCRIPTION     : wait for a socket to become readable
+//
+// ARGUMENTS       : s            IN socket
+//                   milliseconds IN how long to wait
+//
+// RETURNS         : true if it is readable
+//
+// ============================================================================
+static bool waitReadable(METRICS_SOCKET s,int milliseconds)
+{
+	fd_set         readable;
+	struct timeval timeout;
+
+	FD_ZERO(&readable);
+	FD_SET(s,&readable);
+	timeout.tv_sec  = milliseconds/1000;
+	timeout.tv_usec = (milliseconds%1000)*1000;
+
+	return select((int)s+1,&readable,0,0,&timeout)>0;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : sendAll
+//
+// DESCRIPTION     : write all of a buffer to a socket (a client which stops
+//                   reading is dropped)
+//
+// ARGUMENTS       : s      IN socket
+//                   data   IN data
+//                   length IN length of data
+//
+// ============================================================================
+static void sendAll(METRICS_SOCKET s,const char *data,int length)
+{
+	while(length>0)
+	{
+		int sent = send(s,data,length,0);
+		if(sent<=0)
+		{
+			LOGGER_LOG_DEBUG1("MetricsEndpoint: send failed, error=%d",METRICS_SOCKET_ERROR)
+			return;
+		}
+		data   += sent;
+		length -= sent;
+	}
+}
@@ -0,0 +1,139 @@
+// ============================================================================
+//
+// FILE        : MetricsEndpoint.h
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : interface definition for MetricsEndpoint class
+//
+//               A MetricsEndpoint serves GET /metrics over HTTP on a TCP port
+//               bound to 127.0.0.1, for a Prometheus scraper (or curl) on the
+//               same machine.  The text is produced by the owner of the
+//               endpoint, through a callback, at the time of each request.
+//
+//               Unlike the ControlEndpoint, it has a thread of its own, so a
+//               scrape is answered even while the service is busy starting or
+//               stopping its command.  The callback is therefore called on
+//               that thread, and should only read values which are safe to
+//               read from there (see Metrics.h).
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// prevent multiple inclusion
+
+#if !defined(__METRICS_ENDPOINT_H__)
+#define __METRICS_ENDPOINT_H__
+
+// ============================================================================
+//
+// IMPORT / EXPORT
+//
+// ============================================================================
+
+//
+// if SRVSTART_DLL_EXPORT is #defined, then we are building the DLL
+//  and exporting the classes
+//
+// otherwise, we are building an executable which will link with the DLL at run-time
+//
+// -------------------------------------------------------------
+// APART FROM THE DLL ITSELF,
+//  ANY SOURCE FILE WHICH #includes THIS ONE SHOULD ENSURE THAT
+//  SRVSTART_DLL_EXPORT is not #defined
+// -------------------------------------------------------------
+//
+
+#ifdef SRVSTART_DLL_EXPORT
+#define SRVSTART_DLL_API __declspec(dllexport)
+#pragma message("exporting MetricsEndpoint")
+
+#else
+
+#ifdef	SRVSTART_DLL_LOCAL
+#pragma message("MetricsEndpoint is local")
+#define	SRVSTART_DLL_API
+
+#else
+
+#define SRVSTART_DLL_API __declspec(dllimport)
+#pragma message("importing MetricsEndpoint")
+
+#endif
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// namespace header
+#include "SrvStart.h"
+
+// forward declarations
+struct MetricsEndpointData;
+
+// ============================================================================
+//
+// NAMESPACE
+//
+// ============================================================================
+
+// all the DLL classes are defined within the SrvStart namespace
+namespace SrvStart {
+
+// ============================================================================
+//
+// MetricsEndpoint class
+//
+// ============================================================================
+class SRVSTART_DLL_API MetricsEndpoint
+{
+public:
+	// longest response body
+	enum { MAX_TEXT = 65536 };
+
+	// render function:  puts the metrics into text, and returns its length
+	//  (textSize if they did not fit - see Metrics::append)
+	typedef int RENDER_FUNCTION(char *text,int textSize,void *genericPointer);
+
+	// open and close the endpoint
+	void open(unsigned short port,RENDER_FUNCTION *renderFunction,void *genericPointer)
+		throw (SrvStartException);
+	void close();
+	bool isOpen() const;
+
+	// constructor and destructor
+	MetricsEndpoint();
+	virtual ~MetricsEndpoint();
+
+private:
+	// no copying
+	MetricsEndpoint(const MetricsEndpoint &);
+	MetricsEndpoint &operator=(const MetricsEndpoint &);
+
+private:	// data members - hidden data
+	struct MetricsEndpointData *metricsEndpointData;
+
+};
+
+} // namespace SrvStart
+
+#endif // !defined(__METRICS_ENDPOINT_H__)
@@ -11,6 +11,10 @@
 //
 //                         http://www.nick.rozanski.com/services.htm
 //
+//               On POSIX there is no SCM, and a much simpler implementation
+//               (at the end of this file) tells a systemd-compatible service
+//               manager the status instead, and takes its stop signals.
+//
 // MODIFICATION HISTORY
 // --------------------
 //
@@ -36,6 +40,15 @@
 // we are exporting the class
 #define	SRVSTART_DLL_EXPORT
 
+//
+// which platform are we running?
+//
+#if	defined(WIN32)
+#define	SCM_PLATFORM_IS_WIN32	1
+#else
+#define	SCM_PLATFORM_IS_WIN32	0
+#endif
+
 // ============================================================================
 //
 // PROJECT HEADER FILES
@@ -43,16 +56,26 @@
 // ============================================================================
 
 // system headers
+#if	SCM_PLATFORM_IS_WIN32
 #define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
 #include <windows.h>
 #include <process.h>
+#include <errno.h>
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#endif	// SCM_PLATFORM_IS_WIN32
 
 // support headers
 #include <logger.h>
 
 // class headers
-#include "Sleeper.h"
+#include "Clock.h"
+#include "DurationHistory.h"
 #include "ScmConnector.h"
+#include "SdNotifier.h"
 
 // ============================================================================
 //
@@ -62,13 +85,24 @@
 
 using namespace SrvStart;
 
+#if	SCM_PLATFORM_IS_WIN32
+
 // ============================================================================
 //
 // CONSTANT DEFINITIONS
 //
 // ============================================================================
 
-const int SERVICE_MAIN_WAIT_SECONDS = 1;
+// interval between the checkpoints reported while the service is starting or
+// stopping (serviceMain does not wake up at all while it is running)
+const int SERVICE_HEARTBEAT_SECONDS = 1;
+
+// wait hint reported with each checkpoint (a couple of heartbeats can be late)
+const DWORD SERVICE_WAIT_HINT_MILLISECONDS = 3*1000*SERVICE_HEARTBEAT_SECONDS;
+
+// while the service is starting or stopping, the wait hint is the rest of the
+//  time this percentage of its past starts or stops took (see DurationHistory)
+const int SERVICE_WAIT_HINT_PERCENTILE = 95;
 
 // ============================================================================
 //
@@ -78,8 +112,13 @@ const int SERVICE_MAIN_WAIT_SECONDS = 1;
 
 void threadMain(void *arg);
 void WINAPI serviceMain(DWORD argc,LPTSTR *argv);
-void WINAPI serviceCtrlHandler(DWORD opcode);
-void reportServiceStatus(DWORD status,DWORD checkPoint=0,DWORD waitHint=0) throw(SrvStartException);
+DWORD WINAPI serviceCtrlHandlerEx(DWORD control,DWORD eventType,LPVOID eventData,LPVOID context);
+void requestStop(ThreadMainData *threadMainData);
+void reportServiceStatus(ThreadMainData *threadMainData,DWORD status,DWORD checkPoint=0,DWORD waitHint=0)
+	throw(SrvStartException);
+void reportPendingStatus(ThreadMainData *threadMainData,DWORD status) throw(SrvStartException);
+DWORD getPendingState(ScmConnector::SCM_STATUSES scmStatus);
+DWORD getWaitHint(ThreadMainData *threadMainData,DWORD status);
 BOOL WINAPI shutdownHandler(DWORD ctrlType);
 
 // ============================================================================
@@ -102,8 +141,9 @@ BOOL WINAPI shutdownHandler(DWORD ctrlType);
 // we use the local class ThreadMainData for several reasons
 //  - it vastly simplifies the ScmConnector interface
 //  - we don't really want to publicise the internal data structure for this class
-//  - we have to store our internal data in a global variable, so that the Win32
-//    service management functions (serviceMain and serviceCtrlHandler) can access it
+//  - the Win32 service management functions (serviceMain and the control handler)
+//    must be able to find it:  there is one for each service hosted by this
+//    process, held in the ServiceTable below
 //
 
 class ThreadMainData
@@ -114,26 +154,43 @@ public:	// member functions
 	// =========== //
 	// constructor //
 	// =========== //
-	ThreadMainData(char *svcName,bool allowConnectErrors)
+	ThreadMainData(char *svcName,bool allowConnectErrors,bool shared)
+		: _sdNotifier(shared ? svcName : 0)
 	{
 		// parameters
 		_svcName = new char[strlen(svcName)+1];
 		strcpy(_svcName,svcName);
 		_allowConnectErrors = allowConnectErrors;
+		_shared             = shared;
 		// callbacks
 		_stopRequestedVar      = 0;
 		_stopRequestedEvent    = 0;
 		_stopRequestedFunction = 0;
 		_genericPointer        = 0;
+		_controlFunction       = 0;
+		_controlPointer        = 0;
+		_acceptPauseContinue   = false;
 		// internals
-		_scmStatus  = ScmConnector::STATUS_INITIALISING;
-		_checkPoint = 0;
+		_scmStatus      = ScmConnector::STATUS_INITIALISING;
+		_hServiceStatus = 0;
+		_checkPoint     = 0;
+		_phaseStarted   = 0;
+		_next           = 0;
+		InitializeCriticalSection(&_statusLock);
+		_statusChangedEvent = CreateEvent(NULL,FALSE,FALSE,NULL);
+		_connectedEvent     = CreateEvent(NULL,TRUE,FALSE,NULL);
 	}
 
 	// ========== //
 	// destructor //
 	// ========== //
-	~ThreadMainData() { delete _svcName; }
+	~ThreadMainData()
+	{
+		delete _svcName;
+		CloseHandle(_statusChangedEvent);
+		CloseHandle(_connectedEvent);
+		DeleteCriticalSection(&_statusLock);
+	}
 
 	// =================== //
 	// callbacks - install //
@@ -153,7 +210,12 @@ public:	// member functions
 		_stopRequestedFunction = stopRequestedFunction;
 		_genericPointer        = genericPointer;
 	}
-
+	void installControlCallback(ScmConnector::CONTROL_HANDLER_FUNCTION *controlFunction,void *genericPointer)
+	{
+		_controlFunction = controlFunction;
+		_controlPointer  = genericPointer;
+	}
+	void acceptPauseContinue(bool accept) { _acceptPauseContinue = accept; }
 
 	// =============== //
 	// callbacks - get //
@@ -162,53 +224,255 @@ public:	// member functions
 	HANDLE *getStopCallbackEvent() const { return _stopRequestedEvent; }
 	ScmConnector::STOP_HANDLER_FUNCTION *getStopCallbackFunction() const { return _stopRequestedFunction; }
 	void *getCallbackGenericPointer() const { return _genericPointer; }
+	ScmConnector::CONTROL_HANDLER_FUNCTION *getControlCallbackFunction() const { return _controlFunction; }
+	void *getControlGenericPointer() const { return _controlPointer; }
+	bool acceptsPauseContinue() const { return _acceptPauseContinue&&(_controlFunction!=0); }
 
 	// ============== //
 	// set properties //
 	// ============== //
-	void setScmStatus(ScmConnector::SCM_STATUSES scmStatus) { _scmStatus = scmStatus; }
+	// (returns true if a start or stop duration has been recorded - the caller
+	//  must then save the history once it has let go of the status lock, see
+	//  DurationSave)
+	bool setScmStatus(ScmConnector::SCM_STATUSES scmStatus)
+	{
+		bool recorded = false;
+		lockStatus();
+		if(scmStatus!=_scmStatus)
+		{
+			// learn how long the service takes to start and to stop (only
+			//  under the SCM - see serviceMain)
+			if(_hServiceStatus!=0)
+			{
+				recorded = recordDuration(_scmStatus,scmStatus);
+			}
+			// checkpoints start again for each pending status
+			_scmStatus  = scmStatus;
+			_checkPoint = 0;
+			// wake up the threads waiting for a change
+			if(scmStatus!=ScmConnector::STATUS_INITIALISING) { SetEvent(_connectedEvent); }
+			SetEvent(_statusChangedEvent);
+		}
+		unlockStatus();
+		return recorded;
+	}
 	void setServiceStatusHandle(SERVICE_STATUS_HANDLE hServiceStatus) { _hServiceStatus = hServiceStatus; }
+	void setNext(ThreadMainData *next) { _next = next; }
 
 	// ============== //
 	// get properties //
 	// ============== //
 	char *getSvcName() const { return _svcName; }
 	bool allowConnectErrors() const { return _allowConnectErrors; }
+	bool isShared() const { return _shared; }
 	ScmConnector::SCM_STATUSES getScmStatus() const { return _scmStatus; }
 	SERVICE_STATUS_HANDLE getServiceStatusHandle() const { return _hServiceStatus; }
 	int getAndIncrementCheckpoint() { return ++_checkPoint; }
+	DurationHistory &getDurationHistory() { return _durationHistory; }
+	void saveDurationHistory() const { _durationHistory.save(); }
+	unsigned long getPhaseElapsed() const { return (unsigned long)(Clock::getTicks()-_phaseStarted); }
+	HANDLE getStatusChangedEvent() const { return _statusChangedEvent; }
+	HANDLE getConnectedEvent() const { return _connectedEvent; }
+	SdNotifier &getSdNotifier() { return _sdNotifier; }
+	ThreadMainData *getNext() const { return _next; }
+
+	// ======================================================== //
+	// status lock (held while a status is set and reported, so //
+	//  that a heartbeat cannot report a status out of date)    //
+	// ======================================================== //
+	void lockStatus() { EnterCriticalSection(&_statusLock); }
+	void unlockStatus() { LeaveCriticalSection(&_statusLock); }
+
+private:	// member functions
+	// returns true if a duration has been recorded (and should be saved)
+	bool recordDuration(ScmConnector::SCM_STATUSES oldStatus,ScmConnector::SCM_STATUSES newStatus)
+	{
+		if((newStatus==ScmConnector::STATUS_STARTING)||(newStatus==ScmConnector::STATUS_STOPPING))
+		{
+			_phaseStarted = Clock::getTicks();
+		}
+		else
+		if((oldStatus==ScmConnector::STATUS_STARTING)&&(newStatus==ScmConnector::STATUS_RUNNING))
+		{
+			_durationHistory.record(DurationHistory::PHASE_START,getPhaseElapsed());
+			return true;
+		}
+		else
+		if((oldStatus==ScmConnector::STATUS_STOPPING)&&(newStatus==ScmConnector::STATUS_STOPPED))
+		{
+			_durationHistory.record(DurationHistory::PHASE_STOP,getPhaseElapsed());
+			return true;
+		}
+		return false;
+	}
 
 private:	// data members
 	// parameters
 	char *_svcName;
 	bool _allowConnectErrors;
+	bool _shared;	// one of several services hosted by this process
 
 	// callbacks
 	bool *_stopRequestedVar;
 	HANDLE *_stopRequestedEvent;
 	ScmConnector::STOP_HANDLER_FUNCTION *_stopRequestedFunction;
 	void *_genericPointer; // generic pointer supplied to installStopCallback
+	ScmConnector::CONTROL_HANDLER_FUNCTION *_controlFunction;
+	void *_controlPointer; // generic pointer supplied to installControlCallback
+	bool _acceptPauseContinue;
 
 	// internals
 	ScmConnector::SCM_STATUSES _scmStatus;
 	SERVICE_STATUS_HANDLE _hServiceStatus;
 	int _checkPoint;
+	DurationHistory _durationHistory;	// how long past starts and stops took
+	unsigned long long _phaseStarted;	// when it started starting or stopping
+	CRITICAL_SECTION _statusLock;
+	HANDLE _statusChangedEvent;	// auto-reset: serviceMain
+	HANDLE _connectedEvent;		// manual-reset: set once no longer initialising
+	SdNotifier _sdNotifier;		// systemd-compatible service manager (if any)
+	ThreadMainData *_next;		// next service in the ServiceTable
 
 	// prevent default constructor
 	ThreadMainData();
 
 };
 
+//
+// StatusLock holds the ThreadMainData status lock while it is in scope
+//
+
+class StatusLock
+{
+public:
+	StatusLock(ThreadMainData *threadMainData) : _threadMainData(threadMainData) { _threadMainData->lockStatus(); }
+	~StatusLock() { _threadMainData->unlockStatus(); }
+
+private:
+	ThreadMainData *_threadMainData;
+
+	// no copying
+	StatusLock(const StatusLock &);
+	StatusLock &operator=(const StatusLock &);
+};
+
+//
+// DurationSave writes the duration history, if a status change recorded a
+//  duration, once the status lock has been let go - declare it before the
+//  StatusLock, so that its destructor runs after the lock's (even when an
+//  exception is thrown)
+//
+
+class DurationSave
+{
+public:
+	DurationSave(ThreadMainData *threadMainData) : _threadMainData(threadMainData), _due(false) {}
+	~DurationSave() { if(_due) { _threadMainData->saveDurationHistory(); } }
+	void setDue(bool due) { _due = _due||due; }
+
+private:
+	ThreadMainData *_threadMainData;
+	bool            _due;
+
+	// no copying
+	DurationSave(const DurationSave &);
+	DurationSave &operator=(const DurationSave &);
+};
+
+//
+// ServiceTable holds the ThreadMainData of each service hosted by this process,
+//  in the order they were added (which is the order of the dispatch table)
+//
+//  - for a service in its own process, the ScmConnector adds it
+//  - for services sharing the process, setSharedServices adds them all first
+//
+// one thread (threadMain) connects the whole process to the SCM, and the SCM
+//  then calls serviceMain once for each service it starts, on a thread of its own
+//
+
+class ServiceTable
+{
+public:
+	ServiceTable() : _first(0), _last(0), _count(0), _dispatcherStarted(false), _shutdownHandlerInstalled(false)
+	{
+		InitializeCriticalSection(&_lock);
+	}
+	~ServiceTable() { DeleteCriticalSection(&_lock); }
+
+	// lock (held while the table is read or changed)
+	void lock() { EnterCriticalSection(&_lock); }
+	void unlock() { LeaveCriticalSection(&_lock); }
+
+	// services
+	void add(ThreadMainData *threadMainData)
+	{
+		if(_last==0) { _first = threadMainData; }
+		else { _last->setNext(threadMainData); }
+		_last = threadMainData;
+		_count++;
+	}
+	ThreadMainData *find(const char *svcName) const
+	{
+		for(ThreadMainData *threadMainData=_first; threadMainData!=0; threadMainData=threadMainData->getNext())
+		{
+			if(!_stricmp(threadMainData->getSvcName(),svcName)) { return threadMainData; }
+		}
+		return 0;
+	}
+	ThreadMainData *getFirst() const { return _first; }
+	int getCount() const { return _count; }
+
+	// the dispatcher (threadMain) and the shutdown handler are started once only
+	bool isDispatcherStarted() const { return _dispatcherStarted; }
+	void setDispatcherStarted() { _dispatcherStarted = true; }
+	bool installShutdownHandlerOnce()
+	{
+		bool install = !_shutdownHandlerInstalled;
+		_shutdownHandlerInstalled = true;
+		return install;
+	}
+
+private:
+	CRITICAL_SECTION _lock;
+	ThreadMainData *_first;
+	ThreadMainData *_last;
+	int _count;
+	bool _dispatcherStarted;
+	bool _shutdownHandlerInstalled;
+
+	// no copying
+	ServiceTable(const ServiceTable &);
+	ServiceTable &operator=(const ServiceTable &);
+};
+
+//
+// TableLock holds the ServiceTable lock while it is in scope
+//
+
+class TableLock
+{
+public:
+	TableLock(ServiceTable *serviceTable) : _serviceTable(serviceTable) { _serviceTable->lock(); }
+	~TableLock() { _serviceTable->unlock(); }
+
+private:
+	ServiceTable *_serviceTable;
+
+	// no copying
+	TableLock(const TableLock &);
+	TableLock &operator=(const TableLock &);
+};
+
 // ============================================================================
 //
 // GLOBAL VARIABLES
 //
 // ============================================================================
 
-// this is pretty awful but we have to use global storage
-// since there is no other way of passing this data into the serviceMain routine
-//  (what about Win32 Thread Local Storage??)
-ThreadMainData *G_threadMainData;
+// we have to use global storage, since there is no other way of passing this
+//  data into the serviceMain routine (the control handler is given its own
+//  service's ThreadMainData as its context)
+ServiceTable G_serviceTable;
 
 // ============================================================================
 //
@@ -224,6 +488,11 @@ ThreadMainData *G_threadMainData;
 //
 // DESCRIPTION     : constructor
 //
+//                   When this process hosts several services (see
+//                   setSharedServices), there is one ScmConnector for each,
+//                   created on a thread of its own:  each waits until the SCM
+//                   starts its service.
+//
 // ARGUMENTS       : srvName            IN name of command/service
 //                   allowConnectErrors IN if true, then failure to connect to
 //                                         SCM is not a fatal error
@@ -240,38 +509,57 @@ throw (SrvStartException)
 {
 	LOGGER_LOG_DEBUG1("ScmConnector::ScmConnector(%s)",srvName)
 
-	// initialise our global storage
-	G_threadMainData = new ThreadMainData(srvName,allowConnectErrors);
-
-	// straight away, start a thread to try and connect to SCM
-	unsigned long serviceMainThread  = _beginthread(threadMain,0,NULL);
-
-	// check if created ok
-	if(serviceMainThread<0)
+	bool startDispatcher;
 	{
-		LOGGER_LOG_ERROR1("failed to create service thread, error = %d",serviceMainThread)
-		G_threadMainData->setScmStatus(ScmConnector::STATUS_FAILED);
-		THROW_SRVSTART_EXCEPTION
-			(SRVSTART_EXCEPTION_GENERAL_ERROR,"ScmConnector","ScmConnector")
+		// find our service in the table (added by setSharedServices), or add it
+		TableLock tableLock(&G_serviceTable);
+		threadMainData = G_serviceTable.find(srvName);
+		if(threadMainData==0)
+		{
+			if(G_serviceTable.isDispatcherStarted())
+			{
+				LOGGER_LOG_ERROR1("service '%s' is not one of the services hosted by this process",srvName)
+				THROW_SRVSTART_EXCEPTION
+					(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ScmConnector","ScmConnector")
+			}
+			threadMainData = new ThreadMainData(srvName,allowConnectErrors,false);
+			G_serviceTable.add(threadMainData);
+		}
+
+		// the first ScmConnector starts the thread which connects to the SCM
+		startDispatcher = !G_serviceTable.isDispatcherStarted();
+		G_serviceTable.setDispatcherStarted();
 	}
 
-	// wait for thread status to change from "initialising"
-	//  - for a successful connect, serviceMain changes it to "starting"
-	//  - for a failed connect, threadMain changes it to "start as console"
-	while(true)
+	if(startDispatcher)
 	{
-		// sleep for one second
-		Sleeper::Sleep(1,"SCM connection");
+		// straight away, start a thread to try and connect to SCM
+		unsigned long serviceMainThread  = _beginthread(threadMain,0,NULL);
 
-		// are we still initialising?
-		if(G_threadMainData->getScmStatus()!=STATUS_INITIALISING)
+		// check if created ok
+		if(serviceMainThread==(unsigned long)-1)
 		{
-			// something has happened
-			LOGGER_LOG_DEBUG("status is no longer STATUS_INITIALISING")
-			break;
+			LOGGER_LOG_ERROR1("failed to create service thread, error = %d",errno)
+			{
+				TableLock tableLock(&G_serviceTable);
+				for(ThreadMainData *d=G_serviceTable.getFirst(); d!=0; d=d->getNext())
+				{
+					d->setScmStatus(ScmConnector::STATUS_FAILED);
+				}
+			}
+			THROW_SRVSTART_EXCEPTION
+				(SRVSTART_EXCEPTION_GENERAL_ERROR,"ScmConnector","ScmConnector")
 		}
 	}
 
+	// wait for thread status to change from "initialising"
+	//  - for a successful connect, serviceMain changes it to "starting"
+	//  - for a failed connect, threadMain changes it to "start as console"
+	//  - for a shared service the SCM never started, threadMain changes it to
+	//    "failed" when the last of the others has stopped
+	(void)WaitForSingleObject(threadMainData->getConnectedEvent(),INFINITE);
+	LOGGER_LOG_DEBUG("status is no longer STATUS_INITIALISING")
+
 }
 
 // ============================================================================
@@ -287,6 +575,58 @@ ScmConnector::~ScmConnector()
 {
 	LOGGER_LOG_DEBUG("ScmConnector::~ScmConnector()")
 
+	// the service's ThreadMainData stays in the table:  the SCM may still use it
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ScmConnector::setSharedServices
+//
+// ACCESS SPECIFIER: public static
+//
+// DESCRIPTION     : host several services in this process
+//                   (SERVICE_WIN32_SHARE_PROCESS) - one dispatch table entry is
+//                   made for each, and each reports its own status
+//
+//                   This must be called before the first ScmConnector is
+//                   created.  Then one ScmConnector is created for each
+//                   service (on a thread of its own), and any other name is
+//                   rejected.  Shared services can only run under the SCM.
+//
+// ARGUMENTS       : svcNames IN names of the services
+//                   svcCount IN number of services
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+void ScmConnector::setSharedServices
+(
+	char *svcNames[],
+	int   svcCount
+)
+throw (SrvStartException)
+{
+	LOGGER_LOG_DEBUG1("ScmConnector::setSharedServices(%d)",svcCount)
+
+	TableLock tableLock(&G_serviceTable);
+
+	if(G_serviceTable.getCount()!=0)
+	{
+		LOGGER_LOG_ERROR("setSharedServices: services have already been connected to the SCM")
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ScmConnector","setSharedServices")
+	}
+
+	for(int i=0; i<svcCount; i++)
+	{
+		if(G_serviceTable.find(svcNames[i])!=0)
+		{
+			LOGGER_LOG_ERROR1("setSharedServices: service '%s' is named twice",svcNames[i])
+			THROW_SRVSTART_EXCEPTION
+				(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ScmConnector","setSharedServices")
+		}
+		G_serviceTable.add(new ThreadMainData(svcNames[i],false,true));
+	}
 }
 
 // ============================================================================
@@ -302,6 +642,9 @@ ScmConnector::~ScmConnector()
 //                                      STATUS_RUNNING
 //                                      STATUS_STOPPING
 //                                      STATUS_STOPPED
+//                                      STATUS_PAUSING
+//                                      STATUS_PAUSED
+//                                      STATUS_CONTINUING
 //                   ignoreErrors  IN if true, do not throw an exception if error
 //                                    occurs
 //
@@ -317,8 +660,11 @@ throw (SrvStartException)
 {
 	LOGGER_LOG_DEBUG("ScmConnector::notifyScmStatus()")
 
-	// set internal status
-	G_threadMainData->setScmStatus(scmStatus);
+	// set internal status, and report it before serviceMain can
+	//  (a systemd-compatible service manager, if there is one, is told too)
+	DurationSave durationSave(threadMainData);
+	StatusLock statusLock(threadMainData);
+	durationSave.setDue(threadMainData->setScmStatus(scmStatus));
 
 #define	RETHROW_IF_NOT_IGNORE_ERRORS	\
 	catch (...) { if(!ignoreErrors) { throw; } }
@@ -329,31 +675,51 @@ throw (SrvStartException)
 		case STATUS_STARTING:
 			// report starting status to SCM
 			LOGGER_LOG_DEBUG1("notifying status %d (SERVICE_START_PENDING)",SERVICE_START_PENDING)
-			try
-			{
-				reportServiceStatus(SERVICE_START_PENDING,G_threadMainData->getAndIncrementCheckpoint(),SERVICE_MAIN_WAIT_SECONDS);
-			}
+			(void)threadMainData->getSdNotifier().notifyStatus("starting");
+			try { reportPendingStatus(threadMainData,SERVICE_START_PENDING); }
 			RETHROW_IF_NOT_IGNORE_ERRORS
 			break;
 
 		case STATUS_RUNNING:
 			// report running status to SCM
 			LOGGER_LOG_DEBUG1("notifying status %d (SERVICE_RUNNING)",SERVICE_RUNNING)
-			try { reportServiceStatus(SERVICE_RUNNING); }
+			(void)threadMainData->getSdNotifier().notifyReady("running");
+			threadMainData->getSdNotifier().startWatchdog();
+			try { reportServiceStatus(threadMainData,SERVICE_RUNNING); }
 			RETHROW_IF_NOT_IGNORE_ERRORS
 			break;
 
 		case STATUS_STOPPING:
 			// report stopping status to SCM
 			LOGGER_LOG_DEBUG1("notifying status %d (SERVICE_STOP_PENDING)",SERVICE_STOP_PENDING)
-			try { reportServiceStatus(SERVICE_STOP_PENDING); }
+			threadMainData->getSdNotifier().stopWatchdog();
+			(void)threadMainData->getSdNotifier().notifyStopping("stopping");
+			try { reportPendingStatus(threadMainData,SERVICE_STOP_PENDING); }
 			RETHROW_IF_NOT_IGNORE_ERRORS
 			break;
 
 		case STATUS_STOPPED:
 			// report stopping status to SCM
 			LOGGER_LOG_DEBUG1("notifying status %d (SERVICE_STOPPED)",SERVICE_STOPPED)
-			try { reportServiceStatus(SERVICE_STOPPED); }
+			threadMainData->getSdNotifier().stopWatchdog();
+			(void)threadMainData->getSdNotifier().notifyStatus("stopped");
+			try { reportServiceStatus(threadMainData,SERVICE_STOPPED); }
+			RETHROW_IF_NOT_IGNORE_ERRORS
+			break;
+
+		case STATUS_PAUSING:
+		case STATUS_CONTINUING:
+			// report pausing or continuing status to SCM
+			LOGGER_LOG_DEBUG1("notifying status %d (SERVICE_PAUSE_PENDING / SERVICE_CONTINUE_PENDING)",scmStatus)
+			try { reportPendingStatus(threadMainData,getPendingState(scmStatus)); }
+			RETHROW_IF_NOT_IGNORE_ERRORS
+			break;
+
+		case STATUS_PAUSED:
+			// report paused status to SCM
+			LOGGER_LOG_DEBUG1("notifying status %d (SERVICE_PAUSED)",SERVICE_PAUSED)
+			(void)threadMainData->getSdNotifier().notifyStatus("paused");
+			try { reportServiceStatus(threadMainData,SERVICE_PAUSED); }
 			RETHROW_IF_NOT_IGNORE_ERRORS
 			break;
 
@@ -366,6 +732,29 @@ throw (SrvStartException)
 	}
 }
 
+// ============================================================================
+//
+// MEMBER FUNCTION : ScmConnector::notifyMainPid
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : tell a systemd-compatible service manager (if there is
+//                   one) which process is now the service's main process -
+//                   called whenever the command is started or replaced
+//
+// ARGUMENTS       : pid IN process id of the command
+//
+// ============================================================================
+void ScmConnector::notifyMainPid
+(
+	unsigned long pid
+)
+{
+	LOGGER_LOG_DEBUG1("ScmConnector::notifyMainPid(%lu)",pid)
+
+	(void)threadMainData->getSdNotifier().notifyMainPid(pid);
+}
+
 // ============================================================================
 //
 // MEMBER FUNCTION : ScmConnector::getScmStatus
@@ -385,7 +774,7 @@ ScmConnector::SCM_STATUSES ScmConnector::getScmStatus() const
 {
 	LOGGER_LOG_DEBUG("ScmConnector::getScmStatus()")
 
-	return G_threadMainData->getScmStatus();
+	return threadMainData->getScmStatus();
 }
 
 // ============================================================================
@@ -412,7 +801,7 @@ void ScmConnector::installStopCallback
 	if(stopRequestedVar != 0)
 	{
 		// copy the location of the variable and set it to false
-		G_threadMainData->installStopCallback(stopRequestedVar);
+		threadMainData->installStopCallback(stopRequestedVar);
 		(*stopRequestedVar) = false;
 	}
 	else
@@ -450,7 +839,7 @@ void ScmConnector::installStopCallback
 	if(stopRequestedEvent != 0)
 	{
 		// copy the location of the event handle
-		G_threadMainData->installStopCallback(stopRequestedEvent);
+		threadMainData->installStopCallback(stopRequestedEvent);
 	}
 	else
 	{
@@ -488,7 +877,7 @@ void ScmConnector::installStopCallback
 	if(stopRequestedFunction != 0)
 	{
 		// copy the location of the function
-		G_threadMainData->installStopCallback(stopRequestedFunction,genericPointer);
+		threadMainData->installStopCallback(stopRequestedFunction,genericPointer);
 	}
 	else
 	{
@@ -499,6 +888,116 @@ void ScmConnector::installStopCallback
 	}
 }
 
+// ============================================================================
+//
+// MEMBER FUNCTION : ScmConnector::installControlCallback
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : install the callback for the PAUSE, CONTINUE and
+//                   PARAMCHANGE controls
+//
+//                   The function is called on the SCM's thread, so it should
+//                   only note the request for the service's own thread.  For a
+//                   PAUSE, the SCM is told the service is pausing until
+//                   STATUS_PAUSED is notified (or STATUS_RUNNING, if it could
+//                   not be paused);  for a CONTINUE, until STATUS_RUNNING is.
+//
+// ARGUMENTS       : controlFunction IN pointer to function
+//                   genericPointer  IN pointer which will be passed to
+//                                      (*controlFunction) when it is called
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+void ScmConnector::installControlCallback
+(
+	CONTROL_HANDLER_FUNCTION *controlFunction,
+	void                     *genericPointer
+) throw (SrvStartException)
+{
+	LOGGER_LOG_DEBUG("ScmConnector::installControlCallback()")
+
+	// is the supplied function pointer ok?
+	if(controlFunction != 0)
+	{
+		// copy the location of the function
+		threadMainData->installControlCallback(controlFunction,genericPointer);
+	}
+	else
+	{
+		// NULL pointer exception
+		LOGGER_LOG_ERROR("installControlCallback(): NULL callback pointer")
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ScmConnector","installControlCallback")
+	}
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ScmConnector::acceptPauseContinue
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : can the service be paused?  (Only if a control callback
+//                   has been installed too.)  The SCM is told the next time the
+//                   status is reported.
+//
+// ARGUMENTS       : accept IN true if it can
+//
+// ============================================================================
+void ScmConnector::acceptPauseContinue
+(
+	bool accept
+)
+{
+	LOGGER_LOG_DEBUG1("ScmConnector::acceptPauseContinue(%d)",accept)
+
+	threadMainData->acceptPauseContinue(accept);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ScmConnector::setPreshutdownTimeout
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : set how long the SCM waits for the service to stop after
+//                   it has been sent PRESHUTDOWN, before the system carries on
+//                   shutting down (the default is much shorter than most
+//                   commands need to stop cleanly)
+//
+//                   This is part of the service's configuration, so it takes
+//                   effect at the next shutdown.  A failure is only logged:  the
+//                   service account may not be allowed to change it.
+//
+// ARGUMENTS       : milliseconds IN timeout
+//
+// ============================================================================
+void ScmConnector::setPreshutdownTimeout
+(
+	unsigned long milliseconds
+)
+{
+	LOGGER_LOG_DEBUG1("ScmConnector::setPreshutdownTimeout(%lu)",milliseconds)
+
+	SC_HANDLE hSCM = OpenSCManager(NULL,NULL,SC_MANAGER_CONNECT);
+	SC_HANDLE hService = (hSCM==NULL) ? NULL :
+		OpenService(hSCM,threadMainData->getSvcName(),SERVICE_CHANGE_CONFIG);
+
+	SERVICE_PRESHUTDOWN_INFO preshutdownInfo;
+	preshutdownInfo.dwPreshutdownTimeout = milliseconds;
+	if((hService==NULL)
+		||(!ChangeServiceConfig2(hService,SERVICE_CONFIG_PRESHUTDOWN_INFO,&preshutdownInfo)))
+	{
+		LOGGER_LOG_INFO2("WARNING: failed to set preshutdown timeout of service '%s', error=%u",
+			threadMainData->getSvcName(),GetLastError())
+	}
+
+	if(hService!=NULL) { CloseServiceHandle(hService); }
+	if(hSCM!=NULL) { CloseServiceHandle(hSCM); }
+}
+
 // ============================================================================
 //
 // PRIVATE MEMBER FUNCTIONS
@@ -519,7 +1018,7 @@ void ScmConnector::installStopCallback
 //                   object.  This thread performs all of the interactions
 //                   with the SCM.
 //
-// ARGUMENTS       : arg IN void pointer to the ThreadMainData object
+// ARGUMENTS       : arg IN not used (the services are in G_serviceTable)
 //
 // ============================================================================
 void threadMain
@@ -529,36 +1028,60 @@ void threadMain
 {
 	LOGGER_LOG_DEBUG("threadMain()")
 
-	LOGGER_LOG_DEBUG1("trying to connecting to SCM for service '%s'",G_threadMainData->getSvcName())
+	// fill in service details - one entry for each service hosted by this process
+	//  (the table does not change once this thread has been started)
+	int                  svcCount      = G_serviceTable.getCount();
+	SERVICE_TABLE_ENTRY *DispatchTable = new SERVICE_TABLE_ENTRY[svcCount+1];
+	ThreadMainData      *threadMainData;
+	int                  i = 0;
 
-	// fill in service details
-	SERVICE_TABLE_ENTRY	DispatchTable[2];
-	DispatchTable[0].lpServiceName = TEXT(G_threadMainData->getSvcName());
-	DispatchTable[0].lpServiceProc = serviceMain;
-	DispatchTable[1].lpServiceName = NULL;
-	DispatchTable[1].lpServiceProc = NULL;
+	for(threadMainData=G_serviceTable.getFirst(); threadMainData!=0; threadMainData=threadMainData->getNext())
+	{
+		LOGGER_LOG_DEBUG1("trying to connecting to SCM for service '%s'",threadMainData->getSvcName())
+		DispatchTable[i].lpServiceName = threadMainData->getSvcName();
+		DispatchTable[i].lpServiceProc = serviceMain;
+		i++;
+	}
+	DispatchTable[i].lpServiceName = NULL;
+	DispatchTable[i].lpServiceProc = NULL;
 
 	// connect to the Service Control Manager
 	// if we are not running as a service, this will time out
-	if(!StartServiceCtrlDispatcher(DispatchTable))
+	//  (otherwise, it returns when every service started has stopped)
+	BOOL connected = StartServiceCtrlDispatcher(DispatchTable);
+	DWORD error    = GetLastError();
+
+	for(threadMainData=G_serviceTable.getFirst(); threadMainData!=0; threadMainData=threadMainData->getNext())
 	{
-		LOGGER_LOG_DEBUG("failed in call to StartServiceCtrlDispatcher")
-		// failed to connect to Service Control Manager
-		if(G_threadMainData->allowConnectErrors())
+		if(!connected)
 		{
-			// failure allowed - assume running from the console
-			LOGGER_LOG_INFO1("failed to connect to SCM for service %s (assuming console)",G_threadMainData->getSvcName())
-			G_threadMainData->setScmStatus(ScmConnector::STATUS_MUST_START_AS_CONSOLE);
+			LOGGER_LOG_DEBUG("failed in call to StartServiceCtrlDispatcher")
+			// failed to connect to Service Control Manager
+			if(threadMainData->allowConnectErrors())
+			{
+				// failure allowed - assume running from the console
+				LOGGER_LOG_INFO1("failed to connect to SCM for service %s (assuming console)",threadMainData->getSvcName())
+				threadMainData->setScmStatus(ScmConnector::STATUS_MUST_START_AS_CONSOLE);
+			}
+			else
+			{
+				// this is an error - report it
+				LOGGER_LOG_ERROR2("failed to connect to SCM for service %s, error=%u",threadMainData->getSvcName(),error)
+				// return with a failure status
+				threadMainData->setScmStatus(ScmConnector::STATUS_FAILED);
+			}
 		}
 		else
+		if(threadMainData->getScmStatus()==ScmConnector::STATUS_INITIALISING)
 		{
-			// this is an error - report it
-			LOGGER_LOG_ERROR2("failed to connect to SCM for service %s, error=%u",G_threadMainData->getSvcName(),GetLastError())
-			// return with a failure status
-			G_threadMainData->setScmStatus(ScmConnector::STATUS_FAILED);
+			// a shared service which the SCM never started - release its thread
+			LOGGER_LOG_INFO1("service %s was not started by the SCM",threadMainData->getSvcName())
+			threadMainData->setScmStatus(ScmConnector::STATUS_FAILED);
 		}
 	}
 
+	delete[] DispatchTable;
+
 	// this thread can just terminate now
 	LOGGER_LOG_DEBUG("threadMain is terminating")
 	return;
@@ -570,7 +1093,11 @@ void threadMain
 //
 // DESCRIPTION     : thread entry point for service thread
 //
-// ARGUMENTS       : argc, argv IN command-line arguments (not used)
+//                   The SCM calls this once for each service it starts, on a
+//                   thread of its own.
+//
+// ARGUMENTS       : argc, argv IN command-line arguments (argv[0] is the
+//                                 service name)
 //
 // ============================================================================
 void WINAPI serviceMain
@@ -581,95 +1108,120 @@ void WINAPI serviceMain
 {
 	LOGGER_LOG_DEBUG("serviceMain()")
 
+	// which service is this?  (a service in its own process may be started
+	//  under any name)
+	ThreadMainData *threadMainData;
+	if(G_serviceTable.getCount()==1)
+	{
+		threadMainData = G_serviceTable.getFirst();
+	}
+	else
+	{
+		threadMainData = (argc>0) ? G_serviceTable.find(argv[0]) : 0;
+		if(threadMainData==0)
+		{
+			LOGGER_LOG_ERROR1("serviceMain: service '%s' is not hosted by this process",
+				(argc>0) ? argv[0] : "")
+			return;
+		}
+	}
+
 	// register the service's Service Control Handler (SCH)
 	// the SCH will handle all requests passed to it by the Service Control Manager (SCM)
-	LOGGER_LOG_DEBUG1("registering SCH for service '%s'",G_threadMainData->getSvcName())
-	G_threadMainData->setServiceStatusHandle(
-			RegisterServiceCtrlHandler(G_threadMainData->getSvcName(),serviceCtrlHandler));
+	LOGGER_LOG_DEBUG1("registering SCH for service '%s'",threadMainData->getSvcName())
+	threadMainData->setServiceStatusHandle(
+			RegisterServiceCtrlHandlerEx(threadMainData->getSvcName(),serviceCtrlHandlerEx,threadMainData));
 
-	if (G_threadMainData->getServiceStatusHandle() == 0)
+	if (threadMainData->getServiceStatusHandle() == 0)
 	{
 		// failed to register Service Control Handler
 		LOGGER_LOG_ERROR1("failed to register SCH, error=%d",GetLastError())
 		// return with a failure status
-		G_threadMainData->setScmStatus(ScmConnector::STATUS_FAILED);
+		threadMainData->setScmStatus(ScmConnector::STATUS_FAILED);
 		// report a "start pending" status
-		reportServiceStatus(SERVICE_STOPPED);
+		reportServiceStatus(threadMainData,SERVICE_STOPPED);
 		return;
 	}
 
-	// we have connected - change our status from "initialising" to "starting"
-	G_threadMainData->setScmStatus(ScmConnector::STATUS_STARTING);
+	// how long has this service taken to start and stop before?
+	threadMainData->getDurationHistory().load(threadMainData->getSvcName());
 
-	// report a "start pending" status
+	// we have connected - change our status from "initialising" to "starting"
+	// and report a "start pending" status
 	try
 	{
-		reportServiceStatus(SERVICE_START_PENDING,G_threadMainData->getAndIncrementCheckpoint(),SERVICE_MAIN_WAIT_SECONDS);
+		StatusLock statusLock(threadMainData);
+		threadMainData->setScmStatus(ScmConnector::STATUS_STARTING);
+		reportPendingStatus(threadMainData,SERVICE_START_PENDING);
 	}
 	CATCH_AND_RETURN("serviceMain")
 
 	// install the console control handler to trap shutdown signals
+	//  (once only - it handles every service hosted by this process)
+	bool installShutdownHandler;
+	{
+		TableLock tableLock(&G_serviceTable);
+		installShutdownHandler = G_serviceTable.installShutdownHandlerOnce();
+	}
 	LOGGER_LOG_DEBUG("about to install console control (shutdown) handler")
-	if(SetConsoleCtrlHandler(shutdownHandler,TRUE)==0)
+	if(installShutdownHandler&&(SetConsoleCtrlHandler(shutdownHandler,TRUE)==0))
 	{
 		LOGGER_LOG_ERROR1("failed to install console control (shutdown) handler, error = %d",GetLastError())
-		G_threadMainData->setScmStatus(ScmConnector::STATUS_FAILED);
+		threadMainData->setScmStatus(ScmConnector::STATUS_FAILED);
 		return;
 	}
- 
-	// wait for things to happen
+
+	// wait for things to happen:  every change of status is reported when it
+	// is made (see ScmConnector::notifyScmStatus), so all we have to do here is
+	// report a checkpoint every heartbeat while it is starting or stopping
+	ScmConnector::SCM_STATUSES lastStatus = ScmConnector::STATUS_STARTING;
 	int waitCount = 0;
+	bool overrunReported = false;
 	while(true)
 	{
-		// sleep
-		Sleeper::Sleep(SERVICE_MAIN_WAIT_SECONDS,"service event");
-
 		// get current status of program
-		ScmConnector::SCM_STATUSES srvstartStatus = G_threadMainData->getScmStatus();
+		ScmConnector::SCM_STATUSES srvstartStatus = threadMainData->getScmStatus();
+		DWORD                      timeout        = INFINITE;
+
+		if(srvstartStatus!=lastStatus)
+		{
+			// new status - clear wait count
+			lastStatus      = srvstartStatus;
+			waitCount       = 0;
+			overrunReported = false;
+		}
 
 		switch(srvstartStatus)
 		{
 			case ScmConnector::STATUS_STARTING:
 				// the service is still starting up
 				LOGGER_LOG_DEBUG("serviceMain wait: service has not started yet")
-				// we need to keep reporting this status to the SCM
-				try
-				{
-					reportServiceStatus(SERVICE_START_PENDING,
-										G_threadMainData->getAndIncrementCheckpoint(),SERVICE_MAIN_WAIT_SECONDS);
-				}
-				CATCH_AND_RETURN("serviceMain")
-
-				// warn if we have been here too long
-				if(((++waitCount)|60)==0)
-				{
-					// log a warning message
-					LOGGER_LOG_INFO2("WARNING: service '%s' has been starting for %d minutes",
-										G_threadMainData->getSvcName(),waitCount/60)
-				}
+				timeout = 1000*SERVICE_HEARTBEAT_SECONDS;
 				break;
 
 			case ScmConnector::STATUS_RUNNING:
 				// the service has started
 				// its status has already been reported to the SCM
 				LOGGER_LOG_DEBUG("serviceMain wait: service is running")
-				// clear wait count
-				waitCount = 0;
 				break;
 
 			case ScmConnector::STATUS_STOPPING:
 				// the service is stopping
 				LOGGER_LOG_DEBUG("serviceMain wait: service is stopping")
-				// we need to keep reporting this status to the SCM
-				try { reportServiceStatus(SERVICE_STOP_PENDING); }
-				CATCH_AND_RETURN("serviceMain")
-				// warn if we have been here too long
-				if(((waitCount++)|60)==0)
-				{
-					// log a warning message
-					LOGGER_LOG_INFO2("WARNING: service '%s' has been stopping for %d minutes",
-										G_threadMainData->getSvcName(),waitCount/60)
-				}
+				timeout = 1000*SERVICE_HEARTBEAT_SECONDS;
+				break;
+
+			case ScmConnector::STATUS_PAUSING:
+			case ScmConnector::STATUS_CONTINUING:
+				// the service is being paused or continued
+				LOGGER_LOG_DEBUG("serviceMain wait: service is pausing or continuing")
+				timeout = 1000*SERVICE_HEARTBEAT_SECONDS;
+				break;
+
+			case ScmConnector::STATUS_PAUSED:
+				// the service is paused
+				// its status has already been reported to the SCM
+				LOGGER_LOG_DEBUG("serviceMain wait: service is paused")
 				break;
 
 			case ScmConnector::STATUS_STOPPED:
@@ -682,144 +1234,284 @@ void WINAPI serviceMain
 
 			default:
 				LOGGER_LOG_ERROR1("global wait status %d - invalid",srvstartStatus)
-				G_threadMainData->setScmStatus(ScmConnector::STATUS_FAILED);
-				try { reportServiceStatus(SERVICE_STOPPED); }
+				threadMainData->setScmStatus(ScmConnector::STATUS_FAILED);
+				try { reportServiceStatus(threadMainData,SERVICE_STOPPED); }
 				CATCH_AND_RETURN("serviceMain")
-				break;
+				return;
 		}
-	}
 
-}
+		// wait for the status to change, or for the next heartbeat
+		if(WaitForSingleObject(threadMainData->getStatusChangedEvent(),timeout)==WAIT_OBJECT_0)
+		{
+			continue;
+		}
+
+		// heartbeat - we need to keep reporting a pending status to the SCM
+		// (unless it has just changed, in which case it has been reported)
+		try
+		{
+			StatusLock statusLock(threadMainData);
+			if(threadMainData->getScmStatus()!=srvstartStatus) { continue; }
+			reportPendingStatus(threadMainData,getPendingState(srvstartStatus));
+
+			// warn as soon as it is taking longer than it nearly always has
+			if((!overrunReported)&&(srvstartStatus==ScmConnector::STATUS_STARTING
+									||srvstartStatus==ScmConnector::STATUS_STOPPING))
+			{
+				bool starting = (srvstartStatus==ScmConnector::STATUS_STARTING);
+				unsigned long expected = threadMainData->getDurationHistory().getPercentile(
+					starting ? DurationHistory::PHASE_START : DurationHistory::PHASE_STOP,
+					SERVICE_WAIT_HINT_PERCENTILE);
+				if((expected!=0)&&(threadMainData->getPhaseElapsed()>expected))
+				{
+					LOGGER_LOG_INFO4("WARNING: service '%s' has been %s for longer than %d%% of its past runs (%lu seconds)",
+										threadMainData->getSvcName(),(starting ? "starting" : "stopping"),
+										SERVICE_WAIT_HINT_PERCENTILE,expected/1000)
+					overrunReported = true;
+				}
+			}
+		}
+		CATCH_AND_RETURN("serviceMain")
+
+		// warn if we have been here too long
+		if(((++waitCount)%(60/SERVICE_HEARTBEAT_SECONDS))==0)
+		{
+			// log a warning message
+			const char *pending;
+			switch(srvstartStatus)
+			{
+				case ScmConnector::STATUS_STARTING:   pending = "starting";   break;
+				case ScmConnector::STATUS_PAUSING:    pending = "pausing";    break;
+				case ScmConnector::STATUS_CONTINUING: pending = "continuing"; break;
+				default:                              pending = "stopping";   break;
+			}
+			LOGGER_LOG_INFO3("WARNING: service '%s' has been %s for %d minutes",
+								threadMainData->getSvcName(),pending,
+								waitCount*SERVICE_HEARTBEAT_SECONDS/60)
+		}
+	}
+
+}
 
 // ============================================================================
-//
-// LOCAL FUNCTION  : serviceCtrlHandler
-//
-// DESCRIPTION     : service control handler (responds to service status
-//                   requests from SCM)
-//
-// ARGUMENTS       : opcode IN request from SCM (stop, status)
-//
-// ============================================================================
-void WINAPI serviceCtrlHandler
+//
+// LOCAL FUNCTION  : serviceCtrlHandlerEx
+//
+// DESCRIPTION     : service control handler (responds to controls sent by the
+//                   SCM)
+//
+//                   STOP, SHUTDOWN and PRESHUTDOWN all stop the service.
+//                   PRESHUTDOWN comes first, while the SCM will still wait for
+//                   the service (see ScmConnector::setPreshutdownTimeout), so
+//                   the command has as long as possible to stop cleanly.
+//
+//                   PAUSE, CONTINUE and PARAMCHANGE are passed to the control
+//                   callback, if there is one.
+//
+// ARGUMENTS       : control   IN control from SCM
+//                   eventType IN not used (device and session events only)
+//                   eventData IN not used
+//                   context   IN the service's ThreadMainData (see serviceMain)
+//
+// RETURNS         : NO_ERROR, or ERROR_CALL_NOT_IMPLEMENTED if the control is
+//                   not supported
+//
+// ============================================================================
+DWORD WINAPI serviceCtrlHandlerEx
 (
-	DWORD opcode
+	DWORD  control,
+	DWORD  eventType,
+	LPVOID eventData,
+	LPVOID context
 )
 {
-	LOGGER_LOG_DEBUG1("serviceCtrlHandler: opcode is %d",opcode)
+	LOGGER_LOG_DEBUG1("serviceCtrlHandlerEx: control is %d",control)
 
+	ThreadMainData *threadMainData = (ThreadMainData*)context;
 	ScmConnector::SCM_STATUSES svcStatus;
-	bool stopActionTaken;
+	ScmConnector::CONTROL_HANDLER_FUNCTION *controlFunction = threadMainData->getControlCallbackFunction();
+	void *controlPointer = threadMainData->getControlGenericPointer();
 
-	// act on the supplied opcode
-	switch(opcode)
+	// act on the supplied control
+	switch(control)
 	{
+		case SERVICE_CONTROL_PRESHUTDOWN:
 		case SERVICE_CONTROL_SHUTDOWN:
 		case SERVICE_CONTROL_STOP:
 			// STOP SERVICE requested, or system is shutting down
-			LOGGER_LOG_DEBUG("serviceCtrlHandler: STOP requested")
-			stopActionTaken = false;
-
-			// tell everybody we are shutting down
-			G_threadMainData->setScmStatus(ScmConnector::STATUS_STOPPING);
-			// report "stopping" status to SCM
-			try { reportServiceStatus(SERVICE_STOP_PENDING); }
-			CATCH_AND_RETURN("serviceCtrlHandler")
+			LOGGER_LOG_DEBUG1("serviceCtrlHandlerEx: STOP requested (control %d)",control)
+			requestStop(threadMainData);
+			break;
 
-			// take appropriate action according to installed callbacks
-			if(G_threadMainData->getStopCallbackVar() != 0)
+		case SERVICE_CONTROL_PAUSE:
+		case SERVICE_CONTROL_CONTINUE:
+			// PAUSE or CONTINUE requested
+			if(!threadMainData->acceptsPauseContinue())
 			{
-				// we need to set the supplied variable to true
-				LOGGER_LOG_DEBUG("serviceCtrlHandler: setting stop variable true")
-				(*G_threadMainData->getStopCallbackVar()) = true;
-				stopActionTaken = true;
+				LOGGER_LOG_ERROR1("serviceCtrlHandlerEx: service '%s' cannot be paused",threadMainData->getSvcName())
+				return ERROR_CALL_NOT_IMPLEMENTED;
 			}
-
-			if(G_threadMainData->getStopCallbackEvent() != 0)
+			try
 			{
-				// we need to notify the supplied event
-				LOGGER_LOG_DEBUG("serviceCtrlHandler: notifying stop event")
-				
-				if(!SetEvent(*G_threadMainData->getStopCallbackEvent()))
+				// it can only be paused while it is running, and continued while it is paused
+				StatusLock statusLock(threadMainData);
+				bool pause = (control==SERVICE_CONTROL_PAUSE);
+				svcStatus = threadMainData->getScmStatus();
+				if(svcStatus!=(pause ? ScmConnector::STATUS_RUNNING : ScmConnector::STATUS_PAUSED))
 				{
-					// failed to notify event
-					LOGGER_LOG_ERROR2("failed to notify stop event for service %s, error=%u",
-						G_threadMainData->getSvcName(),GetLastError())
-
+					LOGGER_LOG_INFO2("WARNING: ignoring %s request for service '%s'",
+						(pause ? "pause" : "continue"),threadMainData->getSvcName())
+					break;
 				}
-				LOGGER_LOG_DEBUG("serviceCtrlHandler: stop event notified")
-				stopActionTaken = true;
+				svcStatus = (pause ? ScmConnector::STATUS_PAUSING : ScmConnector::STATUS_CONTINUING);
+				threadMainData->setScmStatus(svcStatus);
+				reportPendingStatus(threadMainData,getPendingState(svcStatus));
 			}
-
-
-			if(G_threadMainData->getStopCallbackFunction() != 0)
+			catch(...)
 			{
-				// we need to call the supplied function
-				LOGGER_LOG_DEBUG("serviceCtrlHandler: call stop function")
-				// pass the previously-supplied generic pointer as argument
-				(*G_threadMainData->getStopCallbackFunction())(G_threadMainData->getCallbackGenericPointer());
-				LOGGER_LOG_DEBUG("serviceCtrlHandler: stop function called")
-				stopActionTaken = true;
+				LOGGER_LOG_ERROR("serviceCtrlHandlerEx(): caught exception - returning")
+				return NO_ERROR;
 			}
+			(*controlFunction)(control==SERVICE_CONTROL_PAUSE ? ScmConnector::CONTROL_PAUSE :
+								ScmConnector::CONTROL_CONTINUE,controlPointer);
+			break;
 
-			// make sure we have done something!
-			if(!stopActionTaken)
+		case SERVICE_CONTROL_PARAMCHANGE:
+			// PARAMCHANGE requested - the service's parameters have changed
+			LOGGER_LOG_DEBUG("serviceCtrlHandlerEx: PARAMCHANGE requested")
+			if(controlFunction==0)
 			{
-				// issue a warning message
-				LOGGER_LOG_ERROR1("WARNING: there is no stop action for service '%s'",G_threadMainData->getSvcName())
+				return ERROR_CALL_NOT_IMPLEMENTED;
 			}
-
+			(*controlFunction)(ScmConnector::CONTROL_PARAMCHANGE,controlPointer);
 			break;
 
 		case SERVICE_CONTROL_INTERROGATE:
 			// INTERROGATE STATUS requested
-			LOGGER_LOG_DEBUG("serviceCtrlHandler: INTERROGATE requested")
+			LOGGER_LOG_DEBUG("serviceCtrlHandlerEx: INTERROGATE requested")
 
 			// get current status of started process
-			svcStatus = G_threadMainData->getScmStatus();
+			svcStatus = threadMainData->getScmStatus();
 
-			switch(svcStatus)
+			try
 			{
-				case ScmConnector::STATUS_STARTING:
-					// the service is starting
-					LOGGER_LOG_DEBUG("service is starting")
-					try { reportServiceStatus(SERVICE_START_PENDING); }
-					CATCH_AND_RETURN("serviceCtrlHandler")
-					break;
-
-				case ScmConnector::STATUS_RUNNING:
-					// the service is running
-					LOGGER_LOG_DEBUG("service is running")
-					try { reportServiceStatus(SERVICE_RUNNING); }
-					CATCH_AND_RETURN("serviceCtrlHandler")
-					break;
-
-				case ScmConnector::STATUS_STOPPING:
-					// the service is stopping
-					LOGGER_LOG_DEBUG("service is stopping")
-					try { reportServiceStatus(SERVICE_STOP_PENDING); }
-					CATCH_AND_RETURN("serviceCtrlHandler")
-					break;
-
-				default:
-					// the service has stopped or something bad has happened
-					LOGGER_LOG_DEBUG("service has stopped")
-					try { reportServiceStatus(SERVICE_STOPPED); }
-					CATCH_AND_RETURN("serviceCtrlHandler")
-					break;
+				switch(svcStatus)
+				{
+					case ScmConnector::STATUS_STARTING:
+					case ScmConnector::STATUS_STOPPING:
+					case ScmConnector::STATUS_PAUSING:
+					case ScmConnector::STATUS_CONTINUING:
+						// the service is starting, stopping, pausing or continuing
+						LOGGER_LOG_DEBUG1("service is in pending state %d",svcStatus)
+						reportServiceStatus(threadMainData,getPendingState(svcStatus));
+						break;
+
+					case ScmConnector::STATUS_RUNNING:
+						// the service is running
+						LOGGER_LOG_DEBUG("service is running")
+						reportServiceStatus(threadMainData,SERVICE_RUNNING);
+						break;
+
+					case ScmConnector::STATUS_PAUSED:
+						// the service is paused
+						LOGGER_LOG_DEBUG("service is paused")
+						reportServiceStatus(threadMainData,SERVICE_PAUSED);
+						break;
+
+					default:
+						// the service has stopped or something bad has happened
+						LOGGER_LOG_DEBUG("service has stopped")
+						reportServiceStatus(threadMainData,SERVICE_STOPPED);
+						break;
+				}
+			}
+			catch(...)
+			{
+				LOGGER_LOG_ERROR("serviceCtrlHandlerEx(): caught exception - returning")
 			}
 			break;
 
 		default:
-			// unsupported or unknown opcode
-			LOGGER_LOG_ERROR1("serviceCtrlHandler: unsupported or unknown op code %d",opcode)
-			;
+			// unsupported or unknown control
+			LOGGER_LOG_ERROR1("serviceCtrlHandlerEx: unsupported or unknown control %d",control)
+			return ERROR_CALL_NOT_IMPLEMENTED;
 	}
 
 	// return from the control handler - NB signalling STOPPED twice really upsets NT!!
-	LOGGER_LOG_DEBUG("returning from serviceCtrlHandler")
-	return;
+	LOGGER_LOG_DEBUG("returning from serviceCtrlHandlerEx")
+	return NO_ERROR;
+
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : requestStop
+//
+// DESCRIPTION     : report "stopping" status to the SCM, and take the action
+//                   of each installed stop callback
+//
+// ARGUMENTS       : threadMainData IN the service to stop
+//
+// ============================================================================
+void requestStop
+(
+	ThreadMainData *threadMainData
+)
+{
+	bool stopActionTaken = false;
+
+	// tell everybody we are shutting down, and report "stopping" status to SCM
+	try
+	{
+		DurationSave durationSave(threadMainData);
+		StatusLock statusLock(threadMainData);
+		durationSave.setDue(threadMainData->setScmStatus(ScmConnector::STATUS_STOPPING));
+		reportPendingStatus(threadMainData,SERVICE_STOP_PENDING);
+	}
+	CATCH_AND_RETURN("requestStop")
+
+	// take appropriate action according to installed callbacks
+	if(threadMainData->getStopCallbackVar() != 0)
+	{
+		// we need to set the supplied variable to true
+		LOGGER_LOG_DEBUG("requestStop: setting stop variable true")
+		(*threadMainData->getStopCallbackVar()) = true;
+		stopActionTaken = true;
+	}
+
+	if(threadMainData->getStopCallbackEvent() != 0)
+	{
+		// we need to notify the supplied event
+		LOGGER_LOG_DEBUG("requestStop: notifying stop event")
+		
+		if(!SetEvent(*threadMainData->getStopCallbackEvent()))
+		{
+			// failed to notify event
+			LOGGER_LOG_ERROR2("failed to notify stop event for service %s, error=%u",
+				threadMainData->getSvcName(),GetLastError())
+
+		}
+		LOGGER_LOG_DEBUG("requestStop: stop event notified")
+		stopActionTaken = true;
+	}
 
+
+	if(threadMainData->getStopCallbackFunction() != 0)
+	{
+		// we need to call the supplied function
+		LOGGER_LOG_DEBUG("requestStop: call stop function")
+		// pass the previously-supplied generic pointer as argument
+		(*threadMainData->getStopCallbackFunction())(threadMainData->getCallbackGenericPointer());
+		LOGGER_LOG_DEBUG("requestStop: stop function called")
+		stopActionTaken = true;
+	}
+
+	// make sure we have done something!
+	if(!stopActionTaken)
+	{
+		// issue a warning message
+		LOGGER_LOG_ERROR1("WARNING: there is no stop action for service '%s'",threadMainData->getSvcName())
+	}
 }
 
 // ============================================================================
@@ -842,7 +1534,19 @@ BOOL WINAPI shutdownHandler
 	if(ctrlType==CTRL_SHUTDOWN_EVENT)
 	{
 		LOGGER_LOG_DEBUG1("shutdownHandler: ctrlType is %d - shutting down",ctrlType)
-		G_threadMainData->setScmStatus(ScmConnector::STATUS_STOPPING);
+		// every service the SCM started is stopping (unless it has stopped already)
+		TableLock tableLock(&G_serviceTable);
+		for(ThreadMainData *threadMainData=G_serviceTable.getFirst(); threadMainData!=0;
+			threadMainData=threadMainData->getNext())
+		{
+			StatusLock statusLock(threadMainData);
+			if((threadMainData->getServiceStatusHandle()!=0)
+				&&(threadMainData->getScmStatus()!=ScmConnector::STATUS_STOPPED)
+				&&(threadMainData->getScmStatus()!=ScmConnector::STATUS_FAILED))
+			{
+				threadMainData->setScmStatus(ScmConnector::STATUS_STOPPING);
+			}
+		}
 	}
 	else
 	{
@@ -858,19 +1562,21 @@ BOOL WINAPI shutdownHandler
 //
 // DESCRIPTION    : report current status of service to SCM
 //
-// ARGUMENTS      : status     IN status to report (see Win32 SetServiceStatus
-//                                for valid values)
-//                  checkpoint IN checkpoint, used during startup only
-//                  waitHint   IN wait hint, used during startup only
+// ARGUMENTS      : threadMainData IN the service whose status it is
+//                  status         IN status to report (see Win32 SetServiceStatus
+//                                    for valid values)
+//                  checkpoint     IN checkpoint, used during startup only
+//                  waitHint       IN wait hint, used during startup only
 //
 // THROWS          : SrvStartException
 //
 // ============================================================================
 void reportServiceStatus
 (
-	DWORD status,
-	DWORD checkPoint,
-	DWORD waitHint
+	ThreadMainData *threadMainData,
+	DWORD           status,
+	DWORD           checkPoint,
+	DWORD           waitHint
 ) throw (SrvStartException)
 {
 	SERVICE_STATUS serviceStatus;
@@ -911,19 +1617,25 @@ void reportServiceStatus
 	}
 
 	// initialise service status information
-	// type of service:  Win32 service running in its own process
-	serviceStatus.dwServiceType             = SERVICE_WIN32;
+	// type of service:  Win32 service running in its own process, or sharing
+	//  this one with other services (see ScmConnector::setSharedServices)
+	serviceStatus.dwServiceType             = threadMainData->isShared() ?
+												SERVICE_WIN32_SHARE_PROCESS : SERVICE_WIN32;
 	// current state
 	serviceStatus.dwCurrentState            = status;
-	// what control codes will be accepted: stop
-	serviceStatus.dwControlsAccepted        = SERVICE_ACCEPT_STOP;
+	// what control codes will be accepted: stop, shutdown, preshutdown and
+	//  paramchange (and pause and continue, if the service can be paused)
+	serviceStatus.dwControlsAccepted        = SERVICE_ACCEPT_STOP|SERVICE_ACCEPT_SHUTDOWN|
+												SERVICE_ACCEPT_PRESHUTDOWN|SERVICE_ACCEPT_PARAMCHANGE|
+												(threadMainData->acceptsPauseContinue() ?
+													SERVICE_ACCEPT_PAUSE_CONTINUE : 0);
 	// other status information
 	serviceStatus.dwWin32ExitCode           = 0;
 	serviceStatus.dwServiceSpecificExitCode = 0;
 	serviceStatus.dwCheckPoint              = checkPoint;
 	serviceStatus.dwWaitHint                = waitHint;
 
-	if (!SetServiceStatus(G_threadMainData->getServiceStatusHandle(),&serviceStatus))
+	if (!SetServiceStatus(threadMainData->getServiceStatusHandle(),&serviceStatus))
 	{
 		// failed to report service status
 		LOGGER_LOG_ERROR2("failed to report status %d, error=%u",status,GetLastError())
@@ -931,3 +1643,711 @@ void reportServiceStatus
 			(SRVSTART_EXCEPTION_NOTIFY_FAILED,"","reportServiceStatus")
 	}
 }
+
+// ============================================================================
+//
+// LOCAL FUNCTION : reportPendingStatus
+//
+// DESCRIPTION    : report a pending status of the service to the SCM, with the
+//                  next checkpoint
+//
+// ARGUMENTS      : threadMainData IN the service whose status it is
+//                  status         IN SERVICE_START_PENDING, SERVICE_STOP_PENDING,
+//                                    SERVICE_PAUSE_PENDING or SERVICE_CONTINUE_PENDING
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+void reportPendingStatus
+(
+	ThreadMainData *threadMainData,
+	DWORD           status
+) throw (SrvStartException)
+{
+	reportServiceStatus(threadMainData,status,threadMainData->getAndIncrementCheckpoint(),
+							getWaitHint(threadMainData,status));
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION : getPendingState
+//
+// DESCRIPTION    : the SCM state to report while the service is starting,
+//                  stopping, pausing or continuing
+//
+// ARGUMENTS      : scmStatus IN STATUS_STARTING, STATUS_STOPPING,
+//                               STATUS_PAUSING or STATUS_CONTINUING
+//
+// RETURNS        : SERVICE_START_PENDING, SERVICE_STOP_PENDING,
+//                  SERVICE_PAUSE_PENDING or SERVICE_CONTINUE_PENDING
+//
+// ============================================================================
+DWORD getPendingState
+(
+	ScmConnector::SCM_STATUSES scmStatus
+)
+{
+	switch(scmStatus)
+	{
+		case ScmConnector::STATUS_STARTING:   return SERVICE_START_PENDING;
+		case ScmConnector::STATUS_PAUSING:    return SERVICE_PAUSE_PENDING;
+		case ScmConnector::STATUS_CONTINUING: return SERVICE_CONTINUE_PENDING;
+		default:                              return SERVICE_STOP_PENDING;
+	}
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION : getWaitHint
+//
+// DESCRIPTION    : the wait hint to report with a pending status
+//
+//                  While the service is starting or stopping, this is the
+//                  rest of the time it has taken to do so in nearly all of its
+//                  past runs, so that the SCM (and anyone waiting on it) can
+//                  tell a service which takes seconds from one which takes
+//                  minutes.  It is never less than a few heartbeats.
+//
+// ARGUMENTS      : threadMainData IN the service whose status it is
+//                  status         IN SERVICE_START_PENDING, SERVICE_STOP_PENDING,
+//                                    SERVICE_PAUSE_PENDING or SERVICE_CONTINUE_PENDING
+//
+// RETURNS        : wait hint in milliseconds
+//
+// ============================================================================
+DWORD getWaitHint
+(
+	ThreadMainData *threadMainData,
+	DWORD           status
+)
+{
+	DurationHistory::PHASES phase;
+	switch(status)
+	{
+		case SERVICE_START_PENDING: phase = DurationHistory::PHASE_START; break;
+		case SERVICE_STOP_PENDING:  phase = DurationHistory::PHASE_STOP;  break;
+		default:                    return SERVICE_WAIT_HINT_MILLISECONDS;
+	}
+
+	unsigned long expected = threadMainData->getDurationHistory().getPercentile(phase,SERVICE_WAIT_HINT_PERCENTILE);
+	unsigned long elapsed  = threadMainData->getPhaseElapsed();
+	if(expected<elapsed+SERVICE_WAIT_HINT_MILLISECONDS)
+	{
+		return SERVICE_WAIT_HINT_MILLISECONDS;
+	}
+	return expected-elapsed;
+}
+
+#else	// !SCM_PLATFORM_IS_WIN32
+
+// ============================================================================
+//
+// POSIX IMPLEMENTATION
+//
+//  There is no SCM here:  the service is run by a systemd-compatible service
+//  manager, which is told the status through SdNotifier, and which stops the
+//  service with SIGTERM (SIGINT does the same, for a service run from a
+//  terminal;  SIGHUP is passed on as PARAMCHANGE).  The signals are taken by
+//  a thread of their own (signalMain), so they must be blocked in every other
+//  thread:  the first ScmConnector blocks them, so it must be created before
+//  any other thread is started.  One service is run at a time.
+//
+// ============================================================================
+
+// ============================================================================
+//
+// STATIC (LOCAL) FUNCTION PROTOTYPES
+//
+// ============================================================================
+
+static void startSignalThread();
+static void *signalMain(void *arg);
+static void requestStop(ThreadMainData *threadMainData);
+
+// ============================================================================
+//
+// LOCAL CLASSES
+//
+// ============================================================================
+
+//
+// ThreadMainData holds the service's status and callbacks, as it does on Win32
+//
+
+class ThreadMainData
+{
+
+public:	// member functions
+
+	// =========== //
+	// constructor //
+	// =========== //
+	ThreadMainData(char *svcName)
+	{
+		// parameters
+		_svcName = new char[strlen(svcName)+1];
+		strcpy(_svcName,svcName);
+		// callbacks
+		_stopRequestedVar      = 0;
+		_stopRequestedFunction = 0;
+		_genericPointer        = 0;
+		_controlFunction       = 0;
+		_controlPointer        = 0;
+		_acceptPauseContinue   = false;
+		// internals
+		_scmStatus = ScmConnector::STATUS_INITIALISING;
+		pthread_mutex_init(&_statusLock,0);
+	}
+
+	// ========== //
+	// destructor //
+	// ========== //
+	~ThreadMainData()
+	{
+		delete[] _svcName;
+		pthread_mutex_destroy(&_statusLock);
+	}
+
+	// =================== //
+	// callbacks - install //
+	// =================== //
+	void installStopCallback(bool *stopRequestedVar)
+	{
+		LOGGER_LOG_DEBUG1("installStopCallback(bool @%p)",stopRequestedVar)
+		_stopRequestedVar = stopRequestedVar;
+		(*_stopRequestedVar) = false;
+	}
+	void installStopCallback(ScmConnector::STOP_HANDLER_FUNCTION *stopRequestedFunction,void *genericPointer)
+	{
+		_stopRequestedFunction = stopRequestedFunction;
+		_genericPointer        = genericPointer;
+	}
+	void installControlCallback(ScmConnector::CONTROL_HANDLER_FUNCTION *controlFunction,void *genericPointer)
+	{
+		_controlFunction = controlFunction;
+		_controlPointer  = genericPointer;
+	}
+	void acceptPauseContinue(bool accept) { _acceptPauseContinue = accept; }
+
+	// =============== //
+	// callbacks - get //
+	// =============== //
+	bool *getStopCallbackVar() const { return _stopRequestedVar; }
+	ScmConnector::STOP_HANDLER_FUNCTION *getStopCallbackFunction() const { return _stopRequestedFunction; }
+	void *getCallbackGenericPointer() const { return _genericPointer; }
+	ScmConnector::CONTROL_HANDLER_FUNCTION *getControlCallbackFunction() const { return _controlFunction; }
+	void *getControlGenericPointer() const { return _controlPointer; }
+
+	// ===================== //
+	// status (and its lock) //
+	// ===================== //
+	void setScmStatus(ScmConnector::SCM_STATUSES scmStatus) { _scmStatus = scmStatus; }
+	ScmConnector::SCM_STATUSES getScmStatus() const { return _scmStatus; }
+	void lockStatus() { pthread_mutex_lock(&_statusLock); }
+	void unlockStatus() { pthread_mutex_unlock(&_statusLock); }
+
+	// ============== //
+	// get properties //
+	// ============== //
+	char *getSvcName() const { return _svcName; }
+	SdNotifier &getSdNotifier() { return _sdNotifier; }
+
+private:	// data members
+	// parameters
+	char *_svcName;
+
+	// callbacks
+	bool *_stopRequestedVar;
+	ScmConnector::STOP_HANDLER_FUNCTION *_stopRequestedFunction;
+	void *_genericPointer; // generic pointer supplied to installStopCallback
+	ScmConnector::CONTROL_HANDLER_FUNCTION *_controlFunction;
+	void *_controlPointer; // generic pointer supplied to installControlCallback
+	bool _acceptPauseContinue;
+
+	// internals
+	ScmConnector::SCM_STATUSES _scmStatus;
+	pthread_mutex_t _statusLock;
+	SdNotifier _sdNotifier;		// systemd-compatible service manager (if any)
+
+	// prevent default constructor
+	ThreadMainData();
+
+};
+
+//
+// StatusLock holds the ThreadMainData status lock while it is in scope
+//
+
+class StatusLock
+{
+public:
+	StatusLock(ThreadMainData *threadMainData) : _threadMainData(threadMainData) { _threadMainData->lockStatus(); }
+	~StatusLock() { _threadMainData->unlockStatus(); }
+
+private:
+	ThreadMainData *_threadMainData;
+
+	// no copying
+	StatusLock(const StatusLock &);
+	StatusLock &operator=(const StatusLock &);
+};
+
+// ============================================================================
+//
+// LOCAL VARIABLES
+//
+// ============================================================================
+
+// the service the signals are for (0 if there is none), and its lock
+static ThreadMainData  *G_service     = 0;
+static pthread_mutex_t  G_serviceLock = PTHREAD_MUTEX_INITIALIZER;
+
+// the signal thread is started by the first ScmConnector
+static pthread_once_t G_signalThreadOnce = PTHREAD_ONCE_INIT;
+
+// ============================================================================
+//
+// PUBLIC MEMBER FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ScmConnector::ScmConnector
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : constructor - the service manager has already started
+//                   the service, so its status is "starting" straight away
+//
+// ARGUMENTS       : srvName            IN name of command/service
+//                   allowConnectErrors IN not used (there is nothing to
+//                                         connect to)
+//
+// THROWS          : SrvStartException if another service is running
+//
+// ============================================================================
+ScmConnector::ScmConnector
+(
+	char *srvName,
+	bool  allowConnectErrors
+)
+throw (SrvStartException)
+{
+	LOGGER_LOG_DEBUG1("ScmConnector::ScmConnector(%s)",srvName)
+
+	(void)allowConnectErrors;	// not used
+
+	// the signals are taken by a thread of their own
+	(void)pthread_once(&G_signalThreadOnce,startSignalThread);
+
+	threadMainData = new ThreadMainData(srvName);
+
+	pthread_mutex_lock(&G_serviceLock);
+	if(G_service!=0)
+	{
+		pthread_mutex_unlock(&G_serviceLock);
+		delete threadMainData;
+		LOGGER_LOG_ERROR1("service '%s' cannot run:  another service is running in this process",srvName)
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ScmConnector","ScmConnector")
+	}
+	G_service = threadMainData;
+	pthread_mutex_unlock(&G_serviceLock);
+
+	notifyScmStatus(STATUS_STARTING,true);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ScmConnector::~ScmConnector
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : destructor (later signals are ignored)
+//
+// ============================================================================
+ScmConnector::~ScmConnector()
+{
+	LOGGER_LOG_DEBUG("ScmConnector::~ScmConnector()")
+
+	pthread_mutex_lock(&G_serviceLock);
+	if(G_service==threadMainData) { G_service = 0; }
+	pthread_mutex_unlock(&G_serviceLock);
+
+	delete threadMainData;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ScmConnector::setSharedServices
+//
+// ACCESS SPECIFIER: public static
+//
+// DESCRIPTION     : host several services in this process - only under the
+//                   Win32 SCM
+//
+// ARGUMENTS       : svcNames IN names of the services
+//                   svcCount IN number of services
+//
+// THROWS          : SrvStartException always
+//
+// ============================================================================
+void ScmConnector::setSharedServices
+(
+	char *svcNames[],
+	int   svcCount
+)
+throw (SrvStartException)
+{
+	LOGGER_LOG_DEBUG1("ScmConnector::setSharedServices(%d)",svcCount)
+
+	(void)svcNames;	// not used
+	(void)svcCount;
+
+	LOGGER_LOG_ERROR("setSharedServices: services can only share a process under the SCM")
+	THROW_SRVSTART_EXCEPTION
+		(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ScmConnector","setSharedServices")
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ScmConnector::notifyScmStatus
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : notify status to the service manager:  READY=1 when
+//                   running (starting the watchdog, if one has been asked
+//                   for), STOPPING=1 when stopping, and STATUS= text
+//
+// ARGUMENTS       : status        IN status, as on Win32
+//                   ignoreErrors  IN not used (a notification that cannot be
+//                                    sent is only logged)
+//
+// THROWS          : SrvStartException if the status is not valid
+//
+// ============================================================================
+void ScmConnector::notifyScmStatus
+(
+	SCM_STATUSES scmStatus,
+	bool         ignoreErrors
+)
+throw (SrvStartException)
+{
+	LOGGER_LOG_DEBUG1("ScmConnector::notifyScmStatus(%d)",scmStatus)
+
+	(void)ignoreErrors;	// not used
+
+	StatusLock  statusLock(threadMainData);
+	SdNotifier &sdNotifier = threadMainData->getSdNotifier();
+
+	switch(scmStatus)
+	{
+		case STATUS_INITIALISING:
+		case STATUS_STARTING:
+			(void)sdNotifier.notifyStatus("starting");
+			break;
+
+		case STATUS_RUNNING:
+			(void)sdNotifier.notifyReady("running");
+			sdNotifier.startWatchdog();
+			break;
+
+		case STATUS_STOPPING:
+			sdNotifier.stopWatchdog();
+			(void)sdNotifier.notifyStopping("stopping");
+			break;
+
+		case STATUS_STOPPED:
+			sdNotifier.stopWatchdog();
+			(void)sdNotifier.notifyStatus("stopped");
+			break;
+
+		case STATUS_PAUSING:
+		case STATUS_CONTINUING:
+			break;
+
+		case STATUS_PAUSED:
+			(void)sdNotifier.notifyStatus("paused");
+			break;
+
+		default:
+			// error - ignore
+			LOGGER_LOG_ERROR1("ScmConnector::notifyScmStatus() called with invalid status %d",scmStatus)
+			THROW_SRVSTART_EXCEPTION
+				(SRVSTART_EXCEPTION_NOTIFY_FAILED,"ScmConnector","notifyScmStatus")
+			break;
+	}
+
+	threadMainData->setScmStatus(scmStatus);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ScmConnector::notifyMainPid
+//                   ScmConnector::getScmStatus
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : as on Win32
+//
+// ============================================================================
+void ScmConnector::notifyMainPid
+(
+	unsigned long pid
+)
+{
+	LOGGER_LOG_DEBUG1("ScmConnector::notifyMainPid(%lu)",pid)
+
+	(void)threadMainData->getSdNotifier().notifyMainPid(pid);
+}
+
+ScmConnector::SCM_STATUSES ScmConnector::getScmStatus() const
+{
+	LOGGER_LOG_DEBUG("ScmConnector::getScmStatus()")
+
+	StatusLock statusLock(threadMainData);
+	return threadMainData->getScmStatus();
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ScmConnector::installStopCallback
+//                   ScmConnector::installControlCallback
+//                   ScmConnector::acceptPauseContinue
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : install the callbacks, as on Win32 (the stop callback is
+//                   called on the signal thread;  the control callback is only
+//                   called for PARAMCHANGE, and pause is never asked for)
+//
+// THROWS          : SrvStartException if the callback is NULL
+//
+// ============================================================================
+void ScmConnector::installStopCallback
+(
+	bool *stopRequestedVar
+) throw (SrvStartException)
+{
+	LOGGER_LOG_DEBUG("ScmConnector::installStopCallback(bool)")
+
+	if(stopRequestedVar==0)
+	{
+		LOGGER_LOG_ERROR("installStopCallback(bool): NULL callback pointer")
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ScmConnector","installStopCallback")
+	}
+	threadMainData->installStopCallback(stopRequestedVar);
+}
+
+void ScmConnector::installStopCallback
+(
+	STOP_HANDLER_FUNCTION *stopRequestedFunction,
+	void                  *genericPointer
+) throw (SrvStartException)
+{
+	LOGGER_LOG_DEBUG("ScmConnector::installStopCallback(STOP_HANDLER_FUNCTION)")
+
+	if(stopRequestedFunction==0)
+	{
+		LOGGER_LOG_ERROR("installStopCallback(STOP_HANDLER_FUNCTION): NULL callback pointer")
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ScmConnector","installStopCallback")
+	}
+	threadMainData->installStopCallback(stopRequestedFunction,genericPointer);
+}
+
+void ScmConnector::installControlCallback
+(
+	CONTROL_HANDLER_FUNCTION *controlFunction,
+	void                     *genericPointer
+) throw (SrvStartException)
+{
+	LOGGER_LOG_DEBUG("ScmConnector::installControlCallback()")
+
+	if(controlFunction==0)
+	{
+		LOGGER_LOG_ERROR("installControlCallback(): NULL callback pointer")
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ScmConnector","installControlCallback")
+	}
+	threadMainData->installControlCallback(controlFunction,genericPointer);
+}
+
+void ScmConnector::acceptPauseContinue
+(
+	bool accept
+)
+{
+	LOGGER_LOG_DEBUG1("ScmConnector::acceptPauseContinue(%d)",accept)
+
+	threadMainData->acceptPauseContinue(accept);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ScmConnector::setPreshutdownTimeout
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : nothing to do - the service manager's own stop timeout
+//                   (eg TimeoutStopSec) applies
+//
+// ARGUMENTS       : milliseconds IN timeout
+//
+// ============================================================================
+void ScmConnector::setPreshutdownTimeout
+(
+	unsigned long milliseconds
+)
+{
+	LOGGER_LOG_DEBUG1("ScmConnector::setPreshutdownTimeout(%lu) - not used",milliseconds)
+
+	(void)milliseconds;	// not used
+}
+
+// ============================================================================
+//
+// LOCAL UTILITY FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : startSignalThread
+//
+// DESCRIPTION     : block the stop signals in this thread (and so in every
+//                   thread it starts from now on), and start the thread which
+//                   takes them
+//
+// ============================================================================
+static void startSignalThread()
+{
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals,SIGTERM);
+	sigaddset(&signals,SIGINT);
+	sigaddset(&signals,SIGHUP);
+	(void)pthread_sigmask(SIG_BLOCK,&signals,0);
+
+	pthread_t      signalThread;
+	pthread_attr_t attributes;
+	pthread_attr_init(&attributes);
+	pthread_attr_setdetachstate(&attributes,PTHREAD_CREATE_DETACHED);
+	int rc = pthread_create(&signalThread,&attributes,signalMain,0);
+	pthread_attr_destroy(&attributes);
+
+	if(rc!=0)
+	{
+		// the signals must not be lost
+		LOGGER_LOG_ERROR1("failed to create signal thread, error = %d",rc)
+		(void)pthread_sigmask(SIG_UNBLOCK,&signals,0);
+	}
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : signalMain
+//
+// DESCRIPTION     : signal thread - asks the service to stop on SIGTERM or
+//                   SIGINT, and passes SIGHUP on as PARAMCHANGE
+//
+// ARGUMENTS       : arg IN not used
+//
+// ============================================================================
+static void *signalMain
+(
+	void *arg
+)
+{
+	(void)arg;	// not used
+
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals,SIGTERM);
+	sigaddset(&signals,SIGINT);
+	sigaddset(&signals,SIGHUP);
+
+	while(true)
+	{
+		int signalNumber;
+		if(sigwait(&signals,&signalNumber)!=0)
+		{
+			continue;
+		}
+		LOGGER_LOG_DEBUG1("signalMain: received signal %d",signalNumber)
+
+		pthread_mutex_lock(&G_serviceLock);
+		ThreadMainData *threadMainData = G_service;
+		if(threadMainData==0)
+		{
+			LOGGER_LOG_INFO1("WARNING: signal %d ignored - no service is running",signalNumber)
+		}
+		else
+		if(signalNumber!=SIGHUP)
+		{
+			requestStop(threadMainData);
+		}
+		else
+		if(threadMainData->getControlCallbackFunction()!=0)
+		{
+			(*threadMainData->getControlCallbackFunction())
+				(ScmConnector::CONTROL_PARAMCHANGE,threadMainData->getControlGenericPointer());
+		}
+		pthread_mutex_unlock(&G_serviceLock);
+	}
+
+	return 0;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : requestStop
+//
+// DESCRIPTION     : tell the service manager the service is stopping, and
+//                   ask the service to stop (through its stop callbacks)
+//
+// ARGUMENTS       : threadMainData IN the service
+//
+// ============================================================================
+static void requestStop
+(
+	ThreadMainData *threadMainData
+)
+{
+	bool stopActionTaken = false;
+
+	LOGGER_LOG_INFO1("service '%s' has been asked to stop",threadMainData->getSvcName())
+
+	// tell the service manager we are stopping
+	{
+		StatusLock statusLock(threadMainData);
+		threadMainData->getSdNotifier().stopWatchdog();
+		(void)threadMainData->getSdNotifier().notifyStopping("stopping");
+		threadMainData->setScmStatus(ScmConnector::STATUS_STOPPING);
+	}
+
+	// take appropriate action according to installed callbacks
+	if(threadMainData->getStopCallbackVar() != 0)
+	{
+		LOGGER_LOG_DEBUG("requestStop: setting stop variable true")
+		(*threadMainData->getStopCallbackVar()) = true;
+		stopActionTaken = true;
+	}
+
+	if(threadMainData->getStopCallbackFunction() != 0)
+	{
+		LOGGER_LOG_DEBUG("requestStop: call stop function")
+		(*threadMainData->getStopCallbackFunction())(threadMainData->getCallbackGenericPointer());
+		stopActionTaken = true;
+	}
+
+	// make sure we have done something!
+	if(!stopActionTaken)
+	{
+		LOGGER_LOG_ERROR1("WARNING: there is no stop action for service '%s'",threadMainData->getSvcName())
+	}
+}
+
+#endif	// SCM_PLATFORM_IS_WIN32
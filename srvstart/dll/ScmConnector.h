@@ -11,6 +11,10 @@
 //
 //                         http://www.nick.rozanski.com/services.htm
 //
+//               On POSIX there is no SCM:  the status is sent to a
+//               systemd-compatible service manager (see SdNotifier), which
+//               stops the service with SIGTERM.
+//
 // MODIFICATION HISTORY
 // --------------------
 //
@@ -80,6 +84,9 @@
 // namespace header
 #include "SrvStart.h"
 
+// forward declarations
+class ThreadMainData;
+
 // ============================================================================
 //
 // NAMESPACE
@@ -99,7 +106,8 @@ class SRVSTART_DLL_API ScmConnector
 public:
 	// supported statuses
 	typedef enum SCM_STATUSES { STATUS_INITIALISING,STATUS_STARTING,STATUS_RUNNING,STATUS_STOPPING,
-								STATUS_STOPPED,STATUS_MUST_START_AS_CONSOLE,STATUS_FAILED };
+								STATUS_STOPPED,STATUS_MUST_START_AS_CONSOLE,STATUS_FAILED,
+								STATUS_PAUSING,STATUS_PAUSED,STATUS_CONTINUING };
 
 	// constructor
 	ScmConnector(char *svcName,bool allowConnectErrors = false) throw (SrvStartException);
@@ -110,17 +118,43 @@ public:
 	// service status
 	void notifyScmStatus(SCM_STATUSES scmStatus,bool ignoreErrors = false) throw (SrvStartException);
 	SCM_STATUSES getScmStatus() const;
+	void notifyMainPid(unsigned long pid);
 
 	// action to take if STOP requested by SCM
 	typedef void STOP_HANDLER_FUNCTION(void*);
 	void installStopCallback(bool *stopRequestedVar) throw (SrvStartException);
+#if	defined(WIN32)
 	void installStopCallback(HANDLE *stopRequestedEvent) throw (SrvStartException);
+#endif	// WIN32
 	void installStopCallback(STOP_HANDLER_FUNCTION *stopRequestedFunction,void *genericPointer)
 		throw (SrvStartException);
 
+	// action to take for the other controls sent by the SCM - the function is
+	//  called on the SCM's thread, and must only note the request:  a PAUSE
+	//  or CONTINUE is complete when STATUS_PAUSED or STATUS_RUNNING is notified
+	enum SCM_CONTROLS { CONTROL_PAUSE, CONTROL_CONTINUE, CONTROL_PARAMCHANGE };
+	typedef void CONTROL_HANDLER_FUNCTION(SCM_CONTROLS control,void*);
+	void installControlCallback(CONTROL_HANDLER_FUNCTION *controlFunction,void *genericPointer)
+		throw (SrvStartException);
+	void acceptPauseContinue(bool accept);
+
+	// time the SCM allows the service to stop before the system shuts down
+	void setPreshutdownTimeout(unsigned long milliseconds);
+
+	// host several services in this process (call this before the first
+	//  ScmConnector is created, then create one for each service)
+	static void setSharedServices(char *svcNames[],int svcCount) throw (SrvStartException);
+
 private: // no default constructor
 	ScmConnector();
 
+	// no copying
+	ScmConnector(const ScmConnector &);
+	ScmConnector &operator=(const ScmConnector &);
+
+private:	// data members - hidden data
+	ThreadMainData *threadMainData;
+
 };
 
 } // namespace SrvStart
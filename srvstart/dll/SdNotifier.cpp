@@ -0,0 +1,528 @@
+// ============================================================================
+//
+// FILE        : SdNotifier.cpp
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : Implementation of SdNotifier class
+//
+//               The socket is opened by the constructor, and each
+//               notification is written to it with a single sendto():  a
+//               datagram is delivered whole or not at all, so notifications
+//               from the watchdog thread and the service cannot interleave.
+//
+//               On Win32 the service is managed by the SCM (see ScmConnector),
+//               and an SdNotifier is never enabled.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// this is the "main" source file
+#define	SRVSTART_DLL
+
+// we are exporting the class
+#define	SRVSTART_DLL_EXPORT
+
+//
+// which platform are we running?
+//
+#if	defined(WIN32)
+#define	SDNOTIFY_PLATFORM_IS_WIN32	1
+#else
+#define	SDNOTIFY_PLATFORM_IS_WIN32	0
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// system headers
+#if	SDNOTIFY_PLATFORM_IS_WIN32
+#define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
+#include <windows.h>
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif	// SDNOTIFY_PLATFORM_IS_WIN32
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// support headers
+#include <logger.h>
+
+// class headers
+#include "SrvStart.h"
+#include "SdNotifier.h"
+
+// ============================================================================
+//
+// NAMESPACE DECLARATIONS
+//
+// ============================================================================
+
+using namespace SrvStart;
+
+// ============================================================================
+//
+// CONSTANT DEFINITIONS
+//
+// ============================================================================
+
+// longest notification we build ourselves (STATUS= text is truncated)
+const int SDNOTIFY_MAX_STATE = 512;
+
+// ============================================================================
+//
+// LOCAL CLASSES
+//
+// ============================================================================
+
+//
+// SdNotifier data
+//
+struct SdNotifierData
+{
+	// %NOTIFY_SOCKET% (0 if there is no service manager to notify)
+	char *socketPath;
+
+	// watchdog interval requested by %WATCHDOG_USEC% (0 if none)
+	unsigned long watchdogMilliseconds;
+
+#if	!SDNOTIFY_PLATFORM_IS_WIN32
+	// socket (opened by the constructor:  -1 if it could not be)
+	int socket;
+
+	// watchdog thread (which notifies through the owning SdNotifier)
+	SdNotifier     *owner;
+	pthread_t       watchdogThread;
+	bool            watchdogRunning;
+	bool            watchdogStop;
+	pthread_mutex_t watchdogMutex;
+	pthread_cond_t  watchdogCondition;
+#endif	// !SDNOTIFY_PLATFORM_IS_WIN32
+
+	// constructor / destructor
+	SdNotifierData()
+	{
+		socketPath           = 0;
+		watchdogMilliseconds = 0;
+#if	!SDNOTIFY_PLATFORM_IS_WIN32
+		socket          = -1;
+		owner           = 0;
+		watchdogRunning = false;
+		watchdogStop    = false;
+		pthread_mutex_init(&watchdogMutex,0);
+		pthread_cond_init(&watchdogCondition,0);
+#endif	// !SDNOTIFY_PLATFORM_IS_WIN32
+	} ;
+
+	virtual ~SdNotifierData()
+	{
+		delete[] socketPath;
+#if	!SDNOTIFY_PLATFORM_IS_WIN32
+		if(socket>=0) { close(socket); }
+		pthread_cond_destroy(&watchdogCondition);
+		pthread_mutex_destroy(&watchdogMutex);
+#endif	// !SDNOTIFY_PLATFORM_IS_WIN32
+	} ;
+
+} ;
+
+// ============================================================================
+//
+// LOCAL FUNCTION PROTOTYPES
+//
+// ============================================================================
+
+#if	!SDNOTIFY_PLATFORM_IS_WIN32
+static void *watchdogMain(void *arg);
+static const char *getIdentityEnv(const char *name,const char *identity);
+#endif	// !SDNOTIFY_PLATFORM_IS_WIN32
+
+// ============================================================================
+//
+// PUBLIC MEMBER FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SdNotifier::SdNotifier
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : constructor - picks up %NOTIFY_SOCKET%, %WATCHDOG_USEC%
+//                   and %WATCHDOG_PID% from the process environment, and
+//                   opens the socket
+//
+// ARGUMENTS       : identity IN service name, if this process hosts several
+//                               services (the variables are then suffixed
+//                               with _<identity>), or 0
+//
+// ============================================================================
+SdNotifier::SdNotifier
+(
+	const char *identity
+)
+{
+	sdNotifierData = new SdNotifierData;
+
+#if	!SDNOTIFY_PLATFORM_IS_WIN32
+	SdNotifierData *d = sdNotifierData;
+
+	// the socket must be a path, or a name in the abstract namespace
+	const char *socketPath = getIdentityEnv("NOTIFY_SOCKET",identity);
+	if(socketPath==0)
+	{
+		LOGGER_LOG_DEBUG1("SdNotifier: NOTIFY_SOCKET is not set for '%s'",
+			(identity!=0 ? identity : "this process"))
+		return;
+	}
+	if(((socketPath[0]!='/')&&(socketPath[0]!='@'))
+		||(strlen(socketPath)>=sizeof(((struct sockaddr_un *)0)->sun_path)))
+	{
+		LOGGER_LOG_ERROR1("SdNotifier: NOTIFY_SOCKET '%s' is not valid",socketPath)
+		return;
+	}
+	d->socketPath = new char[strlen(socketPath)+1];
+	strcpy(d->socketPath,socketPath);
+
+	// the watchdog applies to us only if WATCHDOG_PID is ours (or not set)
+	const char *watchdogUsec = getIdentityEnv("WATCHDOG_USEC",identity);
+	const char *watchdogPid  = getIdentityEnv("WATCHDOG_PID",identity);
+	if((watchdogUsec!=0)&&((watchdogPid==0)||(strtoul(watchdogPid,0,10)==(unsigned long)getpid())))
+	{
+		unsigned long usec = strtoul(watchdogUsec,0,10);
+		d->watchdogMilliseconds = (usec==0 ? 0 : (usec<1000 ? 1 : usec/1000));
+	}
+
+	// open the socket now, before the watchdog thread can notify too
+	d->socket = ::socket(AF_UNIX,SOCK_DGRAM|SOCK_CLOEXEC,0);
+	if(d->socket<0)
+	{
+		LOGGER_LOG_ERROR1("SdNotifier: unable to create socket, error=%d",errno)
+	}
+
+	LOGGER_LOG_DEBUG2("SdNotifier: NOTIFY_SOCKET is '%s', watchdog interval %lums",
+		d->socketPath,d->watchdogMilliseconds)
+#endif	// !SDNOTIFY_PLATFORM_IS_WIN32
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SdNotifier::~SdNotifier
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : destructor
+//
+// ============================================================================
+SdNotifier::~SdNotifier()
+{
+	stopWatchdog();
+	delete sdNotifierData;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SdNotifier::isEnabled
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : is there a service manager to notify?
+//
+// RETURNS         : true if there is
+//
+// ============================================================================
+bool SdNotifier::isEnabled() const
+{
+	return sdNotifierData->socketPath!=0;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SdNotifier::notify
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : send a notification to the service manager
+//
+// ARGUMENTS       : state IN NAME=VALUE lines, separated by newlines
+//
+// RETURNS         : true if it has been sent (false if there is no service
+//                   manager, or the socket cannot be written)
+//
+// ============================================================================
+bool SdNotifier::notify
+(
+	const char *state
+)
+{
+	SdNotifierData *d = sdNotifierData;
+
+	if(d->socketPath==0)
+	{
+		return false;
+	}
+
+#if	SDNOTIFY_PLATFORM_IS_WIN32
+	return false;
+#else
+	LOGGER_LOG_DEBUG1("SdNotifier::notify('%s')",state)
+
+	// the socket is only written here (sendto is safe from several threads)
+	if(d->socket<0)
+	{
+		return false;
+	}
+
+	// the address (a leading '@' is a NUL in the abstract namespace)
+	struct sockaddr_un address;
+	int                pathLength = strlen(d->socketPath);
+	memset(&address,0,sizeof(address));
+	address.sun_family = AF_UNIX;
+	memcpy(address.sun_path,d->socketPath,pathLength);
+	if(address.sun_path[0]=='@') { address.sun_path[0] = '\0'; }
+
+	if(sendto(d->socket,state,strlen(state),MSG_NOSIGNAL,(struct sockaddr *)&address,
+				offsetof(struct sockaddr_un,sun_path)+pathLength)<0)
+	{
+		LOGGER_LOG_ERROR2("SdNotifier: unable to notify '%s', error=%d",d->socketPath,errno)
+		return false;
+	}
+	return true;
+#endif	// SDNOTIFY_PLATFORM_IS_WIN32
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SdNotifier::notifyReady
+//                   SdNotifier::notifyStopping
+//                   SdNotifier::notifyStatus
+//                   SdNotifier::notifyMainPid
+//                   SdNotifier::notifyWatchdog
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : send the standard notifications:  READY=1, STOPPING=1,
+//                   STATUS=, MAINPID= and WATCHDOG=1
+//
+// ARGUMENTS       : status IN status text (may be NULL)
+//                   pid    IN process id of the main process
+//
+// RETURNS         : true if the notification has been sent
+//
+// ============================================================================
+bool SdNotifier::notifyReady(const char *status)
+{
+	char state[SDNOTIFY_MAX_STATE];
+	if(status==0) { return notify("READY=1"); }
+	snprintf(state,sizeof(state),"READY=1\nSTATUS=%s",status);
+	return notify(state);
+}
+bool SdNotifier::notifyStopping(const char *status)
+{
+	char state[SDNOTIFY_MAX_STATE];
+	if(status==0) { return notify("STOPPING=1"); }
+	snprintf(state,sizeof(state),"STOPPING=1\nSTATUS=%s",status);
+	return notify(state);
+}
+bool SdNotifier::notifyStatus(const char *status)
+{
+	char state[SDNOTIFY_MAX_STATE];
+	snprintf(state,sizeof(state),"STATUS=%s",(status==0 ? "" : status));
+	return notify(state);
+}
+bool SdNotifier::notifyMainPid(unsigned long pid)
+{
+	char state[SDNOTIFY_MAX_STATE];
+	snprintf(state,sizeof(state),"MAINPID=%lu",pid);
+	return notify(state);
+}
+bool SdNotifier::notifyWatchdog() { return notify("WATCHDOG=1"); }
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SdNotifier::getWatchdogInterval
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : get the watchdog interval requested by the service manager
+//
+// RETURNS         : interval in milliseconds (0 if no watchdog)
+//
+// ============================================================================
+unsigned long SdNotifier::getWatchdogInterval() const
+{
+	return sdNotifierData->watchdogMilliseconds;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SdNotifier::startWatchdog
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : start a thread which sends WATCHDOG=1 at half the
+//                   requested interval (if a watchdog has been requested)
+//
+// ============================================================================
+void SdNotifier::startWatchdog()
+{
+#if	!SDNOTIFY_PLATFORM_IS_WIN32
+	SdNotifierData *d = sdNotifierData;
+
+	if((d->socketPath==0)||(d->watchdogMilliseconds==0)||d->watchdogRunning)
+	{
+		return;
+	}
+
+	d->owner        = this;
+	d->watchdogStop = false;
+	if(pthread_create(&d->watchdogThread,0,watchdogMain,d)!=0)
+	{
+		LOGGER_LOG_ERROR1("SdNotifier: unable to start watchdog thread, error=%d",errno)
+		return;
+	}
+	d->watchdogRunning = true;
+	LOGGER_LOG_DEBUG1("SdNotifier: watchdog started (every %lums)",d->watchdogMilliseconds/2)
+#endif	// !SDNOTIFY_PLATFORM_IS_WIN32
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SdNotifier::stopWatchdog
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : stop the watchdog thread (if it is running)
+//
+// ============================================================================
+void SdNotifier::stopWatchdog()
+{
+#if	!SDNOTIFY_PLATFORM_IS_WIN32
+	SdNotifierData *d = sdNotifierData;
+
+	if(!d->watchdogRunning)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&d->watchdogMutex);
+	d->watchdogStop = true;
+	pthread_cond_signal(&d->watchdogCondition);
+	pthread_mutex_unlock(&d->watchdogMutex);
+	pthread_join(d->watchdogThread,0);
+	d->watchdogRunning = false;
+	LOGGER_LOG_DEBUG("SdNotifier: watchdog stopped")
+#endif	// !SDNOTIFY_PLATFORM_IS_WIN32
+}
+
+// ============================================================================
+//
+// LOCAL UTILITY FUNCTIONS
+//
+// ============================================================================
+
+#if	!SDNOTIFY_PLATFORM_IS_WIN32
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : watchdogMain
+//
+// DESCRIPTION     : watchdog thread - sends WATCHDOG=1 at half the requested
+//                   interval until it is stopped
+//
+// ARGUMENTS       : arg IN the SdNotifier's data
+//
+// ============================================================================
+static void *watchdogMain
+(
+	void *arg
+)
+{
+	SdNotifierData *d        = static_cast<SdNotifierData*>(arg);
+	unsigned long   interval = d->watchdogMilliseconds/2;
+
+	if(interval==0) { interval = 1; }
+
+	pthread_mutex_lock(&d->watchdogMutex);
+	while(!d->watchdogStop)
+	{
+		// wait for half the interval (or to be stopped)
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME,&deadline);
+		deadline.tv_sec  += interval/1000;
+		deadline.tv_nsec += (interval%1000)*1000000L;
+		if(deadline.tv_nsec>=1000000000L)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		if(pthread_cond_timedwait(&d->watchdogCondition,&d->watchdogMutex,&deadline)==ETIMEDOUT)
+		{
+			pthread_mutex_unlock(&d->watchdogMutex);
+			(void)d->owner->notifyWatchdog();
+			pthread_mutex_lock(&d->watchdogMutex);
+		}
+	}
+	pthread_mutex_unlock(&d->watchdogMutex);
+
+	return 0;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : getIdentityEnv
+//
+// DESCRIPTION     : get one of the service manager's variables for a service
+//
+// ARGUMENTS       : name     IN variable name (eg NOTIFY_SOCKET)
+//                   identity IN service name, if this process hosts several
+//                               services, or 0
+//
+// RETURNS         : %<name>_<identity>% (%<name>% if identity is 0), or 0 if
+//                   it is not set
+//
+// ============================================================================
+static const char *getIdentityEnv
+(
+	const char *name,
+	const char *identity
+)
+{
+	if(identity==0) { return getenv(name); }
+
+	char qualifiedName[SDNOTIFY_MAX_STATE];
+	if(snprintf(qualifiedName,sizeof(qualifiedName),"%s_%s",name,identity)>=(int)sizeof(qualifiedName))
+	{
+		return 0;
+	}
+	return getenv(qualifiedName);
+}
+
+#endif	// !SDNOTIFY_PLATFORM_IS_WIN32
@@ -0,0 +1,149 @@
+// ============================================================================
+//
+// FILE        : SdNotifier.h
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : interface definition for SdNotifier class
+//
+//               An SdNotifier tells a systemd-compatible service manager about
+//               the state of the service, using the sd_notify protocol:  each
+//               notification is a single datagram of NAME=VALUE lines, sent to
+//               the AF_UNIX socket named by %NOTIFY_SOCKET% (a leading '@'
+//               means the abstract namespace).  If %WATCHDOG_USEC% is set, a
+//               thread can send WATCHDOG=1 at half that interval.
+//
+//               No service manager library is needed.  If %NOTIFY_SOCKET% is
+//               not set (or on Win32, where the SCM is used instead), every
+//               notification is silently ignored.
+//
+//               When one process hosts several services, each has its own
+//               identity, and uses %NOTIFY_SOCKET_<identity>% (and
+//               %WATCHDOG_USEC_<identity>%, %WATCHDOG_PID_<identity>%) instead:
+//               a READY=1 on the shared socket would speak for all of them.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// prevent multiple inclusion
+
+#if !defined(__SD_NOTIFIER_H__)
+#define __SD_NOTIFIER_H__
+
+// ============================================================================
+//
+// IMPORT / EXPORT
+//
+// ============================================================================
+
+//
+// if SRVSTART_DLL_EXPORT is #defined, then we are building the DLL
+//  and exporting the classes
+//
+// otherwise, we are building an executable which will link with the DLL at run-time
+//
+// -------------------------------------------------------------
+// APART FROM THE DLL ITSELF,
+//  ANY SOURCE FILE WHICH #includes THIS ONE SHOULD ENSURE THAT
+//  SRVSTART_DLL_EXPORT is not #defined
+// -------------------------------------------------------------
+//
+
+#ifdef SRVSTART_DLL_EXPORT
+#define SRVSTART_DLL_API __declspec(dllexport)
+#pragma message("exporting SdNotifier")
+
+#else
+
+#ifdef	SRVSTART_DLL_LOCAL
+#pragma message("SdNotifier is local")
+#define	SRVSTART_DLL_API
+
+#else
+
+#define SRVSTART_DLL_API __declspec(dllimport)
+#pragma message("importing SdNotifier")
+
+#endif
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// namespace header
+#include "SrvStart.h"
+
+// forward declarations
+struct SdNotifierData;
+
+// ============================================================================
+//
+// NAMESPACE
+//
+// ============================================================================
+
+// all the DLL classes are defined within the SrvStart namespace
+namespace SrvStart {
+
+// ============================================================================
+//
+// SdNotifier class
+//
+// ============================================================================
+class SRVSTART_DLL_API SdNotifier {
+public:
+	// is there a service manager to notify?
+	bool isEnabled() const;
+
+	// send a notification (NAME=VALUE lines, separated by newlines)
+	bool notify(const char *state);
+
+	// send the standard notifications (status may be NULL)
+	bool notifyReady(const char *status);
+	bool notifyStopping(const char *status);
+	bool notifyStatus(const char *status);
+	bool notifyMainPid(unsigned long pid);
+	bool notifyWatchdog();
+
+	// watchdog (interval in milliseconds, 0 if none has been requested)
+	unsigned long getWatchdogInterval() const;
+	void startWatchdog();
+	void stopWatchdog();
+
+	// constructor (identity is the service's name, when one process hosts
+	//  several services) and destructor
+	SdNotifier(const char *identity = 0);
+	virtual ~SdNotifier();
+
+private:
+	// no copying
+	SdNotifier(const SdNotifier &);
+	SdNotifier &operator=(const SdNotifier &);
+
+private:	// data members - hidden data
+	struct SdNotifierData *sdNotifierData;
+
+};
+
+} // namespace SrvStart
+
+#endif // !defined(__SD_NOTIFIER_H__)
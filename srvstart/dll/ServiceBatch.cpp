@@ -0,0 +1,1263 @@
+// ============================================================================
+//
+// FILE        : ServiceBatch.cpp
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : Implementation of exported class ServiceBatch
+//
+//               Each line of the journal is one action which has been begun,
+//               with the configuration the service had before it:
+//
+//                  action<TAB>name<TAB>type<TAB>start<TAB>error<TAB>display<TAB>path<TAB>account
+//                        <TAB>description<TAB>dependencies
+//
+//               (dependencies separated by '/';  a journal written before the
+//               last two fields were added can still be rolled back).
+//
+//               An action is undone by removing the service it installed,
+//               changing a modified service back, or creating a removed one
+//               again - each of which is harmless if the action had not in
+//               fact been carried out.  A service is stopped before it is
+//               removed.  A password cannot be read back from the SCM, so a
+//               service running under an account which needs one is never
+//               removed:  plan() refuses it.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// this is the "main" source file
+#define	SRVSTART_DLL
+
+// we are exporting the class
+#define	SRVSTART_DLL_EXPORT
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// system headers
+#define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
+#include <windows.h>
+#include <process.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+// support headers
+#include <logger.h>
+
+// class headers
+#include "StringArena.h"
+#include "ServiceBatch.h"
+
+// ============================================================================
+//
+// NAMESPACE DECLARATIONS
+//
+// ============================================================================
+
+using namespace SrvStart;
+
+// ============================================================================
+//
+// CONSTANT DEFINITIONS
+//
+// ============================================================================
+
+// what a batch does to each service
+typedef enum BATCH_ACTIONS { ACTION_NONE, ACTION_INSTALL, ACTION_MODIFY, ACTION_REMOVE } ;
+static const char *BATCH_ACTION_NAMES[] = { "none", "install", "modify", "remove" };
+
+// the first line of a journal
+#define	BATCH_JOURNAL_HEADER	"# srvstart service batch journal"
+
+// longest line in a journal
+const int BATCH_JOURNAL_LINE = 8192;
+
+// fields in a journal line (and in one written before the description and
+//  dependencies were added)
+const int BATCH_JOURNAL_FIELDS     = 10;
+const int BATCH_JOURNAL_OLD_FIELDS = 8;
+
+// how long a service is given to stop before it is removed, or to go once
+//  it has been marked for deletion - and how often it is checked
+const DWORD BATCH_STOP_TIMEOUT = 30*1000;
+const DWORD BATCH_STOP_POLL    = 250;
+
+// ============================================================================
+//
+// LOCAL CLASSES
+//
+// ============================================================================
+
+//
+// the configuration of a service, as far as a batch is concerned
+//
+struct ServiceConfig
+{
+	DWORD       serviceType;
+	DWORD       startType;
+	DWORD       errorControl;
+	const char *displayName;
+	const char *binaryPath;
+	const char *account;		// 0 for LocalSystem
+	const char *description;
+	const char *dependencies;	// separated by '/'
+
+	ServiceConfig()
+	{
+		serviceType  = SERVICE_WIN32_OWN_PROCESS;
+		startType    = SERVICE_DEMAND_START;
+		errorControl = SERVICE_ERROR_IGNORE;
+		displayName  = "";
+		binaryPath   = "";
+		account      = 0;
+		description  = "";
+		dependencies = "";
+	} ;
+} ;
+
+//
+// one service in the batch
+//
+struct BatchEntry
+{
+	const char   *svcName;
+	bool          wanted;		// should the service exist?
+	ServiceConfig target;		// if so, like this
+	bool          exists;		// found by plan()
+	ServiceConfig current;		//  like this
+	BATCH_ACTIONS action;
+	BatchEntry   *next;
+
+	BatchEntry()
+	{
+		svcName = 0;
+		wanted  = false;
+		exists  = false;
+		action  = ACTION_NONE;
+		next    = 0;
+	} ;
+} ;
+
+//
+// ServiceBatch data
+//
+struct ServiceBatchData
+{
+	// handle to SCM (shared by every thread)
+	SC_HANDLE hSCM;
+
+	// the services, in the order they were added
+	BatchEntry *first;
+	BatchEntry *last;
+	int         count;
+	bool        planned;
+	StringArena arena;
+
+	// journal, and the actions begun (in the order they were journalled)
+	CRITICAL_SECTION journalLock;
+	FILE            *journal;
+	BatchEntry     **begun;
+	int              begunCount;
+
+	// constructor / destructor
+	ServiceBatchData()
+	{
+		hSCM       = NULL;
+		first      = 0;
+		last       = 0;
+		count      = 0;
+		planned    = false;
+		journal    = 0;
+		begun      = 0;
+		begunCount = 0;
+		InitializeCriticalSection(&journalLock);
+	} ;
+
+	virtual ~ServiceBatchData()
+	{
+		while(first!=0)
+		{
+			BatchEntry *entry = first;
+			first = entry->next;
+			delete entry;
+		}
+		delete[] begun;
+		if(journal!=0) { fclose(journal); }
+		if(hSCM!=NULL) { CloseServiceHandle(hSCM); }
+		DeleteCriticalSection(&journalLock);
+	} ;
+
+	// find a service in the batch
+	BatchEntry *find(const char *svcName) const
+	{
+		for(BatchEntry *entry=first;entry!=0;entry=entry->next)
+		{
+			if(_stricmp(entry->svcName,svcName)==0) { return entry; }
+		}
+		return 0;
+	} ;
+
+	// add a service to the batch
+	BatchEntry *add(const char *svcName) throw (SrvStartException)
+	{
+		if((svcName==0)||(svcName[0]=='\0')||(find(svcName)!=0))
+		{
+			LOGGER_LOG_ERROR1("ServiceBatch: service '%s' is missing or named twice",(svcName!=0 ? svcName : ""))
+			THROW_SRVSTART_EXCEPTION
+				(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ServiceBatch","add")
+		}
+		BatchEntry *entry = new BatchEntry;
+		entry->svcName = arena.copy(svcName);
+		if(last==0) { first = entry; } else { last->next = entry; }
+		last    = entry;
+		planned = false;
+		count++;
+		return entry;
+	} ;
+
+} ;
+
+//
+// the actions of one phase of apply(), shared by its threads
+//
+struct BatchPhase
+{
+	ServiceBatchData *d;
+	BatchEntry      **entries;
+	int               count;
+	volatile LONG     next;
+	volatile LONG     failed;
+} ;
+
+// ============================================================================
+//
+// LOCAL FUNCTION PROTOTYPES
+//
+// ============================================================================
+
+static bool runPhase(ServiceBatchData *d,BatchEntry **entries,int count,int maxThreads);
+static unsigned __stdcall phaseWorker(void *arg);
+static bool performAction(ServiceBatchData *d,BatchEntry *entry);
+static bool undoAction(SC_HANDLE hSCM,BATCH_ACTIONS action,const char *svcName,const ServiceConfig &old);
+static DWORD queryService(SC_HANDLE hSCM,const char *svcName,ServiceConfig *config,StringArena &arena);
+static DWORD createService(SC_HANDLE hSCM,const char *svcName,const ServiceConfig &config);
+static DWORD changeService(SC_HANDLE hSCM,const char *svcName,const ServiceConfig &config);
+static DWORD deleteService(SC_HANDLE hSCM,const char *svcName);
+static DWORD stopService(SC_HANDLE hService,const char *svcName);
+static bool needsPassword(const char *account);
+static void logScmError(const char *what,const char *svcName,DWORD error);
+static const char *startTypeName(DWORD startType);
+static SC_HANDLE openScm() throw (SrvStartException);
+static int splitJournalLine(char *line,char *fields[],int maxFields);
+
+// ============================================================================
+//
+// PUBLIC MEMBER FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceBatch::ServiceBatch
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : constructor - opens the SCM (once, for the whole batch)
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+ServiceBatch::ServiceBatch() throw (SrvStartException)
+{
+	LOGGER_LOG_DEBUG("ServiceBatch::ServiceBatch()")
+
+	serviceBatchData = new ServiceBatchData;
+	try { serviceBatchData->hSCM = openScm(); }
+	catch(...)
+	{
+		delete serviceBatchData;
+		throw;
+	}
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceBatch::~ServiceBatch
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : destructor
+//
+// ============================================================================
+ServiceBatch::~ServiceBatch()
+{
+	LOGGER_LOG_DEBUG("ServiceBatch::~ServiceBatch()")
+	delete serviceBatchData;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceBatch::addService
+//                   ServiceBatch::addRemoval
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : add a service which should exist, with the given
+//                   configuration, or which should not exist
+//
+// ARGUMENTS       : svcName        IN system name of service
+//                   displayName    IN display name (0 for the system name)
+//                   binaryPath     IN binary path (executable and parameters)
+//                   startType      IN when the service is started
+//                   desktopService IN can the service interact with the desktop?
+//
+// THROWS          : SrvStartException (if the service is already in the batch)
+//
+// ============================================================================
+void ServiceBatch::addService
+(
+	const char *svcName,
+	const char *displayName,
+	const char *binaryPath,
+	START_TYPES startType,
+	bool        desktopService
+) throw (SrvStartException)
+{
+	ServiceBatchData *d     = serviceBatchData;
+	BatchEntry       *entry = d->add(svcName);
+
+	entry->wanted                   = true;
+	entry->target.serviceType       = SERVICE_WIN32_OWN_PROCESS|(desktopService ? SERVICE_INTERACTIVE_PROCESS : 0);
+	entry->target.startType         = (startType==START_AUTO ? SERVICE_AUTO_START :
+										(startType==START_DISABLED ? SERVICE_DISABLED : SERVICE_DEMAND_START));
+	entry->target.displayName       = d->arena.copy(((displayName!=0)&&(displayName[0]!='\0')) ? displayName : svcName);
+	entry->target.binaryPath        = d->arena.copy(binaryPath);
+}
+
+void ServiceBatch::addRemoval
+(
+	const char *svcName
+) throw (SrvStartException)
+{
+	serviceBatchData->add(svcName)->wanted = false;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceBatch::plan
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : ask the SCM how each service is configured now, and decide
+//                   what to do to it
+//
+// RETURNS         : number of services to install, modify or remove
+//
+// THROWS          : SrvStartException (if a service cannot be queried)
+//
+// ============================================================================
+int ServiceBatch::plan() throw (SrvStartException)
+{
+	ServiceBatchData *d       = serviceBatchData;
+	int               actions = 0;
+
+	LOGGER_LOG_DEBUG1("ServiceBatch::plan() - %d services",d->count)
+
+	for(BatchEntry *entry=d->first;entry!=0;entry=entry->next)
+	{
+		DWORD error = queryService(d->hSCM,entry->svcName,&entry->current,d->arena);
+		if((error!=ERROR_SUCCESS)&&(error!=ERROR_SERVICE_DOES_NOT_EXIST))
+		{
+			logScmError("query",entry->svcName,error);
+			THROW_SRVSTART_EXCEPTION
+				(SRVSTART_EXCEPTION_GENERAL_ERROR,"ServiceBatch","plan")
+		}
+		entry->exists = (error==ERROR_SUCCESS);
+
+		if(entry->wanted&&(!entry->exists))
+		{
+			entry->action = ACTION_INSTALL;
+		}
+		else if(entry->wanted
+			&&((entry->current.serviceType!=entry->target.serviceType)
+				||(entry->current.startType!=entry->target.startType)
+				||(strcmp(entry->current.displayName,entry->target.displayName)!=0)
+				||(_stricmp(entry->current.binaryPath,entry->target.binaryPath)!=0)))
+		{
+			entry->action = ACTION_MODIFY;
+		}
+		else if((!entry->wanted)&&entry->exists)
+		{
+			// it could not be created again as it was, if the batch failed
+			if(needsPassword(entry->current.account))
+			{
+				LOGGER_LOG_ERROR2("service '%s' runs as '%s' - it cannot be removed by a batch, since its password could not be restored",
+					entry->svcName,entry->current.account)
+				THROW_SRVSTART_EXCEPTION
+					(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ServiceBatch","plan")
+			}
+			entry->action = ACTION_REMOVE;
+		}
+		else
+		{
+			entry->action = ACTION_NONE;
+		}
+		if(entry->action!=ACTION_NONE) { actions++; }
+	}
+
+	d->planned = true;
+	return actions;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceBatch::describe
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : describe what plan() has decided, one line per service -
+//                   and for a modification, what is to change
+//
+// ARGUMENTS       : printFunction  IN called for each line
+//                   genericPointer IN passed to printFunction
+//
+// ============================================================================
+void ServiceBatch::describe
+(
+	PRINT_FUNCTION *printFunction,
+	void           *genericPointer
+) const
+{
+	ServiceBatchData *d = serviceBatchData;
+	char              line[BATCH_JOURNAL_LINE];
+	int               length;
+
+	for(BatchEntry *entry=d->first;entry!=0;entry=entry->next)
+	{
+		const ServiceConfig &from = entry->current;
+		const ServiceConfig &to   = entry->target;
+		switch(entry->action)
+		{
+			case ACTION_INSTALL:
+				snprintf(line,sizeof(line),"install   %s: display '%s' start %s type 0x%lx path '%s'",
+					entry->svcName,to.displayName,startTypeName(to.startType),to.serviceType,to.binaryPath);
+				break;
+
+			case ACTION_MODIFY:
+				length = snprintf(line,sizeof(line),"modify    %s:",entry->svcName);
+				if((from.serviceType!=to.serviceType)&&(length<(int)sizeof(line)))
+				{
+					length += snprintf(line+length,sizeof(line)-length," type 0x%lx -> 0x%lx",
+						from.serviceType,to.serviceType);
+				}
+				if((from.startType!=to.startType)&&(length<(int)sizeof(line)))
+				{
+					length += snprintf(line+length,sizeof(line)-length," start %s -> %s",
+						startTypeName(from.startType),startTypeName(to.startType));
+				}
+				if((strcmp(from.displayName,to.displayName)!=0)&&(length<(int)sizeof(line)))
+				{
+					length += snprintf(line+length,sizeof(line)-length," display '%s' -> '%s'",
+						from.displayName,to.displayName);
+				}
+				if((_stricmp(from.binaryPath,to.binaryPath)!=0)&&(length<(int)sizeof(line)))
+				{
+					length += snprintf(line+length,sizeof(line)-length," path '%s' -> '%s'",
+						from.binaryPath,to.binaryPath);
+				}
+				break;
+
+			case ACTION_REMOVE:
+				snprintf(line,sizeof(line),"remove    %s: path '%s'",entry->svcName,from.binaryPath);
+				break;
+
+			default:
+				snprintf(line,sizeof(line),"unchanged %s%s",entry->svcName,
+					(entry->wanted ? "" : " (not installed)"));
+				break;
+		}
+		(*printFunction)(line,genericPointer);
+	}
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceBatch::apply
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : carry out the plan (making it first, if need be)
+//
+//                   Installs and modifications are made first, several at a
+//                   time, then removals.  If any action fails, no more are
+//                   started, and those begun are undone;  the journal is only
+//                   left behind if they cannot all be undone.
+//
+// ARGUMENTS       : journalPath IN journal file (which must not exist)
+//                   maxThreads  IN number of actions carried out at once
+//
+// THROWS          : SrvStartException (if the batch has failed)
+//
+// ============================================================================
+void ServiceBatch::apply
+(
+	const char *journalPath,
+	int         maxThreads
+) throw (SrvStartException)
+{
+	ServiceBatchData *d = serviceBatchData;
+	int               i;
+
+	LOGGER_LOG_DEBUG2("ServiceBatch::apply('%s',%d)",journalPath,maxThreads)
+
+	if(!d->planned)
+	{
+		(void)plan();
+	}
+
+	// a journal left behind must be dealt with first
+	FILE *previous = fopen(journalPath,"r");
+	if(previous!=0)
+	{
+		fclose(previous);
+		LOGGER_LOG_ERROR1("journal '%s' exists - a previous batch did not finish, and must be rolled back first",
+			journalPath)
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ServiceBatch","apply")
+	}
+	d->journal = fopen(journalPath,"w");
+	if(d->journal==0)
+	{
+		LOGGER_LOG_ERROR1("unable to create journal '%s'",journalPath)
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_GENERAL_ERROR,"ServiceBatch","apply")
+	}
+	fprintf(d->journal,"%s\n",BATCH_JOURNAL_HEADER);
+	fflush(d->journal);
+
+	// removals come last
+	BatchEntry **changes  = new BatchEntry*[d->count];
+	BatchEntry **removals = new BatchEntry*[d->count];
+	int          changeCount = 0, removalCount = 0;
+	for(BatchEntry *entry=d->first;entry!=0;entry=entry->next)
+	{
+		if((entry->action==ACTION_INSTALL)||(entry->action==ACTION_MODIFY)) { changes[changeCount++] = entry; }
+		if(entry->action==ACTION_REMOVE) { removals[removalCount++] = entry; }
+	}
+	delete[] d->begun;
+	d->begun      = new BatchEntry*[d->count];
+	d->begunCount = 0;
+
+	bool ok = runPhase(d,changes,changeCount,maxThreads)&&runPhase(d,removals,removalCount,maxThreads);
+	delete[] changes;
+	delete[] removals;
+	fclose(d->journal);
+	d->journal = 0;
+
+	if(ok)
+	{
+		(void)remove(journalPath);
+		LOGGER_LOG_INFO3("service batch applied: %d services changed, %d removed, %d unchanged",
+			changeCount,removalCount,d->count-changeCount-removalCount)
+		return;
+	}
+
+	// undo everything begun, latest first
+	LOGGER_LOG_ERROR1("service batch failed - undoing %d actions",d->begunCount)
+	bool undone = true;
+	for(i=d->begunCount-1;i>=0;i--)
+	{
+		BatchEntry *entry = d->begun[i];
+		undone = undoAction(d->hSCM,entry->action,entry->svcName,entry->current)&&undone;
+	}
+	if(undone)
+	{
+		(void)remove(journalPath);
+		LOGGER_LOG_INFO("service batch has been rolled back")
+	}
+	else
+	{
+		LOGGER_LOG_ERROR1("service batch could not be rolled back completely - journal '%s' has been kept",
+			journalPath)
+	}
+	THROW_SRVSTART_EXCEPTION
+		(SRVSTART_EXCEPTION_GENERAL_ERROR,"ServiceBatch","apply")
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceBatch::rollback
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : undo the actions recorded in a journal, latest first, and
+//                   delete it (unless some of them cannot be undone)
+//
+// ARGUMENTS       : journalPath IN journal file
+//
+// THROWS          : SrvStartException (if the journal cannot be read, or not
+//                   every action can be undone)
+//
+// ============================================================================
+void ServiceBatch::rollback
+(
+	const char *journalPath
+) throw (SrvStartException)
+{
+	LOGGER_LOG_DEBUG1("ServiceBatch::rollback('%s')",journalPath)
+
+	FILE *journal = fopen(journalPath,"r");
+	if(journal==0)
+	{
+		LOGGER_LOG_ERROR1("unable to open journal '%s'",journalPath)
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ServiceBatch","rollback")
+	}
+
+	// read every action (the journal is small - one line per service)
+	StringArena arena;
+	char        line[BATCH_JOURNAL_LINE];
+	char      **lines     = 0;
+	int         lineCount = 0, lineSize = 0;
+	while(fgets(line,sizeof(line),journal)!=0)
+	{
+		line[strcspn(line,"\r\n")] = '\0';
+		if((line[0]=='\0')||(line[0]=='#')) { continue; }
+		if(lineCount==lineSize)
+		{
+			lineSize = (lineSize==0 ? 64 : 2*lineSize);
+			char **bigger = new char*[lineSize];
+			for(int i=0;i<lineCount;i++) { bigger[i] = lines[i]; }
+			delete[] lines;
+			lines = bigger;
+		}
+		lines[lineCount++] = arena.copy(line);
+	}
+	fclose(journal);
+
+	// undo them, latest first
+	SC_HANDLE hSCM = NULL;
+	try { hSCM = openScm(); }
+	catch(...)
+	{
+		delete[] lines;
+		throw;
+	}
+	bool undone = true;
+	for(int i=lineCount-1;i>=0;i--)
+	{
+		char         *fields[BATCH_JOURNAL_FIELDS];
+		ServiceConfig old;
+		BATCH_ACTIONS action = ACTION_NONE;
+		int           fieldCount = splitJournalLine(lines[i],fields,BATCH_JOURNAL_FIELDS);
+		if((fieldCount!=BATCH_JOURNAL_FIELDS)&&(fieldCount!=BATCH_JOURNAL_OLD_FIELDS))
+		{
+			LOGGER_LOG_ERROR1("invalid journal line '%s'",lines[i])
+			undone = false;
+			continue;
+		}
+		for(int a=ACTION_INSTALL;a<=ACTION_REMOVE;a++)
+		{
+			if(strcmp(fields[0],BATCH_ACTION_NAMES[a])==0) { action = (BATCH_ACTIONS)a; }
+		}
+		old.serviceType  = strtoul(fields[2],0,10);
+		old.startType    = strtoul(fields[3],0,10);
+		old.errorControl = strtoul(fields[4],0,10);
+		old.displayName  = fields[5];
+		old.binaryPath   = fields[6];
+		old.account      = (fields[7][0]!='\0' ? fields[7] : 0);
+		if(fieldCount==BATCH_JOURNAL_FIELDS)
+		{
+			old.description  = fields[8];
+			old.dependencies = fields[9];
+		}
+		undone = undoAction(hSCM,action,fields[1],old)&&undone;
+	}
+	CloseServiceHandle(hSCM);
+	delete[] lines;
+
+	if(!undone)
+	{
+		LOGGER_LOG_ERROR1("journal '%s' could not be rolled back completely - it has been kept",journalPath)
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_GENERAL_ERROR,"ServiceBatch","rollback")
+	}
+	(void)remove(journalPath);
+	LOGGER_LOG_INFO2("%d actions in journal '%s' have been rolled back",lineCount,journalPath)
+}
+
+// ============================================================================
+//
+// LOCAL UTILITY FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : runPhase
+//
+// DESCRIPTION     : carry out some actions, up to maxThreads at a time (the
+//                   calling thread does them itself if no thread can be started)
+//
+// ARGUMENTS       : d          IN batch data
+//                   entries    IN services to act on
+//                   count      IN number of services
+//                   maxThreads IN number of threads
+//
+// RETURNS         : true if every action has succeeded
+//
+// ============================================================================
+static bool runPhase(ServiceBatchData *d,BatchEntry **entries,int count,int maxThreads)
+{
+	BatchPhase phase;
+	HANDLE     threads[MAXIMUM_WAIT_OBJECTS];
+	int        threadCount = 0;
+
+	phase.d       = d;
+	phase.entries = entries;
+	phase.count   = count;
+	phase.next    = 0;
+	phase.failed  = 0;
+
+	if(maxThreads>MAXIMUM_WAIT_OBJECTS) { maxThreads = MAXIMUM_WAIT_OBJECTS; }
+	if(maxThreads>count) { maxThreads = count; }
+	for(;threadCount<maxThreads;threadCount++)
+	{
+		threads[threadCount] = (HANDLE)_beginthreadex(NULL,0,phaseWorker,&phase,0,NULL);
+		if(threads[threadCount]==0)
+		{
+			LOGGER_LOG_DEBUG1("runPhase: unable to start thread, errno=%d",errno)
+			break;
+		}
+	}
+
+	if(threadCount==0)
+	{
+		(void)phaseWorker(&phase);
+	}
+	else
+	{
+		WaitForMultipleObjects(threadCount,threads,TRUE,INFINITE);
+		for(int i=0;i<threadCount;i++) { CloseHandle(threads[i]); }
+	}
+
+	return phase.failed==0;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : phaseWorker
+//
+// DESCRIPTION     : take the next action of a phase and carry it out, until
+//                   there are none left or one has failed
+//
+// ARGUMENTS       : arg IN BatchPhase
+//
+// ============================================================================
+static unsigned __stdcall phaseWorker(void *arg)
+{
+	BatchPhase *phase = (BatchPhase *)arg;
+
+	while(phase->failed==0)
+	{
+		LONG next = InterlockedIncrement(&phase->next)-1;
+		if(next>=phase->count)
+		{
+			break;
+		}
+		if(!performAction(phase->d,phase->entries[next]))
+		{
+			InterlockedExchange(&phase->failed,1);
+		}
+	}
+
+	return 0;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : performAction
+//
+// DESCRIPTION     : journal an action, then carry it out
+//
+// ARGUMENTS       : d     IN batch data
+//                   entry IN service
+//
+// RETURNS         : true on success
+//
+// ============================================================================
+static bool performAction(ServiceBatchData *d,BatchEntry *entry)
+{
+	const ServiceConfig &old = entry->current;
+	DWORD                error;
+
+	// the journal must say how to undo the action before it is taken
+	EnterCriticalSection(&d->journalLock);
+	int written = fprintf(d->journal,"%s\t%s\t%lu\t%lu\t%lu\t%s\t%s\t%s\t%s\t%s\n",
+					BATCH_ACTION_NAMES[entry->action],entry->svcName,
+					old.serviceType,old.startType,old.errorControl,
+					old.displayName,old.binaryPath,(old.account!=0 ? old.account : ""),
+					old.description,old.dependencies);
+	bool journalled = (written>0)&&(fflush(d->journal)==0);
+	if(journalled) { d->begun[d->begunCount++] = entry; }
+	LeaveCriticalSection(&d->journalLock);
+	if(!journalled)
+	{
+		LOGGER_LOG_ERROR1("unable to write to the journal for service '%s'",entry->svcName)
+		return false;
+	}
+
+	switch(entry->action)
+	{
+		case ACTION_INSTALL: error = createService(d->hSCM,entry->svcName,entry->target); break;
+		case ACTION_MODIFY:  error = changeService(d->hSCM,entry->svcName,entry->target); break;
+		case ACTION_REMOVE:  error = deleteService(d->hSCM,entry->svcName);               break;
+		default:             error = ERROR_SUCCESS;                                        break;
+	}
+	if((entry->action==ACTION_REMOVE)&&(error==ERROR_SERVICE_MARKED_FOR_DELETE))
+	{
+		// something else has already removed it
+		LOGGER_LOG_INFO1("service '%s' was already marked for deletion",entry->svcName)
+		error = ERROR_SUCCESS;
+	}
+	if(error!=ERROR_SUCCESS)
+	{
+		logScmError(BATCH_ACTION_NAMES[entry->action],entry->svcName,error);
+		return false;
+	}
+
+	LOGGER_LOG_INFO2("%s of service '%s' succeeded",BATCH_ACTION_NAMES[entry->action],entry->svcName)
+	return true;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : undoAction
+//
+// DESCRIPTION     : undo an action (which may or may not have been carried out)
+//
+// ARGUMENTS       : hSCM    IN SCM handle
+//                   action  IN action
+//                   svcName IN service
+//                   old     IN the service's configuration before the action
+//
+// RETURNS         : true if the service is as it was before the action
+//
+// ============================================================================
+static bool undoAction(SC_HANDLE hSCM,BATCH_ACTIONS action,const char *svcName,const ServiceConfig &old)
+{
+	DWORD error;
+
+	switch(action)
+	{
+		case ACTION_INSTALL:
+			// (a service marked for deletion goes once its last handle is closed)
+			error = deleteService(hSCM,svcName);
+			if((error==ERROR_SERVICE_DOES_NOT_EXIST)||(error==ERROR_SERVICE_MARKED_FOR_DELETE)) { error = ERROR_SUCCESS; }
+			break;
+
+		case ACTION_MODIFY:
+			error = changeService(hSCM,svcName,old);
+			break;
+
+		case ACTION_REMOVE:
+			// the service cannot be created again until the one removed has
+			//  gone - which it does once every handle to it has been closed
+			error = createService(hSCM,svcName,old);
+			for(DWORD waited=0;(error==ERROR_SERVICE_MARKED_FOR_DELETE)&&(waited<BATCH_STOP_TIMEOUT);waited+=BATCH_STOP_POLL)
+			{
+				Sleep(BATCH_STOP_POLL);
+				error = createService(hSCM,svcName,old);
+			}
+			if(error==ERROR_SERVICE_MARKED_FOR_DELETE)
+			{
+				LOGGER_LOG_ERROR1("service '%s' is still marked for deletion - close every program using it (eg the Services console), then roll back the journal",
+					svcName)
+				return false;
+			}
+			if(error==ERROR_SERVICE_EXISTS) { error = ERROR_SUCCESS; }
+			else if((error==ERROR_SUCCESS)&&needsPassword(old.account))
+			{
+				LOGGER_LOG_INFO2("WARNING: service '%s' has been created again to run as '%s' - its password must be set again",
+					svcName,old.account)
+			}
+			break;
+
+		default:
+			LOGGER_LOG_ERROR1("unknown action for service '%s'",svcName)
+			return false;
+	}
+
+	if(error!=ERROR_SUCCESS)
+	{
+		logScmError("undo",svcName,error);
+		return false;
+	}
+	LOGGER_LOG_INFO2("%s of service '%s' has been undone",BATCH_ACTION_NAMES[action],svcName)
+	return true;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : queryService
+//
+// DESCRIPTION     : get the configuration of a service
+//
+// ARGUMENTS       : hSCM    IN  SCM handle
+//                   svcName IN  service
+//                   config  OUT configuration (its strings are put in arena)
+//                   arena   IN  string arena
+//
+// RETURNS         : ERROR_SUCCESS, ERROR_SERVICE_DOES_NOT_EXIST or another error
+//
+// ============================================================================
+static DWORD queryService(SC_HANDLE hSCM,const char *svcName,ServiceConfig *config,StringArena &arena)
+{
+	SC_HANDLE hService = OpenService(hSCM,svcName,SERVICE_QUERY_CONFIG);
+	if(hService==NULL)
+	{
+		return GetLastError();
+	}
+
+	DWORD bytesNeeded = 0;
+	(void)QueryServiceConfig(hService,NULL,0,&bytesNeeded);
+	QUERY_SERVICE_CONFIG *query = (QUERY_SERVICE_CONFIG *)new char[bytesNeeded+sizeof(QUERY_SERVICE_CONFIG)];
+	DWORD error = ERROR_SUCCESS;
+	if(QueryServiceConfig(hService,query,bytesNeeded+sizeof(QUERY_SERVICE_CONFIG),&bytesNeeded))
+	{
+		config->serviceType  = query->dwServiceType;
+		config->startType    = query->dwStartType;
+		config->errorControl = query->dwErrorControl;
+		config->displayName  = arena.copy(query->lpDisplayName!=0 ? query->lpDisplayName : "");
+		config->binaryPath   = arena.copy(query->lpBinaryPathName!=0 ? query->lpBinaryPathName : "");
+		config->account      = (((query->lpServiceStartName==0)||(_stricmp(query->lpServiceStartName,"LocalSystem")==0)) ?
+								0 : arena.copy(query->lpServiceStartName));
+
+		// the dependencies (a list ending with an empty string) as one string
+		const char *dependency = (query->lpDependencies!=0 ? query->lpDependencies : "");
+		size_t      length     = 0;
+		while(dependency[length]!='\0') { length += strlen(dependency+length)+1; }
+		char *dependencies = new char[length+1];
+		memcpy(dependencies,dependency,length);
+		dependencies[length] = '\0';
+		if(length>0) { dependencies[length-1] = '\0'; }
+		for(size_t i=0;(length>0)&&(i<length-1);i++)
+		{
+			if(dependencies[i]=='\0') { dependencies[i] = '/'; }
+		}
+		config->dependencies = arena.copy(dependencies);
+		delete[] dependencies;
+	}
+	else
+	{
+		error = GetLastError();
+	}
+	delete[] (char *)query;
+
+	// the description (which must fit on one line of the journal)
+	if(error==ERROR_SUCCESS)
+	{
+		bytesNeeded = 0;
+		(void)QueryServiceConfig2(hService,SERVICE_CONFIG_DESCRIPTION,NULL,0,&bytesNeeded);
+		SERVICE_DESCRIPTION *description = (SERVICE_DESCRIPTION *)new char[bytesNeeded+sizeof(SERVICE_DESCRIPTION)];
+		if(QueryServiceConfig2(hService,SERVICE_CONFIG_DESCRIPTION,(LPBYTE)description,
+				bytesNeeded+sizeof(SERVICE_DESCRIPTION),&bytesNeeded)
+			&&(description->lpDescription!=0))
+		{
+			char *text = arena.copy(description->lpDescription);
+			for(char *c=text;*c!='\0';c++)
+			{
+				if((*c=='\t')||(*c=='\r')||(*c=='\n')) { *c = ' '; }
+			}
+			config->description = text;
+		}
+		delete[] (char *)description;
+	}
+
+	CloseServiceHandle(hService);
+	return error;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : createService
+//                   changeService
+//                   deleteService
+//
+// DESCRIPTION     : create, reconfigure or delete a service
+//
+// ARGUMENTS       : hSCM    IN SCM handle
+//                   svcName IN service
+//                   config  IN configuration
+//
+// RETURNS         : ERROR_SUCCESS or the error
+//
+// ============================================================================
+static DWORD createService(SC_HANDLE hSCM,const char *svcName,const ServiceConfig &config)
+{
+	// the dependencies as a list ending with an empty string
+	size_t length       = strlen(config.dependencies);
+	char  *dependencies = new char[length+2];
+	strcpy(dependencies,config.dependencies);
+	dependencies[length+1] = '\0';
+	for(size_t i=0;i<length;i++)
+	{
+		if(dependencies[i]=='/') { dependencies[i] = '\0'; }
+	}
+
+	SC_HANDLE hService = CreateService(hSCM,svcName,config.displayName,STANDARD_RIGHTS_REQUIRED|SERVICE_CHANGE_CONFIG,
+							config.serviceType,config.startType,config.errorControl,config.binaryPath,
+							NULL,NULL,(length>0 ? dependencies : NULL),config.account,NULL);
+	DWORD error = (hService==NULL ? GetLastError() : ERROR_SUCCESS);
+	delete[] dependencies;
+	if(hService==NULL)
+	{
+		return error;
+	}
+
+	if(config.description[0]!='\0')
+	{
+		SERVICE_DESCRIPTION description;
+		description.lpDescription = const_cast<char *>(config.description);
+		if(!ChangeServiceConfig2(hService,SERVICE_CONFIG_DESCRIPTION,&description))
+		{
+			LOGGER_LOG_INFO2("WARNING: the description of service '%s' could not be set, error=%d",
+				svcName,GetLastError())
+		}
+	}
+	CloseServiceHandle(hService);
+	return ERROR_SUCCESS;
+}
+
+static DWORD changeService(SC_HANDLE hSCM,const char *svcName,const ServiceConfig &config)
+{
+	SC_HANDLE hService = OpenService(hSCM,svcName,SERVICE_CHANGE_CONFIG);
+	if(hService==NULL)
+	{
+		return GetLastError();
+	}
+	DWORD error = ERROR_SUCCESS;
+	if(!ChangeServiceConfig(hService,config.serviceType,config.startType,SERVICE_NO_CHANGE,
+			config.binaryPath,NULL,NULL,NULL,NULL,NULL,config.displayName))
+	{
+		error = GetLastError();
+	}
+	CloseServiceHandle(hService);
+	return error;
+}
+
+static DWORD deleteService(SC_HANDLE hSCM,const char *svcName)
+{
+	SC_HANDLE hService = OpenService(hSCM,svcName,DELETE|SERVICE_STOP|SERVICE_QUERY_STATUS);
+	if(hService==NULL)
+	{
+		return GetLastError();
+	}
+	// a running service would only be marked for deletion, and would go
+	//  (and could be created again) only once it had stopped
+	DWORD error = stopService(hService,svcName);
+	if((error==ERROR_SUCCESS)&&(!DeleteService(hService)))
+	{
+		error = GetLastError();
+	}
+	CloseServiceHandle(hService);
+	return error;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : stopService
+//
+// DESCRIPTION     : stop a service (if it is running), and wait for it to stop
+//
+// ARGUMENTS       : hService IN service handle (with SERVICE_STOP and
+//                               SERVICE_QUERY_STATUS access)
+//                   svcName  IN service
+//
+// RETURNS         : ERROR_SUCCESS once it has stopped,
+//                   ERROR_SERVICE_REQUEST_TIMEOUT if it has not stopped within
+//                   BATCH_STOP_TIMEOUT, or another error
+//
+// ============================================================================
+static DWORD stopService(SC_HANDLE hService,const char *svcName)
+{
+	SERVICE_STATUS status;
+
+	if(!QueryServiceStatus(hService,&status))
+	{
+		return GetLastError();
+	}
+	if(status.dwCurrentState==SERVICE_STOPPED)
+	{
+		return ERROR_SUCCESS;
+	}
+	if(status.dwCurrentState!=SERVICE_STOP_PENDING)
+	{
+		LOGGER_LOG_INFO1("stopping service '%s' before it is removed",svcName)
+		if(!ControlService(hService,SERVICE_CONTROL_STOP,&status))
+		{
+			DWORD error = GetLastError();
+			return (error==ERROR_SERVICE_NOT_ACTIVE ? ERROR_SUCCESS : error);
+		}
+	}
+
+	for(DWORD waited=0;status.dwCurrentState!=SERVICE_STOPPED;waited+=BATCH_STOP_POLL)
+	{
+		if(waited>=BATCH_STOP_TIMEOUT)
+		{
+			LOGGER_LOG_ERROR2("service '%s' has not stopped within %lu seconds",svcName,BATCH_STOP_TIMEOUT/1000)
+			return ERROR_SERVICE_REQUEST_TIMEOUT;
+		}
+		Sleep(BATCH_STOP_POLL);
+		if(!QueryServiceStatus(hService,&status))
+		{
+			return GetLastError();
+		}
+	}
+	return ERROR_SUCCESS;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : needsPassword
+//
+// DESCRIPTION     : does a service account need a password?  (LocalSystem,
+//                   the NT AUTHORITY and NT SERVICE accounts, and managed
+//                   service accounts - ending with '$' - do not.)
+//
+// ARGUMENTS       : account IN account (0 for LocalSystem)
+//
+// RETURNS         : true if it does
+//
+// ============================================================================
+static bool needsPassword(const char *account)
+{
+	if(account==0)
+	{
+		return false;
+	}
+	size_t length = strlen(account);
+	return (_strnicmp(account,"NT AUTHORITY\\",13)!=0)
+		&&(_strnicmp(account,"NT SERVICE\\",11)!=0)
+		&&((length==0)||(account[length-1]!='$'));
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : logScmError
+//
+// DESCRIPTION     : log a failed SCM call, with the system's description of
+//                   the error
+//
+// ARGUMENTS       : what    IN what was being done
+//                   svcName IN service
+//                   error   IN error
+//
+// ============================================================================
+static void logScmError(const char *what,const char *svcName,DWORD error)
+{
+	char msg[SRVSTART_EXCEPTION_STRING_SIZE];
+
+	msg[0] = '\0';
+	FormatMessage(FORMAT_MESSAGE_FROM_SYSTEM|FORMAT_MESSAGE_IGNORE_INSERTS,
+		NULL,error,0,msg,sizeof(msg),NULL);
+	msg[strcspn(msg,"\r\n")] = '\0';
+	LOGGER_LOG_ERROR4("Failed to %s service '%s' (error %d): %s",what,svcName,error,msg)
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : startTypeName
+//
+// DESCRIPTION     : name of a service start type (as in a manifest)
+//
+// ARGUMENTS       : startType IN start type
+//
+// RETURNS         : name
+//
+// ============================================================================
+static const char *startTypeName(DWORD startType)
+{
+	switch(startType)
+	{
+		case SERVICE_AUTO_START:   return "auto";
+		case SERVICE_DEMAND_START: return "demand";
+		case SERVICE_DISABLED:     return "disabled";
+		default:                   return "boot/system";
+	}
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : openScm
+//
+// DESCRIPTION     : open the SCM for this computer
+//
+// RETURNS         : SCM handle
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+static SC_HANDLE openScm() throw (SrvStartException)
+{
+	SC_HANDLE hSCM = OpenSCManager(NULL,NULL,SC_MANAGER_CONNECT|SC_MANAGER_CREATE_SERVICE);
+	if(hSCM==NULL)
+	{
+		LOGGER_LOG_ERROR1("ServiceBatch: failed to open SCM, error = %d",GetLastError())
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_GENERAL_ERROR,"ServiceBatch","openScm")
+	}
+	return hSCM;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : splitJournalLine
+//
+// DESCRIPTION     : split a journal line at its tabs (fields may be empty)
+//
+// ARGUMENTS       : line      IN/OUT line (the tabs are replaced by NULs)
+//                   fields    OUT    the fields
+//                   maxFields IN     size of fields
+//
+// RETURNS         : number of fields
+//
+// ============================================================================
+static int splitJournalLine(char *line,char *fields[],int maxFields)
+{
+	int count = 0;
+
+	while(count<maxFields)
+	{
+		fields[count++] = line;
+		line = strchr(line,'\t');
+		if(line==0)
+		{
+			break;
+		}
+		*line++ = '\0';
+	}
+
+	return (line==0) ? count : count+1;
+}
@@ -0,0 +1,154 @@
+// ============================================================================
+//
+// FILE        : ServiceBatch.h
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : interface definition for exported class ServiceBatch
+//
+//               A ServiceBatch installs, modifies and removes many services at
+//               once (see the apply mode of srvstart.exe).  The services are
+//               described by what they should look like;  plan() compares
+//               that with what the SCM has, and decides which to install,
+//               modify or remove, so a batch can be applied again safely.
+//
+//               apply() carries out the plan with a few threads sharing one
+//               SCM handle - installs and modifications first, removals once
+//               they have all succeeded.  A service is stopped before it is
+//               removed, and plan() refuses to remove one which runs under an
+//               account with a password (which could not be restored).
+//               Before each action it writes what it takes to undo it to a
+//               journal;  if any action fails, those already begun are
+//               undone, in reverse order, and the journal is deleted.  A
+//               journal left behind by a batch which did not finish can be
+//               undone with rollback().
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// prevent multiple inclusion
+
+#if !defined(__SERVICE_BATCH_H__)
+#define __SERVICE_BATCH_H__
+
+// ============================================================================
+//
+// IMPORT / EXPORT
+//
+// ============================================================================
+
+//
+// if SRVSTART_DLL_EXPORT is #defined, then we are building the DLL
+//  and exporting the classes
+//
+// otherwise, we are building an executable which will link with the DLL at run-time
+//
+// -------------------------------------------------------------
+// APART FROM THE DLL ITSELF,
+//  ANY SOURCE FILE WHICH #includes THIS ONE SHOULD ENSURE THAT
+//  SRVSTART_DLL_EXPORT is not #defined
+// -------------------------------------------------------------
+//
+
+#ifdef SRVSTART_DLL_EXPORT
+#define SRVSTART_DLL_API __declspec(dllexport)
+#pragma message("exporting ServiceBatch")
+
+#else
+
+#ifdef	SRVSTART_DLL_LOCAL
+#pragma message("ServiceBatch is local")
+#define	SRVSTART_DLL_API
+
+#else
+
+#define SRVSTART_DLL_API __declspec(dllimport)
+#pragma message("importing ServiceBatch")
+
+#endif
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// namespace header
+#include "SrvStart.h"
+
+// forward declarations
+struct ServiceBatchData;
+
+// ============================================================================
+//
+// NAMESPACE
+//
+// ============================================================================
+
+// all the DLL classes are defined within the SrvStart namespace
+namespace SrvStart {
+
+// ============================================================================
+//
+// ServiceBatch class
+//
+// ============================================================================
+class SRVSTART_DLL_API ServiceBatch
+{
+public:
+	// public types
+	typedef enum START_TYPES { START_DEMAND, START_AUTO, START_DISABLED };
+
+	// services which should exist (installed or modified to match), and
+	//  services which should not
+	void addService(const char *svcName,const char *displayName,const char *binaryPath,
+		START_TYPES startType,bool desktopService) throw (SrvStartException);
+	void addRemoval(const char *svcName) throw (SrvStartException);
+
+	// work out what has to be done (returns the number of actions)
+	int plan() throw (SrvStartException);
+
+	// describe the plan, one line per service (for a dry run)
+	typedef void PRINT_FUNCTION(const char *line,void *genericPointer);
+	void describe(PRINT_FUNCTION *printFunction,void *genericPointer) const;
+
+	// carry out the plan - the batch is undone if it fails
+	void apply(const char *journalPath,int maxThreads) throw (SrvStartException);
+
+	// undo the actions recorded in a journal
+	static void rollback(const char *journalPath) throw (SrvStartException);
+
+	// constructor and destructor
+	ServiceBatch() throw (SrvStartException);
+	virtual ~ServiceBatch();
+
+private:
+	// no copying
+	ServiceBatch(const ServiceBatch &);
+	ServiceBatch &operator=(const ServiceBatch &);
+
+private:	// data members - hidden data
+	struct ServiceBatchData *serviceBatchData;
+
+};
+
+} // namespace SrvStart
+
+#endif // !defined(__SERVICE_BATCH_H__)
@@ -97,6 +97,7 @@ struct ServiceManagerData
 	char *displayName;
 	char *binaryPathName;
 	bool  desktopService;
+	bool  sharedProcess;
 
 	// handle to SCM
 	SC_HANDLE hSCM;
@@ -116,12 +117,12 @@ struct ServiceManagerData
 		stringSubstituter.stringInit(binaryPathName);
 		hSCM = NULL;
 		desktopService = false;
+		sharedProcess  = false;
 	} ;
 	
 	virtual ~ServiceManagerData()
 	{
-		stringSubstituter.stringDelete(serviceName);
-		stringSubstituter.stringDelete(binaryPathName);
+		// the strings are freed along with stringSubstituter
 	} ;
 } ;
 
@@ -198,8 +199,8 @@ void ServiceManager::install() throw (SrvStartException)
 {
 	LOGGER_LOG_DEBUG("install()")
 
-	// can the service interact with the desktop?
-	DWORD serviceType = SERVICE_WIN32_OWN_PROCESS |
+	// does the service share its process with others, and can it interact with the desktop?
+	DWORD serviceType = (serviceManagerData->sharedProcess?SERVICE_WIN32_SHARE_PROCESS:SERVICE_WIN32_OWN_PROCESS) |
 						(serviceManagerData->desktopService?SERVICE_INTERACTIVE_PROCESS:0);
 
 	// create the service
@@ -367,6 +368,23 @@ void ServiceManager::remove
 void ServiceManager::setDesktopService(bool ds) { serviceManagerData->desktopService = ds ; }
 bool ServiceManager::getDesktopService() const { return serviceManagerData->desktopService; }
 
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceManager::get|setSharedProcess
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : does this service share its process with other services
+//                   (SERVICE_WIN32_SHARE_PROCESS)?  See ScmConnector::setSharedServices.
+//
+// ARGUMENTS       : as below
+//
+// THROWS          : n/a
+//
+// ============================================================================
+void ServiceManager::setSharedProcess(bool sp) { serviceManagerData->sharedProcess = sp ; }
+bool ServiceManager::getSharedProcess() const { return serviceManagerData->sharedProcess; }
+
 // ============================================================================
 //
 // MEMBER FUNCTION : ServiceManager::get|setDisplayName
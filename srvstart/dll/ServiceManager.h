@@ -112,11 +112,13 @@ public:
 
 	// set / get properties
 	void setDesktopService(bool ds);
+	void setSharedProcess(bool sp);
 	void ServiceManager::setDisplayName(char *dn);
 	void ServiceManager::setBinaryPath(char *bp);
 	void ServiceManager::addBinaryPathParameter(char *bpp);
 
 	bool  getDesktopService() const;
+	bool  getSharedProcess() const;
 	char *ServiceManager::getDisplayName() const;
 	char *ServiceManager::getBinaryPath() const;
 
@@ -35,6 +35,14 @@
 #if !defined(__SLEEPER_H__)
 #define __SLEEPER_H__
 
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// class headers
+#include "Clock.h"
 
 // ============================================================================
 //
@@ -57,18 +65,11 @@ public:
 	// sleep for the given number of seconds
 	static void Sleep(int seconds,char *msg)
 	{
-		// create local wait event
-		HANDLE hSleepEvent;
-		hSleepEvent = CreateEvent(NULL,FALSE,FALSE,NULL);
-
-		// wait for given time
+		// wait for given time (on the supervisor's clock, which a test
+		// harness can replace - see Clock)
 		LOGGER_LOG_DEBUG2("waiting %dms for %s ...",1000*seconds,msg)
-		(void)WaitForSingleObject(hSleepEvent,1000*seconds);
+		Clock::sleep(1000*seconds);
 		LOGGER_LOG_DEBUG2("... wait %dms for %s complete",1000*seconds,msg)
-
-		// close handle
-		CloseHandle(hSleepEvent);
-
 	}
 
 private:
@@ -39,6 +39,7 @@
 
 // system headers
 #include <string>
+#include <string.h>
 
 // support headers
 #include <logger.h>
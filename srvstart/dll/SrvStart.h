@@ -69,9 +69,16 @@
 
 #else
 
+#ifdef	SRVSTART_DLL_LOCAL
+#pragma message("SrvStart is local")
+#define	SRVSTART_DLL_API
+
+#else
+
 #define SRVSTART_DLL_API __declspec(dllimport)
 #pragma message("importing SrvStart")
 
+#endif
 #endif
 
 // ============================================================================
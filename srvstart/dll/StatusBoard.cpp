@@ -0,0 +1,681 @@
+// ============================================================================
+//
+// FILE        : StatusBoard.cpp
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : Implementation of StatusBoard class
+//
+//               The segment starts with a header, which is filled in by the
+//               first writer to find it empty (every writer would fill it in
+//               the same way, so there is no race worth locking against), and
+//               is followed by MAX_SERVICES slots.  A writer claims a slot by
+//               swapping its own pid into the slot's owner, either where there
+//               was none, or where the owner has died; a reader skips slots
+//               with no owner.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// this is the "main" source file
+#define	SRVSTART_DLL
+
+// we are exporting the class
+#define	SRVSTART_DLL_EXPORT
+
+//
+// which platform are we running?
+//
+#if	defined(WIN32)
+#define	BOARD_PLATFORM_IS_WIN32	1
+#else
+#define	BOARD_PLATFORM_IS_WIN32	0
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// system headers
+#if	BOARD_PLATFORM_IS_WIN32
+#define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
+#include <windows.h>
+#include <sddl.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif	// BOARD_PLATFORM_IS_WIN32
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// support headers
+#include <logger.h>
+
+// class headers
+#include "SrvStart.h"
+#include "StatusBoard.h"
+
+// ============================================================================
+//
+// NAMESPACE DECLARATIONS
+//
+// ============================================================================
+
+using namespace SrvStart;
+
+// ============================================================================
+//
+// LOCAL MACROS
+//
+// ============================================================================
+
+// interlocked operations (each is a full memory barrier) on a 32-bit value
+#if	BOARD_PLATFORM_IS_WIN32
+#define	BOARD_ATOMIC_INCREMENT(p)		InterlockedIncrement((volatile LONG *)(p))
+#define	BOARD_ATOMIC_EXCHANGE(p,v)		InterlockedExchange((volatile LONG *)(p),(LONG)(v))
+#define	BOARD_ATOMIC_CAS(p,v,old)		((unsigned int)InterlockedCompareExchange((volatile LONG *)(p),(LONG)(v),(LONG)(old)))
+#define	BOARD_FENCE()					MemoryBarrier()
+#else
+#define	BOARD_ATOMIC_INCREMENT(p)		__sync_add_and_fetch((p),1)
+#define	BOARD_ATOMIC_EXCHANGE(p,v)		__sync_lock_test_and_set((p),(v))
+#define	BOARD_ATOMIC_CAS(p,v,old)		__sync_val_compare_and_swap((p),(old),(v))
+#define	BOARD_FENCE()					__sync_synchronize()
+#endif	// BOARD_PLATFORM_IS_WIN32
+
+// ============================================================================
+//
+// CONSTANT DEFINITIONS
+//
+// ============================================================================
+
+// segment names, in the order they are tried
+#if	BOARD_PLATFORM_IS_WIN32
+static const char *BOARD_NAMES[] = { "Global\\srvstart.statusboard","Local\\srvstart.statusboard" };
+
+// full access for the system, administrators and the creator, read access
+//  for any other user who has logged on
+#define	BOARD_SECURITY		"D:(A;;GA;;;SY)(A;;GA;;;BA)(A;;GA;;;OW)(A;;GR;;;AU)"
+#else
+static const char *BOARD_NAMES[] = { "/srvstart.statusboard" };
+#endif	// BOARD_PLATFORM_IS_WIN32
+const int BOARD_NAME_COUNT = sizeof(BOARD_NAMES)/sizeof(BOARD_NAMES[0]);
+
+// the header identifies the layout
+const unsigned int BOARD_MAGIC   = 0x53425353;	// "SSBS"
+const unsigned int BOARD_VERSION = 1;
+
+// how often a reader tries a record which is being written
+const int BOARD_READ_ATTEMPTS = 1000;
+
+// ============================================================================
+//
+// LOCAL CLASSES
+//
+// ============================================================================
+
+//
+// the layout of the segment
+//
+struct BoardHeader
+{
+	volatile unsigned int magic;
+	unsigned int          version;
+	unsigned int          slotCount;
+	unsigned int          slotSize;
+	unsigned char         reserved[48];
+} ;
+
+struct BoardSlot
+{
+	volatile unsigned int      sequence;	// odd while the record is being written
+	volatile unsigned int      owner;		// pid of the writer (0 if the slot is free)
+	StatusBoard::STATUS_RECORD record;
+} ;
+
+struct BoardLayout
+{
+	BoardHeader header;
+	BoardSlot   slots[StatusBoard::MAX_SERVICES];
+} ;
+
+//
+// a mapped segment
+//
+struct BoardMapping
+{
+	BoardLayout *board;
+#if	BOARD_PLATFORM_IS_WIN32
+	HANDLE       handle;
+#endif	// BOARD_PLATFORM_IS_WIN32
+
+	BoardMapping()
+	{
+		board = 0;
+#if	BOARD_PLATFORM_IS_WIN32
+		handle = NULL;
+#endif	// BOARD_PLATFORM_IS_WIN32
+	} ;
+} ;
+
+//
+// StatusBoard data
+//
+struct StatusBoardData
+{
+	// the segment, and our slot in it
+	BoardMapping mapping;
+	BoardSlot   *slot;
+	unsigned int ownPid;
+
+	// constructor
+	StatusBoardData()
+	{
+		slot   = 0;
+		ownPid = 0;
+	} ;
+
+} ;
+
+// ============================================================================
+//
+// LOCAL FUNCTION PROTOTYPES
+//
+// ============================================================================
+
+static bool mapBoard(const char *name,bool writable,BoardMapping *mapping);
+static void unmapBoard(BoardMapping *mapping);
+static bool isBoardValid(const BoardLayout *board);
+static bool readSlot(const BoardSlot *slot,StatusBoard::STATUS_RECORD *record);
+static bool isProcessAlive(unsigned int pid);
+static unsigned int getOwnPid();
+
+// ============================================================================
+//
+// PUBLIC MEMBER FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// MEMBER FUNCTION : StatusBoard::StatusBoard
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : constructor - no record is held
+//
+// ============================================================================
+StatusBoard::StatusBoard()
+{
+	statusBoardData = new StatusBoardData;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : StatusBoard::~StatusBoard
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : destructor - gives up the record
+//
+// ============================================================================
+StatusBoard::~StatusBoard()
+{
+	close();
+	delete statusBoardData;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : StatusBoard::open
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : map the board (creating it if need be), and claim a record
+//                   for a service
+//
+// ARGUMENTS       : svcName IN service name
+//
+// THROWS          : SrvStartException (if the board cannot be mapped, or is
+//                   full)
+//
+// ============================================================================
+void StatusBoard::open
+(
+	const char *svcName
+)
+throw (SrvStartException)
+{
+	StatusBoardData *d = statusBoardData;
+	int              i;
+
+	LOGGER_LOG_DEBUG1("StatusBoard::open('%s')",svcName)
+
+	close();
+	d->ownPid = getOwnPid();
+
+	// map the first board we can write to
+	for(i=0;(i<BOARD_NAME_COUNT)&&(!mapBoard(BOARD_NAMES[i],true,&d->mapping));i++)
+	{
+		LOGGER_LOG_DEBUG1("StatusBoard: unable to map '%s' for writing",BOARD_NAMES[i])
+	}
+	if(i==BOARD_NAME_COUNT)
+	{
+		LOGGER_LOG_ERROR1("StatusBoard: unable to map a status board for service '%s'",svcName)
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_GENERAL_ERROR,"StatusBoard","open")
+	}
+	BoardLayout *board = d->mapping.board;
+
+	// fill in the header of a new board
+	if(board->header.magic==0)
+	{
+		board->header.version   = BOARD_VERSION;
+		board->header.slotCount = MAX_SERVICES;
+		board->header.slotSize  = sizeof(BoardSlot);
+		BOARD_FENCE();
+		board->header.magic     = BOARD_MAGIC;
+	}
+	if(!isBoardValid(board))
+	{
+		LOGGER_LOG_ERROR1("StatusBoard: '%s' has a different layout (another version of SrvStart?)",
+			BOARD_NAMES[i])
+		unmapBoard(&d->mapping);
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_GENERAL_ERROR,"StatusBoard","open")
+	}
+
+	// claim a free slot, or one whose owner has died
+	for(i=0;i<MAX_SERVICES;i++)
+	{
+		BoardSlot   *slot  = &board->slots[i];
+		unsigned int owner = slot->owner;
+		if(((owner==0)||((owner!=d->ownPid)&&(!isProcessAlive(owner))))
+			&&(BOARD_ATOMIC_CAS(&slot->owner,d->ownPid,owner)==owner))
+		{
+			d->slot = slot;
+			break;
+		}
+	}
+	if(d->slot==0)
+	{
+		LOGGER_LOG_ERROR2("StatusBoard: no room for service '%s' (%d services already)",svcName,MAX_SERVICES)
+		unmapBoard(&d->mapping);
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_GENERAL_ERROR,"StatusBoard","open")
+	}
+
+	// a dead owner may have left the record half written
+	if((d->slot->sequence&1)!=0)
+	{
+		BOARD_ATOMIC_INCREMENT(&d->slot->sequence);
+	}
+
+	// start with just the name
+	STATUS_RECORD record;
+	memset(&record,0,sizeof(record));
+	strncpy(record.svcName,svcName,sizeof(record.svcName)-1);
+	publish(record);
+
+	LOGGER_LOG_DEBUG2("StatusBoard: service '%s' has record %d",svcName,(int)(d->slot-board->slots))
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : StatusBoard::close
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : give up the record, and unmap the board
+//
+// ============================================================================
+void StatusBoard::close()
+{
+	StatusBoardData *d = statusBoardData;
+
+	if(d->slot!=0)
+	{
+		LOGGER_LOG_DEBUG1("StatusBoard::close('%s')",d->slot->record.svcName)
+		BOARD_ATOMIC_INCREMENT(&d->slot->sequence);
+		memset(&d->slot->record,0,sizeof(d->slot->record));
+		BOARD_ATOMIC_INCREMENT(&d->slot->sequence);
+		BOARD_ATOMIC_EXCHANGE(&d->slot->owner,0);
+		d->slot = 0;
+	}
+	unmapBoard(&d->mapping);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : StatusBoard::isOpen
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : is a record held?
+//
+// RETURNS         : true if it is
+//
+// ============================================================================
+bool StatusBoard::isOpen() const
+{
+	return statusBoardData->slot!=0;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : StatusBoard::publish
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : replace the record (readers see either the old record or
+//                   the new one, never a mixture)
+//
+// ARGUMENTS       : record IN new record (its ownerPid is ignored)
+//
+// ============================================================================
+void StatusBoard::publish
+(
+	const STATUS_RECORD &record
+)
+{
+	StatusBoardData *d = statusBoardData;
+
+	if(d->slot==0)
+	{
+		return;
+	}
+
+	BOARD_ATOMIC_INCREMENT(&d->slot->sequence);
+	d->slot->record          = record;
+	d->slot->record.ownerPid = d->ownPid;
+	BOARD_ATOMIC_INCREMENT(&d->slot->sequence);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : StatusBoard::snapshot
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : copy the record of every service on the board(s)
+//
+//                   Apart from mapping each board, this makes no system calls:
+//                   a record whose owner has died without giving it up is still
+//                   copied (until its slot is claimed again), so a reader which
+//                   cares should look at how old its sampleTime is.
+//
+// ARGUMENTS       : records    OUT records
+//                   maxRecords IN  size of records
+//
+// RETURNS         : number of records copied
+//
+// ============================================================================
+int StatusBoard::snapshot
+(
+	STATUS_RECORD *records,
+	int            maxRecords
+)
+{
+	int count = 0;
+
+	for(int i=0;i<BOARD_NAME_COUNT;i++)
+	{
+		BoardMapping mapping;
+		if(!mapBoard(BOARD_NAMES[i],false,&mapping))
+		{
+			continue;
+		}
+		if(isBoardValid(mapping.board))
+		{
+			for(int j=0;(j<MAX_SERVICES)&&(count<maxRecords);j++)
+			{
+				if(readSlot(&mapping.board->slots[j],&records[count]))
+				{
+					count++;
+				}
+			}
+		}
+		unmapBoard(&mapping);
+	}
+
+	return count;
+}
+
+// ============================================================================
+//
+// LOCAL UTILITY FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : mapBoard
+//
+// DESCRIPTION     : map a board - for writing, creating it if need be, or for
+//                   reading, if it exists
+//
+// ARGUMENTS       : name     IN  segment name
+//                   writable IN  true to write to the board
+//                   mapping  OUT the mapping
+//
+// RETURNS         : true if it has been mapped
+//
+// ============================================================================
+static bool mapBoard(const char *name,bool writable,BoardMapping *mapping)
+{
+#if	BOARD_PLATFORM_IS_WIN32
+	if(writable)
+	{
+		SECURITY_ATTRIBUTES securityAttributes;
+		securityAttributes.nLength        = sizeof(securityAttributes);
+		securityAttributes.bInheritHandle = FALSE;
+		if(!ConvertStringSecurityDescriptorToSecurityDescriptor(BOARD_SECURITY,SDDL_REVISION_1,
+				&securityAttributes.lpSecurityDescriptor,NULL))
+		{
+			LOGGER_LOG_ERROR1("StatusBoard: unable to build security descriptor, error=%d",GetLastError())
+			return false;
+		}
+		mapping->handle = CreateFileMapping(INVALID_HANDLE_VALUE,&securityAttributes,PAGE_READWRITE,
+							0,sizeof(BoardLayout),name);
+		LocalFree(securityAttributes.lpSecurityDescriptor);
+	}
+	else
+	{
+		mapping->handle = OpenFileMapping(FILE_MAP_READ,FALSE,name);
+	}
+	if(mapping->handle==NULL)
+	{
+		return false;
+	}
+	mapping->board = (BoardLayout *)MapViewOfFile(mapping->handle,
+						(writable ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ),0,0,sizeof(BoardLayout));
+	if(mapping->board==0)
+	{
+		CloseHandle(mapping->handle);
+		mapping->handle = NULL;
+		return false;
+	}
+#else
+	int         fd = shm_open(name,(writable ? O_RDWR|O_CREAT : O_RDONLY),S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+	struct stat status;
+	if(fd<0)
+	{
+		return false;
+	}
+	if((fstat(fd,&status)!=0)
+		||((status.st_size<(off_t)sizeof(BoardLayout))
+			&&((!writable)||(ftruncate(fd,sizeof(BoardLayout))!=0))))
+	{
+		::close(fd);
+		return false;
+	}
+	void *board = mmap(0,sizeof(BoardLayout),(writable ? PROT_READ|PROT_WRITE : PROT_READ),MAP_SHARED,fd,0);
+	::close(fd);
+	if(board==MAP_FAILED)
+	{
+		return false;
+	}
+	mapping->board = (BoardLayout *)board;
+#endif	// BOARD_PLATFORM_IS_WIN32
+
+	return true;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : unmapBoard
+//
+// DESCRIPTION     : unmap a board (if it is mapped)
+//
+// ARGUMENTS       : mapping IN/OUT the mapping
+//
+// ============================================================================
+static void unmapBoard(BoardMapping *mapping)
+{
+	if(mapping->board==0)
+	{
+		return;
+	}
+#if	BOARD_PLATFORM_IS_WIN32
+	UnmapViewOfFile(mapping->board);
+	CloseHandle(mapping->handle);
+	mapping->handle = NULL;
+#else
+	munmap(mapping->board,sizeof(BoardLayout));
+#endif	// BOARD_PLATFORM_IS_WIN32
+	mapping->board = 0;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : isBoardValid
+//
+// DESCRIPTION     : does a board have the layout we expect?
+//
+// ARGUMENTS       : board IN board
+//
+// RETURNS         : true if it does
+//
+// ============================================================================
+static bool isBoardValid(const BoardLayout *board)
+{
+	if(board->header.magic!=BOARD_MAGIC)
+	{
+		return false;
+	}
+	BOARD_FENCE();
+	return (board->header.version==BOARD_VERSION)
+		&&(board->header.slotCount==StatusBoard::MAX_SERVICES)
+		&&(board->header.slotSize==sizeof(BoardSlot));
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : readSlot
+//
+// DESCRIPTION     : copy the record in a slot, if it has an owner
+//
+//                   The copy is retried while the record is being written (the
+//                   sequence is odd) or if it was rewritten during the copy (the
+//                   sequence has changed).
+//
+// ARGUMENTS       : slot   IN  slot
+//                   record OUT record
+//
+// RETURNS         : true if a record has been copied
+//
+// ============================================================================
+static bool readSlot(const BoardSlot *slot,StatusBoard::STATUS_RECORD *record)
+{
+	for(int attempt=0;attempt<BOARD_READ_ATTEMPTS;attempt++)
+	{
+		unsigned int before = slot->sequence;
+		if((before&1)!=0)
+		{
+			continue;
+		}
+		BOARD_FENCE();
+		if(slot->owner==0)
+		{
+			return false;
+		}
+		memcpy(record,(const void *)&slot->record,sizeof(*record));
+		BOARD_FENCE();
+		if(slot->sequence==before)
+		{
+			record->svcName[StatusBoard::MAX_NAME-1] = '\0';
+			record->state[StatusBoard::MAX_STATE-1]  = '\0';
+			return record->svcName[0]!='\0';
+		}
+	}
+
+	// the writer has stopped part way through (or is very unlucky)
+	return false;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : isProcessAlive
+//
+// DESCRIPTION     : is a process still running?
+//
+// ARGUMENTS       : pid IN process id
+//
+// RETURNS         : true if it is (or we cannot tell)
+//
+// ============================================================================
+static bool isProcessAlive(unsigned int pid)
+{
+#if	BOARD_PLATFORM_IS_WIN32
+	HANDLE hProcess = OpenProcess(SYNCHRONIZE,FALSE,pid);
+	if(hProcess==NULL)
+	{
+		return GetLastError()==ERROR_ACCESS_DENIED;
+	}
+	bool alive = (WaitForSingleObject(hProcess,0)==WAIT_TIMEOUT);
+	CloseHandle(hProcess);
+	return alive;
+#else
+	return (kill((pid_t)pid,0)==0)||(errno!=ESRCH);
+#endif	// BOARD_PLATFORM_IS_WIN32
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : getOwnPid
+//
+// DESCRIPTION     : id of this process
+//
+// RETURNS         : process id
+//
+// ============================================================================
+static unsigned int getOwnPid()
+{
+#if	BOARD_PLATFORM_IS_WIN32
+	return (unsigned int)GetCurrentProcessId();
+#else
+	return (unsigned int)getpid();
+#endif	// BOARD_PLATFORM_IS_WIN32
+}
@@ -0,0 +1,165 @@
+// ============================================================================
+//
+// FILE        : StatusBoard.h
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : interface definition for StatusBoard class
+//
+//               The status board is a named shared memory segment, with one
+//               fixed-layout record for each service run by SrvStart on the
+//               machine (Global\srvstart.statusboard on Win32, falling back
+//               to Local\ for a process which cannot create global objects;
+//               /srvstart.statusboard elsewhere).  Each service publishes its
+//               state, pid, restarts, last exit and resource usage there, and
+//               a monitor reads every record with plain memory reads - no
+//               request to the service, nor to the SCM, per service.
+//
+//               Each record is guarded by a sequence lock:  the writer makes
+//               the sequence odd while it writes, and even again afterwards,
+//               and a reader retries a record whose sequence was odd, or
+//               changed while it was copied.  Writers never wait for readers.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// prevent multiple inclusion
+
+#if !defined(__STATUS_BOARD_H__)
+#define __STATUS_BOARD_H__
+
+// ============================================================================
+//
+// IMPORT / EXPORT
+//
+// ============================================================================
+
+//
+// if SRVSTART_DLL_EXPORT is #defined, then we are building the DLL
+//  and exporting the classes
+//
+// otherwise, we are building an executable which will link with the DLL at run-time
+//
+// -------------------------------------------------------------
+// APART FROM THE DLL ITSELF,
+//  ANY SOURCE FILE WHICH #includes THIS ONE SHOULD ENSURE THAT
+//  SRVSTART_DLL_EXPORT is not #defined
+// -------------------------------------------------------------
+//
+
+#ifdef SRVSTART_DLL_EXPORT
+#define SRVSTART_DLL_API __declspec(dllexport)
+#pragma message("exporting StatusBoard")
+
+#else
+
+#ifdef	SRVSTART_DLL_LOCAL
+#pragma message("StatusBoard is local")
+#define	SRVSTART_DLL_API
+
+#else
+
+#define SRVSTART_DLL_API __declspec(dllimport)
+#pragma message("importing StatusBoard")
+
+#endif
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// namespace header
+#include "SrvStart.h"
+
+// forward declarations
+struct StatusBoardData;
+
+// ============================================================================
+//
+// NAMESPACE
+//
+// ============================================================================
+
+// all the DLL classes are defined within the SrvStart namespace
+namespace SrvStart {
+
+// ============================================================================
+//
+// StatusBoard class
+//
+// ============================================================================
+class SRVSTART_DLL_API StatusBoard
+{
+public:
+	// size of the board, and of the names in it
+	enum { MAX_SERVICES = 512, MAX_NAME = 64, MAX_STATE = 16 };
+
+	// one service's record (times are in seconds since 1970, 0 if never)
+	struct STATUS_RECORD
+	{
+		char               svcName[MAX_NAME];
+		char               state[MAX_STATE];	// as reported by srvctl status
+		unsigned int       ownerPid;			// the SrvStart process
+		unsigned int       pid;					// the command (0 if none)
+		unsigned int       restarts;
+		unsigned int       lastExitCode;
+		unsigned long long lastExitTime;
+		unsigned long long transitionTime;		// when the state last changed
+		unsigned long long sampleTime;			// when the usage below was sampled
+		unsigned long long userMilliseconds;
+		unsigned long long kernelMilliseconds;
+		unsigned long long workingSet;
+		unsigned long long pagefile;
+		unsigned long long readBytes;
+		unsigned long long writeBytes;
+		unsigned int       handles;
+		unsigned int       reserved;
+	} ;
+
+	// writer:  take a record on the board for a service, and publish to it
+	//  (the ownerPid is filled in)
+	void open(const char *svcName) throw (SrvStartException);
+	void close();
+	bool isOpen() const;
+	void publish(const STATUS_RECORD &record);
+
+	// reader:  copy the records of every service on the board (returns the
+	//  number copied)
+	static int snapshot(STATUS_RECORD *records,int maxRecords);
+
+	// constructor and destructor
+	StatusBoard();
+	virtual ~StatusBoard();
+
+private:
+	// no copying
+	StatusBoard(const StatusBoard &);
+	StatusBoard &operator=(const StatusBoard &);
+
+private:	// data members - hidden data
+	struct StatusBoardData *statusBoardData;
+
+};
+
+} // namespace SrvStart
+
+#endif // !defined(__STATUS_BOARD_H__)
@@ -0,0 +1,476 @@
+// ============================================================================
+//
+// FILE        : StringArena.cpp
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : Implementation of StringArena class
+//
+//               Strings are carved one after another out of the current
+//               block.  Appending to the most recently allocated string
+//               extends it in place;  when the block is full, the string is
+//               moved to a new block at least twice its size, so building a
+//               command line from many arguments costs amortised linear time.
+//
+//               Each string is preceded by its capacity (the longest string
+//               its storage can hold), so that assign() can reuse the storage
+//               even after a shorter value has been put in it.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// this is the "main" source file
+#define	SRVSTART_DLL
+
+// we are exporting the class
+#define	SRVSTART_DLL_EXPORT
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// system headers
+#include <stdlib.h>
+#include <string.h>
+
+// class headers
+#include "StringArena.h"
+
+// ============================================================================
+//
+// NAMESPACE DECLARATIONS
+//
+// ============================================================================
+
+using namespace SrvStart;
+
+// ============================================================================
+//
+// CONSTANT DEFINITIONS
+//
+// ============================================================================
+
+// room in front of each string for its capacity
+const int STRING_ARENA_HEADER = sizeof(int);
+
+// ============================================================================
+//
+// LOCAL CLASSES
+//
+// ============================================================================
+
+//
+// block of string storage
+//
+struct StringArenaBlock
+{
+	char *data;
+	int   size;
+	int   used;
+
+	// previous block
+	StringArenaBlock *next;
+
+	// constructor / destructor
+	StringArenaBlock(int sz,StringArenaBlock *nxt)
+	{
+		data = new char[sz];
+		size = sz;
+		used = 0;
+		next = nxt;
+	} ;
+
+	virtual ~StringArenaBlock()
+	{
+		delete[] data;
+	} ;
+
+} ;
+
+// ============================================================================
+//
+// LOCAL FUNCTION PROTOTYPES
+//
+// ============================================================================
+
+static int  getCapacity(const char *str);
+static void setCapacity(char *str,int capacity);
+
+// ============================================================================
+//
+// PUBLIC MEMBER FUNCTIONS
+//
+// ============================================================================
+
+
+// ============================================================================
+//
+// MEMBER FUNCTION : StringArena::StringArena
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : constructor
+//
+//                   No storage is allocated until the first string is stored.
+//
+// ARGUMENTS       : blockSize IN normal size of each block of storage
+//
+// ============================================================================
+StringArena::StringArena
+(
+	int blockSize
+)
+{
+	_blockSize   = blockSize;
+	currentBlock = 0;
+	lastString   = 0;
+	lastLength   = 0;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : StringArena::~StringArena
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : destructor - frees every string in the arena
+//
+// ============================================================================
+StringArena::~StringArena()
+{
+	release();
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : StringArena::allocate
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : allocate storage for a string
+//
+// ARGUMENTS       : len IN string length (excluding the terminator)
+//
+// RETURNS         : the storage, holding an empty string
+//
+// ============================================================================
+char *StringArena::allocate
+(
+	int len
+)
+{
+	int need = STRING_ARENA_HEADER+len+1;
+
+	// is there room in the current block?
+	if((currentBlock==0)||(currentBlock->used+need>currentBlock->size))
+	{
+		// no - start a new one, leaving room for the string to grow
+		int size = (need*2>_blockSize ? need*2 : _blockSize);
+		currentBlock = new StringArenaBlock(size,currentBlock);
+	}
+
+	lastString    = currentBlock->data+currentBlock->used+STRING_ARENA_HEADER;
+	lastLength    = 0;
+	lastString[0] = '\0';
+	setCapacity(lastString,len);
+	currentBlock->used += need;
+	return lastString;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : StringArena::copy
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : copy a string into the arena
+//
+// ARGUMENTS       : src IN string to copy
+//
+// RETURNS         : the copy
+//
+// ============================================================================
+char *StringArena::copy
+(
+	const char *src
+)
+{
+	int   len = strlen(src);
+	char *dest = allocate(len);
+	memcpy(dest,src,len+1);
+	lastLength = len;
+	return dest;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : StringArena::append
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : append to a string
+//
+//                   If dest is the most recently allocated string and there is
+//                   room in its block, it is extended in place.  Otherwise a
+//                   new copy is made, and the old one is left in the arena.
+//
+// ARGUMENTS       : dest     IN string to append to (may be NULL)
+//                   src      IN string to append
+//                   addSpace IN if true, add a space before src
+//
+// RETURNS         : the result (which may not be at dest)
+//
+// ============================================================================
+char *StringArena::append
+(
+	char       *dest,
+	const char *src,
+	bool        addSpace
+)
+{
+	// nothing to append to?
+	if(dest==0)
+	{
+		return copy(src);
+	}
+
+	int destLen = (dest==lastString ? lastLength : strlen(dest));
+	int srcLen  = strlen(src);
+	int extra   = srcLen+(addSpace?1:0);
+	int grow    = 0;
+
+	// its storage may already have room (see assign)
+	if(dest==lastString)
+	{
+		grow = destLen+extra-getCapacity(dest);
+		if(grow<0) { grow = 0; }
+	}
+
+	// can it be extended in place?
+	if((dest!=lastString)||(currentBlock->used+grow>currentBlock->size))
+	{
+		// no - move it
+		char *tmp = dest;
+		dest = allocate(destLen+extra);
+		memcpy(dest,tmp,destLen);
+	}
+	else if(grow>0)
+	{
+		currentBlock->used += grow;
+		setCapacity(dest,destLen+extra);
+	}
+
+	// append (src may be part of dest)
+	char *outCh = dest+destLen;
+	if(addSpace) { (*outCh++) = ' '; }
+	memmove(outCh,src,srcLen);
+	outCh[srcLen] = '\0';
+	lastLength = destLen+extra;
+	return dest;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : StringArena::assign
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : replace a string
+//
+//                   If dest belongs to the arena and its storage can hold src,
+//                   src is copied over it;  if dest is the most recently
+//                   allocated string and there is room in its block, it is
+//                   extended in place.  Otherwise a new copy is made, and the
+//                   old one is left in the arena.  So a string which is set
+//                   again and again only takes up the storage of its longest
+//                   value.
+//
+// ARGUMENTS       : dest IN string to replace (may be NULL, or not in the arena)
+//                   src  IN string to copy
+//
+// RETURNS         : the result (which may not be at dest)
+//
+// ============================================================================
+char *StringArena::assign
+(
+	char       *dest,
+	const char *src
+)
+{
+	if((dest==0)||(!contains(dest)))
+	{
+		return copy(src);
+	}
+
+	int srcLen = strlen(src);
+	if(srcLen>getCapacity(dest))
+	{
+		// too big - can it be extended in place?
+		int extra = srcLen-getCapacity(dest);
+		if((dest!=lastString)||(currentBlock->used+extra>currentBlock->size))
+		{
+			return copy(src);
+		}
+		currentBlock->used += extra;
+		setCapacity(dest,srcLen);
+	}
+
+	// src may be part of dest
+	memmove(dest,src,srcLen+1);
+	if(dest==lastString) { lastLength = srcLen; }
+	return dest;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : StringArena::reclaim
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : give back the storage of a string
+//
+//                   Only the most recently allocated string can be given back
+//                   (its storage is used for the next one);  for any other
+//                   string this does nothing.
+//
+// ARGUMENTS       : str IN string (may be NULL)
+//
+// ============================================================================
+void StringArena::reclaim
+(
+	char *str
+)
+{
+	if((str==0)||(str!=lastString))
+	{
+		return;
+	}
+
+	currentBlock->used = (int)(str-currentBlock->data)-STRING_ARENA_HEADER;
+	lastString = 0;
+	lastLength = 0;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : StringArena::release
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : free every string in the arena
+//
+// ============================================================================
+void StringArena::release()
+{
+	while(currentBlock!=0)
+	{
+		StringArenaBlock *block = currentBlock;
+		currentBlock = block->next;
+		delete block;
+	}
+	lastString = 0;
+	lastLength = 0;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : StringArena::getSize
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : get the amount of storage held by the arena
+//
+// RETURNS         : number of bytes
+//
+// ============================================================================
+int StringArena::getSize() const
+{
+	int size = 0;
+	for(StringArenaBlock *block=currentBlock; block!=0; block=block->next)
+	{
+		size += block->size;
+	}
+	return size;
+}
+
+// ============================================================================
+//
+// PRIVATE MEMBER FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// MEMBER FUNCTION : StringArena::contains
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : does a string belong to the arena?
+//
+// ARGUMENTS       : str IN string
+//
+// RETURNS         : true if it does
+//
+// ============================================================================
+bool StringArena::contains
+(
+	const char *str
+) const
+{
+	for(StringArenaBlock *block=currentBlock; block!=0; block=block->next)
+	{
+		if((str>=block->data+STRING_ARENA_HEADER)&&(str<block->data+block->used))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// ============================================================================
+//
+// LOCAL UTILITY FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : getCapacity
+//                   setCapacity
+//
+// DESCRIPTION     : the capacity stored in front of a string (it may not be
+//                   aligned, so it is copied byte by byte)
+//
+// ARGUMENTS       : str      IN string
+//                   capacity IN longest string its storage can hold
+//
+// ============================================================================
+static int getCapacity(const char *str)
+{
+	int capacity;
+	memcpy(&capacity,str-STRING_ARENA_HEADER,sizeof(capacity));
+	return capacity;
+}
+
+static void setCapacity(char *str,int capacity)
+{
+	memcpy(str-STRING_ARENA_HEADER,&capacity,sizeof(capacity));
+}
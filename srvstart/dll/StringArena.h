@@ -0,0 +1,144 @@
+// ============================================================================
+//
+// FILE        : StringArena.h
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : interface definition for StringArena class
+//
+//               A StringArena holds strings in large blocks of storage, which
+//               are all freed together when the arena is destroyed.  Strings
+//               are not freed individually, but a string can be overwritten
+//               in its own storage (see assign), and the most recently
+//               allocated one can be given back (see reclaim).
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// prevent multiple inclusion
+
+#if !defined(__STRING_ARENA_H__)
+#define __STRING_ARENA_H__
+
+// ============================================================================
+//
+// IMPORT / EXPORT
+//
+// ============================================================================
+
+//
+// if SRVSTART_DLL_EXPORT is #defined, then we are building the DLL
+//  and exporting the classes
+//
+// otherwise, we are building an executable which will link with the DLL at run-time
+//
+// -------------------------------------------------------------
+// APART FROM THE DLL ITSELF,
+//  ANY SOURCE FILE WHICH #includes THIS ONE SHOULD ENSURE THAT
+//  SRVSTART_DLL_EXPORT is not #defined
+// -------------------------------------------------------------
+//
+
+#ifdef SRVSTART_DLL_EXPORT
+#define SRVSTART_DLL_API __declspec(dllexport)
+#pragma message("exporting StringArena")
+
+#else
+
+#ifdef	SRVSTART_DLL_LOCAL
+#pragma message("StringArena is local")
+#define	SRVSTART_DLL_API
+
+#else
+
+#define SRVSTART_DLL_API __declspec(dllimport)
+#pragma message("importing StringArena")
+
+#endif
+#endif
+
+// forward declarations
+struct StringArenaBlock;
+
+// ============================================================================
+//
+// NAMESPACE
+//
+// ============================================================================
+
+// all the DLL classes are defined within the SrvStart namespace
+namespace SrvStart {
+const int STRING_ARENA_DEFAULT_BLOCKSIZE = 4096;
+
+// ============================================================================
+//
+// StringArena class
+//
+// ============================================================================
+class SRVSTART_DLL_API StringArena {
+public:
+	// allocate room for a string of len characters (plus terminator)
+	char *allocate(int len);
+
+	// copy a string into the arena
+	char *copy(const char *src);
+
+	// append to a string in the arena (returns the string, which may have moved)
+	char *append(char *dest, const char *src, bool addSpace=false);
+
+	// replace a string, in its own storage if it is big enough (returns the
+	//  string, which may have moved)
+	char *assign(char *dest, const char *src);
+
+	// give back the storage of the most recently allocated string (any other
+	//  string stays until the arena is released)
+	void reclaim(char *str);
+
+	// free every string in the arena
+	void release();
+
+	// number of bytes held by the arena
+	int getSize() const;
+
+	// constructor and destructor
+	StringArena(int blockSize = STRING_ARENA_DEFAULT_BLOCKSIZE);
+	virtual ~StringArena();
+
+private:
+	// no copying
+	StringArena(const StringArena &);
+	StringArena &operator=(const StringArena &);
+
+	// does the string belong to the arena?
+	bool contains(const char *str) const;
+
+private:
+	int _blockSize;
+
+	// block currently being filled (most recent first)
+	struct StringArenaBlock *currentBlock;
+
+	// most recently allocated string, and its length
+	char *lastString;
+	int   lastLength;
+};
+
+} // namespace SrvStart
+
+#endif // !defined(__STRING_ARENA_H__)
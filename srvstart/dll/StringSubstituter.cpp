@@ -6,7 +6,7 @@
 //
 // DESCRIPTION : Implementation of StringSubstituter class
 //
-//               This class is a bit of an abomination.  Sorry.
+//               The substitution itself is done by SubstitutionTemplate.
 //
 // MODIFICATION HISTORY
 // --------------------
@@ -43,16 +43,14 @@
 #define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
 #include <windows.h>
 #include <stdlib.h>
-#include <iostream>
-#include <fstream>
-using namespace std;
-#include <conio.h>
+#include <string.h>
 
 // support headers
 #include <logger.h>
 
 // class headers
 #include "StringSubstituter.h"
+#include "SubstitutionTemplate.h"
 
 // ============================================================================
 //
@@ -62,20 +60,6 @@ using namespace std;
 
 using namespace SrvStart;
 
-// ============================================================================
-//
-// CONSTANT DEFINITIONS
-//
-// ============================================================================
-
-const char INPUT_START		= '{';
-const char INPUT_SEPARATOR	= ':';
-const char INPUT_END		= '}';
-const char HIDDEN_INDICATOR	= '-';
-
-const char ENV_START		= '%';
-const char ENV_END			= '%';
-
 // ============================================================================
 //
 // PUBLIC MEMBER FUNCTIONS
@@ -91,15 +75,11 @@ const char ENV_END			= '%';
 //
 // DESCRIPTION     : constructors
 //
-// ARGUMENTS       : bufsize IN buffer size
+// ARGUMENTS       : bufsize IN size of each block of string storage
 //
 // ============================================================================
-StringSubstituter::StringSubstituter(int bufSize)
+StringSubstituter::StringSubstituter(int bufSize) : arena(bufSize)
 {
-	_bufSize   = bufSize;
-	buf        = new char[_bufSize];
-	tmpString1 = new char[_bufSize];
-	tmpString2 = new char[_bufSize];
 }
 
 // ============================================================================
@@ -110,12 +90,12 @@ StringSubstituter::StringSubstituter(int bufSize)
 //
 // DESCRIPTION     : destructor
 //
+//                   All the strings allocated by this StringSubstituter are
+//                   freed here, in one go.
+//
 // ============================================================================
 StringSubstituter::~StringSubstituter()
 {
-	delete []buf;
-	delete []tmpString1;
-	delete []tmpString2;
 }
 
 // ============================================================================
@@ -146,10 +126,11 @@ void StringSubstituter::stringInit
 //
 // DESCRIPTION     : garbage-collecting version of strcpy
 //
-//                   This function copies the string in src to dest.  If dest
-//                   is not NULL, it frees the storage pointed to by dest.  It
-//                   then allocates exactly enough storage, storing the result
-//                   in dest, and copies src to dest.
+//                   This function copies the string in src into this
+//                   StringSubstituter's arena, storing the result in dest.
+//                   The storage of any previous value of dest is reused if it
+//                   is big enough, so setting a string again and again (as a
+//                   configuration reload does) does not grow the arena.
 //
 // ARGUMENTS       : dest INOUT where to copy to (may be NULL or empty)
 //                   src  IN    where to copy from
@@ -162,22 +143,7 @@ void StringSubstituter::stringCopy
 )
 {
 	// LOGGER_LOG_DEBUG("stringCopy()")
-
-	// has dest already been allocated?
-	if(dest!=0)
-	{
-		// yes, it has
-		// LOGGER_LOG_DEBUG1("stringCopy(): deleting dest (%p)",dest)
-		delete[] dest;
-	}
-
-	// allocate new storage
-	int len = strlen(src);
-	// LOGGER_LOG_DEBUG1("stringCopy(): allocating %d+1 bytes",len)
-	dest=new char[len+1];
-
-	// copy string
-	strcpy(dest,src);
+	dest = arena.assign(dest,src);
 	// LOGGER_LOG_DEBUG1("stringCopy(): dest is now '%s'",dest)
 }
 
@@ -190,12 +156,14 @@ void StringSubstituter::stringCopy
 // DESCRIPTION     : garbage-collecting version of strcat
 //
 //                   This function appends the string in src to dest.  If dest
-//                   is not NULL, it frees the storage pointed to by dest.  It
-//                   then allocates exactly enough storage, storing the result
-//                   in dest, and appends src to dest.
+//                   was the last string allocated, it is extended in place;
+//                   otherwise it is moved to a larger space in the arena.
+//                   Building a string from many pieces therefore costs time
+//                   proportional to its final length.
 //
-// ARGUMENTS       : dest INOUT where to copy to (may be NULL or empty)
-//                   src  IN    where to copy from
+// ARGUMENTS       : dest     INOUT where to copy to (may be NULL or empty)
+//                   src      IN    where to copy from
+//                   addSpace IN    if true, add a space before src
 //
 // ============================================================================
 void StringSubstituter::stringAppend
@@ -206,32 +174,8 @@ void StringSubstituter::stringAppend
 )
 {
 	// LOGGER_LOG_DEBUG("stringAppend")
-
-	// has dest been allocated?
-	if(dest!=0)
-	{
-		// yes, it has
-		int len = strlen(dest)+strlen(src)+(addSpace?1:0);
-		// LOGGER_LOG_DEBUG1("stringAppend(): reallocating %d bytes",len+1)
-		char *tmp = dest;
-		dest = new char[len+1];
-		strcpy(dest,tmp);
-		if(addSpace) { strcat(dest," "); }
-		strcat(dest,src);
-		// LOGGER_LOG_DEBUG1("stringAppend(): deleting old dest (%p)",tmp)
-		delete[] tmp;
-	}
-	else
-	{
-		// no, it hasn't
-		int len = strlen(src);
-		// LOGGER_LOG_DEBUG1("stringAppend(): allocating %d bytes",len+1)
-		dest = new char[len+1];
-		// copy string
-		strcpy(dest,src);
-	}
+	dest = arena.append(dest,src,addSpace);
 	// LOGGER_LOG_DEBUG1("stringAppend(): dest is now '%s'",dest)
-
 }
 
 // ============================================================================
@@ -240,9 +184,14 @@ void StringSubstituter::stringAppend
 //
 // ACCESS SPECIFIER: public
 //
-// DESCRIPTION     : delete storage pointed to by string if not NULL
+// DESCRIPTION     : release a string
+//
+//                   If str was the last string allocated (as a temporary
+//                   usually is), its storage is used again for the next one;
+//                   otherwise it stays in the arena until the
+//                   StringSubstituter is destroyed.
 //
-// ARGUMENTS       : str INOUT storage to delete
+// ARGUMENTS       : str IN string to release (must not be used afterwards)
 //
 // ============================================================================
 void StringSubstituter::stringDelete
@@ -250,11 +199,7 @@ void StringSubstituter::stringDelete
 	char *str
 )
 {
-	if(str!=0)
-	{
-		// LOGGER_LOG_DEBUG1("stringDelete(): deleting string (%p)",str)
-		delete[] str;
-	}
+	arena.reclaim(str);
 }
 
 // ============================================================================
@@ -265,167 +210,27 @@ void StringSubstituter::stringDelete
 //
 // DESCRIPTION     : substitute into given string buffer
 //
-// ARGUMENTS       : subBuf INOUT buffer to substitute into
+//                   The string is compiled into a SubstitutionTemplate and
+//                   rendered once.  Callers which substitute the same string
+//                   repeatedly should keep a SubstitutionTemplate instead.
+//
+// ARGUMENTS       : subBuf  INOUT buffer to substitute into
+//                   context IN    where to find environment variables (if
+//                                 NULL, the process environment is used)
+//
+// THROWS          : SrvStartException (see SubstitutionTemplate::render)
 //
 // ============================================================================
 void StringSubstituter::stringSubstitute
 (
-	char *&subBuf
+	char                *&subBuf,
+	SubstitutionContext  *context
 )
 {
-	char *inCh  = subBuf;
-	char *outCh = buf;
-	char *tmpCh, *envCh;
-	char  ch;
-	bool  hiddenReply;
-	
 	LOGGER_LOG_DEBUG1("stringSubstitute: input string is '%s'",subBuf)
-	
-	while(true)
-	{
-		// read next character
-		ch = (*inCh++);
-		// what is it?
-		switch(ch)
-		{
-			case '\0':
-				// end of string
-				(*outCh) = '\0';
-				goto END_OF_INPUT;
-				
-			case INPUT_START:
-				// substitute from stdin
-				LOGGER_LOG_DEBUG1("stringSubstitute: stdin substitution at '%s'",inCh-1)
-				// is this hidden text?
-				if((*inCh)==HIDDEN_INDICATOR)
-				{
-					// yes, it is
-					LOGGER_LOG_DEBUG("stringSubstitute: hidden text indicated")
-					hiddenReply = true;
-					inCh++;
-				}
-				else
-				{
-					// no, it isn't
-					LOGGER_LOG_DEBUG("stringSubstitute: hidden text NOT indicated")
-					hiddenReply = false;
-				}
-
-				// get prompt
-				tmpCh = tmpString1;
-				while(((*inCh)!=INPUT_SEPARATOR)&&((*inCh)!=INPUT_END)&&((*inCh)!='\0'))
-				{
-					// read the prompt
-					(*tmpCh++) = (*inCh);
-					if((*inCh)!='\0') { inCh++; }
-				}
-				// add terminator
-				(*tmpCh) = '\0';
-				bool foundSeparator;
-				foundSeparator = ((*inCh)== INPUT_SEPARATOR);
-				if((*inCh)!='\0') { inCh++; }
-				LOGGER_LOG_DEBUG1("stringSubstitute: prompt is '%s'",tmpString1)
-
-				if(foundSeparator)
-				{
-					// get default
-					tmpCh = tmpString2;
-					while(((*inCh)!=INPUT_END)&&((*inCh)!='\0'))
-					{
-						// read the default
-						(*tmpCh++) = (*inCh);
-						if((*inCh)!='\0') { inCh++; }
-					}
-					// add terminator
-					(*tmpCh) = '\0';
-					if((*inCh)!='\0') { inCh++; }
-					LOGGER_LOG_DEBUG1("stringSubstitute: default is '%s'",tmpString2)
-				}
-				else
-				{
-					// no default provided
-					tmpString2[0] = '\0';
-				}
-				
-				// display prompt to stdout
-				cout << tmpString1 << " [" << tmpString2 << "]: "; cout.flush();
-
-				// read input
-				if(hiddenReply)
-				{
-					// do not echo the entered reply (eg a password)
-					// have to read input directly from console (without echo)
-					// IS THERE A BETTER WAY TO DO THIS?
-					tmpCh = tmpString1;
-					while(true)
-					{
-						// get the next character from the console
-						char ch = _getch();
-						if(ch==13) { (*tmpCh) = '\0'; cout << '\n'; cout.flush(); break; }
-						(*tmpCh++) = ch;
-					}
-				}
-				else
-				{
-					// read input from stdin
-					cin.getline(tmpString1,_bufSize);
-				}
-				LOGGER_LOG_DEBUG1("entered reply is '%s'",tmpString1)
-				
-				// if reply is empty, use default
-				if (tmpString1[0] == '\0')
-				{
-					strcpy(tmpString1,tmpString2);
-					LOGGER_LOG_DEBUG1("using default reply '%s'",tmpString1)
-				}
 
-				// copy reply string into output buffer
-				tmpCh = tmpString1;
-				while ((*tmpCh)!='\0') { (*outCh++) = (*tmpCh++); }
+	SubstitutionTemplate subTemplate(subBuf);
+	stringCopy(subBuf,subTemplate.render(context));
 
-				// that's it
-				break;
-
-			case ENV_START:
-				// substitute from stdin
-				LOGGER_LOG_DEBUG1("stringSubstitute: environment substitution at '%s'",inCh-1)
-				// get environment variable
-				tmpCh = tmpString1;
-				while(((*inCh)!=ENV_END)&&((*inCh)!='\0'))
-				{
-					// read the environment variable
-					(*tmpCh++) = (*inCh);
-					if((*inCh)!='\0') { inCh++; }
-				}
-				// add terminator
-				(*tmpCh) = '\0';
-				if((*inCh)!='\0') { inCh++; }
-				LOGGER_LOG_DEBUG1("stringSubstitute: environment variable is '%s'",tmpString1)
-				
-				// get environment value
-				envCh = tmpString2;
-				if(GetEnvironmentVariable(tmpString1,envCh,_bufSize)==0)
-				{
-					LOGGER_LOG_INFO1("warning: unable to substitute environment variable '%s' (using blank)",tmpString1)
-					(*envCh) = '\0';
-				}
-				LOGGER_LOG_DEBUG1("substitute: environment value is '%s'",envCh)
-
-				// copy environment value into output buffer
-				while ((*envCh)!='\0') { (*outCh++) = (*envCh++); }
-
-				break;
-
-			default:
-				// ordinary character
-				(*outCh++) = ch;
-
-		}
-	}
-END_OF_INPUT:
-	// copy processed string back into input
-	LOGGER_LOG_DEBUG("stringSubstitute: finished loop")
-	stringCopy(subBuf,buf);
 	LOGGER_LOG_DEBUG1("stringSubstitute: output string is '%s'",subBuf)
-
 }
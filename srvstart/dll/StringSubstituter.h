@@ -67,6 +67,9 @@
 #endif
 #endif
 
+// storage for strings
+#include "StringArena.h"
+
 // ============================================================================
 //
 // NAMESPACE
@@ -77,6 +80,8 @@
 namespace SrvStart {
 const int STRING_SUBSTITUTER_DEFAULT_BUFSIZE = 5000;
 
+class SubstitutionContext;
+
 // ============================================================================
 //
 // StringSubstituter class
@@ -91,19 +96,15 @@ public:
 	void stringDelete(char *str);
 
 	// substitute environment values into string
-	void stringSubstitute(char *&subBuf);
+	void stringSubstitute(char *&subBuf,SubstitutionContext *context = 0);
 	
 	// constructor and destructor
 	StringSubstituter(int bufSize = STRING_SUBSTITUTER_DEFAULT_BUFSIZE);
 	virtual ~StringSubstituter();
 
 private:
-	int _bufSize;
-	char *buf;
-	char *tmpString1;
-	char *tmpString2;
-
-	
+	// storage for every string allocated by this StringSubstituter
+	StringArena arena;
 };
 
 } // namespace SrvStart
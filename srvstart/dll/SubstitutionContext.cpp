@@ -0,0 +1,642 @@
+// ============================================================================
+//
+// FILE        : SubstitutionContext.cpp
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : Implementation of SubstitutionContext class
+//
+//               Variables taken from the process environment are held as they
+//               are.  A variable set by an env directive is held as a
+//               SubstitutionTemplate, and substituted (against this context)
+//               the first time it is looked up.  So a value may refer to
+//               variables set before or after it;  a reference to its own name
+//               (eg PATH=%PATH%;C:\bin) means the definition it replaced, and
+//               any other loop back to a variable being substituted is an
+//               error.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// this is the "main" source file
+#define	SRVSTART_DLL
+
+// we are exporting the class
+#define	SRVSTART_DLL_EXPORT
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// system headers
+#define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+// support headers
+#include <logger.h>
+
+// class headers
+#include "SrvStart.h"
+#include "SubstitutionTemplate.h"
+#include "SubstitutionContext.h"
+
+// ============================================================================
+//
+// NAMESPACE DECLARATIONS
+//
+// ============================================================================
+
+using namespace SrvStart;
+
+// ============================================================================
+//
+// CONSTANT DEFINITIONS
+//
+// ============================================================================
+
+// initial number of hash buckets (always a power of 2)
+const int CONTEXT_INITIAL_BUCKETS = 64;
+
+// ============================================================================
+//
+// LOCAL CLASSES
+//
+// ============================================================================
+
+//
+// one variable
+//
+struct SubstitutionEntry
+{
+	char *name;
+	unsigned long hash;
+
+	// value (for a set variable, 0 until it has been substituted)
+	char *value;
+	// value as set (0 for a variable from the process environment)
+	SubstitutionTemplate *valueTemplate;
+	// being substituted now?
+	bool expanding;
+
+	// definition this one replaced (0 if none)
+	SubstitutionEntry *previous;
+	// next entry in the same hash bucket
+	SubstitutionEntry *nextInBucket;
+	// next variable set (in the order they were set)
+	SubstitutionEntry *nextSet;
+
+	// constructor / destructor
+	SubstitutionEntry(const char *nm,int len,unsigned long h)
+	{
+		name = new char[len+1];
+		memcpy(name,nm,len);
+		name[len] = '\0';
+		hash          = h;
+		value         = 0;
+		valueTemplate = 0;
+		expanding     = false;
+		previous      = 0;
+		nextInBucket  = 0;
+		nextSet       = 0;
+	} ;
+
+	virtual ~SubstitutionEntry()
+	{
+		// a set variable's value belongs to its template
+		if(valueTemplate==0) { delete[] value; }
+		delete valueTemplate;
+		delete[] name;
+	} ;
+
+} ;
+
+//
+// SubstitutionContext data
+//
+struct SubstitutionContextData
+{
+	// hash table of current definitions
+	SubstitutionEntry **buckets;
+	int bucketCount;
+	int count;
+
+	// every entry ever added (for deletion)
+	SubstitutionEntry **entries;
+	int entryCount;
+	int entrySize;
+
+	// variables set, in order
+	SubstitutionEntry *firstSet;
+	SubstitutionEntry *lastSet;
+
+	// innermost variable being substituted
+	SubstitutionEntry *expanding;
+
+	// environment block (0 until built)
+	char *environmentBlock;
+
+	// constructor / destructor
+	SubstitutionContextData()
+	{
+		buckets     = 0;
+		entries     = 0;
+		entryCount  = 0;
+		environmentBlock = 0;
+		clear();
+	} ;
+
+	virtual ~SubstitutionContextData()
+	{
+		clear();
+		delete[] buckets;
+	} ;
+
+	// discard every variable
+	void clear()
+	{
+		for(int i=0; i<entryCount; i++) { delete entries[i]; }
+		delete[] entries;
+		delete[] buckets;
+		delete[] environmentBlock;
+
+		bucketCount = CONTEXT_INITIAL_BUCKETS;
+		buckets     = new SubstitutionEntry *[bucketCount];
+		memset(buckets,0,bucketCount*sizeof(SubstitutionEntry *));
+		count       = 0;
+		entries     = 0;
+		entryCount  = 0;
+		entrySize   = 0;
+		firstSet    = 0;
+		lastSet     = 0;
+		expanding   = 0;
+		environmentBlock = 0;
+	} ;
+
+	// hash a name (case-insensitive FNV-1a)
+	static unsigned long hashName(const char *nm,int len)
+	{
+		unsigned long h = 2166136261UL;
+		for(int i=0; i<len; i++)
+		{
+			h ^= (unsigned char)toupper((unsigned char)nm[i]);
+			h *= 16777619UL;
+		}
+		return h;
+	} ;
+
+	// find the current definition of a name
+	SubstitutionEntry *find(const char *nm)
+	{
+		unsigned long h = hashName(nm,strlen(nm));
+		for(SubstitutionEntry *e=buckets[h&(bucketCount-1)]; e!=0; e=e->nextInBucket)
+		{
+			if((e->hash==h)&&(_stricmp(e->name,nm)==0)) { return e; }
+		}
+		return 0;
+	} ;
+
+	// add a definition, replacing any current one
+	SubstitutionEntry *add(const char *nm,int len)
+	{
+		unsigned long h = hashName(nm,len);
+		SubstitutionEntry *e = new SubstitutionEntry(nm,len,h);
+
+		// remember it
+		if(entryCount==entrySize)
+		{
+			SubstitutionEntry **tmp = entries;
+			entrySize = (entrySize==0 ? CONTEXT_INITIAL_BUCKETS : entrySize*2);
+			entries   = new SubstitutionEntry *[entrySize];
+			if(entryCount>0) { memcpy(entries,tmp,entryCount*sizeof(SubstitutionEntry *)); }
+			delete[] tmp;
+		}
+		entries[entryCount++] = e;
+
+		// replace the current definition, if any
+		SubstitutionEntry **link = &buckets[h&(bucketCount-1)];
+		while((*link)!=0)
+		{
+			if(((*link)->hash==h)&&(_stricmp((*link)->name,e->name)==0))
+			{
+				e->previous     = (*link);
+				e->nextInBucket = (*link)->nextInBucket;
+				(*link) = e;
+				return e;
+			}
+			link = &((*link)->nextInBucket);
+		}
+		(*link) = e;
+		if(++count>bucketCount) { grow(); }
+		return e;
+	} ;
+
+	// double the number of hash buckets
+	void grow()
+	{
+		int newCount = bucketCount*2;
+		SubstitutionEntry **newBuckets = new SubstitutionEntry *[newCount];
+		memset(newBuckets,0,newCount*sizeof(SubstitutionEntry *));
+		for(int i=0; i<bucketCount; i++)
+		{
+			SubstitutionEntry *e = buckets[i];
+			while(e!=0)
+			{
+				SubstitutionEntry *next = e->nextInBucket;
+				e->nextInBucket = newBuckets[e->hash&(newCount-1)];
+				newBuckets[e->hash&(newCount-1)] = e;
+				e = next;
+			}
+		}
+		delete[] buckets;
+		buckets     = newBuckets;
+		bucketCount = newCount;
+	} ;
+
+	// forget every substituted value (after a variable has been set)
+	void invalidate()
+	{
+		for(SubstitutionEntry *e=firstSet; e!=0; e=e->nextSet) { e->value = 0; }
+		delete[] environmentBlock;
+		environmentBlock = 0;
+	} ;
+
+} ;
+
+// ============================================================================
+//
+// LOCAL FUNCTION PROTOTYPES
+//
+// ============================================================================
+
+static int compareEntries(const void *e1,const void *e2);
+
+// ============================================================================
+//
+// PUBLIC MEMBER FUNCTIONS
+//
+// ============================================================================
+
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SubstitutionContext::SubstitutionContext
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : constructor
+//
+// ARGUMENTS       : takeSnapshot IN if true, start with a snapshot of the
+//                                   process environment
+//
+// ============================================================================
+SubstitutionContext::SubstitutionContext
+(
+	bool takeSnapshot
+)
+{
+	substitutionContextData = new SubstitutionContextData;
+	if(takeSnapshot) { snapshot(); }
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SubstitutionContext::~SubstitutionContext
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : destructor
+//
+// ============================================================================
+SubstitutionContext::~SubstitutionContext()
+{
+	delete substitutionContextData;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SubstitutionContext::snapshot
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : replace the context with a copy of the process environment
+//
+// ============================================================================
+void SubstitutionContext::snapshot()
+{
+	SubstitutionContextData *d = substitutionContextData;
+	d->clear();
+
+	char *env = GetEnvironmentStringsA();
+	if(env==0)
+	{
+		LOGGER_LOG_ERROR1("snapshot(): unable to read environment, error=%d",GetLastError())
+		return;
+	}
+
+	// the block is a list of NAME=VALUE strings, ending with an empty string
+	// (names of the per-drive current directories start with '=')
+	for(char *var=env; (*var)!='\0'; var+=strlen(var)+1)
+	{
+		char *equals = strchr(var+1,'=');
+		if(equals==0) { continue; }
+		SubstitutionEntry *e = d->add(var,equals-var);
+		int len  = strlen(equals+1);
+		e->value = new char[len+1];
+		memcpy(e->value,equals+1,len+1);
+	}
+	FreeEnvironmentStringsA(env);
+
+	LOGGER_LOG_DEBUG1("snapshot(): %d environment variables",d->count)
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SubstitutionContext::set
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : set a variable
+//
+//                   The value may contain any substitution;  it is substituted
+//                   when the variable is first looked up.
+//
+// ARGUMENTS       : nm  IN variable name
+//                   val IN variable value
+//
+// ============================================================================
+void SubstitutionContext::set
+(
+	const char *nm,
+	const char *val
+)
+{
+	SubstitutionContextData *d = substitutionContextData;
+
+	LOGGER_LOG_DEBUG2("SubstitutionContext::set('%s','%s')",nm,val)
+	d->invalidate();
+	SubstitutionEntry *e = d->add(nm,strlen(nm));
+	e->valueTemplate = new SubstitutionTemplate(val);
+
+	if(d->lastSet==0) { d->firstSet = e; }
+	else              { d->lastSet->nextSet = e; }
+	d->lastSet = e;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SubstitutionContext::unset
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : discard every value set for a variable, so that it has
+//                   its value in the snapshot again (or is not set at all)
+//
+// ARGUMENTS       : nm IN variable name
+//
+// ============================================================================
+void SubstitutionContext::unset
+(
+	const char *nm
+)
+{
+	SubstitutionContextData *d = substitutionContextData;
+
+	LOGGER_LOG_DEBUG1("SubstitutionContext::unset('%s')",nm)
+	unsigned long h = SubstitutionContextData::hashName(nm,strlen(nm));
+	SubstitutionEntry **link = &d->buckets[h&(d->bucketCount-1)];
+	while((*link)!=0)
+	{
+		if(((*link)->hash==h)&&(_stricmp((*link)->name,nm)==0))
+		{
+			// go back to the definition from the snapshot, if any
+			// (the entries themselves are deleted along with the context)
+			SubstitutionEntry *e = (*link);
+			SubstitutionEntry *original = e->previous;
+			while((original!=0)&&(original->valueTemplate!=0)) { original = original->previous; }
+			if(e->valueTemplate==0) { return; }
+
+			d->invalidate();
+			if(original==0)
+			{
+				(*link) = e->nextInBucket;
+				d->count--;
+			}
+			else
+			{
+				original->nextInBucket = e->nextInBucket;
+				(*link) = original;
+			}
+			return;
+		}
+		link = &((*link)->nextInBucket);
+	}
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SubstitutionContext::lookup
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : get the value of a variable
+//
+// ARGUMENTS       : nm IN variable name
+//
+// RETURNS         : the value, which belongs to the context (NULL if the
+//                   variable is not set)
+//
+// THROWS          : SrvStartException if the variable refers back to itself
+//                   through other variables, or a ${VAR:?error} fails
+//
+// ============================================================================
+const char *SubstitutionContext::lookup
+(
+	const char *nm
+) throw (SrvStartException)
+{
+	SubstitutionContextData *d = substitutionContextData;
+	SubstitutionEntry *e;
+
+	// a variable which refers to itself means its previous definition
+	if((d->expanding!=0)&&(_stricmp(d->expanding->name,nm)==0))
+	{
+		e = d->expanding->previous;
+	}
+	else
+	{
+		e = d->find(nm);
+	}
+
+	// not set, or already substituted?
+	if(e==0)        { return 0; }
+	if(e->value!=0) { return e->value; }
+
+	// does it refer back to itself?
+	if(e->expanding)
+	{
+		LOGGER_LOG_ERROR1("environment variable '%s' refers back to itself",nm)
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_INVALID_PARAMETER,"SubstitutionContext","lookup")
+	}
+
+	// substitute it
+	SubstitutionEntry *outer = d->expanding;
+	e->expanding = true;
+	d->expanding = e;
+	try
+	{
+		e->value = e->valueTemplate->render(this);
+	}
+	catch(...)
+	{
+		e->expanding = false;
+		d->expanding = outer;
+		throw;
+	}
+	e->expanding = false;
+	d->expanding = outer;
+
+	return e->value;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SubstitutionContext::apply
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : set every variable which has been set in the context in
+//                   the process environment too (for commands which inherit
+//                   it, eg those run using system())
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+void SubstitutionContext::apply() throw (SrvStartException)
+{
+	SubstitutionContextData *d = substitutionContextData;
+
+	for(SubstitutionEntry *e=d->firstSet; e!=0; e=e->nextSet)
+	{
+		// only the current definition
+		if(d->find(e->name)==e)
+		{
+			const char *val = lookup(e->name);
+			LOGGER_LOG_DEBUG2("apply(): SET %s=%s",e->name,val)
+			SetEnvironmentVariable(e->name,val);
+		}
+	}
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SubstitutionContext::getEnvironmentBlock
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : get an environment block holding every variable, sorted
+//                   by name, for CreateProcess
+//
+// RETURNS         : the block, which belongs to the context
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+char *SubstitutionContext::getEnvironmentBlock() throw (SrvStartException)
+{
+	SubstitutionContextData *d = substitutionContextData;
+	int i, n = 0, len = 0;
+
+	if(d->environmentBlock!=0)
+	{
+		return d->environmentBlock;
+	}
+
+	// collect the current definitions, and substitute their values
+	SubstitutionEntry **vars = new SubstitutionEntry *[d->count];
+	try
+	{
+		for(i=0; i<d->bucketCount; i++)
+		{
+			for(SubstitutionEntry *e=d->buckets[i]; e!=0; e=e->nextInBucket)
+			{
+				lookup(e->name);
+				vars[n++] = e;
+				len += strlen(e->name)+1+strlen(e->value)+1;
+			}
+		}
+	}
+	catch(...)
+	{
+		delete[] vars;
+		throw;
+	}
+	qsort(vars,n,sizeof(SubstitutionEntry *),compareEntries);
+
+	// build the block (which ends with an empty string)
+	char *outCh = d->environmentBlock = new char[len+2];
+	for(i=0; i<n; i++)
+	{
+		int nameLen  = strlen(vars[i]->name);
+		int valueLen = strlen(vars[i]->value);
+		memcpy(outCh,vars[i]->name,nameLen);
+		outCh += nameLen;
+		(*outCh++) = '=';
+		memcpy(outCh,vars[i]->value,valueLen+1);
+		outCh += valueLen+1;
+	}
+	if(n==0) { (*outCh++) = '\0'; }
+	(*outCh) = '\0';
+	delete[] vars;
+
+	return d->environmentBlock;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTIONS
+//
+// ============================================================================
+
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : compareEntries
+//
+// DESCRIPTION     : qsort() comparison function for environment block order
+//
+// ARGUMENTS       : e1, e2 IN pointers to the entries to compare
+//
+// RETURNS         : <0, 0 or >0
+//
+// ============================================================================
+static int compareEntries
+(
+	const void *e1,
+	const void *e2
+)
+{
+	return _stricmp((*(SubstitutionEntry * const *)e1)->name,
+					(*(SubstitutionEntry * const *)e2)->name);
+}
@@ -0,0 +1,139 @@
+// ============================================================================
+//
+// FILE        : SubstitutionContext.h
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : interface definition for SubstitutionContext class
+//
+//               A SubstitutionContext holds the environment variables which
+//               %VAR% and ${VAR} references are substituted from:  a snapshot
+//               of the process environment, taken once, plus the variables set
+//               by env directives.  Names are hashed (case-insensitively, as
+//               Windows does), so each lookup takes constant time, and later
+//               changes to the process environment do not affect it.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// prevent multiple inclusion
+
+#if !defined(__SUBSTITUTION_CONTEXT_H__)
+#define __SUBSTITUTION_CONTEXT_H__
+
+// ============================================================================
+//
+// IMPORT / EXPORT
+//
+// ============================================================================
+
+//
+// if SRVSTART_DLL_EXPORT is #defined, then we are building the DLL
+//  and exporting the classes
+//
+// otherwise, we are building an executable which will link with the DLL at run-time
+//
+// -------------------------------------------------------------
+// APART FROM THE DLL ITSELF,
+//  ANY SOURCE FILE WHICH #includes THIS ONE SHOULD ENSURE THAT
+//  SRVSTART_DLL_EXPORT is not #defined
+// -------------------------------------------------------------
+//
+
+#ifdef SRVSTART_DLL_EXPORT
+#define SRVSTART_DLL_API __declspec(dllexport)
+#pragma message("exporting SubstitutionContext")
+
+#else
+
+#ifdef	SRVSTART_DLL_LOCAL
+#pragma message("SubstitutionContext is local")
+#define	SRVSTART_DLL_API
+
+#else
+
+#define SRVSTART_DLL_API __declspec(dllimport)
+#pragma message("importing SubstitutionContext")
+
+#endif
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// namespace header
+#include "SrvStart.h"
+
+// forward declarations
+struct SubstitutionContextData;
+
+// ============================================================================
+//
+// NAMESPACE
+//
+// ============================================================================
+
+// all the DLL classes are defined within the SrvStart namespace
+namespace SrvStart {
+
+// ============================================================================
+//
+// SubstitutionContext class
+//
+// ============================================================================
+class SRVSTART_DLL_API SubstitutionContext {
+public:
+	// take a snapshot of the process environment (discarding any variables set)
+	void snapshot();
+
+	// set a variable (its value is substituted when it is looked up)
+	void set(const char *nm,const char *val);
+
+	// discard the values set for a variable (back to its snapshot value, if any)
+	void unset(const char *nm);
+
+	// look up a variable (NULL if it is not set)
+	const char *lookup(const char *nm) throw (SrvStartException);
+
+	// set the variables in the process environment too
+	void apply() throw (SrvStartException);
+
+	// environment block for CreateProcess
+	char *getEnvironmentBlock() throw (SrvStartException);
+
+	// constructor and destructor
+	SubstitutionContext(bool takeSnapshot = true);
+	virtual ~SubstitutionContext();
+
+private:
+	// no copying
+	SubstitutionContext(const SubstitutionContext &);
+	SubstitutionContext &operator=(const SubstitutionContext &);
+
+private:	// data members - hidden data
+	struct SubstitutionContextData *substitutionContextData;
+
+};
+
+} // namespace SrvStart
+
+#endif // !defined(__SUBSTITUTION_CONTEXT_H__)
@@ -0,0 +1,692 @@
+// ============================================================================
+//
+// FILE        : SubstitutionTemplate.cpp
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : Implementation of SubstitutionTemplate class
+//
+//               The syntax is the one StringSubstituter has always accepted:
+//
+//                 %NAME%              value of environment variable NAME
+//                 ${NAME}             ditto
+//                 ${NAME:-default}    ditto, or default if NAME is unset or empty
+//                 ${NAME:?error}      ditto;  it is an error (and the error
+//                                     message is logged) if NAME is unset or
+//                                     empty
+//                 {prompt}            reply typed at the console
+//                 {prompt:default}    ditto, with a default for an empty reply
+//                 {-prompt...}        ditto, without echoing the reply
+//
+//               Each prompt is asked once, the first time the template is
+//               rendered;  its reply is kept for later renderings (eg when a
+//               service is auto-restarted).  Environment values are looked up
+//               on every rendering, but the output is only rebuilt if one of
+//               them has changed.
+//
+//               Environment variables are read from a SubstitutionContext if
+//               one is supplied, and from the process environment otherwise.
+//               The default and error texts may contain substitutions too.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// this is the "main" source file
+#define	SRVSTART_DLL
+
+// we are exporting the class
+#define	SRVSTART_DLL_EXPORT
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// system headers
+#define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+using namespace std;
+#include <conio.h>
+
+// support headers
+#include <logger.h>
+
+// class headers
+#include "SrvStart.h"
+#include "SubstitutionTemplate.h"
+#include "SubstitutionContext.h"
+
+// ============================================================================
+//
+// NAMESPACE DECLARATIONS
+//
+// ============================================================================
+
+using namespace SrvStart;
+
+// ============================================================================
+//
+// CONSTANT DEFINITIONS
+//
+// ============================================================================
+
+const char INPUT_START		= '{';
+const char INPUT_SEPARATOR	= ':';
+const char INPUT_END		= '}';
+const char HIDDEN_INDICATOR	= '-';
+
+const char ENV_START		= '%';
+const char ENV_END			= '%';
+
+const char VAR_START		= '$';
+const char VAR_OPEN			= '{';
+const char VAR_SEPARATOR	= ':';
+const char VAR_DEFAULT		= '-';
+const char VAR_ERROR		= '?';
+const char VAR_CLOSE		= '}';
+
+// initial size of the buffer used to read a reply
+const int REPLY_INITIAL_SIZE = 64;
+
+// ============================================================================
+//
+// LOCAL FUNCTION PROTOTYPES
+//
+// ============================================================================
+
+static char *copyText(const char *text,int len);
+static char *readReply(bool hidden);
+
+// ============================================================================
+//
+// LOCAL CLASSES
+//
+// ============================================================================
+
+//
+// template token
+//
+enum TOKEN_TYPES
+{
+	TOKEN_LITERAL,			// literal text
+	TOKEN_ENV,				// %NAME% or ${NAME...}
+	TOKEN_PROMPT			// {prompt:default}
+} ;
+
+struct SubstitutionToken
+{
+	TOKEN_TYPES type;
+
+	// literal text, environment variable name or prompt
+	char *text;
+	// default reply (TOKEN_PROMPT only)
+	char *defaultReply;
+	// reply is not echoed (TOKEN_PROMPT only)
+	bool  hidden;
+	// VAR_DEFAULT, VAR_ERROR or '\0' (TOKEN_ENV only)
+	char  operation;
+	// default or error text (TOKEN_ENV with an operation only)
+	SubstitutionTemplate *alternative;
+
+	// current value (0 until resolved, except for TOKEN_LITERAL)
+	char *value;
+	int   length;
+
+	SubstitutionToken *next;
+
+	// constructor / destructor
+	SubstitutionToken(TOKEN_TYPES t,char *txt)
+	{
+		type         = t;
+		text         = txt;
+		defaultReply = 0;
+		hidden       = false;
+		operation    = '\0';
+		alternative  = 0;
+		value        = (t==TOKEN_LITERAL ? txt : 0);
+		length       = (t==TOKEN_LITERAL ? strlen(txt) : 0);
+		next         = 0;
+	} ;
+
+	virtual ~SubstitutionToken()
+	{
+		if(value!=text) { delete[] value; }
+		delete[] text;
+		delete[] defaultReply;
+		delete alternative;
+	} ;
+
+} ;
+
+//
+// SubstitutionTemplate data
+//
+struct SubstitutionTemplateData
+{
+	// string the template was compiled from
+	char *source;
+
+	// token list
+	SubstitutionToken *firstToken;
+	SubstitutionToken *lastToken;
+
+	// last rendering (0 if the template must be rendered again)
+	char *output;
+
+	// buffer for reading environment values
+	char  *envBuf;
+	DWORD  envBufSize;
+
+	// constructor / destructor
+	SubstitutionTemplateData()
+	{
+		source     = 0;
+		firstToken = 0;
+		lastToken  = 0;
+		output     = 0;
+		envBuf     = 0;
+		envBufSize = 0;
+	} ;
+
+	virtual ~SubstitutionTemplateData()
+	{
+		delete[] envBuf;
+	} ;
+
+	// add a token to the end of the list
+	void addToken(SubstitutionToken *token)
+	{
+		if(lastToken==0) { firstToken = token; }
+		else             { lastToken->next = token; }
+		lastToken = token;
+	} ;
+
+	// add literal text, up to the next substitution - returns where it ends
+	const char *addLiteral(const char *start)
+	{
+		const char *inCh = start+1;
+		while(((*inCh)!=INPUT_START)&&((*inCh)!=ENV_START)&&((*inCh)!='\0')&&
+				(((*inCh)!=VAR_START)||(inCh[1]!=VAR_OPEN))) { inCh++; }
+		addToken(new SubstitutionToken(TOKEN_LITERAL,copyText(start,inCh-start)));
+		return inCh;
+	} ;
+
+	// look up an environment variable - returns true if its value has changed
+	bool resolveEnv(SubstitutionToken *token,SubstitutionContext *context) throw (SrvStartException)
+	{
+		const char *val;
+
+		if(context!=0)
+		{
+			val = context->lookup(token->text);
+		}
+		else
+		{
+			// find out how big the value is, and read it
+			DWORD len = GetEnvironmentVariable(token->text,envBuf,envBufSize);
+			while(len>envBufSize)
+			{
+				// buffer is too small (len includes the terminator)
+				delete[] envBuf;
+				envBufSize = len;
+				envBuf     = new char[envBufSize];
+				len        = GetEnvironmentVariable(token->text,envBuf,envBufSize);
+			}
+			val = (len==0 ? 0 : envBuf);
+		}
+
+		// unset or empty?
+		bool unset = ((val==0)||((*val)=='\0'));
+		if(unset&&(token->operation==VAR_DEFAULT))
+		{
+			val = token->alternative->render(context);
+		}
+		else
+		if(unset&&(token->operation==VAR_ERROR))
+		{
+			LOGGER_LOG_ERROR2("environment variable '%s' is not set: %s",
+								token->text,token->alternative->render(context))
+			THROW_SRVSTART_EXCEPTION
+				(SRVSTART_EXCEPTION_INVALID_PARAMETER,"SubstitutionTemplate","render")
+		}
+
+		// has it changed?
+		if((token->value!=0)&&(strcmp(token->value,(val==0?"":val))==0))
+		{
+			return false;
+		}
+		if(val==0)
+		{
+			LOGGER_LOG_INFO1("warning: unable to substitute environment variable '%s' (using blank)",token->text)
+			val = "";
+		}
+		LOGGER_LOG_DEBUG2("render: environment variable '%s' is '%s'",token->text,val)
+		delete[] token->value;
+		token->length = strlen(val);
+		token->value  = copyText(val,token->length);
+		return true;
+	} ;
+
+	// ask for a prompted reply
+	void resolvePrompt(SubstitutionToken *token)
+	{
+		// display prompt to stdout
+		cout << token->text << " [" << token->defaultReply << "]: "; cout.flush();
+
+		// read input
+		char *reply = readReply(token->hidden);
+		if(token->hidden) { LOGGER_LOG_DEBUG("entered reply is hidden") }
+		else              { LOGGER_LOG_DEBUG1("entered reply is '%s'",reply) }
+
+		// if reply is empty, use default
+		if(reply[0]=='\0')
+		{
+			delete[] reply;
+			reply = copyText(token->defaultReply,strlen(token->defaultReply));
+			LOGGER_LOG_DEBUG1("using default reply '%s'",reply)
+		}
+		token->value  = reply;
+		token->length = strlen(reply);
+	} ;
+
+} ;
+
+// ============================================================================
+//
+// PUBLIC MEMBER FUNCTIONS
+//
+// ============================================================================
+
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SubstitutionTemplate::SubstitutionTemplate
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : constructor
+//
+// ARGUMENTS       : src IN string to compile (may be NULL)
+//
+// ============================================================================
+SubstitutionTemplate::SubstitutionTemplate
+(
+	const char *src
+)
+{
+	substitutionTemplateData = new SubstitutionTemplateData;
+	if(src!=0) { compile(src); }
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SubstitutionTemplate::~SubstitutionTemplate
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : destructor
+//
+// ============================================================================
+SubstitutionTemplate::~SubstitutionTemplate()
+{
+	clear();
+	delete substitutionTemplateData;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SubstitutionTemplate::compile
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : parse a string into a list of tokens
+//
+//                   If the string is the same as the one the template was last
+//                   compiled from, the template (and any prompted replies) are
+//                   kept.
+//
+// ARGUMENTS       : src IN string to compile (NULL is treated as empty)
+//
+// ============================================================================
+void SubstitutionTemplate::compile
+(
+	const char *src
+)
+{
+	SubstitutionTemplateData *d = substitutionTemplateData;
+	const char *inCh, *start;
+	bool hiddenReply, foundSeparator;
+
+	if(src==0) { src = ""; }
+
+	// is it already compiled?
+	if((d->source!=0)&&(strcmp(d->source,src)==0))
+	{
+		return;
+	}
+	clear();
+	d->source = copyText(src,strlen(src));
+	LOGGER_LOG_DEBUG1("compile: input string is '%s'",src)
+
+	inCh = src;
+	while((*inCh)!='\0')
+	{
+		switch(*inCh)
+		{
+			case INPUT_START:
+				// substitute from stdin - is this hidden text?
+				inCh++;
+				hiddenReply = ((*inCh)==HIDDEN_INDICATOR);
+				if(hiddenReply) { inCh++; }
+
+				// get prompt
+				start = inCh;
+				while(((*inCh)!=INPUT_SEPARATOR)&&((*inCh)!=INPUT_END)&&((*inCh)!='\0')) { inCh++; }
+				SubstitutionToken *prompt;
+				prompt = new SubstitutionToken(TOKEN_PROMPT,copyText(start,inCh-start));
+				prompt->hidden = hiddenReply;
+				foundSeparator = ((*inCh)==INPUT_SEPARATOR);
+				if((*inCh)!='\0') { inCh++; }
+
+				// get default
+				start = inCh;
+				if(foundSeparator)
+				{
+					while(((*inCh)!=INPUT_END)&&((*inCh)!='\0')) { inCh++; }
+				}
+				prompt->defaultReply = copyText(start,inCh-start);
+				if(foundSeparator&&((*inCh)!='\0')) { inCh++; }
+
+				LOGGER_LOG_DEBUG2("compile: prompt is '%s', default is '%s'",prompt->text,prompt->defaultReply)
+				d->addToken(prompt);
+				break;
+
+			case ENV_START:
+				// substitute from environment
+				start = ++inCh;
+				while(((*inCh)!=ENV_END)&&((*inCh)!='\0')) { inCh++; }
+				d->addToken(new SubstitutionToken(TOKEN_ENV,copyText(start,inCh-start)));
+				LOGGER_LOG_DEBUG1("compile: environment variable is '%s'",d->lastToken->text)
+				if((*inCh)!='\0') { inCh++; }
+				break;
+
+			case VAR_START:
+				// just a '$'?
+				if(inCh[1]!=VAR_OPEN)
+				{
+					inCh = d->addLiteral(inCh);
+					break;
+				}
+
+				// substitute from environment - get the name
+				inCh += 2;
+				start = inCh;
+				while(((*inCh)!=VAR_SEPARATOR)&&((*inCh)!=VAR_CLOSE)&&((*inCh)!='\0')) { inCh++; }
+				SubstitutionToken *var;
+				var = new SubstitutionToken(TOKEN_ENV,copyText(start,inCh-start));
+				d->addToken(var);
+
+				// default or error text?
+				if(((*inCh)==VAR_SEPARATOR)&&((inCh[1]==VAR_DEFAULT)||(inCh[1]==VAR_ERROR)))
+				{
+					var->operation = inCh[1];
+					inCh += 2;
+					// find the matching close (the text may contain braces too)
+					int depth;
+					depth = 0;
+					start = inCh;
+					while(((*inCh)!='\0')&&(((*inCh)!=VAR_CLOSE)||(depth>0)))
+					{
+						if((*inCh)==VAR_OPEN)  { depth++; }
+						if((*inCh)==VAR_CLOSE) { depth--; }
+						inCh++;
+					}
+					char *text;
+					text = copyText(start,inCh-start);
+					var->alternative = new SubstitutionTemplate(text);
+					delete[] text;
+				}
+				else
+				{
+					// ignore anything else up to the close
+					while(((*inCh)!=VAR_CLOSE)&&((*inCh)!='\0')) { inCh++; }
+				}
+				LOGGER_LOG_DEBUG2("compile: environment variable is '%s', operation '%c'",
+									var->text,(var->operation=='\0' ? ' ' : var->operation))
+				if((*inCh)!='\0') { inCh++; }
+				break;
+
+			default:
+				// ordinary characters
+				inCh = d->addLiteral(inCh);
+				break;
+		}
+	}
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SubstitutionTemplate::render
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : substitute values into the template
+//
+//                   The result belongs to the template, and remains valid until
+//                   the template is next compiled, rendered or destroyed.
+//
+// ARGUMENTS       : context IN where to find environment variables (if NULL,
+//                              the process environment is used)
+//
+// RETURNS         : the rendered string
+//
+// THROWS          : SrvStartException if a ${NAME:?error} variable is not set,
+//                   or a variable refers back to itself
+//
+// ============================================================================
+char *SubstitutionTemplate::render
+(
+	SubstitutionContext *context
+) throw (SrvStartException)
+{
+	SubstitutionTemplateData *d = substitutionTemplateData;
+	SubstitutionToken *token;
+	bool changed = (d->output==0);
+	int len = 0;
+
+	if(d->source==0) { compile(""); }
+
+	// resolve the values, adding up the length of the result
+	for(token=d->firstToken; token!=0; token=token->next)
+	{
+		switch(token->type)
+		{
+			case TOKEN_ENV:
+				if(d->resolveEnv(token,context)) { changed = true; }
+				break;
+
+			case TOKEN_PROMPT:
+				if(token->value==0) { d->resolvePrompt(token); changed = true; }
+				break;
+
+			default:
+				// literal text never changes
+				break;
+		}
+		len += token->length;
+	}
+
+	// anything to do?
+	if(!changed)
+	{
+		return d->output;
+	}
+
+	// build the result in exactly enough storage
+	delete[] d->output;
+	d->output = new char[len+1];
+	char *outCh = d->output;
+	for(token=d->firstToken; token!=0; token=token->next)
+	{
+		memcpy(outCh,token->value,token->length);
+		outCh += token->length;
+	}
+	(*outCh) = '\0';
+	LOGGER_LOG_DEBUG1("render: output string is '%s'",d->output)
+
+	return d->output;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SubstitutionTemplate::getSource
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : get the string the template was compiled from
+//
+// RETURNS         : the string (NULL if nothing has been compiled)
+//
+// ============================================================================
+const char *SubstitutionTemplate::getSource() const
+{
+	return substitutionTemplateData->source;
+}
+
+// ============================================================================
+//
+// PRIVATE MEMBER FUNCTIONS
+//
+// ============================================================================
+
+
+// ============================================================================
+//
+// MEMBER FUNCTION : SubstitutionTemplate::clear
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : discard the compiled template and its rendering
+//
+// ============================================================================
+void SubstitutionTemplate::clear()
+{
+	SubstitutionTemplateData *d = substitutionTemplateData;
+
+	while(d->firstToken!=0)
+	{
+		SubstitutionToken *token = d->firstToken;
+		d->firstToken = token->next;
+		delete token;
+	}
+	d->lastToken = 0;
+
+	delete[] d->source;
+	d->source = 0;
+	delete[] d->output;
+	d->output = 0;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTIONS
+//
+// ============================================================================
+
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : copyText
+//
+// DESCRIPTION     : copy part of a string into exactly enough new storage
+//
+// ARGUMENTS       : text IN start of text to copy
+//                   len  IN number of characters to copy
+//
+// RETURNS         : the copy (allocated with new[])
+//
+// ============================================================================
+static char *copyText
+(
+	const char *text,
+	int         len
+)
+{
+	char *copy = new char[len+1];
+	memcpy(copy,text,len);
+	copy[len] = '\0';
+	return copy;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : readReply
+//
+// DESCRIPTION     : read a line of input from the console
+//
+//                   There is no limit on the length of the reply.
+//
+// ARGUMENTS       : hidden IN if true, do not echo the reply (eg a password)
+//
+// RETURNS         : the reply (allocated with new[])
+//
+// ============================================================================
+static char *readReply
+(
+	bool hidden
+)
+{
+	int   size  = REPLY_INITIAL_SIZE;
+	int   len   = 0;
+	char *reply = new char[size];
+	int   ch;
+
+	while(true)
+	{
+		if(hidden)
+		{
+			// have to read input directly from console (without echo)
+			ch = _getch();
+			if(ch==13) { cout << '\n'; cout.flush(); break; }
+		}
+		else
+		{
+			// read input from stdin
+			ch = cin.get();
+			if((ch==EOF)||(ch=='\n')) { break; }
+		}
+
+		// make room for this character and the terminator
+		if(len+1>=size)
+		{
+			char *tmp = reply;
+			size  = size*2;
+			reply = new char[size];
+			memcpy(reply,tmp,len);
+			delete[] tmp;
+		}
+		reply[len++] = (char)ch;
+	}
+	reply[len] = '\0';
+	return reply;
+}
@@ -0,0 +1,134 @@
+// ============================================================================
+//
+// FILE        : SubstitutionTemplate.h
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : interface definition for SubstitutionTemplate class
+//
+//               A SubstitutionTemplate is a string (eg a command line) which
+//               has been parsed once into a list of literal text, %ENV% or
+//               ${ENV} references and {prompt} references.  It is rendered into
+//               exactly enough storage, and only re-rendered when one of its
+//               inputs has changed.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// prevent multiple inclusion
+
+#if !defined(__SUBSTITUTION_TEMPLATE_H__)
+#define __SUBSTITUTION_TEMPLATE_H__
+
+// ============================================================================
+//
+// IMPORT / EXPORT
+//
+// ============================================================================
+
+//
+// if SRVSTART_DLL_EXPORT is #defined, then we are building the DLL
+//  and exporting the classes
+//
+// otherwise, we are building an executable which will link with the DLL at run-time
+//
+// -------------------------------------------------------------
+// APART FROM THE DLL ITSELF,
+//  ANY SOURCE FILE WHICH #includes THIS ONE SHOULD ENSURE THAT
+//  SRVSTART_DLL_EXPORT is not #defined
+// -------------------------------------------------------------
+//
+
+#ifdef SRVSTART_DLL_EXPORT
+#define SRVSTART_DLL_API __declspec(dllexport)
+#pragma message("exporting SubstitutionTemplate")
+
+#else
+
+#ifdef	SRVSTART_DLL_LOCAL
+#pragma message("SubstitutionTemplate is local")
+#define	SRVSTART_DLL_API
+
+#else
+
+#define SRVSTART_DLL_API __declspec(dllimport)
+#pragma message("importing SubstitutionTemplate")
+
+#endif
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// namespace header
+#include "SrvStart.h"
+
+// forward declarations
+struct SubstitutionTemplateData;
+
+// ============================================================================
+//
+// NAMESPACE
+//
+// ============================================================================
+
+// all the DLL classes are defined within the SrvStart namespace
+namespace SrvStart {
+
+class SubstitutionContext;
+
+// ============================================================================
+//
+// SubstitutionTemplate class
+//
+// ============================================================================
+class SRVSTART_DLL_API SubstitutionTemplate {
+public:
+	// parse a string into the template (does nothing if it is unchanged)
+	void compile(const char *src);
+
+	// render the template (re-rendered only when an input has changed)
+	char *render(SubstitutionContext *context = 0) throw (SrvStartException);
+
+	// the string the template was compiled from
+	const char *getSource() const;
+
+	// constructor and destructor
+	SubstitutionTemplate(const char *src = 0);
+	virtual ~SubstitutionTemplate();
+
+private:
+	// discard the compiled template
+	void clear();
+
+	// no copying
+	SubstitutionTemplate(const SubstitutionTemplate &);
+	SubstitutionTemplate &operator=(const SubstitutionTemplate &);
+
+private:	// data members - hidden data
+	struct SubstitutionTemplateData *substitutionTemplateData;
+
+};
+
+} // namespace SrvStart
+
+#endif // !defined(__SUBSTITUTION_TEMPLATE_H__)
@@ -0,0 +1,763 @@
+// ============================================================================
+//
+// FILE        : Supervisor.cpp
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : Implementation of Supervisor class
+//
+//               The command is checked every SUPERVISOR_POLL_MILLISECONDS
+//               (waitpid() with WNOHANG, by default), as is the stop flag set
+//               by the ScmConnector's signal thread.  The command is run by
+//               /bin/sh, so that it can have arguments, redirections etc.
+//
+//               This is for POSIX only:  it is not part of the Win32 DLL
+//               project.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// this is the "main" source file
+#define	SRVSTART_DLL
+
+// we are exporting the class
+#define	SRVSTART_DLL_EXPORT
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// system headers
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// support headers
+#include <logger.h>
+
+// class headers
+#include "Clock.h"
+#include "ScmConnector.h"
+#include "Supervisor.h"
+
+// ============================================================================
+//
+// NAMESPACE DECLARATIONS
+//
+// ============================================================================
+
+using namespace SrvStart;
+
+// ============================================================================
+//
+// CONSTANT DEFINITIONS
+//
+// ============================================================================
+
+// how often the command and the stop flag are checked
+const unsigned long SUPERVISOR_POLL_MILLISECONDS = 100;
+
+// how long the command is watched between "still running" messages
+const unsigned long SUPERVISOR_WATCH_MILLISECONDS = 60*1000;
+
+// the shell which runs the command
+const char SUPERVISOR_SHELL[] = "/bin/sh";
+
+// ============================================================================
+//
+// LOCAL CLASSES
+//
+// ============================================================================
+
+//
+// Supervisor data
+//
+struct SupervisorData
+{
+	// properties
+	char *srvName;
+	char *startupCommand;
+	int   startupDelay;
+	bool  autoRestart;
+	int   autoRestartInterval;
+	int   shutdownTimeout;
+
+	// the service manager
+	ScmConnector *scmConnector;
+
+	// the command (pid is -1 once it has exited)
+	long pid;
+	int  exitCode;
+	int  restartCount;
+
+	// set by the stop callback (on the ScmConnector's signal thread)
+	int stopRequested;
+
+	// constructor / destructor
+	SupervisorData(const char *nm)
+	{
+		srvName = new char[strlen(nm)+1];
+		strcpy(srvName,nm);
+		startupCommand      = 0;
+		startupDelay        = 0;
+		autoRestart         = false;
+		autoRestartInterval = 0;
+		shutdownTimeout     = 0;
+		scmConnector        = 0;
+		pid                 = -1;
+		exitCode            = 0;
+		restartCount        = 0;
+		stopRequested       = 0;
+	} ;
+
+	virtual ~SupervisorData()
+	{
+		delete scmConnector;
+		delete[] startupCommand;
+		delete[] srvName;
+	} ;
+
+} ;
+
+//
+// what a wait was ended by
+//
+enum WAIT_OUTCOMES { WAIT_ELAPSED, WAIT_STOPPED, WAIT_EXITED };
+
+// ============================================================================
+//
+// LOCAL FUNCTION PROTOTYPES
+//
+// ============================================================================
+
+static WAIT_OUTCOMES waitFor(SupervisorData *d,unsigned long milliseconds,bool watchCommand);
+static bool commandExited(SupervisorData *d);
+static long startPosixProcess(const char *command,void *genericPointer);
+static bool posixProcessExited(long pid,int *exitCode,void *genericPointer);
+static void signalPosixProcess(long pid,bool kill,void *genericPointer);
+
+// ============================================================================
+//
+// LOCAL VARIABLES
+//
+// ============================================================================
+
+// process backend (see setProcessBackend)
+static Supervisor::START_FUNCTION  *G_startFunction  = startPosixProcess;
+static Supervisor::EXITED_FUNCTION *G_exitedFunction = posixProcessExited;
+static Supervisor::SIGNAL_FUNCTION *G_signalFunction = signalPosixProcess;
+static void                        *G_processPointer = 0;
+
+// ============================================================================
+//
+// PUBLIC MEMBER FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// MEMBER FUNCTION : Supervisor::Supervisor
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : constructor - connects to the service manager
+//
+// ARGUMENTS       : nm IN name of the service
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+Supervisor::Supervisor
+(
+	char *nm
+) throw (SrvStartException)
+{
+	LOGGER_LOG_DEBUG1("Supervisor::Supervisor(%s)",nm)
+
+	supervisorData = new SupervisorData(nm);
+
+	try
+	{
+		supervisorData->scmConnector = new ScmConnector(nm);
+		supervisorData->scmConnector->installStopCallback(stopCallbackFunction,this);
+	}
+	catch(...)
+	{
+		delete supervisorData;
+		throw;
+	}
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : Supervisor::~Supervisor
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : destructor
+//
+// ============================================================================
+Supervisor::~Supervisor()
+{
+	LOGGER_LOG_DEBUG("Supervisor::~Supervisor()")
+
+	delete supervisorData;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : Supervisor::start
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : run the command as a service, and return when the service
+//                   has stopped:  because the service manager asked, or because
+//                   the command exited and is not to be restarted
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+void Supervisor::start() throw (SrvStartException)
+{
+	LOGGER_LOG_DEBUG("Supervisor::start()")
+
+	SupervisorData *d = supervisorData;
+
+	if((d->startupCommand==0)||(d->startupCommand[0]=='\0'))
+	{
+		LOGGER_LOG_ERROR1("Supervisor::start(): no command has been set for service '%s'",d->srvName)
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_INVALID_PARAMETER,"Supervisor","start")
+	}
+
+#define	CATCH_AND_NOTIFY \
+	catch(...) { \
+		d->scmConnector->notifyScmStatus(ScmConnector::STATUS_STOPPING,true); \
+		d->scmConnector->notifyScmStatus(ScmConnector::STATUS_STOPPED,true); \
+		throw; }
+
+	// if the service is set to auto-restart, we may have to loop
+	bool stillLooping = true;
+	bool restarting   = false;
+
+	while(stillLooping)
+	{
+		// run the command - it is now the service's main process
+		try { startCommand(); }
+		CATCH_AND_NOTIFY
+		d->scmConnector->notifyMainPid((unsigned long)d->pid);
+		if(restarting) { d->restartCount++; }
+
+		// wait for it to start up, then watch it (until it exits or the
+		//  service is stopped)
+		WATCH_OUTCOMES watchOutcome;
+		try
+		{
+			if(waitForStartup())
+			{
+				LOGGER_LOG_DEBUG("process is running")
+				d->scmConnector->notifyScmStatus(ScmConnector::STATUS_RUNNING);
+				watchOutcome = watchCommand();
+			}
+			else
+			if(isStopRequested())
+			{
+				LOGGER_LOG_DEBUG("service was stopped while the process was starting")
+				killCommand();
+				watchOutcome = WATCH_COMMAND_WAS_STOPPED;
+			}
+			else
+			{
+				LOGGER_LOG_ERROR1("service '%s': command exited while it was starting",d->srvName)
+				watchOutcome = WATCH_COMMAND_COMPLETED;
+			}
+		}
+		CATCH_AND_NOTIFY
+
+		switch(watchOutcome)
+		{
+			case WATCH_COMMAND_COMPLETED:
+				// command completed on its own - restart it?
+				stillLooping = false;
+				if(d->autoRestart)
+				{
+					LOGGER_LOG_INFO2("service '%s': restarting command (exit code %d)",
+						d->srvName,d->exitCode)
+					stillLooping = (waitFor(d,1000UL*d->autoRestartInterval,false)==WAIT_ELAPSED);
+					restarting   = true;
+				}
+				break;
+
+			case WATCH_COMMAND_WAS_STOPPED:
+				// command was stopped by the service manager
+				LOGGER_LOG_DEBUG("command was stopped by the service manager - exiting")
+				stillLooping = false;
+				break;
+		}
+	}
+
+	// the service has stopped
+	LOGGER_LOG_DEBUG("command has completed - service is shutting down")
+	d->scmConnector->notifyScmStatus(ScmConnector::STATUS_STOPPING,true);
+	d->scmConnector->notifyScmStatus(ScmConnector::STATUS_STOPPED);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : Supervisor::get<property>
+//                   Supervisor::set<property>
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : set / get properties
+//
+// ============================================================================
+void Supervisor::setStartupCommand(const char *sc) throw (SrvStartException)
+{
+	if(sc==0)
+	{
+		LOGGER_LOG_ERROR("setStartupCommand: NULL command")
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_INVALID_PARAMETER,"Supervisor","setStartupCommand")
+	}
+	delete[] supervisorData->startupCommand;
+	supervisorData->startupCommand = new char[strlen(sc)+1];
+	strcpy(supervisorData->startupCommand,sc);
+}
+void Supervisor::setStartupDelay(int sd) { supervisorData->startupDelay = sd; }
+void Supervisor::setAutoRestart(bool ar) { supervisorData->autoRestart = ar; }
+void Supervisor::setAutoRestartInterval(int in) { supervisorData->autoRestartInterval = in; }
+void Supervisor::setShutdownTimeout(int st) { supervisorData->shutdownTimeout = st; }
+
+char *Supervisor::getSrvName() const { return supervisorData->srvName; }
+char *Supervisor::getStartupCommand() const { return supervisorData->startupCommand; }
+int   Supervisor::getStartupDelay() const { return supervisorData->startupDelay; }
+bool  Supervisor::getAutoRestart() const { return supervisorData->autoRestart; }
+int   Supervisor::getAutoRestartInterval() const { return supervisorData->autoRestartInterval; }
+int   Supervisor::getShutdownTimeout() const { return supervisorData->shutdownTimeout; }
+int   Supervisor::getRestartCount() const { return supervisorData->restartCount; }
+
+// ============================================================================
+//
+// MEMBER FUNCTION : Supervisor::isStopRequested
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : has the service manager asked the service to stop?
+//
+// RETURNS         : true if it has
+//
+// ============================================================================
+bool Supervisor::isStopRequested() const
+{
+	return __atomic_load_n(&supervisorData->stopRequested,__ATOMIC_SEQ_CST)!=0;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : Supervisor::setProcessBackend
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : replace the functions which start, check and stop the
+//                   command (eg with a fake process backend, for a test
+//                   harness), or go back to the POSIX ones
+//
+//                   The functions are not protected by a lock, so they must
+//                   be set before any service is started.
+//
+// ARGUMENTS       : startFunction  IN function starting a process (NULL for
+//                                     fork and exec)
+//                   exitedFunction IN function checking whether it has exited
+//                                     (NULL for waitpid)
+//                   signalFunction IN function stopping or killing it (NULL
+//                                     for kill)
+//                   genericPointer IN pointer passed to all three functions
+//
+// ============================================================================
+void Supervisor::setProcessBackend
+(
+	START_FUNCTION  *startFunction,
+	EXITED_FUNCTION *exitedFunction,
+	SIGNAL_FUNCTION *signalFunction,
+	void            *genericPointer
+)
+{
+	G_startFunction  = (startFunction!=0 ? startFunction : startPosixProcess);
+	G_exitedFunction = (exitedFunction!=0 ? exitedFunction : posixProcessExited);
+	G_signalFunction = (signalFunction!=0 ? signalFunction : signalPosixProcess);
+	G_processPointer = genericPointer;
+}
+
+// ============================================================================
+//
+// PRIVATE MEMBER FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// MEMBER FUNCTION : Supervisor::stopCallbackFunction
+//
+// ACCESS SPECIFIER: private (static)
+//
+// DESCRIPTION     : called (on the ScmConnector's signal thread) when the
+//                   service manager asks the service to stop
+//
+// ARGUMENTS       : thisObject IN the Supervisor
+//
+// ============================================================================
+void Supervisor::stopCallbackFunction
+(
+	void *thisObject
+)
+{
+	Supervisor *supervisor = static_cast<Supervisor*>(thisObject);
+	__atomic_store_n(&supervisor->supervisorData->stopRequested,1,__ATOMIC_SEQ_CST);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : Supervisor::startCommand
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : start the command
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+void Supervisor::startCommand() throw (SrvStartException)
+{
+	SupervisorData *d = supervisorData;
+
+	LOGGER_LOG_DEBUG1("Supervisor::startCommand(%s)",d->startupCommand)
+
+	d->exitCode = 0;
+	d->pid      = (*G_startFunction)(d->startupCommand,G_processPointer);
+	if(d->pid<0)
+	{
+		LOGGER_LOG_ERROR2("service '%s': failed to start command '%s'",d->srvName,d->startupCommand)
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_CREATE_PROCESS_FAILED,"Supervisor","startCommand")
+	}
+	LOGGER_LOG_INFO3("service '%s': started command '%s' (pid %ld)",d->srvName,d->startupCommand,d->pid)
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : Supervisor::waitForStartup
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : wait for the startup delay, before the service is
+//                   reported running
+//
+// RETURNS         : true if the command has started up, false if it has
+//                   exited or the service is stopping
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+bool Supervisor::waitForStartup() throw (SrvStartException)
+{
+	SupervisorData *d = supervisorData;
+
+	LOGGER_LOG_DEBUG1("Supervisor::waitForStartup(%d)",d->startupDelay)
+
+	if(d->startupDelay>0)
+	{
+		LOGGER_LOG_INFO2("waiting %d seconds before reporting a 'running' status for service '%s'",
+			d->startupDelay,d->srvName)
+	}
+	return waitFor(d,1000UL*d->startupDelay,true)==WAIT_ELAPSED;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : Supervisor::watchCommand
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : watch command until it completes, or until the service
+//                   manager asks the service to stop (the command is then
+//                   stopped)
+//
+// RETURNS         : WATCH_COMMAND_COMPLETED or WATCH_COMMAND_WAS_STOPPED
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+Supervisor::WATCH_OUTCOMES Supervisor::watchCommand() throw (SrvStartException)
+{
+	SupervisorData *d = supervisorData;
+
+	LOGGER_LOG_DEBUG("Supervisor::watchCommand()")
+
+	while(true)
+	{
+		switch(waitFor(d,SUPERVISOR_WATCH_MILLISECONDS,true))
+		{
+			case WAIT_ELAPSED:
+				LOGGER_LOG_DEBUG("watchCommand: process still running - will wait again")
+				break;
+
+			case WAIT_EXITED:
+				if(d->exitCode==0)
+				{
+					LOGGER_LOG_DEBUG("watchCommand: process has finished ok")
+				}
+				else
+				{
+					LOGGER_LOG_ERROR1("watchCommand: process has finished with error %d",d->exitCode)
+				}
+				return WATCH_COMMAND_COMPLETED;
+
+			case WAIT_STOPPED:
+				LOGGER_LOG_DEBUG("watchCommand: service is stopping")
+				killCommand();
+				return WATCH_COMMAND_WAS_STOPPED;
+		}
+	}
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : Supervisor::killCommand
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : stop the command:  ask it to stop (SIGTERM), and kill it
+//                   (SIGKILL) if it has not stopped within the shutdown
+//                   timeout (if there is one)
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+void Supervisor::killCommand() throw (SrvStartException)
+{
+	SupervisorData *d = supervisorData;
+
+	LOGGER_LOG_DEBUG1("Supervisor::killCommand(%ld)",d->pid)
+
+	unsigned long long stoppingTicks = Clock::getTicks();
+	unsigned long      nextWarning   = 60*1000;
+	bool               killed        = false;
+
+	// tell the service manager the service is stopping
+	d->scmConnector->notifyScmStatus(ScmConnector::STATUS_STOPPING);
+
+	if(!commandExited(d))
+	{
+		(*G_signalFunction)(d->pid,false,G_processPointer);
+	}
+
+	// wait for the process to shut down
+	while(!commandExited(d))
+	{
+		unsigned long elapsed = (unsigned long)(Clock::getTicks()-stoppingTicks);
+		if((!killed)&&(d->shutdownTimeout>0)&&(elapsed>=1000UL*d->shutdownTimeout))
+		{
+			LOGGER_LOG_INFO2("WARNING: service '%s' has not stopped within %d seconds - killing it",
+				d->srvName,d->shutdownTimeout)
+			(*G_signalFunction)(d->pid,true,G_processPointer);
+			killed = true;
+		}
+		if(elapsed>=nextWarning)
+		{
+			LOGGER_LOG_INFO2("WARNING: service '%s' has been shutting down for %lu minutes",
+				d->srvName,nextWarning/60000)
+			nextWarning += 60*1000;
+		}
+		Clock::sleep(SUPERVISOR_POLL_MILLISECONDS);
+	}
+
+	LOGGER_LOG_DEBUG1("command stopped after %lums",(unsigned long)(Clock::getTicks()-stoppingTicks))
+}
+
+// ============================================================================
+//
+// LOCAL UTILITY FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : waitFor
+//
+// DESCRIPTION     : wait for a time, unless the service is asked to stop (or
+//                   the command exits) first - checked before waiting, and
+//                   every SUPERVISOR_POLL_MILLISECONDS
+//
+// ARGUMENTS       : d            IN the Supervisor's data
+//                   milliseconds IN time to wait
+//                   watchCommand IN true to stop waiting if the command exits
+//
+// RETURNS         : WAIT_ELAPSED, WAIT_STOPPED or WAIT_EXITED
+//
+// ============================================================================
+static WAIT_OUTCOMES waitFor
+(
+	SupervisorData *d,
+	unsigned long   milliseconds,
+	bool            watchCommand
+)
+{
+	unsigned long long deadline = Clock::getTicks()+milliseconds;
+
+	while(true)
+	{
+		if(__atomic_load_n(&d->stopRequested,__ATOMIC_SEQ_CST)!=0)
+		{
+			return WAIT_STOPPED;
+		}
+		if(watchCommand&&commandExited(d))
+		{
+			return WAIT_EXITED;
+		}
+
+		unsigned long long now = Clock::getTicks();
+		if(now>=deadline)
+		{
+			return WAIT_ELAPSED;
+		}
+		Clock::sleep(deadline-now<SUPERVISOR_POLL_MILLISECONDS ?
+			(unsigned long)(deadline-now) : SUPERVISOR_POLL_MILLISECONDS);
+	}
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : commandExited
+//
+// DESCRIPTION     : has the command exited?  (The exit code is kept.)
+//
+// ARGUMENTS       : d IN the Supervisor's data
+//
+// RETURNS         : true if it has
+//
+// ============================================================================
+static bool commandExited
+(
+	SupervisorData *d
+)
+{
+	if(d->pid<0)
+	{
+		return true;
+	}
+	if(!(*G_exitedFunction)(d->pid,&d->exitCode,G_processPointer))
+	{
+		return false;
+	}
+	LOGGER_LOG_INFO3("service '%s': command (pid %ld) has exited with code %d",d->srvName,d->pid,d->exitCode)
+	d->pid = -1;
+	return true;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : startPosixProcess
+//                   posixProcessExited
+//                   signalPosixProcess
+//
+// DESCRIPTION     : the POSIX process backend:  the command is run by the
+//                   shell in a child process (which takes the signals the
+//                   ScmConnector has blocked), is reaped by waitpid(), and is
+//                   stopped by SIGTERM or killed by SIGKILL
+//
+// ARGUMENTS       : command        IN command line
+//                   pid            IN process id
+//                   exitCode       OUT exit code (128+signal if it was killed)
+//                   kill           IN true for SIGKILL
+//                   genericPointer IN not used
+//
+// ============================================================================
+static long startPosixProcess
+(
+	const char *command,
+	void       *genericPointer
+)
+{
+	(void)genericPointer;	// not used
+
+	pid_t pid = fork();
+	if(pid<0)
+	{
+		LOGGER_LOG_ERROR1("startPosixProcess: fork failed, error=%d",errno)
+		return -1;
+	}
+	if(pid==0)
+	{
+		sigset_t signals;
+		sigemptyset(&signals);
+		(void)sigprocmask(SIG_SETMASK,&signals,0);
+		execl(SUPERVISOR_SHELL,SUPERVISOR_SHELL,"-c",command,(char*)0);
+		_exit(127);
+	}
+	return pid;
+}
+
+static bool posixProcessExited
+(
+	long  pid,
+	int  *exitCode,
+	void *genericPointer
+)
+{
+	(void)genericPointer;	// not used
+
+	int   status;
+	pid_t rc = waitpid((pid_t)pid,&status,WNOHANG);
+	if(rc==0)
+	{
+		return false;
+	}
+	if(rc<0)
+	{
+		if(errno==EINTR) { return false; }
+		LOGGER_LOG_ERROR2("posixProcessExited: cannot wait for process %ld, error=%d",pid,errno)
+		*exitCode = -1;
+		return true;
+	}
+	*exitCode = (WIFEXITED(status) ? WEXITSTATUS(status) : 128+WTERMSIG(status));
+	return true;
+}
+
+static void signalPosixProcess
+(
+	long  pid,
+	bool  kill,
+	void *genericPointer
+)
+{
+	(void)genericPointer;	// not used
+
+	if(::kill((pid_t)pid,(kill ? SIGKILL : SIGTERM))!=0)
+	{
+		LOGGER_LOG_INFO2("failed to signal process %ld, error=%d (it may have already stopped)",pid,errno)
+	}
+}
@@ -0,0 +1,177 @@
+// ============================================================================
+//
+// FILE        : Supervisor.h
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : interface definition for Supervisor class
+//
+//               A Supervisor runs a command as a service on POSIX, under a
+//               systemd-compatible service manager (Type=notify):  it starts
+//               the command, reports it running once it has started up,
+//               restarts it if it exits (if auto-restart is set), and stops
+//               it when the service manager asks - with SIGTERM, then SIGKILL
+//               if it has not stopped in time.  Every status change goes
+//               through an ScmConnector, and so to the service manager (see
+//               SdNotifier).  On Win32, CmdRunner does this under the SCM.
+//
+//               Every wait goes through the Clock, and the processes are
+//               handled by a process backend (fork/exec, waitpid and kill by
+//               default), so that a test harness can replace both.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master header file SrvStart.h for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// prevent multiple inclusion
+
+#if !defined(__SUPERVISOR_H__)
+#define __SUPERVISOR_H__
+
+// ============================================================================
+//
+// IMPORT / EXPORT
+//
+// ============================================================================
+
+//
+// if SRVSTART_DLL_EXPORT is #defined, then we are building the DLL
+//  and exporting the classes
+//
+// otherwise, we are building an executable which will link with the DLL at run-time
+//
+// -------------------------------------------------------------
+// APART FROM THE DLL ITSELF,
+//  ANY SOURCE FILE WHICH #includes THIS ONE SHOULD ENSURE THAT
+//  SRVSTART_DLL_EXPORT is not #defined
+// -------------------------------------------------------------
+//
+
+#ifdef SRVSTART_DLL_EXPORT
+#define SRVSTART_DLL_API __declspec(dllexport)
+#pragma message("exporting Supervisor")
+
+#else
+
+#ifdef	SRVSTART_DLL_LOCAL
+#pragma message("Supervisor is local")
+#define	SRVSTART_DLL_API
+
+#else
+
+#define SRVSTART_DLL_API __declspec(dllimport)
+#pragma message("importing Supervisor")
+
+#endif
+#endif
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// namespace header
+#include "SrvStart.h"
+
+// forward declarations
+struct SupervisorData;
+
+// ============================================================================
+//
+// NAMESPACE
+//
+// ============================================================================
+
+// all the DLL classes are defined within the SrvStart namespace
+namespace SrvStart {
+
+// ============================================================================
+//
+// Supervisor class
+//
+// ============================================================================
+class SRVSTART_DLL_API Supervisor
+{
+public:
+	// run the command as a service, and return when the service has stopped
+	void start() throw (SrvStartException);
+
+	// properties (times in seconds, as for CmdRunner)
+	void setStartupCommand(const char *sc) throw (SrvStartException);
+	void setStartupDelay(int sd);
+	void setAutoRestart(bool ar);
+	void setAutoRestartInterval(int in);
+	void setShutdownTimeout(int st);
+
+	char *getSrvName() const;
+	char *getStartupCommand() const;
+	int   getStartupDelay() const;
+	bool  getAutoRestart() const;
+	int   getAutoRestartInterval() const;
+	int   getShutdownTimeout() const;
+	int   getRestartCount() const;
+
+	// has the service manager asked the service to stop?
+	bool isStopRequested() const;
+
+	// replace the process backend (NULL functions for the POSIX one) - this
+	//  must be done before any service is started.  START_FUNCTION returns
+	//  the process id (-1 if it cannot be started);  EXITED_FUNCTION does not
+	//  wait, and returns true (with the exit code) once the process has exited;
+	//  SIGNAL_FUNCTION asks the process to stop, or kills it if kill is true.
+	typedef long START_FUNCTION(const char *command,void *genericPointer);
+	typedef bool EXITED_FUNCTION(long pid,int *exitCode,void *genericPointer);
+	typedef void SIGNAL_FUNCTION(long pid,bool kill,void *genericPointer);
+	static void setProcessBackend(START_FUNCTION *startFunction,EXITED_FUNCTION *exitedFunction,
+		SIGNAL_FUNCTION *signalFunction,void *genericPointer);
+
+	// constructor (connects to the service manager - see ScmConnector) and destructor
+	Supervisor(char *nm) throw (SrvStartException);
+	virtual ~Supervisor();
+
+private:	// member functions: internals
+	// no copying
+	Supervisor(const Supervisor &);
+	Supervisor &operator=(const Supervisor &);
+
+	// service stop callback function (see ScmConnector)
+	static void stopCallbackFunction(void *thisObject);
+
+	// start the command
+	void startCommand() throw (SrvStartException);
+
+	// wait for command to start (returns false if it has exited, or the
+	//  service is stopping)
+	bool waitForStartup() throw (SrvStartException);
+
+	// watch command while it's running
+	enum WATCH_OUTCOMES { WATCH_COMMAND_COMPLETED, WATCH_COMMAND_WAS_STOPPED };
+	WATCH_OUTCOMES watchCommand() throw (SrvStartException);
+
+	// stop the command
+	void killCommand() throw (SrvStartException);
+
+private:	// data members - hidden data
+	struct SupervisorData *supervisorData;
+
+};
+
+} // namespace SrvStart
+
+#endif // !defined(__SUPERVISOR_H__)
@@ -54,7 +54,7 @@ BSC32=bscmake.exe
 # ADD BSC32 /nologo
 LINK32=link.exe
 # ADD BASE LINK32 kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib /nologo /dll /machine:I386
-# ADD LINK32 kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib mpr.lib logger.lib /nologo /dll /machine:I386 /out:"Release\srvstart.dll"
+# ADD LINK32 kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib mpr.lib psapi.lib ws2_32.lib logger.lib /nologo /dll /machine:I386 /out:"Release\srvstart.dll"
 
 !ELSEIF  "$(CFG)" == "dll - Win32 Debug"
 
@@ -81,7 +81,7 @@ BSC32=bscmake.exe
 # ADD BSC32 /nologo
 LINK32=link.exe
 # ADD BASE LINK32 kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib /nologo /dll /debug /machine:I386 /pdbtype:sept
-# ADD LINK32 kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib mpr.lib logger.lib /nologo /dll /debug /machine:I386 /out:"Debug\srvstart.dll" /pdbtype:sept
+# ADD LINK32 kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib mpr.lib psapi.lib ws2_32.lib logger.lib /nologo /dll /debug /machine:I386 /out:"Debug\srvstart.dll" /pdbtype:sept
 
 !ENDIF 
 
@@ -94,14 +94,42 @@ LINK32=link.exe
 # PROP Default_Filter "cpp;c;cxx;rc;def;r;odl;idl;hpj;bat"
 # Begin Source File
 
+SOURCE=.\Clock.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\CmdRunner.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\ControlEndpoint.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\DurationHistory.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Metrics.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\MetricsEndpoint.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\ScmConnector.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\SdNotifier.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\ServiceBatch.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\ServiceManager.cpp
 # End Source File
 # Begin Source File
@@ -110,22 +138,66 @@ SOURCE=.\SrvStart.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\StatusBoard.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\StringArena.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\StringSubstituter.cpp
 # End Source File
+# Begin Source File
+
+SOURCE=.\SubstitutionContext.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\SubstitutionTemplate.cpp
+# End Source File
 # End Group
 # Begin Group "Header Files"
 
 # PROP Default_Filter "h;hpp;hxx;hm;inl"
 # Begin Source File
 
+SOURCE=.\Clock.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\CmdRunner.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\ControlEndpoint.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\DurationHistory.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\Metrics.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\MetricsEndpoint.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\ScmConnector.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\SdNotifier.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\ServiceBatch.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\ServiceManager.h
 # End Source File
 # Begin Source File
@@ -138,8 +210,24 @@ SOURCE=.\SrvStart.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\StatusBoard.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\StringArena.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\StringSubstituter.h
 # End Source File
+# Begin Source File
+
+SOURCE=.\SubstitutionContext.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\SubstitutionTemplate.h
+# End Source File
 # End Group
 # Begin Group "Resource Files"
 
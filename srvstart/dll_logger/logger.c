@@ -21,7 +21,7 @@
 //               -------------------------
 //                Compile flags (.o)  : -I ../include -I ${SYBASE}/include -g -fPIC
 //                Compile flags (.so) : -I ../include -I ${SYBASE}/include -g -fPIC -DLOGGER_SHARED_LIB
-//                Link flags          : -shared
+//                Link flags          : -shared -lpthread
 //
 // SYBASE SUPPORT :
 //
@@ -82,6 +82,7 @@
 #elif	defined(__linux__)
 #define	LOGGER_PLATFORM_IS_WIN32	0
 #define	LOGGER_PLATFORM_IS_LINUX	1
+#define	_GNU_SOURCE		// for PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP
 #else
 #error	BUILD FAILURE - the Logger only runs on Win32 and Linux
 #endif
@@ -93,8 +94,11 @@
 // ============================================================================
 
 // ANSI headers
+#include <ctype.h>
+#include <errno.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <sys/stat.h>
@@ -102,8 +106,11 @@
 
 // Win32 headers
 #if	LOGGER_PLATFORM_IS_WIN32
+#include <winsock2.h>		// must precede windows.h
+#include <ws2tcpip.h>
 #include <windows.h>
 #include <winbase.h>
+#include <intrin.h>
 #endif	// LOGGER_PLATFORM_IS_WIN32
 
 // Linux headers
@@ -111,9 +118,25 @@
 #include <linux/limits.h>
 #include <dlfcn.h>
 #include <syslog.h>
-#include <libio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
 #endif	// LOGGER_PLATFORM_IS_LINUX
 
+// SSE2 intrinsics (used to escape text for the structured destinations)
+#if	defined(_M_X64)||(defined(_M_IX86_FP)&&(_M_IX86_FP>=2))||defined(__SSE2__)
+#define	LOGGER_HAVE_SSE2	1
+#include <emmintrin.h>
+#else
+#define	LOGGER_HAVE_SSE2	0
+#endif
+
 // Sybase Open Server headers (if present)
 #ifdef LOGGER_BUILD_WITH_SYBASE_HEADERS
 #include <cspublic.h>
@@ -177,6 +200,42 @@ static char __version[] = LOGGER_VERSION_STRING;
 #define	LOGGER_AUDIT_FAILURE_TEXT	"AUDIT_FAILURE"
 #define	LOGGER_OTHER_TEXT			"unclassified"
 
+//
+// message class keys for the structured (JSON and logfmt) and syslog socket destinations
+//
+#define	LOGGER_BARE_KEY				"bare"
+#define	LOGGER_INFO_KEY				"info"
+#define	LOGGER_WARN_KEY				"warn"
+#define	LOGGER_ERROR_KEY			"error"
+#define	LOGGER_DEBUG_KEY			"debug"
+#define	LOGGER_AUDIT_SUCCESS_KEY	"audit_success"
+#define	LOGGER_AUDIT_FAILURE_KEY	"audit_failure"
+
+//
+// socket syslog (LOGGER_SYSLOG_SOCKET):  frames are queued (up to LOGGER_SYSLOG_QUEUE
+// of them) while the socket is busy, and sent up to LOGGER_SYSLOG_BATCH at a time
+//
+#define	LOGGER_SYSLOG_QUEUE			64
+#define	LOGGER_SYSLOG_BATCH			16
+#define	LOGGER_SYSLOG_FRAME_SIZE	2048
+#define	LOGGER_SYSLOG_FACILITY		1		// user-level messages
+#define	LOGGER_SYSLOG_PORT			"514"
+#define	LOGGER_SYSLOG_OK			0		// (results of SyslogSend)
+#define	LOGGER_SYSLOG_BLOCKED		1
+#define	LOGGER_SYSLOG_FAILED		2
+#define	LOGGER_SYSLOG_EXIT_MILLIS	100		// the longest wait at exit for a busy daemon
+#if	LOGGER_PLATFORM_IS_WIN32
+#define	LOGGER_SYSLOG_DEFAULT		"127.0.0.1"
+#else	// LOGGER_PLATFORM_IS_LINUX
+#define	LOGGER_SYSLOG_DEFAULT		"/dev/log"
+#endif	// LOGGER_PLATFORM_IS_WIN32
+
+//
+// batched file writes (see LoggerSetBatching):  the size of each of the two
+// buffers held by a file destination (it must exceed LOGGER_BUFFERSIZE)
+//
+#define	LOGGER_BATCH_BYTES			65536
+
 //
 // Sybase dynamic libraries
 //
@@ -188,12 +247,31 @@ static char __version[] = LOGGER_VERSION_STRING;
 
 #define	SYBASE_SRV_LOG_FUNCTION_NAME	"srv_log"
 
+//
+// runtime control
+//
+#define	LOGGER_CONTROL_WORD_SIZE	100
+#define	LOGGER_CONTROL_REPLY_SIZE	1000
+
+//
+// the largest message text (leaving room in LOGGER_BUFFERSIZE for the elements added by the Logger)
+//
+#define	LOGGER_MAX_TEXT		(LOGGER_BUFFERSIZE-1024)
+
+//
+// the highest message class (rate limits are held per class)
+//
+#define	LOGGER_MAX_CLASS	LOGGER_AUDIT_FAILURE
+
+//
+// initial size of the logger registry (it grows as required, up to LOGGER_MAX_LOGGERS)
+//
+#define	LOGGER_INITIAL_LOGGERS	32
+
 //
 // miscellany
 //
 #define LOGGER_EOS		'\0'
-#define LOGGER_UNUSED	0
-#define LOGGER_USED		1
 
 // ============================================================================
 //
@@ -201,8 +279,17 @@ static char __version[] = LOGGER_VERSION_STRING;
 //
 // ============================================================================
 
-// debug level for use by callers
-static int DebugLevel = 0;
+// debug level for use by callers (read without locking, so always updated atomically)
+static volatile long DebugLevel = 0;
+
+// batched file writes (see LoggerSetBatching);  off unless BatchMessages > 1
+static volatile long BatchMessages = 0;
+static volatile long BatchMillis   = LOGGER_BATCH_MILLIS;
+static int           BatchThreadUp = 0;
+static int           BatchAtExit   = 0;
+
+// open socket syslog destinations (the batch thread also sends their queues)
+static int           SyslogSinks   = 0;
 
 // function pointer typedef for the "srv_log" function
 #ifdef LOGGER_BUILD_WITH_SYBASE_HEADERS
@@ -211,51 +298,192 @@ typedef	CS_RETCODE (*srvlog_fptr)(SRV_SERVER*,CS_BOOL,CS_CHAR*,CS_INT);
 typedef	void (*srvlog_fptr)();
 #endif // ifdef LOGGER_BUILD_WITH_SYBASE_HEADERS
 
+//
+// a socket syslog destination
+//
+// Writers copy frames into the queue (Frame[Tail..Head-1], modulo
+// LOGGER_SYSLOG_QUEUE) while holding QueueLock, which is only ever held for a
+// copy;  whichever writer sets FlushBusy then sends them without the lock.
+// A frame which arrives when the queue is full is counted in Dropped.
+//
+#if	LOGGER_PLATFORM_IS_WIN32
+typedef SOCKET LOGGER_SOCKET;
+#define	LOGGER_INVALID_SOCKET	INVALID_SOCKET
+#else	// LOGGER_PLATFORM_IS_LINUX
+typedef int    LOGGER_SOCKET;
+#define	LOGGER_INVALID_SOCKET	(-1)
+#endif	// LOGGER_PLATFORM_IS_WIN32
+
+typedef struct
+{
+	LOGGER_SOCKET           Socket;
+	struct sockaddr_storage Address;
+	int                     AddressLength;
+	volatile long           QueueLock;
+	volatile long           FlushBusy;
+	volatile unsigned long  Head;
+	volatile unsigned long  Tail;
+	volatile unsigned long  Sent;
+	volatile unsigned long  Dropped;
+	int                     FrameLength[LOGGER_SYSLOG_QUEUE];
+	char                    Frame[LOGGER_SYSLOG_QUEUE][LOGGER_SYSLOG_FRAME_SIZE];
+} SyslogSink;
+
+//
+// the batch of a file destination
+//
+// Writers append messages to Buffer while holding Lock, which is only ever
+// held for a copy.  Whichever thread sets FlushBusy swaps Buffer and Spare,
+// and writes the whole of Spare in one call without the lock;  a thread which
+// finds it busy sets FlushWanted instead, and the flushing thread goes round
+// again.  Both buffers are LOGGER_BATCH_BYTES, and follow the structure in
+// the same allocation.
+//
+// WriteLock is held for each write to the file itself (see
+// WriteFileDestination), so that a flush and an unbatched message, or two
+// unbatched messages, are not interleaved.
+//
+typedef struct
+{
+	volatile long           Lock;
+	volatile long           WriteLock;
+	volatile long           FlushBusy;
+	volatile long           FlushWanted;
+	int                     Length;
+	int                     Count;
+	char                   *Buffer;
+	char                   *Spare;
+	volatile unsigned long  Writes;
+	volatile unsigned long  Messages;
+} BatchSink;
+
 // structure used to store filtering rules
 typedef struct
 {
 	int       MessageClass;              // bitwise flags
 	int       MessageSeverity;           // equality
 	int       ThreadId;                  // equality
-	char      SourceFile[MAX_FILESIZE];  // containing
-	char      FuncName[1000];            // equality
+	char     *SourceFile;                // containing (NULL for any)
+	char     *FuncName;                  // equality (NULL for any)
 } FilterData;
 
-// static array of logger data - one per logger
-typedef struct
+//
+// logger data - one per logger, allocated on the heap
+//
+// A logger is never changed once it has been published: reconfiguring it, or
+// changing its filter, publishes a replacement.  Hostname and Application
+// point into the same allocation.  OwnsResources is cleared when a replacement
+// takes over the open destination (see LoggerSetFilter).
+//
+typedef struct LoggerDataStruct
 {
-	short int   Used;
+	LOGGER_ID   Id;
 	short int   Destination;
-	char        Hostname[255];
-	char        Application[255];
+	short int   FilterSet;
+	short int   OwnsResources;
+	char       *Hostname;
+	char       *Application;
 	char       *MsgBuffer;
-	char        ANSIFileName[MAX_FILESIZE];
 	FILE       *ANSIFilePtr;
-	int         ANSIFileHandle;
+	LOGGER_RING_HEADER *RingHeader;
+	SyslogSink *Syslog;
+	BatchSink  *Batch;
 #if	LOGGER_PLATFORM_IS_WIN32
 	HANDLE      hWin32Console;
-	char        Win32FileName[MAX_FILESIZE];
 	HANDLE      hWin32File;
 	HANDLE      hEventSource;
-	char        Computer[1000];
-#endif	// LOGGER_PLATFORM_IS_WIN32
-#if	LOGGER_PLATFORM_IS_WIN32
 	HINSTANCE   hDLL;
 #else	// LOGGER_PLATFORM_IS_LINUX
 	void       *LibHandle;
 #endif	// LOGGER_PLATFORM_IS_WIN32
 	srvlog_fptr Srvlog;
-	short int   FilterSet;
 	FilterData  Filter;
 } LoggerData;
 
-static LoggerData Loggers[LOGGER_MAX_LOGGERS];
+//
+// the logger registry
+//
+// Registry maps logger ids to loggers (NULL for an unused id), and grows as
+// higher ids are used;  it is only accessed in single-thread mode.
+//
+// Writers never look at the registry.  They read ActiveLoggers, a compact
+// array of the loggers which have a destination, without taking any lock.
+// Each change to the registry publishes a new array (see PublishLoggers), and
+// the previous array and any replaced loggers are freed only when no writer
+// can still be using them.  Writers count themselves in and out of
+// ReaderCount[ReaderEpoch&1] (see EnterReader and WaitForReaders).
+//
+typedef struct
+{
+	int          Count;
+	LoggerData  *Active[1];    // Count entries, in logger id order
+} LoggerSnapshot;
+
+static LoggerData              **Registry     = NULL;
+static int                       RegistrySize = 0;
+static LoggerSnapshot * volatile ActiveLoggers = NULL;
+static volatile long             ReaderEpoch  = 0;
+static volatile long             ReaderCount[2];
 
-// Win32 structure to protect shared Logger data in multi-thread environment
+// structure to protect shared Logger data in multi-thread environment
 #if	LOGGER_PLATFORM_IS_WIN32
 static CRITICAL_SECTION LoggerCriticalSection;
+#else	// LOGGER_PLATFORM_IS_LINUX
+static pthread_mutex_t  LoggerMutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
 #endif	// LOGGER_PLATFORM_IS_WIN32
 
+// rate limits for each message class (see LoggerSetRateLimit)
+typedef struct
+{
+	volatile long PerMinute;
+	volatile long Burst;
+} RateLimitData;
+
+static RateLimitData RateLimits[LOGGER_MAX_CLASS+1];
+
+// number of messages dropped by the rate limits (see LoggerGetRateDropped)
+static volatile long RateDropped = 0;
+
+//
+// coalescing of repeated messages (see LoggerSetCoalesce): each thread
+// remembers the last message it wrote, and how often it has been repeated
+//
+static volatile long CoalesceSeconds = 0;
+
+typedef struct
+{
+	int     Valid;
+	int     MsgClass;
+	char   *SourceFile;
+	int     LineNumber;
+	time_t  Since;
+	long    Repeats;
+	char    Text[LOGGER_MAX_TEXT];
+} CoalesceData;
+
+//
+// service name for the structured destinations (see LoggerSetServiceName);
+// replaced strings are never freed, because a writer may still be using them
+//
+static char * volatile ServiceName = NULL;
+
+// a structured (JSON or logfmt) record being built up by FormatStructured
+typedef struct
+{
+	char   *Buffer;
+	int     Size;
+	int     Length;
+	int     Json;
+	int     Fields;
+} StructuredRecord;
+
+// runtime control file (see LoggerWatchControlFile)
+static char   ControlFileName[MAX_FILESIZE];
+static int    ControlFilePoll   = 0;
+static time_t ControlFileTime   = 0;
+static long   ControlFileSize   = -1;
+static int    ControlThreadUp   = 0;
+
 //
 // Windows NT: thread local storage indexes for LoggerWriteMessage
 //  (we use TLS rather than the stack because these structures are large)
@@ -263,14 +491,17 @@ static CRITICAL_SECTION LoggerCriticalSection;
 #if	LOGGER_PLATFORM_IS_WIN32
 DWORD TlsTmpBuffer;
 DWORD TlsMsgBuffer;
-DWORD TlsThisLogger;
+DWORD TlsTextBuffer;
+DWORD TlsCoalesce;
 #else	// LOGGER_PLATFORM_IS_LINUX
 //
-// static storage for Linux
+// thread local storage for Linux (writers take no lock, so each thread
+//  formats and coalesces its messages in its own buffers)
 //
-static char       StaticTmpBuffer[LOGGER_BUFFERSIZE];
-static char       StaticMsgBuffer[LOGGER_BUFFERSIZE];
-static LoggerData StaticThisLogger[LOGGER_BUFFERSIZE];
+static __thread char         StaticTmpBuffer[LOGGER_BUFFERSIZE];
+static __thread char         StaticMsgBuffer[LOGGER_BUFFERSIZE];
+static __thread char         StaticTextBuffer[LOGGER_BUFFERSIZE];
+static __thread CoalesceData StaticCoalesce;
 #endif	// LOGGER_PLATFORM_IS_WIN32
 
 // ============================================================================
@@ -280,7 +511,7 @@ static LoggerData StaticThisLogger[LOGGER_BUFFERSIZE];
 // ============================================================================
 
 //
-// ensure single-threaded access to the Logger static data (Windows NT DLL only)
+// ensure single-threaded access to the Logger static data (Windows NT DLL and Linux)
 //
 
 #ifdef	LOGGER_SHARED_LIB
@@ -290,24 +521,117 @@ static LoggerData StaticThisLogger[LOGGER_BUFFERSIZE];
 #define	END_SINGLE_THREAD		LeaveCriticalSection(&LoggerCriticalSection);
 
 #else	// LOGGER_PLATFORM_IS_LINUX
-#define	START_SINGLE_THREAD		;
-#define	END_SINGLE_THREAD		;
+#define	START_SINGLE_THREAD		pthread_mutex_lock(&LoggerMutex);
+#define	END_SINGLE_THREAD		pthread_mutex_unlock(&LoggerMutex);
 #endif	// LOGGER_PLATFORM_IS_WIN32
 
 #else	// !LOGGER_SHARED_LIB
 
+#if	LOGGER_PLATFORM_IS_WIN32
 #define	START_SINGLE_THREAD		;
 #define	END_SINGLE_THREAD		;
+#else	// LOGGER_PLATFORM_IS_LINUX (the mutex needs no initialisation)
+#define	START_SINGLE_THREAD		pthread_mutex_lock(&LoggerMutex);
+#define	END_SINGLE_THREAD		pthread_mutex_unlock(&LoggerMutex);
+#endif	// LOGGER_PLATFORM_IS_WIN32
 
 #endif	// LOGGER_SHARED_LIB
 
+//
+// atomic operations (these are also full memory barriers)
+//
+#if	LOGGER_PLATFORM_IS_WIN32
+#define	LOGGER_ATOMIC_INCREMENT(p)		InterlockedIncrement(p)
+#define	LOGGER_ATOMIC_DECREMENT(p)		InterlockedDecrement(p)
+#define	LOGGER_ATOMIC_EXCHANGE(p,v)		InterlockedExchange(p,v)
+#define	LOGGER_ATOMIC_EXCHANGE_PTR(p,v)	InterlockedExchangePointer((PVOID volatile*)(p),v)
+#define	LOGGER_ATOMIC_ADD(p,v)			((unsigned int)InterlockedExchangeAdd((LONG volatile*)(p),(LONG)(v)))
+#define	LOGGER_MEMORY_BARRIER			MemoryBarrier();
+#define	LOGGER_YIELD					Sleep(0);
+#else	// LOGGER_PLATFORM_IS_LINUX
+#define	LOGGER_ATOMIC_INCREMENT(p)		__sync_add_and_fetch(p,1)
+#define	LOGGER_ATOMIC_DECREMENT(p)		__sync_sub_and_fetch(p,1)
+#define	LOGGER_ATOMIC_EXCHANGE(p,v)		__sync_lock_test_and_set(p,v)
+#define	LOGGER_ATOMIC_EXCHANGE_PTR(p,v)	__sync_lock_test_and_set(p,v)
+#define	LOGGER_ATOMIC_ADD(p,v)			__sync_fetch_and_add(p,v)
+#define	LOGGER_MEMORY_BARRIER			__sync_synchronize();
+#define	LOGGER_YIELD					sched_yield();
+#endif	// LOGGER_PLATFORM_IS_WIN32
+
 // ============================================================================
 //
 // LOCAL FUNCTIONS
 //
 // ============================================================================
 
-void CloseLogger (LOGGER_ID LoggerId);
+void  CloseLogger (LoggerData *ThisLogger);
+
+// logger registry
+int   GrowRegistry (LOGGER_ID LoggerId);
+LoggerData *NewLogger (LOGGER_ID LoggerId,char *Hostname,char *Application);
+LoggerData *CloneLogger (LoggerData *Original);
+void  ReleaseLogger (LoggerData *ThisLogger);
+int   PublishLoggers ();
+long  EnterReader ();
+void  LeaveReader (long Index);
+void  WaitForReaders ();
+char *CopyString (char *String);
+void  WriteFormattedMessage (int MsgClass,int MsgSeverity,int ThreadId,char *SourceFile,
+								int LineNumber,char *FuncName,char *Text);
+unsigned long TickCount ();
+
+// structured destinations
+char *ClassKey (int MsgClass);
+void  FormatStructured (LoggerData *ThisLogger,char *Buffer,int BufferSize,int MsgClass,int MsgSeverity,
+							int ThreadId,char *SourceFile,int LineNumber,char *FuncName,char *Text);
+void  StructuredString (StructuredRecord *Record,char *Key,char *Value);
+void  StructuredNumber (StructuredRecord *Record,char *Key,long Value);
+int   EscapeText (char *Out,int OutSize,char *In);
+int   EscapeCharacter (char *Out,int OutSize,unsigned char Character);
+
+// flight recorder
+LOGGER_RING_HEADER *OpenRing (char *FileName,int Size);
+void  RingWrite (LOGGER_RING_HEADER *Header,char *Msg);
+void  RingCopy (char *Data,unsigned int Mask,unsigned int Position,const char *Source,unsigned int Count);
+
+// syslog
+int   SyslogSeverity (int MsgClass);
+SyslogSink *OpenSyslog (char *Address);
+void  CloseSyslog (SyslogSink *Sink);
+void  SyslogWrite (LoggerData *ThisLogger,int MsgClass,char *Msg);
+void  SyslogFlush (SyslogSink *Sink);
+int   SyslogSend (SyslogSink *Sink,unsigned long First,int Count,int *ErrorPtr);
+int   SyslogToken (char *Out,int OutSize,char *In);
+
+// batched file writes
+BatchSink *OpenBatch ();
+int   BatchWrite (LoggerData *ThisLogger,int MsgClass,char *Msg);
+void  BatchFlush (LoggerData *ThisLogger);
+int   FlushBatches ();
+void  FlushAtExit ();
+int   StartBatchThread ();
+#if	LOGGER_PLATFORM_IS_WIN32
+DWORD WINAPI BatchThread (LPVOID Parameter);
+#else	// LOGGER_PLATFORM_IS_LINUX
+void *BatchThread (void *Parameter);
+#endif	// LOGGER_PLATFORM_IS_WIN32
+void  WriteFileDestination (LoggerData *ThisLogger,char *Data,int Length);
+
+// runtime control
+#if	LOGGER_PLATFORM_IS_WIN32
+DWORD WINAPI ControlFileThread (LPVOID Parameter);
+#else	// LOGGER_PLATFORM_IS_LINUX
+void *ControlFileThread (void *Parameter);
+#endif	// LOGGER_PLATFORM_IS_WIN32
+int   CheckControlFile ();
+int   ApplyControlFile (char *FileName);
+void  NextControlWord (char **Cursor,char *Word,int WordSize);
+void  ControlRest (char *Cursor,char *Rest,int RestSize);
+int   ControlWordIs (char *Word,char *Keyword);
+int   IsControlInteger (char *Word);
+int   ParseControlClasses (char *Word,int *MaskPtr);
+void  ControlReply (char *ReplyPtr,int ReplySize,char *Format,...);
+char *DestinationName (int Destination);
 
 #ifdef	LOGGER_SHARED_LIB
 #if	LOGGER_PLATFORM_IS_WIN32
@@ -355,19 +679,13 @@ BOOL APIENTRY DllMain
 			//
 			InitializeCriticalSection(&LoggerCriticalSection);
 
-			// ensure single-threaded access to the Logger static data
-			START_SINGLE_THREAD
-
-			// initialise the Logger static data
-			for(i=0;i<LOGGER_MAX_LOGGERS;i++){Loggers[i].Destination=LOGGER_UNUSED;}
-
-			// end single-thread access to Logger static data
-			END_SINGLE_THREAD
+			// the logger registry starts empty (see GrowRegistry)
 
 			// allocate thread local storage indexes for LoggerWriteMessage
 			if((TlsTmpBuffer=TlsAlloc())==0xFFFFFFFF) { RETURN_FAILURE(DLL_PROCESS_ATTACH,"TlsAlloc") }
 			if((TlsMsgBuffer=TlsAlloc())==0xFFFFFFFF) { RETURN_FAILURE(DLL_PROCESS_ATTACH,"TlsAlloc") }
-			if((TlsThisLogger=TlsAlloc())==0xFFFFFFFF)    { RETURN_FAILURE(DLL_PROCESS_ATTACH,"TlsAlloc") }
+			if((TlsTextBuffer=TlsAlloc())==0xFFFFFFFF) { RETURN_FAILURE(DLL_PROCESS_ATTACH,"TlsAlloc") }
+			if((TlsCoalesce=TlsAlloc())==0xFFFFFFFF)    { RETURN_FAILURE(DLL_PROCESS_ATTACH,"TlsAlloc") }
 
 			// allocate heap storage for the process's main thread
 			if(!TlsSetValue(TlsTmpBuffer,malloc(LOGGER_BUFFERSIZE)))
@@ -378,7 +696,11 @@ BOOL APIENTRY DllMain
 			{
 				RETURN_FAILURE(DLL_PROCESS_ATTACH,"TlsSetValue")
 			}
-			if(!TlsSetValue(TlsThisLogger,malloc(sizeof(LoggerData))))
+			if(!TlsSetValue(TlsTextBuffer,malloc(LOGGER_BUFFERSIZE)))
+			{
+				RETURN_FAILURE(DLL_PROCESS_ATTACH,"TlsSetValue")
+			}
+			if(!TlsSetValue(TlsCoalesce,calloc(1,sizeof(CoalesceData))))
 			{
 				RETURN_FAILURE(DLL_PROCESS_ATTACH,"TlsSetValue")
 			}
@@ -397,7 +719,11 @@ BOOL APIENTRY DllMain
 			{
 				RETURN_FAILURE(DLL_PROCESS_ATTACH,"TlsSetValue")
 			}
-			if(!TlsSetValue(TlsThisLogger,malloc(sizeof(LoggerData))))
+			if(!TlsSetValue(TlsTextBuffer,malloc(LOGGER_BUFFERSIZE)))
+			{
+				RETURN_FAILURE(DLL_PROCESS_ATTACH,"TlsSetValue")
+			}
+			if(!TlsSetValue(TlsCoalesce,calloc(1,sizeof(CoalesceData))))
 			{
 				RETURN_FAILURE(DLL_PROCESS_ATTACH,"TlsSetValue")
 			}
@@ -410,7 +736,8 @@ BOOL APIENTRY DllMain
 			//
 			free(TlsGetValue(TlsTmpBuffer));
 			free(TlsGetValue(TlsMsgBuffer));
-			free(TlsGetValue(TlsThisLogger));
+			free(TlsGetValue(TlsTextBuffer));
+			free(TlsGetValue(TlsCoalesce));
 			break;
 
 		case DLL_PROCESS_DETACH:
@@ -418,6 +745,8 @@ BOOL APIENTRY DllMain
 			// the DLL is detaching from the address space of the calling process
 			// as a result of either a clean process exit or of a call to FreeLibrary
 			//
+			// tell the control file thread (if any) to stop at its next wake-up
+			ControlFilePoll = 0;
 			break;
     }
 
@@ -448,9 +777,13 @@ BOOL APIENTRY DllMain
 // RETURNS     : debug level
 //
 // ============================================================================
-int LOGGER_DLLFN LoggerGetDebugLevel() { return DebugLevel; }
+int LOGGER_DLLFN LoggerGetDebugLevel() { return (int)DebugLevel; }
 
-int LOGGER_DLLFN LoggerSetDebugLevel(int DbgLvl) { DebugLevel = DbgLvl; return DebugLevel; }
+int LOGGER_DLLFN LoggerSetDebugLevel(int DbgLvl)
+{
+	LOGGER_ATOMIC_EXCHANGE(&DebugLevel,(long)DbgLvl);
+	return DbgLvl;
+}
 
 // ============================================================================
 //
@@ -463,6 +796,8 @@ int LOGGER_DLLFN LoggerSetDebugLevel(int DbgLvl) { DebugLevel = DbgLvl; return D
 // RETURNS     : If there is an unused logger, return its id, otherwise return
 //               LOGGER_NO_UNUSED_LOGGER
 //
+// NOTES       : The registry is grown if all the existing ids are in use.
+//
 // ============================================================================
 LOGGER_ID LOGGER_DLLFN LoggerGetUnusedLogger()
 {
@@ -471,15 +806,19 @@ LOGGER_ID LOGGER_DLLFN LoggerGetUnusedLogger()
 	// ensure single-threaded access to the Logger structures
 	START_SINGLE_THREAD
 
-	for(i=0;i<LOGGER_MAX_LOGGERS;i++)
+	for(i=0;i<RegistrySize;i++)
 	{
-		if(Loggers[i].Used == LOGGER_UNUSED)
+		if(Registry[i] == NULL)
 		{
-			// mark this Logger as used
-			Loggers[i].Used        = LOGGER_USED;
-			Loggers[i].Destination = LOGGER_NONE;
-			Loggers[i].FilterSet   = 0;
+			break;
+		}
+	}
 
+	// mark this Logger as used (it has no destination, so writers need not know)
+	if(GrowRegistry(i))
+	{
+		if((Registry[i]=NewLogger(i,NULL,NULL)) != NULL)
+		{
 			// end single-thread access to Logger static data
 			END_SINGLE_THREAD
 
@@ -513,15 +852,25 @@ void LOGGER_DLLFN LoggerMarkUnused
 	if((LoggerId>=0)&&(LoggerId<LOGGER_MAX_LOGGERS))
 	{
 
+		LoggerData *Old;
+
 		// ensure single-threaded access to the Logger structures
 		START_SINGLE_THREAD
 
-		// close the logger (just in case)
-		CloseLogger(LoggerId);
-
-		// mark the logger as unused
-		Loggers[LoggerId].Used      = LOGGER_UNUSED;
-		Loggers[LoggerId].FilterSet = 0;
+		// mark the logger as unused, and close it once writers have finished with it
+		if((LoggerId<RegistrySize)&&((Old=Registry[LoggerId]) != NULL))
+		{
+			Registry[LoggerId] = NULL;
+			if(PublishLoggers())
+			{
+				ReleaseLogger(Old);
+			}
+			else
+			{
+				// out of memory - leave the logger as it was
+				Registry[LoggerId] = Old;
+			}
+		}
 
 		// end single-thread access to Logger static data
 		END_SINGLE_THREAD
@@ -573,6 +922,18 @@ void LOGGER_DLLFN LoggerMarkUnused
 //                                           which has previously been opened by the caller,
 //                                           using file pointer (*DestDetails1)
 //
+//                 LOGGER_JSON_FILENAME     as LOGGER_ANSI_FILENAME, but write each message
+//                                           as one line of JSON
+//
+//                 LOGGER_LOGFMT_FILENAME   as LOGGER_ANSI_FILENAME, but write each message
+//                                           as one line of logfmt (key=value pairs)
+//
+//                 LOGGER_RING_FILENAME     record messages in the flight recorder file
+//                                           named (*DestDetails1), a fixed-size ring which
+//                                           is memory-mapped, so that writing a message
+//                                           needs no system calls and the messages survive
+//                                           the death of the process (see logdump)
+//
 //                 LOGGER_WIN32_CONSOLE     use Win32 functions to write to console with handle
 //                                           (*lpDestDetails1)
 //
@@ -591,6 +952,12 @@ void LOGGER_DLLFN LoggerMarkUnused
 //
 //                 LOGGER_UNIX_SYSLOG    write to the Unix system logger (syslogd)
 //
+//                 LOGGER_SYSLOG_SOCKET     send RFC 5424 frames to a syslog daemon, through
+//                                           a local (Unix) or UDP socket which is never
+//                                           allowed to block;  messages which cannot be sent
+//                                           straight away are queued, and counted as dropped
+//                                           if the queue is full (see LoggerGetSyslogCounters)
+//
 //               DestDetails1
 //
 //                The meanings of DestDetails1 and DestDetails2 depend on the value of
@@ -613,6 +980,14 @@ void LOGGER_DLLFN LoggerMarkUnused
 //                   (WL)                   (previously opened by caller for writing, specifying
 //                                          the file to append to)
 //
+//                 LOGGER_JSON_FILENAME     char*
+//                 LOGGER_LOGFMT_FILENAME    (as for LOGGER_ANSI_FILENAME)
+//                   (WL)
+//
+//                 LOGGER_RING_FILENAME     char*
+//                   (WL)                    (a null-terminated string specifying the pathname of
+//                                           the ring file;  created if it does not exist)
+//
 //                 LOGGER_WIN32_CONSOLE     HANDLE* (NB not just a HANDLE)
 //                   (W)                     (previously opened by caller for writing using
 //                                           GetStdHandle or AllocConsole)
@@ -633,15 +1008,27 @@ void LOGGER_DLLFN LoggerMarkUnused
 //                 LOGGER_SYBASE_SRVLOG     ignored
 //                   (WL)
 //
+//                 LOGGER_SYSLOG_SOCKET     char*
+//                   (WL)                    (the address of the syslog daemon:  the pathname of a
+//                                           Unix datagram socket (L), or "host", "host:port" or
+//                                           ":port" for UDP (port 514 by default);  NULL for
+//                                           /dev/log on Linux and 127.0.0.1:514 on Windows NT)
+//
 //                 Destination Types marked (W) are for Windows NT only.  Destination Types marked
 //                 (L) are for Linux only.  Destination Types marked (WL) are for both.
 //
 //               DestDetails2
 //
-//                 For LOGGER_ANSI_FILENAME and LOGGER_WIN32_FILENAME, DestDetails2, if not NULL,
+//                 For LOGGER_ANSI_FILENAME, LOGGER_JSON_FILENAME, LOGGER_LOGFMT_FILENAME and
+//                 LOGGER_WIN32_FILENAME, DestDetails2, if not NULL,
 //                 should be a pointer to a boolean value (int 0 or 1).  If true, the output
 //                 file will be truncated by LoggerConfigure.
 //
+//                 For LOGGER_RING_FILENAME, DestDetails2, if not NULL, should be a pointer to
+//                 the size of the ring in bytes (int).  The size is rounded up to a power of
+//                 two, and is at least LOGGER_RING_MIN_SIZE;  the default is
+//                 LOGGER_RING_DEFAULT_SIZE.  An existing ring of the same size is appended to.
+//
 //                 DestDetails2 is ignored for other destination types.
 //
 //               ErrorPtr
@@ -656,12 +1043,16 @@ void LOGGER_DLLFN LoggerMarkUnused
 //
 //               Multi-threading Support
 //
-//                The Logger should work correctly in a multithreading Windows NT environment;
-//                a Win32 "critical section" is used to single-thread through this whole function.
-//                However I have not extensively tested this.
+//                The Logger should work correctly in a multithreading environment;  a Win32
+//                "critical section" (a mutex on Linux) is used to single-thread through this whole
+//                function.  Threads writing messages are never blocked:  the new destination is
+//                opened first, and writers carry on using the previous configuration until the
+//                new one replaces it (in a single publish).  The previous destination is closed
+//                once no writer is using it;  if the new one cannot be opened, the previous
+//                configuration is left in place.
 //
-//                No multi-threading support is provided for Linux (yet).  You may find that messages
-//                get garbled.
+//                Each thread formats its messages in buffers of its own (thread-local storage),
+//                so messages from different threads are not mixed up.
 //
 //               LOGGER_SYBASE_SRVLOG
 //
@@ -721,8 +1112,10 @@ int LOGGER_DLLFN LoggerConfigure
 #define	TRUNCATE_FILE_REQUESTED	\
 			(DestDetails2==NULL)?0:(((*(int*)DestDetails2)==0)?0:1)
 
-	int   rc = 0;
-	char *ErrorStringPtr=NULL;
+	int         rc = 0;
+	LoggerData *New = NULL;
+	LoggerData *Old;
+	char       *ErrorStringPtr=NULL;
 
 	// ensure single-threaded access to the Logger static data
 	START_SINGLE_THREAD
@@ -732,37 +1125,24 @@ int LOGGER_DLLFN LoggerConfigure
 	{
 		RETURN_BAD_CALL("logger id out of range")
 	}
-	else
-	{
-		// close the logger (just in case)
-		CloseLogger(LoggerId);
-
-		// mark this logger as used
-		Loggers[LoggerId].Used      = LOGGER_USED;
-		Loggers[LoggerId].FilterSet = 0;
-	}
 
-	// save host name
-	if(Hostname==NULL)
-	{
-		Loggers[LoggerId].Hostname[0] = LOGGER_EOS;
-	}
-	else
-	{
-		strcpy(Loggers[LoggerId].Hostname,Hostname);
-	}
-		// save application name
-	if(Application==NULL)
+	// build the new logger (saving the host and application names)
+	if((!GrowRegistry(LoggerId))||((New=NewLogger(LoggerId,Hostname,Application)) == NULL))
 	{
-		Loggers[LoggerId].Application[0] = LOGGER_EOS;
+		RETURN_FAILURE("out of memory")
 	}
-	else
+
+	// get message destination (the existing logger, if any, stays in use
+	//  until the new one has been built and published - see TheEnd)
+	New->Destination = Destination;
+
+	// a file destination gathers its messages into batches (see LoggerSetBatching)
+	if((Destination==LOGGER_ANSI_FILENAME)||(Destination==LOGGER_JSON_FILENAME)||
+	   (Destination==LOGGER_LOGFMT_FILENAME)||(Destination==LOGGER_ANSI_FILEPTR)||
+	   (Destination==LOGGER_WIN32_FILENAME)||(Destination==LOGGER_WIN32_FILEHANDLE))
 	{
-		strcpy(Loggers[LoggerId].Application,Application);
+		if((New->Batch=OpenBatch()) == NULL) { RETURN_FAILURE("out of memory") }
 	}
-	
-	// get message destination
-	Loggers[LoggerId].Destination = Destination;
 
 	switch(Destination)
 	{
@@ -775,30 +1155,57 @@ int LOGGER_DLLFN LoggerConfigure
 		case LOGGER_FMTONLY:
 
 			// store address of message buffer
-			Loggers[LoggerId].MsgBuffer = (char*)DestDetails1;
+			New->MsgBuffer = (char*)DestDetails1;
 			// return success
 			rc = 1;
 			break;
 
-		case LOGGER_ANSI_FILENAME:
+		case LOGGER_ANSI_FILENAME: case LOGGER_JSON_FILENAME: case LOGGER_LOGFMT_FILENAME:
 
-			// store file name
+			// check file name
 			CHECK_NOTNULL_DEST
-			strcpy(Loggers[LoggerId].ANSIFileName,(char*)DestDetails1);
 
 			// truncate or append?
 			if(TRUNCATE_FILE_REQUESTED)
 			{
 				// open the file (truncate if it exists)
-				Loggers[LoggerId].ANSIFilePtr = fopen(Loggers[LoggerId].ANSIFileName,"w");
+				New->ANSIFilePtr = fopen((char*)DestDetails1,"w");
 			}
 			else
 			{
 				// open the file (append if it exists)
-				Loggers[LoggerId].ANSIFilePtr = fopen(Loggers[LoggerId].ANSIFileName,"a");
+				New->ANSIFilePtr = fopen((char*)DestDetails1,"a");
 			}
 			// was open successful?
-			if(Loggers[LoggerId].ANSIFilePtr == NULL) { RETURN_FAILURE("failed to open file") }
+			if(New->ANSIFilePtr == NULL) { RETURN_FAILURE("failed to open file") }
+
+			// return success
+			rc = 1;
+			break;
+
+		case LOGGER_RING_FILENAME:
+
+			// map the ring file (DestDetails2, if not NULL, points to the size)
+			CHECK_NOTNULL_DEST
+			New->RingHeader = OpenRing((char*)DestDetails1,
+									(DestDetails2==NULL) ? 0 : *(int*)DestDetails2);
+			if(New->RingHeader == NULL) { RETURN_FAILURE("failed to map ring file") }
+
+			// return success
+			rc = 1;
+			break;
+
+		case LOGGER_SYSLOG_SOCKET:
+
+			// open a non-blocking socket to the syslog daemon
+			New->Syslog = OpenSyslog((char*)DestDetails1);
+			if(New->Syslog == NULL) { RETURN_FAILURE("failed to open syslog socket") }
+			SyslogSinks++;
+
+			// frames which the socket refused for the moment are sent by the
+			// batch thread if no message follows them (if it cannot be started, the
+			// next message sends them)
+			(void)StartBatchThread();
 
 			// return success
 			rc = 1;
@@ -808,7 +1215,7 @@ int LOGGER_DLLFN LoggerConfigure
 
 			// store file pointer
 			CHECK_NOTNULL_DEST
-			Loggers[LoggerId].ANSIFilePtr = (FILE*)DestDetails1;
+			New->ANSIFilePtr = (FILE*)DestDetails1;
 
 			// return success
 			rc = 1;
@@ -820,7 +1227,7 @@ int LOGGER_DLLFN LoggerConfigure
 
 			// store console handle
 			CHECK_NOTNULL_DEST
-			Loggers[LoggerId].hWin32Console = *(HANDLE*)DestDetails1;
+			New->hWin32Console = *(HANDLE*)DestDetails1;
 
 			// return success
 			rc = 1;
@@ -832,27 +1239,26 @@ int LOGGER_DLLFN LoggerConfigure
 
 		case LOGGER_WIN32_FILENAME:
 
-			// store file name
+			// check file name
 			CHECK_NOTNULL_DEST
-			strcpy(Loggers[LoggerId].Win32FileName,(char*)DestDetails1);
 
 			// truncate or append?
 			if(TRUNCATE_FILE_REQUESTED)
 			{
 				// open the file (truncate if it exists)
-				Loggers[LoggerId].hWin32File = CreateFile(Loggers[LoggerId].Win32FileName,GENERIC_WRITE,
+				New->hWin32File = CreateFile((char*)DestDetails1,GENERIC_WRITE,
 												FILE_SHARE_READ|FILE_SHARE_WRITE,
 												NULL,CREATE_ALWAYS,FILE_FLAG_WRITE_THROUGH,NULL);
 			}
 			else
 			{
 				// open the file (append if it exists)
-				Loggers[LoggerId].hWin32File = CreateFile(Loggers[LoggerId].Win32FileName,GENERIC_WRITE,
+				New->hWin32File = CreateFile((char*)DestDetails1,GENERIC_WRITE,
 												FILE_SHARE_READ|FILE_SHARE_WRITE,
 												NULL,OPEN_ALWAYS,FILE_FLAG_WRITE_THROUGH,NULL);
 			}
 			// was open successful?
-			if(Loggers[LoggerId].hWin32File == INVALID_HANDLE_VALUE)
+			if(New->hWin32File == INVALID_HANDLE_VALUE)
 			{
 				RETURN_FAILURE("failed to open file")
 			}
@@ -869,7 +1275,7 @@ int LOGGER_DLLFN LoggerConfigure
 
 			// store file handle
 			CHECK_NOTNULL_DEST
-			Loggers[LoggerId].hWin32File = *(HANDLE*)DestDetails1;
+			New->hWin32File = *(HANDLE*)DestDetails1;
 
 			// return success
 			rc = 1;
@@ -881,28 +1287,17 @@ int LOGGER_DLLFN LoggerConfigure
 
 		case LOGGER_WIN32_EVENTLOG:
 
-			// store computer name
-			if(DestDetails1 == NULL)
-			{
-				Loggers[LoggerId].Computer[0] = LOGGER_EOS;
-			}
-			else
-			{
-				strcpy(Loggers[LoggerId].Computer,(char*)DestDetails1);
-			}
-
-			// register event source so we can log events
-			if(Loggers[LoggerId].Computer[0] = LOGGER_EOS)
+			// register event source so we can log events (on the named computer, if any)
+			if((DestDetails1 == NULL)||(*(char*)DestDetails1 == LOGGER_EOS))
 			{
-				Loggers[LoggerId].hEventSource = RegisterEventSource(NULL,Loggers[LoggerId].Application);
+				New->hEventSource = RegisterEventSource(NULL,New->Application);
 			}
 			else
 			{
-				Loggers[LoggerId].hEventSource = RegisterEventSource(Loggers[LoggerId].Computer,
-																	Loggers[LoggerId].Application);
+				New->hEventSource = RegisterEventSource((char*)DestDetails1,New->Application);
 			}
 
-			if(Loggers[LoggerId].hEventSource == INVALID_HANDLE_VALUE)
+			if(New->hEventSource == INVALID_HANDLE_VALUE)
 			{
 				if(ErrorPtr!=NULL) { (*ErrorPtr) = (int)GetLastError; }
 				if(ErrorMsgPtr!=NULL)
@@ -924,8 +1319,8 @@ int LOGGER_DLLFN LoggerConfigure
 
 #if	LOGGER_PLATFORM_IS_WIN32
 
-			Loggers[LoggerId].hDLL = LoadLibrary(SYBASE_SRV_LOG_LIBRARY_NAME);
-			if(Loggers[LoggerId].hDLL == NULL)
+			New->hDLL = LoadLibrary(SYBASE_SRV_LOG_LIBRARY_NAME);
+			if(New->hDLL == NULL)
 			{
 				if(ErrorPtr!=NULL) { (*ErrorPtr) = (int)GetLastError; }
 				if(ErrorMsgPtr!=NULL)
@@ -935,23 +1330,23 @@ int LOGGER_DLLFN LoggerConfigure
 				goto TheEnd;
 			}
 			// save the function address for "srv_log"
-			Loggers[LoggerId].Srvlog = (srvlog_fptr)GetProcAddress(Loggers[LoggerId].hDLL,
+			New->Srvlog = (srvlog_fptr)GetProcAddress(New->hDLL,
 											SYBASE_SRV_LOG_FUNCTION_NAME);
-			if(!Loggers[LoggerId].Srvlog)
+			if(!New->Srvlog)
 			{
 				if(ErrorPtr!=NULL) { (*ErrorPtr) = (int)GetLastError; }
 				if(ErrorMsgPtr!=NULL)
 				{
 					strncpy(ErrorMsgPtr,"failed to retrieve function address",LOGGER_ERROR_MSG_SIZE);
 				}
-				FreeLibrary(Loggers[LoggerId].hDLL);
+				FreeLibrary(New->hDLL);
 				goto TheEnd;
 			}
 
 #else	// LOGGER_PLATFORM_IS_LINUX
 
-			Loggers[LoggerId].LibHandle = dlopen(SYBASE_SRV_LOG_LIBRARY_NAME,RTLD_LAZY);
-			if(Loggers[LoggerId].LibHandle == NULL)
+			New->LibHandle = dlopen(SYBASE_SRV_LOG_LIBRARY_NAME,RTLD_LAZY);
+			if(New->LibHandle == NULL)
 			{
 				if(ErrorPtr!=NULL) { (*ErrorPtr) = (int)-2; }
 				if(ErrorMsgPtr!=NULL)
@@ -961,16 +1356,16 @@ int LOGGER_DLLFN LoggerConfigure
 				goto TheEnd;
 			}
 			// save the function address for "srv_log"
-			Loggers[LoggerId].Srvlog = (srvlog_fptr)dlsym(Loggers[LoggerId].LibHandle,
+			New->Srvlog = (srvlog_fptr)dlsym(New->LibHandle,
 											SYBASE_SRV_LOG_FUNCTION_NAME);
-			if(Loggers[LoggerId].Srvlog==NULL)
+			if(New->Srvlog==NULL)
 			{
 				if(ErrorPtr!=NULL) { (*ErrorPtr) = (int)-2; }
 				if(ErrorMsgPtr!=NULL)
 				{
 					strncpy(ErrorMsgPtr,dlerror(),LOGGER_ERROR_MSG_SIZE);
 				}
-				dlclose(Loggers[LoggerId].LibHandle);
+				dlclose(New->LibHandle);
 				goto TheEnd;
 			}
 
@@ -984,8 +1379,8 @@ int LOGGER_DLLFN LoggerConfigure
 
 		case LOGGER_UNIX_SYSLOG:
 
-			// open syslog (not strictly necessary according to man (3)
-			openlog(Loggers[LoggerId].Application,0,LOG_USER);
+			// syslog is opened once the new logger has been published (closing
+			//  an old syslog logger would otherwise close it again - see TheEnd)
 
 			// return success
 			rc = 1;
@@ -1001,6 +1396,52 @@ int LOGGER_DLLFN LoggerConfigure
 
 TheEnd:
 
+	// swap the new configuration for the old one with a single publish, and close
+	// the old one once writers have finished with it;  if the new one failed to
+	// configure, the old one stays in place (a new logger is left switched off)
+	if(New != NULL)
+	{
+		Old = Registry[LoggerId];
+		if(!rc)
+		{
+			New->Destination = LOGGER_NONE;
+			if(Old == NULL)
+			{
+				Registry[LoggerId] = New;
+			}
+			else
+			{
+				ReleaseLogger(New);
+			}
+		}
+		else
+		{
+			Registry[LoggerId] = New;
+			if(PublishLoggers())
+			{
+				if(Old != NULL)
+				{
+					ReleaseLogger(Old);
+				}
+#if	LOGGER_PLATFORM_IS_LINUX
+				// open syslog (not strictly necessary according to man (3)
+				if(Destination == LOGGER_UNIX_SYSLOG)
+				{
+					openlog(New->Application,0,LOG_USER);
+				}
+#endif	// LOGGER_PLATFORM_IS_LINUX
+			}
+			else
+			{
+				Registry[LoggerId] = Old;
+				ReleaseLogger(New);
+				if(ErrorPtr != NULL)    { (*ErrorPtr) = -2; }
+				if(ErrorMsgPtr != NULL) { strncpy(ErrorMsgPtr,"out of memory",LOGGER_ERROR_MSG_SIZE); }
+				rc = 0;
+			}
+		}
+	}
+
 	// end single-thread access to Logger static data
 	END_SINGLE_THREAD
 
@@ -1076,36 +1517,63 @@ void LOGGER_DLLFN LoggerSetFilter
 )
 
 {
+	LoggerData *Old;
+	LoggerData *New;
+
 	// validate logger id
 	if((LoggerId<0)||(LoggerId>=LOGGER_MAX_LOGGERS))
 	{
 		return;
 	}
-	if(!Loggers[LoggerId].Used)
+
+	// ensure single-threaded access to the Logger static data
+	START_SINGLE_THREAD
+
+	if((LoggerId>=RegistrySize)||((Old=Registry[LoggerId]) == NULL)||((New=CloneLogger(Old)) == NULL))
 	{
+		END_SINGLE_THREAD
 		return;
 	}
 
 	// is FilterAll set?
-	if(FilterAll)
+	if(!FilterAll)
 	{
-		Loggers[LoggerId].FilterSet = 0;
-		return;
+		// a real filter is being set
+		New->Filter.MessageClass    = MsgClass;
+		New->Filter.MessageSeverity = MsgSeverity;
+		New->Filter.ThreadId        = ThreadId;
+		New->Filter.SourceFile      = CopyString(SourceFile);
+		New->Filter.FuncName        = CopyString(FuncName);
+		New->FilterSet = 1;
+
+		// out of memory?
+		if(((New->Filter.SourceFile == NULL)&&(SourceFile != NULL)&&(SourceFile[0] != LOGGER_EOS))||
+		   ((New->Filter.FuncName   == NULL)&&(FuncName   != NULL)&&(FuncName[0]   != LOGGER_EOS)))
+		{
+			ReleaseLogger(New);
+			END_SINGLE_THREAD
+			return;
+		}
 	}
 
-	// a real filter is being set
-	Loggers[LoggerId].Filter.MessageClass    = MsgClass;
-	Loggers[LoggerId].Filter.MessageSeverity = MsgSeverity;
-	Loggers[LoggerId].Filter.ThreadId        = ThreadId;
-	if(SourceFile!=NULL)
+	// writers start to use the new filter once it has been published;  the
+	// replacement then takes over the destination from the old logger
+	Registry[LoggerId] = New;
+	if(PublishLoggers())
 	{
-		strncpy(Loggers[LoggerId].Filter.SourceFile,SourceFile,sizeof(Loggers[LoggerId].Filter.SourceFile));
+		New->OwnsResources = 1;
+		Old->OwnsResources = 0;
+		ReleaseLogger(Old);
 	}
-	if(FuncName!=NULL)
+	else
 	{
-		strncpy(Loggers[LoggerId].Filter.FuncName,FuncName,sizeof(Loggers[LoggerId].Filter.FuncName));
+		Registry[LoggerId] = Old;
+		ReleaseLogger(New);
 	}
-	Loggers[LoggerId].FilterSet = 1;
+
+	// end single-thread access to Logger static data
+	END_SINGLE_THREAD
+
 	return;
 }
 
@@ -1163,6 +1631,14 @@ void LOGGER_DLLFN LoggerSetFilter
 //                specifiers such as %s, %d etc.  These must match the remaining arguments to
 //                the function, as if they were being passed to sprintf.
 //
+//                The formatted text is truncated to LOGGER_MAX_TEXT characters.
+//
+// NOTES       : If coalescing is switched on (see LoggerSetCoalesce), a message which
+//               is identical to the last one written by the same thread (same class,
+//               source, line and text) is counted rather than written; the count is
+//               written as "last message repeated N times" when a different message
+//               arrives, or when the coalescing interval has passed.
+//
 // EXAMPLES    :
 //
 // RETURNS     : n/a
@@ -1181,23 +1657,116 @@ void LOGGER_DLLFN LoggerWriteMessage
 	char MsgText[],
 	...
 )
+{
+	char         *TextBuffer;
+	CoalesceData *Coalesce;
+	va_list       ArgList;
+	long          Interval;
+	time_t        Now;
+	char          RepeatText[100];
+
+#if	LOGGER_PLATFORM_IS_WIN32
+
+	// Windows NT - get thread local storage for this thread
+	TextBuffer=(char*)TlsGetValue(TlsTextBuffer);
+	Coalesce  =(CoalesceData*)TlsGetValue(TlsCoalesce);
+	if(TextBuffer==NULL)
+	{
+		// thread was created before the DLL was loaded
+		return;
+	}
+
+#else	// LOGGER_PLATFORM_IS_LINUX
+
+	// Linux - get thread local storage for this thread
+	TextBuffer=StaticTextBuffer;
+	Coalesce  =&StaticCoalesce;
+
+#endif	// LOGGER_PLATFORM_IS_WIN32
+
+	// format the message text once, for all loggers
+	va_start(ArgList,MsgText);
+	vsnprintf(TextBuffer,LOGGER_MAX_TEXT,MsgText,ArgList);
+	va_end(ArgList);
+	TextBuffer[LOGGER_MAX_TEXT-1] = LOGGER_EOS;
+
+	// coalesce repeated messages from this thread
+	Interval = CoalesceSeconds;
+	if((Interval>0)&&(Coalesce!=NULL)&&(MsgClass!=LOGGER_BARE))
+	{
+		Now = time(NULL);
+		if((Coalesce->Valid)&&(Coalesce->MsgClass==MsgClass)&&
+		   (Coalesce->SourceFile==SourceFile)&&(Coalesce->LineNumber==LineNumber)&&
+		   (!strcmp(Coalesce->Text,TextBuffer)))
+		{
+			// a repeat - just count it, unless it is time to report the count
+			if((long)(Now-Coalesce->Since)<Interval)
+			{
+				Coalesce->Repeats++;
+				return;
+			}
+		}
+
+		// report how often the previous message was repeated
+		if((Coalesce->Valid)&&(Coalesce->Repeats>0))
+		{
+			sprintf(RepeatText,"last message repeated %ld times",Coalesce->Repeats);
+			WriteFormattedMessage(Coalesce->MsgClass,-1,-2,"",-1,"",RepeatText);
+		}
+
+		// remember this message
+		Coalesce->Valid      = 1;
+		Coalesce->MsgClass   = MsgClass;
+		Coalesce->SourceFile = SourceFile;
+		Coalesce->LineNumber = LineNumber;
+		Coalesce->Since      = Now;
+		Coalesce->Repeats    = 0;
+		strcpy(Coalesce->Text,TextBuffer);
+	}
+
+	WriteFormattedMessage(MsgClass,MsgSeverity,ThreadId,SourceFile,LineNumber,FuncName,TextBuffer);
+
+	return;
+}
+
+// ============================================================================
+//
+// FUNCTION    : WriteFormattedMessage
+//
+// DESCRIPTION : write already-formatted message text to each Logger (the work
+//               of LoggerWriteMessage)
+//
+// ARGUMENTS   : as for LoggerWriteMessage, except that Text is not a format string
+//
+// RETURNS     : n/a
+//
+// ============================================================================
+void WriteFormattedMessage
+(
+	int  MsgClass,
+	int  MsgSeverity,
+	int  ThreadId,
+	char SourceFile[],
+	int  LineNumber,
+	char FuncName[],
+	char Text[]
+)
 {
 
 	// local variables
-	LOGGER_ID    LoggerId;
+	LoggerSnapshot *Snapshot;
+	long         ReaderIndex;
+	int          i;
 	char         ClassBuffer[30];
 	char        *TmpBuffer;
 	char        *MsgBuffer;
 	LoggerData  *ThisLogger;
 	char         ThreadBuffer[20];
 	char         NumBuffer[20];
-	va_list      ArgList;
 	time_t       now1;
 	struct tm   *now2;
 	char         TimeString[30];
-	struct stat  FstatBuffer;
 #if	LOGGER_PLATFORM_IS_WIN32
-	int          FilePosition;
 	int          MsgLength;
 	int          CharsWritten;
 	WORD         wEventType;
@@ -1210,478 +1779,3480 @@ void LOGGER_DLLFN LoggerWriteMessage
 	// Windows NT - get thread local storage for this thread
 	TmpBuffer =(char*)TlsGetValue(TlsTmpBuffer);
 	MsgBuffer =(char*)TlsGetValue(TlsMsgBuffer);
-	ThisLogger=(LoggerData*)TlsGetValue(TlsThisLogger);
 
 #else	// LOGGER_PLATFORM_IS_LINUX
 
-	// Linux - get static storage
+	// Linux - get thread local storage for this thread
 	TmpBuffer =StaticTmpBuffer;
 	MsgBuffer =StaticMsgBuffer;
-	ThisLogger=StaticThisLogger;
 
 #endif	// LOGGER_PLATFORM_IS_WIN32
-		
-	for(LoggerId=0;LoggerId<LOGGER_MAX_LOGGERS;LoggerId++)
-	{
 
-		// printf("+++ LoggerWriteMessage(%d,...)\n",LoggerId);
+	// the loggers with a destination (no lock is taken;  neither the array nor
+	// the loggers in it are changed or freed until we leave)
+	ReaderIndex = EnterReader();
+	Snapshot = ActiveLoggers;
 
-		// ensure single-threaded access to the Logger static data
-		START_SINGLE_THREAD
-
-		// is this logger used?
-		if((Loggers[LoggerId].Used == LOGGER_USED)&&(Loggers[LoggerId].Destination != LOGGER_NONE))
-		{
+	for(i=0;(Snapshot!=NULL)&&(i<Snapshot->Count);i++)
+	{
+		ThisLogger = Snapshot->Active[i];
 
-			// copy the data for this logger
-			memcpy(ThisLogger,&Loggers[LoggerId],sizeof(LoggerData));
+		// printf("+++ LoggerWriteMessage(%d,...)\n",ThisLogger->Id);
 
-			// end single-thread access to Logger static data
-			END_SINGLE_THREAD
-
-			// does a filter apply?
-			if(Loggers[LoggerId].FilterSet)
-			{
-				// check message class
-				FilterInclude=
-				(
-					((MsgClass==LOGGER_BARE)&&(Loggers[LoggerId].Filter.MessageClass&LOGGER_BARE_FILTER))||
-					((MsgClass==LOGGER_INFO)&&(Loggers[LoggerId].Filter.MessageClass&LOGGER_INFO_FILTER))||
-					((MsgClass==LOGGER_WARN)&&(Loggers[LoggerId].Filter.MessageClass&LOGGER_WARN_FILTER))||
-					((MsgClass==LOGGER_ERROR)&&(Loggers[LoggerId].Filter.MessageClass&LOGGER_ERROR_FILTER))||
-					((MsgClass==LOGGER_DEBUG)&&(Loggers[LoggerId].Filter.MessageClass&LOGGER_DEBUG_FILTER))||
-					((MsgClass==LOGGER_AUDIT_SUCCESS)&&(Loggers[LoggerId].Filter.MessageClass&LOGGER_AUDIT_SUCCESS_FILTER))||
-					((MsgClass==LOGGER_AUDIT_FAILURE)&&(Loggers[LoggerId].Filter.MessageClass&LOGGER_AUDIT_FAILURE_FILTER))
-				);
-				// printf("+++ after class: FilterInclude=%d\n",FilterInclude);
-
-				// if severity filter defined (>0), supplied severity must equal or exceed it
-				if(Loggers[LoggerId].Filter.MessageSeverity>=0)
-				{
-					// printf("+++ severity: logger %d message %d\n",Loggers[LoggerId].Filter.MessageSeverity,MsgSeverity);
-					FilterInclude=FilterInclude&&(MsgSeverity>=Loggers[LoggerId].Filter.MessageSeverity);
-				}
-				// printf("+++ after severity: FilterInclude=%d\n",FilterInclude);
+		// does a filter apply?
+		if(ThisLogger->FilterSet)
+		{
+			// check message class
+			FilterInclude=
+			(
+				((MsgClass==LOGGER_BARE)&&(ThisLogger->Filter.MessageClass&LOGGER_BARE_FILTER))||
+				((MsgClass==LOGGER_INFO)&&(ThisLogger->Filter.MessageClass&LOGGER_INFO_FILTER))||
+				((MsgClass==LOGGER_WARN)&&(ThisLogger->Filter.MessageClass&LOGGER_WARN_FILTER))||
+				((MsgClass==LOGGER_ERROR)&&(ThisLogger->Filter.MessageClass&LOGGER_ERROR_FILTER))||
+				((MsgClass==LOGGER_DEBUG)&&(ThisLogger->Filter.MessageClass&LOGGER_DEBUG_FILTER))||
+				((MsgClass==LOGGER_AUDIT_SUCCESS)&&(ThisLogger->Filter.MessageClass&LOGGER_AUDIT_SUCCESS_FILTER))||
+				((MsgClass==LOGGER_AUDIT_FAILURE)&&(ThisLogger->Filter.MessageClass&LOGGER_AUDIT_FAILURE_FILTER))
+			);
+			// printf("+++ after class: FilterInclude=%d\n",FilterInclude);
+
+			// if severity filter defined (>0), supplied severity must equal or exceed it
+			if(ThisLogger->Filter.MessageSeverity>=0)
+			{
+				// printf("+++ severity: logger %d message %d\n",ThisLogger->Filter.MessageSeverity,MsgSeverity);
+				FilterInclude=FilterInclude&&(MsgSeverity>=ThisLogger->Filter.MessageSeverity);
+			}
+			// printf("+++ after severity: FilterInclude=%d\n",FilterInclude);
 
-				// if thread id filter defined (>0), supplied thread id must match
-				if(Loggers[LoggerId].Filter.ThreadId>=0)
+			// if thread id filter defined (>0), supplied thread id must match
+			if(ThisLogger->Filter.ThreadId>=0)
+			{
+				if(ThreadId==-2)
 				{
-					if(ThreadId=-2)
-					{
 #if	LOGGER_PLATFORM_IS_WIN32
-						FilterInclude=FilterInclude&&(((int)GetCurrentThreadId())==Loggers[LoggerId].Filter.ThreadId);
+					FilterInclude=FilterInclude&&(((int)GetCurrentThreadId())==ThisLogger->Filter.ThreadId);
 #else	// LOGGER_PLATFORM_IS_LINUX
-						FilterInclude=0;
+					FilterInclude=0;
 #endif	// LOGGER_PLATFORM_IS_WIN32
-					}
-					else
-					{
-						FilterInclude=FilterInclude&&(ThreadId==Loggers[LoggerId].Filter.ThreadId);
-					}
-				}
-				// printf("+++ after thread: FilterInclude=%d\n",FilterInclude);
-
-				// if source file filter defined, then supplied file name must be a substring
-				if(Loggers[LoggerId].Filter.SourceFile[0]!='\0')
-				{
-					if(SourceFile!=NULL)
-					{
-						FilterInclude=FilterInclude&&(strstr(SourceFile,Loggers[LoggerId].Filter.SourceFile)!=NULL);
-					}
-					else
-					{
-						FilterInclude=0;
-					}
-				}
-				// printf("+++ after source file: FilterInclude=%d\n",FilterInclude);
-
-				// if function name filter defined, then supplied function name must match
-				if(Loggers[LoggerId].Filter.FuncName[0]!='\0')
-				{
-					if(FuncName!=NULL)
-					{
-						FilterInclude=FilterInclude&&(!strcmp(FuncName,Loggers[LoggerId].Filter.FuncName));
-					}
-					else
-					{
-						FilterInclude=0;
-					}
 				}
-				// printf("+++ after function: FilterInclude=%d\n",FilterInclude);
-
-				// does a filter apply?
-				if(!FilterInclude)
+				else
 				{
-					// filter exclusion
-					goto LOGGER_WRITE_MESSAGE_NEXT;
+					FilterInclude=FilterInclude&&(ThreadId==ThisLogger->Filter.ThreadId);
 				}
-
 			}
+			// printf("+++ after thread: FilterInclude=%d\n",FilterInclude);
 
-			// build up the full message string
-			if(MsgClass==LOGGER_BARE)
-			{
-				// just log the message text
-				strcpy(TmpBuffer,MsgText);
-			}
-			else
+			// if source file filter defined, then supplied file name must be a substring
+			if(ThisLogger->Filter.SourceFile!=NULL)
 			{
-	
-				// get message class text
-				switch(MsgClass)
+				if(SourceFile!=NULL)
 				{
-					case LOGGER_INFO:          strcpy(ClassBuffer,LOGGER_INFO_TEXT);          break;
-					case LOGGER_WARN:          strcpy(ClassBuffer,LOGGER_WARN_TEXT);          break;
-					case LOGGER_ERROR:         strcpy(ClassBuffer,LOGGER_ERROR_TEXT);         break;
-					case LOGGER_DEBUG:         strcpy(ClassBuffer,LOGGER_DEBUG_TEXT);         break;
-					case LOGGER_AUDIT_SUCCESS: strcpy(ClassBuffer,LOGGER_AUDIT_SUCCESS_TEXT); break;
-					case LOGGER_AUDIT_FAILURE: strcpy(ClassBuffer,LOGGER_AUDIT_FAILURE_TEXT); break;
-					default:                   strcpy(ClassBuffer,LOGGER_INFO_TEXT);          break;
-				}
-
-				//
-				// get the current date and time, unless logging to the NT Event Log,
-				// Sybase Open Server log or Unix syslog
-				//
-				if((ThisLogger->Destination != LOGGER_WIN32_EVENTLOG)&&
-				   (ThisLogger->Destination != LOGGER_SYBASE_SRVLOG)&&
-				   (ThisLogger->Destination != LOGGER_UNIX_SYSLOG))
-				{
-					// get the date and time
-					now1 = time(NULL);
-					now2 = localtime(&now1);
-					// convert to a string
-					sprintf(TimeString,"%4d/%02d/%02d %02d:%02d:%02d ",
-							now2->tm_year+1900,now2->tm_mon+1,now2->tm_mday,
-							now2->tm_hour,now2->tm_min,now2->tm_sec);
+					FilterInclude=FilterInclude&&(strstr(SourceFile,ThisLogger->Filter.SourceFile)!=NULL);
 				}
 				else
 				{
-					strcpy(TimeString,"");
+					FilterInclude=0;
 				}
+			}
+			// printf("+++ after source file: FilterInclude=%d\n",FilterInclude);
 
-				// build up the first part of the message string
-				if((ThisLogger->Hostname[0] != LOGGER_EOS)&&
-				   (ThisLogger->Destination != LOGGER_WIN32_EVENTLOG)&&
-				   (ThisLogger->Destination != LOGGER_UNIX_SYSLOG))
+			// if function name filter defined, then supplied function name must match
+			if(ThisLogger->Filter.FuncName!=NULL)
+			{
+				if(FuncName!=NULL)
 				{
-					sprintf(TmpBuffer,"[%s] ",ThisLogger->Hostname);
+					FilterInclude=FilterInclude&&(!strcmp(FuncName,ThisLogger->Filter.FuncName));
 				}
 				else
 				{
-					TmpBuffer[0]=LOGGER_EOS;
+					FilterInclude=0;
 				}
+			}
+			// printf("+++ after function: FilterInclude=%d\n",FilterInclude);
 
-				// add the application name
-				if((ThisLogger->Application[0] != LOGGER_EOS)&&
-				   (ThisLogger->Destination != LOGGER_WIN32_EVENTLOG)&&
-				   (ThisLogger->Destination != LOGGER_UNIX_SYSLOG))
-				{
-					strcat(TmpBuffer,ThisLogger->Application);
-					strcat(TmpBuffer,": ");
-					strcat(TmpBuffer,TimeString);
-					strcat(TmpBuffer,ClassBuffer);
-				}
-				else
-				{
-					strcat(TmpBuffer,TimeString);
-					strcat(TmpBuffer,ClassBuffer);
-				}
+			// does a filter apply?
+			if(!FilterInclude)
+			{
+				// filter exclusion
+				goto LOGGER_WRITE_MESSAGE_NEXT;
+			}
 
-				// add the severity to the message, if non-negative
-				if(MsgSeverity>=0)
-				{
-					strcat(TmpBuffer," severity=");
-					sprintf(NumBuffer,"%d",MsgSeverity);
-					strcat(TmpBuffer,NumBuffer);
-				}
+		}
+
+		// build up the full message string
+		if((ThisLogger->Destination==LOGGER_JSON_FILENAME)||
+		   (ThisLogger->Destination==LOGGER_LOGFMT_FILENAME))
+		{
+			// one structured record per line
+			FormatStructured(ThisLogger,TmpBuffer,LOGGER_BUFFERSIZE,MsgClass,MsgSeverity,
+								ThreadId,SourceFile,LineNumber,FuncName,Text);
+		}
+		else if(MsgClass==LOGGER_BARE)
+		{
+			// just log the message text
+			strcpy(TmpBuffer,Text);
+		}
+		else
+		{
+
+			// get message class text
+			switch(MsgClass)
+			{
+				case LOGGER_INFO:          strcpy(ClassBuffer,LOGGER_INFO_TEXT);          break;
+				case LOGGER_WARN:          strcpy(ClassBuffer,LOGGER_WARN_TEXT);          break;
+				case LOGGER_ERROR:         strcpy(ClassBuffer,LOGGER_ERROR_TEXT);         break;
+				case LOGGER_DEBUG:         strcpy(ClassBuffer,LOGGER_DEBUG_TEXT);         break;
+				case LOGGER_AUDIT_SUCCESS: strcpy(ClassBuffer,LOGGER_AUDIT_SUCCESS_TEXT); break;
+				case LOGGER_AUDIT_FAILURE: strcpy(ClassBuffer,LOGGER_AUDIT_FAILURE_TEXT); break;
+				default:                   strcpy(ClassBuffer,LOGGER_INFO_TEXT);          break;
+			}
+
+			//
+			// get the current date and time, unless logging to the NT Event Log,
+			// Sybase Open Server log or Unix syslog
+			//
+			if((ThisLogger->Destination != LOGGER_WIN32_EVENTLOG)&&
+			   (ThisLogger->Destination != LOGGER_SYBASE_SRVLOG)&&
+			   (ThisLogger->Destination != LOGGER_UNIX_SYSLOG)&&
+			   (ThisLogger->Destination != LOGGER_SYSLOG_SOCKET))
+			{
+				// get the date and time
+				now1 = time(NULL);
+				now2 = localtime(&now1);
+				// convert to a string
+				sprintf(TimeString,"%4d/%02d/%02d %02d:%02d:%02d ",
+						now2->tm_year+1900,now2->tm_mon+1,now2->tm_mday,
+						now2->tm_hour,now2->tm_min,now2->tm_sec);
+			}
+			else
+			{
+				strcpy(TimeString,"");
+			}
+
+			// build up the first part of the message string
+			if((ThisLogger->Hostname[0] != LOGGER_EOS)&&
+			   (ThisLogger->Destination != LOGGER_WIN32_EVENTLOG)&&
+			   (ThisLogger->Destination != LOGGER_UNIX_SYSLOG)&&
+			   (ThisLogger->Destination != LOGGER_SYSLOG_SOCKET))
+			{
+				sprintf(TmpBuffer,"[%s] ",ThisLogger->Hostname);
+			}
+			else
+			{
+				TmpBuffer[0]=LOGGER_EOS;
+			}
+
+			// add the application name
+			if((ThisLogger->Application[0] != LOGGER_EOS)&&
+			   (ThisLogger->Destination != LOGGER_WIN32_EVENTLOG)&&
+			   (ThisLogger->Destination != LOGGER_UNIX_SYSLOG)&&
+			   (ThisLogger->Destination != LOGGER_SYSLOG_SOCKET))
+			{
+				strcat(TmpBuffer,ThisLogger->Application);
+				strcat(TmpBuffer,": ");
+				strcat(TmpBuffer,TimeString);
+				strcat(TmpBuffer,ClassBuffer);
+			}
+			else
+			{
+				strcat(TmpBuffer,TimeString);
+				strcat(TmpBuffer,ClassBuffer);
+			}
+
+			// add the severity to the message, if non-negative
+			if(MsgSeverity>=0)
+			{
+				strcat(TmpBuffer," severity=");
+				sprintf(NumBuffer,"%d",MsgSeverity);
+				strcat(TmpBuffer,NumBuffer);
+			}
 
-				// add the thread id to the message, if required
-				if(ThreadId != -1)
+			// add the thread id to the message, if required
+			if(ThreadId != -1)
+			{
+				if(ThreadId == -2)
 				{
-					if(ThreadId == -2)
-					{
-						strcat(TmpBuffer," thread=");
+					strcat(TmpBuffer," thread=");
 
 #if	LOGGER_PLATFORM_IS_WIN32
-						sprintf(ThreadBuffer,"%d",(int)GetCurrentThreadId());
+					sprintf(ThreadBuffer,"%d",(int)GetCurrentThreadId());
 #else	// LOGGER_PLATFORM_IS_LINUX
-						strcpy(ThreadBuffer,"?");
+					strcpy(ThreadBuffer,"?");
 #endif	// LOGGER_PLATFORM_IS_WIN32
 
-						strcat(TmpBuffer,ThreadBuffer);
-					}
-					else
-					{
-						strcat(TmpBuffer," thread=");
-						sprintf(ThreadBuffer,"%d",ThreadId);
-						strcat(TmpBuffer,ThreadBuffer);
-					}
-				}
-
-				// add the source file to the message, if non-null
-				if(SourceFile != NULL)
-				{
-					if(*SourceFile != LOGGER_EOS)
-					{
-						strcat(TmpBuffer," source=");
-						strcat(TmpBuffer,SourceFile);
-					}
+					strcat(TmpBuffer,ThreadBuffer);
 				}
-
-				// add the line number to the message, if non-negative
-				if(LineNumber >= 0)
+				else
 				{
-					strcat(TmpBuffer," line=");
-					sprintf(NumBuffer,"%d",LineNumber);
-					strcat(TmpBuffer,NumBuffer);
+					strcat(TmpBuffer," thread=");
+					sprintf(ThreadBuffer,"%d",ThreadId);
+					strcat(TmpBuffer,ThreadBuffer);
 				}
+			}
 
-				// add the function name to the message, if non-null
-				if(FuncName != NULL)
+			// add the source file to the message, if non-null
+			if(SourceFile != NULL)
+			{
+				if(*SourceFile != LOGGER_EOS)
 				{
-					if(*FuncName != LOGGER_EOS)
-					{
-						strcat(TmpBuffer," function=");
-						strcat(TmpBuffer,FuncName);
-					}
+					strcat(TmpBuffer," source=");
+					strcat(TmpBuffer,SourceFile);
 				}
-
-				// add the message text
-				strcat(TmpBuffer," text=");
-				strcat(TmpBuffer,MsgText);
-
 			}
-	
-			//
-			// add a carriage return, unless destination is "format only"
-			// or logging to the NT Event Log
-			//
-			if((ThisLogger->Destination != LOGGER_FMTONLY)&&
-			   (ThisLogger->Destination != LOGGER_WIN32_EVENTLOG))
+
+			// add the line number to the message, if non-negative
+			if(LineNumber >= 0)
 			{
-				strcat(TmpBuffer,"\n");
+				strcat(TmpBuffer," line=");
+				sprintf(NumBuffer,"%d",LineNumber);
+				strcat(TmpBuffer,NumBuffer);
 			}
 
-			// initialise the ANSI "varargs" library
-		    va_start(ArgList,MsgText);
-
-			// copy the variable arguments into the message
-			vsprintf(MsgBuffer,TmpBuffer,ArgList);
-
-			// end the "varargs" processing
-		    va_end(ArgList);
-
-			// write the message
-			switch(ThisLogger->Destination)
+			// add the function name to the message, if non-null
+			if(FuncName != NULL)
 			{
+				if(*FuncName != LOGGER_EOS)
+				{
+					strcat(TmpBuffer," function=");
+					strcat(TmpBuffer,FuncName);
+				}
+			}
 
-				case LOGGER_FMTONLY:
-
-					strcpy(ThisLogger->MsgBuffer,MsgBuffer);
-					break;
+			// add the message text
+			strcat(TmpBuffer," text=");
+			strcat(TmpBuffer,Text);
 
-				case LOGGER_ANSI_STDOUT:
+		}
 
-					fprintf(stdout,MsgBuffer); fflush(stdout);
-					break;
+		//
+		// add a carriage return, unless destination is "format only",
+		// or logging to the NT Event Log or a syslog socket
+		//
+		if((ThisLogger->Destination != LOGGER_FMTONLY)&&
+		   (ThisLogger->Destination != LOGGER_WIN32_EVENTLOG)&&
+		   (ThisLogger->Destination != LOGGER_SYSLOG_SOCKET))
+		{
+			strcat(TmpBuffer,"\n");
+		}
 
-				case LOGGER_ANSI_FILENAME: case LOGGER_ANSI_FILEPTR:
-    		
-					// check that the file handle is stil valid
-					if(fstat(fileno(ThisLogger->ANSIFilePtr),&FstatBuffer)==0)
-					{
-						fprintf(ThisLogger->ANSIFilePtr,MsgBuffer);
-						fflush(ThisLogger->ANSIFilePtr);
-					}
-					break;
+		// the message is complete (the text was formatted by LoggerWriteMessage)
+		strcpy(MsgBuffer,TmpBuffer);
 
+		// write the message
+		switch(ThisLogger->Destination)
+		{
 
-#if	LOGGER_PLATFORM_IS_WIN32
+			case LOGGER_FMTONLY:
 
-				case LOGGER_WIN32_CONSOLE:
-			
-					// get message length
-					MsgLength=strlen(MsgBuffer);
+				strcpy(ThisLogger->MsgBuffer,MsgBuffer);
+				break;
 
-					// write to Win32 stdout
-					WriteConsole(ThisLogger->hWin32Console,(CONST VOID*)MsgBuffer,
-								MsgLength,&CharsWritten,NULL);
-					break;
+			case LOGGER_ANSI_STDOUT:
 
-#endif	// LOGGER_PLATFORM_IS_WIN32
+				fprintf(stdout,"%s",MsgBuffer); fflush(stdout);
+				break;
 
+			case LOGGER_ANSI_FILENAME: case LOGGER_ANSI_FILEPTR:
+			case LOGGER_JSON_FILENAME: case LOGGER_LOGFMT_FILENAME:
 #if	LOGGER_PLATFORM_IS_WIN32
+			case LOGGER_WIN32_FILENAME: case LOGGER_WIN32_FILEHANDLE:
+#endif	// LOGGER_PLATFORM_IS_WIN32
 
-				case LOGGER_WIN32_FILENAME: case LOGGER_WIN32_FILEHANDLE:
+				// add the message to the batch, or write it now if batching is off
+				if(!BatchWrite(ThisLogger,MsgClass,MsgBuffer))
+				{
+					WriteFileDestination(ThisLogger,MsgBuffer,(int)strlen(MsgBuffer));
+				}
+				break;
 
-					// get message length
-					MsgLength=strlen(MsgBuffer);
+			case LOGGER_RING_FILENAME:
 
-					// move to end of file
-					FilePosition=SetFilePointer(ThisLogger->hWin32File,
-													0,NULL,FILE_END);
+				// plain stores into the mapped file - no system calls
+				RingWrite(ThisLogger->RingHeader,MsgBuffer);
+				break;
 
-					// lock file for writing
-					LockFile(ThisLogger->hWin32File,FilePosition,
-								0,FilePosition+MsgLength,0);
+			case LOGGER_SYSLOG_SOCKET:
 
-					// write to the file
-					WriteFile(ThisLogger->hWin32File,MsgBuffer,MsgLength,
-									&CharsWritten,NULL);
+				// queue an RFC 5424 frame, and send it unless another thread is
+				// sending (never blocks)
+				SyslogWrite(ThisLogger,MsgClass,MsgBuffer);
+				break;
 
-					// unlock the file
-					UnlockFile(ThisLogger->hWin32File,FilePosition,0,
-								FilePosition+MsgLength,0);
+#if	LOGGER_PLATFORM_IS_WIN32
 
-					// flush to disk
-					FlushFileBuffers(ThisLogger->hWin32File);
+			case LOGGER_WIN32_CONSOLE:
+		
+				// get message length
+				MsgLength=strlen(MsgBuffer);
 
-					break;
+				// write to Win32 stdout
+				WriteConsole(ThisLogger->hWin32Console,(CONST VOID*)MsgBuffer,
+							MsgLength,&CharsWritten,NULL);
+				break;
 
 #endif	// LOGGER_PLATFORM_IS_WIN32
 
 #if	LOGGER_PLATFORM_IS_WIN32
 
-				case LOGGER_WIN32_EVENTLOG:
-
-					// build up event string array
-					lpszStrings[0] = MsgBuffer;
-					switch(MsgClass)
-					{
-						case LOGGER_INFO: case LOGGER_DEBUG:
-							wEventType=EVENTLOG_INFORMATION_TYPE;
-							break;
-						case LOGGER_WARN:
-							wEventType=EVENTLOG_WARNING_TYPE;
-							break;
-						case LOGGER_ERROR:
-							wEventType=EVENTLOG_ERROR_TYPE;
-							break;
-						case LOGGER_AUDIT_SUCCESS:
-							wEventType=EVENTLOG_AUDIT_SUCCESS;
-							break;
-						case LOGGER_AUDIT_FAILURE:
-							wEventType=EVENTLOG_AUDIT_FAILURE;
-							break;
-						default:
-							wEventType=EVENTLOG_INFORMATION_TYPE;
-							break;
-					}
-
-					// now report the event
-					ReportEvent(ThisLogger->hEventSource,wEventType,0,0,
-								NULL,1,0,(LPCTSTR*)lpszStrings,NULL);
-					break;
+			case LOGGER_WIN32_EVENTLOG:
+
+				// build up event string array
+				lpszStrings[0] = MsgBuffer;
+				switch(MsgClass)
+				{
+					case LOGGER_INFO: case LOGGER_DEBUG:
+						wEventType=EVENTLOG_INFORMATION_TYPE;
+						break;
+					case LOGGER_WARN:
+						wEventType=EVENTLOG_WARNING_TYPE;
+						break;
+					case LOGGER_ERROR:
+						wEventType=EVENTLOG_ERROR_TYPE;
+						break;
+					case LOGGER_AUDIT_SUCCESS:
+						wEventType=EVENTLOG_AUDIT_SUCCESS;
+						break;
+					case LOGGER_AUDIT_FAILURE:
+						wEventType=EVENTLOG_AUDIT_FAILURE;
+						break;
+					default:
+						wEventType=EVENTLOG_INFORMATION_TYPE;
+						break;
+				}
+
+				// now report the event
+				ReportEvent(ThisLogger->hEventSource,wEventType,0,0,
+							NULL,1,0,(LPCTSTR*)lpszStrings,NULL);
+				break;
 
 #endif	// LOGGER_PLATFORM_IS_WIN32
 
-				case LOGGER_SYBASE_SRVLOG:
+			case LOGGER_SYBASE_SRVLOG:
 
 #ifdef LOGGER_BUILD_WITH_SYBASE_HEADERS
-					// printf("+++ %d: about to call srv_log(%s) @%p\n",LoggerId,MsgBuffer,(void*)ThisLogger->Srvlog);
-					(void)(*(ThisLogger->Srvlog))(NULL,CS_TRUE,MsgBuffer,CS_NULLTERM);
-					// printf("+++ call to srv_log() complete\n");
+				// printf("+++ %d: about to call srv_log(%s) @%p\n",LoggerId,MsgBuffer,(void*)ThisLogger->Srvlog);
+				(void)(*(ThisLogger->Srvlog))(NULL,CS_TRUE,MsgBuffer,CS_NULLTERM);
+				// printf("+++ call to srv_log() complete\n");
 #endif
-					// printf("+++ %d: about to break\n",LoggerId);
-					break;
+				// printf("+++ %d: about to break\n",LoggerId);
+				break;
 
 #if	LOGGER_PLATFORM_IS_LINUX
 
-		case LOGGER_UNIX_SYSLOG:
+			case LOGGER_UNIX_SYSLOG:
 
-					syslog(LOG_NOTICE,MsgBuffer);
-					break;
+				// (the message is not a format string)
+				syslog(SyslogSeverity(MsgClass),"%s",MsgBuffer);
+				break;
 
 #endif	// LOGGER_PLATFORM_IS_LINUX
 
-				default:
-					break;
-
-			}
+			default:
+				break;
 
 		}
-		else
-		{
-
-			// end single-thread access to Logger static data
-			END_SINGLE_THREAD
 
-		}
 LOGGER_WRITE_MESSAGE_NEXT:
 		;
 
 	} // end for loop
 
+	LeaveReader(ReaderIndex);
+
 	return;
 }
 
 // ============================================================================
 //
-// FUNCTION    : CloseLogger
+// FUNCTION    : LoggerSetRateLimit
 //
-// DESCRIPTION : close a logger (release its resources)
+// DESCRIPTION : limit the rate at which each call site may log messages of a
+//               given class (see LoggerRateCheck)
 //
-// ARGUMENTS   : LoggerId
+//               Each call site has a "token bucket" which holds up to Burst
+//               messages, and is refilled at PerMinute messages per minute.
 //
-// RETURNS     : none
+// ARGUMENTS   : MsgClass   message class (LOGGER_BARE .. LOGGER_AUDIT_FAILURE)
+//               PerMinute  messages per minute per call site (0 for no limit)
+//               Burst      number of messages which may be logged in quick
+//                          succession (at least 1)
+//
+// RETURNS     : nonzero on success, zero if the message class is invalid
 //
 // ============================================================================
-void CloseLogger
+int LOGGER_DLLFN LoggerSetRateLimit
 (
-	LOGGER_ID LoggerId
+	int MsgClass,
+	int PerMinute,
+	int Burst
+)
+{
+	if((MsgClass<0)||(MsgClass>LOGGER_MAX_CLASS))
+	{
+		return 0;
+	}
+	LOGGER_ATOMIC_EXCHANGE(&RateLimits[MsgClass].Burst,(long)((Burst<1)?1:Burst));
+	LOGGER_ATOMIC_EXCHANGE(&RateLimits[MsgClass].PerMinute,(long)((PerMinute<0)?0:PerMinute));
+	return 1;
+}
+
+// ============================================================================
+//
+// FUNCTION    : LoggerRateCheck
+//
+// DESCRIPTION : decide whether a call site may log a message now, under the
+//               rate limit for its message class (see LoggerSetRateLimit)
+//
+//               This is called by the LOGGER_LOG_ macros, each of which holds
+//               its own (static) LOGGER_RATE_SLOT.  If there is no rate limit
+//               for the class it returns at once.  When a call site is allowed
+//               to log again after some of its messages were dropped, the number
+//               dropped is logged first.
+//
+//               The slot is not locked, so under heavy contention a few extra
+//               messages may get through; none are ever lost other than by
+//               the limit itself.
+//
+// ARGUMENTS   : Slot        rate limit state for the call site
+//               MsgClass    class of message
+//               SourceFile  call site (used to report dropped messages)
+//               LineNumber
+//
+// RETURNS     : nonzero if the message should be logged, zero if it should be dropped
+//
+// ============================================================================
+int LOGGER_DLLFN LoggerRateCheck
+(
+	LOGGER_RATE_SLOT *Slot,
+	int               MsgClass,
+	char             *SourceFile,
+	int               LineNumber
 )
 {
-	// close the given logger (if used)
-	if(Loggers[LoggerId].Used == LOGGER_USED)
+	long          PerMinute, Burst, Dropped;
+	unsigned long Now, Elapsed;
+	double        Tokens;
+
+	// no limit?
+	if((MsgClass<0)||(MsgClass>LOGGER_MAX_CLASS)||((PerMinute=RateLimits[MsgClass].PerMinute)<=0))
+	{
+		return 1;
+	}
+	Burst = RateLimits[MsgClass].Burst;
+	Now   = TickCount();
+
+	// refill the bucket (tokens are held in thousandths of a message)
+	if(!Slot->Started)
+	{
+		Tokens        = (double)Burst*1000.0;
+		Slot->Started = 1;
+	}
+	else
 	{
-		switch(Loggers[LoggerId].Destination)
+		Elapsed = Now - Slot->LastTick;
+		Tokens  = (double)Slot->Tokens + ((double)Elapsed*(double)PerMinute)/60.0;
+		if(Tokens>(double)Burst*1000.0)
 		{
-			case LOGGER_ANSI_FILENAME:
-				// close the file
-				fclose(Loggers[LoggerId].ANSIFilePtr);
-				break;
+			Tokens = (double)Burst*1000.0;
+		}
+	}
+	Slot->LastTick = Now;
 
-#if	LOGGER_PLATFORM_IS_WIN32
+	// is there a token for this message?
+	if(Tokens<1000.0)
+	{
+		Slot->Tokens = (long)Tokens;
+		Slot->Dropped++;
+		LOGGER_ATOMIC_INCREMENT(&RateDropped);
+		return 0;
+	}
+	Slot->Tokens = (long)(Tokens-1000.0);
 
-			case LOGGER_WIN32_FILENAME:
-				// close the file
-				CloseHandle(Loggers[LoggerId].hWin32File);
-				break;
+	// report any messages which were dropped
+	if(Slot->Dropped>0)
+	{
+		Dropped = Slot->Dropped;
+		Slot->Dropped = 0;
+		LoggerWriteMessage(MsgClass,-1,-2,SourceFile,LineNumber,"",
+							"%ld messages from here were dropped by the rate limit",Dropped);
+	}
 
-			case LOGGER_WIN32_EVENTLOG:
-				// deregister
-				(void)DeregisterEventSource(Loggers[LoggerId].hEventSource);
-				break;
+	return 1;
+}
 
-#endif	// LOGGER_PLATFORM_IS_WIN32
-		
-			case LOGGER_SYBASE_SRVLOG:
-				// unload the Sybase Open Server DLL
+// ============================================================================
+//
+// FUNCTION    : LoggerGetRateDropped
+//
+// DESCRIPTION : return the number of messages dropped by the rate limits (see
+//               LoggerRateCheck), over all call sites, since the program started
+//
+// RETURNS     : number of messages dropped
+//
+// ============================================================================
+unsigned long LOGGER_DLLFN LoggerGetRateDropped()
+{
+	return (unsigned long)RateDropped;
+}
 
-#if	LOGGER_PLATFORM_IS_WIN32
-				FreeLibrary(Loggers[LoggerId].hDLL);
-#else	// LOGGER_PLATFORM_IS_LINUX
-				dlclose(Loggers[LoggerId].LibHandle);
-#endif	// LOGGER_PLATFORM_IS_WIN32
-				break;
-		
-#if	LOGGER_PLATFORM_IS_LINUX
+// ============================================================================
+//
+// FUNCTION    : LoggerSetCoalesce
+//
+// DESCRIPTION : switch coalescing of repeated messages on or off (see
+//               LoggerWriteMessage)
+//
+// ARGUMENTS   : Seconds  how often to report the number of repeats of a message
+//                        which is still being repeated (0 to switch coalescing off)
+//
+// RETURNS     : none
+//
+// ============================================================================
+void LOGGER_DLLFN LoggerSetCoalesce
+(
+	int Seconds
+)
+{
+	LOGGER_ATOMIC_EXCHANGE(&CoalesceSeconds,(long)((Seconds<0)?0:Seconds));
+}
 
-		case LOGGER_UNIX_SYSLOG:
+// ============================================================================
+//
+// FUNCTION    : LoggerSetBatching
+//
+// DESCRIPTION : switch batching of writes to file destinations on or off
+//
+//               With batching on, the messages for a file destination
+//               (LOGGER_ANSI_FILENAME, LOGGER_ANSI_FILEPTR, LOGGER_JSON_FILENAME,
+//               LOGGER_LOGFMT_FILENAME, LOGGER_WIN32_FILENAME and
+//               LOGGER_WIN32_FILEHANDLE) are gathered in memory, and written and
+//               flushed in a single call when MaxMessages are waiting.  An error
+//               message (LOGGER_ERROR) is written at once, with any messages
+//               waiting before it;  a background thread writes the rest within
+//               MaxMillis.  Messages still waiting are written when a logger is
+//               closed or reconfigured, when batching is switched off, and when
+//               the process exits normally, but are lost if it crashes.
+//
+// ARGUMENTS   : MaxMessages  the most messages in a batch (0 or 1 to switch
+//                            batching off, which is the default)
+//               MaxMillis    the longest time (milliseconds) a message may wait
+//                            (<=0 for the default, LOGGER_BATCH_MILLIS)
+//
+// RETURNS     : 1 for success, 0 if the background thread could not be started
+//               (batching is then left off)
+//
+// ============================================================================
+int LOGGER_DLLFN LoggerSetBatching
+(
+	int MaxMessages,
+	int MaxMillis
+)
+{
+	// ensure single-threaded access to the Logger static data
+	START_SINGLE_THREAD
 
-			// close syslog (not strictly necessary according to man (3)
-			closelog();
-			break;
+	LOGGER_ATOMIC_EXCHANGE(&BatchMillis,(long)((MaxMillis>0)?MaxMillis:LOGGER_BATCH_MILLIS));
+	LOGGER_ATOMIC_EXCHANGE(&BatchMessages,(long)((MaxMessages>1)?MaxMessages:0));
 
-#endif	// LOGGER_PLATFORM_IS_LINUX
+	// start the thread which writes waiting batches, unless it is already running
+	if((BatchMessages>1)&&(!StartBatchThread()))
+	{
+		LOGGER_ATOMIC_EXCHANGE(&BatchMessages,0);
+		END_SINGLE_THREAD
+		return 0;
+	}
 
-			default:
-				// no switch-off action
-				break;
-		}
+	// end single-thread access to Logger static data
+	END_SINGLE_THREAD
 
+	// batching is off - write whatever is waiting
+	if(BatchMessages<=1)
+	{
+		(void)FlushBatches();
 	}
 
+	return 1;
 }
 
+// ============================================================================
+//
+// FUNCTION    : LoggerSetServiceName
+//
+// DESCRIPTION : set the service name which is recorded in each message written
+//               to a structured (JSON or logfmt) destination
+//
+// ARGUMENTS   : Name  the service name (NULL or empty to omit it)
+//
+// RETURNS     : 1 for success, 0 if out of memory
+//
+// ============================================================================
+int LOGGER_DLLFN LoggerSetServiceName
+(
+	char *Name
+)
+{
+	char *Copy = NULL;
+
+	if((Name!=NULL)&&(*Name!=LOGGER_EOS))
+	{
+		if((Copy=(char*)malloc(strlen(Name)+1))==NULL)
+		{
+			return 0;
+		}
+		strcpy(Copy,Name);
+	}
+
+	// the previous name is not freed (see ServiceName)
+	(void)LOGGER_ATOMIC_EXCHANGE_PTR(&ServiceName,Copy);
+	return 1;
+}
+
+// ============================================================================
+//
+// FUNCTION    : LoggerGetSyslogCounters
+//
+// DESCRIPTION : return the counters of a socket syslog (LOGGER_SYSLOG_SOCKET)
+//               logger
+//
+// ARGUMENTS   : LoggerId
+//               SentPtr     OUT  number of messages sent (may be NULL)
+//               QueuedPtr   OUT  number of messages waiting to be sent (may be NULL)
+//               DroppedPtr  OUT  number of messages dropped, because the queue was
+//                                full or the socket failed (may be NULL)
+//
+// RETURNS     : 1 for success, 0 if the logger is not a socket syslog logger
+//
+// ============================================================================
+int LOGGER_DLLFN LoggerGetSyslogCounters
+(
+	LOGGER_ID      LoggerId,
+	unsigned long *SentPtr,
+	unsigned long *QueuedPtr,
+	unsigned long *DroppedPtr
+)
+{
+	SyslogSink *Sink;
+	int         rc = 0;
+
+	// ensure single-threaded access to the Logger static data
+	START_SINGLE_THREAD
+
+	if((LoggerId>=0)&&(LoggerId<RegistrySize)&&(Registry[LoggerId] != NULL)&&
+	   (Registry[LoggerId]->Destination == LOGGER_SYSLOG_SOCKET))
+	{
+		Sink = Registry[LoggerId]->Syslog;
+		if(SentPtr != NULL)    { (*SentPtr)    = Sink->Sent; }
+		if(QueuedPtr != NULL)  { (*QueuedPtr)  = Sink->Head-Sink->Tail; }
+		if(DroppedPtr != NULL) { (*DroppedPtr) = Sink->Dropped; }
+		rc = 1;
+	}
+
+	// end single-thread access to Logger static data
+	END_SINGLE_THREAD
+
+	return rc;
+}
+
+// ============================================================================
+//
+// FUNCTION    : LoggerControl
+//
+// DESCRIPTION : apply a single runtime control command, so that the debug level,
+//               filters and destinations can be changed in a running program
+//
+// ARGUMENTS   : Command
+//
+//                A null-terminated control command.  Keywords are not case-sensitive.
+//                Blank commands and commands starting with # are ignored.
+//
+//                  debug <level>                   set the debug level (as LoggerSetDebugLevel)
+//
+//                  filter <id> all                 switch off filtering for logger <id>
+//
+//                  filter <id> <classes> [<severity> [<thread> [<source> [<function>]]]]
+//                                                  filter logger <id> (as LoggerSetFilter);
+//                                                   <classes> is a comma-separated list of
+//                                                   bare, info, warn, error, debug, audit_success,
+//                                                   audit_failure, all; use -1 for any severity or
+//                                                   thread, and - for any source file or function
+//
+//                  add <id> stdout                 log to stdout
+//                  add <id> file <path>            append to file <path>
+//                  add <id> truncate <path>        truncate, then write to file <path>
+//                  add <id> json <path>            append JSON records to file <path>
+//                  add <id> logfmt <path>          append logfmt records to file <path>
+//                  add <id> ring <path>            record to flight recorder file <path>
+//                  add <id> eventlog [<computer>]  log to the NT Event Log (Win32 only)
+//                  add <id> syslog                 log to syslogd (Linux only)
+//                  add <id> syslog-socket [<addr>] send RFC 5424 frames to a syslog socket
+//
+//                  remove <id>                     stop logging with logger <id>
+//
+//                  rate <classes> <per-minute> [<burst>]
+//                                                  limit the rate of messages of the given
+//                                                   classes from each call site (as
+//                                                   LoggerSetRateLimit; 0 for no limit)
+//
+//                  coalesce <seconds>              coalesce repeated messages (as
+//                                                   LoggerSetCoalesce; 0 to switch off)
+//
+//                  batch <messages> [<millis>]     batch writes to file destinations (as
+//                                                   LoggerSetBatching; 0 to switch off)
+//
+//                  show                            describe the current configuration
+//
+//                Loggers added with "add" take their host and application names from
+//                the default logger.
+//
+//               ReplyPtr, ReplySize
+//
+//                If ReplyPtr is not NULL, a null-terminated reply of at most ReplySize
+//                bytes is written to it (the configuration for "show", otherwise a
+//                confirmation or an error message).
+//
+// NOTES       : Changes are published to LoggerWriteMessage atomically, so writers never
+//               wait for a control command, and never see a half-applied change.
+//
+// RETURNS     : nonzero if the command was applied, zero otherwise
+//
+// ============================================================================
+int LOGGER_DLLFN LoggerControl
+(
+	char *Command,
+	char *ReplyPtr,
+	int   ReplySize
+)
+{
+	char        Verb[LOGGER_CONTROL_WORD_SIZE];
+	char        Word[LOGGER_CONTROL_WORD_SIZE];
+	char        Path[MAX_FILESIZE];
+	char        ErrorMsg[LOGGER_ERROR_MSG_SIZE+1];
+	char       *Cursor = Command;
+	LOGGER_ID   LoggerId;
+	LoggerData *ThisLogger;
+	char        Hostname[256];
+	char        Application[256];
+	int         Error = 0;
+	int         Truncate;
+	int         MsgClass, MsgSeverity, ThreadId;
+	int         PerMinute, Burst;
+	int         BatchSize;
+	int         i;
+	char        SourceFile[MAX_FILESIZE];
+	char        FuncName[1000];
+	int         rc;
+
+	// clear the reply
+	if((ReplyPtr!=NULL)&&(ReplySize>0)) { ReplyPtr[0] = LOGGER_EOS; }
+
+	if(Command==NULL)
+	{
+		ControlReply(ReplyPtr,ReplySize,"no command");
+		return 0;
+	}
+
+	// get the keyword; blank lines and comments are accepted and ignored
+	NextControlWord(&Cursor,Verb,sizeof(Verb));
+	if((Verb[0]==LOGGER_EOS)||(Verb[0]=='#'))
+	{
+		return 1;
+	}
+
+	// debug level
+	if(ControlWordIs(Verb,"debug"))
+	{
+		NextControlWord(&Cursor,Word,sizeof(Word));
+		if(!IsControlInteger(Word))
+		{
+			ControlReply(ReplyPtr,ReplySize,"invalid debug level '%s'",Word);
+			return 0;
+		}
+		LoggerSetDebugLevel(atoi(Word));
+		ControlReply(ReplyPtr,ReplySize,"debug level is %d",LoggerGetDebugLevel());
+		return 1;
+	}
+
+	// rate limits
+	if(ControlWordIs(Verb,"rate"))
+	{
+		NextControlWord(&Cursor,Word,sizeof(Word));
+		if(!ParseControlClasses(Word,&MsgClass))
+		{
+			ControlReply(ReplyPtr,ReplySize,"invalid message classes '%s'",Word);
+			return 0;
+		}
+		NextControlWord(&Cursor,Word,sizeof(Word));
+		if(!IsControlInteger(Word))
+		{
+			ControlReply(ReplyPtr,ReplySize,"invalid rate '%s'",Word);
+			return 0;
+		}
+		PerMinute = atoi(Word);
+		NextControlWord(&Cursor,Word,sizeof(Word));
+		if((Word[0]!=LOGGER_EOS)&&(!IsControlInteger(Word)))
+		{
+			ControlReply(ReplyPtr,ReplySize,"invalid burst '%s'",Word);
+			return 0;
+		}
+		Burst = (Word[0]==LOGGER_EOS)?1:atoi(Word);
+		for(i=0;i<=LOGGER_MAX_CLASS;i++)
+		{
+			if(MsgClass&(1<<i))
+			{
+				LoggerSetRateLimit(i,PerMinute,Burst);
+			}
+		}
+		ControlReply(ReplyPtr,ReplySize,"rate limit set");
+		return 1;
+	}
+
+	// coalescing of repeated messages
+	if(ControlWordIs(Verb,"coalesce"))
+	{
+		NextControlWord(&Cursor,Word,sizeof(Word));
+		if(!IsControlInteger(Word))
+		{
+			ControlReply(ReplyPtr,ReplySize,"invalid coalesce interval '%s'",Word);
+			return 0;
+		}
+		LoggerSetCoalesce(atoi(Word));
+		ControlReply(ReplyPtr,ReplySize,"coalesce interval is %d seconds",(int)CoalesceSeconds);
+		return 1;
+	}
+
+	// batching of file writes
+	if(ControlWordIs(Verb,"batch"))
+	{
+		NextControlWord(&Cursor,Word,sizeof(Word));
+		if(!IsControlInteger(Word))
+		{
+			ControlReply(ReplyPtr,ReplySize,"invalid batch size '%s'",Word);
+			return 0;
+		}
+		BatchSize = atoi(Word);
+		NextControlWord(&Cursor,Word,sizeof(Word));
+		if((Word[0]!=LOGGER_EOS)&&(!IsControlInteger(Word)))
+		{
+			ControlReply(ReplyPtr,ReplySize,"invalid batch interval '%s'",Word);
+			return 0;
+		}
+		if(!LoggerSetBatching(BatchSize,(Word[0]==LOGGER_EOS)?0:atoi(Word)))
+		{
+			ControlReply(ReplyPtr,ReplySize,"failed to start the batch thread");
+			return 0;
+		}
+		ControlReply(ReplyPtr,ReplySize,"batch size is %ld, interval %ld milliseconds",
+						BatchMessages,BatchMillis);
+		return 1;
+	}
+
+	// describe the current configuration
+	if(ControlWordIs(Verb,"show"))
+	{
+		ControlReply(ReplyPtr,ReplySize,"debug=%d coalesce=%d batch=%ld batch_millis=%ld\n",
+						LoggerGetDebugLevel(),(int)CoalesceSeconds,BatchMessages,BatchMillis);
+		for(i=0;i<=LOGGER_MAX_CLASS;i++)
+		{
+			if(RateLimits[i].PerMinute>0)
+			{
+				ControlReply(ReplyPtr,ReplySize,"rate class=%d per_minute=%ld burst=%ld\n",
+								i,RateLimits[i].PerMinute,RateLimits[i].Burst);
+			}
+		}
+		START_SINGLE_THREAD
+		for(LoggerId=0;LoggerId<RegistrySize;LoggerId++)
+		{
+			if((ThisLogger=Registry[LoggerId]) == NULL)
+			{
+				continue;
+			}
+			ControlReply(ReplyPtr,ReplySize,"logger %d: destination=%s",
+							(int)LoggerId,DestinationName(ThisLogger->Destination));
+			if(ThisLogger->Destination==LOGGER_SYSLOG_SOCKET)
+			{
+				ControlReply(ReplyPtr,ReplySize," sent=%lu queued=%lu dropped=%lu",
+								ThisLogger->Syslog->Sent,ThisLogger->Syslog->Head-ThisLogger->Syslog->Tail,
+								ThisLogger->Syslog->Dropped);
+			}
+			if(ThisLogger->Batch!=NULL)
+			{
+				ControlReply(ReplyPtr,ReplySize," batched=%lu writes=%lu",
+								ThisLogger->Batch->Messages,ThisLogger->Batch->Writes);
+			}
+			if(ThisLogger->FilterSet)
+			{
+				ControlReply(ReplyPtr,ReplySize," filter=0x%x severity=%d thread=%d source='%s' function='%s'\n",
+								ThisLogger->Filter.MessageClass,ThisLogger->Filter.MessageSeverity,
+								ThisLogger->Filter.ThreadId,
+								(ThisLogger->Filter.SourceFile==NULL) ? "" : ThisLogger->Filter.SourceFile,
+								(ThisLogger->Filter.FuncName==NULL)   ? "" : ThisLogger->Filter.FuncName);
+			}
+			else
+			{
+				ControlReply(ReplyPtr,ReplySize," filter=none\n");
+			}
+		}
+		END_SINGLE_THREAD
+		return 1;
+	}
+
+	// all other commands apply to a given logger
+	if(!ControlWordIs(Verb,"filter")&&!ControlWordIs(Verb,"add")&&!ControlWordIs(Verb,"remove"))
+	{
+		ControlReply(ReplyPtr,ReplySize,"unknown command '%s'",Verb);
+		return 0;
+	}
+	NextControlWord(&Cursor,Word,sizeof(Word));
+	if((!IsControlInteger(Word))||(atoi(Word)<0)||(atoi(Word)>=LOGGER_MAX_LOGGERS))
+	{
+		ControlReply(ReplyPtr,ReplySize,"invalid logger id '%s'",Word);
+		return 0;
+	}
+	LoggerId = (LOGGER_ID)atoi(Word);
+
+	// remove a destination
+	if(ControlWordIs(Verb,"remove"))
+	{
+		LoggerMarkUnused(LoggerId);
+		ControlReply(ReplyPtr,ReplySize,"logger %d removed",(int)LoggerId);
+		return 1;
+	}
+
+	// set or clear a filter
+	if(ControlWordIs(Verb,"filter"))
+	{
+		NextControlWord(&Cursor,Word,sizeof(Word));
+		if(ControlWordIs(Word,"all"))
+		{
+			LoggerSetFilter(LoggerId,1,0,0,0,NULL,NULL);
+			ControlReply(ReplyPtr,ReplySize,"logger %d is not filtered",(int)LoggerId);
+			return 1;
+		}
+		if(!ParseControlClasses(Word,&MsgClass))
+		{
+			ControlReply(ReplyPtr,ReplySize,"invalid message classes '%s'",Word);
+			return 0;
+		}
+
+		// optional severity and thread id
+		MsgSeverity = -1;
+		ThreadId    = -1;
+		NextControlWord(&Cursor,Word,sizeof(Word));
+		if(Word[0]!=LOGGER_EOS)
+		{
+			if(!IsControlInteger(Word))
+			{
+				ControlReply(ReplyPtr,ReplySize,"invalid severity '%s'",Word);
+				return 0;
+			}
+			MsgSeverity = atoi(Word);
+		}
+		NextControlWord(&Cursor,Word,sizeof(Word));
+		if(Word[0]!=LOGGER_EOS)
+		{
+			if(!IsControlInteger(Word))
+			{
+				ControlReply(ReplyPtr,ReplySize,"invalid thread id '%s'",Word);
+				return 0;
+			}
+			ThreadId = atoi(Word);
+		}
+
+		// optional source file and function ("-" means any)
+		NextControlWord(&Cursor,SourceFile,sizeof(SourceFile));
+		if(!strcmp(SourceFile,"-")) { SourceFile[0] = LOGGER_EOS; }
+		NextControlWord(&Cursor,FuncName,sizeof(FuncName));
+		if(!strcmp(FuncName,"-")) { FuncName[0] = LOGGER_EOS; }
+
+		LoggerSetFilter(LoggerId,0,MsgClass,MsgSeverity,ThreadId,SourceFile,FuncName);
+		ControlReply(ReplyPtr,ReplySize,"logger %d filter set",(int)LoggerId);
+		return 1;
+	}
+
+	// add (or replace) a destination, using the names of the default logger
+	Hostname[0]    = LOGGER_EOS;
+	Application[0] = LOGGER_EOS;
+	START_SINGLE_THREAD
+	if((RegistrySize>LOGGER_DEFAULT_LOGGER)&&((ThisLogger=Registry[LOGGER_DEFAULT_LOGGER]) != NULL))
+	{
+		strncpy(Hostname,ThisLogger->Hostname,sizeof(Hostname)-1);
+		Hostname[sizeof(Hostname)-1] = LOGGER_EOS;
+		strncpy(Application,ThisLogger->Application,sizeof(Application)-1);
+		Application[sizeof(Application)-1] = LOGGER_EOS;
+	}
+	END_SINGLE_THREAD
+	NextControlWord(&Cursor,Word,sizeof(Word));
+	ControlRest(Cursor,Path,sizeof(Path));
+	ErrorMsg[0] = LOGGER_EOS;
+
+	if(ControlWordIs(Word,"stdout"))
+	{
+		rc = LoggerConfigure(LoggerId,Hostname,Application,LOGGER_ANSI_STDOUT,
+								NULL,NULL,&Error,ErrorMsg);
+	}
+	else if(ControlWordIs(Word,"ring"))
+	{
+		if(Path[0]==LOGGER_EOS)
+		{
+			ControlReply(ReplyPtr,ReplySize,"missing file name");
+			return 0;
+		}
+		rc = LoggerConfigure(LoggerId,Hostname,Application,LOGGER_RING_FILENAME,
+								Path,NULL,&Error,ErrorMsg);
+	}
+	else if(ControlWordIs(Word,"file")||ControlWordIs(Word,"truncate")||
+			ControlWordIs(Word,"json")||ControlWordIs(Word,"logfmt"))
+	{
+		if(Path[0]==LOGGER_EOS)
+		{
+			ControlReply(ReplyPtr,ReplySize,"missing file name");
+			return 0;
+		}
+		Truncate = ControlWordIs(Word,"truncate");
+		rc = LoggerConfigure(LoggerId,Hostname,Application,
+								ControlWordIs(Word,"json") ? LOGGER_JSON_FILENAME :
+								ControlWordIs(Word,"logfmt") ? LOGGER_LOGFMT_FILENAME : LOGGER_ANSI_FILENAME,
+								Path,&Truncate,&Error,ErrorMsg);
+	}
+#if	LOGGER_PLATFORM_IS_WIN32
+	else if(ControlWordIs(Word,"eventlog"))
+	{
+		rc = LoggerConfigure(LoggerId,Hostname,Application,LOGGER_WIN32_EVENTLOG,
+								Path,NULL,&Error,ErrorMsg);
+	}
+#endif	// LOGGER_PLATFORM_IS_WIN32
+	else if(ControlWordIs(Word,"syslog-socket"))
+	{
+		rc = LoggerConfigure(LoggerId,Hostname,Application,LOGGER_SYSLOG_SOCKET,
+								(Path[0]==LOGGER_EOS) ? NULL : Path,NULL,&Error,ErrorMsg);
+	}
+#if	LOGGER_PLATFORM_IS_LINUX
+	else if(ControlWordIs(Word,"syslog"))
+	{
+		rc = LoggerConfigure(LoggerId,Hostname,Application,LOGGER_UNIX_SYSLOG,
+								NULL,NULL,&Error,ErrorMsg);
+	}
+#endif	// LOGGER_PLATFORM_IS_LINUX
+	else
+	{
+		ControlReply(ReplyPtr,ReplySize,"unknown destination '%s'",Word);
+		return 0;
+	}
+
+	if(!rc)
+	{
+		ControlReply(ReplyPtr,ReplySize,"logger %d: %s (error %d)",(int)LoggerId,ErrorMsg,Error);
+		return 0;
+	}
+	ControlReply(ReplyPtr,ReplySize,"logger %d: destination=%s",(int)LoggerId,Word);
+	return 1;
+}
+
+// ============================================================================
+//
+// FUNCTION    : LoggerWatchControlFile
+//
+// DESCRIPTION : apply the control commands in a file (see LoggerControl), and
+//               apply them again whenever the file changes
+//
+//               The file is checked by a background thread.  It does not need
+//               to exist: it is applied as soon as it is created.  Errors are
+//               logged as warnings, and the rest of the file is still applied.
+//
+// ARGUMENTS   : ControlFile  name of the control file (NULL to stop watching)
+//               PollSeconds  how often to check the file (<=0 for the default,
+//                            LOGGER_CONTROL_POLL_SECONDS)
+//
+// RETURNS     : nonzero on success, zero if the watcher thread could not be started
+//
+// ============================================================================
+int LOGGER_DLLFN LoggerWatchControlFile
+(
+	char *ControlFile,
+	int   PollSeconds
+)
+{
+#if	LOGGER_PLATFORM_IS_WIN32
+	HANDLE    hThread;
+	DWORD     ThreadId;
+#else	// LOGGER_PLATFORM_IS_LINUX
+	pthread_t Thread;
+#endif	// LOGGER_PLATFORM_IS_WIN32
+
+	// ensure single-threaded access to the Logger static data
+	START_SINGLE_THREAD
+
+	// stop watching?
+	if(ControlFile==NULL)
+	{
+		ControlFilePoll    = 0;
+		ControlFileName[0] = LOGGER_EOS;
+		END_SINGLE_THREAD
+		return 1;
+	}
+	if(strlen(ControlFile)>=sizeof(ControlFileName))
+	{
+		END_SINGLE_THREAD
+		return 0;
+	}
+
+	// (re)define the file to watch
+	strcpy(ControlFileName,ControlFile);
+	ControlFileTime = 0;
+	ControlFileSize = -1;
+	ControlFilePoll = (PollSeconds>0)?PollSeconds:LOGGER_CONTROL_POLL_SECONDS;
+
+	// start the watcher thread, unless it is already running
+	if(!ControlThreadUp)
+	{
+#if	LOGGER_PLATFORM_IS_WIN32
+		hThread = CreateThread(NULL,0,ControlFileThread,NULL,0,&ThreadId);
+		if(hThread==NULL)
+		{
+			ControlFilePoll = 0;
+			END_SINGLE_THREAD
+			return 0;
+		}
+		CloseHandle(hThread);
+#else	// LOGGER_PLATFORM_IS_LINUX
+		if(pthread_create(&Thread,NULL,ControlFileThread,NULL)!=0)
+		{
+			ControlFilePoll = 0;
+			END_SINGLE_THREAD
+			return 0;
+		}
+		pthread_detach(Thread);
+#endif	// LOGGER_PLATFORM_IS_WIN32
+		ControlThreadUp = 1;
+	}
+
+	// end single-thread access to Logger static data
+	END_SINGLE_THREAD
+
+	// apply the file straight away, so that it takes effect from the start
+	(void)CheckControlFile();
+
+	return 1;
+}
+
+// ============================================================================
+//
+// FUNCTION    : CloseLogger
+//
+// DESCRIPTION : close a logger (release its resources)
+//
+// ARGUMENTS   : ThisLogger
+//
+// RETURNS     : none
+//
+// NOTES       : Must be called in single-thread mode, once no writer can be
+//               using the logger.
+//
+// ============================================================================
+void CloseLogger
+(
+	LoggerData *ThisLogger
+)
+{
+	// close the given logger (unless its destination has been passed on)
+	if(ThisLogger->OwnsResources)
+	{
+		// write the last batch before the file is closed
+		if((ThisLogger->Batch != NULL)&&(ThisLogger->Destination != LOGGER_NONE))
+		{
+			BatchFlush(ThisLogger);
+		}
+
+		switch(ThisLogger->Destination)
+		{
+			case LOGGER_ANSI_FILENAME: case LOGGER_JSON_FILENAME: case LOGGER_LOGFMT_FILENAME:
+				// close the file
+				fclose(ThisLogger->ANSIFilePtr);
+				break;
+
+			case LOGGER_RING_FILENAME:
+				// unmap the ring (its contents stay in the file)
+				if(ThisLogger->RingHeader != NULL)
+				{
+#if	LOGGER_PLATFORM_IS_WIN32
+					UnmapViewOfFile(ThisLogger->RingHeader);
+#else	// LOGGER_PLATFORM_IS_LINUX
+					munmap(ThisLogger->RingHeader,
+							ThisLogger->RingHeader->HeaderSize+ThisLogger->RingHeader->DataSize);
+#endif	// LOGGER_PLATFORM_IS_WIN32
+					ThisLogger->RingHeader = NULL;
+				}
+				break;
+
+			case LOGGER_SYSLOG_SOCKET:
+				// send what we can of the queue, and close the socket
+				CloseSyslog(ThisLogger->Syslog);
+				ThisLogger->Syslog = NULL;
+				SyslogSinks--;
+				break;
+
+#if	LOGGER_PLATFORM_IS_WIN32
+
+			case LOGGER_WIN32_FILENAME:
+				// close the file
+				CloseHandle(ThisLogger->hWin32File);
+				break;
+
+			case LOGGER_WIN32_EVENTLOG:
+				// deregister
+				(void)DeregisterEventSource(ThisLogger->hEventSource);
+				break;
+
+#endif	// LOGGER_PLATFORM_IS_WIN32
+		
+			case LOGGER_SYBASE_SRVLOG:
+				// unload the Sybase Open Server DLL
+
+#if	LOGGER_PLATFORM_IS_WIN32
+				FreeLibrary(ThisLogger->hDLL);
+#else	// LOGGER_PLATFORM_IS_LINUX
+				dlclose(ThisLogger->LibHandle);
+#endif	// LOGGER_PLATFORM_IS_WIN32
+				break;
+		
+#if	LOGGER_PLATFORM_IS_LINUX
+
+		case LOGGER_UNIX_SYSLOG:
+
+			// close syslog (not strictly necessary according to man (3)
+			closelog();
+			break;
+
+#endif	// LOGGER_PLATFORM_IS_LINUX
+
+			default:
+				// no switch-off action
+				break;
+		}
+
+		free(ThisLogger->Batch);
+		ThisLogger->Batch = NULL;
+	}
+
+}
+
+// ============================================================================
+//
+// FUNCTION    : GrowRegistry
+//
+// DESCRIPTION : make sure that the logger registry has room for a logger id
+//
+// ARGUMENTS   : LoggerId
+//
+// RETURNS     : 1 for success, 0 if the id is out of range or out of memory
+//
+// NOTES       : Must be called in single-thread mode.  The registry doubles in
+//               size as required;  writers never see it, so it can be
+//               reallocated freely.
+//
+// ============================================================================
+int GrowRegistry
+(
+	LOGGER_ID LoggerId
+)
+{
+	LoggerData **NewRegistry;
+	int          NewSize;
+	int          i;
+
+	if((LoggerId<0)||(LoggerId>=LOGGER_MAX_LOGGERS))
+	{
+		return 0;
+	}
+	if(LoggerId<RegistrySize)
+	{
+		return 1;
+	}
+
+	for(NewSize=(RegistrySize>0)?RegistrySize:LOGGER_INITIAL_LOGGERS;NewSize<=LoggerId;NewSize*=2)
+		;
+	if(NewSize>LOGGER_MAX_LOGGERS)
+	{
+		NewSize = LOGGER_MAX_LOGGERS;
+	}
+
+	if((NewRegistry=(LoggerData**)realloc(Registry,NewSize*sizeof(LoggerData*))) == NULL)
+	{
+		return 0;
+	}
+	for(i=RegistrySize;i<NewSize;i++)
+	{
+		NewRegistry[i] = NULL;
+	}
+	Registry     = NewRegistry;
+	RegistrySize = NewSize;
+
+	return 1;
+}
+
+// ============================================================================
+//
+// FUNCTION    : NewLogger
+//
+// DESCRIPTION : allocate a logger with no destination and no filter
+//
+// ARGUMENTS   : LoggerId
+//               Hostname     name of the logging host (may be NULL)
+//               Application  name of the logging application (may be NULL)
+//
+// RETURNS     : the new logger, or NULL if out of memory
+//
+// ============================================================================
+LoggerData *NewLogger
+(
+	LOGGER_ID LoggerId,
+	char     *Hostname,
+	char     *Application
+)
+{
+	LoggerData *ThisLogger;
+	size_t      HostLength = (Hostname==NULL) ? 0 : strlen(Hostname);
+	size_t      AppLength  = (Application==NULL) ? 0 : strlen(Application);
+
+	// the names are stored after the logger, in the same block
+	if((ThisLogger=(LoggerData*)malloc(sizeof(LoggerData)+HostLength+AppLength+2)) == NULL)
+	{
+		return NULL;
+	}
+	memset(ThisLogger,0,sizeof(LoggerData));
+
+	ThisLogger->Id            = LoggerId;
+	ThisLogger->Destination   = LOGGER_NONE;
+	ThisLogger->OwnsResources = 1;
+	ThisLogger->Hostname      = (char*)(ThisLogger+1);
+	ThisLogger->Application   = ThisLogger->Hostname+HostLength+1;
+	memcpy(ThisLogger->Hostname,(HostLength>0) ? Hostname : "",HostLength+1);
+	memcpy(ThisLogger->Application,(AppLength>0) ? Application : "",AppLength+1);
+
+	return ThisLogger;
+}
+
+// ============================================================================
+//
+// FUNCTION    : CloneLogger
+//
+// DESCRIPTION : allocate a copy of a logger, with no filter, which shares the
+//               original's destination
+//
+// ARGUMENTS   : Original
+//
+// RETURNS     : the copy, or NULL if out of memory
+//
+// NOTES       : The copy does not own the destination until the caller says so
+//               (see LoggerSetFilter).
+//
+// ============================================================================
+LoggerData *CloneLogger
+(
+	LoggerData *Original
+)
+{
+	LoggerData *ThisLogger;
+
+	if((ThisLogger=NewLogger(Original->Id,Original->Hostname,Original->Application)) == NULL)
+	{
+		return NULL;
+	}
+
+	ThisLogger->Destination   = Original->Destination;
+	ThisLogger->OwnsResources = 0;
+	ThisLogger->MsgBuffer     = Original->MsgBuffer;
+	ThisLogger->ANSIFilePtr   = Original->ANSIFilePtr;
+	ThisLogger->RingHeader    = Original->RingHeader;
+	ThisLogger->Syslog        = Original->Syslog;
+	ThisLogger->Batch         = Original->Batch;
+#if	LOGGER_PLATFORM_IS_WIN32
+	ThisLogger->hWin32Console = Original->hWin32Console;
+	ThisLogger->hWin32File    = Original->hWin32File;
+	ThisLogger->hEventSource  = Original->hEventSource;
+	ThisLogger->hDLL          = Original->hDLL;
+#else	// LOGGER_PLATFORM_IS_LINUX
+	ThisLogger->LibHandle     = Original->LibHandle;
+#endif	// LOGGER_PLATFORM_IS_WIN32
+	ThisLogger->Srvlog        = Original->Srvlog;
+
+	return ThisLogger;
+}
+
+// ============================================================================
+//
+// FUNCTION    : ReleaseLogger
+//
+// DESCRIPTION : close a logger and free its memory
+//
+// ARGUMENTS   : ThisLogger
+//
+// RETURNS     : none
+//
+// NOTES       : Must be called in single-thread mode, once no writer can be
+//               using the logger (that is, after PublishLoggers has removed it).
+//
+// ============================================================================
+void ReleaseLogger
+(
+	LoggerData *ThisLogger
+)
+{
+	CloseLogger(ThisLogger);
+	free(ThisLogger->Filter.SourceFile);
+	free(ThisLogger->Filter.FuncName);
+	free(ThisLogger);
+}
+
+// ============================================================================
+//
+// FUNCTION    : PublishLoggers
+//
+// DESCRIPTION : make the writers use the loggers now in the registry
+//
+//               A new array of the loggers with a destination replaces
+//               ActiveLoggers, and the previous array is freed once every
+//               writer which might be using it has finished.
+//
+// ARGUMENTS   : none
+//
+// RETURNS     : 1 for success, 0 if out of memory (nothing is changed)
+//
+// NOTES       : Must be called in single-thread mode.  When it returns, no
+//               writer is using a logger which has been taken out of the
+//               registry, so the caller may release it.
+//
+// ============================================================================
+int PublishLoggers()
+{
+	LoggerSnapshot *Snapshot;
+	LoggerSnapshot *Previous;
+	int             Count = 0;
+	int             i;
+
+	for(i=0;i<RegistrySize;i++)
+	{
+		if((Registry[i] != NULL)&&(Registry[i]->Destination != LOGGER_NONE))
+		{
+			Count++;
+		}
+	}
+
+	if((Snapshot=(LoggerSnapshot*)malloc(sizeof(LoggerSnapshot)+Count*sizeof(LoggerData*))) == NULL)
+	{
+		return 0;
+	}
+	Snapshot->Count = 0;
+	for(i=0;i<RegistrySize;i++)
+	{
+		if((Registry[i] != NULL)&&(Registry[i]->Destination != LOGGER_NONE))
+		{
+			Snapshot->Active[Snapshot->Count++] = Registry[i];
+		}
+	}
+
+	// the writers see the whole of the new array, or none of it
+	LOGGER_MEMORY_BARRIER
+	Previous = (LoggerSnapshot*)LOGGER_ATOMIC_EXCHANGE_PTR(&ActiveLoggers,Snapshot);
+
+	WaitForReaders();
+	free(Previous);
+
+	return 1;
+}
+
+// ============================================================================
+//
+// FUNCTION    : EnterReader
+//
+// DESCRIPTION : register a writer which is about to use ActiveLoggers
+//
+// ARGUMENTS   : none
+//
+// RETURNS     : the index to pass to LeaveReader
+//
+// ============================================================================
+long EnterReader()
+{
+	long Index;
+
+	while(1)
+	{
+		Index = ReaderEpoch & 1;
+		LOGGER_ATOMIC_INCREMENT(&ReaderCount[Index]);
+
+		// if the epoch moved on meanwhile, WaitForReaders may already have
+		// looked at this count - register with the new one instead
+		if((ReaderEpoch & 1) == Index)
+		{
+			return Index;
+		}
+		LOGGER_ATOMIC_DECREMENT(&ReaderCount[Index]);
+	}
+}
+
+// ============================================================================
+//
+// FUNCTION    : LeaveReader
+//
+// DESCRIPTION : register that a writer has finished with ActiveLoggers
+//
+// ARGUMENTS   : Index  as returned by EnterReader
+//
+// RETURNS     : none
+//
+// ============================================================================
+void LeaveReader
+(
+	long Index
+)
+{
+	LOGGER_ATOMIC_DECREMENT(&ReaderCount[Index]);
+}
+
+// ============================================================================
+//
+// FUNCTION    : WaitForReaders
+//
+// DESCRIPTION : wait until every writer which was registered when this function
+//               was called has left
+//
+// ARGUMENTS   : none
+//
+// RETURNS     : none
+//
+// NOTES       : Must be called in single-thread mode.  The epoch is moved on,
+//               so that new writers register with the other count, and then
+//               the old count is allowed to drain;  this is done twice, because
+//               a writer may have read the epoch just before it moved on and
+//               registered just after.
+//
+// ============================================================================
+void WaitForReaders()
+{
+	long Index;
+	int  Pass;
+
+	for(Pass=0;Pass<2;Pass++)
+	{
+		Index = ReaderEpoch & 1;
+		LOGGER_ATOMIC_INCREMENT(&ReaderEpoch);
+		LOGGER_MEMORY_BARRIER
+
+		while(ReaderCount[Index] != 0)
+		{
+			LOGGER_YIELD
+		}
+	}
+}
+
+// ============================================================================
+//
+// FUNCTION    : CopyString
+//
+// DESCRIPTION : copy a string to the heap
+//
+// ARGUMENTS   : String
+//
+// RETURNS     : the copy, or NULL if String is NULL or empty (or out of memory)
+//
+// ============================================================================
+char *CopyString
+(
+	char *String
+)
+{
+	char *Copy;
+
+	if((String==NULL)||(String[0]==LOGGER_EOS))
+	{
+		return NULL;
+	}
+	if((Copy=(char*)malloc(strlen(String)+1)) != NULL)
+	{
+		strcpy(Copy,String);
+	}
+	return Copy;
+}
+
+// ============================================================================
+//
+// FUNCTION    : ControlFileThread
+//
+// DESCRIPTION : background thread which checks the runtime control file
+//               every ControlFilePoll seconds, until told to stop
+//
+// ARGUMENTS   : Parameter (not used)
+//
+// RETURNS     : 0
+//
+// ============================================================================
+#if	LOGGER_PLATFORM_IS_WIN32
+DWORD WINAPI ControlFileThread
+(
+	LPVOID Parameter
+)
+#else	// LOGGER_PLATFORM_IS_LINUX
+void *ControlFileThread
+(
+	void *Parameter
+)
+#endif	// LOGGER_PLATFORM_IS_WIN32
+{
+	int Poll;
+
+	(void)Parameter;	// not used
+
+	while((Poll=ControlFilePoll)>0)
+	{
+#if	LOGGER_PLATFORM_IS_WIN32
+		Sleep(Poll*1000);
+#else	// LOGGER_PLATFORM_IS_LINUX
+		sleep(Poll);
+#endif	// LOGGER_PLATFORM_IS_WIN32
+		if(ControlFilePoll>0)
+		{
+			(void)CheckControlFile();
+		}
+	}
+
+	// we have been told to stop
+	START_SINGLE_THREAD
+	ControlThreadUp = 0;
+	END_SINGLE_THREAD
+
+	return 0;
+}
+
+// ============================================================================
+//
+// FUNCTION    : CheckControlFile
+//
+// DESCRIPTION : apply the runtime control file if it has changed since it
+//               was last applied
+//
+// ARGUMENTS   : none
+//
+// RETURNS     : zero if the file was applied and any command failed, nonzero otherwise
+//
+// ============================================================================
+int CheckControlFile()
+{
+	char        FileName[MAX_FILESIZE];
+	struct stat StatBuffer;
+	int         Changed = 0;
+
+	// get the name of the control file
+	START_SINGLE_THREAD
+	strcpy(FileName,ControlFileName);
+	END_SINGLE_THREAD
+
+	// the control file does not have to exist
+	if((FileName[0]==LOGGER_EOS)||(stat(FileName,&StatBuffer)!=0))
+	{
+		return 1;
+	}
+
+	// has the file changed?
+	START_SINGLE_THREAD
+	if((StatBuffer.st_mtime != ControlFileTime)||((long)StatBuffer.st_size != ControlFileSize))
+	{
+		ControlFileTime = StatBuffer.st_mtime;
+		ControlFileSize = (long)StatBuffer.st_size;
+		Changed = 1;
+	}
+	END_SINGLE_THREAD
+
+	return Changed?ApplyControlFile(FileName):1;
+}
+
+// ============================================================================
+//
+// FUNCTION    : ApplyControlFile
+//
+// DESCRIPTION : apply each line of a runtime control file using LoggerControl
+//
+// ARGUMENTS   : FileName
+//
+// RETURNS     : nonzero if every command was applied, zero otherwise
+//
+// ============================================================================
+int ApplyControlFile
+(
+	char *FileName
+)
+{
+	FILE *ControlFile;
+	char  Line[LOGGER_BUFFERSIZE];
+	char  Reply[LOGGER_CONTROL_REPLY_SIZE];
+	int   LineNumber = 0;
+	int   Failures = 0;
+	int   Length;
+
+	if((ControlFile=fopen(FileName,"r"))==NULL)
+	{
+		return 0;
+	}
+
+	while(fgets(Line,sizeof(Line),ControlFile)!=NULL)
+	{
+		LineNumber++;
+
+		// strip the line terminator
+		Length = strlen(Line);
+		while((Length>0)&&((Line[Length-1]=='\n')||(Line[Length-1]=='\r')))
+		{
+			Line[--Length] = LOGGER_EOS;
+		}
+
+		if(!LoggerControl(Line,Reply,sizeof(Reply)))
+		{
+			Failures++;
+			LoggerWriteMessage(LOGGER_WARN,-1,-2,__FILE__,__LINE__,"",
+								"control file '%s' line %d: %s",FileName,LineNumber,Reply);
+		}
+	}
+	fclose(ControlFile);
+
+	if(LoggerGetDebugLevel()>=0)
+	{
+		LoggerWriteMessage(LOGGER_INFO,-1,-2,__FILE__,__LINE__,"",
+							"applied control file '%s' (%d lines, %d errors)",FileName,LineNumber,Failures);
+	}
+
+	return (Failures==0);
+}
+
+// ============================================================================
+//
+// FUNCTION    : NextControlWord, ControlRest, ControlWordIs, IsControlInteger
+//
+// DESCRIPTION : helpers to parse control commands: get the next white-space
+//               delimited word, get the rest of the command (trimmed), compare
+//               a word with a keyword (ignoring case), and check for an integer
+//
+// ============================================================================
+void NextControlWord
+(
+	char **Cursor,
+	char  *Word,
+	int    WordSize
+)
+{
+	int Length = 0;
+
+	while(isspace((unsigned char)**Cursor)) { (*Cursor)++; }
+	while((**Cursor!=LOGGER_EOS)&&(!isspace((unsigned char)**Cursor)))
+	{
+		if(Length<WordSize-1) { Word[Length++] = **Cursor; }
+		(*Cursor)++;
+	}
+	Word[Length] = LOGGER_EOS;
+}
+
+void ControlRest
+(
+	char *Cursor,
+	char *Rest,
+	int   RestSize
+)
+{
+	int Length;
+
+	while(isspace((unsigned char)*Cursor)) { Cursor++; }
+	strncpy(Rest,Cursor,RestSize-1);
+	Rest[RestSize-1] = LOGGER_EOS;
+	Length = strlen(Rest);
+	while((Length>0)&&(isspace((unsigned char)Rest[Length-1]))) { Rest[--Length] = LOGGER_EOS; }
+}
+
+int ControlWordIs
+(
+	char *Word,
+	char *Keyword
+)
+{
+	while((*Word!=LOGGER_EOS)&&(tolower((unsigned char)*Word)==*Keyword)) { Word++; Keyword++; }
+	return ((*Word==LOGGER_EOS)&&(*Keyword==LOGGER_EOS));
+}
+
+int IsControlInteger
+(
+	char *Word
+)
+{
+	if(*Word=='-') { Word++; }
+	if(*Word==LOGGER_EOS) { return 0; }
+	while(isdigit((unsigned char)*Word)) { Word++; }
+	return (*Word==LOGGER_EOS);
+}
+
+// ============================================================================
+//
+// FUNCTION    : ParseControlClasses
+//
+// DESCRIPTION : convert a comma-separated list of message class names into
+//               a filter mask (LOGGER_xxx_FILTER)
+//
+// ARGUMENTS   : Word     list of class names
+//               MaskPtr  OUT filter mask
+//
+// RETURNS     : nonzero if every name was recognised, zero otherwise
+//
+// ============================================================================
+int ParseControlClasses
+(
+	char *Word,
+	int  *MaskPtr
+)
+{
+	static struct { char *Name; int Filter; } Classes[] =
+	{
+		{ "bare",			LOGGER_BARE_FILTER },
+		{ "info",			LOGGER_INFO_FILTER },
+		{ "warn",			LOGGER_WARN_FILTER },
+		{ "error",			LOGGER_ERROR_FILTER },
+		{ "debug",			LOGGER_DEBUG_FILTER },
+		{ "audit_success",	LOGGER_AUDIT_SUCCESS_FILTER },
+		{ "audit_failure",	LOGGER_AUDIT_FAILURE_FILTER },
+		{ "all",			LOGGER_ALL_CLASSES_FILTER }
+	};
+	char  Name[LOGGER_CONTROL_WORD_SIZE];
+	char *Next;
+	int   Length, i, Found;
+
+	*MaskPtr = 0;
+	while(*Word!=LOGGER_EOS)
+	{
+		// get the next name
+		Next = strchr(Word,',');
+		Length = (Next==NULL)?(int)strlen(Word):(int)(Next-Word);
+		if((Length==0)||(Length>=(int)sizeof(Name)))
+		{
+			return 0;
+		}
+		strncpy(Name,Word,Length);
+		Name[Length] = LOGGER_EOS;
+
+		// look it up
+		Found = 0;
+		for(i=0;i<(int)(sizeof(Classes)/sizeof(Classes[0]));i++)
+		{
+			if(ControlWordIs(Name,Classes[i].Name))
+			{
+				*MaskPtr |= Classes[i].Filter;
+				Found = 1;
+				break;
+			}
+		}
+		if(!Found)
+		{
+			return 0;
+		}
+		Word += (Next==NULL)?Length:Length+1;
+	}
+	return (*MaskPtr!=0);
+}
+
+// ============================================================================
+//
+// FUNCTION    : ControlReply
+//
+// DESCRIPTION : append formatted text to a control command reply
+//
+// ARGUMENTS   : ReplyPtr, ReplySize  reply buffer (may be NULL)
+//               Format, ...          as for printf
+//
+// RETURNS     : none
+//
+// ============================================================================
+void ControlReply
+(
+	char *ReplyPtr,
+	int   ReplySize,
+	char *Format,
+	...
+)
+{
+	va_list ArgList;
+	int     Length;
+
+	if((ReplyPtr==NULL)||(ReplySize<=0))
+	{
+		return;
+	}
+	Length = strlen(ReplyPtr);
+	if(Length>=ReplySize-1)
+	{
+		return;
+	}
+	va_start(ArgList,Format);
+	vsnprintf(ReplyPtr+Length,ReplySize-Length,Format,ArgList);
+	va_end(ArgList);
+}
+
+// ============================================================================
+//
+// FUNCTION    : DestinationName
+//
+// DESCRIPTION : return a printable name for a logger destination
+//
+// ARGUMENTS   : Destination
+//
+// RETURNS     : destination name
+//
+// ============================================================================
+char *DestinationName
+(
+	int Destination
+)
+{
+	switch(Destination)
+	{
+		case LOGGER_NONE:				return "none";
+		case LOGGER_FMTONLY:			return "fmtonly";
+		case LOGGER_ANSI_STDOUT:		return "stdout";
+		case LOGGER_ANSI_FILENAME:		return "file";
+		case LOGGER_ANSI_FILEPTR:		return "fileptr";
+		case LOGGER_ANSI_FILEHANDLE:	return "filehandle";
+		case LOGGER_JSON_FILENAME:		return "json";
+		case LOGGER_LOGFMT_FILENAME:	return "logfmt";
+		case LOGGER_RING_FILENAME:		return "ring";
+		case LOGGER_WIN32_CONSOLE:		return "console";
+		case LOGGER_WIN32_FILENAME:		return "win32file";
+		case LOGGER_WIN32_FILEHANDLE:	return "win32filehandle";
+		case LOGGER_WIN32_EVENTLOG:		return "eventlog";
+		case LOGGER_SYBASE_SRVLOG:		return "srvlog";
+		case LOGGER_UNIX_SYSLOG:		return "syslog";
+		case LOGGER_SYSLOG_SOCKET:		return "syslog-socket";
+		default:						return "unknown";
+	}
+}
+
+// ============================================================================
+//
+// FUNCTION    : TickCount
+//
+// DESCRIPTION : return a millisecond clock (which wraps, so only differences
+//               are meaningful)
+//
+// ARGUMENTS   : none
+//
+// RETURNS     : milliseconds
+//
+// ============================================================================
+unsigned long TickCount()
+{
+#if	LOGGER_PLATFORM_IS_WIN32
+	return (unsigned long)GetTickCount();
+#else	// LOGGER_PLATFORM_IS_LINUX
+	struct timespec Now;
+	clock_gettime(CLOCK_MONOTONIC,&Now);
+	return (unsigned long)(Now.tv_sec*1000+Now.tv_nsec/1000000);
+#endif	// LOGGER_PLATFORM_IS_WIN32
+}
+
+// ============================================================================
+//
+// FUNCTION    : ClassKey
+//
+// DESCRIPTION : return the key for a message class used by the structured and
+//               syslog socket destinations
+//
+// ARGUMENTS   : MsgClass
+//
+// RETURNS     : the key
+//
+// ============================================================================
+char *ClassKey
+(
+	int MsgClass
+)
+{
+	switch(MsgClass)
+	{
+		case LOGGER_BARE:          return LOGGER_BARE_KEY;
+		case LOGGER_INFO:          return LOGGER_INFO_KEY;
+		case LOGGER_WARN:          return LOGGER_WARN_KEY;
+		case LOGGER_ERROR:         return LOGGER_ERROR_KEY;
+		case LOGGER_DEBUG:         return LOGGER_DEBUG_KEY;
+		case LOGGER_AUDIT_SUCCESS: return LOGGER_AUDIT_SUCCESS_KEY;
+		case LOGGER_AUDIT_FAILURE: return LOGGER_AUDIT_FAILURE_KEY;
+		default:                   return LOGGER_INFO_KEY;
+	}
+}
+
+// ============================================================================
+//
+// FUNCTION    : FormatStructured
+//
+// DESCRIPTION : build up a message as a single JSON object or logfmt line,
+//               according to the logger's destination (no trailing newline)
+//
+// ARGUMENTS   : ThisLogger  the logger
+//               Buffer      the buffer to build the record in
+//               BufferSize  the size of Buffer
+//               others      as for LoggerWriteMessage, except that Text is not a
+//                           format string
+//
+// RETURNS     : none
+//
+// NOTES       : A record which does not fit in Buffer is truncated, but is always
+//               well-formed.
+//
+// ============================================================================
+void FormatStructured
+(
+	LoggerData *ThisLogger,
+	char        Buffer[],
+	int         BufferSize,
+	int         MsgClass,
+	int         MsgSeverity,
+	int         ThreadId,
+	char        SourceFile[],
+	int         LineNumber,
+	char        FuncName[],
+	char        Text[]
+)
+{
+	StructuredRecord Record;
+	time_t           Now;
+	struct tm        NowTm;
+	char             TimeString[30];
+	char            *Service;
+
+	// leave room for the closing brace, a newline and the terminator
+	Record.Buffer = Buffer;
+	Record.Size   = BufferSize-3;
+	Record.Length = 0;
+	Record.Json   = (ThisLogger->Destination==LOGGER_JSON_FILENAME);
+	Record.Fields = 0;
+
+	Buffer[0] = LOGGER_EOS;
+	if(Record.Json)
+	{
+		strcpy(Buffer,"{");
+		Record.Length = 1;
+	}
+
+	// timestamp (UTC, ISO 8601)
+	Now = time(NULL);
+#if	LOGGER_PLATFORM_IS_WIN32
+	NowTm = *gmtime(&Now);
+#else	// LOGGER_PLATFORM_IS_LINUX
+	gmtime_r(&Now,&NowTm);
+#endif	// LOGGER_PLATFORM_IS_WIN32
+	strftime(TimeString,sizeof(TimeString),"%Y-%m-%dT%H:%M:%SZ",&NowTm);
+	StructuredString(&Record,"ts",TimeString);
+
+	// message class
+	StructuredString(&Record,"level",ClassKey(MsgClass));
+
+	// the optional fields, as for the text destinations
+	if(MsgSeverity>=0)
+	{
+		StructuredNumber(&Record,"severity",MsgSeverity);
+	}
+	if(ThisLogger->Hostname[0]!=LOGGER_EOS)
+	{
+		StructuredString(&Record,"host",ThisLogger->Hostname);
+	}
+	if(ThisLogger->Application[0]!=LOGGER_EOS)
+	{
+		StructuredString(&Record,"app",ThisLogger->Application);
+	}
+	Service = ServiceName;
+	if(Service!=NULL)
+	{
+		StructuredString(&Record,"service",Service);
+	}
+	if(ThreadId==-2)
+	{
+#if	LOGGER_PLATFORM_IS_WIN32
+		StructuredNumber(&Record,"thread",(long)GetCurrentThreadId());
+#else	// LOGGER_PLATFORM_IS_LINUX
+		StructuredNumber(&Record,"thread",(long)syscall(SYS_gettid));
+#endif	// LOGGER_PLATFORM_IS_WIN32
+	}
+	else if(ThreadId!=-1)
+	{
+		StructuredNumber(&Record,"thread",ThreadId);
+	}
+	if((SourceFile!=NULL)&&(*SourceFile!=LOGGER_EOS))
+	{
+		StructuredString(&Record,"source",SourceFile);
+	}
+	if(LineNumber>=0)
+	{
+		StructuredNumber(&Record,"line",LineNumber);
+	}
+	if((FuncName!=NULL)&&(*FuncName!=LOGGER_EOS))
+	{
+		StructuredString(&Record,"function",FuncName);
+	}
+
+	// the message text
+	StructuredString(&Record,"msg",Text);
+
+	if(Record.Json)
+	{
+		Buffer[Record.Length++] = '}';
+		Buffer[Record.Length]   = LOGGER_EOS;
+	}
+}
+
+// ============================================================================
+//
+// FUNCTION    : StructuredString
+//
+// DESCRIPTION : add a quoted, escaped string field to a structured record
+//
+// ARGUMENTS   : Record, Key, Value
+//
+// RETURNS     : none (the field is truncated or omitted if the record is full)
+//
+// ============================================================================
+void StructuredString
+(
+	StructuredRecord *Record,
+	char              Key[],
+	char              Value[]
+)
+{
+	int Room;
+	int Length;
+
+	// separator and key
+	Room = Record->Size-Record->Length;
+	Length = snprintf(Record->Buffer+Record->Length,Room,
+						Record->Json ? "%s\"%s\":\"" : "%s%s=\"",
+						(Record->Fields==0) ? "" : (Record->Json ? "," : " "),Key);
+	if((Length<0)||(Length>=Room-1))
+	{
+		Record->Buffer[Record->Length] = LOGGER_EOS;
+		return;
+	}
+	Record->Length += Length;
+
+	// value (leaving room for the closing quote)
+	Record->Length += EscapeText(Record->Buffer+Record->Length,Record->Size-Record->Length-1,Value);
+	Record->Buffer[Record->Length++] = '"';
+	Record->Buffer[Record->Length]   = LOGGER_EOS;
+	Record->Fields++;
+}
+
+// ============================================================================
+//
+// FUNCTION    : StructuredNumber
+//
+// DESCRIPTION : add an integer field to a structured record
+//
+// ARGUMENTS   : Record, Key, Value
+//
+// RETURNS     : none (the field is omitted if the record is full)
+//
+// ============================================================================
+void StructuredNumber
+(
+	StructuredRecord *Record,
+	char              Key[],
+	long              Value
+)
+{
+	int Room;
+	int Length;
+
+	Room = Record->Size-Record->Length;
+	Length = snprintf(Record->Buffer+Record->Length,Room,
+						Record->Json ? "%s\"%s\":%ld" : "%s%s=%ld",
+						(Record->Fields==0) ? "" : (Record->Json ? "," : " "),Key,Value);
+	if((Length<0)||(Length>=Room))
+	{
+		Record->Buffer[Record->Length] = LOGGER_EOS;
+		return;
+	}
+	Record->Length += Length;
+	Record->Fields++;
+}
+
+// ============================================================================
+//
+// FUNCTION    : EscapeText
+//
+// DESCRIPTION : copy a string, escaping quotes, backslashes and control
+//               characters as JSON requires (the same escapes are used for
+//               quoted logfmt values)
+//
+// ARGUMENTS   : Out      the output buffer (not null-terminated)
+//               OutSize  the space available in Out
+//               In       the null-terminated string to escape
+//
+// RETURNS     : the number of characters written to Out
+//
+// NOTES       : Where SSE2 is available, the string is scanned sixteen bytes
+//               at a time, and runs of characters which need no escaping are
+//               copied in one go.  Text which does not fit is truncated (never
+//               in the middle of an escape sequence).
+//
+// ============================================================================
+int EscapeText
+(
+	char  Out[],
+	int   OutSize,
+	char  In[]
+)
+{
+	int            InLength;
+	int            InPos   = 0;
+	int            OutPos  = 0;
+	int            Escaped;
+	unsigned char  Character;
+#if	LOGGER_HAVE_SSE2
+	__m128i        Quote     = _mm_set1_epi8('"');
+	__m128i        Backslash = _mm_set1_epi8('\\');
+	__m128i        Control   = _mm_set1_epi8(0x1f);
+	__m128i        Chunk;
+	__m128i        Special;
+	int            Mask;
+#if	LOGGER_PLATFORM_IS_WIN32
+	unsigned long  Clean;
+#else	// LOGGER_PLATFORM_IS_LINUX
+	int            Clean;
+#endif	// LOGGER_PLATFORM_IS_WIN32
+#endif	// LOGGER_HAVE_SSE2
+
+	InLength = (int)strlen(In);
+
+#if	LOGGER_HAVE_SSE2
+	while((InPos+16<=InLength)&&(OutPos+16<=OutSize))
+	{
+		// find the characters in this chunk which need escaping (control
+		// characters are those for which max(c,0x1f)==0x1f, unsigned)
+		Chunk   = _mm_loadu_si128((__m128i*)(In+InPos));
+		Special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(Chunk,Quote),_mm_cmpeq_epi8(Chunk,Backslash)),
+								_mm_cmpeq_epi8(_mm_max_epu8(Chunk,Control),Control));
+		Mask    = _mm_movemask_epi8(Special);
+
+		if(Mask==0)
+		{
+			// nothing to escape - copy the whole chunk
+			_mm_storeu_si128((__m128i*)(Out+OutPos),Chunk);
+			InPos  += 16;
+			OutPos += 16;
+			continue;
+		}
+
+		// copy the clean characters ahead of the first special one, then escape it
+#if	LOGGER_PLATFORM_IS_WIN32
+		_BitScanForward(&Clean,(unsigned long)Mask);
+#else	// LOGGER_PLATFORM_IS_LINUX
+		Clean = __builtin_ctz((unsigned int)Mask);
+#endif	// LOGGER_PLATFORM_IS_WIN32
+		memcpy(Out+OutPos,In+InPos,Clean);
+		InPos  += Clean;
+		OutPos += Clean;
+
+		if((Escaped=EscapeCharacter(Out+OutPos,OutSize-OutPos,(unsigned char)In[InPos]))==0)
+		{
+			return OutPos;
+		}
+		InPos++;
+		OutPos += Escaped;
+	}
+#endif	// LOGGER_HAVE_SSE2
+
+	// the remainder, one character at a time
+	for(;InPos<InLength;InPos++)
+	{
+		Character = (unsigned char)In[InPos];
+		if((Character=='"')||(Character=='\\')||(Character<0x20))
+		{
+			if((Escaped=EscapeCharacter(Out+OutPos,OutSize-OutPos,Character))==0)
+			{
+				break;
+			}
+			OutPos += Escaped;
+		}
+		else
+		{
+			if(OutPos>=OutSize)
+			{
+				break;
+			}
+			Out[OutPos++] = (char)Character;
+		}
+	}
+
+	return OutPos;
+}
+
+// ============================================================================
+//
+// FUNCTION    : EscapeCharacter
+//
+// DESCRIPTION : write the JSON escape sequence for a single character
+//
+// ARGUMENTS   : Out        the output buffer (not null-terminated)
+//               OutSize    the space available in Out
+//               Character  a quote, backslash or control character
+//
+// RETURNS     : the length of the escape sequence, or 0 if it does not fit
+//
+// ============================================================================
+int EscapeCharacter
+(
+	char          Out[],
+	int           OutSize,
+	unsigned char Character
+)
+{
+	char Sequence[7];
+	int  Length;
+
+	switch(Character)
+	{
+		case '"':  strcpy(Sequence,"\\\""); break;
+		case '\\': strcpy(Sequence,"\\\\"); break;
+		case '\n': strcpy(Sequence,"\\n");  break;
+		case '\r': strcpy(Sequence,"\\r");  break;
+		case '\t': strcpy(Sequence,"\\t");  break;
+		default:   sprintf(Sequence,"\\u%04x",(unsigned int)Character); break;
+	}
+
+	Length = (int)strlen(Sequence);
+	if(Length>OutSize)
+	{
+		return 0;
+	}
+	memcpy(Out,Sequence,Length);
+	return Length;
+}
+
+// ============================================================================
+//
+// FUNCTION    : OpenRing
+//
+// DESCRIPTION : create (or reopen) and map a flight recorder file
+//
+// ARGUMENTS   : FileName  the ring file
+//               Size      the requested ring size in bytes (0 for the default)
+//
+// RETURNS     : the mapped ring header, or NULL on failure
+//
+// NOTES       : An existing ring is kept (and appended to) if its layout matches;
+//               otherwise the file is reinitialised.
+//
+// ============================================================================
+LOGGER_RING_HEADER *OpenRing
+(
+	char FileName[],
+	int  Size
+)
+{
+	LOGGER_RING_HEADER *Header;
+	unsigned int        DataSize;
+	unsigned int        MapSize;
+#if	LOGGER_PLATFORM_IS_WIN32
+	HANDLE              hFile;
+	HANDLE              hMapping;
+#else	// LOGGER_PLATFORM_IS_LINUX
+	int                 FileHandle;
+#endif	// LOGGER_PLATFORM_IS_WIN32
+
+	// the ring size must be a power of two
+	if(Size<=0)
+	{
+		Size = LOGGER_RING_DEFAULT_SIZE;
+	}
+	for(DataSize=LOGGER_RING_MIN_SIZE;(DataSize<(unsigned int)Size)&&(DataSize<0x40000000);DataSize<<=1)
+	{
+		;
+	}
+	MapSize = sizeof(LOGGER_RING_HEADER)+DataSize;
+
+#if	LOGGER_PLATFORM_IS_WIN32
+
+	// the file and mapping handles can be closed as soon as the view exists
+	hFile = CreateFile(FileName,GENERIC_READ|GENERIC_WRITE,FILE_SHARE_READ|FILE_SHARE_WRITE,
+						NULL,OPEN_ALWAYS,FILE_ATTRIBUTE_NORMAL,NULL);
+	if(hFile == INVALID_HANDLE_VALUE)
+	{
+		return NULL;
+	}
+	hMapping = CreateFileMapping(hFile,NULL,PAGE_READWRITE,0,MapSize,NULL);
+	CloseHandle(hFile);
+	if(hMapping == NULL)
+	{
+		return NULL;
+	}
+	Header = (LOGGER_RING_HEADER*)MapViewOfFile(hMapping,FILE_MAP_WRITE,0,0,MapSize);
+	CloseHandle(hMapping);
+	if(Header == NULL)
+	{
+		return NULL;
+	}
+
+#else	// LOGGER_PLATFORM_IS_LINUX
+
+	// the file can be closed as soon as it is mapped
+	if((FileHandle=open(FileName,O_RDWR|O_CREAT,0644))<0)
+	{
+		return NULL;
+	}
+	if(ftruncate(FileHandle,MapSize)!=0)
+	{
+		close(FileHandle);
+		return NULL;
+	}
+	Header = (LOGGER_RING_HEADER*)mmap(NULL,MapSize,PROT_READ|PROT_WRITE,MAP_SHARED,FileHandle,0);
+	close(FileHandle);
+	if(Header == (LOGGER_RING_HEADER*)MAP_FAILED)
+	{
+		return NULL;
+	}
+
+#endif	// LOGGER_PLATFORM_IS_WIN32
+
+	// initialise the ring, unless it is a compatible one left by an earlier run
+	if((Header->Magic      != LOGGER_RING_MAGIC)||
+	   (Header->Version    != LOGGER_RING_VERSION)||
+	   (Header->HeaderSize != sizeof(LOGGER_RING_HEADER))||
+	   (Header->DataSize   != DataSize))
+	{
+		memset(Header,0,MapSize);
+		Header->Version    = LOGGER_RING_VERSION;
+		Header->HeaderSize = sizeof(LOGGER_RING_HEADER);
+		Header->DataSize   = DataSize;
+		Header->Head       = 0;
+		LOGGER_MEMORY_BARRIER
+		Header->Magic      = LOGGER_RING_MAGIC;
+	}
+
+	return Header;
+}
+
+// ============================================================================
+//
+// FUNCTION    : RingWrite
+//
+// DESCRIPTION : append a message to a flight recorder ring
+//
+// ARGUMENTS   : Header  the mapped ring
+//               Msg     the (complete) message
+//
+// RETURNS     : none
+//
+// NOTES       : Space is reserved with a single atomic add, so any number of
+//               threads (or processes sharing the file) can write at once.  The
+//               record's Start field is invalidated first and set last, so a
+//               reader never takes a half-written record for a complete one.
+//
+// ============================================================================
+void RingWrite
+(
+	LOGGER_RING_HEADER *Header,
+	char                Msg[]
+)
+{
+	static const char   Padding[LOGGER_RING_ALIGN] = { 0 };
+	char               *Data;
+	unsigned int        Mask;
+	unsigned int        TextLength;
+	unsigned int        Length;
+	unsigned int        Start;
+	LOGGER_RING_RECORD *Record;
+
+	Data = (char*)Header+Header->HeaderSize;
+	Mask = Header->DataSize-1;
+
+	// the record is padded with at least one zero byte
+	TextLength = (unsigned int)strlen(Msg);
+	Length     = (sizeof(LOGGER_RING_RECORD)+TextLength+LOGGER_RING_ALIGN)&~(LOGGER_RING_ALIGN-1);
+
+	// reserve space (records are aligned, so the record header never wraps)
+	Start  = LOGGER_ATOMIC_ADD(&Header->Head,Length);
+	Record = (LOGGER_RING_RECORD*)(Data+(Start&Mask));
+
+	Record->Start = ~Start;
+	LOGGER_MEMORY_BARRIER
+	Record->Length = Length;
+	RingCopy(Data,Mask,Start+sizeof(LOGGER_RING_RECORD),Msg,TextLength);
+	RingCopy(Data,Mask,Start+sizeof(LOGGER_RING_RECORD)+TextLength,Padding,
+				Length-sizeof(LOGGER_RING_RECORD)-TextLength);
+	LOGGER_MEMORY_BARRIER
+	Record->Start = Start;
+}
+
+// ============================================================================
+//
+// FUNCTION    : RingCopy
+//
+// DESCRIPTION : copy bytes into a ring, wrapping at the end
+//
+// ARGUMENTS   : Data      the ring data
+//               Mask      the ring size - 1
+//               Position  where to copy to (modulo the ring size)
+//               Source    what to copy
+//               Count     how many bytes to copy
+//
+// RETURNS     : none
+//
+// ============================================================================
+void RingCopy
+(
+	char          *Data,
+	unsigned int   Mask,
+	unsigned int   Position,
+	const char    *Source,
+	unsigned int   Count
+)
+{
+	unsigned int Offset = Position&Mask;
+	unsigned int First  = Mask+1-Offset;
+
+	if(Count<=First)
+	{
+		memcpy(Data+Offset,Source,Count);
+	}
+	else
+	{
+		memcpy(Data+Offset,Source,First);
+		memcpy(Data,Source+First,Count-First);
+	}
+}
+
+// ============================================================================
+//
+// FUNCTION    : SyslogSeverity
+//
+// DESCRIPTION : map a message class to a syslog severity
+//
+// ARGUMENTS   : MsgClass
+//
+// RETURNS     : syslog severity (as for LOG_ERR etc on Linux)
+//
+// ============================================================================
+int SyslogSeverity
+(
+	int MsgClass
+)
+{
+	switch(MsgClass)
+	{
+		case LOGGER_ERROR:         return 3;	// error
+		case LOGGER_WARN:          return 4;	// warning
+		case LOGGER_AUDIT_FAILURE: return 4;	// warning
+		case LOGGER_AUDIT_SUCCESS: return 5;	// notice
+		case LOGGER_INFO:          return 6;	// informational
+		case LOGGER_DEBUG:         return 7;	// debug
+		default:                   return 5;	// notice
+	}
+}
+
+// ============================================================================
+//
+// FUNCTION    : OpenSyslog
+//
+// DESCRIPTION : open a non-blocking socket to a syslog daemon
+//
+// ARGUMENTS   : Address  the pathname of a Unix datagram socket (Linux only), or
+//                        "host", "host:port" or ":port" for UDP;  NULL or empty
+//                        for LOGGER_SYSLOG_DEFAULT
+//
+// RETURNS     : the new destination, or NULL for failure
+//
+// NOTES       : The socket is not connected, so the daemon need not be running
+//               yet;  frames sent while it is not are counted as dropped.
+//
+// ============================================================================
+SyslogSink *OpenSyslog
+(
+	char *Address
+)
+{
+	SyslogSink      *Sink;
+	char             Host[MAX_FILESIZE];
+	char            *Port;
+	struct addrinfo  Hints;
+	struct addrinfo *Result;
+#if	LOGGER_PLATFORM_IS_WIN32
+	WSADATA          WsaData;
+	u_long           NonBlocking = 1;
+#else	// LOGGER_PLATFORM_IS_LINUX
+	struct sockaddr_un *UnixAddress;
+#endif	// LOGGER_PLATFORM_IS_WIN32
+
+	if((Address==NULL)||(*Address==LOGGER_EOS))
+	{
+		Address = LOGGER_SYSLOG_DEFAULT;
+	}
+	if(strlen(Address)>=sizeof(Host))
+	{
+		return NULL;
+	}
+
+	if((Sink=(SyslogSink*)calloc(1,sizeof(SyslogSink))) == NULL)
+	{
+		return NULL;
+	}
+	Sink->Socket = LOGGER_INVALID_SOCKET;
+
+#if	LOGGER_PLATFORM_IS_WIN32
+
+	if(WSAStartup(MAKEWORD(2,2),&WsaData) != 0)
+	{
+		free(Sink);
+		return NULL;
+	}
+
+#else	// LOGGER_PLATFORM_IS_LINUX
+
+	// a pathname is a local (Unix datagram) socket, such as /dev/log
+	if(Address[0]=='/')
+	{
+		UnixAddress = (struct sockaddr_un*)&Sink->Address;
+		if(strlen(Address)>=sizeof(UnixAddress->sun_path))
+		{
+			free(Sink);
+			return NULL;
+		}
+		UnixAddress->sun_family = AF_UNIX;
+		strcpy(UnixAddress->sun_path,Address);
+		Sink->AddressLength = sizeof(struct sockaddr_un);
+		Sink->Socket = socket(AF_UNIX,SOCK_DGRAM|SOCK_NONBLOCK|SOCK_CLOEXEC,0);
+		if(Sink->Socket == LOGGER_INVALID_SOCKET)
+		{
+			free(Sink);
+			return NULL;
+		}
+		return Sink;
+	}
+
+#endif	// LOGGER_PLATFORM_IS_WIN32
+
+	// otherwise a UDP address (resolved now, so that writers never have to)
+	strcpy(Host,Address);
+	Port = strrchr(Host,':');
+	if(Port != NULL)
+	{
+		*Port++ = LOGGER_EOS;
+	}
+	if((Port==NULL)||(*Port==LOGGER_EOS))
+	{
+		Port = LOGGER_SYSLOG_PORT;
+	}
+	if(Host[0]==LOGGER_EOS)
+	{
+		strcpy(Host,"127.0.0.1");
+	}
+
+	memset(&Hints,0,sizeof(Hints));
+	Hints.ai_family   = AF_UNSPEC;
+	Hints.ai_socktype = SOCK_DGRAM;
+	if(getaddrinfo(Host,Port,&Hints,&Result) == 0)
+	{
+		if(Result->ai_addrlen<=sizeof(Sink->Address))
+		{
+			memcpy(&Sink->Address,Result->ai_addr,Result->ai_addrlen);
+			Sink->AddressLength = (int)Result->ai_addrlen;
+#if	LOGGER_PLATFORM_IS_WIN32
+			Sink->Socket = socket(Result->ai_family,SOCK_DGRAM,IPPROTO_UDP);
+			if((Sink->Socket != LOGGER_INVALID_SOCKET)&&
+			   (ioctlsocket(Sink->Socket,FIONBIO,&NonBlocking) != 0))
+			{
+				closesocket(Sink->Socket);
+				Sink->Socket = LOGGER_INVALID_SOCKET;
+			}
+#else	// LOGGER_PLATFORM_IS_LINUX
+			Sink->Socket = socket(Result->ai_family,SOCK_DGRAM|SOCK_NONBLOCK|SOCK_CLOEXEC,0);
+#endif	// LOGGER_PLATFORM_IS_WIN32
+		}
+		freeaddrinfo(Result);
+	}
+
+	if(Sink->Socket == LOGGER_INVALID_SOCKET)
+	{
+#if	LOGGER_PLATFORM_IS_WIN32
+		WSACleanup();
+#endif	// LOGGER_PLATFORM_IS_WIN32
+		free(Sink);
+		return NULL;
+	}
+
+	return Sink;
+}
+
+// ============================================================================
+//
+// FUNCTION    : CloseSyslog
+//
+// DESCRIPTION : send what can be sent of the queue without blocking, and close
+//               a syslog socket
+//
+// ARGUMENTS   : Sink
+//
+// RETURNS     : none
+//
+// ============================================================================
+void CloseSyslog
+(
+	SyslogSink *Sink
+)
+{
+	if(Sink == NULL)
+	{
+		return;
+	}
+
+	SyslogFlush(Sink);
+
+#if	LOGGER_PLATFORM_IS_WIN32
+	closesocket(Sink->Socket);
+	WSACleanup();
+#else	// LOGGER_PLATFORM_IS_LINUX
+	close(Sink->Socket);
+#endif	// LOGGER_PLATFORM_IS_WIN32
+
+	free(Sink);
+}
+
+// ============================================================================
+//
+// FUNCTION    : SyslogWrite
+//
+// DESCRIPTION : queue a message as an RFC 5424 frame, and send the queue unless
+//               another thread is already sending it
+//
+//               <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID - MSG
+//
+// ARGUMENTS   : ThisLogger
+//               MsgClass    message class (gives the severity and the MSGID)
+//               Msg         the formatted message (without host, application
+//                           and time, which are in the header)
+//
+// RETURNS     : none
+//
+// NOTES       : Never blocks:  the queue lock is only held to copy a frame, and
+//               the socket is non-blocking.  Frames longer than
+//               LOGGER_SYSLOG_FRAME_SIZE are truncated.
+//
+// ============================================================================
+void SyslogWrite
+(
+	LoggerData *ThisLogger,
+	int         MsgClass,
+	char       *Msg
+)
+{
+	SyslogSink   *Sink = ThisLogger->Syslog;
+	char          Frame[LOGGER_SYSLOG_FRAME_SIZE];
+	char          Host[256];
+	char          App[49];
+	time_t        Now;
+	struct tm     NowTm;
+	int           Length;
+	int           MsgLength;
+	unsigned long Slot;
+
+	// the header (the time is UTC)
+	Now = time(NULL);
+#if	LOGGER_PLATFORM_IS_WIN32
+	NowTm = *gmtime(&Now);
+#else	// LOGGER_PLATFORM_IS_LINUX
+	gmtime_r(&Now,&NowTm);
+#endif	// LOGGER_PLATFORM_IS_WIN32
+	SyslogToken(Host,sizeof(Host),ThisLogger->Hostname);
+	SyslogToken(App,sizeof(App),ThisLogger->Application);
+	Length = sprintf(Frame,"<%d>1 %04d-%02d-%02dT%02d:%02d:%02dZ %s %s %lu %s - ",
+						LOGGER_SYSLOG_FACILITY*8+SyslogSeverity(MsgClass),
+						NowTm.tm_year+1900,NowTm.tm_mon+1,NowTm.tm_mday,
+						NowTm.tm_hour,NowTm.tm_min,NowTm.tm_sec,
+						Host,App,
+#if	LOGGER_PLATFORM_IS_WIN32
+						(unsigned long)GetCurrentProcessId(),
+#else	// LOGGER_PLATFORM_IS_LINUX
+						(unsigned long)getpid(),
+#endif	// LOGGER_PLATFORM_IS_WIN32
+						ClassKey(MsgClass));
+
+	// the message (no terminator is sent)
+	MsgLength = (int)strlen(Msg);
+	if(MsgLength>LOGGER_SYSLOG_FRAME_SIZE-Length)
+	{
+		MsgLength = LOGGER_SYSLOG_FRAME_SIZE-Length;
+	}
+	memcpy(Frame+Length,Msg,MsgLength);
+	Length += MsgLength;
+
+	// queue the frame, or drop it if the queue is full
+	while(LOGGER_ATOMIC_EXCHANGE(&Sink->QueueLock,1))
+	{
+		LOGGER_YIELD
+	}
+	if(Sink->Head-Sink->Tail>=LOGGER_SYSLOG_QUEUE)
+	{
+		Sink->Dropped++;
+	}
+	else
+	{
+		Slot = Sink->Head%LOGGER_SYSLOG_QUEUE;
+		memcpy(Sink->Frame[Slot],Frame,Length);
+		Sink->FrameLength[Slot] = Length;
+		Sink->Head++;
+	}
+	LOGGER_MEMORY_BARRIER
+	Sink->QueueLock = 0;
+
+	SyslogFlush(Sink);
+}
+
+// ============================================================================
+//
+// FUNCTION    : SyslogFlush
+//
+// DESCRIPTION : send queued frames until the queue is empty or the socket
+//               would block
+//
+// ARGUMENTS   : Sink
+//
+// RETURNS     : none
+//
+// NOTES       : If another thread is already sending, this returns at once;
+//               that thread sends any frames queued meanwhile.  Frames left
+//               when the socket would block are sent by the next message, or
+//               by BatchThread within BatchMillis (see FlushBatches).
+//
+// ============================================================================
+void SyslogFlush
+(
+	SyslogSink *Sink
+)
+{
+	unsigned long Head;
+	int           Count;
+	int           Sent;
+	int           Error;
+
+	do
+	{
+		// only one thread sends at a time
+		if(LOGGER_ATOMIC_EXCHANGE(&Sink->FlushBusy,1))
+		{
+			return;
+		}
+
+		Error = LOGGER_SYSLOG_OK;
+		while(Error != LOGGER_SYSLOG_BLOCKED)
+		{
+			// frames before Head are complete;  they are not reused until Tail passes them
+			Head = Sink->Head;
+			LOGGER_MEMORY_BARRIER
+			if((Count=(int)(Head-Sink->Tail)) == 0)
+			{
+				break;
+			}
+			if(Count>LOGGER_SYSLOG_BATCH)
+			{
+				Count = LOGGER_SYSLOG_BATCH;
+			}
+
+			Sent = SyslogSend(Sink,Sink->Tail,Count,&Error);
+
+			// a frame which the socket refused is dropped
+			while(LOGGER_ATOMIC_EXCHANGE(&Sink->QueueLock,1))
+			{
+				LOGGER_YIELD
+			}
+			Sink->Sent += Sent;
+			Sink->Tail += Sent;
+			if(Error == LOGGER_SYSLOG_FAILED)
+			{
+				Sink->Dropped++;
+				Sink->Tail++;
+			}
+			LOGGER_MEMORY_BARRIER
+			Sink->QueueLock = 0;
+		}
+
+		LOGGER_MEMORY_BARRIER
+		Sink->FlushBusy = 0;
+		LOGGER_MEMORY_BARRIER
+
+	// a frame may have been queued after we looked, by a writer which found us busy
+	} while((Error != LOGGER_SYSLOG_BLOCKED)&&(Sink->Head != Sink->Tail));
+}
+
+// ============================================================================
+//
+// FUNCTION    : SyslogSend
+//
+// DESCRIPTION : send a batch of queued frames, without blocking
+//
+// ARGUMENTS   : Sink
+//               First     the position of the first frame
+//               Count     the number of frames (at most LOGGER_SYSLOG_BATCH)
+//               ErrorPtr  OUT  LOGGER_SYSLOG_OK, LOGGER_SYSLOG_BLOCKED if the
+//                              socket would block, or LOGGER_SYSLOG_FAILED if
+//                              the frame after those sent was refused
+//
+// RETURNS     : the number of frames sent
+//
+// NOTES       : On Linux the batch goes to the kernel in a single sendmmsg call.
+//
+// ============================================================================
+int SyslogSend
+(
+	SyslogSink    *Sink,
+	unsigned long  First,
+	int            Count,
+	int           *ErrorPtr
+)
+{
+	unsigned long  Slot;
+	int            Sent;
+#if	LOGGER_PLATFORM_IS_WIN32
+	int            LastError;
+#else	// LOGGER_PLATFORM_IS_LINUX
+	struct mmsghdr Messages[LOGGER_SYSLOG_BATCH];
+	struct iovec   Vectors[LOGGER_SYSLOG_BATCH];
+	int            i;
+#endif	// LOGGER_PLATFORM_IS_WIN32
+
+	(*ErrorPtr) = LOGGER_SYSLOG_OK;
+
+#if	LOGGER_PLATFORM_IS_WIN32
+
+	for(Sent=0;Sent<Count;Sent++)
+	{
+		Slot = (First+Sent)%LOGGER_SYSLOG_QUEUE;
+		if(sendto(Sink->Socket,Sink->Frame[Slot],Sink->FrameLength[Slot],0,
+					(struct sockaddr*)&Sink->Address,Sink->AddressLength) == SOCKET_ERROR)
+		{
+			LastError = WSAGetLastError();
+			(*ErrorPtr) = ((LastError==WSAEWOULDBLOCK)||(LastError==WSAENOBUFS)) ?
+							LOGGER_SYSLOG_BLOCKED : LOGGER_SYSLOG_FAILED;
+			break;
+		}
+	}
+
+#else	// LOGGER_PLATFORM_IS_LINUX
+
+	memset(Messages,0,sizeof(Messages));
+	for(i=0;i<Count;i++)
+	{
+		Slot = (First+i)%LOGGER_SYSLOG_QUEUE;
+		Vectors[i].iov_base             = Sink->Frame[Slot];
+		Vectors[i].iov_len              = Sink->FrameLength[Slot];
+		Messages[i].msg_hdr.msg_iov     = &Vectors[i];
+		Messages[i].msg_hdr.msg_iovlen  = 1;
+		Messages[i].msg_hdr.msg_name    = &Sink->Address;
+		Messages[i].msg_hdr.msg_namelen = Sink->AddressLength;
+	}
+
+	// a short count means that the next frame failed;  the next call reports why
+	if((Sent=sendmmsg(Sink->Socket,Messages,Count,MSG_DONTWAIT)) < 0)
+	{
+		Sent = 0;
+		(*ErrorPtr) = ((errno==EAGAIN)||(errno==EWOULDBLOCK)||(errno==ENOBUFS)||(errno==EINTR)) ?
+						LOGGER_SYSLOG_BLOCKED : LOGGER_SYSLOG_FAILED;
+	}
+
+#endif	// LOGGER_PLATFORM_IS_WIN32
+
+	return Sent;
+}
+
+// ============================================================================
+//
+// FUNCTION    : SyslogToken
+//
+// DESCRIPTION : copy a syslog header field, which may only contain printable
+//               ASCII characters other than space
+//
+// ARGUMENTS   : Out      the output buffer
+//               OutSize  the size of Out (the field is truncated to fit)
+//               In       the text (may be NULL)
+//
+// RETURNS     : the length of the field ("-", the nil value, if it is empty)
+//
+// ============================================================================
+int SyslogToken
+(
+	char *Out,
+	int   OutSize,
+	char *In
+)
+{
+	int Length = 0;
+
+	for(;(In!=NULL)&&(*In!=LOGGER_EOS)&&(Length<OutSize-1);In++)
+	{
+		if((*In>32)&&(*In<127))
+		{
+			Out[Length++] = *In;
+		}
+	}
+	if(Length == 0)
+	{
+		Out[Length++] = '-';
+	}
+	Out[Length] = LOGGER_EOS;
+
+	return Length;
+}
+
+// ============================================================================
+//
+// FUNCTION    : OpenBatch
+//
+// DESCRIPTION : allocate an empty batch for a file destination
+//
+// ARGUMENTS   : none
+//
+// RETURNS     : the batch (free it with free), or NULL if out of memory
+//
+// ============================================================================
+BatchSink *OpenBatch()
+{
+	BatchSink *Batch;
+
+	// the two buffers follow the structure, in the same block
+	if((Batch=(BatchSink*)malloc(sizeof(BatchSink)+2*LOGGER_BATCH_BYTES)) == NULL)
+	{
+		return NULL;
+	}
+	memset(Batch,0,sizeof(BatchSink));
+	Batch->Buffer = (char*)(Batch+1);
+	Batch->Spare  = Batch->Buffer+LOGGER_BATCH_BYTES;
+
+	return Batch;
+}
+
+// ============================================================================
+//
+// FUNCTION    : BatchWrite
+//
+// DESCRIPTION : add a message to the batch of a file destination, writing the
+//               batch if it is full, if it holds BatchMessages messages, or if
+//               the message is an error
+//
+// ARGUMENTS   : ThisLogger
+//               MsgClass    message class
+//               Msg         the formatted message
+//
+// RETURNS     : 1 if the message was batched, 0 if batching is off (the caller
+//               must write the message itself)
+//
+// NOTES       : Messages which are not written by a writer are written by
+//               BatchThread within BatchMillis.
+//
+// ============================================================================
+int BatchWrite
+(
+	LoggerData *ThisLogger,
+	int         MsgClass,
+	char       *Msg
+)
+{
+	BatchSink *Batch = ThisLogger->Batch;
+	long       Limit = BatchMessages;
+	int        Length;
+	int        Flush;
+
+	if(Batch == NULL)
+	{
+		return 0;
+	}
+
+	// batching is off:  wait for a batch which another thread is writing (it
+	// has already been taken from the buffer), and write anything left from
+	// when it was on, so that the caller's message comes after both
+	if(Limit<=1)
+	{
+		while(1)
+		{
+			LOGGER_MEMORY_BARRIER
+			if(Batch->FlushBusy)
+			{
+				LOGGER_YIELD
+			}
+			else
+			if(Batch->Length>0)
+			{
+				Batch->FlushWanted = 1;
+				BatchFlush(ThisLogger);
+			}
+			else
+			{
+				break;
+			}
+		}
+		return 0;
+	}
+
+	// wait for room (a message is much smaller than the buffer)
+	Length = (int)strlen(Msg);
+	while(1)
+	{
+		while(LOGGER_ATOMIC_EXCHANGE(&Batch->Lock,1))
+		{
+			LOGGER_YIELD
+		}
+		if(Batch->Length+Length<=LOGGER_BATCH_BYTES)
+		{
+			break;
+		}
+		LOGGER_MEMORY_BARRIER
+		Batch->Lock = 0;
+
+		Batch->FlushWanted = 1;
+		BatchFlush(ThisLogger);
+		LOGGER_YIELD
+	}
+
+	memcpy(Batch->Buffer+Batch->Length,Msg,Length);
+	Batch->Length += Length;
+	Batch->Count++;
+	if((Flush=((Batch->Count>=Limit)||(MsgClass==LOGGER_ERROR))) != 0)
+	{
+		Batch->FlushWanted = 1;
+	}
+	LOGGER_MEMORY_BARRIER
+	Batch->Lock = 0;
+
+	if(Flush)
+	{
+		BatchFlush(ThisLogger);
+	}
+	return 1;
+}
+
+// ============================================================================
+//
+// FUNCTION    : BatchFlush
+//
+// DESCRIPTION : write the batch of a file destination, in a single call
+//
+// ARGUMENTS   : ThisLogger
+//
+// RETURNS     : none
+//
+// NOTES       : If another thread is already writing the batch, this returns at
+//               once;  that thread writes the batch again before it finishes,
+//               because FlushWanted has been set.
+//
+// ============================================================================
+void BatchFlush
+(
+	LoggerData *ThisLogger
+)
+{
+	BatchSink *Batch = ThisLogger->Batch;
+	char      *Data;
+	int        Length;
+	int        Count;
+
+	do
+	{
+		// only one thread writes at a time
+		if(LOGGER_ATOMIC_EXCHANGE(&Batch->FlushBusy,1))
+		{
+			return;
+		}
+
+		// take the batch, leaving the writers an empty buffer
+		while(LOGGER_ATOMIC_EXCHANGE(&Batch->Lock,1))
+		{
+			LOGGER_YIELD
+		}
+		Batch->FlushWanted = 0;
+		Data           = Batch->Buffer;
+		Length         = Batch->Length;
+		Count          = Batch->Count;
+		Batch->Buffer  = Batch->Spare;
+		Batch->Spare   = Data;
+		Batch->Length  = 0;
+		Batch->Count   = 0;
+		LOGGER_MEMORY_BARRIER
+		Batch->Lock = 0;
+
+		if(Length>0)
+		{
+			WriteFileDestination(ThisLogger,Data,Length);
+			Batch->Writes++;
+			Batch->Messages += Count;
+		}
+
+		LOGGER_MEMORY_BARRIER
+		Batch->FlushBusy = 0;
+		LOGGER_MEMORY_BARRIER
+
+	// a writer may have asked for a flush while we were busy
+	} while(Batch->FlushWanted);
+}
+
+// ============================================================================
+//
+// FUNCTION    : FlushBatches
+//
+// DESCRIPTION : write the batch of every file destination which has messages
+//               waiting, and send the queue of every socket syslog destination
+//               which has frames waiting
+//
+// ARGUMENTS   : none
+//
+// RETURNS     : the number of syslog frames still waiting (the socket would
+//               block, or another thread is sending them)
+//
+// NOTES       : Called by BatchThread, when batching is switched off, and when
+//               the process exits.  Like a writer, it takes no lock.
+//
+// ============================================================================
+int FlushBatches()
+{
+	LoggerSnapshot *Snapshot;
+	LoggerData     *ThisLogger;
+	long            ReaderIndex;
+	int             Waiting = 0;
+	int             i;
+
+	ReaderIndex = EnterReader();
+	Snapshot = ActiveLoggers;
+
+	for(i=0;(Snapshot!=NULL)&&(i<Snapshot->Count);i++)
+	{
+		ThisLogger = Snapshot->Active[i];
+		if((ThisLogger->Batch != NULL)&&(ThisLogger->Batch->Length>0))
+		{
+			ThisLogger->Batch->FlushWanted = 1;
+			BatchFlush(ThisLogger);
+		}
+		if((ThisLogger->Syslog != NULL)&&(ThisLogger->Syslog->Head != ThisLogger->Syslog->Tail))
+		{
+			SyslogFlush(ThisLogger->Syslog);
+			Waiting += (int)(ThisLogger->Syslog->Head-ThisLogger->Syslog->Tail);
+		}
+	}
+
+	LeaveReader(ReaderIndex);
+
+	return Waiting;
+}
+
+// ============================================================================
+//
+// FUNCTION    : FlushAtExit
+//
+// DESCRIPTION : write whatever is waiting when the process exits
+//
+// ARGUMENTS   : none
+//
+// RETURNS     : none
+//
+// NOTES       : A syslog daemon which is behind is given up to
+//               LOGGER_SYSLOG_EXIT_MILLIS to take the frames still queued.
+//
+// ============================================================================
+void FlushAtExit()
+{
+	int Millis;
+
+	for(Millis=0;(FlushBatches()>0)&&(Millis<LOGGER_SYSLOG_EXIT_MILLIS);Millis++)
+	{
+#if	LOGGER_PLATFORM_IS_WIN32
+		Sleep(1);
+#else	// LOGGER_PLATFORM_IS_LINUX
+		usleep(1000);
+#endif	// LOGGER_PLATFORM_IS_WIN32
+	}
+}
+
+// ============================================================================
+//
+// FUNCTION    : StartBatchThread
+//
+// DESCRIPTION : start BatchThread, unless it is already running, and arrange
+//               for whatever is waiting to be written when the process exits
+//
+// ARGUMENTS   : none
+//
+// RETURNS     : 1 for success, 0 if the thread could not be started
+//
+// NOTES       : Must be called in single-thread mode.
+//
+// ============================================================================
+int StartBatchThread()
+{
+#if	LOGGER_PLATFORM_IS_WIN32
+	HANDLE    hThread;
+	DWORD     ThreadId;
+#else	// LOGGER_PLATFORM_IS_LINUX
+	pthread_t Thread;
+#endif	// LOGGER_PLATFORM_IS_WIN32
+
+	if(!BatchThreadUp)
+	{
+#if	LOGGER_PLATFORM_IS_WIN32
+		hThread = CreateThread(NULL,0,BatchThread,NULL,0,&ThreadId);
+		if(hThread==NULL)
+		{
+			return 0;
+		}
+		CloseHandle(hThread);
+#else	// LOGGER_PLATFORM_IS_LINUX
+		if(pthread_create(&Thread,NULL,BatchThread,NULL)!=0)
+		{
+			return 0;
+		}
+		pthread_detach(Thread);
+#endif	// LOGGER_PLATFORM_IS_WIN32
+		BatchThreadUp = 1;
+	}
+
+	if(!BatchAtExit)
+	{
+		atexit(FlushAtExit);
+		BatchAtExit = 1;
+	}
+
+	return 1;
+}
+
+// ============================================================================
+//
+// FUNCTION    : BatchThread
+//
+// DESCRIPTION : background thread which writes waiting batches, and sends
+//               waiting syslog frames, every BatchMillis milliseconds, until
+//               batching is switched off and no socket syslog destination is open
+//
+// ARGUMENTS   : Parameter (not used)
+//
+// RETURNS     : 0
+//
+// ============================================================================
+#if	LOGGER_PLATFORM_IS_WIN32
+DWORD WINAPI BatchThread
+(
+	LPVOID Parameter
+)
+#else	// LOGGER_PLATFORM_IS_LINUX
+void *BatchThread
+(
+	void *Parameter
+)
+#endif	// LOGGER_PLATFORM_IS_WIN32
+{
+	(void)Parameter;	// not used
+
+	while(1)
+	{
+#if	LOGGER_PLATFORM_IS_WIN32
+		Sleep((DWORD)BatchMillis);
+#else	// LOGGER_PLATFORM_IS_LINUX
+		usleep((useconds_t)BatchMillis*1000);
+#endif	// LOGGER_PLATFORM_IS_WIN32
+
+		(void)FlushBatches();
+
+		// stop if there is nothing more to do (decided under the lock, so that
+		// StartBatchThread knows whether to start another thread)
+		START_SINGLE_THREAD
+		if((BatchMessages<=1)&&(SyslogSinks==0))
+		{
+			BatchThreadUp = 0;
+			END_SINGLE_THREAD
+			break;
+		}
+		END_SINGLE_THREAD
+	}
+
+	return 0;
+}
+
+// ============================================================================
+//
+// FUNCTION    : WriteFileDestination
+//
+// DESCRIPTION : write one or more formatted messages to a file destination,
+//               and flush them to the file
+//
+// ARGUMENTS   : ThisLogger
+//               Data        the messages (not null-terminated)
+//               Length      the number of bytes
+//
+// RETURNS     : none
+//
+// ============================================================================
+void WriteFileDestination
+(
+	LoggerData *ThisLogger,
+	char       *Data,
+	int         Length
+)
+{
+	BatchSink  *Batch = ThisLogger->Batch;
+	struct stat FstatBuffer;
+#if	LOGGER_PLATFORM_IS_WIN32
+	int         FilePosition;
+	int         CharsWritten;
+#endif	// LOGGER_PLATFORM_IS_WIN32
+
+	// one write to the file at a time
+	if(Batch != NULL)
+	{
+		while(LOGGER_ATOMIC_EXCHANGE(&Batch->WriteLock,1))
+		{
+			LOGGER_YIELD
+		}
+	}
+
+	switch(ThisLogger->Destination)
+	{
+		case LOGGER_ANSI_FILENAME: case LOGGER_ANSI_FILEPTR:
+		case LOGGER_JSON_FILENAME: case LOGGER_LOGFMT_FILENAME:
+
+			// check that the file handle is still valid
+			if(fstat(fileno(ThisLogger->ANSIFilePtr),&FstatBuffer)==0)
+			{
+				fwrite(Data,1,Length,ThisLogger->ANSIFilePtr);
+				fflush(ThisLogger->ANSIFilePtr);
+			}
+			break;
+
+#if	LOGGER_PLATFORM_IS_WIN32
+
+		case LOGGER_WIN32_FILENAME: case LOGGER_WIN32_FILEHANDLE:
+
+			// move to end of file
+			FilePosition=SetFilePointer(ThisLogger->hWin32File,
+											0,NULL,FILE_END);
+
+			// lock file for writing
+			LockFile(ThisLogger->hWin32File,FilePosition,
+						0,FilePosition+Length,0);
+
+			// write to the file
+			WriteFile(ThisLogger->hWin32File,Data,Length,
+							&CharsWritten,NULL);
+
+			// unlock the file
+			UnlockFile(ThisLogger->hWin32File,FilePosition,0,
+						FilePosition+Length,0);
+
+			// flush to disk
+			FlushFileBuffers(ThisLogger->hWin32File);
+
+			break;
+
+#endif	// LOGGER_PLATFORM_IS_WIN32
+
+		default:
+			break;
+	}
+
+	if(Batch != NULL)
+	{
+		LOGGER_MEMORY_BARRIER
+		Batch->WriteLock = 0;
+	}
+}
@@ -83,15 +83,26 @@
 ******************************************************************************/
 
 /*
-** maximum number of loggers
+** maximum number of loggers (the range of LOGGER_ID;  the Logger only allocates
+** space for the loggers which are actually used)
 */
-#define	LOGGER_MAX_LOGGERS	30
+#define	LOGGER_MAX_LOGGERS	32767
 
 /*
 ** the default logger identifier
 */
 #define	LOGGER_DEFAULT_LOGGER	0
 
+/*
+** default interval (seconds) at which a runtime control file is checked
+*/
+#define	LOGGER_CONTROL_POLL_SECONDS	2
+
+/*
+** default longest time (milliseconds) a message may wait in a batch (see LoggerSetBatching)
+*/
+#define	LOGGER_BATCH_MILLIS	200
+
 /*
 ** message classes
 */
@@ -116,6 +127,9 @@
 #define	LOGGER_ANSI_FILENAME	201
 #define	LOGGER_ANSI_FILEPTR		202
 #define	LOGGER_ANSI_FILEHANDLE	203
+#define	LOGGER_JSON_FILENAME	204
+#define	LOGGER_LOGFMT_FILENAME	205
+#define	LOGGER_RING_FILENAME	206
 
 #define	LOGGER_WIN32_CONSOLE	300
 #define	LOGGER_WIN32_FILENAME	301
@@ -126,12 +140,46 @@
 #define	LOGGER_SYBASE_SRVLOG	500
 
 #define	LOGGER_UNIX_SYSLOG		600
+#define	LOGGER_SYSLOG_SOCKET	601
 
 /*
 ** maximum (final) message size (including elements added by LOGGER)
 */
 #define LOGGER_BUFFERSIZE	5000
 
+/*
+** flight recorder (LOGGER_RING_FILENAME) file layout
+**
+** The file is a LOGGER_RING_HEADER followed by DataSize bytes of ring data
+** (DataSize is a power of two).  Head is the number of bytes ever reserved
+** (modulo 2^32).  The record reserved at position P starts at offset
+** P % DataSize, and is a LOGGER_RING_RECORD followed by the message text,
+** zero-padded to a multiple of LOGGER_RING_ALIGN bytes.  The writer stores
+** the record's Start field (= P) last, so a record whose Start field does
+** not match its position is incomplete or stale.
+*/
+#define	LOGGER_RING_MAGIC			0x52474F4C	/* "LOGR" */
+#define	LOGGER_RING_VERSION			1
+#define	LOGGER_RING_ALIGN			8
+#define	LOGGER_RING_MIN_SIZE		(64*1024)
+#define	LOGGER_RING_DEFAULT_SIZE	(4*1024*1024)
+
+typedef struct
+{
+	unsigned int          Magic;
+	unsigned int          Version;
+	unsigned int          HeaderSize;
+	unsigned int          DataSize;
+	volatile unsigned int Head;
+	unsigned int          Reserved[3];
+} LOGGER_RING_HEADER;
+
+typedef struct
+{
+	unsigned int          Length;		/* including this structure and the padding */
+	volatile unsigned int Start;		/* the record's position; written last */
+} LOGGER_RING_RECORD;
+
 /*
 ** value returned by LoggerGetUnusedLogger if no free loggers are available
 */
@@ -142,6 +190,18 @@
 */
 typedef short int LOGGER_ID;
 
+/*
+** rate limiting state for a single call site (see LoggerRateCheck);
+** each LOGGER_LOG_ macro holds its own static instance
+*/
+typedef struct
+{
+	int           Started;		/* bucket has been filled */
+	long          Tokens;		/* tokens available, in thousandths of a message */
+	unsigned long LastTick;		/* time of last refill (milliseconds) */
+	long          Dropped;		/* messages dropped since the last one logged */
+} LOGGER_RATE_SLOT;
+
 /*
 ** filter(s) for an existing logger message classes
 */
@@ -276,6 +336,99 @@ void LOGGER_DLLFN LoggerWriteMessage
 );
 DECL_END
 
+/*
+** rate limiting and coalescing of repeated messages
+*/
+DECL_START
+int LOGGER_DLLFN LoggerSetRateLimit
+(
+	int MsgClass,
+	int PerMinute,
+	int Burst
+);
+DECL_END
+
+DECL_START
+int LOGGER_DLLFN LoggerRateCheck
+(
+	LOGGER_RATE_SLOT *Slot,
+	int               MsgClass,
+	char             *SourceFile,
+	int               LineNumber
+);
+DECL_END
+
+/*
+** number of messages dropped by the rate limits
+*/
+DECL_START
+unsigned long LOGGER_DLLFN LoggerGetRateDropped();
+DECL_END
+
+DECL_START
+void LOGGER_DLLFN LoggerSetCoalesce
+(
+	int Seconds
+);
+DECL_END
+
+/*
+** batch the writes to file destinations
+*/
+DECL_START
+int LOGGER_DLLFN LoggerSetBatching
+(
+	int MaxMessages,
+	int MaxMillis
+);
+DECL_END
+
+/*
+** set the service name recorded by structured (JSON and logfmt) destinations
+*/
+DECL_START
+int LOGGER_DLLFN LoggerSetServiceName
+(
+	char *ServiceName
+);
+DECL_END
+
+/*
+** get the counters of a LOGGER_SYSLOG_SOCKET logger
+*/
+DECL_START
+int LOGGER_DLLFN LoggerGetSyslogCounters
+(
+	LOGGER_ID      LoggerId,
+	unsigned long *SentPtr,
+	unsigned long *QueuedPtr,
+	unsigned long *DroppedPtr
+);
+DECL_END
+
+/*
+** apply a runtime control command (debug level, filters, destinations)
+*/
+DECL_START
+int LOGGER_DLLFN LoggerControl
+(
+	char *Command,
+	char *ReplyPtr,
+	int   ReplySize
+);
+DECL_END
+
+/*
+** watch a runtime control file, applying it whenever it changes
+*/
+DECL_START
+int LOGGER_DLLFN LoggerWatchControlFile
+(
+	char *ControlFile,
+	int   PollSeconds
+);
+DECL_END
+
 /******************************************************************************
 **                                                                           **
 ** DEBUG MACROS                                                              **
@@ -301,6 +454,12 @@ DECL_END
 
 #endif	/* _DEBUG */
 
+/*
+** rate-limited call site: each expansion has its own LOGGER_RATE_SLOT
+*/
+#define	LOGGER_RATE_LIMITED(c,w)	\
+	{ static LOGGER_RATE_SLOT LoggerRateSlot; if(LoggerRateCheck(&LoggerRateSlot,c,__FILE__,__LINE__)) { w; } }
+
 /*
 ** macros for debug executable
 */
@@ -309,15 +468,15 @@ DECL_END
 #define	LOGGER_SET_DEBUG_LEVEL(d)	LoggerSetDebugLevel((int)(d));
 
 #define	LOGGER_LOG_DEBUG(m)	if(LoggerGetDebugLevel()>0)	\
-	{ LoggerWriteMessage(LOGGER_DEBUG,0,-2,__FILE__,__LINE__,"",m); }
+	LOGGER_RATE_LIMITED(LOGGER_DEBUG,LoggerWriteMessage(LOGGER_DEBUG,0,-2,__FILE__,__LINE__,"",m))
 #define	LOGGER_LOG_DEBUG1(m,p1)	if(LoggerGetDebugLevel()>0)	\
-	{ LoggerWriteMessage(LOGGER_DEBUG,0,-2,__FILE__,__LINE__,"",m,p1); }
+	LOGGER_RATE_LIMITED(LOGGER_DEBUG,LoggerWriteMessage(LOGGER_DEBUG,0,-2,__FILE__,__LINE__,"",m,p1))
 #define	LOGGER_LOG_DEBUG2(m,p1,p2)	if(LoggerGetDebugLevel()>0)	\
-	{ LoggerWriteMessage(LOGGER_DEBUG,0,-2,__FILE__,__LINE__,"",m,p1,p2); }
+	LOGGER_RATE_LIMITED(LOGGER_DEBUG,LoggerWriteMessage(LOGGER_DEBUG,0,-2,__FILE__,__LINE__,"",m,p1,p2))
 #define	LOGGER_LOG_DEBUG3(m,p1,p2,p3)	if(LoggerGetDebugLevel()>0)	\
-	{ LoggerWriteMessage(LOGGER_DEBUG,0,-2,__FILE__,__LINE__,"",m,p1,p2,p3); }
+	LOGGER_RATE_LIMITED(LOGGER_DEBUG,LoggerWriteMessage(LOGGER_DEBUG,0,-2,__FILE__,__LINE__,"",m,p1,p2,p3))
 #define	LOGGER_LOG_DEBUG4(m,p1,p2,p3,p4)	if(LoggerGetDebugLevel()>0)	\
-	{ LoggerWriteMessage(LOGGER_DEBUG,0,-2,__FILE__,__LINE__,"",m,p1,p2,p3,p4); }
+	LOGGER_RATE_LIMITED(LOGGER_DEBUG,LoggerWriteMessage(LOGGER_DEBUG,0,-2,__FILE__,__LINE__,"",m,p1,p2,p3,p4))
 
 /*
 ** macros for non-debug executable
@@ -340,26 +499,26 @@ DECL_END
 */
 
 #define	LOGGER_LOG_INFO(m)	if(LoggerGetDebugLevel()>=0)	\
-	{ LoggerWriteMessage(LOGGER_INFO,0,-2,__FILE__,__LINE__,"",m); }
+	LOGGER_RATE_LIMITED(LOGGER_INFO,LoggerWriteMessage(LOGGER_INFO,0,-2,__FILE__,__LINE__,"",m))
 #define	LOGGER_LOG_INFO1(m,p1)	if(LoggerGetDebugLevel()>=0)	\
-	{ LoggerWriteMessage(LOGGER_INFO,0,-2,__FILE__,__LINE__,"",m,p1); }
+	LOGGER_RATE_LIMITED(LOGGER_INFO,LoggerWriteMessage(LOGGER_INFO,0,-2,__FILE__,__LINE__,"",m,p1))
 #define	LOGGER_LOG_INFO2(m,p1,p2)	if(LoggerGetDebugLevel()>=0)	\
-	{ LoggerWriteMessage(LOGGER_INFO,0,-2,__FILE__,__LINE__,"",m,p1,p2); }
+	LOGGER_RATE_LIMITED(LOGGER_INFO,LoggerWriteMessage(LOGGER_INFO,0,-2,__FILE__,__LINE__,"",m,p1,p2))
 #define	LOGGER_LOG_INFO3(m,p1,p2,p3)	if(LoggerGetDebugLevel()>=0)	\
-	{ LoggerWriteMessage(LOGGER_INFO,0,-2,__FILE__,__LINE__,"",m,p1,p2,p3); }
+	LOGGER_RATE_LIMITED(LOGGER_INFO,LoggerWriteMessage(LOGGER_INFO,0,-2,__FILE__,__LINE__,"",m,p1,p2,p3))
 #define	LOGGER_LOG_INFO4(m,p1,p2,p3,p4)	if(LoggerGetDebugLevel()>=0)	\
-	{ LoggerWriteMessage(LOGGER_INFO,0,-2,__FILE__,__LINE__,"",m,p1,p2,p3,p4); }
+	LOGGER_RATE_LIMITED(LOGGER_INFO,LoggerWriteMessage(LOGGER_INFO,0,-2,__FILE__,__LINE__,"",m,p1,p2,p3,p4))
 
 #define	LOGGER_LOG_ERROR(m)	\
-	LoggerWriteMessage(LOGGER_ERROR,0,-2,__FILE__,__LINE__,"",m);
+	LOGGER_RATE_LIMITED(LOGGER_ERROR,LoggerWriteMessage(LOGGER_ERROR,0,-2,__FILE__,__LINE__,"",m))
 #define	LOGGER_LOG_ERROR1(m,p1)	\
-	LoggerWriteMessage(LOGGER_ERROR,0,-2,__FILE__,__LINE__,"",m,p1);
+	LOGGER_RATE_LIMITED(LOGGER_ERROR,LoggerWriteMessage(LOGGER_ERROR,0,-2,__FILE__,__LINE__,"",m,p1))
 #define	LOGGER_LOG_ERROR2(m,p1,p2)	\
-	LoggerWriteMessage(LOGGER_ERROR,0,-2,__FILE__,__LINE__,"",m,p1,p2);
+	LOGGER_RATE_LIMITED(LOGGER_ERROR,LoggerWriteMessage(LOGGER_ERROR,0,-2,__FILE__,__LINE__,"",m,p1,p2))
 #define	LOGGER_LOG_ERROR3(m,p1,p2,p3)	\
-	LoggerWriteMessage(LOGGER_ERROR,0,-2,__FILE__,__LINE__,"",m,p1,p2,p3);
+	LOGGER_RATE_LIMITED(LOGGER_ERROR,LoggerWriteMessage(LOGGER_ERROR,0,-2,__FILE__,__LINE__,"",m,p1,p2,p3))
 #define	LOGGER_LOG_ERROR4(m,p1,p2,p3,p4)	\
-	LoggerWriteMessage(LOGGER_ERROR,0,-2,__FILE__,__LINE__,"",m,p1,p2,p3,p4);
+	LOGGER_RATE_LIMITED(LOGGER_ERROR,LoggerWriteMessage(LOGGER_ERROR,0,-2,__FILE__,__LINE__,"",m,p1,p2,p3,p4))
 
 /*
 ** common filter macros
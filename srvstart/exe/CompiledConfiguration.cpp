@@ -0,0 +1,636 @@
+// ============================================================================
+//
+// FILE        : CompiledConfiguration.cpp
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : implementation of CompiledConfiguration class
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master source file exe.cpp for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// system headers
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+// support headers
+#include <logger.h>
+
+// class header
+#include "CompiledConfiguration.h"
+
+// ============================================================================
+//
+// LOCAL CLASSES
+//
+// ============================================================================
+
+//
+// a service being compiled
+//
+struct CompilingService
+{
+	DWORD                   nameOffset;
+	vector<CompiledSetting> settings;
+} ;
+
+//
+// the image being compiled
+//
+struct CompilingImage
+{
+	vector<CompilingService> services;
+	vector<char>             strings;		// offsets are fixed up when it is written
+
+	// add a string to the pool
+	DWORD addString(const char *str)
+	{
+		if(str==0) { return COMPILED_CONFIGURATION_NO_STRING; }
+		DWORD offset = strings.size();
+		strings.insert(strings.end(),str,str+strlen(str)+1);
+		return offset;
+	} ;
+
+	// compare the names of two services
+	bool nameLess(const CompilingService &a,const CompilingService &b) const
+	{
+		return strcmp(&strings[a.nameOffset],&strings[b.nameOffset])<0;
+	} ;
+} ;
+
+// ============================================================================
+//
+// LOCAL FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : mapFile
+//
+// DESCRIPTION     : map a file read-only
+//
+// ARGUMENTS       : path          IN  file name
+//                   fileHandle    OUT file handle
+//                   mappingHandle OUT mapping handle (NULL if the file is empty)
+//                   data          OUT the mapped file (NULL if it is empty)
+//                   size          OUT its size
+//
+// RETURNS         : true if successful
+//
+// ============================================================================
+static bool mapFile
+(
+	const char  *path,
+	HANDLE      &fileHandle,
+	HANDLE      &mappingHandle,
+	const char *&data,
+	DWORD       &size
+)
+{
+	DWORD sizeHigh = 0;
+
+	mappingHandle = NULL;
+	data          = 0;
+	size          = 0;
+
+	fileHandle = CreateFile(path,GENERIC_READ,FILE_SHARE_READ,NULL,
+		OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+	if(fileHandle==INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	size = GetFileSize(fileHandle,&sizeHigh);
+	if(((size==INVALID_FILE_SIZE)&&(GetLastError()!=NO_ERROR))||(sizeHigh!=0)||(size>0x7fffffffUL))
+	{
+		CloseHandle(fileHandle);
+		fileHandle = INVALID_HANDLE_VALUE;
+		return false;
+	}
+
+	// an empty file cannot be mapped
+	if(size>0)
+	{
+		mappingHandle = CreateFileMapping(fileHandle,NULL,PAGE_READONLY,0,0,NULL);
+		if(mappingHandle!=NULL)
+		{
+			data = (const char *)MapViewOfFile(mappingHandle,FILE_MAP_READ,0,0,0);
+		}
+		if(data==0)
+		{
+			if(mappingHandle!=NULL) { CloseHandle(mappingHandle); }
+			CloseHandle(fileHandle);
+			mappingHandle = NULL;
+			fileHandle    = INVALID_HANDLE_VALUE;
+			return false;
+		}
+	}
+	return true;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : unmapFile
+//
+// DESCRIPTION     : unmap and close a file mapped by mapFile
+//
+// ARGUMENTS       : fileHandle    IN file handle
+//                   mappingHandle IN mapping handle
+//                   data          IN the mapped file
+//
+// ============================================================================
+static void unmapFile
+(
+	HANDLE      fileHandle,
+	HANDLE      mappingHandle,
+	const char *data
+)
+{
+	if(data!=0)                           { UnmapViewOfFile(data); }
+	if(mappingHandle!=NULL)               { CloseHandle(mappingHandle); }
+	if(fileHandle!=INVALID_HANDLE_VALUE)  { CloseHandle(fileHandle); }
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : hashFile
+//
+// DESCRIPTION     : hash the contents of a file
+//
+// ARGUMENTS       : path IN  file name
+//                   hash OUT hash of its contents
+//
+// RETURNS         : true if successful
+//
+// ============================================================================
+static bool hashFile
+(
+	const char *path,
+	DWORD      &hash
+)
+{
+	HANDLE      fileHandle,mappingHandle;
+	const char *data;
+	DWORD       size;
+
+	if(!mapFile(path,fileHandle,mappingHandle,data,size))
+	{
+		return false;
+	}
+	hash = keywordHash(0,(data==0 ? "" : data),size);
+	unmapFile(fileHandle,mappingHandle,data);
+	return true;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : compileSection
+//
+// DESCRIPTION     : resolve one section and add it to the image
+//
+// ARGUMENTS       : cf      IN  open configuration file
+//                   section IN  section name (NULL for the directives in no
+//                               section)
+//                   image   OUT the image being compiled
+//
+// THROWS          : SrvStartException if a directive is invalid
+//
+// ============================================================================
+static void compileSection
+(
+	ConfigurationFile &cf,
+	char              *section,
+	CompilingImage    &image
+) throw(SrvStartException)
+{
+	ServiceDefinition definition;
+	CompilingService  service;
+
+	cf.setRequestedSection(section);
+	definition.parse(cf);
+
+	service.nameOffset = image.addString(section==0 ? "" : section);
+	for(int i=0; i<definition.getSettingCount(); i++)
+	{
+		const ServiceSetting &setting = definition.getSetting(i);
+		CompiledSetting       compiled;
+		compiled.directive  = setting.directive;
+		compiled.number     = setting.number;
+		compiled.nameOffset = image.addString(setting.name);
+		compiled.textOffset = image.addString(setting.text);
+		service.settings.push_back(compiled);
+	}
+	image.services.push_back(service);
+}
+
+// ============================================================================
+//
+// PUBLIC MEMBER FUNCTIONS
+//
+// ============================================================================
+
+
+// ============================================================================
+//
+// MEMBER FUNCTION : CompiledConfiguration::compile
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : compile every section of a configuration file into an image
+//
+//                   The image is written to a temporary file which then
+//                   replaces imagePath, so a service starting at the same time
+//                   sees either the old image or the new one.
+//
+// ARGUMENTS       : configPath IN configuration file
+//                   imagePath  IN image file to write
+//
+// RETURNS         : number of sections compiled (not counting the directives
+//                   in no section)
+//
+// THROWS          : SrvStartException if a directive is invalid, or the image
+//                   cannot be written
+//
+// ============================================================================
+int CompiledConfiguration::compile
+(
+	char        configPath[],
+	const char *imagePath
+) throw(SrvStartException)
+{
+	ConfigurationFile           cf;
+	CompilingImage              image;
+	CompiledConfigurationHeader header;
+	WIN32_FILE_ATTRIBUTE_DATA   attributes;
+
+	LOGGER_LOG_DEBUG2("compiling configuration file '%s' into '%s'",configPath,imagePath)
+
+	// identify the file compiled (before reading it, so that a change made
+	//  while compiling makes the image out of date)
+	memset(&header,0,sizeof(header));
+	if((!GetFileAttributesEx(configPath,GetFileExInfoStandard,&attributes))
+		||(!hashFile(configPath,header.sourceHash))
+		||(!cf.openConfigurationFile(configPath)))
+	{
+		LOGGER_LOG_ERROR1("failed to open configuration file '%s'",configPath)
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_INVALID_PARAMETER,"CompiledConfiguration","compile")
+	}
+
+	// resolve the directives in no section, then every section
+	compileSection(cf,0,image);
+	for(int i=0; i<cf.getSectionCount(); i++)
+	{
+		int         length;
+		const char *name = cf.getSectionName(i,length);
+		char        section[CFGFILE_SECTION_SIZE];
+		if((length==0)||(length>=CFGFILE_SECTION_SIZE))
+		{
+			// a service could never request it
+			LOGGER_LOG_INFO2("ignoring section '%.*s'",(length<CFGFILE_SECTION_SIZE ? length : CFGFILE_SECTION_SIZE-1),name)
+			continue;
+		}
+		memcpy(section,name,length);
+		section[length] = '\0';
+		LOGGER_LOG_DEBUG1("compiling section '%s'",section)
+		compileSection(cf,section,image);
+	}
+
+	// sort the services by name, so that they can be found by binary search
+	sort(image.services.begin(),image.services.end(),
+		[&image](const CompilingService &a,const CompilingService &b) { return image.nameLess(a,b); });
+
+	// lay out the image
+	DWORD settingCount = 0;
+	for(int i=0; i<(int)image.services.size(); i++)
+	{
+		settingCount += image.services[i].settings.size();
+	}
+	memcpy(header.magic,COMPILED_CONFIGURATION_MAGIC,sizeof(header.magic));
+	header.version        = COMPILED_CONFIGURATION_VERSION;
+	header.sourceSize     = attributes.nFileSizeLow;
+	header.sourceTimeLow  = attributes.ftLastWriteTime.dwLowDateTime;
+	header.sourceTimeHigh = attributes.ftLastWriteTime.dwHighDateTime;
+	header.serviceCount   = image.services.size();
+	header.servicesOffset = sizeof(header);
+	header.settingCount   = settingCount;
+	header.settingsOffset = header.servicesOffset+header.serviceCount*sizeof(CompiledService);
+	header.stringsOffset  = header.settingsOffset+header.settingCount*sizeof(CompiledSetting);
+	header.imageSize      = header.stringsOffset+image.strings.size();
+
+	// build the image
+	vector<char> data(header.imageSize);
+	CompiledService *services = (CompiledService *)&data[header.servicesOffset];
+	CompiledSetting *settings = (CompiledSetting *)&data[header.settingsOffset];
+	DWORD            next     = 0;
+	for(int i=0; i<(int)image.services.size(); i++)
+	{
+		const CompilingService &service = image.services[i];
+		services[i].nameOffset   = header.stringsOffset+service.nameOffset;
+		services[i].firstSetting = next;
+		services[i].settingCount = service.settings.size();
+		for(int j=0; j<(int)service.settings.size(); j++)
+		{
+			CompiledSetting setting = service.settings[j];
+			if(setting.nameOffset!=COMPILED_CONFIGURATION_NO_STRING)
+			{
+				setting.nameOffset += header.stringsOffset;
+			}
+			setting.textOffset += header.stringsOffset;
+			settings[next++] = setting;
+		}
+	}
+	memcpy(&data[header.stringsOffset],&image.strings[0],image.strings.size());
+	header.checksum = keywordHash(0,&data[sizeof(header)],header.imageSize-sizeof(header));
+	memcpy(&data[0],&header,sizeof(header));
+
+	// write it to a temporary file, and replace the old image
+	StringArena arena;
+	char       *tempPath = arena.append(arena.copy(imagePath),".tmp");
+	HANDLE      file     = CreateFile(tempPath,GENERIC_WRITE,0,NULL,CREATE_ALWAYS,FILE_ATTRIBUTE_NORMAL,NULL);
+	DWORD       written  = 0;
+	bool        ok       = (file!=INVALID_HANDLE_VALUE);
+	if(ok)
+	{
+		ok = (WriteFile(file,&data[0],header.imageSize,&written,NULL)!=0)&&(written==header.imageSize);
+		ok = (CloseHandle(file)!=0)&&ok;
+	}
+	if(ok)
+	{
+		ok = (MoveFileEx(tempPath,imagePath,MOVEFILE_REPLACE_EXISTING)!=0);
+	}
+	if(!ok)
+	{
+		LOGGER_LOG_ERROR2("failed to write compiled configuration '%s': error %lu",imagePath,GetLastError())
+		DeleteFile(tempPath);
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_GENERAL_ERROR,"CompiledConfiguration","compile")
+	}
+
+	LOGGER_LOG_DEBUG3("compiled %d services (%lu settings, %lu bytes)",
+		(int)header.serviceCount,header.settingCount,header.imageSize)
+	return header.serviceCount-1;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : CompiledConfiguration::open
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : map an image, and check that it is valid and up to date
+//
+//                   The image is up to date if the configuration file has the
+//                   same size and modification time as when it was compiled,
+//                   or (if only the modification time differs) the same hash.
+//
+// ARGUMENTS       : imagePath  IN image file
+//                   configPath IN the configuration file it was compiled from
+//
+// RETURNS         : true if the image can be used
+//
+// ============================================================================
+bool CompiledConfiguration::open
+(
+	const char *imagePath,
+	const char *configPath
+)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	DWORD                     sourceHash;
+
+	close();
+
+	if(!mapFile(imagePath,fileHandle,mappingHandle,image,imageSize))
+	{
+		LOGGER_LOG_DEBUG1("no compiled configuration '%s'",imagePath)
+		return false;
+	}
+
+	// check the layout
+	header = (const CompiledConfigurationHeader *)image;
+	if((imageSize<sizeof(CompiledConfigurationHeader))
+		||(memcmp(header->magic,COMPILED_CONFIGURATION_MAGIC,sizeof(header->magic))!=0)
+		||(header->version!=COMPILED_CONFIGURATION_VERSION)
+		||(header->imageSize!=imageSize)
+		||(header->serviceCount>imageSize/sizeof(CompiledService))
+		||(header->settingCount>imageSize/sizeof(CompiledSetting))
+		||(header->servicesOffset!=sizeof(CompiledConfigurationHeader))
+		||(header->settingsOffset!=header->servicesOffset+header->serviceCount*sizeof(CompiledService))
+		||(header->stringsOffset!=header->settingsOffset+header->settingCount*sizeof(CompiledSetting))
+		||(header->stringsOffset>imageSize)
+		||((header->stringsOffset<imageSize)&&(image[imageSize-1]!='\0'))
+		||(header->checksum!=keywordHash(0,image+sizeof(CompiledConfigurationHeader),
+									imageSize-sizeof(CompiledConfigurationHeader))))
+	{
+		LOGGER_LOG_ERROR1("ignoring invalid compiled configuration '%s'",imagePath)
+		close();
+		return false;
+	}
+
+	// is it up to date?
+	if((!GetFileAttributesEx(configPath,GetFileExInfoStandard,&attributes))
+		||(attributes.nFileSizeHigh!=0)
+		||(attributes.nFileSizeLow!=header->sourceSize))
+	{
+		LOGGER_LOG_INFO1("compiled configuration '%s' is out of date",imagePath)
+		close();
+		return false;
+	}
+	if((attributes.ftLastWriteTime.dwLowDateTime!=header->sourceTimeLow)
+		||(attributes.ftLastWriteTime.dwHighDateTime!=header->sourceTimeHigh))
+	{
+		if((!hashFile(configPath,sourceHash))||(sourceHash!=header->sourceHash))
+		{
+			LOGGER_LOG_INFO1("compiled configuration '%s' is out of date",imagePath)
+			close();
+			return false;
+		}
+		LOGGER_LOG_DEBUG1("'%s' has been touched but not changed",configPath)
+	}
+
+	LOGGER_LOG_DEBUG2("opened compiled configuration '%s' (%lu services)",imagePath,header->serviceCount)
+	return true;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : CompiledConfiguration::find
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : get the definition of a service from the image
+//
+// ARGUMENTS       : service    IN  service (section) name
+//                   definition OUT its definition
+//
+// RETURNS         : false if the image is not open or is invalid
+//
+// ============================================================================
+bool CompiledConfiguration::find
+(
+	const char        *service,
+	ServiceDefinition &definition
+) const
+{
+	if(header==0)
+	{
+		return false;
+	}
+
+	// binary search for the service
+	const CompiledService *services = (const CompiledService *)(image+header->servicesOffset);
+	const CompiledService *found    = 0;
+	int                    low = 0, high = (int)header->serviceCount-1;
+	while((low<=high)&&(found==0))
+	{
+		int         middle = (low+high)/2;
+		const char *name   = getString(services[middle].nameOffset);
+		if(name==0) { return false; }
+		int         cmp    = strcmp(service,name);
+		if(cmp==0)     { found = &services[middle]; }
+		else if(cmp<0) { high = middle-1; }
+		else           { low  = middle+1; }
+	}
+
+	// no section - use the directives in no section (which sort first)
+	if((found==0)&&(header->serviceCount>0))
+	{
+		const char *name = getString(services[0].nameOffset);
+		if((name!=0)&&(name[0]=='\0'))
+		{
+			found = &services[0];
+		}
+	}
+	if((found==0)
+		||(found->firstSetting>header->settingCount)
+		||(found->settingCount>header->settingCount-found->firstSetting))
+	{
+		return false;
+	}
+
+	// copy its settings
+	const CompiledSetting *settings = (const CompiledSetting *)(image+header->settingsOffset)+found->firstSetting;
+	definition.clear();
+	for(DWORD i=0; i<found->settingCount; i++)
+	{
+		const char *name = getString(settings[i].nameOffset);
+		const char *text = getString(settings[i].textOffset);
+		if((text==0)||(settings[i].directive>=DIRECTIVE_COUNT)
+			||((name==0)&&(settings[i].nameOffset!=COMPILED_CONFIGURATION_NO_STRING)))
+		{
+			definition.clear();
+			return false;
+		}
+		definition.addSetting(settings[i].directive,settings[i].number,name,text);
+	}
+	return true;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : CompiledConfiguration::CompiledConfiguration
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : constructor
+//
+// ============================================================================
+CompiledConfiguration::CompiledConfiguration()
+{
+	fileHandle    = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+	image         = 0;
+	imageSize     = 0;
+	header        = 0;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : CompiledConfiguration::~CompiledConfiguration
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : destructor
+//
+// ============================================================================
+CompiledConfiguration::~CompiledConfiguration()
+{
+	close();
+}
+
+// ============================================================================
+//
+// PRIVATE MEMBER FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// MEMBER FUNCTION : CompiledConfiguration::close
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : unmap the image
+//
+// ============================================================================
+void CompiledConfiguration::close()
+{
+	unmapFile(fileHandle,mappingHandle,image);
+	fileHandle    = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+	image         = 0;
+	imageSize     = 0;
+	header        = 0;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : CompiledConfiguration::getString
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : get a string from the image
+//
+// ARGUMENTS       : offset IN offset of the string
+//
+// RETURNS         : the string, or NULL if the offset is not in the string
+//                   pool (the image ends with a NUL, so every string in the
+//                   pool is terminated)
+//
+// ============================================================================
+const char *CompiledConfiguration::getString
+(
+	DWORD offset
+) const
+{
+	if((offset<header->stringsOffset)||(offset>=imageSize))
+	{
+		return 0;
+	}
+	return image+offset;
+}
@@ -0,0 +1,151 @@
+// ============================================================================
+//
+// FILE        : CompiledConfiguration.h
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : interface definition for CompiledConfiguration class
+//
+//               A compiled configuration is a binary image of the resolved
+//               ServiceDefinition of every section in a configuration file
+//               (plus one for the directives which are in no section), written
+//               by "srvstart compile ctrlfile".  When a service starts, the
+//               image is mapped and its definition is read directly, instead of
+//               parsing and validating the text file again.
+//
+//               The image records the size, modification time and hash of the
+//               file it was compiled from, and is ignored if that file has
+//               changed since.  It is also ignored if its version or checksum
+//               is wrong.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master source file exe.cpp for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// prevent multiple inclusion
+
+#if !defined(__COMPILED_CONFIGURATION_H__)
+#define __COMPILED_CONFIGURATION_H__
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+// class headers
+#include "ServiceDefinition.h"
+
+// ============================================================================
+//
+// CONSTANT DEFINITIONS
+//
+// ============================================================================
+
+// the image for ctrlfile is ctrlfile.compiled
+const char  COMPILED_CONFIGURATION_SUFFIX[]  = ".compiled";
+
+const char  COMPILED_CONFIGURATION_MAGIC[]   = "SRVSTCFG";
+const DWORD COMPILED_CONFIGURATION_VERSION   = 1;
+const DWORD COMPILED_CONFIGURATION_NO_STRING = 0xffffffffUL;
+
+// ============================================================================
+//
+// IMAGE LAYOUT
+//
+//  header, then the services (sorted by name), then the settings of every
+//  service, then the strings (each NUL-terminated).  All offsets are from
+//  the start of the image.
+//
+// ============================================================================
+
+struct CompiledConfigurationHeader
+{
+	char  magic[8];
+	DWORD version;
+	DWORD imageSize;
+	DWORD checksum;					// hash of everything after the header
+
+	// the configuration file compiled
+	DWORD sourceSize;
+	DWORD sourceTimeLow;
+	DWORD sourceTimeHigh;
+	DWORD sourceHash;
+
+	DWORD serviceCount;
+	DWORD servicesOffset;
+	DWORD settingCount;
+	DWORD settingsOffset;
+	DWORD stringsOffset;
+} ;
+
+struct CompiledService
+{
+	DWORD nameOffset;				// "" for the directives in no section
+	DWORD firstSetting;
+	DWORD settingCount;
+} ;
+
+struct CompiledSetting
+{
+	DWORD directive;
+	LONG  number;
+	DWORD nameOffset;				// COMPILED_CONFIGURATION_NO_STRING if none
+	DWORD textOffset;
+} ;
+
+// ============================================================================
+//
+// CompiledConfiguration class
+//
+// ============================================================================
+class CompiledConfiguration
+{
+public:
+
+	// compile a configuration file into an image
+	static int compile(char configPath[],const char *imagePath) throw(SrvStartException);
+
+	// open an image (false if it is missing, invalid or out of date)
+	bool open(const char *imagePath,const char *configPath);
+
+	// get the definition of a service (or of the directives in no section
+	//  if the service has no section)
+	bool find(const char *service,ServiceDefinition &definition) const;
+
+	// constructor and destructor
+	CompiledConfiguration();
+	virtual ~CompiledConfiguration();
+
+private:
+	// service functions
+	void        close();
+	const char *getString(DWORD offset) const;
+
+	// no copying
+	CompiledConfiguration(const CompiledConfiguration &);
+	CompiledConfiguration &operator=(const CompiledConfiguration &);
+
+	// the mapped image
+	HANDLE                             fileHandle;
+	HANDLE                             mappingHandle;
+	const char                        *image;
+	DWORD                              imageSize;
+	const CompiledConfigurationHeader *header;
+
+};
+
+#endif // !defined(__COMPILED_CONFIGURATION_H__)
@@ -33,8 +33,7 @@
 
 // system headers
 #include <stdlib.h>
-#include <string>
-#include <algorithm>
+#include <string.h>
 
 // support headers
 #include <logger.h>
@@ -42,6 +41,61 @@
 // class header
 #include "ConfigurationFile.h"
 
+// ============================================================================
+//
+// LOCAL FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : hashName
+//
+// DESCRIPTION     : hash a section name (FNV-1a)
+//
+// ARGUMENTS       : name   IN section name (not NUL-terminated)
+//                   length IN length of name
+//
+// RETURNS         : hash value
+//
+// ============================================================================
+static unsigned long hashName
+(
+	const char *name,
+	int         length
+)
+{
+	unsigned long hash = 2166136261UL;
+	for(int i=0; i<length; i++)
+	{
+		hash ^= (unsigned char)name[i];
+		hash  = (hash*16777619UL)&0xffffffffUL;
+	}
+	return hash;
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : copyView
+//
+// DESCRIPTION     : copy part of the mapped file into a NUL-terminated buffer
+//
+// ARGUMENTS       : dest   OUT buffer
+//                   src    IN  text to copy
+//                   length IN  length of text
+//
+// ============================================================================
+static void copyView
+(
+	char       *dest,
+	const char *src,
+	int         length
+)
+{
+	memcpy(dest,src,length);
+	dest[length] = '\0';
+}
+
 // ============================================================================
 //
 // PUBLIC MEMBER FUNCTIONS
@@ -57,6 +111,10 @@
 //
 // DESCRIPTION     : open named configuration file
 //
+//                   The file is mapped read-only and indexed.  It stays
+//                   mapped (and locked against writing) until the object is
+//                   destroyed or another file is opened.
+//
 // ARGUMENTS       : configPath IN path name of configuration file
 //
 // RETURNS         : true if successful, false otherwise
@@ -67,10 +125,107 @@ bool ConfigurationFile::openConfigurationFile
 	char configPath[]
 )
 {
+	DWORD sizeHigh = 0;
+
+	closeConfigurationFile();
+
 	// open configuration file
 	LOGGER_LOG_DEBUG1("opening configuration file '%s'",configPath)
-	configFile = new ifstream(configPath);
-	return (configFile->is_open()!=0);
+	fileHandle = CreateFile(configPath,GENERIC_READ,FILE_SHARE_READ,NULL,
+		OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL|FILE_FLAG_SEQUENTIAL_SCAN,NULL);
+	if(fileHandle==INVALID_HANDLE_VALUE)
+	{
+		LOGGER_LOG_DEBUG1("CreateFile failed: error %lu",GetLastError())
+		return false;
+	}
+
+	fileSize = GetFileSize(fileHandle,&sizeHigh);
+	if((fileSize==INVALID_FILE_SIZE)&&(GetLastError()!=NO_ERROR))
+	{
+		LOGGER_LOG_DEBUG1("GetFileSize failed: error %lu",GetLastError())
+		closeConfigurationFile();
+		return false;
+	}
+	if((sizeHigh!=0)||(fileSize>0x7fffffffUL))
+	{
+		LOGGER_LOG_ERROR1("configuration file '%s' is too large",configPath)
+		closeConfigurationFile();
+		return false;
+	}
+
+	// an empty file cannot be mapped, but has no directives anyway
+	if(fileSize>0)
+	{
+		mappingHandle = CreateFileMapping(fileHandle,NULL,PAGE_READONLY,0,0,NULL);
+		if(mappingHandle==NULL)
+		{
+			LOGGER_LOG_DEBUG1("CreateFileMapping failed: error %lu",GetLastError())
+			closeConfigurationFile();
+			return false;
+		}
+		fileData = (const char *)MapViewOfFile(mappingHandle,FILE_MAP_READ,0,0,0);
+		if(fileData==NULL)
+		{
+			LOGGER_LOG_DEBUG1("MapViewOfFile failed: error %lu",GetLastError())
+			closeConfigurationFile();
+			return false;
+		}
+	}
+
+	buildIndex();
+	return true;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationFile::getNextConfigurationDirective
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : get next configuration directive from currently-open file
+//
+//                   Directives which come before any section are returned
+//                   first, followed by those in the requested section (or,
+//                   if no section has been requested, every directive in the
+//                   order they appear in the file).
+//
+// ARGUMENTS       : directive OUT directive name and value
+//
+// RETURNS         : false if there are no more directives
+//
+// ============================================================================
+bool ConfigurationFile::getNextConfigurationDirective
+(
+	ConfigurationDirective &directive
+)
+{
+	if((_requestedSection[0]=='\0')&&(!globalsOnly))
+	{
+		// every directive, in file order
+		if(nextEntry>=(int)entries.size())
+		{
+			LOGGER_LOG_DEBUG("reached end of configuration file")
+			return false;
+		}
+		directive = entries[nextEntry++].directive;
+		return true;
+	}
+
+	// directives before any section come first
+	if(inGlobals&&(nextEntry<0))
+	{
+		inGlobals = false;
+		nextEntry = (requestedSectionIndex<0 ? -1 : sections[requestedSectionIndex].first);
+	}
+
+	if(nextEntry<0)
+	{
+		LOGGER_LOG_DEBUG1("reached end of section '%s'",_requestedSection)
+		return false;
+	}
+	directive = entries[nextEntry].directive;
+	nextEntry = entries[nextEntry].next;
+	return true;
 }
 
 // ============================================================================
@@ -84,6 +239,9 @@ bool ConfigurationFile::openConfigurationFile
 // ARGUMENTS       : directive OUT directive name (empty if no more directives)
 //                   value     OUT directive value
 //
+//                   The buffers must be large enough for the longest
+//                   directive and value in the file.
+//
 // ============================================================================
 void ConfigurationFile::getNextConfigurationDirective
 (
@@ -91,72 +249,15 @@ void ConfigurationFile::getNextConfigurationDirective
 	char value[]
 )
 {
-	char *line,*ch;
-	char  section[CFGFILE_SECTION_SIZE];
-	bool  rightSection = true;
+	ConfigurationDirective next;
 
 	directive[0] = '\0';
 	value[0]     = '\0';
 
-
-	LOGGER_LOG_DEBUG1("searching for next directive in section '%s'",_requestedSection)
-
-	// have we opened the configuration file yet?
-	if(configFile->is_open()==0)
+	if(getNextConfigurationDirective(next))
 	{
-		LOGGER_LOG_DEBUG("configuration file not open ... returning")
-		return;
-	}
-
-	// get the next directive / value pair
-	while(true)
-	{
-		line = readNextRealLine();
-		switch(*line)
-		{
-			case '\0':
-				// end of file reached
-				LOGGER_LOG_DEBUG("reached end of configuration file")
-				return;
-
-			case CFGFILE_SECTION_OPEN:
-				// new section
-				ch = section;
-				line++;
-				LOGGER_LOG_DEBUG1("found section '%s'",line)
-
-				while(((*line)!=CFGFILE_SECTION_CLOSE)&&((*line)!='\0')) { (*ch++) = (*line++); }
-				(*ch) = '\0';
-				// if not our section, ignore
-				if(_requestedSection[0]!='\0')
-				{
-					rightSection = (strcmp(section,_requestedSection) == 0);
-				}
-				else
-				{
-					rightSection = true;
-				}
-				break;
-
-			default:
-				// a directive / value pair
-				if(rightSection)
-				{
-					// extract the directive
-					ch = directive;
-					while(((*line)!='=')&&((*line)!='\0')) { (*ch++) = (*line++); }
-					(*ch) = '\0'; if((*line)=='='){ line++; }
-					// LOGGER_LOG_DEBUG1("extracted directive '%s'",directive)
-
-					// extract the value
-					ch = value;
-					while((*line)!='\0') { (*ch++) = (*line++); }
-					(*ch) = '\0';
-					// LOGGER_LOG_DEBUG1("extracted value '%s'",value)
-
-					return;
-				}
-		}
+		copyView(directive,next.name,next.nameLength);
+		copyView(value,next.value,next.valueLength);
 	}
 }
 
@@ -168,6 +269,8 @@ void ConfigurationFile::getNextConfigurationDirective
 //
 // DESCRIPTION     : set the characters which are recognised as starting a comment
 //
+//                   If a file is already open, it is indexed again.
+//
 // ARGUMENTS       : commentCharacters IN comment characters
 //
 // ============================================================================
@@ -182,6 +285,11 @@ void ConfigurationFile::setCommentCharacters
 	}
 	_commentCharacters = new char[strlen(commentCharacters)+1];
 	strcpy(_commentCharacters,commentCharacters);
+
+	if(fileHandle!=INVALID_HANDLE_VALUE)
+	{
+		buildIndex();
+	}
 }
 
 // ============================================================================
@@ -193,7 +301,8 @@ void ConfigurationFile::setCommentCharacters
 // DESCRIPTION     : set the name of the requested section: only directives in
 //                   this section or in no section will be returned
 //
-// ARGUMENTS       : requestedSection IN requested section
+// ARGUMENTS       : requestedSection IN requested section (NULL for only the
+//                                       directives in no section)
 //
 // ============================================================================
 void ConfigurationFile::setRequestedSection
@@ -201,8 +310,74 @@ void ConfigurationFile::setRequestedSection
 	char requestedSection[]
 )
 {
-	strcpy(_requestedSection,requestedSection);
+	globalsOnly = (requestedSection==0);
+	strncpy(_requestedSection,(globalsOnly ? "" : requestedSection),CFGFILE_SECTION_SIZE-1);
+	_requestedSection[CFGFILE_SECTION_SIZE-1] = '\0';
 	LOGGER_LOG_DEBUG1("setRequestedSection '%s'",_requestedSection)
+	rewind();
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationFile::getSectionCount
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : get the number of (distinct) sections in the file
+//
+// RETURNS         : number of sections
+//
+// ============================================================================
+int ConfigurationFile::getSectionCount() const
+{
+	return sections.size();
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationFile::getSectionName
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : get the name of a section
+//
+// ARGUMENTS       : section IN  index of the section (in the order they first
+//                               appear in the file)
+//                   length  OUT length of the name
+//
+// RETURNS         : the name (not NUL-terminated)
+//
+// ============================================================================
+const char *ConfigurationFile::getSectionName
+(
+	int  section,
+	int &length
+) const
+{
+	length = sections[section].nameLength;
+	return sections[section].name;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationFile::hasSection
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : does the file contain the named section?
+//
+// ARGUMENTS       : section IN section name
+//
+// RETURNS         : true if it does
+//
+// ============================================================================
+bool ConfigurationFile::hasSection
+(
+	const char *section
+) const
+{
+	int length = strlen(section);
+	return (findSection(section,length,hashName(section,length))>=0);
 }
 
 // ============================================================================
@@ -220,10 +395,20 @@ void ConfigurationFile::setRequestedSection
 // ============================================================================
 ConfigurationFile::ConfigurationFile()
 {
-	_requestedSection[0] = '\0';
-	configFile           = 0;
-	_commentCharacters   = new char[strlen(CFGFILE_DEFAULT_COMMENT_CHARACTERS)+1];
+	_requestedSection[0]  = '\0';
+	_commentCharacters    = new char[strlen(CFGFILE_DEFAULT_COMMENT_CHARACTERS)+1];
 	strcpy(_commentCharacters,CFGFILE_DEFAULT_COMMENT_CHARACTERS);
+
+	fileHandle            = INVALID_HANDLE_VALUE;
+	mappingHandle         = NULL;
+	fileData              = 0;
+	fileSize              = 0;
+	firstGlobal           = -1;
+	lastGlobal            = -1;
+	requestedSectionIndex = -1;
+	nextEntry             = 0;
+	inGlobals             = false;
+	globalsOnly           = false;
 }
 
 // ============================================================================
@@ -241,61 +426,236 @@ ConfigurationFile::~ConfigurationFile()
 	{
 		delete [] _commentCharacters;
 	}
-	if(configFile != 0)
-	{
-		if(configFile->is_open()!=0)
-		{
-			configFile->close();
-		}
-		delete configFile;
-	}
+	closeConfigurationFile();
 }
 
 // ============================================================================
 //
-// MEMBER FUNCTION : ConfigurationFile::readNextRealLine
+// PRIVATE MEMBER FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationFile::buildIndex
 //
 // ACCESS SPECIFIER: private
 //
-// DESCRIPTION     : read next line from input file which is not blank or a comment
+// DESCRIPTION     : index the mapped file in a single pass
 //
-// RETURNS         : pointer to line read
+//                   Blank lines and comments are skipped.  A section which
+//                   appears more than once is treated as a single section.
 //
 // ============================================================================
-char *ConfigurationFile::readNextRealLine()
+void ConfigurationFile::buildIndex()
 {
+	const char *ch  = fileData;
+	const char *end = fileData+fileSize;
+	int         section = -1;
+
+	entries.clear();
+	sections.clear();
+	buckets.assign(16,-1);
+	firstGlobal = lastGlobal = -1;
 
-	while(!configFile->eof())
+	while(ch<end)
 	{
-		// remove any leading spaces or tabs
-		configFile->getline(configLine,CFGFILE_MAX_LINE_LENGTH);
+		// find the end of the line
+		const char *line = ch;
+		const char *eol  = (const char *)memchr(ch,'\n',end-ch);
+		if(eol==0) { eol = end; }
+		ch = eol+1;
+		if((eol>line)&&(eol[-1]=='\r')) { eol--; }
+		int length = eol-line;
 
 		// is it a blank line?
-		if(configLine[0]=='\0')
+		int blanks = 0;
+		while((blanks<length)&&(strchr(CFGFILE_BLANKS,line[blanks])!=0)) { blanks++; }
+		if(blanks==length)
 		{
-			// LOGGER_LOG_DEBUG("blank line")
 			continue;
 		}
 
-		if (all_of(begin(configLine), end(configLine), [](char c) {return iswspace(c); }))
+		// is it a comment?
+		if(strchr(_commentCharacters,line[0])!=0)
+		{
 			continue;
+		}
 
-		// is it a comment?
-		if(strchr(_commentCharacters,configLine[0])!=0)
+		if(line[0]!=CFGFILE_SECTION_OPEN)
 		{
-			// LOGGER_LOG_DEBUG1("comment line '%s'",configLine)
+			addEntry(section,line,length);
 			continue;
 		}
 
-		// non-blank line - return the line
-		// LOGGER_LOG_DEBUG1("non-blank line '%s'",configLine)
-		return configLine;
+		// new section
+		const char *name  = line+1;
+		const char *close = (const char *)memchr(name,CFGFILE_SECTION_CLOSE,eol-name);
+		int nameLength    = (close==0 ? eol : close)-name;
+		unsigned long hash = hashName(name,nameLength);
+
+		section = findSection(name,nameLength,hash);
+		if(section<0)
+		{
+			// grow the hash table to keep the chains short
+			if(sections.size()>=buckets.size())
+			{
+				buckets.assign(buckets.size()*2,-1);
+				for(int i=0; i<(int)sections.size(); i++)
+				{
+					int bucket = sections[i].hash&(buckets.size()-1);
+					sections[i].nextInBucket = buckets[bucket];
+					buckets[bucket] = i;
+				}
+			}
+
+			Section s;
+			s.name         = name;
+			s.nameLength   = nameLength;
+			s.hash         = hash;
+			s.first        = -1;
+			s.last         = -1;
+			int bucket     = hash&(buckets.size()-1);
+			s.nextInBucket = buckets[bucket];
+			section        = sections.size();
+			buckets[bucket] = section;
+			sections.push_back(s);
+		}
+	}
+	LOGGER_LOG_DEBUG2("indexed %d directives in %d sections",(int)entries.size(),(int)sections.size())
+
+	// start again
+	rewind();
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationFile::addEntry
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : add a directive / value line to the index
+//
+// ARGUMENTS       : section IN index of its section (-1 if none)
+//                   line    IN the line
+//                   length  IN length of the line
+//
+// ============================================================================
+void ConfigurationFile::addEntry
+(
+	int         section,
+	const char *line,
+	int         length
+)
+{
+	Entry e;
+
+	// the directive is everything before the =, and the value everything after
+	const char *equals = (const char *)memchr(line,'=',length);
+	e.directive.name        = line;
+	e.directive.nameLength  = (equals==0 ? length : equals-line);
+	e.directive.value       = (equals==0 ? line+length : equals+1);
+	e.directive.valueLength = (line+length)-e.directive.value;
+	e.next                  = -1;
 
+	// chain it to the others in its section
+	int  index = entries.size();
+	int &first = (section<0 ? firstGlobal : sections[section].first);
+	int &last  = (section<0 ? lastGlobal  : sections[section].last);
+	if(last<0) { first = index; } else { entries[last].next = index; }
+	last = index;
+
+	entries.push_back(e);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationFile::findSection
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : look up a section in the index
+//
+// ARGUMENTS       : name   IN section name (not NUL-terminated)
+//                   length IN length of name
+//                   hash   IN hash of name
+//
+// RETURNS         : index of the section, or -1 if it is not present
+//
+// ============================================================================
+int ConfigurationFile::findSection
+(
+	const char   *name,
+	int           length,
+	unsigned long hash
+) const
+{
+	if(buckets.empty())
+	{
+		return -1;
 	}
+	for(int i=buckets[hash&(buckets.size()-1)]; i>=0; i=sections[i].nextInBucket)
+	{
+		const Section &s = sections[i];
+		if((s.hash==hash)&&(s.nameLength==length)&&(memcmp(s.name,name,length)==0))
+		{
+			return i;
+		}
+	}
+	return -1;
+}
 
-	// end of file reached
-	configLine[0] = '\0';
-	// LOGGER_LOG_DEBUG("end of file reached")
-	return configLine;
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationFile::rewind
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : look up the requested section, and go back to the first
+//                   directive to be returned
+//
+// ============================================================================
+void ConfigurationFile::rewind()
+{
+	int length = strlen(_requestedSection);
+	requestedSectionIndex = (globalsOnly ? -1 : findSection(_requestedSection,length,hashName(_requestedSection,length)));
+	inGlobals             = (globalsOnly||(_requestedSection[0]!='\0'));
+	nextEntry             = (inGlobals ? firstGlobal : 0);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationFile::closeConfigurationFile
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : unmap and close the file, and discard the index
+//
+// ============================================================================
+void ConfigurationFile::closeConfigurationFile()
+{
+	entries.clear();
+	sections.clear();
+	buckets.clear();
+	firstGlobal = lastGlobal = -1;
+	requestedSectionIndex = -1;
+	nextEntry   = 0;
+	inGlobals   = false;
 
+	if(fileData!=0)
+	{
+		UnmapViewOfFile(fileData);
+		fileData = 0;
+	}
+	if(mappingHandle!=NULL)
+	{
+		CloseHandle(mappingHandle);
+		mappingHandle = NULL;
+	}
+	if(fileHandle!=INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(fileHandle);
+		fileHandle = INVALID_HANDLE_VALUE;
+	}
+	fileSize = 0;
 }
@@ -34,7 +34,10 @@
 #pragma once
 #endif // _MSC_VER > 1000
 
-#include <fstream>
+// system headers
+#define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
+#include <windows.h>
+#include <vector>
 using namespace std;
 // ============================================================================
 //
@@ -43,12 +46,29 @@ using namespace std;
 // ============================================================================
 
 const int  CFGFILE_SECTION_SIZE                 = 128;
-const int  CFGFILE_MAX_LINE_LENGTH              = 5000;
 const char CFGFILE_DEFAULT_COMMENT_CHARACTERS[] = "#;";
 const char CFGFILE_SECTION_OPEN                 = '[';
 const char CFGFILE_SECTION_CLOSE                = ']';
-const char CFGFILE_BLANKS[]                     = "		"; // space or tab
+const char CFGFILE_BLANKS[]                     = " \t"; // space or tab
 
+//
+// a directive / value pair:  both point into the mapped file, so they
+//  are not NUL-terminated and are only valid while the file is open
+//
+struct ConfigurationDirective
+{
+	const char *name;
+	int         nameLength;
+	const char *value;
+	int         valueLength;
+} ;
+
+//
+// The file is mapped into memory and indexed in a single pass when it is
+//  opened:  each section's directives are chained together, and sections
+//  are found through a hash table, so selecting a section does not scan
+//  the file again.
+//
 class ConfigurationFile  
 {
 public:
@@ -56,10 +76,20 @@ public:
 	// open configuration file
 	bool openConfigurationFile(char configPath[]);
 
-	// set requested section
+	// set requested section (and start again from its first directive)
 	void setRequestedSection(char requestedSection[]);
 
-	// get next configuration directive
+	// does the file contain the named section?
+	bool hasSection(const char *section) const;
+
+	// sections in the file
+	int         getSectionCount() const;
+	const char *getSectionName(int section,int &length) const;
+
+	// get next configuration directive (false if no more directives)
+	bool getNextConfigurationDirective(ConfigurationDirective &directive);
+
+	// get next configuration directive, copied into the buffers
 	void getNextConfigurationDirective(char directive[],char value[]);
 
 	// which characters are used for comments
@@ -70,15 +100,56 @@ public:
 	virtual ~ConfigurationFile();
 
 private:
+	// indexed directive
+	struct Entry
+	{
+		ConfigurationDirective directive;
+		int                    next;		// next in the same section
+	} ;
+
+	// indexed section
+	struct Section
+	{
+		const char   *name;
+		int           nameLength;
+		unsigned long hash;
+		int           first,last;			// its directives
+		int           nextInBucket;
+	} ;
+
 	// service functions
-	char *readNextRealLine();
+	void  buildIndex();
+	void  addEntry(int section,const char *line,int length);
+	int   findSection(const char *name,int length,unsigned long hash) const;
+	void  rewind();
+	void  closeConfigurationFile();
+
+	// no copying
+	ConfigurationFile(const ConfigurationFile &);
+	ConfigurationFile &operator=(const ConfigurationFile &);
 
 	// private variables
 	char      _requestedSection[CFGFILE_SECTION_SIZE];
-	ifstream *configFile;
-	char      configLine[CFGFILE_MAX_LINE_LENGTH];
 	char     *_commentCharacters;
 
+	// the mapped file
+	HANDLE      fileHandle;
+	HANDLE      mappingHandle;
+	const char *fileData;
+	DWORD       fileSize;
+
+	// the index
+	vector<Entry>   entries;
+	vector<Section> sections;
+	vector<int>     buckets;
+	int             firstGlobal,lastGlobal;	// directives before any section
+
+	// iteration state
+	int  requestedSectionIndex;			// -1 if the section is not present
+	int  nextEntry;
+	bool inGlobals;
+	bool globalsOnly;					// no section requested
+
 };
 
 #endif // !defined(__CONFIGURATION_FILE_H__)
@@ -0,0 +1,418 @@
+// ============================================================================
+//
+// FILE        : ConfigurationReloader.cpp
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : implementation of ConfigurationReloader class
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master source file exe.cpp for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// system headers
+#include <stdlib.h>
+#include <string.h>
+
+// support headers
+#include <logger.h>
+
+// class headers
+#include "ConfigurationReloader.h"
+#include "CompiledConfiguration.h"
+
+// ============================================================================
+//
+// PUBLIC MEMBER FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationReloader::load
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : read a service's definition from a configuration file,
+//                   apply it, and watch the file for changes
+//
+//                   Only one configuration file can be watched:  if a second
+//                   one is loaded, the service will not be reloaded at all.
+//
+// ARGUMENTS       : cmdRunner  IN CmdRunner object to apply the definition to
+//                   configFile IN name of configuration file
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+void ConfigurationReloader::load
+(
+	CmdRunner *cmdRunner,
+	char       configFile[]
+) throw(SrvStartException)
+{
+	// read it, and take the appropriate action for each directive
+	read(cmdRunner->getSrvName(),configFile,*current);
+	current->apply(cmdRunner);
+
+	// more than one configuration file?
+	if(this->configFile!=0)
+	{
+		LOGGER_LOG_INFO1("more than one configuration file - changes to '%s' will not be reloaded",
+			this->configFile)
+		cmdRunner->setReloadCallback(0,0);
+		return;
+	}
+
+	// the files to watch
+	this->configFile = arena.copy(configFile);
+	imagePath = arena.append(arena.copy(configFile),COMPILED_CONFIGURATION_SUFFIX);
+	getFileStamps(fileTimes,fileSizes);
+
+	// watch the directory which holds them (if we can't, the files are
+	//  checked each time the service is polled instead)
+	char *directory = arena.copy(configFile);
+	char *slash     = strrchr(directory,'\\');
+	if(strrchr(directory,'/')>slash) { slash = strrchr(directory,'/'); }
+	if(slash==0)              { directory = arena.copy("."); }
+	else if(slash==directory) { slash[1] = '\0'; }
+	else                      { slash[0] = '\0'; }
+	changeHandle = FindFirstChangeNotification(directory,FALSE,
+		FILE_NOTIFY_CHANGE_FILE_NAME|FILE_NOTIFY_CHANGE_SIZE|FILE_NOTIFY_CHANGE_LAST_WRITE);
+	if(changeHandle==INVALID_HANDLE_VALUE)
+	{
+		LOGGER_LOG_DEBUG2("unable to watch directory '%s', error=%d",directory,GetLastError())
+	}
+
+	LOGGER_LOG_DEBUG1("watching configuration file '%s'",configFile)
+	cmdRunner->setReloadCallback(reloadCallbackFunction,this);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationReloader::read
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : read a service's definition from a configuration file
+//
+//                   If the file has been compiled (see CompiledConfiguration)
+//                   and has not changed since, the definition is taken from
+//                   the compiled image instead.
+//
+// ARGUMENTS       : service    IN  service name
+//                   configFile IN  name of configuration file
+//                   definition OUT the service's definition
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+void ConfigurationReloader::read
+(
+	char              *service,
+	char               configFile[],
+	ServiceDefinition &definition
+) throw(SrvStartException)
+{
+	CompiledConfiguration compiled;
+	StringArena           arena;
+
+	// is there an up-to-date compiled image?
+	char *imagePath = arena.append(arena.copy(configFile),COMPILED_CONFIGURATION_SUFFIX);
+	if(compiled.open(imagePath,configFile)&&compiled.find(service,definition))
+	{
+		LOGGER_LOG_DEBUG1("using compiled configuration '%s'",imagePath)
+		return;
+	}
+
+	ConfigurationFile cf;
+
+	// open the configuration file
+	LOGGER_LOG_DEBUG1("about to open configuration file '%s'",configFile)
+	if(!cf.openConfigurationFile(configFile))
+	{
+		LOGGER_LOG_ERROR1("failed to open configuration file '%s'",configFile)
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ConfigurationReloader","read")
+	}
+
+	// set the name of the section we are interested in
+	cf.setRequestedSection(service);
+	LOGGER_LOG_DEBUG1("requested section is '%s'",service)
+
+	// read and validate the configuration file directives
+	definition.parse(cf);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationReloader::reloadCallbackFunction
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : this function is called by the CmdRunner while the service
+//                   is running (see CmdRunner::setReloadCallback)
+//
+// ARGUMENTS       : cmdRunner      IN CmdRunner object running the service
+//                   restarting     IN true once the command has been stopped
+//                                     to pick up the new definition
+//                   genericPointer IN generic pointer
+//
+// RETURNS         : RELOAD_NOTHING, RELOAD_APPLIED or RELOAD_RESTART
+//
+// ============================================================================
+CmdRunner::RELOAD_ACTIONS ConfigurationReloader::reloadCallbackFunction
+(
+	CmdRunner *cmdRunner,
+	bool       restarting,
+	void      *genericPointer
+)
+{
+	// pointer should point to this object
+	if(genericPointer==0)
+	{
+		LOGGER_LOG_ERROR("reloadCallbackFunction() has been invoked with NULL pointer")
+		return CmdRunner::RELOAD_NOTHING;
+	}
+	ConfigurationReloader *thisObject = static_cast<ConfigurationReloader*>(genericPointer);
+
+	if(restarting)
+	{
+		thisObject->restart(cmdRunner);
+		return CmdRunner::RELOAD_APPLIED;
+	}
+	return thisObject->reload(cmdRunner);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationReloader::ConfigurationReloader
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : constructor
+//
+// ============================================================================
+ConfigurationReloader::ConfigurationReloader()
+{
+	configFile   = 0;
+	imagePath    = 0;
+	changeHandle = INVALID_HANDLE_VALUE;
+	memset(fileTimes,0,sizeof(fileTimes));
+	memset(fileSizes,0,sizeof(fileSizes));
+	current      = &definitions[0];
+	pending      = &definitions[1];
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationReloader::~ConfigurationReloader
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : destructor
+//
+// ============================================================================
+ConfigurationReloader::~ConfigurationReloader()
+{
+	if(changeHandle!=INVALID_HANDLE_VALUE)
+	{
+		FindCloseChangeNotification(changeHandle);
+	}
+}
+
+// ============================================================================
+//
+// PRIVATE MEMBER FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationReloader::reload
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : if the configuration file has changed (or a reload has
+//                   been asked for), read the service's definition again and
+//                   apply any live changes
+//
+// ARGUMENTS       : cmdRunner IN CmdRunner object running the service
+//
+// RETURNS         : RELOAD_NOTHING if nothing has changed (or the file is not
+//                   valid), RELOAD_APPLIED if the changes have been applied,
+//                   RELOAD_RESTART if the command must be restarted
+//
+// ============================================================================
+CmdRunner::RELOAD_ACTIONS ConfigurationReloader::reload
+(
+	CmdRunner *cmdRunner
+)
+{
+	ServiceDefinition *swap;
+
+	if((!hasChanged())&&(!cmdRunner->isReloadRequested()))
+	{
+		return CmdRunner::RELOAD_NOTHING;
+	}
+
+	// read the service's definition again
+	LOGGER_LOG_INFO1("reading configuration file '%s' again",configFile)
+	try
+	{
+		read(cmdRunner->getSrvName(),configFile,*pending);
+	}
+	catch(SrvStartException e)
+	{
+		LOGGER_LOG_ERROR2("configuration file '%s' is not valid (%s) - service is unchanged",
+			configFile,e.errorMessage)
+		return CmdRunner::RELOAD_NOTHING;
+	}
+
+	// what has changed?
+	switch(pending->compare(*current))
+	{
+		case ServiceDefinition::DEFINITION_UNCHANGED:
+			LOGGER_LOG_INFO1("configuration of service '%s' has not changed",cmdRunner->getSrvName())
+			return CmdRunner::RELOAD_NOTHING;
+
+		case ServiceDefinition::DEFINITION_CHANGED_LIVE:
+			LOGGER_LOG_INFO1("applying new configuration of service '%s' without a restart",
+				cmdRunner->getSrvName())
+			try
+			{
+				pending->applyChanges(cmdRunner,*current,false);
+			}
+			catch(SrvStartException e)
+			{
+				LOGGER_LOG_ERROR2("failed to apply new configuration of service '%s' (%s)",
+					cmdRunner->getSrvName(),e.errorMessage)
+			}
+			swap = current; current = pending; pending = swap;
+			return CmdRunner::RELOAD_APPLIED;
+
+		default:
+			LOGGER_LOG_INFO1("new configuration of service '%s' needs a restart",cmdRunner->getSrvName())
+			return CmdRunner::RELOAD_RESTART;
+	}
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationReloader::restart
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : apply every change to the service's definition, once its
+//                   command has been stopped
+//
+// ARGUMENTS       : cmdRunner IN CmdRunner object running the service
+//
+// ============================================================================
+void ConfigurationReloader::restart
+(
+	CmdRunner *cmdRunner
+)
+{
+	try
+	{
+		pending->applyChanges(cmdRunner,*current,true);
+	}
+	catch(SrvStartException e)
+	{
+		LOGGER_LOG_ERROR2("failed to apply new configuration of service '%s' (%s)",
+			cmdRunner->getSrvName(),e.errorMessage)
+	}
+
+	ServiceDefinition *swap = current;
+	current = pending;
+	pending = swap;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationReloader::hasChanged
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : has the configuration file (or its compiled image) been
+//                   written since it was last read?
+//
+// RETURNS         : true if it has
+//
+// ============================================================================
+bool ConfigurationReloader::hasChanged()
+{
+	// only look at the files if something in their directory has changed
+	if(changeHandle!=INVALID_HANDLE_VALUE)
+	{
+		if(WaitForSingleObject(changeHandle,0)!=WAIT_OBJECT_0)
+		{
+			return false;
+		}
+		FindNextChangeNotification(changeHandle);
+	}
+
+	FILETIME times[2];
+	DWORD    sizes[2];
+	getFileStamps(times,sizes);
+	if((memcmp(times,fileTimes,sizeof(times))==0)&&(memcmp(sizes,fileSizes,sizeof(sizes))==0))
+	{
+		return false;
+	}
+	memcpy(fileTimes,times,sizeof(times));
+	memcpy(fileSizes,sizes,sizeof(sizes));
+	return true;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ConfigurationReloader::getFileStamps
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : get the modification time and size of the configuration
+//                   file and its compiled image (zero if it does not exist)
+//
+// ARGUMENTS       : stamps OUT modification times
+//                   sizes  OUT sizes
+//
+// ============================================================================
+void ConfigurationReloader::getFileStamps
+(
+	FILETIME stamps[2],
+	DWORD    sizes[2]
+) const
+{
+	const char *paths[2] = { configFile, imagePath };
+
+	for(int i=0; i<2; i++)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		memset(&attributes,0,sizeof(attributes));
+		(void)GetFileAttributesEx(paths[i],GetFileExInfoStandard,&attributes);
+		stamps[i] = attributes.ftLastWriteTime;
+		sizes[i]  = attributes.nFileSizeLow;
+	}
+}
@@ -0,0 +1,106 @@
+// ============================================================================
+//
+// FILE        : ConfigurationReloader.h
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : interface definition for ConfigurationReloader class
+//
+//               A ConfigurationReloader loads a service's definition from its
+//               configuration file (or the compiled image of it), and then
+//               watches the file while the service is running.  When it
+//               changes, the service's section is read again and compared with
+//               the definition in use:
+//
+//                - if it has not changed, nothing is done (so editing another
+//                  service's section does not affect this one)
+//                - if only logging or restart policy directives have changed,
+//                  they are applied without touching the command
+//                - otherwise the command is stopped and started again with
+//                  the new settings (the service itself keeps running)
+//
+//               If the changed file is not valid, it is ignored and the service
+//               carries on with the definition it has.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master source file exe.cpp for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// prevent multiple inclusion
+
+#if !defined(__CONFIGURATION_RELOADER_H__)
+#define __CONFIGURATION_RELOADER_H__
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+// class headers
+#include "ServiceDefinition.h"
+
+// ============================================================================
+//
+// ConfigurationReloader class
+//
+// ============================================================================
+class ConfigurationReloader
+{
+public:
+
+	// load and apply a service's definition, and watch for changes to it
+	void load(CmdRunner *cmdRunner,char configFile[]) throw(SrvStartException);
+
+	// read a service's definition (from the compiled image if it is up to date)
+	static void read(char *service,char configFile[],ServiceDefinition &definition)
+		throw(SrvStartException);
+
+	// CmdRunner reload callback
+	static CmdRunner::RELOAD_ACTIONS reloadCallbackFunction(CmdRunner *cmdRunner,
+		bool restarting,void *genericPointer);
+
+	// constructor and destructor
+	ConfigurationReloader();
+	virtual ~ConfigurationReloader();
+
+private:
+	// service functions
+	CmdRunner::RELOAD_ACTIONS reload(CmdRunner *cmdRunner);
+	void restart(CmdRunner *cmdRunner);
+	bool hasChanged();
+	void getFileStamps(FILETIME stamps[2],DWORD sizes[2]) const;
+
+	// no copying
+	ConfigurationReloader(const ConfigurationReloader &);
+	ConfigurationReloader &operator=(const ConfigurationReloader &);
+
+	// files watched
+	StringArena arena;
+	char       *configFile;
+	char       *imagePath;
+	HANDLE      changeHandle;
+	FILETIME    fileTimes[2];
+	DWORD       fileSizes[2];
+
+	// definition in use, and the new one (waiting for a restart)
+	ServiceDefinition  definitions[2];
+	ServiceDefinition *current;
+	ServiceDefinition *pending;
+
+};
+
+#endif // !defined(__CONFIGURATION_RELOADER_H__)
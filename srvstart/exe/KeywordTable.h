@@ -0,0 +1,177 @@
+// ============================================================================
+//
+// FILE        : KeywordTable.h
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : interface definition for KeywordTable class
+//
+//               A KeywordTable maps a fixed set of keywords (eg configuration
+//               file directives) to integer identifiers.  A perfect hash for
+//               the keywords is found when the program is compiled, so a
+//               lookup costs one hash and one string compare, and the
+//               keywords may be listed in any order.  A table for which no
+//               perfect hash can be found (eg because it contains the same
+//               keyword twice) fails the static_assert which accompanies it.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master source file exe.cpp for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// prevent multiple inclusion
+
+#if !defined(__KEYWORD_TABLE_H__)
+#define __KEYWORD_TABLE_H__
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+// system headers
+#include <string.h>
+
+// ============================================================================
+//
+// CONSTANT DEFINITIONS
+//
+// ============================================================================
+
+// identifier returned for an unknown keyword
+const int KEYWORD_NOT_FOUND = -1;
+
+// number of hash seeds tried before giving up
+const unsigned long KEYWORD_MAX_SEEDS = 1024;
+
+// ============================================================================
+//
+// TYPE DEFINITIONS
+//
+// ============================================================================
+
+//
+// a keyword and its identifier
+//
+struct Keyword
+{
+	const char *name;
+	int         id;
+} ;
+
+// ============================================================================
+//
+// LOCAL FUNCTIONS
+//
+// ============================================================================
+
+//
+// hash a keyword (FNV-1a, perturbed by a seed)
+//
+constexpr unsigned long keywordHash(unsigned long seed,const char *name,int length)
+{
+	unsigned long hash = 2166136261UL^seed;
+	for(int i=0; i<length; i++)
+	{
+		hash ^= (unsigned char)name[i];
+		hash  = (hash*16777619UL)&0xffffffffUL;
+	}
+	return hash;
+}
+
+//
+// length of a keyword
+//
+constexpr int keywordLength(const char *name)
+{
+	int length = 0;
+	while(name[length]!='\0') { length++; }
+	return length;
+}
+
+// ============================================================================
+//
+// KeywordTable class
+//
+//  N     is the number of keywords
+//  SLOTS is the size of the hash table (a power of two - the more slots,
+//        the sooner a perfect hash is found)
+//
+// ============================================================================
+template<int N,int SLOTS>
+class KeywordTable
+{
+public:
+	// build the table, searching for a seed which gives a perfect hash
+	constexpr KeywordTable(const Keyword (&table)[N])
+		: keywords(table), seed(0), perfect(false), slots{}
+	{
+		static_assert((SLOTS&(SLOTS-1))==0,"keyword table size must be a power of two");
+		static_assert(SLOTS>=N,"keyword table is too small");
+
+		for(unsigned long s=0; (s<KEYWORD_MAX_SEEDS)&&(!perfect); s++)
+		{
+			perfect = true;
+			seed    = s;
+			for(int i=0; i<SLOTS; i++) { slots[i] = KEYWORD_NOT_FOUND; }
+			for(int i=0; (i<N)&&perfect; i++)
+			{
+				int slot = (int)(keywordHash(s,table[i].name,keywordLength(table[i].name))&(SLOTS-1));
+				if(slots[slot]!=KEYWORD_NOT_FOUND) { perfect = false; }
+				else                               { slots[slot] = i; }
+			}
+		}
+	}
+
+	// was a perfect hash found?
+	constexpr bool isPerfect() const { return perfect; }
+
+	// look up a keyword (KEYWORD_NOT_FOUND if it is not in the table)
+	int find(const char *name,int length) const
+	{
+		int i = slots[keywordHash(seed,name,length)&(SLOTS-1)];
+		if((i==KEYWORD_NOT_FOUND)
+			||((int)strlen(keywords[i].name)!=length)
+			||(memcmp(keywords[i].name,name,length)!=0))
+		{
+			return KEYWORD_NOT_FOUND;
+		}
+		return keywords[i].id;
+	}
+
+	int find(const char *name) const
+	{
+		return find(name,(int)strlen(name));
+	}
+
+private:
+	const Keyword *keywords;
+	unsigned long  seed;
+	bool           perfect;
+	int            slots[SLOTS];
+
+};
+
+//
+// make a table (so that the number of keywords need not be given)
+//
+template<int SLOTS,int N>
+constexpr KeywordTable<N,SLOTS> makeKeywordTable(const Keyword (&table)[N])
+{
+	return KeywordTable<N,SLOTS>(table);
+}
+
+#endif // !defined(__KEYWORD_TABLE_H__)
@@ -0,0 +1,1025 @@
+// ============================================================================
+//
+// FILE        : ServiceDefinition.cpp
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : implementation of ServiceDefinition class
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master source file exe.cpp for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// ============================================================================
+//
+// PROJECT HEADER FILES
+//
+// ============================================================================
+
+// system headers
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// support headers
+#include <logger.h>
+
+// class headers
+#include "ServiceDefinition.h"
+#include "Validation.h"
+#include "../dll/StringSubstituter.h"
+
+// ============================================================================
+//
+// LOCAL FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : configureLogger
+//
+// DESCRIPTION     : configure the default logger
+//
+// ARGUMENTS       : destination IN LOGGER_ destination
+//                   info        IN destination information
+//                   option      IN destination option
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+static void configureLogger
+(
+	int   destination,
+	char *info,
+	void *option
+) throw(SrvStartException)
+{
+	int loggerError;
+	if(LoggerConfigure(LOGGER_DEFAULT_LOGGER,"",const_cast<char*>(APPLICATION),
+							destination,info,option,&loggerError,0)==0)
+	{
+		LOGGER_LOG_ERROR1("Logger initialisation failed, error = %d",loggerError)
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_GENERAL_ERROR,"ServiceDefinition","apply")
+	}
+}
+
+// ============================================================================
+//
+// LOCAL FUNCTION  : loggerControl
+//
+// DESCRIPTION     : apply a logger control command
+//
+// ARGUMENTS       : command IN command keyword (eg "batch")
+//                   value   IN its arguments
+//                   what    IN description for the error message
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+static void loggerControl
+(
+	const char *command,
+	const char *value,
+	const char *what
+) throw(SrvStartException)
+{
+	StringArena arena;
+	char        reply[1000];
+	char       *line = arena.copy(command);
+	line = arena.append(line,value,true);
+	if(!LoggerControl(line,reply,sizeof(reply)))
+	{
+		LOGGER_LOG_ERROR3("Invalid %s %s (%s)",what,value,reply)
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ServiceDefinition","apply")
+	}
+}
+
+// ============================================================================
+//
+// PUBLIC MEMBER FUNCTIONS
+//
+// ============================================================================
+
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceDefinition::parse
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : build the definition from the directives in the requested
+//                   section of a configuration file (replacing any settings
+//                   it already holds)
+//
+//                   Nothing is applied yet, apart from raising the debug level
+//                   if the debug directive is invalid.
+//
+// ARGUMENTS       : cf IN open configuration file
+//
+// THROWS          : SrvStartException if a directive is invalid
+//
+// ============================================================================
+void ServiceDefinition::parse
+(
+	ConfigurationFile &cf
+) throw(SrvStartException)
+{
+	ConfigurationDirective next;
+	Validation             v;
+	bool                   libDirSet=false,pathSet=false;
+	int                    id;
+
+	clear();
+
+	while(cf.getNextConfigurationDirective(next))
+	{
+		// the value points into the file - copy it
+		char *value = arena.allocate(next.valueLength);
+		memcpy(value,next.value,next.valueLength);
+		value[next.valueLength] = '\0';
+
+		// look up directive in directive list
+		int directive = directiveTable.find(next.name,next.nameLength);
+		LOGGER_LOG_DEBUG3("next directive '%.*s' (%d)",next.nameLength,next.name,directive)
+
+		switch(directive)
+		{
+			case W_AUTO_RESTART:
+			case W_MINIMISED:
+			case W_NEW_WINDOW:
+				// yes / no
+				storeSetting(directive,v.isLikeYes(value),0,value);
+				break;
+
+			case W_DEBUG:
+			case W_LOG_COALESCE:
+			case W_PRESHUTDOWN_TIMEOUT:
+			case W_RESTART_INTERVAL:
+			case W_STARTUP_DELAY:
+			case W_WAIT_TIME:
+				// integer
+				if(!v.isInteger(value))
+				{
+					if(directive==W_DEBUG)
+					{
+						// bad debug level supplied
+						LoggerSetDebugLevel(2);
+					}
+					LOGGER_LOG_ERROR3("Invalid %.*s %s",next.nameLength,next.name,value)
+					THROW_SRVSTART_EXCEPTION
+						(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ServiceDefinition","parse")
+				}
+				storeSetting(directive,atoi(value),0,value);
+				break;
+
+			case W_METRICS_PORT:
+				// TCP port (0 for none)
+				if((!v.isInteger(value))||(atoi(value)<0)||(atoi(value)>65535))
+				{
+					LOGGER_LOG_ERROR3("Invalid %.*s %s",next.nameLength,next.name,value)
+					THROW_SRVSTART_EXCEPTION
+						(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ServiceDefinition","parse")
+				}
+				storeSetting(directive,atoi(value),0,value);
+				break;
+
+			case W_CONTINUE:
+			case W_DEBUG_OUT:
+			case W_LOG_BATCH:
+			case W_LOG_CONTROL:
+			case W_LOG_LIMIT:
+			case W_PAUSE:
+			case W_SHUTDOWN:
+			case W_STARTUP:
+			case W_STARTUP_DIR:
+			case W_WAIT:
+				// text
+				storeSetting(directive,0,0,value);
+				break;
+
+			case W_ENV:
+			case W_LOCAL_DRIVE:
+			case W_NET_DRIVE:
+				// name=value
+				{
+					char *equals = strchr(value,'=');
+					if((equals==0)||(equals==value))
+					{
+						LOGGER_LOG_ERROR3("missing = in %.*s directive '%s'",next.nameLength,next.name,value)
+						THROW_SRVSTART_EXCEPTION
+							(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ServiceDefinition","parse")
+					}
+					(*equals) = '\0';
+
+					if(directive==W_ENV)
+					{
+						addEnvSetting(value,equals+1);
+					}
+					else
+					{
+						// drive letter
+						char *driveLetter = value;
+						while((*driveLetter)==' ') { driveLetter++; }
+						storeSetting(directive,*driveLetter,0,equals+1);
+					}
+				}
+				break;
+
+			case W_LIB:
+				// value of %LIB%
+				addEnvSetting(LIBDIR_NAME,value);
+				libDirSet = true;
+				break;
+
+			case W_PATH:
+				// value of %PATH%
+				addEnvSetting(PATH_NAME,value);
+				pathSet = true;
+				break;
+
+			case W_PRIORITY:
+				// execution priority
+				id = priorityTable.find(value);
+				if(id==KEYWORD_NOT_FOUND)
+				{
+					LOGGER_LOG_ERROR1("Invalid execution priority %s",value)
+					THROW_SRVSTART_EXCEPTION
+						(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ServiceDefinition","parse")
+				}
+				storeSetting(directive,id,0,value);
+				break;
+
+			case W_PAUSE_METHOD:
+				// pause method
+				id = pauseMethodTable.find(value);
+				if(id==KEYWORD_NOT_FOUND)
+				{
+					LOGGER_LOG_ERROR1("Invalid pause method %s",value)
+					THROW_SRVSTART_EXCEPTION
+						(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ServiceDefinition","parse")
+				}
+				storeSetting(directive,id,0,value);
+				break;
+
+			case W_SHUTDOWN_METHOD:
+				// shutdown method
+				id = shutdownMethodTable.find(value);
+				if(id==KEYWORD_NOT_FOUND)
+				{
+					LOGGER_LOG_ERROR1("Invalid shutdown method %s",value)
+					THROW_SRVSTART_EXCEPTION
+						(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ServiceDefinition","parse")
+				}
+				storeSetting(directive,id,0,value);
+				break;
+
+			case W_SYBASE:
+				// value of %SYBASE%, and default %LIB% and %PATH%
+				addEnvSetting(SYBASE_NAME,value);
+				if(!libDirSet)
+				{
+					addEnvSetting(LIBDIR_NAME,getDefaultLibDir(value,arena));
+					libDirSet = true;
+				}
+				if(!pathSet)
+				{
+					addEnvSetting(PATH_NAME,getDefaultPath(value,arena));
+					pathSet = true;
+				}
+				break;
+
+			case W_SYBPATH:
+				// value of %PATH% based on %SYBASE%
+				addEnvSetting(PATH_NAME,getDefaultPath(value,arena));
+				pathSet = true;
+				break;
+
+			default:
+				LOGGER_LOG_ERROR3("Invalid directive '%.*s' = '%s'",next.nameLength,next.name,value)
+				THROW_SRVSTART_EXCEPTION
+					(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ServiceDefinition","parse")
+				break;
+		}
+	}
+	LOGGER_LOG_DEBUG1("service definition has %d settings",(int)settings.size())
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceDefinition::apply
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : apply the settings to a CmdRunner (and the logger), in the
+//                   order they appeared in the configuration file
+//
+// ARGUMENTS       : cmdRunner IN CmdRunner object to apply settings to
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+void ServiceDefinition::apply
+(
+	CmdRunner *cmdRunner
+) const throw(SrvStartException)
+{
+	for(int i=0; i<(int)settings.size(); i++)
+	{
+		applySetting(cmdRunner,settings[i]);
+	}
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceDefinition::compare
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : compare this definition with a previous one (of the same
+//                   service)
+//
+//                   Settings are compared directive by directive, in the order
+//                   they appeared, so moving an unrelated line is not a change.
+//
+// ARGUMENTS       : previous IN previous definition
+//
+// RETURNS         : DEFINITION_UNCHANGED       if they are the same
+//                   DEFINITION_CHANGED_LIVE    if only live directives differ
+//                   DEFINITION_CHANGED_RESTART if the command must be restarted
+//
+// ============================================================================
+ServiceDefinition::DEFINITION_CHANGES ServiceDefinition::compare
+(
+	const ServiceDefinition &previous
+) const
+{
+	DEFINITION_CHANGES changes = DEFINITION_UNCHANGED;
+
+	for(int directive=0; directive<DIRECTIVE_COUNT; directive++)
+	{
+		if(!sameSettings(previous,directive))
+		{
+			LOGGER_LOG_DEBUG1("directive %d has changed",directive)
+			if(!isLiveDirective(directive))
+			{
+				return DEFINITION_CHANGED_RESTART;
+			}
+			changes = DEFINITION_CHANGED_LIVE;
+		}
+	}
+	return changes;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceDefinition::applyChanges
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : apply the settings which differ from a previous
+//                   definition
+//
+//                   A live directive which has been removed goes back to its
+//                   default (the logging directives keep their current
+//                   setting).  Environment variables which have been removed
+//                   go back to their original values.  Any other directive
+//                   which has been removed keeps its current setting.
+//
+// ARGUMENTS       : cmdRunner  IN CmdRunner object to apply settings to
+//                   previous   IN definition which has been applied already
+//                   restarting IN if false, only live directives are applied
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+void ServiceDefinition::applyChanges
+(
+	CmdRunner               *cmdRunner,
+	const ServiceDefinition &previous,
+	bool                     restarting
+) const throw(SrvStartException)
+{
+	int i;
+
+	for(int directive=0; directive<DIRECTIVE_COUNT; directive++)
+	{
+		if(sameSettings(previous,directive)) { continue; }
+		if((!restarting)&&(!isLiveDirective(directive))) { continue; }
+
+		// variables which are no longer set
+		if(directive==W_ENV)
+		{
+			for(i=0; i<(int)previous.settings.size(); i++)
+			{
+				if(previous.settings[i].directive==W_ENV)
+				{
+					cmdRunner->removeEnv(previous.settings[i].name);
+				}
+			}
+		}
+
+		// the new settings
+		bool applied = false;
+		for(i=0; i<(int)settings.size(); i++)
+		{
+			if(settings[i].directive==directive)
+			{
+				applySetting(cmdRunner,settings[i]);
+				applied = true;
+			}
+		}
+		if(applied||(directive==W_ENV)) { continue; }
+
+		// the directive has been removed
+		switch(directive)
+		{
+			case W_AUTO_RESTART:		cmdRunner->setAutoRestart(false);			break;
+			case W_RESTART_INTERVAL:	cmdRunner->setAutoRestartInterval(0);		break;
+			case W_STARTUP_DELAY:		cmdRunner->setStartupDelay(0);				break;
+			case W_WAIT_TIME:			cmdRunner->setWaitInterval(1);				break;
+			default:
+				LOGGER_LOG_INFO1("directive %d has been removed - keeping its current setting",directive)
+				break;
+		}
+	}
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceDefinition::isLiveDirective
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : can a directive be changed while the command is running?
+//
+//                   Logging, restart policy and the preshutdown timeout can;
+//                   the environment, commands, directories, drives, priority,
+//                   window and pause method are only used when the command
+//                   starts.
+//
+// ARGUMENTS       : directive IN one of the DIRECTIVE_IDS
+//
+// RETURNS         : true if it can
+//
+// ============================================================================
+bool ServiceDefinition::isLiveDirective
+(
+	int directive
+)
+{
+	switch(directive)
+	{
+		case W_AUTO_RESTART:
+		case W_DEBUG:
+		case W_DEBUG_OUT:
+		case W_LOG_BATCH:
+		case W_LOG_COALESCE:
+		case W_LOG_CONTROL:
+		case W_LOG_LIMIT:
+		case W_PRESHUTDOWN_TIMEOUT:
+		case W_RESTART_INTERVAL:
+		case W_STARTUP_DELAY:
+		case W_WAIT_TIME:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceDefinition::addSetting
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : add a (resolved) setting
+//
+// ARGUMENTS       : directive IN one of the DIRECTIVE_IDS
+//                   number    IN converted value
+//                   name      IN variable name (may be NULL)
+//                   text      IN value
+//
+// ============================================================================
+void ServiceDefinition::addSetting
+(
+	int         directive,
+	int         number,
+	const char *name,
+	const char *text
+)
+{
+	storeSetting(directive,number,
+		(name==0 ? 0 : arena.copy(name)),
+		arena.copy(text==0 ? "" : text));
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceDefinition::clear
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : discard every setting
+//
+// ============================================================================
+void ServiceDefinition::clear()
+{
+	settings.clear();
+	arena.release();
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceDefinition::getSettingCount
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : get the number of settings
+//
+// RETURNS         : number of settings
+//
+// ============================================================================
+int ServiceDefinition::getSettingCount() const
+{
+	return settings.size();
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceDefinition::getSetting
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : get a setting
+//
+// ARGUMENTS       : setting IN index of the setting
+//
+// RETURNS         : the setting
+//
+// ============================================================================
+const ServiceSetting &ServiceDefinition::getSetting
+(
+	int setting
+) const
+{
+	return settings[setting];
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceDefinition::getDefaultLibDir
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : return default LIB directory based on given value of %SYBASE%
+//
+// ARGUMENTS       : sybase IN value of %SYBASE%
+//                   arena  IN arena to hold the result
+//
+// RETURNS         : default LIB directory
+//
+// ============================================================================
+char *ServiceDefinition::getDefaultLibDir
+(
+	const char  *sybase,
+	StringArena &arena
+)
+{
+	char *defaultLibDir = arena.allocate(strlen(sybase)+4);
+	sprintf(defaultLibDir,"%s\\lib",sybase);
+	LOGGER_LOG_DEBUG1("default LIB is '%s'",defaultLibDir)
+	return defaultLibDir;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceDefinition::getDefaultPath
+//
+// ACCESS SPECIFIER: public (static)
+//
+// DESCRIPTION     : return default PATH based on given value of %SYBASE%
+//
+// ARGUMENTS       : sybase IN value of %SYBASE%
+//                   arena  IN arena to hold the result
+//
+// RETURNS         : default PATH
+//
+// ============================================================================
+char *ServiceDefinition::getDefaultPath
+(
+	const char  *sybase,
+	StringArena &arena
+)
+{
+	const char *systemRoot;
+
+	// get the location of the Windows NT directory
+	systemRoot = getenv("SYSTEMROOT");
+	LOGGER_LOG_DEBUG1("systemRoot is '%s'",systemRoot)
+	if(systemRoot==0) { systemRoot = ""; }
+
+	// build up the default path
+	char *defaultPath = arena.allocate(3*strlen(sybase)+2*strlen(systemRoot)+30);
+	sprintf(defaultPath,"%s\\install;%s\\bin;%s\\dll;%s;%s\\system32",
+				sybase,sybase,sybase,systemRoot,systemRoot);
+	LOGGER_LOG_DEBUG1("default PATH is '%s'",defaultPath)
+	return defaultPath;
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceDefinition::ServiceDefinition
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : constructor
+//
+// ============================================================================
+ServiceDefinition::ServiceDefinition()
+{
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceDefinition::~ServiceDefinition
+//
+// ACCESS SPECIFIER: public
+//
+// DESCRIPTION     : destructor - the strings are freed along with the arena
+//
+// ============================================================================
+ServiceDefinition::~ServiceDefinition()
+{
+}
+
+// ============================================================================
+//
+// PRIVATE MEMBER FUNCTIONS
+//
+// ============================================================================
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceDefinition::applySetting
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : apply one setting to a CmdRunner (or the logger)
+//
+// ARGUMENTS       : cmdRunner IN CmdRunner object to apply the setting to
+//                   setting   IN the setting
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+void ServiceDefinition::applySetting
+(
+	CmdRunner            *cmdRunner,
+	const ServiceSetting &setting
+) const throw(SrvStartException)
+{
+	const char *value = setting.text;
+
+	switch(setting.directive)
+	{
+		case W_AUTO_RESTART:
+			// auto restart?
+			cmdRunner->setAutoRestart(setting.number!=0);
+			break;
+
+		case W_DEBUG:
+			LoggerSetDebugLevel(setting.number-1);
+			break;
+
+		case W_DEBUG_OUT:
+			if(!strcmp(value,"-"))
+			{
+				// log to stdout
+				configureLogger(LOGGER_ANSI_STDOUT,0,0);
+			}
+			else
+			if(!strcmp(value,"LOG"))
+			{
+				// log to event log
+				configureLogger(LOGGER_WIN32_EVENTLOG,"",0);
+			}
+			else
+			if(!strncmp(value,"syslog:",7))
+			{
+				// send RFC 5424 frames to a syslog daemon ("syslog:" alone for the local one)
+				configureLogger(LOGGER_SYSLOG_SOCKET,const_cast<char*>(value+7),0);
+			}
+			else
+			{
+				// log to file
+
+				// a leading "json:" or "logfmt:" writes structured records instead of text,
+				// and "ring:" writes to a flight recorder (read it with logdump)
+				int         logDestination=LOGGER_ANSI_FILENAME;
+				const char *logSpec=value;
+				if(!strncmp(logSpec,"ring:",5))
+				{
+					logDestination=LOGGER_RING_FILENAME;
+					logSpec+=5;
+				}
+				else
+				if(!strncmp(logSpec,"json:",5))
+				{
+					logDestination=LOGGER_JSON_FILENAME;
+					logSpec+=5;
+				}
+				else
+				if(!strncmp(logSpec,"logfmt:",7))
+				{
+					logDestination=LOGGER_LOGFMT_FILENAME;
+					logSpec+=7;
+				}
+
+				// get filename and substitute environment variables
+				StringSubstituter stringSubstituter;
+				char *logFile;
+				stringSubstituter.stringInit(logFile);
+
+				// if the first character of the log file is '>', then truncate the log file first
+				int truncateFile;
+				// truncate the log file?
+				if(logSpec[0]=='>')
+				{
+					// strip off the leading '>' and truncate the file
+					stringSubstituter.stringCopy(logFile,logSpec+1);
+					truncateFile=1;
+				}
+				else
+				{
+					// don't truncate the file
+					stringSubstituter.stringCopy(logFile,logSpec);
+					truncateFile=0;
+				}
+
+				// substitute any environment variables in the log file
+				stringSubstituter.stringSubstitute(logFile);
+
+				// configure the logger
+				configureLogger(logDestination,logFile,
+					(logDestination==LOGGER_RING_FILENAME)?NULL:(void*)&truncateFile);
+			}
+			break;
+
+		case W_ENV:
+			// environment variable
+			LOGGER_LOG_DEBUG2("environment '%s' = '%s'",setting.name,value)
+			cmdRunner->addEnv(setting.name,value);
+			break;
+
+		case W_LOCAL_DRIVE:
+			// map local drive (ie SUBST)
+			LOGGER_LOG_DEBUG2("local drive %c = '%s'",setting.number,value)
+			cmdRunner->mapLocalDrive((char)setting.number,value);
+			break;
+
+		case W_LOG_CONTROL:
+			// runtime logger control file (debug level, filters and destinations
+			// can be changed by editing this file while the service is running)
+			{
+				// get filename and substitute environment variables
+				StringSubstituter stringSubstituter;
+				char *controlFile;
+				stringSubstituter.stringInit(controlFile);
+				stringSubstituter.stringCopy(controlFile,value);
+				stringSubstituter.stringSubstitute(controlFile);
+
+				// start watching the control file
+				LOGGER_LOG_DEBUG1("logger control file '%s'",controlFile)
+				if(!LoggerWatchControlFile(controlFile,0))
+				{
+					LOGGER_LOG_ERROR1("Failed to watch logger control file '%s'",controlFile)
+					THROW_SRVSTART_EXCEPTION
+						(SRVSTART_EXCEPTION_GENERAL_ERROR,"ServiceDefinition","apply")
+				}
+			}
+			break;
+
+		case W_LOG_COALESCE:
+			// interval for reporting repeated messages (0 to log every repeat)
+			LoggerSetCoalesce(setting.number);
+			break;
+
+		case W_LOG_BATCH:
+			// batch writes to log files: "messages [milliseconds]" (0 to write each message)
+			loggerControl("batch",value,"log batch");
+			break;
+
+		case W_LOG_LIMIT:
+			// rate limit for each call site: "classes per_minute [burst]"
+			loggerControl("rate",value,"log limit");
+			break;
+
+		case W_MINIMISED:
+			// start minimised?
+			cmdRunner->setStartMinimised(setting.number!=0);
+			break;
+
+		case W_NET_DRIVE:
+			// map network drive (ie NET USE)
+			LOGGER_LOG_DEBUG2("network drive %c = '%s'",setting.number,value)
+			cmdRunner->mapNetworkDrive((char)setting.number,value);
+			break;
+
+		case W_NEW_WINDOW:
+			// start in new window
+			cmdRunner->setStartInNewWindow(setting.number!=0);
+			break;
+
+		case W_CONTINUE:
+			// continue command
+			cmdRunner->setContinueCommand(value);
+			break;
+
+		case W_PAUSE:
+			// pause command
+			cmdRunner->setPauseCommand(value);
+			break;
+
+		case W_METRICS_PORT:
+			// port on which the metrics are served
+			cmdRunner->setMetricsPort(setting.number);
+			break;
+
+		case W_PAUSE_METHOD:
+			// pause method
+			cmdRunner->setPauseMethod((CmdRunner::PAUSE_METHODS)setting.number);
+			break;
+
+		case W_PRESHUTDOWN_TIMEOUT:
+			// time the SCM allows the service to stop before the system shuts down
+			cmdRunner->setPreshutdownTimeout(setting.number);
+			break;
+
+		case W_PRIORITY:
+			// execution priority
+			cmdRunner->setExecutionPriority((CmdRunner::EXECUTION_PRIORITIES)setting.number);
+			break;
+
+		case W_RESTART_INTERVAL:
+			// restart interval
+			cmdRunner->setAutoRestartInterval(setting.number);
+			break;
+
+		case W_SHUTDOWN:
+			// shutdown command
+			cmdRunner->setShutdownCommand(value);
+			cmdRunner->setShutdownMethod(CmdRunner::SHUTDOWN_BY_COMMAND);
+			break;
+
+		case W_SHUTDOWN_METHOD:
+			// shutdown method
+			cmdRunner->setShutdownMethod((CmdRunner::SHUTDOWN_METHODS)setting.number);
+			break;
+
+		case W_STARTUP:
+			// startup command
+			cmdRunner->setStartupCommand(value);
+			break;
+
+		case W_STARTUP_DELAY:
+			// startup delay
+			cmdRunner->setStartupDelay(setting.number);
+			break;
+
+		case W_STARTUP_DIR:
+			// startup directory
+			cmdRunner->setStartupDirectory(value);
+			break;
+
+		case W_WAIT:
+			// wait command
+			cmdRunner->setWaitCommand(value);
+			break;
+
+		case W_WAIT_TIME:
+			// wait interval
+			cmdRunner->setWaitInterval(setting.number);
+			break;
+
+		default:
+			// lib, path, sybase and sybpath are resolved by parse()
+			LOGGER_LOG_ERROR1("Invalid service setting %d",setting.directive)
+			THROW_SRVSTART_EXCEPTION
+				(SRVSTART_EXCEPTION_INVALID_PARAMETER,"ServiceDefinition","apply")
+			break;
+	}
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceDefinition::sameSettings
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : does another definition have the same settings for a
+//                   directive, in the same order?
+//
+// ARGUMENTS       : other     IN other definition
+//                   directive IN one of the DIRECTIVE_IDS
+//
+// RETURNS         : true if it does
+//
+// ============================================================================
+bool ServiceDefinition::sameSettings
+(
+	const ServiceDefinition &other,
+	int                      directive
+) const
+{
+	int i = 0, j = 0;
+
+	while(true)
+	{
+		// next setting for the directive in each definition
+		while((i<(int)settings.size())&&(settings[i].directive!=directive)) { i++; }
+		while((j<(int)other.settings.size())&&(other.settings[j].directive!=directive)) { j++; }
+
+		if((i==(int)settings.size())||(j==(int)other.settings.size()))
+		{
+			return (i==(int)settings.size())&&(j==(int)other.settings.size());
+		}
+
+		const ServiceSetting &s1 = settings[i++];
+		const ServiceSetting &s2 = other.settings[j++];
+		if(s1.number!=s2.number) { return false; }
+		if(strcmp(s1.text,s2.text)) { return false; }
+		if((s1.name==0)!=(s2.name==0)) { return false; }
+		if((s1.name!=0)&&strcmp(s1.name,s2.name)) { return false; }
+	}
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceDefinition::addEnvSetting
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : add an environment variable setting
+//
+// ARGUMENTS       : name IN variable name (held in the arena or static)
+//                   text IN value (held in the arena)
+//
+// ============================================================================
+void ServiceDefinition::addEnvSetting
+(
+	const char *name,
+	const char *text
+)
+{
+	LOGGER_LOG_DEBUG2("environment '%s' = '%s'",name,text)
+	storeSetting(W_ENV,0,name,text);
+}
+
+// ============================================================================
+//
+// MEMBER FUNCTION : ServiceDefinition::storeSetting
+//
+// ACCESS SPECIFIER: private
+//
+// DESCRIPTION     : add a setting whose strings are already held in the arena
+//
+// ARGUMENTS       : directive IN one of the DIRECTIVE_IDS
+//                   number    IN converted value
+//                   name      IN variable name (may be NULL)
+//                   text      IN value
+//
+// ============================================================================
+void ServiceDefinition::storeSetting
+(
+	int         directive,
+	int         number,
+	const char *name,
+	const char *text
+)
+{
+	ServiceSetting setting;
+	setting.directive = directive;
+	setting.number    = number;
+	setting.name      = name;
+	setting.text      = text;
+	settings.push_back(setting);
+}
@@ -0,0 +1,274 @@
+// ============================================================================
+//
+// FILE        : ServiceDefinition.h
+//
+// AUTHOR      : Nick Rozanski
+//
+// DESCRIPTION : interface definition for ServiceDefinition class
+//
+//               A ServiceDefinition holds the settings for one service, taken
+//               from a configuration file:  every integer, yes/no and keyword
+//               value has been validated and converted, env directives have
+//               been split into name and value, and the sybase and sybpath
+//               directives have been resolved into the %SYBASE%, %LIB% and
+//               %PATH% variables they set.  It can be built from a text
+//               configuration file or loaded from a compiled one (see
+//               CompiledConfiguration.h), and then applied to a CmdRunner.
+//
+//               When the configuration file changes while a service is
+//               running, the new definition is compared with the old one.
+//               Logging and restart policy directives can be applied live;  any
+//               other change needs the command to be restarted.
+//
+// MODIFICATION HISTORY
+// --------------------
+//
+//  Refer to master source file exe.cpp for full modification history.
+//
+// DISTRIBUTION
+// ------------
+// Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+// Distributed under the terms of the GNU General Public License
+//  as published by the Free Software Foundation
+//  (675 Mass Ave, Cambridge, MA 02139, USA)
+//
+// SrvStart is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+// License for more details.
+//
+// ============================================================================
+
+// prevent multiple inclusion
+
+#if !defined(__SERVICE_DEFINITION_H__)
+#define __SERVICE_DEFINITION_H__
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+// system headers
+#include <vector>
+
+// class headers
+#include "ConfigurationFile.h"
+#include "KeywordTable.h"
+#include "../dll/CmdRunner.h"
+#include "../dll/StringArena.h"
+
+using namespace std;
+using namespace SrvStart;
+
+// ============================================================================
+//
+// CONSTANT DEFINITIONS
+//
+// ============================================================================
+
+const char LIBDIR_NAME[] = "LIB";
+const char PATH_NAME[]   = "PATH";
+const char SYBASE_NAME[] = "SYBASE";
+
+// ============================================================================
+//
+// KEYWORD TABLES
+//
+//  These may be listed in any order - see KeywordTable.h
+//
+// ============================================================================
+
+// control file directive identifiers (new ones go at the end, since these
+//  are stored in compiled configuration images)
+enum DIRECTIVE_IDS
+{
+	W_AUTO_RESTART = 0,
+	W_DEBUG,
+	W_DEBUG_OUT,
+	W_ENV,
+	W_LIB,
+	W_LOCAL_DRIVE,
+	W_LOG_BATCH,
+	W_LOG_COALESCE,
+	W_LOG_CONTROL,
+	W_LOG_LIMIT,
+	W_MINIMISED,
+	W_NET_DRIVE,
+	W_NEW_WINDOW,
+	W_PATH,
+	W_PRIORITY,
+	W_RESTART_INTERVAL,
+	W_SYBASE,
+	W_SYBPATH,
+	W_SHUTDOWN,
+	W_SHUTDOWN_METHOD,
+	W_STARTUP,
+	W_STARTUP_DELAY,
+	W_STARTUP_DIR,
+	W_WAIT,
+	W_WAIT_TIME,
+	W_CONTINUE,
+	W_PAUSE,
+	W_PAUSE_METHOD,
+	W_PRESHUTDOWN_TIMEOUT,
+	W_METRICS_PORT,
+	DIRECTIVE_COUNT
+};
+
+// control file directives
+constexpr Keyword directiveKeywords[] =
+{
+	"auto_restart",		W_AUTO_RESTART,
+	"continue",			W_CONTINUE,
+	"debug",			W_DEBUG,
+	"debug_out",		W_DEBUG_OUT,
+	"env",				W_ENV,
+	"lib",				W_LIB,
+	"local_drive",		W_LOCAL_DRIVE,
+	"log_batch",		W_LOG_BATCH,
+	"log_coalesce",		W_LOG_COALESCE,
+	"log_control",		W_LOG_CONTROL,
+	"log_limit",		W_LOG_LIMIT,
+	"metrics_port",		W_METRICS_PORT,
+	"minimised",		W_MINIMISED,
+	"network_drive",	W_NET_DRIVE,
+	"new_window",		W_NEW_WINDOW,
+	"path",				W_PATH,
+	"pause",			W_PAUSE,
+	"pause_method",		W_PAUSE_METHOD,
+	"preshutdown_timeout",	W_PRESHUTDOWN_TIMEOUT,
+	"priority",			W_PRIORITY,
+	"restart_interval",	W_RESTART_INTERVAL,
+	"shutdown",			W_SHUTDOWN,
+	"shutdown_method",	W_SHUTDOWN_METHOD,
+	"startup",			W_STARTUP,
+	"startup_delay",	W_STARTUP_DELAY,
+	"startup_dir",		W_STARTUP_DIR,
+	"sybase",			W_SYBASE,
+	"sybpath",			W_SYBPATH,
+	"wait",				W_WAIT,
+	"wait_time",		W_WAIT_TIME
+};
+constexpr auto directiveTable = makeKeywordTable<128>(directiveKeywords);
+static_assert(directiveTable.isPerfect(),"duplicate configuration file directive");
+
+// execution priorities (priority directive and -x switch)
+constexpr Keyword priorityKeywords[] =
+{
+	"high",				CmdRunner::HIGH_PRIORITY,
+	"idle",				CmdRunner::IDLE_PRIORITY,
+	"normal",			CmdRunner::NORMAL_PRIORITY,
+	"real",				CmdRunner::REAL_PRIORITY
+};
+constexpr auto priorityTable = makeKeywordTable<16>(priorityKeywords);
+static_assert(priorityTable.isPerfect(),"duplicate execution priority");
+
+// shutdown methods (shutdown_method directive)
+constexpr Keyword shutdownMethodKeywords[] =
+{
+	"command",			CmdRunner::SHUTDOWN_BY_COMMAND,
+	"kill",				CmdRunner::SHUTDOWN_BY_KILL,
+	"winmessage",		CmdRunner::SHUTDOWN_BY_WINMESSAGE
+};
+constexpr auto shutdownMethodTable = makeKeywordTable<16>(shutdownMethodKeywords);
+static_assert(shutdownMethodTable.isPerfect(),"duplicate shutdown method");
+
+// pause methods (pause_method directive)
+constexpr Keyword pauseMethodKeywords[] =
+{
+	"command",			CmdRunner::PAUSE_BY_COMMAND,
+	"none",				CmdRunner::PAUSE_NOT_SUPPORTED,
+	"suspend",			CmdRunner::PAUSE_BY_SUSPEND
+};
+constexpr auto pauseMethodTable = makeKeywordTable<16>(pauseMethodKeywords);
+static_assert(pauseMethodTable.isPerfect(),"duplicate pause method");
+
+// ============================================================================
+//
+// TYPE DEFINITIONS
+//
+// ============================================================================
+
+//
+// a single resolved setting
+//
+//  directive is one of the DIRECTIVE_IDS (lib, path, sybase and sybpath are
+//   resolved into W_ENV settings)
+//  number    is the converted value of integer, yes/no and keyword
+//   directives, or the drive letter of drive mappings
+//  name      is the variable name of W_ENV settings (otherwise NULL)
+//  text      is the value of the setting
+//
+struct ServiceSetting
+{
+	int         directive;
+	int         number;
+	const char *name;
+	const char *text;
+} ;
+
+// ============================================================================
+//
+// ServiceDefinition class
+//
+// ============================================================================
+class ServiceDefinition
+{
+public:
+
+	// build from the requested section of a configuration file
+	void parse(ConfigurationFile &cf) throw(SrvStartException);
+
+	// apply the settings to a CmdRunner
+	void apply(CmdRunner *cmdRunner) const throw(SrvStartException);
+
+	// how this definition differs from a previous one
+	typedef enum DEFINITION_CHANGES { DEFINITION_UNCHANGED, DEFINITION_CHANGED_LIVE,
+										DEFINITION_CHANGED_RESTART };
+	DEFINITION_CHANGES compare(const ServiceDefinition &previous) const;
+
+	// apply the settings which differ from a previous definition (only the
+	//  live ones unless the command is being restarted)
+	void applyChanges(CmdRunner *cmdRunner,const ServiceDefinition &previous,bool restarting) const
+		throw(SrvStartException);
+
+	// can a directive be changed while the command is running?
+	static bool isLiveDirective(int directive);
+
+	// add a setting (name and text are copied)
+	void addSetting(int directive,int number,const char *name,const char *text);
+
+	// discard every setting
+	void clear();
+
+	// settings
+	int                   getSettingCount() const;
+	const ServiceSetting &getSetting(int setting) const;
+
+	// default %LIB% and %PATH% for a given %SYBASE%
+	static char *getDefaultLibDir(const char *sybase,StringArena &arena);
+	static char *getDefaultPath(const char *sybase,StringArena &arena);
+
+	// constructor and destructor
+	ServiceDefinition();
+	virtual ~ServiceDefinition();
+
+private:
+	// service functions
+	void applySetting(CmdRunner *cmdRunner,const ServiceSetting &setting) const
+		throw(SrvStartException);
+	bool sameSettings(const ServiceDefinition &other,int directive) const;
+	void addEnvSetting(const char *name,const char *text);
+	void storeSetting(int directive,int number,const char *name,const char *text);
+
+	// no copying
+	ServiceDefinition(const ServiceDefinition &);
+	ServiceDefinition &operator=(const ServiceDefinition &);
+
+	// private variables
+	vector<ServiceSetting> settings;
+	StringArena            arena;
+
+};
+
+#endif // !defined(__SERVICE_DEFINITION_H__)
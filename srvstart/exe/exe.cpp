@@ -43,6 +43,8 @@
 // ============================================================================
 
 // system headers
+#include <errno.h>
+#include <process.h>
 #include <stdlib.h>
 #include <string>
 #include <stdio.h>
@@ -53,9 +55,14 @@
 
 // class headers
 #include "ArgumentList.h"
+#include "CompiledConfiguration.h"
 #include "ConfigurationFile.h"
+#include "ConfigurationReloader.h"
+#include "ServiceDefinition.h"
 #include "Validation.h"
 #include "../dll/CmdRunner.h"
+#include "../dll/ScmConnector.h"
+#include "../dll/ServiceBatch.h"
 #include "../dll/SrvStart.h"
 #include "../dll/ServiceManager.h"
 #include "../dll/StringSubstituter.h"
@@ -89,8 +96,9 @@ using namespace std;
 // ============================================================================
 
 const int	MAX_ARG_SIZE		= 5000;
-const int	DIRECTIVE_SIZE		= 128;
-const int	VALUE_SIZE			= 5000;
+
+// interval at which repeats of a logged message are reported (see LoggerSetCoalesce)
+const int	LOG_COALESCE_SECONDS	= 60;
 
 const char	*COMMAND_MODE_ARG		= "cmd";
 const char	*SERVICE_MODE_ARG		= "svc";
@@ -98,10 +106,45 @@ const char	*ANY_MODE_ARG			= "any";
 const char	*INSTALL_ARG			= "install";
 const char	*INSTALL_DESKTOP_ARG	= "install_desktop";
 const char	*REMOVE_ARG				= "remove";
+const char	*COMPILE_ARG			= "compile";
+const char	*APPLY_ARG				= "apply";
+const char	*ROLLBACK_ARG			= "rollback";
+
+// services installed or modified by a manifest at once (see applyManifest)
+const int	DEFAULT_BATCH_THREADS	= 8;
 
-const char	*LIBDIR_NAME	= "LIB";
-const char	*PATH_NAME		= "PATH";
-const char	*SYBASE_NAME	= "SYBASE";
+// a manifest's journal is named after it
+const char	*JOURNAL_SUFFIX			= ".journal";
+
+// separates the names of services which share one process
+const char	*SERVICE_LIST_SEPARATORS	= ",";
+
+// ============================================================================
+//
+// GLOBAL VARIABLES
+//
+// ============================================================================
+
+// the service's definition, reloaded when its configuration file changes
+static ConfigurationReloader G_configurationReloader;
+
+// held while a hosted service parses its arguments (see hostServices)
+static CRITICAL_SECTION G_parseLock;
+
+// ============================================================================
+//
+// LOCAL TYPES
+//
+// ============================================================================
+
+// one of the services hosted by this process (see hostServices)
+struct HostedService
+{
+	char                  *svcName;
+	ArgumentList          *argList;
+	ConfigurationReloader  configurationReloader;
+	bool                   success;
+};
 
 // ============================================================================
 //
@@ -109,16 +152,22 @@ const char	*SYBASE_NAME	= "SYBASE";
 //
 // ============================================================================
 
-void getDefaultLibDir(char sybase[],char defaultLibDir[]);
-void getDefaultPath(char sybase[],char defaultPath[]);
+void compileConfigurationFile(char configFile[]) throw(SrvStartException);
+void applyManifest(char manifest[],bool dryRun,int maxThreads,ArgumentList &argList)
+				throw(SrvStartException);
+void rollbackManifest(char manifest[]) throw(SrvStartException);
+void printBatchLine(const char *line,void *unused);
 void installService(char *serviceName,bool desktopService,ArgumentList argList)
 				throw(SrvStartException);
-void parseArgv(CmdRunner *cmdRunner,ArgumentList argList)
+void parseArgv(CmdRunner *cmdRunner,ArgumentList argList,ConfigurationReloader *reloader)
 				throw(SrvStartException);
-void parseConfigurationFile(CmdRunner *cmdRunner,char configFile[]);
-void parseSwitch(CmdRunner *cmdRunner,ArgumentList &argList,bool &libDirSet,bool &pathSet);
+void parseConfigurationFile(CmdRunner *cmdRunner,char configFile[],ConfigurationReloader *reloader);
+void parseSwitch(CmdRunner *cmdRunner,ArgumentList &argList,bool &libDirSet,bool &pathSet,
+				ConfigurationReloader *reloader);
 void printSyntaxAndExit(bool success);
 void removeService(char *serviceName) throw(SrvStartException);
+bool hostServices(char *svcList,ArgumentList argList) throw(SrvStartException);
+unsigned __stdcall hostedServiceMain(void *arg);
 void exitProcess(bool success);
 
 // ============================================================================
@@ -136,6 +185,9 @@ void main(int argc, char* argv[])
 	LoggerConfigure(LOGGER_DEFAULT_LOGGER,0,const_cast<char*>(SrvStart::getApplication()),
 					LOGGER_ANSI_STDOUT,0,0,0,0);
 
+	// report repeated messages (eg from polling loops) as a count rather than one by one
+	LoggerSetCoalesce(LOG_COALESCE_SECONDS);
+
 	// set the appropriate debug level for Debug or Release versions
 #ifdef	LOGGER_DEBUG_ON
 	LoggerSetDebugLevel(2);
@@ -215,6 +267,114 @@ void main(int argc, char* argv[])
 				LoggerConfigure(LOGGER_DEFAULT_LOGGER,0,const_cast<char*>(SrvStart::getApplication()),
 						LOGGER_ANSI_STDOUT,0,0,0,0);
 			}
+			else if(!strcmp(arg,COMPILE_ARG))
+			{
+				LOGGER_LOG_DEBUG("mode is 'compile'")
+				argList.popNextArgument(argType,arg,ArgumentList::AL_TO_LOWER);
+				// since compile mode, log to stdout
+				LoggerConfigure(LOGGER_DEFAULT_LOGGER,0,const_cast<char*>(SrvStart::getApplication()),
+						LOGGER_ANSI_STDOUT,0,0,0,0);
+
+				// get the configuration file
+				bool isValid;
+				argList.popNextArgument(argType,ArgumentList::AL_IS_FILE,isValid,arg);
+				if(!isValid)
+				{
+					LOGGER_LOG_ERROR1("Configuration file '%s' not found",arg)
+					printSyntaxAndExit(false);
+				}
+
+				try
+				{
+					// compile it
+					compileConfigurationFile(arg);
+				}
+				catch(SrvStartException e)
+				{
+					// an exception has been trapped - log it
+					LOGGER_LOG_ERROR3("Exception %d trapped in source file '%s' line %d",
+										e.exceptionId,e.sourceFile,e.lineNumber)
+					LOGGER_LOG_ERROR2("Class '%s' method '%s'",e.className,e.methodName)
+					LOGGER_LOG_ERROR1("%s",e.errorMessage)
+					exitProcess(false);
+				}
+
+				// compile succeeded
+				exitProcess(true);
+			}
+			else if((!strcmp(arg,APPLY_ARG))||(!strcmp(arg,ROLLBACK_ARG)))
+			{
+				bool rollback = (strcmp(arg,ROLLBACK_ARG)==0);
+				LOGGER_LOG_DEBUG1("mode is '%s'",(rollback ? ROLLBACK_ARG : APPLY_ARG))
+				argList.popNextArgument(argType,arg,ArgumentList::AL_TO_LOWER);
+				// since apply / rollback mode, log to stdout
+				LoggerConfigure(LOGGER_DEFAULT_LOGGER,0,const_cast<char*>(SrvStart::getApplication()),
+						LOGGER_ANSI_STDOUT,0,0,0,0);
+
+				// get the manifest
+				bool isValid;
+				char manifest[MAX_ARG_SIZE];
+				argList.popNextArgument(argType,ArgumentList::AL_IS_FILE,isValid,manifest);
+				if(!isValid)
+				{
+					LOGGER_LOG_ERROR1("Manifest '%s' not found",manifest)
+					printSyntaxAndExit(false);
+				}
+
+				// -n (dry run) and -j threads
+				bool dryRun     = false;
+				int  maxThreads = DEFAULT_BATCH_THREADS;
+				for(argList.popNextArgument(argType,arg,ArgumentList::AL_TO_LOWER);
+					argType!=ArgumentList::AL_EMPTY;
+					argList.popNextArgument(argType,arg,ArgumentList::AL_TO_LOWER))
+				{
+					if((argType==ArgumentList::AL_SWITCH)&&(!strcmp(arg,"n"))&&(!rollback))
+					{
+						dryRun = true;
+					}
+					else if((argType==ArgumentList::AL_SWITCH)&&(!strcmp(arg,"j"))&&(!rollback))
+					{
+						argList.popNextArgument(argType,ArgumentList::AL_IS_INTEGER,isValid,arg);
+						maxThreads = atoi(arg);
+						if((!isValid)||(maxThreads<1))
+						{
+							LOGGER_LOG_ERROR1("Invalid number of threads '%s'",arg)
+							printSyntaxAndExit(false);
+						}
+					}
+					else
+					{
+						LOGGER_LOG_ERROR2("invalid syntax for %s mode (%s)",
+							(rollback ? ROLLBACK_ARG : APPLY_ARG),arg)
+						printSyntaxAndExit(false);
+					}
+				}
+
+				try
+				{
+					// apply it (or undo it)
+					if(rollback)
+					{
+						rollbackManifest(manifest);
+					}
+					else
+					{
+						applyManifest(manifest,dryRun,maxThreads,argList);
+					}
+				}
+				catch(SrvStartException e)
+				{
+					// an exception has been trapped - log it
+					LOGGER_LOG_ERROR3("Exception %d trapped in source file '%s' line %d",
+										e.exceptionId,e.sourceFile,e.lineNumber)
+					LOGGER_LOG_ERROR2("Class '%s' method '%s'",e.className,e.methodName)
+					LOGGER_LOG_ERROR1("%s",e.errorMessage)
+					exitProcess(false);
+				}
+
+				// apply / rollback succeeded
+				exitProcess(true);
+			}
 			else
 			{
 				// invalid mode - assume this argument is the service name
@@ -244,6 +404,9 @@ void main(int argc, char* argv[])
 		LOGGER_LOG_DEBUG1("window / service name is '%s'",svc_name)
 	}
 
+	// record the service name in structured (JSON and logfmt) log messages
+	LoggerSetServiceName(svc_name);
+
 	// if install mode, install service and exit
 	if((mode==CmdRunner::INSTALL_MODE)||(mode==CmdRunner::INSTALL_DESKTOP_MODE))
 	{
@@ -304,6 +467,42 @@ void main(int argc, char* argv[])
 		exitProcess(true);
 	}
 
+	// if several services share this process, run each of them
+	if(strpbrk(svc_name,SERVICE_LIST_SEPARATORS)!=0)
+	{
+		if(mode!=CmdRunner::SERVICE_MODE)
+		{
+			LOGGER_LOG_ERROR1("services '%s' can only share a process in service mode",svc_name)
+			printSyntaxAndExit(false);
+		}
+
+		bool success = false;
+		try
+		{
+			// hostServices() returns when every service has stopped
+			success = hostServices(svc_name,argList);
+		}
+		catch(SrvStartException e)
+		{
+			// an exception has been trapped - log it
+			LOGGER_LOG_ERROR3("Exception %d trapped in source file '%s' line %d",
+		 						e.exceptionId,e.sourceFile,e.lineNumber)
+			LOGGER_LOG_ERROR2("Class '%s' method '%s'",e.className,e.methodName)
+			LOGGER_LOG_ERROR1("%s",e.errorMessage)
+
+			// write it to stdout too
+			cout << "ERROR: Exception " << e.exceptionId <<
+					" trapped in source file '" << e.sourceFile <<
+					"' line " << e.lineNumber << "\n";
+			cout << "ERROR: Class '" << e.className << "' method '" << e.methodName << "'\n";
+			cout << e.errorMessage << "\n";
+
+			exitProcess(false);
+		}
+
+		exitProcess(success);
+	}
+
 	// otherwise - run command or service
 	try
 	{
@@ -313,7 +512,7 @@ void main(int argc, char* argv[])
 		LOGGER_LOG_DEBUG("CmdRunner object created")
 
 		// parse remaining command line arguments (includes reading configuration file)
-		parseArgv(&cmdRunner,argList);
+		parseArgv(&cmdRunner,argList,&G_configurationReloader);
 
 		// log startup information
 		LOGGER_LOG_INFO4("%s version %s %s (%s)",
@@ -382,14 +581,28 @@ Syntax for command mode:\n\
 Syntax for service mode:\n\
  srvstart [ svc ] service_name [options] command [program_parameters...]\n\
 \n\
+Syntax for service mode (several services sharing one process):\n\
+ srvstart svc service_name,service_name... -c controlfile\n\
+\n\
 Syntax for any mode (try service, then command):\n\
  srvstart any service_name [options] command [program_parameters...]\n\
 \n\
 Syntax for install mode:\n\
- srvstart install|install_desktop service_name -c controlfile\n\
+ srvstart install|install_desktop service_name[,service_name...] -c controlfile\n\
 \n\
 Syntax for remove mode:\n\
- srvstart remove service_name\n\
+ srvstart remove service_name[,service_name...]\n\
+\n\
+Syntax for compile mode (services then load ctrlfile.compiled instead):\n\
+ srvstart compile ctrlfile\n\
+\n\
+Syntax for apply mode (install, modify and remove the services in a manifest):\n\
+ srvstart apply manifest [-n] [-j threads]\n\
+   -n prints what would be done, without doing it\n\
+   -j sets how many services are installed at once (default 8)\n\
+\n\
+Syntax for rollback mode (undo an apply which did not finish):\n\
+ srvstart rollback manifest\n\
 \n\
 service_name is short (internal) name of NT service\n\
 \n\
@@ -460,14 +673,16 @@ void exitProcess
 //
 // ARGUMENTS       : cmdRunner IN CmdRunner object to apply arguments to
 //                   argList   IN argument list
+//                   reloader  IN the service's definition (see -c)
 //
 // THROWS          : SrvStartException
 //
 // ============================================================================
 void parseArgv
 (
-	CmdRunner    *cmdRunner,
-	ArgumentList  argList
+	CmdRunner             *cmdRunner,
+	ArgumentList           argList,
+	ConfigurationReloader *reloader
 ) throw(SrvStartException)
 {
 	LOGGER_LOG_DEBUG("parseArgv()")
@@ -490,7 +705,7 @@ void parseArgv
 			case ArgumentList::AL_SWITCH:
 				// a switch
 				LOGGER_LOG_DEBUG("parseArgv(): switch")
-				parseSwitch(cmdRunner,argList,libDirSet,pathSet);
+				parseSwitch(cmdRunner,argList,libDirSet,pathSet,reloader);
 				break;
 
 			default:
@@ -537,16 +752,18 @@ NO_MORE_ARGS:
 //                   argList   IN argument list
 //                   libDirSet IN true if %LIB% has been set already
 //                   pathSet   IN true if %PATH% has been set already
+//                   reloader  IN the service's definition (see -c)
 //
 // THROWS          : SrvStartException
 //
 // ============================================================================
 void parseSwitch
 (
-	CmdRunner   *cmdRunner,
-	ArgumentList &argList,
-	bool         &libDirSet,
-	bool         &pathSet
+	CmdRunner             *cmdRunner,
+	ArgumentList          &argList,
+	bool                  &libDirSet,
+	bool                  &pathSet,
+	ConfigurationReloader *reloader
 ) throw(SrvStartException)
 {
 	LOGGER_LOG_DEBUG("parseSwitch()")
@@ -554,6 +771,7 @@ void parseSwitch
 	static char                 arg[MAX_ARG_SIZE];
 	ArgumentList::ArgumentTypes argType;
 	bool                        isValid;
+	int                         valueId;
 
 	argList.popNextArgument(argType,arg);
 	switch(arg[0])
@@ -675,10 +893,9 @@ void parseSwitch
 		case 'q':	LOGGER_LOG_DEBUG("switch -q")
 			// value of %PATH% based on %SYBASE%
 			{
-				char tmp[MAX_ARG_SIZE];
+				StringArena arena;
 				argList.popNextArgument(argType,arg);
-				getDefaultPath(arg,tmp);
-				cmdRunner->addEnv(PATH_NAME,tmp);
+				cmdRunner->addEnv(PATH_NAME,ServiceDefinition::getDefaultPath(arg,arena));
 				pathSet = true;
 			}
 			break;
@@ -686,21 +903,19 @@ void parseSwitch
 		case 's':	LOGGER_LOG_DEBUG("switch -s")
 			// value of %SYBASE%
 			{
-				char tmp[MAX_ARG_SIZE];
+				StringArena arena;
 				argList.popNextArgument(argType,arg);
 				cmdRunner->addEnv(SYBASE_NAME,arg);
 				if(!libDirSet)
 				{
-					getDefaultLibDir(arg,tmp);
-					LOGGER_LOG_DEBUG1("lib dir not set, using default '%s'",tmp)
-					cmdRunner->addEnv(LIBDIR_NAME,tmp);
+					LOGGER_LOG_DEBUG("lib dir not set, using default")
+					cmdRunner->addEnv(LIBDIR_NAME,ServiceDefinition::getDefaultLibDir(arg,arena));
 					libDirSet = true;
 				}
 				if(!pathSet)
 				{
-					getDefaultPath(arg,tmp);
-					LOGGER_LOG_DEBUG1("path not set, using default '%s'",tmp)
-					cmdRunner->addEnv(PATH_NAME,tmp);
+					LOGGER_LOG_DEBUG("path not set, using default")
+					cmdRunner->addEnv(PATH_NAME,ServiceDefinition::getDefaultPath(arg,arena));
 					pathSet = true;
 				}
 			}
@@ -728,10 +943,11 @@ void parseSwitch
 		case 'x':	LOGGER_LOG_DEBUG("switch -x")
 			// execution priority
 			argList.popNextArgument(argType,ArgumentList::AL_ANY,isValid,arg,ArgumentList::AL_TO_LOWER);
-			if(!strcmp(arg,"high")) { cmdRunner->setExecutionPriority(CmdRunner::HIGH_PRIORITY); }
-			else if(!strcmp(arg,"idle")) { cmdRunner->setExecutionPriority(CmdRunner::IDLE_PRIORITY); }
-			else if(!strcmp(arg,"normal")) { cmdRunner->setExecutionPriority(CmdRunner::NORMAL_PRIORITY); }
-			else if(!strcmp(arg,"real")) { cmdRunner->setExecutionPriority(CmdRunner::REAL_PRIORITY); }
+			valueId = priorityTable.find(arg);
+			if(valueId!=KEYWORD_NOT_FOUND)
+			{
+				cmdRunner->setExecutionPriority((CmdRunner::EXECUTION_PRIORITIES)valueId);
+			}
 			else
 			{
 				LOGGER_LOG_ERROR1("Invalid execution priority (-x) %s",arg)
@@ -758,7 +974,7 @@ void parseSwitch
 			argList.popNextArgument(argType,ArgumentList::AL_IS_FILE,isValid,arg);
 			if(isValid)
 			{
-				parseConfigurationFile(cmdRunner,arg);
+				parseConfigurationFile(cmdRunner,arg,reloader);
 			}
 			else
 			{
@@ -781,511 +997,51 @@ void parseSwitch
 //
 // DESCRIPTION     : parse a configuration file
 //
+//                   If the file has been compiled (see compileConfigurationFile)
+//                   and has not changed since, the service's definition is
+//                   taken from the compiled image instead.  The file is then
+//                   watched, and changes to the service's definition are
+//                   applied while it is running (see ConfigurationReloader).
+//
 // ARGUMENTS       : cmdRunner  IN CmdRunner object to apply arguments to
 //                   configFile IN name of configuration file
+//                   reloader   IN the service's definition
 //
 // THROWS          : SrvStartException
 //
 // ============================================================================
 void parseConfigurationFile
 (
-	CmdRunner *cmdRunner,
-	char       configFile[]
+	CmdRunner             *cmdRunner,
+	char                   configFile[],
+	ConfigurationReloader *reloader
 ) throw(SrvStartException)
 {
-	ConfigurationFile cf;
-	static char       directive[DIRECTIVE_SIZE];
-	static char       value[VALUE_SIZE];
-	bool              libDirSet=false,pathSet=false;
-
-	// control file directive identifiers
-#define	W_EMPTY		-2
-#define	W_INVALID	-1
-	typedef enum 
-	{
-		W_AUTO_RESTART = 0,
-		W_DEBUG,
-		W_DEBUG_OUT,
-		W_ENV,
-		W_LIB,
-		W_LOCAL_DRIVE,
-		W_MINIMISED,
-		W_NET_DRIVE,
-		W_NEW_WINDOW,
-		W_PATH,
-		W_PRIORITY,
-		W_RESTART_INTERVAL,
-		W_SYBASE,
-		W_SYBPATH,
-		W_SHUTDOWN,
-		W_SHUTDOWN_METHOD,
-		W_STARTUP,
-		W_STARTUP_DELAY,
-		W_STARTUP_DIR,
-		W_WAIT,
-		W_WAIT_TIME
-	} directive_ids;
-
-	//
-	// control file directives
-	// !! THESE MUST ALWAYS BE IN ALPHABETICAL ORDER !!
-	//
-
-	typedef struct
-	{
-		char          directive_name[DIRECTIVE_SIZE];
-		directive_ids directive_id;
-	} directive_array;
-
-	directive_array directives [] =
-	{
-		"auto_restart",		W_AUTO_RESTART,
-		"debug",			W_DEBUG,
-		"debug_out",		W_DEBUG_OUT,
-		"env",				W_ENV,
-		"lib",				W_LIB,
-		"local_drive",		W_LOCAL_DRIVE,
-		"minimised",		W_MINIMISED,
-		"network_drive",	W_NET_DRIVE,
-		"new_window",		W_NEW_WINDOW,
-		"path",				W_PATH,
-		"priority",			W_PRIORITY,
-		"restart_interval",	W_RESTART_INTERVAL,
-		"shutdown",			W_SHUTDOWN,
-		"shutdown_method",	W_SHUTDOWN_METHOD,
-		"startup",			W_STARTUP,
-		"startup_delay",	W_STARTUP_DELAY,
-		"startup_dir",		W_STARTUP_DIR,
-		"sybase",			W_SYBASE,
-		"sybpath",			W_SYBPATH,
-		"wait",				W_WAIT,
-		"wait_time",		W_WAIT_TIME
-	};
-
-	directive_array *directive_id;
-	int this_directive_id;
-
-	// open the configuration file
-	LOGGER_LOG_DEBUG1("about to open configuration file '%s'",configFile)
-	if(!cf.openConfigurationFile(configFile))
-	{
-		LOGGER_LOG_ERROR1("failed to open configuration file '%s'",configFile)
-		THROW_SRVSTART_EXCEPTION
-			(SRVSTART_EXCEPTION_INVALID_PARAMETER,"","parseConfigurationFile")
-	}
-
-	// set the name of the section we are interested in
-	cf.setRequestedSection(cmdRunner->getSrvName());
-	LOGGER_LOG_DEBUG1("requested section is '%s'",cmdRunner->getSrvName())
-
-	// read the configuration file directives
-	while(true)
-	{
-		// get the next directive
-		cf.getNextConfigurationDirective(directive,value);
-
-		// have we reached the end of file?
-		if(directive[0]=='\0')
-		{
-			LOGGER_LOG_DEBUG("end of directive file reached")
-			break;
-		}
-		LOGGER_LOG_DEBUG2("next directive '%s' = '%s'",directive,value)
-
-		// look up directive in directive list
-		LOGGER_LOG_DEBUG1("about to call bsearch for directive '%s'",directive)
-		directive_id = (directive_array*)bsearch((void*)directive,(void*)directives,
-						(int)(sizeof(directives)/sizeof(directive_array)),
-						sizeof(directive_array),
-						(int(__cdecl *)(const void *,const void *))strcmp);
-
-		if (directive_id != 0)
-		{
-			// we have found the word - convert the pointer to an integer
-			this_directive_id = directive_id->directive_id;
-			LOGGER_LOG_DEBUG1("directive id is %d",this_directive_id)
-		}
-		else
-		{
-			LOGGER_LOG_DEBUG("did not find directive")
-			this_directive_id = W_INVALID;
-		}
-
-		// take the appropriate action for this directive
-		class Validation v;
-		switch(this_directive_id)
-		{
-			case W_AUTO_RESTART:
-				// auto restart?
-				cmdRunner->setAutoRestart(v.isLikeYes(value));
-				break;
-
-			case W_DEBUG:
-				if(v.isInteger(value))
-				{
-					LoggerSetDebugLevel(atoi(value)-1);
-				}
-				else
-				{
-					// bad debug level supplied
-					LoggerSetDebugLevel(2);
-					LOGGER_LOG_ERROR1("Invalid debug level directive %s",value)
-					THROW_SRVSTART_EXCEPTION
-						(SRVSTART_EXCEPTION_INVALID_PARAMETER,"","parseConfigurationFile")
-				}
-				break;
-
-			case W_DEBUG_OUT:
-				if(!strcmp(value,"-"))
-				{
-					// log to stdout
-					int loggerError;
-					if(LoggerConfigure(LOGGER_DEFAULT_LOGGER,"",const_cast<char*>(APPLICATION),
-											LOGGER_ANSI_STDOUT,0,0,&loggerError,0)==0)
-					{
-						LOGGER_LOG_ERROR1("Logger initialisation failed, error = %d",loggerError)
-						THROW_SRVSTART_EXCEPTION
-							(SRVSTART_EXCEPTION_GENERAL_ERROR,"","parseConfigurationFile")
-					}
-				}
-				else
-				if(!strcmp(value,"LOG"))
-				{
-					// log to event log
-					int loggerError;
-					if(LoggerConfigure(LOGGER_DEFAULT_LOGGER,"",const_cast<char*>(APPLICATION),
-											LOGGER_WIN32_EVENTLOG,"",0,&loggerError,0)==0)
-					{
-						LOGGER_LOG_ERROR1("Logger initialisation failed, error = %d",loggerError)
-						THROW_SRVSTART_EXCEPTION
-							(SRVSTART_EXCEPTION_GENERAL_ERROR,"","parseConfigurationFile")
-					}
-				}
-				else
-				{
-					// log to file
-
-					// get filename and substitute environment variables
-					StringSubstituter stringSubstituter;
-					char *logFile;
-					stringSubstituter.stringInit(logFile);
-
-					// if the first character of the log file is '>', then truncate the log file first
-					int truncateFile;
-					// truncate the log file?
-					if(value[0]=='>')
-					{
-						// strip off the leading '>' and truncate the file
-						stringSubstituter.stringCopy(logFile,value+1);
-						truncateFile=1;
-					}
-					else
-					{
-						// don't truncate the file
-						stringSubstituter.stringCopy(logFile,value);
-						truncateFile=0;
-					}
-
-					// substitute any environment variables in the log file
-					stringSubstituter.stringSubstitute(logFile);
-
-					// configure the logger
-					int loggerError;
-					if(LoggerConfigure(LOGGER_DEFAULT_LOGGER,"",const_cast<char*>(APPLICATION),
-											LOGGER_ANSI_FILENAME,logFile,(void*)&truncateFile,
-											&loggerError,0)==0)
-					{
-						LOGGER_LOG_ERROR1("Logger initialisation failed, error = %d",loggerError)
-						stringSubstituter.stringDelete(logFile);
-						THROW_SRVSTART_EXCEPTION
-							(SRVSTART_EXCEPTION_GENERAL_ERROR,"","parseConfigurationFile")
-					}
-					stringSubstituter.stringDelete(logFile);
-				}
-				break;
-
-			case W_ENV:
-				// environment variable
-				{
-					char  envName[MAX_ARG_SIZE];
-					char  envValue[MAX_ARG_SIZE];
-					int   equalsPosition;
-					equalsPosition=(strchr(value,'=')-value);
-					if(equalsPosition==0)
-					{
-						LOGGER_LOG_ERROR1("missing = in environment directive '%s'",value)
-						THROW_SRVSTART_EXCEPTION
-							(SRVSTART_EXCEPTION_INVALID_PARAMETER,"","parseConfigurationFile")
-					}
-					// get environment variable name
-					strncpy(envName,value,equalsPosition);
-					envName[equalsPosition]='\0';
-					// get environment variable value
-					strcpy(envValue,value+equalsPosition+1);
-					// add environment variable to list
-					LOGGER_LOG_DEBUG2("environment '%s' = '%s'",envName,envValue)
-					cmdRunner->addEnv(envName,envValue);
-				}
-				break;
-
-			case W_LOCAL_DRIVE:
-				// map local drive (ie SUBST)
-				{
-					// find position of =
-					int equalsPosition=(strchr(value,'=')-value);
-					if(equalsPosition==0)
-					{
-						LOGGER_LOG_ERROR1("missing = in environment directive '%s'",value)
-						THROW_SRVSTART_EXCEPTION
-							(SRVSTART_EXCEPTION_INVALID_PARAMETER,"","parseConfigurationFile")
-					}
-
-					// get drive letter
-					char driveLetter;
-					int i = 0;
-					while(value[i]==' ') { i++;}
-					driveLetter = value[i];
-
-					// get drive path and substitute environment variables
-					char drivePath[MAX_PATH];
-					strcpy(drivePath,value+equalsPosition+1);
-
-					// map local drive
-					LOGGER_LOG_DEBUG2("local drive %c = '%s'",driveLetter,drivePath)
-					cmdRunner->mapLocalDrive(driveLetter,drivePath);
-				}
-				break;
-
-			case W_LIB:
-				// value of %LIB%
-				LOGGER_LOG_DEBUG2("'%s' = '%s'",LIBDIR_NAME,value)
-				cmdRunner->addEnv(LIBDIR_NAME,value);
-				libDirSet = true;
-				break;
-
-			case W_MINIMISED:
-				// start minimised?
-				cmdRunner->setStartMinimised(v.isLikeYes(value));
-				break;
-
-			case W_NET_DRIVE:
-				// map network drive (ie NET USE)
-				{
-					// find position of =
-					int equalsPosition=(strchr(value,'=')-value);
-					if(equalsPosition==0)
-					{
-						LOGGER_LOG_ERROR1("missing = in environment directive '%s'",value)
-						THROW_SRVSTART_EXCEPTION
-							(SRVSTART_EXCEPTION_INVALID_PARAMETER,"","parseConfigurationFile")
-					}
-
-					// get drive letter
-					char driveLetter;
-					int i = 0;
-					while(value[i]==' ') { i++;}
-					driveLetter = value[i];
-
-					// get network path and substitute environment variables
-					char networkPath[MAX_PATH];
-					strcpy(networkPath,value+equalsPosition+1);
-
-					// map network drive
-					LOGGER_LOG_DEBUG2("network drive '%s' = '%s'",driveLetter,networkPath)
-					cmdRunner->mapNetworkDrive(driveLetter,networkPath);
-				}
-				break;
-
-			case W_NEW_WINDOW:
-				// start in new window
-				cmdRunner->setStartInNewWindow(v.isLikeYes(value));
-				break;
-
-			case W_PATH:
-				// value of %PATH%
-				LOGGER_LOG_DEBUG2("'%s' = '%s'",PATH_NAME,value)
-				cmdRunner->addEnv(PATH_NAME,value);
-				pathSet = true;
-				break;
-
-			case W_PRIORITY:
-				if(!strcmp(value,"high")) { cmdRunner->setExecutionPriority(CmdRunner::HIGH_PRIORITY); }
-				else if(!strcmp(value,"idle")) { cmdRunner->setExecutionPriority(CmdRunner::IDLE_PRIORITY); }
-				else if(!strcmp(value,"normal")) { cmdRunner->setExecutionPriority(CmdRunner::NORMAL_PRIORITY); }
-				else if(!strcmp(value,"real")) { cmdRunner->setExecutionPriority(CmdRunner::REAL_PRIORITY); }
-				else
-				{
-					LOGGER_LOG_ERROR1("Invalid execution priority %s",value)
-					THROW_SRVSTART_EXCEPTION
-						(SRVSTART_EXCEPTION_INVALID_PARAMETER,"","parseConfigurationFile")
-				}
-				break;
-
-			case W_RESTART_INTERVAL:
-				// restart interval
-				if(v.isInteger(value))
-				{
-					cmdRunner->setAutoRestartInterval(atoi(value));
-				}
-				else
-				{
-					LOGGER_LOG_ERROR1("Invalid restart interval %s",value)
-					THROW_SRVSTART_EXCEPTION
-						(SRVSTART_EXCEPTION_INVALID_PARAMETER,"","parseConfigurationFile")
-				}
-				break;
-
-			case W_SHUTDOWN:
-				// shutdown command
-				cmdRunner->setShutdownCommand(value);
-				cmdRunner->setShutdownMethod(CmdRunner::SHUTDOWN_BY_COMMAND);
-				break;
-
-			case W_SHUTDOWN_METHOD:
-				// shutdown command
-				if(!strcmp(value,"kill")) { cmdRunner->setShutdownMethod(CmdRunner::SHUTDOWN_BY_KILL); }
-				else if(!strcmp(value,"command")) { cmdRunner->setShutdownMethod(CmdRunner::SHUTDOWN_BY_COMMAND); }
-				else if(!strcmp(value,"winmessage")) { cmdRunner->setShutdownMethod(CmdRunner::SHUTDOWN_BY_WINMESSAGE); }
-				else
-				{
-					LOGGER_LOG_ERROR1("Invalid shutdown method %s",value)
-					THROW_SRVSTART_EXCEPTION
-						(SRVSTART_EXCEPTION_INVALID_PARAMETER,"","parseConfigurationFile")
-				}
-				break;
-
-			case W_STARTUP:
-				// startup command
-				cmdRunner->setStartupCommand(value);
-				break;
-
-			case W_STARTUP_DELAY:
-				// startup delay
-				if(v.isInteger(value))
-				{
-					cmdRunner->setStartupDelay(atoi(value));
-				}
-				else
-				{
-					LOGGER_LOG_ERROR1("Invalid startup delay %s",value)
-					THROW_SRVSTART_EXCEPTION
-						(SRVSTART_EXCEPTION_INVALID_PARAMETER,"","parseConfigurationFile")
-				}
-				break;
-
-			case W_STARTUP_DIR:
-				// startup directory
-				cmdRunner->setStartupDirectory(value);
-				break;
-
-			case W_SYBASE:
-				// value of %SYBASE%
-				{
-					char tmp[MAX_ARG_SIZE];
-					cmdRunner->addEnv(SYBASE_NAME,value);
-					if(!libDirSet)
-					{
-						getDefaultLibDir(value,tmp);
-						LOGGER_LOG_DEBUG1("lib dir not set, using default '%s'",tmp)
-						cmdRunner->addEnv(LIBDIR_NAME,tmp);
-						libDirSet = true;
-					}
-					if(!pathSet)
-					{
-						getDefaultPath(value,tmp);
-						LOGGER_LOG_DEBUG1("path not set, using default '%s'",tmp)
-						cmdRunner->addEnv(PATH_NAME,tmp);
-						pathSet = true;
-					}
-				}
-				break;
-
-			case W_SYBPATH:
-				// value of %PATH% based on %SYBASE%
-				{
-					char tmp[MAX_ARG_SIZE];
-					getDefaultPath(value,tmp);
-					cmdRunner->addEnv(PATH_NAME,tmp);
-					pathSet = true;
-				}
-				break;
-
-			case W_WAIT:
-				// wait command
-				cmdRunner->setWaitCommand(value);
-				break;
-
-			case W_WAIT_TIME:
-				// wait interval
-				if(v.isInteger(value))
-				{
-					cmdRunner->setWaitInterval(atoi(value));
-				}
-				else
-				{
-					LOGGER_LOG_ERROR1("Invalid wait interval %s",value)
-					THROW_SRVSTART_EXCEPTION
-						(SRVSTART_EXCEPTION_INVALID_PARAMETER,"","parseConfigurationFile")
-				}
-				break;
-
-			default:
-				LOGGER_LOG_ERROR2("Invalid directive '%s' = '%s'",directive,value)
-				THROW_SRVSTART_EXCEPTION
-					(SRVSTART_EXCEPTION_INVALID_PARAMETER,"","parseConfigurationFile")
-				break;
-
-		}
-	}
-
+	reloader->load(cmdRunner,configFile);
 }
 
 // ============================================================================
 //
-// FUNCTION        : getDefaultLibDir
-//
-// DESCRIPTION     : return default LIB directory based on given value of %SYBASE%
-//
-// ARGUMENTS       : sybase        IN  value of %SYBASE%
-//                   defaultLibDir OUT default LIB directory 
-//
-// ============================================================================
-void getDefaultLibDir
-(
-	char sybase[],
-	char defaultLibDir[]
-)
-{
-	sprintf(defaultLibDir,"%s\\lib",sybase);
-	LOGGER_LOG_DEBUG1("default LIB is '%s'",defaultLibDir)
-}
-
-// ============================================================================
+// FUNCTION        : compileConfigurationFile
 //
-// FUNCTION        : getDefaultPath
+// DESCRIPTION     : compile a configuration file (every section) into an image
+//                   which services using the file will load instead
 //
-// DESCRIPTION     : return default PATH based on given value of %SYBASE%
+// ARGUMENTS       : configFile IN name of configuration file
 //
-// ARGUMENTS       : sybase      IN  value of %SYBASE%
-//                   defaultPath OUT default PATH
+// THROWS          : SrvStartException
 //
 // ============================================================================
-void getDefaultPath
+void compileConfigurationFile
 (
-	char sybase[],
-	char defaultPath[]
-)
+	char configFile[]
+) throw(SrvStartException)
 {
-	char *systemRoot;
-
-	// get the location of the Windows NT directory
-	systemRoot = getenv("SYSTEMROOT");
-	LOGGER_LOG_DEBUG1("systemRoot is '%s'",systemRoot)
-
-	// build up the default path
-	sprintf(defaultPath,"%s\\install;%s\\bin;%s\\dll;%s;%s\\system32",
-				sybase,sybase,sybase,systemRoot,systemRoot);
-	LOGGER_LOG_DEBUG1("default PATH is '%s'",defaultPath)
+	StringArena arena;
+	char *imagePath = arena.append(arena.copy(configFile),COMPILED_CONFIGURATION_SUFFIX);
+	int   services  = CompiledConfiguration::compile(configFile,imagePath);
+	cout << "compiled " << services << " service(s) from '" << configFile
+		 << "' into '" << imagePath << "'\n";
 }
 
 // ============================================================================
@@ -1294,7 +1050,10 @@ void getDefaultPath
 //
 // DESCRIPTION     : install a srvstart.exe-based service with given parameters
 //
-// ARGUMENTS       : serviceName    IN  service name
+//                   If several services are named (separated by commas), each
+//                   of them is installed to share one srvstart.exe process.
+//
+// ARGUMENTS       : serviceName    IN  service name (or names)
 //                   desktopService IN can this service interact with the desktop?
 //                   argList        IN argument list
 //
@@ -1318,12 +1077,6 @@ void installService
 			(SRVSTART_EXCEPTION_GENERAL_ERROR,"","installService")
 	}
 
-	// ServiceManager object
-	ServiceManager serviceManager(serviceName);
-
-	// assign binary path name
-	serviceManager.setBinaryPath(thisExe);
-
 	// get name of control file
 	ArgumentList::ArgumentTypes argType;
 	char                        arg[MAX_ARG_SIZE];
@@ -1338,12 +1091,7 @@ void installService
 			argList.popNextArgument(argType,ArgumentList::AL_IS_FILE,isValid,arg);
 			if(isValid)
 			{
-				// add the parameter
 				LOGGER_LOG_DEBUG1("control file '%s' exists",arg)
-				serviceManager.addBinaryPathParameter("svc");
-				serviceManager.addBinaryPathParameter(serviceName);
-				serviceManager.addBinaryPathParameter("-c");
-				serviceManager.addBinaryPathParameter(arg);
 			}
 			else
 			{
@@ -1365,11 +1113,31 @@ void installService
 		printSyntaxAndExit(false);
 	}
 
-	// set desktop interaction
-	serviceManager.setDesktopService(desktopService);
+	// install each service named - they all run the same command line
+	StringArena arena;
+	char *svcNames      = arena.copy(serviceName);
+	bool  sharedProcess = (strpbrk(serviceName,SERVICE_LIST_SEPARATORS)!=0);
 
-	// install service (will throw exception if does not work)
-	serviceManager.install();
+	for(char *svcName=strtok(svcNames,SERVICE_LIST_SEPARATORS); svcName!=0;
+		svcName=strtok(0,SERVICE_LIST_SEPARATORS))
+	{
+		// ServiceManager object
+		ServiceManager serviceManager(svcName);
+
+		// assign binary path name, and add the parameters
+		serviceManager.setBinaryPath(thisExe);
+		serviceManager.addBinaryPathParameter("svc");
+		serviceManager.addBinaryPathParameter(serviceName);
+		serviceManager.addBinaryPathParameter("-c");
+		serviceManager.addBinaryPathParameter(arg);
+
+		// set desktop interaction, and whether the process is shared
+		serviceManager.setDesktopService(desktopService);
+		serviceManager.setSharedProcess(sharedProcess);
+
+		// install service (will throw exception if does not work)
+		serviceManager.install();
+	}
 
 	return;
 }
@@ -1380,7 +1148,7 @@ void installService
 //
 // DESCRIPTION     : remove a (srvstart.exe-based) service with given name
 //
-// ARGUMENTS       : serviceName IN service name
+// ARGUMENTS       : serviceName IN service name (or names, separated by commas)
 //
 // ============================================================================
 void removeService
@@ -1390,11 +1158,379 @@ void removeService
 {
 	LOGGER_LOG_DEBUG1("removeService(%s)",serviceName)
 
-	// ServiceManager object
-	ServiceManager serviceManager(serviceName);
+	StringArena arena;
+	char *svcNames = arena.copy(serviceName);
+
+	for(char *svcName=strtok(svcNames,SERVICE_LIST_SEPARATORS); svcName!=0;
+		svcName=strtok(0,SERVICE_LIST_SEPARATORS))
+	{
+		// ServiceManager object
+		ServiceManager serviceManager(svcName);
+
+		// remove service (will throw exception if does not work)
+		serviceManager.remove();
+	}
+
+	return;
+}
+
+// ============================================================================
+//
+// FUNCTION        : applyManifest
+//
+// DESCRIPTION     : install, modify and remove the services in a manifest, as
+//                   one batch (see ServiceBatch)
+//
+//                   A manifest is a configuration file with a section for each
+//                   service;  the directives in no section apply to every
+//                   service, unless its own section says otherwise:
+//
+//                      control_file  control file for the service (as -c)
+//                      display_name  display name (default is the service name)
+//                      start         auto, demand (the default) or disabled
+//                      desktop       can the service interact with the desktop?
+//                      remove        the service should not be installed at all
+//
+//                   The batch journal is kept in manifest.journal until the
+//                   batch has been applied (or rolled back).
+//
+// ARGUMENTS       : manifest   IN manifest path name
+//                   dryRun     IN only print what would be done
+//                   maxThreads IN number of services installed at once
+//                   argList    IN argument list (for the path of this program)
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+void applyManifest
+(
+	char          manifest[],
+	bool          dryRun,
+	int           maxThreads,
+	ArgumentList &argList
+) throw(SrvStartException)
+{
+	LOGGER_LOG_DEBUG3("applyManifest(%s,%d,%d)",manifest,dryRun,maxThreads)
+
+	// get path name of this executable
+	char thisExe[_MAX_PATH];
+	if(!argList.getExeFullPath(thisExe))
+	{
+		// failed to get full path
+		LOGGER_LOG_ERROR("Failed to get full path of SrvStart executable - you must run this from a command prompt")
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_GENERAL_ERROR,"","applyManifest")
+	}
+
+	ConfigurationFile cf;
+	if(!cf.openConfigurationFile(manifest))
+	{
+		LOGGER_LOG_ERROR1("failed to open manifest '%s'",manifest)
+		THROW_SRVSTART_EXCEPTION
+			(SRVSTART_EXCEPTION_INVALID_PARAMETER,"","applyManifest")
+	}
+
+	// each section is a service
+	ServiceBatch batch;
+	Validation   v;
+	StringArena  arena;
+	for(int i=0; i<cf.getSectionCount(); i++)
+	{
+		int         length;
+		const char *name = cf.getSectionName(i,length);
+		char        section[CFGFILE_SECTION_SIZE];
+		if((length==0)||(length>=CFGFILE_SECTION_SIZE))
+		{
+			LOGGER_LOG_INFO2("ignoring section '%.*s'",(length<CFGFILE_SECTION_SIZE ? length : CFGFILE_SECTION_SIZE-1),name)
+			continue;
+		}
+		memcpy(section,name,length);
+		section[length] = '\0';
+
+		// the service's directives (after the defaults)
+		const char              *controlFile = 0, *displayName = 0;
+		ServiceBatch::START_TYPES startType   = ServiceBatch::START_DEMAND;
+		bool                      desktop     = false, remove = false;
+		ConfigurationDirective    next;
+		cf.setRequestedSection(section);
+		while(cf.getNextConfigurationDirective(next))
+		{
+			// the value points into the file - copy it
+			char *value = arena.allocate(next.valueLength);
+			memcpy(value,next.value,next.valueLength);
+			value[next.valueLength] = '\0';
+
+			if((next.nameLength==12)&&(!_strnicmp(next.name,"control_file",12)))
+			{
+				controlFile = value;
+			}
+			else if((next.nameLength==12)&&(!_strnicmp(next.name,"display_name",12)))
+			{
+				displayName = value;
+			}
+			else if((next.nameLength==5)&&(!_strnicmp(next.name,"start",5)))
+			{
+				if(!_stricmp(value,"auto"))          { startType = ServiceBatch::START_AUTO; }
+				else if(!_stricmp(value,"demand"))   { startType = ServiceBatch::START_DEMAND; }
+				else if(!_stricmp(value,"disabled")) { startType = ServiceBatch::START_DISABLED; }
+				else
+				{
+					LOGGER_LOG_ERROR2("Invalid start '%s' for service '%s'",value,section)
+					THROW_SRVSTART_EXCEPTION
+						(SRVSTART_EXCEPTION_INVALID_PARAMETER,"","applyManifest")
+				}
+			}
+			else if((next.nameLength==7)&&(!_strnicmp(next.name,"desktop",7)))
+			{
+				desktop = v.isLikeYes(value);
+			}
+			else if((next.nameLength==6)&&(!_strnicmp(next.name,"remove",6)))
+			{
+				remove = v.isLikeYes(value);
+			}
+			else
+			{
+				LOGGER_LOG_ERROR3("Invalid directive '%.*s' for service '%s'",next.nameLength,next.name,section)
+				THROW_SRVSTART_EXCEPTION
+					(SRVSTART_EXCEPTION_INVALID_PARAMETER,"","applyManifest")
+			}
+		}
+
+		if(remove)
+		{
+			batch.addRemoval(section);
+			continue;
+		}
 
-	// remove service (will throw exception if does not work)
-	serviceManager.remove();
+		// the service runs this program, with its control file (as install mode)
+		char controlPath[_MAX_PATH];
+		if((controlFile==0)||(_fullpath(controlPath,controlFile,sizeof(controlPath))==0))
+		{
+			LOGGER_LOG_ERROR1("Missing or invalid control_file for service '%s'",section)
+			THROW_SRVSTART_EXCEPTION
+				(SRVSTART_EXCEPTION_INVALID_PARAMETER,"","applyManifest")
+		}
+		if(!v.isRegularFile(controlPath))
+		{
+			LOGGER_LOG_INFO2("WARNING: control file '%s' for service '%s' not found",controlPath,section)
+		}
+		char *binaryPath = arena.copy(thisExe);
+		binaryPath = arena.append(binaryPath,"svc",true);
+		binaryPath = arena.append(binaryPath,section,true);
+		binaryPath = arena.append(binaryPath,"-c",true);
+		binaryPath = arena.append(binaryPath,controlPath,true);
+		batch.addService(section,displayName,binaryPath,startType,desktop);
+	}
+
+	// compare the manifest with the services as they are now
+	int actions = batch.plan();
+	if(dryRun||(actions==0))
+	{
+		batch.describe(printBatchLine,0);
+		cout << actions << " services to install, modify or remove" << (dryRun ? " (dry run)" : "") << "\n";
+		return;
+	}
+
+	// apply it (the batch rolls itself back if it fails)
+	string journal = string(manifest)+JOURNAL_SUFFIX;
+	batch.describe(printBatchLine,0);
+	batch.apply(journal.c_str(),maxThreads);
 
 	return;
 }
+
+// ============================================================================
+//
+// FUNCTION        : rollbackManifest
+//
+// DESCRIPTION     : undo a batch applied from a manifest which did not finish
+//                   (and whose journal was therefore kept)
+//
+// ARGUMENTS       : manifest IN manifest path name
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+void rollbackManifest
+(
+	char manifest[]
+) throw(SrvStartException)
+{
+	LOGGER_LOG_DEBUG1("rollbackManifest(%s)",manifest)
+
+	string journal = string(manifest)+JOURNAL_SUFFIX;
+	ServiceBatch::rollback(journal.c_str());
+
+	return;
+}
+
+// ============================================================================
+//
+// FUNCTION        : printBatchLine
+//
+// DESCRIPTION     : print a line describing a service batch (see applyManifest)
+//
+// ARGUMENTS       : line   IN line to print
+//                   unused IN not used
+//
+// ============================================================================
+void printBatchLine
+(
+	const char *line,
+	void       *unused
+)
+{
+	cout << line << "\n";
+}
+
+// ============================================================================
+//
+// FUNCTION        : hostServices
+//
+// DESCRIPTION     : run several services in this process
+//                   (SERVICE_WIN32_SHARE_PROCESS - see install mode)
+//
+//                   Each service runs on a thread of its own, with its own
+//                   CmdRunner, and takes its definition from its own section
+//                   of the configuration file.  A service the SCM does not
+//                   start is given up when all the others have stopped.
+//
+// ARGUMENTS       : svcList IN service names, separated by commas
+//                   argList IN argument list (the same for every service)
+//
+// RETURNS         : true if every service ran and stopped successfully
+//
+// THROWS          : SrvStartException
+//
+// ============================================================================
+bool hostServices
+(
+	char         *svcList,
+	ArgumentList  argList
+) throw(SrvStartException)
+{
+	LOGGER_LOG_DEBUG1("hostServices(%s)",svcList)
+
+	// split the list
+	StringArena arena;
+	char *svcNames = arena.copy(svcList);
+	int   svcCount = 0;
+	char *svcName;
+	char **svcNameArray = new char*[strlen(svcList)];
+
+	for(svcName=strtok(svcNames,SERVICE_LIST_SEPARATORS); svcName!=0;
+		svcName=strtok(0,SERVICE_LIST_SEPARATORS))
+	{
+		svcNameArray[svcCount++] = svcName;
+	}
+
+	// tell the SCM connection about them all, before any of them connects
+	ScmConnector::setSharedServices(svcNameArray,svcCount);
+
+	// log startup information
+	LOGGER_LOG_INFO4("%s version %s %s (%s)",
+		const_cast<char*>(getApplication()),
+		const_cast<char*>(getVersion()),
+		const_cast<char*>(getCopyright()),
+		const_cast<char*>(getDistribution()))
+	LOGGER_LOG_INFO2("hosting %d services (%s)",svcCount,svcList)
+
+	// start a thread for each service, and wait for them all to finish
+	HostedService *hostedServices = new HostedService[svcCount];
+	HANDLE        *threads        = new HANDLE[svcCount];
+	bool           success        = true;
+	int            i;
+
+	InitializeCriticalSection(&G_parseLock);
+
+	for(i=0; i<svcCount; i++)
+	{
+		hostedServices[i].svcName = svcNameArray[i];
+		hostedServices[i].argList = &argList;
+		hostedServices[i].success = false;
+		threads[i] = (HANDLE)_beginthreadex(NULL,0,hostedServiceMain,&hostedServices[i],0,NULL);
+		if(threads[i]==0)
+		{
+			LOGGER_LOG_ERROR2("failed to create thread for service '%s', error = %d",
+				svcNameArray[i],errno)
+		}
+	}
+
+	for(i=0; i<svcCount; i++)
+	{
+		if(threads[i]!=0)
+		{
+			(void)WaitForSingleObject(threads[i],INFINITE);
+			CloseHandle(threads[i]);
+		}
+		success = success&&hostedServices[i].success;
+	}
+
+	DeleteCriticalSection(&G_parseLock);
+
+	delete[] threads;
+	delete[] hostedServices;
+	delete[] svcNameArray;
+
+	return success;
+}
+
+// ============================================================================
+//
+// FUNCTION        : hostedServiceMain
+//
+// DESCRIPTION     : thread entry point for one of the services hosted by this
+//                   process - returns when the service has stopped
+//
+//                   The arguments are parsed one service at a time, since
+//                   parsing uses static buffers.
+//
+// ARGUMENTS       : arg IN the HostedService
+//
+// RETURNS         : 0
+//
+// ============================================================================
+unsigned __stdcall hostedServiceMain
+(
+	void *arg
+)
+{
+	HostedService *hostedService = (HostedService*)arg;
+
+	LOGGER_LOG_DEBUG1("hostedServiceMain(%s)",hostedService->svcName)
+
+	try
+	{
+		// create CmdRunner object (returns when the SCM starts the service)
+		CmdRunner cmdRunner(CmdRunner::SERVICE_MODE,hostedService->svcName);
+
+		// parse remaining command line arguments (includes reading configuration file)
+		EnterCriticalSection(&G_parseLock);
+		try
+		{
+			parseArgv(&cmdRunner,*hostedService->argList,&hostedService->configurationReloader);
+		}
+		catch(...)
+		{
+			LeaveCriticalSection(&G_parseLock);
+			throw;
+		}
+		LeaveCriticalSection(&G_parseLock);
+
+		// start cmdRunner
+		cmdRunner.start();
+
+		hostedService->success = true;
+	}
+	catch(SrvStartException e)
+	{
+		// an exception has been trapped - log it
+		LOGGER_LOG_ERROR1("service '%s' failed",hostedService->svcName)
+		LOGGER_LOG_ERROR3("Exception %d trapped in source file '%s' line %d",
+		 					e.exceptionId,e.sourceFile,e.lineNumber)
+		LOGGER_LOG_ERROR2("Class '%s' method '%s'",e.className,e.methodName)
+		LOGGER_LOG_ERROR1("%s",e.errorMessage)
+	}
+
+	return 0;
+}
@@ -93,14 +93,26 @@ SOURCE=.\ArgumentList.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\CompiledConfiguration.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\ConfigurationFile.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\ConfigurationReloader.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\exe.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\ServiceDefinition.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\Validation.cpp
 # End Source File
 # End Group
@@ -113,10 +125,26 @@ SOURCE=.\ArgumentList.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\CompiledConfiguration.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\ConfigurationFile.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\ConfigurationReloader.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\KeywordTable.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\ServiceDefinition.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\Validation.h
 # End Source File
 # End Group
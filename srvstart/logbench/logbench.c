@@ -0,0 +1,754 @@
+/******************************************************************************
+**
+** FILE        : logbench.c
+**
+** AUTHOR      : Nick Rozanski
+**
+** DESCRIPTION : Measure the throughput and caller latency of the Logger
+**
+**               Each scenario configures the default logger, starts a number
+**               of threads which each call LoggerWriteMessage in a tight loop,
+**               and times every call.  The scenarios are every combination of
+**
+**                 destination  stdout, file (LOGGER_ANSI_FILENAME), filehandle
+**                              (LOGGER_WIN32_FILEHANDLE on Windows NT,
+**                              LOGGER_ANSI_FILEPTR on Linux) and syslog
+**                              (LOGGER_SYSLOG_SOCKET)
+**                 mode         emitted, or filtered out by a class filter
+**                 payload      short, or long (close to LOGGER_BUFFERSIZE)
+**                 threads      1, 2, 4, 8, 16 and 32
+**
+**               One result is written per scenario, as CSV or as JSON lines,
+**               so that runs can be compared to track regressions.  This is a
+**               benchmark, not a test:  nothing is checked.
+**
+** SYNOPSIS    : logbench [-j] [-o <results>] [-n <messages>] [-t <threads>]
+**                        [-d <destinations>] [-w <directory>] [-s <address>]
+**                        [-b <batch>]
+**
+**               -j  write JSON lines (default CSV)
+**               -o  results file (default logbench.csv, or logbench.json with -j)
+**               -n  messages per scenario, shared between the threads
+**                   (default 20000)
+**               -t  comma-separated thread counts (default 1,2,4,8,16,32)
+**               -d  comma-separated destinations (default stdout,file,filehandle,syslog)
+**               -w  directory for the log files (default the current directory)
+**               -s  syslog address (default as for LOGGER_SYSLOG_SOCKET);  a
+**                   destination which cannot be configured is skipped
+**               -b  batch the writes to the file destinations, up to <batch>
+**                   messages at a time (see LoggerSetBatching)
+**
+**               The results are never written to stdout, because one of the
+**               destinations is stdout.  Progress is written to stderr.
+**
+** MODIFICATION HISTORY
+** --------------------
+**
+**  Refer to master header file logger.h for full modification history.
+**
+** DISTRIBUTION
+** ------------
+** Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+** Distributed under the terms of the GNU General Public License
+**  as published by the Free Software Foundation
+**  (675 Mass Ave, Cambridge, MA 02139, USA)
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT
+** ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+** or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+** License for more details.
+**
+******************************************************************************/
+
+/******************************************************************************
+**                                                                           **
+** ANSI HEADER FILES                                                         **
+**                                                                           **
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/******************************************************************************
+**                                                                           **
+** PLATFORM HEADER FILES                                                     **
+**                                                                           **
+******************************************************************************/
+
+#if defined(WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+/******************************************************************************
+**                                                                           **
+** APPLICATION HEADER FILES                                                  **
+**                                                                           **
+******************************************************************************/
+
+#include <logger.h>
+
+/******************************************************************************
+**                                                                           **
+** LOCAL MACROS                                                              **
+**                                                                           **
+******************************************************************************/
+
+#define	TRUE	1
+#define	FALSE	0
+
+#define	EOS		'\0'
+
+#define	MAX_THREADS		32
+#define	MAX_PATH_SIZE	1000
+#define	SHORT_PAYLOAD	32
+#define	LONG_PAYLOAD	(LOGGER_BUFFERSIZE-1100)	/* leaves room for the Logger's fields */
+
+#if defined(WIN32)
+#define	YIELD			Sleep(0);
+#else
+#define	YIELD			sched_yield();
+#endif
+
+/******************************************************************************
+**                                                                           **
+** TYPES                                                                     **
+**                                                                           **
+******************************************************************************/
+
+/* one benchmark thread */
+typedef struct
+{
+	int            messages;     /* number of messages to write */
+	int            msg_class;    /* LOGGER_INFO */
+	const char*    payload;      /* message text */
+	unsigned long* latency;      /* OUT: nanoseconds per call */
+} worker;
+
+/* the result of one scenario */
+typedef struct
+{
+	const char*    destination;
+	int            threads;
+	const char*    mode;
+	const char*    payload;
+	int            messages;
+	double         seconds;
+	unsigned long  p50;
+	unsigned long  p99;
+	unsigned long  p999;
+	unsigned long  max;
+} result;
+
+/******************************************************************************
+**                                                                           **
+** STATIC DATA                                                               **
+**                                                                           **
+******************************************************************************/
+
+static volatile int start_flag = FALSE;    /* released when all threads exist */
+
+/******************************************************************************
+**                                                                           **
+** FUNCTION PROTOTYPES                                                       **
+**                                                                           **
+******************************************************************************/
+
+int    configure(const char* destination, const char* directory, const char* address, void** handle);
+void   unconfigure(void* handle);
+int    run_scenario(int threads, int messages, const char* payload, result* res);
+void   write_result(FILE* out, int json, const result* res);
+int    parse_list(const char* text, int* values, int max_values);
+int    compare_latency(const void* a, const void* b);
+unsigned long percentile(const unsigned long* sorted, unsigned long count, double fraction);
+double now_seconds();
+#if defined(WIN32)
+DWORD WINAPI worker_thread(LPVOID parameter);
+#else
+void*  worker_thread(void* parameter);
+#endif
+
+/******************************************************************************
+**
+** FUNCTION    : main
+**
+** DESCRIPTION : logbench program entry point
+**
+** ARGUMENTS   : argc    number of command-line arguments
+**               argv    command-line argument vector
+**
+** RETURNS     : 0 for success, 1 for failure
+**
+******************************************************************************/
+int main
+(
+	int   argc,
+	char* argv[]
+)
+{
+	const char* results_file = NULL;
+	const char* destinations = "stdout,file,filehandle,syslog";
+	const char* directory = ".";
+	const char* address = NULL;
+	int         json = FALSE;
+	int         messages = 20000;
+	int         batch = 0;
+	int         thread_counts[MAX_THREADS];
+	int         thread_count_count;
+	char        list[MAX_PATH_SIZE];
+	char*       destination;
+	char*       payload_short;
+	char*       payload_long;
+	const char* payload;
+	void*       handle;
+	FILE*       out;
+	result      res;
+	int         filtered;
+	int         long_payload;
+	int         i;
+	int         arg;
+
+	thread_count_count = parse_list("1,2,4,8,16,32", thread_counts, MAX_THREADS);
+
+	/* options */
+	for (arg = 1; arg < argc; arg++)
+	{
+		if (!strcmp(argv[arg], "-j"))
+		{
+			json = TRUE;
+		}
+		else if ((arg < argc - 1) && (!strcmp(argv[arg], "-o")))
+		{
+			results_file = argv[++arg];
+		}
+		else if ((arg < argc - 1) && (!strcmp(argv[arg], "-n")))
+		{
+			messages = atoi(argv[++arg]);
+		}
+		else if ((arg < argc - 1) && (!strcmp(argv[arg], "-t")))
+		{
+			thread_count_count = parse_list(argv[++arg], thread_counts, MAX_THREADS);
+		}
+		else if ((arg < argc - 1) && (!strcmp(argv[arg], "-d")))
+		{
+			destinations = argv[++arg];
+		}
+		else if ((arg < argc - 1) && (!strcmp(argv[arg], "-w")))
+		{
+			directory = argv[++arg];
+		}
+		else if ((arg < argc - 1) && (!strcmp(argv[arg], "-s")))
+		{
+			address = argv[++arg];
+		}
+		else if ((arg < argc - 1) && (!strcmp(argv[arg], "-b")))
+		{
+			batch = atoi(argv[++arg]);
+		}
+		else
+		{
+			fprintf(stderr, "usage: logbench [-j] [-o <results>] [-n <messages>] [-t <threads>]\n"
+							"                [-d <destinations>] [-w <directory>] [-s <address>]\n"
+							"                [-b <batch>]\n");
+			return 1;
+		}
+	}
+	if ((messages <= 0) || (thread_count_count <= 0) || (strlen(destinations) >= sizeof(list)))
+	{
+		fprintf(stderr, "ERROR - invalid message count, thread counts or destinations\n");
+		return 1;
+	}
+	if ((batch > 1) && (!LoggerSetBatching(batch, 0)))
+	{
+		fprintf(stderr, "ERROR - cannot switch batching on\n");
+		return 1;
+	}
+	if (results_file == NULL)
+	{
+		results_file = json ? "logbench.json" : "logbench.csv";
+	}
+
+	/* the payloads */
+	payload_short = (char*)malloc(SHORT_PAYLOAD + 1);
+	payload_long = (char*)malloc(LONG_PAYLOAD + 1);
+	if ((payload_short == NULL) || (payload_long == NULL))
+	{
+		fprintf(stderr, "ERROR - out of memory\n");
+		return 1;
+	}
+	for (i = 0; i < LONG_PAYLOAD; i++)
+	{
+		payload_long[i] = (char)('a' + (i % 26));
+	}
+	payload_long[LONG_PAYLOAD] = EOS;
+	memcpy(payload_short, payload_long, SHORT_PAYLOAD);
+	payload_short[SHORT_PAYLOAD] = EOS;
+
+	if ((out = fopen(results_file, "w")) == NULL)
+	{
+		fprintf(stderr, "ERROR - cannot open '%s'\n", results_file);
+		return 1;
+	}
+	if (!json)
+	{
+		fprintf(out, "destination,threads,mode,payload,messages,seconds,msgs_per_sec,p50_ns,p99_ns,p999_ns,max_ns\n");
+	}
+
+	/* every scenario */
+	strcpy(list, destinations);
+	for (destination = strtok(list, ","); destination != NULL; destination = strtok(NULL, ","))
+	{
+		for (filtered = FALSE; filtered <= TRUE; filtered++)
+		{
+			for (long_payload = FALSE; long_payload <= TRUE; long_payload++)
+			{
+				payload = long_payload ? payload_long : payload_short;
+				for (i = 0; i < thread_count_count; i++)
+				{
+					/* start each scenario with an empty log file */
+					if (!configure(destination, directory, address, &handle))
+					{
+						fprintf(stderr, "skipping destination '%s' - it cannot be configured\n", destination);
+						goto next_destination;
+					}
+					if (filtered)
+					{
+						/* only errors pass, and the benchmark writes information messages */
+						LoggerSetFilter(LOGGER_DEFAULT_LOGGER, 0, LOGGER_ERROR_FILTER, -1, -1, NULL, NULL);
+					}
+
+					res.destination = destination;
+					res.mode = filtered ? "filtered" : "emitted";
+					res.payload = long_payload ? "long" : "short";
+					if (run_scenario(thread_counts[i], messages, payload, &res))
+					{
+						write_result(out, json, &res);
+						fflush(out);
+						fprintf(stderr, "%s %s %s %d threads: %.0f msgs/sec\n", res.destination, res.mode,
+							res.payload, res.threads, res.messages / res.seconds);
+					}
+					unconfigure(handle);
+				}
+			}
+		}
+	next_destination:
+		;
+	}
+
+	fclose(out);
+	free(payload_short);
+	free(payload_long);
+	return 0;
+}
+
+/******************************************************************************
+**
+** FUNCTION    : configure
+**
+** DESCRIPTION : configure the default logger for a destination
+**
+** ARGUMENTS   : destination  stdout, file, filehandle or syslog
+**               directory    the directory for log files
+**               address      the syslog address (NULL for the default)
+**               handle       returns the file opened for filehandle (or NULL)
+**
+** RETURNS     : TRUE for success, FALSE for failure
+**
+******************************************************************************/
+int configure
+(
+	const char*  destination,
+	const char*  directory,
+	const char*  address,
+	void**       handle
+)
+{
+	char  path[MAX_PATH_SIZE];
+	char  error_msg[300];
+	int   error;
+	int   truncate = TRUE;
+#if defined(WIN32)
+	HANDLE file;
+#endif
+
+	*handle = NULL;
+	if (strlen(directory) + 20 >= sizeof(path))
+	{
+		return FALSE;
+	}
+
+	if (!strcmp(destination, "stdout"))
+	{
+		return LoggerConfigure(LOGGER_DEFAULT_LOGGER, "bench", "logbench", LOGGER_ANSI_STDOUT,
+					NULL, NULL, &error, error_msg);
+	}
+	if (!strcmp(destination, "file"))
+	{
+		sprintf(path, "%s/logbench.log", directory);
+		return LoggerConfigure(LOGGER_DEFAULT_LOGGER, "bench", "logbench", LOGGER_ANSI_FILENAME,
+					path, &truncate, &error, error_msg);
+	}
+	if (!strcmp(destination, "filehandle"))
+	{
+		sprintf(path, "%s/logbench_handle.log", directory);
+#if defined(WIN32)
+		file = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+					NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return FALSE;
+		}
+		*handle = (void*)file;
+		return LoggerConfigure(LOGGER_DEFAULT_LOGGER, "bench", "logbench", LOGGER_WIN32_FILEHANDLE,
+					handle, NULL, &error, error_msg);
+#else
+		if ((*handle = (void*)fopen(path, "w")) == NULL)
+		{
+			return FALSE;
+		}
+		return LoggerConfigure(LOGGER_DEFAULT_LOGGER, "bench", "logbench", LOGGER_ANSI_FILEPTR,
+					*handle, NULL, &error, error_msg);
+#endif
+	}
+	if (!strcmp(destination, "syslog"))
+	{
+		return LoggerConfigure(LOGGER_DEFAULT_LOGGER, "bench", "logbench", LOGGER_SYSLOG_SOCKET,
+					(void*)address, NULL, &error, error_msg);
+	}
+
+	return FALSE;
+}
+
+/******************************************************************************
+**
+** FUNCTION    : unconfigure
+**
+** DESCRIPTION : switch the default logger off, and close any file opened by
+**               configure
+**
+** ARGUMENTS   : handle   as returned by configure
+**
+** RETURNS     : n/a
+**
+******************************************************************************/
+void unconfigure
+(
+	void*  handle
+)
+{
+	int error;
+
+	LoggerConfigure(LOGGER_DEFAULT_LOGGER, NULL, NULL, LOGGER_NONE, NULL, NULL, &error, NULL);
+	if (handle != NULL)
+	{
+#if defined(WIN32)
+		CloseHandle((HANDLE)handle);
+#else
+		fclose((FILE*)handle);
+#endif
+	}
+}
+
+/******************************************************************************
+**
+** FUNCTION    : run_scenario
+**
+** DESCRIPTION : run the threads of one scenario, and summarise their timings
+**
+** ARGUMENTS   : threads   number of threads
+**               messages  total number of messages (shared between the threads)
+**               payload   message text
+**               res       returns the result (threads, messages and timings)
+**
+** RETURNS     : TRUE for success, FALSE for failure (a message has been printed)
+**
+******************************************************************************/
+int run_scenario
+(
+	int          threads,
+	int          messages,
+	const char*  payload,
+	result*      res
+)
+{
+	worker         workers[MAX_THREADS];
+	unsigned long* latency;
+	unsigned long  total = 0;
+	double         started;
+	int            i;
+#if defined(WIN32)
+	HANDLE         handles[MAX_THREADS];
+#else
+	pthread_t      handles[MAX_THREADS];
+#endif
+
+	if ((threads < 1) || (threads > MAX_THREADS))
+	{
+		fprintf(stderr, "ERROR - thread count %d is not in the range 1..%d\n", threads, MAX_THREADS);
+		return FALSE;
+	}
+	if ((latency = (unsigned long*)malloc(messages * sizeof(unsigned long))) == NULL)
+	{
+		fprintf(stderr, "ERROR - out of memory\n");
+		return FALSE;
+	}
+
+	/* each thread gets its share of the messages, and of the latency array */
+	start_flag = FALSE;
+	for (i = 0; i < threads; i++)
+	{
+		workers[i].messages = messages / threads + ((i < messages % threads) ? 1 : 0);
+		workers[i].msg_class = LOGGER_INFO;
+		workers[i].payload = payload;
+		workers[i].latency = latency + total;
+		total += workers[i].messages;
+#if defined(WIN32)
+		handles[i] = CreateThread(NULL, 0, worker_thread, &workers[i], 0, NULL);
+		if (handles[i] == NULL)
+#else
+		if (pthread_create(&handles[i], NULL, worker_thread, &workers[i]) != 0)
+#endif
+		{
+			fprintf(stderr, "ERROR - cannot start thread %d\n", i);
+			exit(1);
+		}
+	}
+
+	/* release the threads together, and wait for them all to finish */
+	started = now_seconds();
+	start_flag = TRUE;
+#if defined(WIN32)
+	WaitForMultipleObjects(threads, handles, TRUE, INFINITE);
+	for (i = 0; i < threads; i++)
+	{
+		CloseHandle(handles[i]);
+	}
+#else
+	for (i = 0; i < threads; i++)
+	{
+		pthread_join(handles[i], NULL);
+	}
+#endif
+	res->seconds = now_seconds() - started;
+
+	/* percentiles over every call */
+	qsort(latency, total, sizeof(unsigned long), compare_latency);
+	res->threads = threads;
+	res->messages = (int)total;
+	res->p50 = percentile(latency, total, 0.50);
+	res->p99 = percentile(latency, total, 0.99);
+	res->p999 = percentile(latency, total, 0.999);
+	res->max = latency[total - 1];
+
+	free(latency);
+	return TRUE;
+}
+
+/******************************************************************************
+**
+** FUNCTION    : worker_thread
+**
+** DESCRIPTION : write a thread's share of the messages, timing each call
+**
+** ARGUMENTS   : parameter  the worker
+**
+** RETURNS     : 0
+**
+******************************************************************************/
+#if defined(WIN32)
+DWORD WINAPI worker_thread(LPVOID parameter)
+#else
+void* worker_thread(void* parameter)
+#endif
+{
+	worker* me = (worker*)parameter;
+	double  before;
+	double  after;
+	int     i;
+
+	while (!start_flag)
+	{
+		YIELD
+	}
+
+	for (i = 0; i < me->messages; i++)
+	{
+		before = now_seconds();
+		LoggerWriteMessage(me->msg_class, 0, -2, __FILE__, __LINE__, "worker_thread", "%s", me->payload);
+		after = now_seconds();
+		me->latency[i] = (unsigned long)((after - before) * 1e9);
+	}
+
+	return 0;
+}
+
+/******************************************************************************
+**
+** FUNCTION    : write_result
+**
+** DESCRIPTION : write the result of one scenario as a CSV line or a JSON object
+**
+** ARGUMENTS   : out   the results file
+**               json  JSON (TRUE) or CSV (FALSE)?
+**               res   the result
+**
+** RETURNS     : n/a
+**
+******************************************************************************/
+void write_result
+(
+	FILE*         out,
+	int           json,
+	const result* res
+)
+{
+	double rate = (res->seconds > 0) ? res->messages / res->seconds : 0;
+
+	if (json)
+	{
+		fprintf(out, "{\"destination\":\"%s\",\"threads\":%d,\"mode\":\"%s\",\"payload\":\"%s\","
+					"\"messages\":%d,\"seconds\":%.6f,\"msgs_per_sec\":%.0f,"
+					"\"p50_ns\":%lu,\"p99_ns\":%lu,\"p999_ns\":%lu,\"max_ns\":%lu}\n",
+			res->destination, res->threads, res->mode, res->payload, res->messages,
+			res->seconds, rate, res->p50, res->p99, res->p999, res->max);
+	}
+	else
+	{
+		fprintf(out, "%s,%d,%s,%s,%d,%.6f,%.0f,%lu,%lu,%lu,%lu\n",
+			res->destination, res->threads, res->mode, res->payload, res->messages,
+			res->seconds, rate, res->p50, res->p99, res->p999, res->max);
+	}
+}
+
+/******************************************************************************
+**
+** FUNCTION    : parse_list
+**
+** DESCRIPTION : parse a comma-separated list of positive integers
+**
+** ARGUMENTS   : text        the list
+**               values      returns the integers
+**               max_values  the size of values
+**
+** RETURNS     : the number of integers, or 0 if the list is invalid
+**
+******************************************************************************/
+int parse_list
+(
+	const char* text,
+	int*        values,
+	int         max_values
+)
+{
+	int count = 0;
+
+	while (*text != EOS)
+	{
+		if ((count >= max_values) || ((values[count] = atoi(text)) <= 0))
+		{
+			return 0;
+		}
+		count++;
+		while ((*text != EOS) && (*text != ','))
+		{
+			text++;
+		}
+		if (*text == ',')
+		{
+			text++;
+		}
+	}
+
+	return count;
+}
+
+/******************************************************************************
+**
+** FUNCTION    : compare_latency
+**
+** DESCRIPTION : qsort comparison function for latencies
+**
+** ARGUMENTS   : a, b   the latencies to compare
+**
+** RETURNS     : <0, 0 or >0
+**
+******************************************************************************/
+int compare_latency
+(
+	const void* a,
+	const void* b
+)
+{
+	unsigned long x = *(const unsigned long*)a;
+	unsigned long y = *(const unsigned long*)b;
+
+	return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+/******************************************************************************
+**
+** FUNCTION    : percentile
+**
+** DESCRIPTION : return a percentile of a sorted array (nearest rank)
+**
+** ARGUMENTS   : sorted    the values, in ascending order
+**               count     the number of values (at least one)
+**               fraction  the percentile, as a fraction (eg 0.99)
+**
+** RETURNS     : the value
+**
+******************************************************************************/
+unsigned long percentile
+(
+	const unsigned long* sorted,
+	unsigned long        count,
+	double               fraction
+)
+{
+	unsigned long rank = (unsigned long)(fraction * count + 0.999999);
+
+	if (rank < 1)
+	{
+		rank = 1;
+	}
+	if (rank > count)
+	{
+		rank = count;
+	}
+	return sorted[rank - 1];
+}
+
+/******************************************************************************
+**
+** FUNCTION    : now_seconds
+**
+** DESCRIPTION : return the time from a high-resolution monotonic clock
+**
+** ARGUMENTS   : none
+**
+** RETURNS     : seconds (only differences are meaningful)
+**
+******************************************************************************/
+double now_seconds()
+{
+#if defined(WIN32)
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER        counter;
+
+	if (frequency.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&frequency);
+	}
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+#endif
+}
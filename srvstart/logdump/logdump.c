@@ -0,0 +1,297 @@
+/******************************************************************************
+**
+** FILE        : logdump.c
+**
+** AUTHOR      : Nick Rozanski
+**
+** DESCRIPTION : Dump the messages held in a Logger flight recorder file
+**
+**               A flight recorder is a fixed-size, memory-mapped ring file
+**               written by a logger configured with LOGGER_RING_FILENAME (the
+**               srvstart directive debug_out=ring:<file>).  Because the pages
+**               belong to the operating system, the ring survives the death
+**               of the process which was writing it.  This program prints the
+**               complete messages in the ring, oldest first.
+**
+**               The file layout is described in logger.h.
+**
+** SYNOPSIS    : logdump [-v] <ring file>
+**
+**               -v also prints the ring size and position, and the number of
+**               bytes skipped (records which were incomplete or overwritten).
+**
+**               The program reads the file with ANSI functions only, so it can
+**               be built on any platform the Logger supports.
+**
+** MODIFICATION HISTORY
+** --------------------
+**
+**  Refer to master header file logger.h for full modification history.
+**
+** DISTRIBUTION
+** ------------
+** Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+** Distributed under the terms of the GNU General Public License
+**  as published by the Free Software Foundation
+**  (675 Mass Ave, Cambridge, MA 02139, USA)
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT
+** ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+** or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+** License for more details.
+**
+******************************************************************************/
+
+/******************************************************************************
+**                                                                           **
+** ANSI HEADER FILES                                                         **
+**                                                                           **
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/******************************************************************************
+**                                                                           **
+** APPLICATION HEADER FILES                                                  **
+**                                                                           **
+******************************************************************************/
+
+#include <logger.h>
+
+/******************************************************************************
+**                                                                           **
+** LOCAL MACROS                                                              **
+**                                                                           **
+******************************************************************************/
+
+#define	TRUE	1
+#define	FALSE	0
+
+#define	EOS		'\0'
+
+/******************************************************************************
+**                                                                           **
+** FUNCTION PROTOTYPES                                                       **
+**                                                                           **
+******************************************************************************/
+
+int  read_ring(const char* filename, LOGGER_RING_HEADER* header, char** data);
+void dump_ring(const LOGGER_RING_HEADER* header, const char* data, int verbose);
+void print_record(const char* data, unsigned int mask, unsigned int position, unsigned int length);
+
+/******************************************************************************
+**
+** FUNCTION    : main
+**
+** DESCRIPTION : logdump program entry point
+**
+** ARGUMENTS   : argc    number of command-line arguments
+**               argv    command-line argument vector
+**
+** RETURNS     : 0 for success, 1 for failure
+**
+******************************************************************************/
+int main
+(
+	int   argc,
+	char* argv[]
+)
+{
+	LOGGER_RING_HEADER header;
+	char*              data;
+	int                verbose = FALSE;
+	int                arg = 1;
+
+	/* -v? */
+	if ((argc > 1) && (!strcmp(argv[1], "-v")))
+	{
+		verbose = TRUE;
+		arg++;
+	}
+	if (arg != argc - 1)
+	{
+		fprintf(stderr, "usage: logdump [-v] <ring file>\n");
+		return 1;
+	}
+
+	/* read and check the ring */
+	if (!read_ring(argv[arg], &header, &data))
+	{
+		return 1;
+	}
+
+	dump_ring(&header, data, verbose);
+	free(data);
+	return 0;
+}
+
+/******************************************************************************
+**
+** FUNCTION    : read_ring
+**
+** DESCRIPTION : read a ring file into memory, checking its header
+**
+** ARGUMENTS   : filename  the ring file
+**               header    returns the ring header
+**               data      returns the ring data (allocated with malloc)
+**
+** RETURNS     : TRUE for success, FALSE for failure (a message has been printed)
+**
+******************************************************************************/
+int read_ring
+(
+	const char*         filename,
+	LOGGER_RING_HEADER* header,
+	char**              data
+)
+{
+	FILE* file;
+
+	if ((file = fopen(filename, "rb")) == NULL)
+	{
+		fprintf(stderr, "ERROR - cannot open '%s'\n", filename);
+		return FALSE;
+	}
+
+	/* the header */
+	if (fread(header, sizeof(LOGGER_RING_HEADER), 1, file) != 1)
+	{
+		fprintf(stderr, "ERROR - '%s' is too short to be a ring file\n", filename);
+		fclose(file);
+		return FALSE;
+	}
+	if (header->Magic != LOGGER_RING_MAGIC)
+	{
+		fprintf(stderr, "ERROR - '%s' is not a ring file\n", filename);
+		fclose(file);
+		return FALSE;
+	}
+	if ((header->Version != LOGGER_RING_VERSION) ||
+		(header->HeaderSize < sizeof(LOGGER_RING_HEADER)) ||
+		(header->DataSize < LOGGER_RING_MIN_SIZE) ||
+		((header->DataSize & (header->DataSize - 1)) != 0))
+	{
+		fprintf(stderr, "ERROR - '%s' has an unsupported layout (version %u)\n",
+			filename, header->Version);
+		fclose(file);
+		return FALSE;
+	}
+
+	/* the data */
+	if ((*data = (char*)malloc(header->DataSize)) == NULL)
+	{
+		fprintf(stderr, "ERROR - out of memory\n");
+		fclose(file);
+		return FALSE;
+	}
+	if ((fseek(file, (long)header->HeaderSize, SEEK_SET) != 0) ||
+		(fread(*data, header->DataSize, 1, file) != 1))
+	{
+		fprintf(stderr, "ERROR - '%s' is truncated\n", filename);
+		free(*data);
+		fclose(file);
+		return FALSE;
+	}
+
+	fclose(file);
+	return TRUE;
+}
+
+/******************************************************************************
+**
+** FUNCTION    : dump_ring
+**
+** DESCRIPTION : print the complete records in a ring, oldest first
+**
+** ARGUMENTS   : header   the ring header
+**               data     the ring data
+**               verbose  print a summary too?
+**
+** RETURNS     : n/a
+**
+** NOTES       : The oldest byte still in the ring is at position Head - DataSize,
+**               which is probably in the middle of a record.  A record is only
+**               accepted if its Start field equals its position and it ends by
+**               Head;  otherwise the scan moves on by LOGGER_RING_ALIGN bytes
+**               until it finds the next one.  (Before the ring first wraps, the
+**               positions "before zero" hold zeroes, which never match.)
+**
+******************************************************************************/
+void dump_ring
+(
+	const LOGGER_RING_HEADER* header,
+	const char*               data,
+	int                       verbose
+)
+{
+	unsigned int              mask = header->DataSize - 1;
+	unsigned int              head = header->Head;
+	unsigned int              position = head - header->DataSize;
+	unsigned int              remaining;
+	const LOGGER_RING_RECORD* record;
+	unsigned long             records = 0;
+	unsigned long             skipped = 0;
+
+	while ((remaining = head - position) >= sizeof(LOGGER_RING_RECORD))
+	{
+		record = (const LOGGER_RING_RECORD*)(data + (position & mask));
+		if ((record->Start == position) &&
+			(record->Length > sizeof(LOGGER_RING_RECORD)) &&
+			(record->Length <= remaining) &&
+			((record->Length % LOGGER_RING_ALIGN) == 0))
+		{
+			print_record(data, mask, position + sizeof(LOGGER_RING_RECORD),
+				record->Length - sizeof(LOGGER_RING_RECORD));
+			records++;
+			position += record->Length;
+		}
+		else
+		{
+			skipped += LOGGER_RING_ALIGN;
+			position += LOGGER_RING_ALIGN;
+		}
+	}
+
+	if (verbose)
+	{
+		fprintf(stderr, "ring size %u bytes, head %u, %lu records, %lu bytes skipped\n",
+			header->DataSize, head, records, skipped);
+	}
+}
+
+/******************************************************************************
+**
+** FUNCTION    : print_record
+**
+** DESCRIPTION : print the text of one record (up to its first zero byte)
+**
+** ARGUMENTS   : data      the ring data
+**               mask      the ring size - 1
+**               position  the position of the text
+**               length    the length of the text and its padding
+**
+** RETURNS     : n/a
+**
+******************************************************************************/
+void print_record
+(
+	const char*  data,
+	unsigned int mask,
+	unsigned int position,
+	unsigned int length
+)
+{
+	unsigned int i;
+	char         c;
+
+	for (i = 0; i < length; i++)
+	{
+		if ((c = data[(position + i) & mask]) == EOS)
+		{
+			break;
+		}
+		putchar(c);
+	}
+}
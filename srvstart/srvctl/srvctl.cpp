@@ -0,0 +1,354 @@
+/******************************************************************************
+**
+** FILE        : srvctl.cpp
+**
+** AUTHOR      : Nick Rozanski
+**
+** DESCRIPTION : Query and command running SrvStart services
+**
+**               Each service run by SrvStart serves requests on its control
+**               endpoint (a named pipe on Win32, a Unix domain socket on
+**               POSIX - see ControlEndpoint.h).  This program sends a request
+**               to one or more services and prints their replies.
+**
+** SYNOPSIS    : srvctl [-t <ms>] <service>[,<service>...] <request>
+**               srvctl [-t <ms>] -a <request>
+**               srvctl -l
+**               srvctl -s
+**
+**               -t sets how long to wait for each reply (default 5000ms).
+**               -a sends the request to every service with an endpoint.
+**               -l lists the services with an endpoint.
+**               -s prints every service on the status board (see StatusBoard.h)
+**                  without sending any requests at all.
+**
+**               The request is the rest of the command line, one of:
+**
+**                  status | pid | uptime | restarts | sample | metrics
+**                  stop | restart | reload | log <logger command> | help
+**
+**               With more than one service, each reply is prefixed with the
+**               service name.  Every service is asked in turn, and each one
+**               replies from its own event loop, so a round of requests to
+**               hundreds of services does not wait for any of them to poll.
+**
+** MODIFICATION HISTORY
+** --------------------
+**
+**  Refer to master header file SrvStart.h for full modification history.
+**
+** DISTRIBUTION
+** ------------
+** Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+** Distributed under the terms of the GNU General Public License
+**  as published by the Free Software Foundation
+**  (675 Mass Ave, Cambridge, MA 02139, USA)
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT
+** ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+** or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+** License for more details.
+**
+******************************************************************************/
+
+/******************************************************************************
+**                                                                           **
+** ANSI HEADER FILES                                                         **
+**                                                                           **
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/******************************************************************************
+**                                                                           **
+** APPLICATION HEADER FILES                                                  **
+**                                                                           **
+******************************************************************************/
+
+#include <logger.h>
+#include "ControlEndpoint.h"
+#include "StatusBoard.h"
+
+using namespace SrvStart;
+
+/******************************************************************************
+**                                                                           **
+** LOCAL MACROS                                                              **
+**                                                                           **
+******************************************************************************/
+
+#define	DEFAULT_TIMEOUT		5000
+
+/******************************************************************************
+**                                                                           **
+** LOCAL TYPES                                                               **
+**                                                                           **
+******************************************************************************/
+
+/* state shared by the services in one round of requests */
+struct RequestRound
+{
+	const char*   request;
+	unsigned long timeout;
+	bool          prefix;
+	int           failures;
+};
+
+/******************************************************************************
+**                                                                           **
+** FUNCTION PROTOTYPES                                                       **
+**                                                                           **
+******************************************************************************/
+
+void send_request(const char* service, void* round);
+void print_service(const char* service, void* unused);
+int  print_board();
+int  usage();
+
+/******************************************************************************
+**
+** FUNCTION    : main
+**
+** DESCRIPTION : srvctl program entry point
+**
+** ARGUMENTS   : argc    number of command-line arguments
+**               argv    command-line argument vector
+**
+** RETURNS     : 0 if every service replied OK, 1 if not, 2 for a usage error
+**
+******************************************************************************/
+int main
+(
+	int   argc,
+	char* argv[]
+)
+{
+	RequestRound round;
+	char         request[ControlEndpoint::MAX_MESSAGE];
+	const char*  services = NULL;
+	bool         all = false;
+	int          arg = 1;
+	int          length = 0;
+
+	round.timeout  = DEFAULT_TIMEOUT;
+	round.failures = 0;
+
+	/* options */
+	while ((arg < argc) && (argv[arg][0] == '-'))
+	{
+		if ((!strcmp(argv[arg], "-t")) && (arg + 1 < argc))
+		{
+			round.timeout = strtoul(argv[arg + 1], NULL, 10);
+			arg += 2;
+		}
+		else if (!strcmp(argv[arg], "-a"))
+		{
+			all = true;
+			arg++;
+		}
+		else if ((!strcmp(argv[arg], "-l")) && (arg == argc - 1))
+		{
+			ControlEndpoint::listServices(print_service, NULL);
+			return 0;
+		}
+		else if ((!strcmp(argv[arg], "-s")) && (arg == argc - 1))
+		{
+			return print_board();
+		}
+		else
+		{
+			return usage();
+		}
+	}
+
+	/* services, unless -a */
+	if (!all)
+	{
+		if (arg >= argc)
+		{
+			return usage();
+		}
+		services = argv[arg++];
+	}
+
+	/* the request is the rest of the line */
+	if (arg >= argc)
+	{
+		return usage();
+	}
+	request[0] = '\0';
+	for (; arg < argc; arg++)
+	{
+		length += snprintf(request + length, sizeof(request) - length, "%s%s",
+			(length > 0 ? " " : ""), argv[arg]);
+		if (length >= (int)sizeof(request))
+		{
+			fprintf(stderr, "ERROR - request is too long\n");
+			return 2;
+		}
+	}
+	round.request = request;
+
+	/* send it */
+	if (all)
+	{
+		round.prefix = true;
+		if (ControlEndpoint::listServices(send_request, &round) == 0)
+		{
+			fprintf(stderr, "no services are running\n");
+		}
+	}
+	else
+	{
+		char  list[ControlEndpoint::MAX_MESSAGE];
+		char* service;
+		strncpy(list, services, sizeof(list) - 1);
+		list[sizeof(list) - 1] = '\0';
+		round.prefix = (strchr(list, ',') != NULL);
+		for (service = strtok(list, ","); service != NULL; service = strtok(NULL, ","))
+		{
+			send_request(service, &round);
+		}
+	}
+
+	return (round.failures == 0 ? 0 : 1);
+}
+
+/******************************************************************************
+**
+** FUNCTION    : send_request
+**
+** DESCRIPTION : send the request to one service, and print its reply
+**
+** ARGUMENTS   : service  the service name
+**               round    the round of requests (RequestRound)
+**
+** RETURNS     : n/a
+**
+******************************************************************************/
+void send_request
+(
+	const char* service,
+	void*       round
+)
+{
+	RequestRound* r = (RequestRound*)round;
+	char          reply[ControlEndpoint::MAX_MESSAGE];
+	bool          ok;
+
+	ok = ControlEndpoint::request(service, r->request, reply, sizeof(reply), r->timeout);
+	if (!ok)
+	{
+		r->failures++;
+	}
+
+	if (r->prefix)
+	{
+		printf("%s: %s%s\n", service, (ok ? "" : "ERROR - "), reply);
+	}
+	else if (ok)
+	{
+		printf("%s\n", reply);
+	}
+	else
+	{
+		fprintf(stderr, "ERROR - %s\n", reply);
+	}
+}
+
+/******************************************************************************
+**
+** FUNCTION    : print_service
+**
+** DESCRIPTION : print the name of a service with a control endpoint
+**
+** ARGUMENTS   : service  the service name
+**               unused   not used
+**
+** RETURNS     : n/a
+**
+******************************************************************************/
+void print_service
+(
+	const char* service,
+	void*       unused
+)
+{
+	printf("%s\n", service);
+}
+
+/******************************************************************************
+**
+** FUNCTION    : print_board
+**
+** DESCRIPTION : print the record of every service on the status board
+**
+**               AGE is how long ago the record was last published, so a
+**               service whose SrvStart process has died shows a growing AGE.
+**
+** RETURNS     : 0
+**
+******************************************************************************/
+int print_board()
+{
+	static StatusBoard::STATUS_RECORD records[StatusBoard::MAX_SERVICES];
+	unsigned long long                now = (unsigned long long)time(NULL);
+	int                               count;
+	int                               i;
+
+	count = StatusBoard::snapshot(records, StatusBoard::MAX_SERVICES);
+	if (count == 0)
+	{
+		fprintf(stderr, "no services are on the status board\n");
+		return 0;
+	}
+
+	printf("%-24s %-12s %8s %8s %8s %10s %10s %8s %10s %8s %6s\n",
+		"SERVICE", "STATE", "SRVSTART", "PID", "RESTARTS", "LAST_EXIT", "STATE_AGE",
+		"CPU_S", "WS_KB", "HANDLES", "AGE");
+	for (i = 0; i < count; i++)
+	{
+		StatusBoard::STATUS_RECORD* r = &records[i];
+		char lastExit[16];
+		if (r->lastExitTime == 0)
+		{
+			strcpy(lastExit, "-");
+		}
+		else
+		{
+			snprintf(lastExit, sizeof(lastExit), "%u", r->lastExitCode);
+		}
+		printf("%-24s %-12s %8u %8u %8u %10s %10llu %8llu %10llu %8u %6llu\n",
+			r->svcName, (r->state[0] != '\0' ? r->state : "-"), r->ownerPid, r->pid,
+			r->restarts, lastExit,
+			(r->transitionTime == 0 ? 0 : now - r->transitionTime),
+			(r->userMilliseconds + r->kernelMilliseconds) / 1000,
+			r->workingSet / 1024, r->handles,
+			(r->sampleTime == 0 ? 0 : now - r->sampleTime));
+	}
+
+	return 0;
+}
+
+/******************************************************************************
+**
+** FUNCTION    : usage
+**
+** DESCRIPTION : print the usage message
+**
+** RETURNS     : 2 (the exit status for a usage error)
+**
+******************************************************************************/
+int usage()
+{
+	fprintf(stderr,
+		"usage: srvctl [-t <ms>] <service>[,<service>...] <request>\n"
+		"       srvctl [-t <ms>] -a <request>\n"
+		"       srvctl -l\n"
+		"       srvctl -s\n"
+		"requests: status pid uptime restarts sample metrics stop restart reload log <command> help\n");
+	return 2;
+}
@@ -0,0 +1,180 @@
+/******************************************************************************
+**
+** FILE        : srvsup.cpp
+**
+** AUTHOR      : Nick Rozanski
+**
+** DESCRIPTION : Run a command as a service under a systemd-compatible
+**               service manager (POSIX)
+**
+**               The command is supervised by a Supervisor (see Supervisor.h):
+**               the service manager is told when it is running (READY=1), when
+**               it is stopping (STOPPING=1), which process it is (MAINPID=),
+**               and is sent WATCHDOG=1 if it has asked for it.  It stops the
+**               service with SIGTERM.  A unit runs it with Type=notify, eg
+**
+**                  [Service]
+**                  Type=notify
+**                  NotifyAccess=main
+**                  ExecStart=/usr/local/bin/srvsup -r 5 myservice "exec mydaemon -f"
+**
+** SYNOPSIS    : srvsup [-d <delay>] [-r <interval>] [-t <timeout>] [-v]
+**                      <service> <command>
+**
+**               -d waits <delay> seconds after starting the command before
+**                  reporting the service running.
+**               -r restarts the command <interval> seconds after it exits
+**                  (it is not restarted by default).
+**               -t kills the command if it has not stopped <timeout>
+**                  seconds after SIGTERM (by default it is waited for).
+**               -v logs debug messages.
+**
+**               The command is run by /bin/sh -c.
+**
+** MODIFICATION HISTORY
+** --------------------
+**
+**  Refer to master header file SrvStart.h for full modification history.
+**
+** DISTRIBUTION
+** ------------
+** Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+** Distributed under the terms of the GNU General Public License
+**  as published by the Free Software Foundation
+**  (675 Mass Ave, Cambridge, MA 02139, USA)
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT
+** ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+** or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+** License for more details.
+**
+******************************************************************************/
+
+/******************************************************************************
+**                                                                           **
+** ANSI HEADER FILES                                                         **
+**                                                                           **
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/******************************************************************************
+**                                                                           **
+** APPLICATION HEADER FILES                                                  **
+**                                                                           **
+******************************************************************************/
+
+#include <logger.h>
+#include "Supervisor.h"
+
+using namespace SrvStart;
+
+/******************************************************************************
+**                                                                           **
+** FUNCTION PROTOTYPES                                                       **
+**                                                                           **
+******************************************************************************/
+
+int usage();
+
+/******************************************************************************
+**
+** FUNCTION    : main
+**
+** DESCRIPTION : srvsup program entry point
+**
+** ARGUMENTS   : argc    number of command-line arguments
+**               argv    command-line argument vector
+**
+** RETURNS     : 0 if the service ran and stopped, 1 if it failed, 2 for a
+**               usage error
+**
+******************************************************************************/
+int main
+(
+	int   argc,
+	char* argv[]
+)
+{
+	int  startupDelay    = 0;
+	int  restartInterval = -1;
+	int  shutdownTimeout = 0;
+	int  debugLevel      = 0;
+	int  arg             = 1;
+
+	/* options */
+	while ((arg < argc) && (argv[arg][0] == '-'))
+	{
+		if ((!strcmp(argv[arg], "-d")) && (arg + 1 < argc))
+		{
+			startupDelay = atoi(argv[arg + 1]);
+			arg += 2;
+		}
+		else if ((!strcmp(argv[arg], "-r")) && (arg + 1 < argc))
+		{
+			restartInterval = atoi(argv[arg + 1]);
+			arg += 2;
+		}
+		else if ((!strcmp(argv[arg], "-t")) && (arg + 1 < argc))
+		{
+			shutdownTimeout = atoi(argv[arg + 1]);
+			arg += 2;
+		}
+		else if (!strcmp(argv[arg], "-v"))
+		{
+			debugLevel = 2;
+			arg++;
+		}
+		else
+		{
+			return usage();
+		}
+	}
+
+	/* service and command */
+	if (arg + 2 != argc)
+	{
+		return usage();
+	}
+
+	/* log to standard output (the service manager's journal) */
+	LoggerConfigure(LOGGER_DEFAULT_LOGGER, 0, argv[arg], LOGGER_ANSI_STDOUT, 0, 0, 0, 0);
+	LoggerSetDebugLevel(debugLevel);
+
+	/* the Supervisor must be created before any other thread is started */
+	try
+	{
+		Supervisor supervisor(argv[arg]);
+		supervisor.setStartupCommand(argv[arg + 1]);
+		supervisor.setStartupDelay(startupDelay);
+		supervisor.setAutoRestart(restartInterval >= 0);
+		supervisor.setAutoRestartInterval(restartInterval < 0 ? 0 : restartInterval);
+		supervisor.setShutdownTimeout(shutdownTimeout);
+		supervisor.start();
+	}
+	catch (...)
+	{
+		fprintf(stderr, "ERROR - service '%s' failed\n", argv[arg]);
+		return 1;
+	}
+
+	return 0;
+}
+
+/******************************************************************************
+**
+** FUNCTION    : usage
+**
+** DESCRIPTION : print the usage message
+**
+** RETURNS     : 2 (the exit status for a usage error)
+**
+******************************************************************************/
+int usage()
+{
+	fprintf(stderr,
+		"usage: srvsup [-d <delay>] [-r <interval>] [-t <timeout>] [-v] <service> <command>\n");
+	return 2;
+}
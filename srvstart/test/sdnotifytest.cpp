@@ -0,0 +1,282 @@
+/******************************************************************************
+**
+** FILE        : sdnotifytest.cpp
+**
+** AUTHOR      : Nick Rozanski
+**
+** DESCRIPTION : Test the POSIX supervisor against a stand-in service manager
+**
+**               The test listens on its own NOTIFY_SOCKET (asking for a
+**               200ms watchdog too), supervises a real command ("sleep") with
+**               a Supervisor, and stops it with SIGTERM once the service is
+**               ready and the watchdog is running.  It then checks the
+**               notifications it was sent, in order:
+**
+**                  STATUS=starting, MAINPID=<pid>, READY=1, WATCHDOG=1 (at
+**                  least twice), STOPPING=1 (no watchdog after it) and
+**                  STATUS=stopped
+**
+**               and that the command has gone.
+**
+** SYNOPSIS    : sdnotifytest
+**
+**               Exits with 0 if every check passed, 1 if not.
+**
+** MODIFICATION HISTORY
+** --------------------
+**
+**  Refer to master header file SrvStart.h for full modification history.
+**
+** DISTRIBUTION
+** ------------
+** Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+** Distributed under the terms of the GNU General Public License
+**  as published by the Free Software Foundation
+**  (675 Mass Ave, Cambridge, MA 02139, USA)
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT
+** ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+** or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+** License for more details.
+**
+******************************************************************************/
+
+/******************************************************************************
+**                                                                           **
+** ANSI HEADER FILES                                                         **
+**                                                                           **
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/******************************************************************************
+**                                                                           **
+** POSIX HEADER FILES                                                        **
+**                                                                           **
+******************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+/******************************************************************************
+**                                                                           **
+** APPLICATION HEADER FILES                                                  **
+**                                                                           **
+******************************************************************************/
+
+#include <logger.h>
+#include "Supervisor.h"
+
+using namespace SrvStart;
+
+/******************************************************************************
+**                                                                           **
+** LOCAL MACROS                                                              **
+**                                                                           **
+******************************************************************************/
+
+#define	MAX_NOTIFICATIONS	256
+#define	MAX_NOTIFICATION	512
+#define	RECEIVE_TIMEOUT		10		/* seconds */
+
+/******************************************************************************
+**                                                                           **
+** LOCAL TYPES                                                               **
+**                                                                           **
+******************************************************************************/
+
+/* the stand-in service manager:  every notification it has been sent */
+struct Manager
+{
+	int  socket;
+	int  count;
+	char notifications[MAX_NOTIFICATIONS][MAX_NOTIFICATION];
+};
+
+/******************************************************************************
+**                                                                           **
+** LOCAL VARIABLES                                                           **
+**                                                                           **
+******************************************************************************/
+
+static int failures = 0;
+
+/******************************************************************************
+**                                                                           **
+** FUNCTION PROTOTYPES                                                       **
+**                                                                           **
+******************************************************************************/
+
+void* manager_main(void* arg);
+void  check(bool ok, const char* what);
+
+/******************************************************************************
+**
+** FUNCTION    : main
+**
+** DESCRIPTION : sdnotifytest program entry point
+**
+** RETURNS     : 0 if every check passed, 1 if not
+**
+******************************************************************************/
+int main()
+{
+	static Manager     manager;
+	struct sockaddr_un address;
+	struct timeval     timeout;
+	pthread_t          thread;
+	char               path[sizeof(address.sun_path)];
+	long               mainPid = 0;
+	int                next = 0;
+	int                watchdogs = 0;
+
+	/* the stand-in service manager's socket */
+	snprintf(path, sizeof(path), "/tmp/sdnotifytest.%ld.sock", (long)getpid());
+	unlink(path);
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+	manager.socket = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if ((manager.socket < 0) || (bind(manager.socket, (struct sockaddr*)&address, sizeof(address)) != 0))
+	{
+		fprintf(stderr, "ERROR - cannot listen on '%s' (error %d)\n", path, errno);
+		return 1;
+	}
+	timeout.tv_sec  = RECEIVE_TIMEOUT;
+	timeout.tv_usec = 0;
+	setsockopt(manager.socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setenv("NOTIFY_SOCKET", path, 1);
+	setenv("WATCHDOG_USEC", "200000", 1);
+	unsetenv("WATCHDOG_PID");
+
+	/* the Supervisor blocks the stop signals, so it comes before the thread */
+	try
+	{
+		Supervisor supervisor(const_cast<char*>("sdnotifytest"));
+		supervisor.setStartupCommand("exec sleep 30");
+		supervisor.setShutdownTimeout(5);
+
+		pthread_create(&thread, NULL, manager_main, &manager);
+		supervisor.start();
+		pthread_join(thread, NULL);
+		check(supervisor.isStopRequested(), "the service was asked to stop");
+	}
+	catch (...)
+	{
+		check(false, "the supervisor ran without an exception");
+		return 1;
+	}
+	close(manager.socket);
+	unlink(path);
+
+	/* the notifications, in order */
+	check((next < manager.count) && (!strcmp(manager.notifications[next++], "STATUS=starting")),
+		"STATUS=starting comes first");
+	check((next < manager.count) && (sscanf(manager.notifications[next++], "MAINPID=%ld", &mainPid) == 1)
+		&& (mainPid > 0), "MAINPID= comes next");
+	check((next < manager.count) && (!strcmp(manager.notifications[next++], "READY=1\nSTATUS=running")),
+		"READY=1 comes next");
+	while ((next < manager.count) && (!strcmp(manager.notifications[next], "WATCHDOG=1")))
+	{
+		watchdogs++;
+		next++;
+	}
+	check(watchdogs >= 2, "the watchdog was running");
+	check((next < manager.count) && (!strcmp(manager.notifications[next++], "STOPPING=1\nSTATUS=stopping")),
+		"STOPPING=1 comes next");
+	while ((next < manager.count) && (!strcmp(manager.notifications[next], "STOPPING=1\nSTATUS=stopping")))
+	{
+		next++;
+	}
+	check((next == manager.count - 1) && (!strcmp(manager.notifications[next], "STATUS=stopped")),
+		"STATUS=stopped comes last (and no watchdog after STOPPING=1)");
+
+	/* the command has been stopped (and reaped) */
+	check((mainPid > 0) && (kill((pid_t)mainPid, 0) != 0) && (errno == ESRCH), "the command has gone");
+
+	printf("%s\n", (failures == 0 ? "all checks passed" : "FAILED"));
+	return (failures == 0 ? 0 : 1);
+}
+
+/******************************************************************************
+**
+** FUNCTION    : manager_main
+**
+** DESCRIPTION : the stand-in service manager:  keeps every notification, and
+**               sends SIGTERM once the service is ready and the watchdog has
+**               been seen twice, until the service has stopped
+**
+** ARGUMENTS   : arg     the Manager
+**
+** RETURNS     : NULL
+**
+******************************************************************************/
+void* manager_main
+(
+	void* arg
+)
+{
+	Manager* manager = (Manager*)arg;
+	bool     ready = false;
+	bool     stopped = false;
+	int      watchdogs = 0;
+
+	while (manager->count < MAX_NOTIFICATIONS)
+	{
+		char* notification = manager->notifications[manager->count];
+		int   length = (int)recv(manager->socket, notification, MAX_NOTIFICATION - 1, 0);
+		if (length < 0)
+		{
+			fprintf(stderr, "ERROR - no notification for %d seconds\n", RECEIVE_TIMEOUT);
+			break;
+		}
+		notification[length] = '\0';
+		manager->count++;
+
+		if (!strncmp(notification, "READY=1", 7))
+		{
+			ready = true;
+		}
+		if ((!strcmp(notification, "WATCHDOG=1")) && ready && (++watchdogs == 2) && (!stopped))
+		{
+			kill(getpid(), SIGTERM);
+			stopped = true;
+		}
+		if (!strcmp(notification, "STATUS=stopped"))
+		{
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/******************************************************************************
+**
+** FUNCTION    : check
+**
+** DESCRIPTION : report one check
+**
+** ARGUMENTS   : ok      true if it passed
+**               what    what was checked
+**
+******************************************************************************/
+void check
+(
+	bool        ok,
+	const char* what
+)
+{
+	printf("%s: %s\n", (ok ? "ok" : "FAILED"), what);
+	if (!ok)
+	{
+		failures++;
+	}
+}
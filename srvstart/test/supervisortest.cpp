@@ -0,0 +1,783 @@
+/******************************************************************************
+**
+** FILE        : supervisortest.cpp
+**
+** AUTHOR      : Nick Rozanski
+**
+** DESCRIPTION : Scenario and latency-regression tests for the POSIX
+**               supervisor, run in virtual time
+**
+**               Nothing in the Supervisor is replaced; what it talks to is:
+**
+**                  the clock    a virtual clock (see Clock::setTimeSource)
+**                               whose sleep moves virtual time on - no
+**                               test waits in real time
+**                  processes    a fake process backend (see
+**                               Supervisor::setProcessBackend) whose
+**                               processes exit at scripted times, on
+**                               SIGTERM (or not) and on SIGKILL
+**                  the SCM      a stand-in service manager:  a NOTIFY_SOCKET
+**                               datagram receiver (every notification is
+**                               timestamped in virtual time) which stops the
+**                               service with SIGTERM at a scripted time
+**
+**               Each scenario (start, readiness, crash and restart, stop,
+**               stop timeout, exit while starting) checks what the service
+**               manager and the processes saw.  The latency checks then
+**               hold the virtual time from each event to its response
+**               within the supervisor's polling interval, and each scenario
+**               within a real-time budget, so that a slower supervisor
+**               fails here rather than in production.
+**
+** SYNOPSIS    : supervisortest
+**
+**               Exits with 0 if every check passed, 1 if not.
+**
+** MODIFICATION HISTORY
+** --------------------
+**
+**  Refer to master header file SrvStart.h for full modification history.
+**
+** DISTRIBUTION
+** ------------
+** Copyright (C) 1998-2000 Nick Rozanski (Nick@Rozanski.com)
+** Distributed under the terms of the GNU General Public License
+**  as published by the Free Software Foundation
+**  (675 Mass Ave, Cambridge, MA 02139, USA)
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT
+** ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+** or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+** License for more details.
+**
+******************************************************************************/
+
+/******************************************************************************
+**                                                                           **
+** ANSI HEADER FILES                                                         **
+**                                                                           **
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/******************************************************************************
+**                                                                           **
+** POSIX HEADER FILES                                                        **
+**                                                                           **
+******************************************************************************/
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/******************************************************************************
+**                                                                           **
+** APPLICATION HEADER FILES                                                  **
+**                                                                           **
+******************************************************************************/
+
+#include <logger.h>
+#include "Clock.h"
+#include "Supervisor.h"
+
+using namespace SrvStart;
+
+/******************************************************************************
+**                                                                           **
+** LOCAL MACROS                                                              **
+**                                                                           **
+******************************************************************************/
+
+#define	NEVER			(~0ULL)
+#define	MAX_PROCESSES		8
+#define	MAX_NOTIFICATIONS	1024
+#define	MAX_NOTIFICATION	256
+#define	MAX_SIGNALS		16
+
+#define	FIRST_PID		1000
+#define	POLL_MILLISECONDS	100	/* the supervisor's polling interval */
+#define	STOP_WAIT_SECONDS	5	/* real time allowed for SIGTERM to arrive */
+#define	BUDGET_MILLISECONDS	2000	/* real time allowed for one scenario */
+
+/******************************************************************************
+**                                                                           **
+** LOCAL TYPES                                                               **
+**                                                                           **
+******************************************************************************/
+
+/* what one (fake) process will do, in virtual milliseconds */
+struct ProcessScript
+{
+	unsigned long long exitAfter;	/* after it starts (NEVER to keep running) */
+	int                exitCode;
+	unsigned long long termAfter;	/* after SIGTERM (NEVER to ignore it) */
+};
+
+/* one scenario */
+struct Scenario
+{
+	const char*        name;
+	int                startupDelay;	/* seconds */
+	int                restartInterval;	/* seconds, -1 for no restart */
+	int                shutdownTimeout;	/* seconds */
+	unsigned long long stopAt;		/* SIGTERM (NEVER for none) */
+	int                processCount;
+	ProcessScript      processes[MAX_PROCESSES];
+};
+
+/* a fake process, as it ran */
+struct Process
+{
+	unsigned long long startedAt;
+	unsigned long long exitsAt;
+	int                exitCode;
+	bool               reaped;
+};
+
+/* a signal sent to a fake process */
+struct Signal
+{
+	unsigned long long at;
+	long               pid;
+	bool               kill;
+};
+
+/* a notification received by the stand-in service manager */
+struct Notification
+{
+	unsigned long long at;
+	char               text[MAX_NOTIFICATION];
+};
+
+/* everything that happened in a scenario (times are virtual, from 0) */
+struct World
+{
+	const Scenario*    scenario;
+	Supervisor*        supervisor;
+	int                manager;
+	unsigned long long now;
+	bool               stopSent;
+	int                processCount;
+	Process            processes[MAX_PROCESSES];
+	int                signalCount;
+	Signal             signals[MAX_SIGNALS];
+	int                notificationCount;
+	Notification       notifications[MAX_NOTIFICATIONS];
+};
+
+/******************************************************************************
+**                                                                           **
+** LOCAL VARIABLES                                                           **
+**                                                                           **
+******************************************************************************/
+
+static int   failures = 0;
+static World world;
+
+/* the scenarios */
+static const Scenario scenarios[] =
+{
+	/* name                  delay restart timeout stopAt  processes */
+	{ "start and stop",          0,   -1,     0,    5000, 1, { { NEVER, 0, 0 } } },
+	{ "startup delay",           3,   -1,     0,   10000, 1, { { NEVER, 0, 250 } } },
+	{ "crash and restart",       0,    2,     0,   20000, 2, { { 4000, 1, 0 }, { NEVER, 0, 0 } } },
+	{ "stop while restarting",   0,   30,     0,    6000, 1, { { 4000, 1, 0 } } },
+	{ "stop timeout",            0,   -1,     2,    5000, 1, { { NEVER, 0, NEVER } } },
+	{ "exit while starting",     5,   -1,     0,   NEVER, 1, { { 1500, 3, 0 } } },
+	{ "exit when done",          0,   -1,     0,   NEVER, 1, { { 7000, 0, 0 } } },
+	{ "run for an hour",         0,   -1,     0, 3600000, 1, { { NEVER, 0, 0 } } },
+};
+
+/******************************************************************************
+**                                                                           **
+** FUNCTION PROTOTYPES                                                       **
+**                                                                           **
+******************************************************************************/
+
+int  open_manager(char* path, size_t length);
+bool run_scenario(const Scenario* scenario);
+void check_scenario(const Scenario* scenario);
+void check_latency(const Scenario* scenario);
+
+unsigned long long virtual_ticks(void* genericPointer);
+void virtual_sleep(unsigned long milliseconds, void* genericPointer);
+void receive_notifications();
+void send_stop();
+
+long fake_start(const char* command, void* genericPointer);
+bool fake_exited(long pid, int* exitCode, void* genericPointer);
+void fake_signal(long pid, bool kill, void* genericPointer);
+
+int  find(int from, const char* text);
+int  count(const char* text);
+unsigned long long real_milliseconds();
+void check(bool ok, const char* scenario, const char* what);
+
+/******************************************************************************
+**
+** FUNCTION    : main
+**
+** DESCRIPTION : supervisortest program entry point
+**
+** RETURNS     : 0 if every check passed, 1 if not
+**
+******************************************************************************/
+int main()
+{
+	char   path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+	size_t s;
+
+	/* only errors are logged */
+	LoggerConfigure(LOGGER_DEFAULT_LOGGER, 0, "supervisortest", LOGGER_ANSI_STDOUT, 0, 0, 0, 0);
+	LoggerSetDebugLevel(0);
+
+	world.manager = open_manager(path, sizeof(path));
+	if (world.manager < 0)
+	{
+		return 1;
+	}
+	unsetenv("WATCHDOG_USEC");	/* the watchdog runs in real time */
+	unsetenv("WATCHDOG_PID");
+
+	Clock::setTimeSource(virtual_ticks, virtual_sleep, &world);
+	Supervisor::setProcessBackend(fake_start, fake_exited, fake_signal, &world);
+
+	for (s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++)
+	{
+		unsigned long long started = real_milliseconds();
+		bool               ran = run_scenario(&scenarios[s]);
+		unsigned long long took = real_milliseconds() - started;
+
+		check(ran, scenarios[s].name, "ran to completion");
+		if (ran)
+		{
+			check_scenario(&scenarios[s]);
+			check_latency(&scenarios[s]);
+		}
+		check(took <= BUDGET_MILLISECONDS, scenarios[s].name, "ran within the real-time budget");
+		printf("   (%s: %llums virtual, %llums real)\n", scenarios[s].name, world.now, took);
+	}
+
+	Supervisor::setProcessBackend(0, 0, 0, 0);
+	Clock::setTimeSource(0, 0, 0);
+	close(world.manager);
+	unlink(path);
+
+	printf("%s\n", (failures == 0 ? "all checks passed" : "FAILED"));
+	return (failures == 0 ? 0 : 1);
+}
+
+/******************************************************************************
+**
+** FUNCTION    : open_manager
+**
+** DESCRIPTION : open the stand-in service manager's socket, and point
+**               NOTIFY_SOCKET at it
+**
+** ARGUMENTS   : path    OUT the socket's path
+**               length  IN the size of path
+**
+** RETURNS     : the socket, or -1 if it could not be opened
+**
+******************************************************************************/
+int open_manager
+(
+	char*  path,
+	size_t length
+)
+{
+	struct sockaddr_un address;
+	int                manager;
+
+	snprintf(path, length, "/tmp/supervisortest.%ld.sock", (long)getpid());
+	unlink(path);
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+	manager = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+	if ((manager < 0) || (bind(manager, (struct sockaddr*)&address, sizeof(address)) != 0))
+	{
+		fprintf(stderr, "ERROR - cannot listen on '%s' (error %d)\n", path, errno);
+		return -1;
+	}
+	setenv("NOTIFY_SOCKET", path, 1);
+	return manager;
+}
+
+/******************************************************************************
+**
+** FUNCTION    : run_scenario
+**
+** DESCRIPTION : supervise a scenario's processes from virtual time 0 until
+**               the supervisor returns
+**
+** ARGUMENTS   : scenario  the scenario
+**
+** RETURNS     : true if the supervisor returned without an exception
+**
+******************************************************************************/
+bool run_scenario
+(
+	const Scenario* scenario
+)
+{
+	bool ran = true;
+
+	world.scenario          = scenario;
+	world.now               = 0;
+	world.stopSent          = false;
+	world.processCount      = 0;
+	world.signalCount       = 0;
+	world.notificationCount = 0;
+
+	try
+	{
+		Supervisor supervisor(const_cast<char*>(scenario->name));
+		supervisor.setStartupCommand("fake");
+		supervisor.setStartupDelay(scenario->startupDelay);
+		supervisor.setAutoRestart(scenario->restartInterval >= 0);
+		supervisor.setAutoRestartInterval(scenario->restartInterval < 0 ? 0 : scenario->restartInterval);
+		supervisor.setShutdownTimeout(scenario->shutdownTimeout);
+
+		world.supervisor = &supervisor;
+		supervisor.start();
+		receive_notifications();
+		check(supervisor.isStopRequested() == (scenario->stopAt != NEVER), scenario->name,
+			"the stop request was seen (only) if one was sent");
+		check(supervisor.getRestartCount() == world.processCount - 1, scenario->name,
+			"every restart was counted");
+	}
+	catch (...)
+	{
+		ran = false;
+	}
+	world.supervisor = 0;
+
+	return ran;
+}
+
+/******************************************************************************
+**
+** FUNCTION    : check_scenario
+**
+** DESCRIPTION : check what the service manager and the processes saw
+**
+** ARGUMENTS   : scenario  the scenario
+**
+******************************************************************************/
+void check_scenario
+(
+	const Scenario* scenario
+)
+{
+	const char* name = scenario->name;
+	int         p;
+	int         next;
+	char        mainPid[32];
+	bool        everyPid = true;
+	bool        everyExit = true;
+
+	/* every scripted process (and no other) was started, and reported */
+	check(world.processCount == scenario->processCount, name, "every process was started");
+	for (p = 0, next = 0; p < world.processCount; p++)
+	{
+		snprintf(mainPid, sizeof(mainPid), "MAINPID=%d", FIRST_PID + p);
+		next = find(next, mainPid);
+		everyPid = everyPid && (next >= 0);
+		everyExit = everyExit && world.processes[p].reaped;
+		if (next < 0)
+		{
+			break;
+		}
+	}
+	check(everyPid, name, "MAINPID= was sent for each process, in order");
+	check(everyExit, name, "every process was reaped");
+
+	/* the service manager saw it start, and stop */
+	check(find(0, "STATUS=starting") == 0, name, "STATUS=starting was sent first");
+	check((world.notificationCount > 0)
+		&& (!strcmp(world.notifications[world.notificationCount - 1].text, "STATUS=stopped")),
+		name, "STATUS=stopped was sent last");
+	check(count("STATUS=stopped") == 1, name, "STATUS=stopped was sent once");
+	check(find(0, "STOPPING=1") >= 0, name, "STOPPING=1 was sent");
+
+	/* ready once per process that started up */
+	int ready = 0;
+	for (p = 0; p < world.processCount; p++)
+	{
+		unsigned long long runFor = world.processes[p].exitsAt - world.processes[p].startedAt;
+		ready += ((world.processes[p].exitsAt == NEVER) || (runFor > 1000ULL * scenario->startupDelay)) ? 1 : 0;
+	}
+	if (world.stopSent && (find(0, "STOPPING=1") < find(0, "READY=1")))
+	{
+		ready = 0;
+	}
+	check(count("READY=1") == ready, name, "READY=1 was sent once for each process that started up");
+
+	/* stopping */
+	int terms = 0;
+	int kills = 0;
+	for (int i = 0; i < world.signalCount; i++)
+	{
+		terms += world.signals[i].kill ? 0 : 1;
+		kills += world.signals[i].kill ? 1 : 0;
+	}
+	bool stoppedRunning = world.stopSent && (world.processCount > 0)
+		&& (world.processes[world.processCount - 1].exitsAt >= scenario->stopAt);
+	check(terms == (stoppedRunning ? 1 : 0), name, "SIGTERM was sent (only) to stop a running process");
+	check(kills == (stoppedRunning && (scenario->processes[world.processCount - 1].termAfter == NEVER) ? 1 : 0),
+		name, "SIGKILL was sent (only) to a process which ignored SIGTERM");
+}
+
+/******************************************************************************
+**
+** FUNCTION    : check_latency
+**
+** DESCRIPTION : the latency-regression checks:  the virtual time from each
+**               event to the supervisor's response
+**
+** ARGUMENTS   : scenario  the scenario
+**
+******************************************************************************/
+void check_latency
+(
+	const Scenario* scenario
+)
+{
+	const char*        name = scenario->name;
+	unsigned long long stoppedAt;
+	int                i;
+
+	if (world.notificationCount == 0)
+	{
+		return;
+	}
+	stoppedAt = world.notifications[world.notificationCount - 1].at;
+
+	/* READY=1 exactly at the startup delay */
+	i = find(0, "READY=1");
+	if (i >= 0)
+	{
+		check(world.notifications[i].at == 1000ULL * scenario->startupDelay, name,
+			"READY=1 was sent at the startup delay");
+	}
+
+	/* a restart within the restart interval (and a poll) of the crash */
+	for (int p = 1; p < world.processCount; p++)
+	{
+		unsigned long long crashedAt = world.processes[p - 1].exitsAt;
+		check((world.processes[p].startedAt >= crashedAt + 1000ULL * scenario->restartInterval)
+			&& (world.processes[p].startedAt <= crashedAt + 1000ULL * scenario->restartInterval + POLL_MILLISECONDS),
+			name, "the process was restarted within a poll of the restart interval");
+	}
+
+	if (world.stopSent)
+	{
+		/* STOPPING=1 as soon as the stop is asked for */
+		i = find(0, "STOPPING=1");
+		check((i >= 0) && (world.notifications[i].at == scenario->stopAt), name,
+			"STOPPING=1 was sent when the stop was asked for");
+
+		/* SIGTERM within a poll */
+		if (world.signalCount > 0)
+		{
+			check(world.signals[0].at <= scenario->stopAt + POLL_MILLISECONDS, name,
+				"SIGTERM was sent within a poll of the stop");
+		}
+
+		/* SIGKILL within a poll of the shutdown timeout */
+		if ((world.signalCount > 1) && world.signals[1].kill)
+		{
+			unsigned long long timeout = world.signals[0].at + 1000ULL * scenario->shutdownTimeout;
+			check((world.signals[1].at >= timeout) && (world.signals[1].at <= timeout + POLL_MILLISECONDS),
+				name, "SIGKILL was sent within a poll of the shutdown timeout");
+		}
+
+		/* STATUS=stopped within a poll of the last process exiting (or of
+		   the stop, if none was running) */
+		unsigned long long exitedAt = scenario->stopAt;
+		for (int p = 0; p < world.processCount; p++)
+		{
+			if ((world.processes[p].exitsAt > exitedAt) && (world.processes[p].exitsAt != NEVER))
+			{
+				exitedAt = world.processes[p].exitsAt;
+			}
+		}
+		check(stoppedAt <= exitedAt + POLL_MILLISECONDS, name,
+			"STATUS=stopped was sent within a poll of the process stopping");
+	}
+	else
+	{
+		/* STATUS=stopped within a poll of the (last) process exiting */
+		unsigned long long exitedAt = world.processes[world.processCount - 1].exitsAt;
+		check((stoppedAt >= exitedAt) && (stoppedAt <= exitedAt + POLL_MILLISECONDS), name,
+			"STATUS=stopped was sent within a poll of the process exiting");
+	}
+}
+
+/******************************************************************************
+**
+** FUNCTION    : virtual_ticks
+**               virtual_sleep
+**
+** DESCRIPTION : the virtual clock:  sleeping moves virtual time on, and the
+**               stand-in service manager stops the service at its scripted
+**               time on the way
+**
+**               Virtual time moves only here, so each notification is
+**               received (at the next sleep) at the time it was sent.
+**
+** ARGUMENTS   : milliseconds    time to sleep
+**               genericPointer  the World
+**
+******************************************************************************/
+unsigned long long virtual_ticks
+(
+	void* genericPointer
+)
+{
+	return ((World*)genericPointer)->now;
+}
+
+void virtual_sleep
+(
+	unsigned long milliseconds,
+	void*         genericPointer
+)
+{
+	World*             w = (World*)genericPointer;
+	unsigned long long until = w->now + milliseconds;
+
+	receive_notifications();
+	if ((!w->stopSent) && (w->scenario->stopAt <= until))
+	{
+		w->now = w->scenario->stopAt;
+		send_stop();
+		receive_notifications();
+	}
+	w->now = until;
+}
+
+/******************************************************************************
+**
+** FUNCTION    : receive_notifications
+**
+** DESCRIPTION : keep every notification waiting at the stand-in service
+**               manager's socket, timestamped now
+**
+******************************************************************************/
+void receive_notifications()
+{
+	while (world.notificationCount < MAX_NOTIFICATIONS)
+	{
+		Notification* n = &world.notifications[world.notificationCount];
+		int           length = (int)recv(world.manager, n->text, MAX_NOTIFICATION - 1, 0);
+		if (length < 0)
+		{
+			break;
+		}
+		n->text[length] = '\0';
+		n->at = world.now;
+		world.notificationCount++;
+	}
+}
+
+/******************************************************************************
+**
+** FUNCTION    : send_stop
+**
+** DESCRIPTION : stop the service as a service manager would (SIGTERM), and
+**               wait (in real time) for the supervisor to see it
+**
+******************************************************************************/
+void send_stop()
+{
+	unsigned long long sentAt = real_milliseconds();
+
+	world.stopSent = true;
+	kill(getpid(), SIGTERM);
+	while ((!world.supervisor->isStopRequested())
+		&& (real_milliseconds() - sentAt < 1000ULL * STOP_WAIT_SECONDS))
+	{
+		usleep(1000);
+	}
+}
+
+/******************************************************************************
+**
+** FUNCTION    : fake_start
+**               fake_exited
+**               fake_signal
+**
+** DESCRIPTION : the fake process backend:  each process started runs the
+**               scenario's next script
+**
+** ARGUMENTS   : command         not used
+**               pid             process id
+**               exitCode        OUT exit code
+**               kill            true for SIGKILL
+**               genericPointer  the World
+**
+******************************************************************************/
+long fake_start
+(
+	const char* command,
+	void*       genericPointer
+)
+{
+	World*               w = (World*)genericPointer;
+	const ProcessScript* script;
+	Process*             process;
+
+	(void)command;
+	if (w->processCount >= w->scenario->processCount)
+	{
+		return -1;
+	}
+	script  = &w->scenario->processes[w->processCount];
+	process = &w->processes[w->processCount];
+	process->startedAt = w->now;
+	process->exitsAt   = (script->exitAfter == NEVER ? NEVER : w->now + script->exitAfter);
+	process->exitCode  = script->exitCode;
+	process->reaped    = false;
+	return FIRST_PID + w->processCount++;
+}
+
+bool fake_exited
+(
+	long  pid,
+	int*  exitCode,
+	void* genericPointer
+)
+{
+	World*   w = (World*)genericPointer;
+	Process* process = &w->processes[pid - FIRST_PID];
+
+	if ((process->reaped) || (process->exitsAt > w->now))
+	{
+		return false;
+	}
+	process->reaped = true;
+	*exitCode = process->exitCode;
+	return true;
+}
+
+void fake_signal
+(
+	long  pid,
+	bool  kill,
+	void* genericPointer
+)
+{
+	World*               w = (World*)genericPointer;
+	Process*             process = &w->processes[pid - FIRST_PID];
+	const ProcessScript* script = &w->scenario->processes[pid - FIRST_PID];
+
+	if (w->signalCount < MAX_SIGNALS)
+	{
+		w->signals[w->signalCount].at   = w->now;
+		w->signals[w->signalCount].pid  = pid;
+		w->signals[w->signalCount].kill = kill;
+		w->signalCount++;
+	}
+	if (kill)
+	{
+		process->exitsAt  = w->now;
+		process->exitCode = 128 + SIGKILL;
+	}
+	else
+	if ((script->termAfter != NEVER) && (w->now + script->termAfter < process->exitsAt))
+	{
+		process->exitsAt  = w->now + script->termAfter;
+		process->exitCode = 128 + SIGTERM;
+	}
+}
+
+/******************************************************************************
+**
+** FUNCTION    : find
+**               count
+**
+** DESCRIPTION : look for a notification starting with the given text
+**
+** ARGUMENTS   : from  first notification to look at
+**               text  what it starts with
+**
+** RETURNS     : find:  its index, or -1 if there is none
+**               count: how many there are
+**
+******************************************************************************/
+int find
+(
+	int         from,
+	const char* text
+)
+{
+	for (int i = (from < 0 ? 0 : from); i < world.notificationCount; i++)
+	{
+		if (!strncmp(world.notifications[i].text, text, strlen(text)))
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+int count
+(
+	const char* text
+)
+{
+	int n = 0;
+	for (int i = find(0, text); i >= 0; i = find(i + 1, text))
+	{
+		n++;
+	}
+	return n;
+}
+
+/******************************************************************************
+**
+** FUNCTION    : real_milliseconds
+**
+** DESCRIPTION : the real (monotonic) time
+**
+** RETURNS     : milliseconds since an arbitrary fixed point
+**
+******************************************************************************/
+unsigned long long real_milliseconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000ULL + (unsigned long long)ts.tv_nsec / 1000000ULL;
+}
+
+/******************************************************************************
+**
+** FUNCTION    : check
+**
+** DESCRIPTION : report one check
+**
+** ARGUMENTS   : ok        true if it passed
+**               scenario  the scenario's name
+**               what      what was checked
+**
+******************************************************************************/
+void check
+(
+	bool        ok,
+	const char* scenario,
+	const char* what
+)
+{
+	printf("%s: %s: %s\n", (ok ? "ok" : "FAILED"), scenario, what);
+	if (!ok)
+	{
+		failures++;
+	}
+}